@@ -15,15 +15,146 @@ struct LeafID {
     int32_t id;
 };
 
+enum class Backend : uint32_t {
+    // 4-wide BVH, built on reset and refit as leaves move
+    BVH,
+    // Hierarchical spatial hash. Best for many similarly sized objects,
+    // with gridCellSize around the size of a typical object.
+    UniformGrid,
+    // Leaves kept sorted along one axis and re-sorted incrementally every
+    // update
+    SweepAndPrune,
+};
+
+struct Config {
+    Backend backend = Backend::BVH;
+    float gridCellSize = 1.f;
+};
+
+// Both of the backends below are rebuilt from the leaf AABBs on every
+// update, and keep leaves that don't fit their structure (infinite planes,
+// very large static geometry) in a separate list that every query tests
+// directly.
+
+// Leaves are hashed by the cell containing their min corner, on the
+// coarsest level they need: level L has cells of gridCellSize * 2^L, and a
+// leaf goes on the first level whose cells are at least as large as it is.
+// Buckets are sized from the leaf count rather than the extent of the
+// scene, so the arena doesn't need to be known ahead of time.
+class UniformGrid {
+public:
+    UniformGrid(CountT max_leaves, float cell_size);
+
+    void build(const math::AABB *leaf_aabbs, CountT num_leaves);
+
+    // Calls fn(leaf_idx) once for every leaf overlapping aabb
+    template <typename Fn>
+    inline void findIntersecting(const math::AABB *leaf_aabbs,
+                                 const math::AABB &aabb,
+                                 Fn &&fn) const;
+
+    // Walks the cells along the ray, calling fn(leaf_idx, t_max) once for
+    // each leaf whose AABB the ray enters before t_max. fn returns the new
+    // t_max, which lets the walk stop once no later cell can be closer.
+    template <typename Fn>
+    inline void traceRay(const math::AABB *leaf_aabbs,
+                         math::Vector3 o,
+                         math::Vector3 d,
+                         float t_max,
+                         Fn &&fn) const;
+
+private:
+    static constexpr int32_t maxLevels = 16;
+
+    struct CellKey {
+        int32_t level;
+        int32_t cell[3];
+    };
+
+    inline bool leafCell(const math::AABB &aabb, CellKey *key) const;
+    inline uint32_t bucketIdx(const CellKey &key) const;
+    inline void levelCellRange(int32_t level,
+                               const math::AABB &aabb,
+                               int32_t *min_cell,
+                               int32_t *max_cell) const;
+
+    float level_cell_sizes_[maxLevels];
+    float inv_level_cell_sizes_[maxLevels];
+    uint32_t bucket_mask_;
+    int32_t *bucket_starts_;
+    // Leaves sorted by bucket. The keys are kept apart from the AABBs so
+    // hash collisions can be skipped without touching the AABBs.
+    CellKey *entry_keys_;
+    math::AABB *entry_aabbs_;
+    int32_t *entry_leaves_;
+    CellKey *leaf_keys_;
+    uint32_t *leaf_buckets_;
+    int32_t *large_leaves_;
+    int32_t num_large_;
+    int32_t num_entries_;
+    uint32_t occupied_levels_;
+    math::AABB bounds_;
+};
+
+class SweepAndPrune {
+public:
+    SweepAndPrune(CountT max_leaves);
+
+    void build(const math::AABB *leaf_aabbs, CountT num_leaves);
+
+    template <typename Fn>
+    inline void findIntersecting(const math::AABB *leaf_aabbs,
+                                 const math::AABB &aabb,
+                                 Fn &&fn) const;
+
+    // Same contract as UniformGrid::traceRay
+    template <typename Fn>
+    inline void traceRay(const math::AABB *leaf_aabbs,
+                         math::Vector3 o,
+                         math::Vector3 d,
+                         float t_max,
+                         Fn &&fn) const;
+
+private:
+    // Leaves wider than this multiple of the average width are large
+    static constexpr float largeWidthScale = 8.f;
+
+    inline CountT lowerBound(float key) const;
+
+    // Calls fn(sorted_idx) for the sorted slots that could overlap
+    // [min_key, max_key] along the sort axis
+    template <typename Fn>
+    inline void scanRange(float min_key, float max_key, Fn &&fn) const;
+
+    void chooseAxis(const math::AABB *leaf_aabbs);
+    void sortFull();
+
+    int32_t sort_axis_;
+    int32_t *order_;
+    float *min_keys_;
+    int32_t *tmp_order_;
+    float *tmp_min_keys_;
+    // Copies of the leaf AABBs in sorted order, so the scan is linear in
+    // memory. The slots of large leaves are inverted.
+    math::AABB *sorted_aabbs_;
+    int32_t *large_leaves_;
+    int32_t num_large_;
+    int32_t num_leaves_;
+    float max_width_;
+    math::AABB bounds_;
+};
+
 class BVH {
 public:
     BVH(const ObjectManager *obj_mgr,
         CountT max_leaves,
         float leaf_velocity_expansion,
-        float leaf_accel_expansion);
+        float leaf_accel_expansion,
+        const Config &config = {});
 
     inline LeafID reserveLeaf(Entity e, base::ObjectID obj_id);
     inline math::AABB getLeafAABB(LeafID leaf_id) const;
+    inline CountT numLeaves() const;
 
     template <typename Fn>
     inline void findIntersecting(const math::AABB &aabb, Fn &&fn) const;
@@ -37,6 +168,15 @@ public:
                     math::Vector3 *out_hit_normal,
                     float t_max = float(INFINITY));
 
+    // Only tests leaves whose entity passes filter(Entity)
+    template <typename Fn>
+    inline Entity traceRayFiltered(math::Vector3 o,
+                                   math::Vector3 d,
+                                   float *out_hit_t,
+                                   math::Vector3 *out_hit_normal,
+                                   float t_max,
+                                   Fn &&filter);
+
     void updateLeafPosition(LeafID leaf_id,
                             const math::Vector3 &pos,
                             const math::Quat &rot,
@@ -52,6 +192,10 @@ public:
     inline void rebuildOnUpdate();
     void updateTree();
 
+    // Called once all leaves have been refit. Rebuilds the grid or sweep
+    // and prune structure from the new leaf AABBs, no-op for the BVH.
+    void finishRefit();
+
     inline void clearLeaves();
 
 private:
@@ -112,6 +256,9 @@ private:
     float leaf_velocity_expansion_;
     float leaf_accel_expansion_;
     bool force_rebuild_;
+    Backend backend_;
+    UniformGrid grid_;
+    SweepAndPrune sap_;
 };
 
 }
@@ -1,5 +1,466 @@
 namespace madrona::phys::broadphase {
 
+// Clips the ray to aabb, returning the entry and exit t
+inline bool clipRayToAABB(const math::AABB &aabb,
+                          math::Vector3 o,
+                          math::Vector3 d,
+                          float t_min,
+                          float t_max,
+                          float *t_enter,
+                          float *t_exit)
+{
+#pragma unroll
+    for (CountT i = 0; i < 3; i++) {
+        if (d[i] == 0.f) {
+            if (o[i] < aabb.pMin[i] || o[i] > aabb.pMax[i]) {
+                return false;
+            }
+            continue;
+        }
+
+        float inv_d = 1.f / d[i];
+        float t_near = (aabb.pMin[i] - o[i]) * inv_d;
+        float t_far = (aabb.pMax[i] - o[i]) * inv_d;
+        if (t_near > t_far) {
+            std::swap(t_near, t_far);
+        }
+
+        t_min = fmaxf(t_min, t_near);
+        t_max = fminf(t_max, t_far);
+    }
+
+    if (t_min > t_max) {
+        return false;
+    }
+
+    *t_enter = t_min;
+    *t_exit = t_max;
+    return true;
+}
+
+bool UniformGrid::leafCell(const math::AABB &aabb, CellKey *key) const
+{
+    // Keeps cell coordinates and their differences well inside int32_t
+    constexpr float max_cell_coord = float(1 << 28);
+
+    float extent = fmaxf(aabb.pMax.x - aabb.pMin.x,
+        fmaxf(aabb.pMax.y - aabb.pMin.y, aabb.pMax.z - aabb.pMin.z));
+
+    int32_t leaf_level = 0;
+    // Also fails for NaN and infinite extents
+    while (!(extent <= level_cell_sizes_[leaf_level])) {
+        if (++leaf_level == maxLevels) {
+            return false;
+        }
+    }
+
+    float inv_cell_size = inv_level_cell_sizes_[leaf_level];
+#pragma unroll
+    for (CountT i = 0; i < 3; i++) {
+        float c = floorf(aabb.pMin[i] * inv_cell_size);
+        if (!(c >= -max_cell_coord && c <= max_cell_coord)) {
+            return false;
+        }
+
+        key->cell[i] = int32_t(c);
+    }
+
+    key->level = leaf_level;
+    return true;
+}
+
+uint32_t UniformGrid::bucketIdx(const CellKey &key) const
+{
+    // Teschner et al. 2003, "Optimized Spatial Hashing for Collision
+    // Detection of Deformable Objects", with the level mixed in
+    uint32_t h = (uint32_t(key.cell[0]) * 73856093_u32) ^
+                 (uint32_t(key.cell[1]) * 19349663_u32) ^
+                 (uint32_t(key.cell[2]) * 83492791_u32) ^
+                 (uint32_t(key.level) * 2654435761_u32);
+    return h & bucket_mask_;
+}
+
+// Leaves on a level are no larger than its cells, so any leaf overlapping
+// aabb has its min corner within one cell below aabb's min corner.
+// aabb must already be clipped to bounds_.
+void UniformGrid::levelCellRange(int32_t level,
+                                 const math::AABB &aabb,
+                                 int32_t *min_cell,
+                                 int32_t *max_cell) const
+{
+    float cell_size = level_cell_sizes_[level];
+    float inv_cell_size = inv_level_cell_sizes_[level];
+
+#pragma unroll
+    for (CountT i = 0; i < 3; i++) {
+        min_cell[i] = int32_t(floorf((aabb.pMin[i] - cell_size) *
+                                     inv_cell_size));
+        max_cell[i] = int32_t(floorf(aabb.pMax[i] * inv_cell_size));
+    }
+}
+
+template <typename Fn>
+void UniformGrid::findIntersecting(const math::AABB *leaf_aabbs,
+                                   const math::AABB &aabb,
+                                   Fn &&fn) const
+{
+    using namespace math;
+
+    for (CountT i = 0; i < (CountT)num_large_; i++) {
+        int32_t leaf_idx = large_leaves_[i];
+        if (aabb.overlaps(leaf_aabbs[leaf_idx])) {
+            fn(leaf_idx);
+        }
+    }
+
+    if (num_entries_ == 0 || !aabb.overlaps(bounds_)) {
+        return;
+    }
+
+    // Leaves in the grid are all inside bounds_, so clipping the query
+    // makes unbounded queries finite without losing any overlaps
+    AABB clipped {
+        /* .pMin = */ Vector3::max(aabb.pMin, bounds_.pMin),
+        /* .pMax = */ Vector3::min(aabb.pMax, bounds_.pMax),
+    };
+
+    int32_t min_cells[maxLevels][3], max_cells[maxLevels][3];
+    int64_t num_query_cells = 0;
+    for (int32_t level = 0; level < maxLevels; level++) {
+        if ((occupied_levels_ & (1_u32 << level)) == 0) {
+            continue;
+        }
+
+        levelCellRange(level, clipped, min_cells[level], max_cells[level]);
+
+        int64_t num_level_cells = 1;
+#pragma unroll
+        for (CountT i = 0; i < 3; i++) {
+            num_level_cells *= int64_t(
+                max_cells[level][i] - min_cells[level][i] + 1);
+        }
+        num_query_cells += num_level_cells;
+    }
+
+    // Testing every leaf is cheaper than visiting more buckets than there
+    // are leaves
+    if (num_query_cells > (int64_t)num_entries_) {
+        for (int32_t i = 0; i < num_entries_; i++) {
+            if (aabb.overlaps(entry_aabbs_[i])) {
+                fn(entry_leaves_[i]);
+            }
+        }
+
+        return;
+    }
+
+    for (int32_t level = 0; level < maxLevels; level++) {
+        if ((occupied_levels_ & (1_u32 << level)) == 0) {
+            continue;
+        }
+
+        const int32_t *min_cell = min_cells[level];
+        const int32_t *max_cell = max_cells[level];
+
+        CellKey key;
+        key.level = level;
+        int32_t *cell = key.cell;
+        for (cell[2] = min_cell[2]; cell[2] <= max_cell[2]; cell[2]++) {
+            for (cell[1] = min_cell[1]; cell[1] <= max_cell[1]; cell[1]++) {
+                for (cell[0] = min_cell[0]; cell[0] <= max_cell[0];
+                     cell[0]++) {
+                    uint32_t bucket = bucketIdx(key);
+                    int32_t bucket_end = bucket_starts_[bucket + 1];
+
+                    for (int32_t i = bucket_starts_[bucket]; i < bucket_end;
+                         i++) {
+                        const CellKey &entry_key = entry_keys_[i];
+
+                        // Skip hash collisions, which would otherwise report
+                        // the leaf more than once
+                        if (entry_key.level != level ||
+                                entry_key.cell[0] != cell[0] ||
+                                entry_key.cell[1] != cell[1] ||
+                                entry_key.cell[2] != cell[2]) {
+                            continue;
+                        }
+
+                        if (aabb.overlaps(entry_aabbs_[i])) {
+                            fn(entry_leaves_[i]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <typename Fn>
+void UniformGrid::traceRay(const math::AABB *leaf_aabbs,
+                           math::Vector3 o,
+                           math::Vector3 d,
+                           float t_max,
+                           Fn &&fn) const
+{
+    using namespace math;
+
+    Diag3x3 inv_d = Diag3x3::fromVec(d).inv();
+
+    for (CountT i = 0; i < (CountT)num_large_; i++) {
+        int32_t leaf_idx = large_leaves_[i];
+        AABB leaf_aabb = leaf_aabbs[leaf_idx];
+        if (leaf_aabb.rayIntersects(o, inv_d, 0.f, t_max)) {
+            t_max = fn(leaf_idx, t_max);
+        }
+    }
+
+    float t_enter, t_exit;
+    if (num_entries_ == 0 ||
+            !clipRayToAABB(bounds_, o, d, 0.f, t_max, &t_enter, &t_exit)) {
+        return;
+    }
+
+    Vector3 start = o + t_enter * d;
+    Vector3 end = o + t_exit * d;
+
+    int32_t start_cells[maxLevels][3], end_cells[maxLevels][3];
+    int32_t bounds_min[maxLevels][3], bounds_max[maxLevels][3];
+    int64_t num_walk_cells = 0;
+    for (int32_t level = 0; level < maxLevels; level++) {
+        if ((occupied_levels_ & (1_u32 << level)) == 0) {
+            continue;
+        }
+
+        float inv_cell_size = inv_level_cell_sizes_[level];
+        num_walk_cells += 1;
+#pragma unroll
+        for (CountT i = 0; i < 3; i++) {
+            bounds_min[level][i] =
+                int32_t(floorf(bounds_.pMin[i] * inv_cell_size));
+            bounds_max[level][i] =
+                int32_t(floorf(bounds_.pMax[i] * inv_cell_size));
+
+            start_cells[level][i] = std::clamp(
+                int32_t(floorf(start[i] * inv_cell_size)),
+                bounds_min[level][i], bounds_max[level][i]);
+            end_cells[level][i] = std::clamp(
+                int32_t(floorf(end[i] * inv_cell_size)),
+                bounds_min[level][i], bounds_max[level][i]);
+
+            num_walk_cells += int64_t(
+                std::abs(end_cells[level][i] - start_cells[level][i]));
+        }
+    }
+
+    // Each step checks 8 cells, so long walks through sparse grids are
+    // slower than testing every leaf
+    if (num_walk_cells * 8 > (int64_t)num_entries_) {
+        for (int32_t i = 0; i < num_entries_; i++) {
+            AABB leaf_aabb = entry_aabbs_[i];
+            if (leaf_aabb.rayIntersects(o, inv_d, 0.f, t_max)) {
+                t_max = fn(entry_leaves_[i], t_max);
+            }
+        }
+
+        return;
+    }
+
+    for (int32_t level = 0; level < maxLevels; level++) {
+        if ((occupied_levels_ & (1_u32 << level)) == 0) {
+            continue;
+        }
+
+        float cell_size = level_cell_sizes_[level];
+
+        // Amanatides & Woo 1987, "A Fast Voxel Traversal Algorithm for Ray
+        // Tracing"
+        int32_t cell[3], step[3];
+        float t_next[3], t_delta[3];
+#pragma unroll
+        for (CountT i = 0; i < 3; i++) {
+            cell[i] = start_cells[level][i];
+
+            if (d[i] > 0.f) {
+                step[i] = 1;
+                t_next[i] = (float(cell[i] + 1) * cell_size - o[i]) / d[i];
+                t_delta[i] = cell_size / d[i];
+            } else if (d[i] < 0.f) {
+                step[i] = -1;
+                t_next[i] = (float(cell[i]) * cell_size - o[i]) / d[i];
+                t_delta[i] = -cell_size / d[i];
+            } else {
+                step[i] = 0;
+                t_next[i] = FLT_MAX;
+                t_delta[i] = FLT_MAX;
+            }
+        }
+
+        int32_t prev_cell[3] = { cell[0], cell[1], cell[2] };
+        bool first_cell = true;
+        while (true) {
+            // A leaf stored in cell c can reach into c + 1 along each axis,
+            // so the leaves that can be in this cell are stored in the 8
+            // cells at or below it
+            for (int32_t offset = 0; offset < 8; offset++) {
+                CellKey src_key {
+                    level,
+                    {
+                        cell[0] - (offset & 1),
+                        cell[1] - ((offset >> 1) & 1),
+                        cell[2] - (offset >> 2),
+                    },
+                };
+                const int32_t *src_cell = src_key.cell;
+
+                // The walk is monotonic along each axis, so the cells it
+                // visits that a leaf can reach are contiguous. Only test
+                // the leaf on the first of them.
+                if (!first_cell &&
+                        prev_cell[0] - src_cell[0] <= 1 &&
+                        prev_cell[0] - src_cell[0] >= 0 &&
+                        prev_cell[1] - src_cell[1] <= 1 &&
+                        prev_cell[1] - src_cell[1] >= 0 &&
+                        prev_cell[2] - src_cell[2] <= 1 &&
+                        prev_cell[2] - src_cell[2] >= 0) {
+                    continue;
+                }
+
+                uint32_t bucket = bucketIdx(src_key);
+                int32_t bucket_end = bucket_starts_[bucket + 1];
+
+                for (int32_t i = bucket_starts_[bucket]; i < bucket_end;
+                     i++) {
+                    const CellKey &entry_key = entry_keys_[i];
+                    if (entry_key.level != level ||
+                            entry_key.cell[0] != src_cell[0] ||
+                            entry_key.cell[1] != src_cell[1] ||
+                            entry_key.cell[2] != src_cell[2]) {
+                        continue;
+                    }
+
+                    AABB leaf_aabb = entry_aabbs_[i];
+                    if (leaf_aabb.rayIntersects(o, inv_d, 0.f, t_max)) {
+                        t_max = fn(entry_leaves_[i], t_max);
+                    }
+                }
+            }
+
+            CountT axis = 0;
+            if (t_next[1] < t_next[axis]) {
+                axis = 1;
+            }
+            if (t_next[2] < t_next[axis]) {
+                axis = 2;
+            }
+
+            // Leaves first reachable from later cells can't be hit before
+            // t_max
+            float cell_exit_t = t_next[axis];
+            if (cell_exit_t > t_max || cell_exit_t > t_exit) {
+                break;
+            }
+
+            prev_cell[0] = cell[0];
+            prev_cell[1] = cell[1];
+            prev_cell[2] = cell[2];
+            first_cell = false;
+
+            cell[axis] += step[axis];
+            if (cell[axis] < bounds_min[level][axis] ||
+                    cell[axis] > bounds_max[level][axis]) {
+                break;
+            }
+            t_next[axis] += t_delta[axis];
+        }
+    }
+}
+
+CountT SweepAndPrune::lowerBound(float key) const
+{
+    CountT lo = 0;
+    CountT hi = num_leaves_;
+    while (lo < hi) {
+        CountT mid = (lo + hi) / 2;
+        if (min_keys_[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+template <typename Fn>
+void SweepAndPrune::scanRange(float min_key, float max_key, Fn &&fn) const
+{
+    for (CountT i = lowerBound(min_key - max_width_);
+         i < (CountT)num_leaves_ && min_keys_[i] <= max_key; i++) {
+        fn(i);
+    }
+}
+
+template <typename Fn>
+void SweepAndPrune::findIntersecting(const math::AABB *leaf_aabbs,
+                                     const math::AABB &aabb,
+                                     Fn &&fn) const
+{
+    for (CountT i = 0; i < (CountT)num_large_; i++) {
+        int32_t leaf_idx = large_leaves_[i];
+        if (aabb.overlaps(leaf_aabbs[leaf_idx])) {
+            fn(leaf_idx);
+        }
+    }
+
+    scanRange(aabb.pMin[sort_axis_], aabb.pMax[sort_axis_],
+              [&](CountT sorted_idx) {
+        // Always false for the inverted slots of large leaves
+        if (aabb.overlaps(sorted_aabbs_[sorted_idx])) {
+            fn(order_[sorted_idx]);
+        }
+    });
+}
+
+template <typename Fn>
+void SweepAndPrune::traceRay(const math::AABB *leaf_aabbs,
+                             math::Vector3 o,
+                             math::Vector3 d,
+                             float t_max,
+                             Fn &&fn) const
+{
+    using namespace math;
+
+    Diag3x3 inv_d = Diag3x3::fromVec(d).inv();
+
+    for (CountT i = 0; i < (CountT)num_large_; i++) {
+        int32_t leaf_idx = large_leaves_[i];
+        AABB leaf_aabb = leaf_aabbs[leaf_idx];
+        if (leaf_aabb.rayIntersects(o, inv_d, 0.f, t_max)) {
+            t_max = fn(leaf_idx, t_max);
+        }
+    }
+
+    float t_enter, t_exit;
+    if (num_large_ == num_leaves_ ||
+            !clipRayToAABB(bounds_, o, d, 0.f, t_max, &t_enter, &t_exit)) {
+        return;
+    }
+
+    float key_enter = o[sort_axis_] + t_enter * d[sort_axis_];
+    float key_exit = o[sort_axis_] + t_exit * d[sort_axis_];
+
+    scanRange(fminf(key_enter, key_exit), fmaxf(key_enter, key_exit),
+              [&](CountT sorted_idx) {
+        AABB leaf_aabb = sorted_aabbs_[sorted_idx];
+
+        // The slab test would accept the inverted slots of large leaves
+        if (leaf_aabb.pMin.x <= leaf_aabb.pMax.x &&
+                leaf_aabb.rayIntersects(o, inv_d, 0.f, t_max)) {
+            t_max = fn(order_[sorted_idx], t_max);
+        }
+    });
+}
+
 LeafID BVH::reserveLeaf(Entity e, base::ObjectID obj_id)
 {
     int32_t leaf_idx = num_leaves_.fetch_add_relaxed(1);
@@ -18,9 +479,30 @@ math::AABB BVH::getLeafAABB(LeafID leaf_id) const
     return leaf_aabbs_[leaf_id.id];
 }
 
+CountT BVH::numLeaves() const
+{
+    return num_leaves_.load_relaxed();
+}
+
 template <typename Fn>
 void BVH::findIntersecting(const math::AABB &aabb, Fn &&fn) const
 {
+    auto leaf_fn = [&](int32_t leaf_idx) {
+        fn(leaf_entities_[leaf_idx]);
+    };
+
+    switch (backend_) {
+    case Backend::UniformGrid: {
+        grid_.findIntersecting(leaf_aabbs_, aabb, leaf_fn);
+        return;
+    }
+    case Backend::SweepAndPrune: {
+        sap_.findIntersecting(leaf_aabbs_, aabb, leaf_fn);
+        return;
+    }
+    default: break;
+    }
+
     int32_t stack[32];
     stack[0] = 0;
     CountT stack_size = 1;
@@ -65,6 +547,115 @@ void BVH::findLeafIntersecting(LeafID leaf_id, Fn &&fn) const
     findIntersecting(leaf_aabb, std::forward<Fn>(fn));
 }
 
+template <typename Fn>
+Entity BVH::traceRayFiltered(math::Vector3 o,
+                             math::Vector3 d,
+                             float *out_hit_t,
+                             math::Vector3 *out_hit_normal,
+                             float t_max,
+                             Fn &&filter)
+{
+    using namespace math;
+
+    Entity closest_hit_entity = Entity::none();
+    Vector3 closest_hit_normal;
+
+    if (backend_ != Backend::BVH) {
+        auto leaf_fn = [&](int32_t leaf_idx, float cur_t_max) {
+            if (!filter(leaf_entities_[leaf_idx])) {
+                return cur_t_max;
+            }
+
+            float hit_t;
+            Vector3 leaf_hit_normal;
+            bool leaf_hit = traceRayIntoLeaf(
+                leaf_idx, o, d, 0.f, cur_t_max, &hit_t, &leaf_hit_normal);
+
+            if (!leaf_hit) {
+                return cur_t_max;
+            }
+
+            t_max = hit_t;
+            closest_hit_entity = leaf_entities_[leaf_idx];
+            closest_hit_normal = leaf_hit_normal;
+            return hit_t;
+        };
+
+        if (backend_ == Backend::UniformGrid) {
+            grid_.traceRay(leaf_aabbs_, o, d, t_max, leaf_fn);
+        } else {
+            sap_.traceRay(leaf_aabbs_, o, d, t_max, leaf_fn);
+        }
+
+        if (closest_hit_entity == Entity::none()) {
+            return Entity::none();
+        }
+
+        *out_hit_t = t_max;
+        *out_hit_normal = closest_hit_normal;
+        return closest_hit_entity;
+    }
+
+    Diag3x3 inv_d = Diag3x3::fromVec(d).inv();
+
+    int32_t stack[32];
+    stack[0] = 0;
+    CountT stack_size = 1;
+
+    while (stack_size > 0) { 
+        int32_t node_idx = stack[--stack_size];
+        const Node &node = nodes_[node_idx];
+        for (int i = 0; i < 4; i++) {
+            if (!node.hasChild(i)) {
+                continue; // Technically this could be break?
+            };
+
+            madrona::math::AABB child_aabb {
+                /* .pMin = */ {
+                    node.minX[i],
+                    node.minY[i],
+                    node.minZ[i],
+                },
+                /* .pMax = */ {
+                    node.maxX[i],
+                    node.maxY[i],
+                    node.maxZ[i],
+                },
+            };
+
+            if (child_aabb.rayIntersects(o, inv_d, 0.f, t_max)) {
+                if (node.isLeaf(i)) {
+                    int32_t leaf_idx = node.leafIDX(i);
+                    if (!filter(leaf_entities_[leaf_idx])) {
+                        continue;
+                    }
+                    
+                    float hit_t;
+                    Vector3 leaf_hit_normal;
+                    bool leaf_hit = traceRayIntoLeaf(
+                        leaf_idx, o, d, 0.f, t_max, &hit_t, &leaf_hit_normal);
+
+                    if (leaf_hit) {
+                        t_max = hit_t;
+                        closest_hit_entity = leaf_entities_[leaf_idx];
+                        closest_hit_normal = leaf_hit_normal;
+                    }
+                } else {
+                    stack[stack_size++] = node.children[i];
+                }
+            }
+        }
+    }
+    
+    if (closest_hit_entity == Entity::none()) {
+        return Entity::none();
+    }
+
+    *out_hit_t = t_max;
+    *out_hit_normal = closest_hit_normal;
+    return closest_hit_entity;
+}
+
 void BVH::rebuildOnUpdate()
 {
     force_rebuild_ = true;
@@ -73,6 +73,32 @@ float hullClosestPointToOriginGJK(
     float err_tolerance2,
     math::Vector3 *closest_point);
 
+struct HullHullGJKResult {
+    // Distance between the hulls, 0 if they overlap
+    float distance;
+    // Separated: direction from the closest point on A to the closest point
+    // on B. Overlapping: direction of minimum penetration, pointing from A
+    // to B.
+    math::Vector3 normal;
+    // Penetration depth along normal, 0 if separated
+    float depth;
+    // Separated: closest point on A. Overlapping: point on A deepest
+    // inside B.
+    math::Vector3 aPoint;
+    // False if EPA couldn't build a polytope around the origin (typically
+    // the hulls are barely touching), normal, depth and aPoint are invalid
+    // in that case.
+    bool valid;
+};
+
+// Distance between two hulls with GJK, falling back to EPA for the
+// penetration depth and direction if they overlap. Both hulls must be in
+// the same space.
+HullHullGJKResult hullHullGJKEPA(
+    const HalfEdgeMesh &a,
+    const HalfEdgeMesh &b,
+    float err_tolerance2);
+
 }
 
 #include "geo.inl"
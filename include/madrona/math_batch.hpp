@@ -0,0 +1,56 @@
+#pragma once
+
+#include <madrona/math.hpp>
+
+namespace madrona::math {
+
+/*
+Structure of arrays batch versions of the hot per-object transform
+operations. Each kernel processes element i of every input array and
+writes element i of the output, running 8 elements per iteration with AVX2,
+4 with NEON and one at a time otherwise. The math matches the scalar
+Quat::rotateVec, Mat3x4::fromTRS and AABB::applyTRS formula for formula,
+so results agree with the scalar versions up to floating point
+contraction. Outputs may alias their matching inputs.
+
+These are CPU only; GPU code should keep using the scalar operations, which
+already run one object per thread.
+*/
+
+struct Vector3SoA {
+    float *x;
+    float *y;
+    float *z;
+};
+
+struct QuatSoA {
+    float *w;
+    float *x;
+    float *y;
+    float *z;
+};
+
+struct AABBSoA {
+    Vector3SoA pMin;
+    Vector3SoA pMax;
+};
+
+#ifndef MADRONA_GPU_MODE
+
+// out[i] = rot[i].rotateVec(v[i])
+void batchRotateVectors(QuatSoA rot, Vector3SoA v, Vector3SoA out,
+                        CountT n);
+
+// out[i] = Mat3x4::fromTRS(t[i], r[i], s[i]). Scale components are stored
+// as x, y, z for Diag3x3's d0, d1, d2. The output is a regular array of
+// Mat3x4 since that's what instance data consumers upload.
+void batchComposeTRS(Vector3SoA t, QuatSoA r, Vector3SoA s, Mat3x4 *out,
+                     CountT n);
+
+// out[i] = aabbs[i].applyTRS(t[i], r[i], s[i])
+void batchTransformAABBs(AABBSoA aabbs, Vector3SoA t, QuatSoA r,
+                         Vector3SoA s, AABBSoA out, CountT n);
+
+#endif
+
+}
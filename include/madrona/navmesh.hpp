@@ -23,12 +23,61 @@ struct Navmesh {
         uint32_t alias;
     };
 
+    // Object median binary BVH over the triangles, used for point location
+    struct TriBVH {
+        struct Node {
+            math::AABB bounds;
+            // For interior nodes the index of the first child, with the
+            // second child right after it. For leaves the offset of the
+            // node's first triangle in triIndices.
+            uint32_t childOrFirstTri;
+            // 0 for interior nodes
+            uint32_t numTris;
+        };
+
+        Node *nodes;
+        uint32_t *triIndices;
+        uint32_t numNodes;
+
+        static constexpr inline CountT maxLeafTris = 4;
+        static constexpr inline CountT maxDepth = 64;
+    };
+
+    // Optional coarse abstraction of the navmesh for long distance queries.
+    // Triangles are grouped into connected regions, and each pair of
+    // adjacent regions is joined by a single portal placed on one of the
+    // edges they share. The shortest path cost between every pair of portals
+    // on the same region, staying inside that region, is precomputed.
+    struct Hierarchy {
+        uint32_t *triRegions;
+        // Portals bordering each region, regionPortalOffsets has
+        // numRegions + 1 entries
+        uint32_t *regionPortalOffsets;
+        uint32_t *regionPortals;
+        // Row major portal to portal cost matrix of each region, FLT_MAX if
+        // the portals aren't connected inside the region
+        uint32_t *regionCostOffsets;
+        float *regionPortalCosts;
+        // Per portal, the two regions it joins, the portal's index within
+        // each region's portal list and the triangle on each side
+        uint32_t *portalRegions;
+        uint32_t *portalLocalIdxs;
+        uint32_t *portalTris;
+        math::Vector3 *portalPositions;
+        uint32_t numRegions;
+        uint32_t numPortals;
+        // Total size of the arrays above
+        uint64_t numBytes;
+    };
+
     math::Vector3 *vertices;
     uint32_t *triIndices;
     uint32_t *triAdjacency;
     AliasEntry *triSampleAliasTable;
     uint32_t numVerts;
     uint32_t numTris;
+    TriBVH triBVH;
+    Hierarchy hierarchy;
 
     inline math::Vector3 samplePointAndPoly(RandKey rnd, uint32_t *out_poly);
     inline math::Vector3 samplePoint(RandKey rnd);
@@ -38,6 +87,31 @@ struct Navmesh {
                                     math::Vector3 *out_b,
                                     math::Vector3 *out_c);
 
+    // Returns the triangle directly above or below pos, meaning its XY
+    // projection contains pos. If several do (stacked floors), the one
+    // vertically closest to pos wins. Returns sentinel if pos is outside the
+    // navmesh's footprint.
+    uint32_t findPoly(math::Vector3 pos);
+
+    // Closest point to pos anywhere on the navmesh, optionally returning the
+    // triangle it lies on.
+    math::Vector3 closestPointOnNavmesh(math::Vector3 pos,
+                                        uint32_t *out_poly = nullptr);
+
+    // findPoly for many agents at once. in_out_polys holds each agent's
+    // triangle from the previous call, or sentinel. Agents rarely move far
+    // between calls, so the previous triangle and its neighbors are checked
+    // before falling back to the BVH, which also keeps agents on the floor
+    // they were already on.
+    void findPolys(const math::Vector3 *positions,
+                   uint32_t *in_out_polys,
+                   CountT num_positions);
+
+    void closestPointsOnNavmesh(const math::Vector3 *positions,
+                                math::Vector3 *out_points,
+                                uint32_t *out_polys,
+                                CountT num_positions);
+
     struct BFSState {
         uint32_t *queue;
         bool *visited;
@@ -63,17 +137,179 @@ struct Navmesh {
         DijkstrasState dijkstras_state,
         Fn &&fn);
 
+    // Scratch state for point to point queries, every array holds numTris
+    // entries. Rather than clearing the arrays on every query, entries are
+    // only valid when their visitGenerations stamp matches generation, which
+    // is bumped at the start of each query. visitGenerations must be zeroed
+    // and generation set to 0 before the first query, and the arrays can't
+    // be shared with another PathFindState.
+    struct PathFindState {
+        float *costs;
+        float *priorities;
+        math::Vector3 *entryPoints;
+        uint32_t *parents;
+        uint32_t *heap;
+        uint32_t *heapIndex;
+        uint32_t *visitGenerations;
+        uint32_t generation;
+    };
+
+    // A* search from start_pos on start_poly to goal_pos on goal_poly, using
+    // the same edge midpoint path costs as dijkstrasFromPoly and a straight
+    // line heuristic. The search stops as soon as goal_poly is expanded.
+    // Writes the triangles from start_poly to goal_poly into out_corridor,
+    // which must hold numTris entries, and returns the corridor length, or 0
+    // if goal_poly is unreachable.
+    uint32_t findCorridor(uint32_t start_poly,
+                          math::Vector3 start_pos,
+                          uint32_t goal_poly,
+                          math::Vector3 goal_pos,
+                          PathFindState *state,
+                          uint32_t *out_corridor,
+                          float *out_path_cost = nullptr);
+
+    // Funnel (string pulling) smoothing of a corridor returned by
+    // findCorridor, performed in the XY plane. Writes the start point, the
+    // corridor vertices the shortest path bends around and the goal point to
+    // out_waypoints. Paths longer than max_waypoints are truncated, which is
+    // fine for agents only steering towards the next few waypoints.
+    CountT stringPull(math::Vector3 start_pos,
+                      math::Vector3 goal_pos,
+                      const uint32_t *corridor,
+                      uint32_t corridor_len,
+                      math::Vector3 *out_waypoints,
+                      CountT max_waypoints);
+
+    // findCorridor followed by stringPull. Returns the number of waypoints
+    // written, or 0 if goal_poly is unreachable.
+    CountT findPath(uint32_t start_poly,
+                    math::Vector3 start_pos,
+                    uint32_t goal_poly,
+                    math::Vector3 goal_pos,
+                    PathFindState *state,
+                    math::Vector3 *out_waypoints,
+                    CountT max_waypoints);
+
+    // Scratch state for findCorridorHierarchical. tris holds numTris
+    // entries, portals holds hierarchy.numPortals + 1 entries,
+    // portalGoalCosts holds hierarchy.numPortals entries and
+    // regionGenerations holds hierarchy.numRegions entries. As with
+    // PathFindState, all generation stamps must start zeroed.
+    struct HierarchicalPathFindState {
+        PathFindState tris;
+        PathFindState portals;
+        float *portalGoalCosts;
+        uint32_t *regionGenerations;
+        uint32_t regionGeneration;
+    };
+
+    // Same contract as findCorridor, but for navmeshes built with a
+    // hierarchy. Searches the portal graph first, then refines the path
+    // with an A* search restricted to the regions the coarse path passes
+    // through, so the work done scales with the path length rather than the
+    // size of the navmesh. The corridor can be slightly longer than the one
+    // findCorridor would return.
+    uint32_t findCorridorHierarchical(uint32_t start_poly,
+                                      math::Vector3 start_pos,
+                                      uint32_t goal_poly,
+                                      math::Vector3 goal_pos,
+                                      HierarchicalPathFindState *state,
+                                      uint32_t *out_corridor,
+                                      float *out_path_cost = nullptr);
+
+    // findCorridorHierarchical followed by stringPull.
+    CountT findPathHierarchical(uint32_t start_poly,
+                                math::Vector3 start_pos,
+                                uint32_t goal_poly,
+                                math::Vector3 goal_pos,
+                                HierarchicalPathFindState *state,
+                                math::Vector3 *out_waypoints,
+                                CountT max_waypoints);
+
+    // hierarchy_region_size is the target number of triangles per region of
+    // the hierarchy, 0 skips building it.
     static Navmesh initFromPolygons(
         math::Vector3 *poly_vertices,
         uint32_t *poly_idxs,
         uint32_t *poly_idx_offsets,
         uint32_t *poly_sizes,
         uint32_t num_verts,
-        uint32_t num_polys);
+        uint32_t num_polys,
+        uint32_t hierarchy_region_size = 0);
 
     static constexpr inline uint32_t sentinel = 0xFFFF'FFFF;
 };
 
+// Precomputed path costs from a fixed set of source triangles to every
+// triangle of a navmesh. The table is never written after it's built, so
+// every world can share one copy instead of rerunning dijkstrasFromPoly.
+struct NavmeshDistanceTable {
+    const uint32_t *sourcePolys;
+    // numSources rows of numTris costs, FLT_MAX where unreachable
+    const float *distances;
+    uint32_t numSources;
+    uint32_t numTris;
+
+    // The cost dijkstrasFromPoly reports for poly when run from the
+    // source's triangle and position.
+    inline float distance(uint32_t source_idx, uint32_t poly) const;
+
+    // Estimate of the path cost between any two triangles, treating the
+    // sources as ALT landmarks: by the triangle inequality, the difference
+    // in distance from a landmark bounds the cost from below. The midpoint
+    // costs aren't an exact metric, so this can very slightly overestimate.
+    // Returns FLT_MAX if some landmark shows a and b are disconnected.
+    inline float landmarkLowerBound(uint32_t a, uint32_t b) const;
+};
+
+// Owns the memory behind a NavmeshDistanceTable: a heap allocation when
+// built, or a read-only mapping of a file saved by save(), whose pages the
+// OS shares between every process mapping that file.
+class NavmeshDistanceTableStorage {
+public:
+    NavmeshDistanceTableStorage();
+    NavmeshDistanceTableStorage(const NavmeshDistanceTableStorage &) = delete;
+    NavmeshDistanceTableStorage(NavmeshDistanceTableStorage &&o);
+    ~NavmeshDistanceTableStorage();
+
+    NavmeshDistanceTableStorage & operator=(NavmeshDistanceTableStorage &&o);
+
+    // One row per source, computed with dijkstrasFromPoly starting at
+    // source_positions[i] on source_polys[i]
+    static NavmeshDistanceTableStorage build(
+        Navmesh &navmesh,
+        const uint32_t *source_polys,
+        const math::Vector3 *source_positions,
+        uint32_t num_sources);
+
+    // Picks num_landmarks sources by farthest point sampling, for use with
+    // landmarkLowerBound. Each new landmark is the triangle farthest from
+    // all previous ones, so the landmarks end up spread around the edges of
+    // the navmesh and cover every disconnected island before doubling up.
+    static NavmeshDistanceTableStorage buildLandmarks(
+        Navmesh &navmesh,
+        uint32_t num_landmarks);
+
+    bool save(const char *path, const Navmesh &navmesh) const;
+
+    // Fails, returning an invalid storage, if the file is missing,
+    // malformed or was built for a different navmesh.
+    static NavmeshDistanceTableStorage load(const char *path,
+                                            const Navmesh &navmesh);
+
+    inline bool valid() const { return base_ != nullptr; }
+    inline const NavmeshDistanceTable & table() const { return table_; }
+
+private:
+    NavmeshDistanceTableStorage(void *base, uint64_t num_bytes,
+                                bool mapped, NavmeshDistanceTable table);
+
+    void *base_;
+    uint64_t numBytes_;
+    bool mapped_;
+    NavmeshDistanceTable table_;
+};
+
 }
 
 #include "navmesh.inl"
@@ -153,4 +153,31 @@ inline void Navmesh::dijkstrasFromPoly(
     }
 }
 
+float NavmeshDistanceTable::distance(uint32_t source_idx,
+                                    uint32_t poly) const
+{
+    return distances[(uint64_t)source_idx * numTris + poly];
+}
+
+float NavmeshDistanceTable::landmarkLowerBound(uint32_t a, uint32_t b) const
+{
+    float bound = 0.f;
+    for (uint32_t i = 0; i < numSources; i++) {
+        float dist_a = distance(i, a);
+        float dist_b = distance(i, b);
+
+        bool reached_a = dist_a != FLT_MAX;
+        bool reached_b = dist_b != FLT_MAX;
+        if (reached_a != reached_b) {
+            return FLT_MAX;
+        } else if (!reached_a) {
+            continue;
+        }
+
+        bound = fmaxf(bound, fabsf(dist_a - dist_b));
+    }
+
+    return bound;
+}
+
 }
@@ -7,6 +7,7 @@
 
 #include <madrona/broadphase.hpp>
 #include <madrona/geo.hpp>
+#include <madrona/mesh_bvh.hpp>
 
 namespace madrona::phys {
 
@@ -58,6 +59,9 @@ struct ContactConstraint {
     math::Vector4 points[4];
     int32_t numPoints;
     math::Vector3 normal;
+    // Index of this pair's entry in the persistent contact cache,
+    // -1 if the pair could not be cached
+    int32_t cacheEntry;
 };
 
 struct JointConstraint {
@@ -90,6 +94,11 @@ struct JointConstraint {
 
     math::Vector3 r1;
     math::Vector3 r2;
+
+    // Accumulated impulses, kept across steps so solvers that warm start
+    // (TGS) can reuse them. Zero when the joint is created.
+    math::Vector3 linearImpulse;
+    math::Vector3 angularImpulse;
 };
 
 struct CollisionEvent {
@@ -121,7 +130,13 @@ struct CollisionPrimitive {
     enum class Type : uint32_t {
         Sphere = 1 << 0,
         Hull = 1 << 1,
-        Plane = 1 << 2,
+        Capsule = 1 << 2,
+        Box = 1 << 3,
+        // Heightfield, TriangleMesh and Plane must stay the largest values
+        // so the static primitive is always b in the narrowphase
+        Heightfield = 1 << 4,
+        TriangleMesh = 1 << 5,
+        Plane = 1 << 6,
     };
 
     struct Sphere {
@@ -132,6 +147,40 @@ struct CollisionPrimitive {
         geo::HalfEdgeMesh halfEdgeMesh;
     };
 
+    // Centered on the origin, with the segment along the Z axis.
+    // cylinderHeight is the length of the segment, not the overall height.
+    // Scaled by Scale::d0 (which must equal d1) and Scale::d2 respectively.
+    struct Capsule {
+        float radius;
+        float cylinderHeight;
+    };
+
+    // Centered on the origin
+    struct Box {
+        math::Vector3 halfExtents;
+    };
+
+    // numRows x numCols grid of samples in the XY plane, centered on the
+    // origin with samples cellSize apart. Rows run along Y. The sample at
+    // (row, col) is at height minHeight + heightScale * samples[row *
+    // numCols + col]. Each cell is split into 2 triangles along the
+    // diagonal from (row, col) to (row + 1, col + 1). Like planes,
+    // heightfields can only be used by static objects.
+    struct Heightfield {
+        uint16_t *samples;
+        uint32_t numRows;
+        uint32_t numCols;
+        float cellSize;
+        float minHeight;
+        float heightScale;
+    };
+
+    // Triangles are one sided, facing the side they're counter clockwise
+    // from. Static objects only, like heightfields.
+    struct TriangleMesh {
+        MeshBVH bvh;
+    };
+
     struct Plane {};
 
     Type type;
@@ -139,6 +188,10 @@ struct CollisionPrimitive {
         Sphere sphere;
         Plane plane;
         Hull hull;
+        Capsule capsule;
+        Box box;
+        Heightfield heightfield;
+        TriangleMesh triangleMesh;
     };
 };
 
@@ -160,21 +213,39 @@ namespace PhysicsSystem {
     enum class Solver : uint32_t {
         XPBD,
         TGS,
+        // XPBD with contacts graph colored and solved in SIMD batches on
+        // the CPU. Behaves like XPBD on the GPU.
+        XPBDBatched,
+        // XPBDBatched with all the substeps of a step fused into a single
+        // taskgraph node per world on the CPU. Behaves like XPBD on the GPU.
+        XPBDFused,
     };
 
+    // enable_sleeping lets islands of resting bodies go to sleep, skipping
+    // them in the broadphase, narrowphase and solver. A sleeping body wakes
+    // when an awake or moving body touches it, or when its Position,
+    // Rotation, Velocity, ExternalForce or ExternalTorque is changed from
+    // outside the physics system.
     void init(Context &ctx,
               ObjectManager *obj_mgr,
               float delta_t,
               CountT num_substeps,
               math::Vector3 gravity,
               CountT max_dynamic_objects,
-              Solver solver = Solver::XPBD);
+              Solver solver = Solver::XPBD,
+              const broadphase::Config &broadphase_config = {},
+              bool enable_sleeping = false);
 
     void reset(Context &ctx);
     broadphase::LeafID registerEntity(Context &ctx,
                                       Entity e,
                                       base::ObjectID obj_id);
 
+    // Stops e short of any other body it would otherwise pass through in a
+    // single step. Meant for small, fast bodies. Needs to be set again after
+    // reset.
+    void setContinuousCollision(Context &ctx, Entity e, bool enabled);
+
     template <typename Fn>
     void findEntitiesWithinAABB(Context &ctx,
                                        math::AABB aabb,
@@ -4,6 +4,8 @@
 #include <madrona/importer.hpp>
 #include <madrona/stack_alloc.hpp>
 #include <madrona/mesh_bvh.hpp>
+#include <madrona/heap_array.hpp>
+#include <madrona/optional.hpp>
 
 #include <madrona/geo.hpp>
 
@@ -14,11 +16,32 @@ struct SourceCollisionPrimitive {
         uint32_t hullIDX;
     };
 
+    // Same layout as CollisionPrimitive::Heightfield. The samples are
+    // copied into the processed assets.
+    struct HeightfieldInput {
+        const uint16_t *samples;
+        uint32_t numRows;
+        uint32_t numCols;
+        float cellSize;
+        float minHeight;
+        float heightScale;
+    };
+
+    // Triangulated mesh, which gets its own MeshBVH in the processed
+    // assets
+    struct TriangleMeshInput {
+        const imp::SourceMesh *mesh;
+    };
+
     CollisionPrimitive::Type type;
     union {
         CollisionPrimitive::Sphere sphere;
         CollisionPrimitive::Plane plane;
+        CollisionPrimitive::Capsule capsule;
+        CollisionPrimitive::Box box;
         HullInput hullInput;
+        HeightfieldInput heightfieldInput;
+        TriangleMeshInput triangleMeshInput;
     };
 };
 
@@ -28,6 +51,55 @@ struct SourceCollisionObject {
     RigidBodyFrictionData friction;
 };
 
+// Hulls with more faces or vertices than these limits are replaced at
+// processing time by a hull built from a subset of their face planes.
+// The simplified hull always contains the original one.
+struct HullSimplificationConfig {
+    uint32_t maxFaces;
+    uint32_t maxVertices;
+};
+
+// Per collision object, summed over its hull primitives
+struct HullSimplificationReport {
+    // Largest distance from the simplified hulls to the original hulls
+    float maxError;
+    // Ratio of SAT work before and after simplification for the object
+    // colliding with itself
+    float estimatedSATSpeedup;
+    uint32_t numFacesBefore;
+    uint32_t numFacesAfter;
+    uint32_t numVertsBefore;
+    uint32_t numVertsAfter;
+};
+
+// Grayscale height image, ready to be turned into a heightfield primitive.
+// Samples are 16 bit, with 8 bit images widened so that white is 65535
+// either way.
+struct HeightfieldImage {
+    HeapArray<uint16_t> samples;
+    uint32_t numRows;
+    uint32_t numCols;
+
+    // Binary (P5) PGM file with 8 or 16 bit samples. Row 0 of the image is
+    // the +Y edge of the heightfield, so the image reads like a top down
+    // view.
+    static Optional<HeightfieldImage> loadPGM(const char *path);
+
+    // Quantizes row major float heights, returning the range covered in
+    // *out_min_height and *out_max_height
+    static HeightfieldImage quantize(Span<const float> heights,
+                                     uint32_t num_rows,
+                                     uint32_t num_cols,
+                                     float *out_min_height,
+                                     float *out_max_height);
+
+    // Maps sample 0 to min_height and 65535 to max_height. The returned
+    // primitive points into samples, so the image must outlive processing.
+    SourceCollisionPrimitive makePrimitive(float cell_size,
+                                           float min_height,
+                                           float max_height) const;
+};
+
 struct RigidBodyAssets {
     struct HullData {
         geo::HalfEdge *halfEdges;
@@ -40,6 +112,15 @@ struct RigidBodyAssets {
         uint32_t numVerts;
     } hullData;
 
+    // Samples of all heightfield primitives
+    uint16_t *heightfieldSamples;
+    uint32_t numHeightfieldSamples;
+
+    // BVHs of all triangle mesh primitives, each a MeshBVHBuilder::build
+    // blob
+    uint8_t *meshBVHData;
+    uint64_t numMeshBVHBytes;
+
     // Per Primitive Data
     CollisionPrimitive *primitives;
     math::AABB *primitiveAABBs;
@@ -54,13 +135,31 @@ struct RigidBodyAssets {
     uint32_t totalNumPrimitives;
     uint32_t numObjs;
 
+    // If simplify_cfg is set, hulls are simplified after being built and
+    // out_simplify_reports (if set) receives one report per collision
+    // object.
     static void * processRigidBodyAssets(
         Span<const imp::SourceMesh> convex_hull_meshes,
         Span<const SourceCollisionObject> collision_objs,
         bool build_convex_hulls,
         StackAlloc &tmp_alloc,
         RigidBodyAssets *out_assets,
-        CountT *out_num_bytes);
+        CountT *out_num_bytes,
+        const HullSimplificationConfig *simplify_cfg = nullptr,
+        HullSimplificationReport *out_simplify_reports = nullptr);
+
+    // Builds hulls and mass properties on num_threads threads (0 = one per
+    // hardware thread), each with its own scratch allocator. Produces the
+    // same blob as the serial version.
+    static void * processRigidBodyAssets(
+        Span<const imp::SourceMesh> convex_hull_meshes,
+        Span<const SourceCollisionObject> collision_objs,
+        bool build_convex_hulls,
+        CountT num_threads,
+        RigidBodyAssets *out_assets,
+        CountT *out_num_bytes,
+        const HullSimplificationConfig *simplify_cfg = nullptr,
+        HullSimplificationReport *out_simplify_reports = nullptr);
 };
 
 struct MeshBVHBuilder {
@@ -71,4 +170,77 @@ struct MeshBVHBuilder {
         CountT *out_num_bytes);
 };
 
+// Read-only, copy-on-write memory mapping of a cooked asset file. Assets
+// loaded from the cache point into the mapping, so it must outlive them.
+class CookedAssetMapping {
+public:
+    CookedAssetMapping();
+    CookedAssetMapping(const CookedAssetMapping &) = delete;
+    CookedAssetMapping(CookedAssetMapping &&o);
+    ~CookedAssetMapping();
+
+    CookedAssetMapping & operator=(CookedAssetMapping &&o);
+
+    inline bool valid() const { return base_ != nullptr; }
+
+private:
+    CookedAssetMapping(void *base, uint64_t num_bytes);
+
+    void *base_;
+    uint64_t numBytes_;
+
+friend struct CookedAssetCache;
+};
+
+// On-disk cache for the blobs returned by
+// RigidBodyAssets::processRigidBodyAssets and MeshBVHBuilder::build.
+// Cache files hold the blob with internal pointers stored as offsets,
+// tagged with a format version and a hash of the source data they were
+// cooked from. Loading maps the file and fixes the pointers back up in
+// place, with no other copies or processing. The loaded RigidBodyAssets can
+// be passed straight to PhysicsLoader::loadRigidBodies, which copies out of
+// them, so the mapping can be released once it returns.
+struct CookedAssetCache {
+    static constexpr inline uint32_t formatVersion = 4;
+
+    // Hashes every input processRigidBodyAssets reads
+    static uint64_t hashRigidBodySources(
+        Span<const imp::SourceMesh> convex_hull_meshes,
+        Span<const SourceCollisionObject> collision_objs,
+        bool build_convex_hulls,
+        const HullSimplificationConfig *simplify_cfg = nullptr);
+
+    // Hashes every input MeshBVHBuilder::build reads
+    static uint64_t hashMeshBVHSources(
+        Span<const imp::SourceMesh> src_meshes);
+
+    // blob and num_blob_bytes are the return value and out_num_bytes of
+    // processRigidBodyAssets, which assets must point into
+    static bool saveRigidBodyAssets(
+        const char *path,
+        uint64_t source_hash,
+        const RigidBodyAssets &assets,
+        const void *blob,
+        CountT num_blob_bytes);
+
+    static bool saveMeshBVH(
+        const char *path,
+        uint64_t source_hash,
+        const MeshBVH &bvh,
+        const void *blob,
+        CountT num_blob_bytes);
+
+    // Return an invalid mapping if path doesn't exist, or was written for
+    // different sources or by a different version of the cache format
+    static CookedAssetMapping loadRigidBodyAssets(
+        const char *path,
+        uint64_t source_hash,
+        RigidBodyAssets *out_assets);
+
+    static CookedAssetMapping loadMeshBVH(
+        const char *path,
+        uint64_t source_hash,
+        MeshBVH *out_bvh);
+};
+
 }
@@ -23,8 +23,20 @@ inline int32_t sampleI32(RandKey k, int32_t a, int32_t b);
 inline int32_t sampleI32Biased(RandKey k, int32_t a, int32_t b);
 inline float sampleUniform(RandKey k);
 inline math::Vector2 sample2xUniform(RandKey k);
+inline float sampleNormal(RandKey k);
 inline float bitsToFloat01(uint32_t rand_bits);
 
+#ifndef MADRONA_GPU_MODE
+// Bulk sampling on the CPU. Element i of the output is exactly the value the
+// matching scalar function returns for split_i(src, first_idx + i), so these
+// can replace a loop over split_i without changing results. Counters are
+// evaluated 16 (AVX-512) or 8 (AVX2) at a time when available.
+void splitN(RandKey src, RandKey *out, CountT n, uint32_t first_idx = 0);
+void fillUniform(RandKey src, float *out, CountT n, uint32_t first_idx = 0);
+void fillNormal(RandKey src, float *out, CountT n, uint32_t first_idx = 0);
+void fillI32Range(RandKey src, int32_t *out, CountT n, int32_t a, int32_t b,
+                  uint32_t first_idx = 0);
+#endif
 
 }
 
@@ -37,9 +49,17 @@ public:
     inline int32_t sampleI32(int32_t a, int32_t b);
     inline int32_t sampleI32Biased(int32_t a, int32_t b);
     inline float sampleUniform();
+    inline float sampleNormal();
 
     inline RandKey randKey();
 
+#ifndef MADRONA_GPU_MODE
+    // Equivalent to n calls to the matching single sample function.
+    inline void fillUniform(float *out, CountT n);
+    inline void fillNormal(float *out, CountT n);
+    inline void fillI32Range(int32_t *out, CountT n, int32_t a, int32_t b);
+#endif
+
     RNG(const RNG &) = delete;
     RNG(RNG &&) = default;
     RNG & operator=(const RNG &) = delete;
@@ -179,6 +179,17 @@ math::Vector2 sample2xUniform(RandKey k)
     };
 }
 
+float sampleNormal(RandKey k)
+{
+    // Box-Muller, keeping only the cosine output. 1 - u maps [0, 1) to
+    // (0, 1] so the log stays finite.
+    float u1 = 1.f - bitsToFloat01(k.a);
+    float u2 = bitsToFloat01(k.b);
+
+    float r = sqrtf(-2.f * logf(u1));
+    return r * cosf(math::pi_m2 * u2);
+}
+
 float bitsToFloat01(uint32_t rand_bits)
 {
     // This implementation (and the one commented out below), generate random
@@ -241,11 +252,37 @@ float RNG::sampleUniform()
     return rand::sampleUniform(sample_k);
 }
 
+float RNG::sampleNormal()
+{
+    RandKey sample_k = advance();
+    return rand::sampleNormal(sample_k);
+}
+
 RandKey RNG::randKey()
 {
     return advance();
 }
 
+#ifndef MADRONA_GPU_MODE
+void RNG::fillUniform(float *out, CountT n)
+{
+    rand::fillUniform(k_, out, n, count_);
+    count_ += (uint32_t)n;
+}
+
+void RNG::fillNormal(float *out, CountT n)
+{
+    rand::fillNormal(k_, out, n, count_);
+    count_ += (uint32_t)n;
+}
+
+void RNG::fillI32Range(int32_t *out, CountT n, int32_t a, int32_t b)
+{
+    rand::fillI32Range(k_, out, n, a, b, count_);
+    count_ += (uint32_t)n;
+}
+#endif
+
 RandKey RNG::advance()
 {
     RandKey sample_k = rand::split_i(k_, count_);
@@ -12,6 +12,7 @@
 namespace madrona::render {
 
 struct RenderContext;
+class CPURaycaster;
 
 // This encapsulates all rendering operations that the engine could require
 class RenderManager {
@@ -30,6 +31,12 @@ public:
         ExecMode execMode;
 
         VoxelConfig voxelCfg;
+
+        // Render depth and instance IDs with the multithreaded CPU ray
+        // caster instead of Vulkan (CPU backend only). render_backend and
+        // dev may be null, there is no RGB output, lighting is ignored and
+        // renderContext() must not be used.
+        bool cpuRaycast = false;
     };
 
     RenderManager(APIBackend *render_backend,
@@ -58,8 +65,13 @@ public:
     const uint8_t * batchRendererRGBOut() const;
     const float * batchRendererDepthOut() const;
 
+    // Per pixel index of the hit instance within its world, -1 for no hit.
+    // Only produced by the CPU ray caster, nullptr otherwise.
+    const int32_t * batchRendererInstanceIDOut() const;
+
 private:
     std::unique_ptr<RenderContext> rctx_;
+    std::unique_ptr<CPURaycaster> cpuRaycaster_;
 };
 
 }
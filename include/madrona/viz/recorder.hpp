@@ -1,30 +1,99 @@
 #pragma once
 
 #include <madrona/exec_mode.hpp>
-#include <madrona/viz/system.hpp>
+#include <madrona/types.hpp>
+
+#include <memory>
+
+namespace madrona::render {
+struct RenderECSBridge;
+struct InstanceData;
+struct PerspectiveCameraData;
+}
 
 namespace madrona::viz {
 
+// Streams the instance and camera transforms the RenderingSystem exports
+// every step to a file, so recordings of any length can be replayed.
+//
+// record() quantizes the instances and views each world exported into a
+// chunk buffer, packed so that only the exported counts take up space.
+// Full chunks are handed to a background thread, which delta encodes every
+// value against the same slot in the previous step, compresses the deltas
+// and appends the chunk to the file. The first step of each chunk is
+// encoded against zeros so chunks decode independently, and an index of
+// chunk offsets is written at the end of the file for seeking.
+//
+// Memory use doesn't grow with the length of the recording: at most
+// (maxQueuedChunks + 1) * stepsPerChunk steps are buffered, at 44 bytes per
+// exported instance and 40 bytes per exported view, plus one step of every
+// world at maxInstancesPerWorld / maxViewsPerWorld capacity that deltas are
+// taken against. record() blocks while maxQueuedChunks chunks are waiting
+// to be written.
+//
+// Only the CPU backend is supported: the bridge's per world ranges must
+// be host memory (see RenderECSBridge::numInstancesPerWorldCPU).
 class Recorder {
 public:
     struct Config {
-        uint32_t renderWidth;
-        uint32_t renderHeight;
+        // Bridge the RenderingSystem writes into, i.e.
+        // RenderManager::bridge()
+        const render::RenderECSBridge *bridge;
         uint32_t numWorlds;
-        uint32_t maxViewsPerWorld;
-        uint32_t maxInstancesPerWorld;
-        uint32_t maxEpisodes;
-        uint32_t maxStepsPerEpisode;
         ExecMode execMode;
+
+        const char *outputPath;
+
+        // Number of steps of all worlds per compressed chunk
+        uint32_t stepsPerChunk = 64;
+        uint32_t maxQueuedChunks = 4;
+
+        // Positions are rounded to multiples of this, rotation components
+        // are always stored with 15 bits of precision. Scales and camera
+        // parameters are stored losslessly.
+        float positionQuantum = 1.f / 1024.f;
     };
 
     Recorder(const Config &cfg);
     Recorder(Recorder &&o);
     ~Recorder();
 
-    const RenderECSBridge * bridge() const;
+    // Records the step the ECS just finished. episode_dones[i] marks that
+    // world i's episode ended on this step; it may be nullptr.
+    void record(const bool *episode_dones = nullptr);
+
+    // Writes any buffered steps and the chunk index, and closes the file.
+    // Called by the destructor if needed.
+    void finish();
+
+    uint64_t numRecordedSteps() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+// Random access reads of a file written by Recorder. Only the chunk
+// containing the current step is kept decoded in memory.
+class RecordingReader {
+public:
+    RecordingReader(const char *path);
+    RecordingReader(RecordingReader &&o);
+    ~RecordingReader();
+
+    uint32_t numWorlds() const;
+    uint64_t numSteps() const;
+
+    // Decodes the given step, reading a new chunk from disk if needed
+    void loadStep(uint64_t step);
 
-    void record();
+    // Data of the last loaded step. Values are reconstructed from their
+    // quantized form, worldIDX is set to world_idx.
+    uint32_t numInstances(uint32_t world_idx) const;
+    const render::InstanceData * instances(uint32_t world_idx) const;
+    uint32_t numViews(uint32_t world_idx) const;
+    const render::PerspectiveCameraData * views(uint32_t world_idx) const;
+    bool episodeDone(uint32_t world_idx) const;
 
 private:
     struct Impl;
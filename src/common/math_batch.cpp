@@ -0,0 +1,428 @@
+#include <madrona/math_batch.hpp>
+
+#include <cstring>
+
+#if defined(MADRONA_X64) && defined(__AVX2__)
+#define MADRONA_MATH_BATCH_AVX2 1
+#include <immintrin.h>
+#elif defined(MADRONA_ARM) && defined(__ARM_NEON)
+#define MADRONA_MATH_BATCH_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace madrona::math {
+
+/*
+The kernels are written once against a lane type F. float is the scalar
+fallback and handles the tail of every batch; Float8 (AVX2) and Float4
+(NEON) only need the handful of operations below. Everything is plain
+mul / add / sub / min / max, so no lane type needs special casing in the
+kernels themselves.
+*/
+
+namespace {
+
+template <typename F>
+inline F loadLanes(const float *p);
+
+template <>
+inline float loadLanes<float>(const float *p)
+{
+    return *p;
+}
+
+inline void storeLanes(float *p, float v)
+{
+    *p = v;
+}
+
+inline float laneMin(float a, float b)
+{
+    return fminf(a, b);
+}
+
+inline float laneMax(float a, float b)
+{
+    return fmaxf(a, b);
+}
+
+#if defined(MADRONA_MATH_BATCH_AVX2)
+
+struct Float8 {
+    static constexpr CountT width = 8;
+
+    __m256 v;
+
+    Float8() = default;
+    Float8(__m256 o) : v(o) {}
+    Float8(float f) : v(_mm256_set1_ps(f)) {}
+};
+
+inline Float8 operator+(Float8 a, Float8 b)
+{
+    return _mm256_add_ps(a.v, b.v);
+}
+
+inline Float8 operator-(Float8 a, Float8 b)
+{
+    return _mm256_sub_ps(a.v, b.v);
+}
+
+inline Float8 operator*(Float8 a, Float8 b)
+{
+    return _mm256_mul_ps(a.v, b.v);
+}
+
+inline Float8 laneMin(Float8 a, Float8 b)
+{
+    return _mm256_min_ps(a.v, b.v);
+}
+
+inline Float8 laneMax(Float8 a, Float8 b)
+{
+    return _mm256_max_ps(a.v, b.v);
+}
+
+template <>
+inline Float8 loadLanes<Float8>(const float *p)
+{
+    return _mm256_loadu_ps(p);
+}
+
+inline void storeLanes(float *p, Float8 v)
+{
+    _mm256_storeu_ps(p, v.v);
+}
+
+using FloatN = Float8;
+
+#elif defined(MADRONA_MATH_BATCH_NEON)
+
+struct Float4 {
+    static constexpr CountT width = 4;
+
+    float32x4_t v;
+
+    Float4() = default;
+    Float4(float32x4_t o) : v(o) {}
+    Float4(float f) : v(vdupq_n_f32(f)) {}
+};
+
+inline Float4 operator+(Float4 a, Float4 b)
+{
+    return vaddq_f32(a.v, b.v);
+}
+
+inline Float4 operator-(Float4 a, Float4 b)
+{
+    return vsubq_f32(a.v, b.v);
+}
+
+inline Float4 operator*(Float4 a, Float4 b)
+{
+    return vmulq_f32(a.v, b.v);
+}
+
+inline Float4 laneMin(Float4 a, Float4 b)
+{
+    return vminq_f32(a.v, b.v);
+}
+
+inline Float4 laneMax(Float4 a, Float4 b)
+{
+    return vmaxq_f32(a.v, b.v);
+}
+
+template <>
+inline Float4 loadLanes<Float4>(const float *p)
+{
+    return vld1q_f32(p);
+}
+
+inline void storeLanes(float *p, Float4 v)
+{
+    vst1q_f32(p, v.v);
+}
+
+using FloatN = Float4;
+
+#endif
+
+template <typename F>
+struct V3 {
+    F x, y, z;
+};
+
+template <typename F>
+struct Q4 {
+    F w, x, y, z;
+};
+
+static_assert(sizeof(Mat3x4) == 12 * sizeof(float));
+
+// Writes lane j of the 12 column major elements to out[j]
+inline void storeMat3x4Lanes(Mat3x4 *out, const float (&elems)[12])
+{
+    memcpy(out, elems, sizeof(Mat3x4));
+}
+
+#if defined(MADRONA_MATH_BATCH_AVX2)
+inline void storeMat3x4Lanes(Mat3x4 *out, const Float8 (&elems)[12])
+{
+    float *dst = (float *)out;
+
+    // Transpose each group of 4 elements into 8 4-float rows: after the
+    // unpacks and shuffles, the low and high 128 bits of row j hold lanes j
+    // and j + 4.
+    for (CountT g = 0; g < 3; g++) {
+        __m256 e0 = elems[g * 4].v;
+        __m256 e1 = elems[g * 4 + 1].v;
+        __m256 e2 = elems[g * 4 + 2].v;
+        __m256 e3 = elems[g * 4 + 3].v;
+
+        __m256 t0 = _mm256_unpacklo_ps(e0, e1);
+        __m256 t1 = _mm256_unpackhi_ps(e0, e1);
+        __m256 t2 = _mm256_unpacklo_ps(e2, e3);
+        __m256 t3 = _mm256_unpackhi_ps(e2, e3);
+
+        __m256 rows[4] = {
+            _mm256_shuffle_ps(t0, t2, 0x44),
+            _mm256_shuffle_ps(t0, t2, 0xEE),
+            _mm256_shuffle_ps(t1, t3, 0x44),
+            _mm256_shuffle_ps(t1, t3, 0xEE),
+        };
+
+        for (CountT j = 0; j < 4; j++) {
+            _mm_storeu_ps(dst + j * 12 + g * 4,
+                          _mm256_castps256_ps128(rows[j]));
+            _mm_storeu_ps(dst + (j + 4) * 12 + g * 4,
+                          _mm256_extractf128_ps(rows[j], 1));
+        }
+    }
+}
+#elif defined(MADRONA_MATH_BATCH_NEON)
+inline void storeMat3x4Lanes(Mat3x4 *out, const Float4 (&elems)[12])
+{
+    float tmp[12][4];
+    for (CountT e = 0; e < 12; e++) {
+        vst1q_f32(tmp[e], elems[e].v);
+    }
+
+    float *dst = (float *)out;
+    for (CountT j = 0; j < 4; j++) {
+        for (CountT e = 0; e < 12; e++) {
+            dst[j * 12 + e] = tmp[e][j];
+        }
+    }
+}
+#endif
+
+template <typename F>
+inline V3<F> loadV3(Vector3SoA v, CountT i)
+{
+    return {
+        loadLanes<F>(v.x + i),
+        loadLanes<F>(v.y + i),
+        loadLanes<F>(v.z + i),
+    };
+}
+
+template <typename F>
+inline void storeV3(Vector3SoA v, CountT i, V3<F> o)
+{
+    storeLanes(v.x + i, o.x);
+    storeLanes(v.y + i, o.y);
+    storeLanes(v.z + i, o.z);
+}
+
+template <typename F>
+inline Q4<F> loadQuat(QuatSoA q, CountT i)
+{
+    return {
+        loadLanes<F>(q.w + i),
+        loadLanes<F>(q.x + i),
+        loadLanes<F>(q.y + i),
+        loadLanes<F>(q.z + i),
+    };
+}
+
+template <typename F>
+inline V3<F> cross(V3<F> a, V3<F> b)
+{
+    return {
+        a.y * b.z - a.z * b.y,
+        a.z * b.x - a.x * b.z,
+        a.x * b.y - a.y * b.x,
+    };
+}
+
+// Quat::rotateVec
+template <typename F>
+inline V3<F> rotate(Q4<F> q, V3<F> v)
+{
+    V3<F> pure { q.x, q.y, q.z };
+
+    V3<F> pure_x_v = cross(pure, v);
+    V3<F> pure_x_pure_x_v = cross(pure, pure_x_v);
+
+    F two(2.f);
+    return {
+        v.x + two * ((pure_x_v.x * q.w) + pure_x_pure_x_v.x),
+        v.y + two * ((pure_x_v.y * q.w) + pure_x_pure_x_v.y),
+        v.z + two * ((pure_x_v.z * q.w) + pure_x_pure_x_v.z),
+    };
+}
+
+// Columns of Mat3x3::fromRS, the upper 3x3 of Mat3x4::fromTRS
+template <typename F>
+inline void rotationScaleCols(Q4<F> r, V3<F> s, V3<F> *cols)
+{
+    F x2 = r.x * r.x;
+    F y2 = r.y * r.y;
+    F z2 = r.z * r.z;
+    F xz = r.x * r.z;
+    F xy = r.x * r.y;
+    F yz = r.y * r.z;
+    F wx = r.w * r.x;
+    F wy = r.w * r.y;
+    F wz = r.w * r.z;
+
+    F two(2.f);
+    V3<F> ds { two * s.x, two * s.y, two * s.z };
+
+    cols[0] = {
+        s.x - ds.x * (y2 + z2),
+        ds.x * (xy + wz),
+        ds.x * (xz - wy),
+    };
+    cols[1] = {
+        ds.y * (xy - wz),
+        s.y - ds.y * (x2 + z2),
+        ds.y * (yz + wx),
+    };
+    cols[2] = {
+        ds.z * (xz + wy),
+        ds.z * (yz - wx),
+        s.z - ds.z * (x2 + y2),
+    };
+}
+
+template <typename F>
+inline void rotateVectorsBlock(QuatSoA rot, Vector3SoA v, Vector3SoA out,
+                               CountT i)
+{
+    storeV3(out, i, rotate(loadQuat<F>(rot, i), loadV3<F>(v, i)));
+}
+
+template <typename F>
+inline void composeTRSBlock(Vector3SoA t, QuatSoA r, Vector3SoA s,
+                            Mat3x4 *out, CountT i)
+{
+    V3<F> cols[4];
+    rotationScaleCols(loadQuat<F>(r, i), loadV3<F>(s, i), cols);
+    cols[3] = loadV3<F>(t, i);
+
+    F elems[12];
+    for (CountT c = 0; c < 4; c++) {
+        elems[c * 3] = cols[c].x;
+        elems[c * 3 + 1] = cols[c].y;
+        elems[c * 3 + 2] = cols[c].z;
+    }
+
+    storeMat3x4Lanes(out + i, elems);
+}
+
+// AABB::applyTRS, RTCD page 86. min / max replace the scalar version's
+// e < f branch, which picks the same values for non NaN inputs.
+template <typename F>
+inline void transformAABBsBlock(AABBSoA aabbs, Vector3SoA t, QuatSoA r,
+                                Vector3SoA s, AABBSoA out, CountT i)
+{
+    V3<F> cols[3];
+    rotationScaleCols(loadQuat<F>(r, i), loadV3<F>(s, i), cols);
+
+    V3<F> p_min = loadV3<F>(aabbs.pMin, i);
+    V3<F> p_max = loadV3<F>(aabbs.pMax, i);
+    V3<F> tr = loadV3<F>(t, i);
+
+    auto axis = [&](F t_i, F c0, F c1, F c2, F *out_min, F *out_max) {
+        F lo = t_i, hi = t_i;
+
+        F e = c0 * p_min.x, f = c0 * p_max.x;
+        lo = lo + laneMin(e, f);
+        hi = hi + laneMax(e, f);
+
+        e = c1 * p_min.y;
+        f = c1 * p_max.y;
+        lo = lo + laneMin(e, f);
+        hi = hi + laneMax(e, f);
+
+        e = c2 * p_min.z;
+        f = c2 * p_max.z;
+        lo = lo + laneMin(e, f);
+        hi = hi + laneMax(e, f);
+
+        *out_min = lo;
+        *out_max = hi;
+    };
+
+    V3<F> o_min, o_max;
+    axis(tr.x, cols[0].x, cols[1].x, cols[2].x, &o_min.x, &o_max.x);
+    axis(tr.y, cols[0].y, cols[1].y, cols[2].y, &o_min.y, &o_max.y);
+    axis(tr.z, cols[0].z, cols[1].z, cols[2].z, &o_min.z, &o_max.z);
+
+    storeV3(out.pMin, i, o_min);
+    storeV3(out.pMax, i, o_max);
+}
+
+}
+
+void batchRotateVectors(QuatSoA rot, Vector3SoA v, Vector3SoA out,
+                        CountT n)
+{
+    CountT i = 0;
+
+#if defined(MADRONA_MATH_BATCH_AVX2) || defined(MADRONA_MATH_BATCH_NEON)
+    for (; i + FloatN::width <= n; i += FloatN::width) {
+        rotateVectorsBlock<FloatN>(rot, v, out, i);
+    }
+#endif
+
+    for (; i < n; i++) {
+        rotateVectorsBlock<float>(rot, v, out, i);
+    }
+}
+
+void batchComposeTRS(Vector3SoA t, QuatSoA r, Vector3SoA s, Mat3x4 *out,
+                     CountT n)
+{
+    CountT i = 0;
+
+#if defined(MADRONA_MATH_BATCH_AVX2) || defined(MADRONA_MATH_BATCH_NEON)
+    for (; i + FloatN::width <= n; i += FloatN::width) {
+        composeTRSBlock<FloatN>(t, r, s, out, i);
+    }
+#endif
+
+    for (; i < n; i++) {
+        composeTRSBlock<float>(t, r, s, out, i);
+    }
+}
+
+void batchTransformAABBs(AABBSoA aabbs, Vector3SoA t, QuatSoA r,
+                         Vector3SoA s, AABBSoA out, CountT n)
+{
+    CountT i = 0;
+
+#if defined(MADRONA_MATH_BATCH_AVX2) || defined(MADRONA_MATH_BATCH_NEON)
+    for (; i + FloatN::width <= n; i += FloatN::width) {
+        transformAABBsBlock<FloatN>(aabbs, t, r, s, out, i);
+    }
+#endif
+
+    for (; i < n; i++) {
+        transformAABBsBlock<float>(aabbs, t, r, s, out, i);
+    }
+}
+
+}
@@ -102,6 +102,794 @@ void Navmesh::PathFindQueue::decreaseCost(uint32_t poly, float cost)
     heapMoveUp(cur_idx, poly, cost, heap, heapIndex, costs);
 }
 
+// Tests whether the XY projection of abc contains p, and if so returns the
+// height of the triangle's plane at p.
+static inline bool triContainsXY(Vector3 a, Vector3 b, Vector3 c, Vector3 p,
+                                 float *out_height)
+{
+    auto area2 = [](Vector3 u, Vector3 v, Vector3 w) {
+        return (v.x - u.x) * (w.y - u.y) - (v.y - u.y) * (w.x - u.x);
+    };
+
+    float total = area2(a, b, c);
+
+    // Vertical triangles can't be stood on
+    if (fabsf(total) < 1e-12f) {
+        return false;
+    }
+
+    float inv_total = 1.f / total;
+    float u = area2(b, c, p) * inv_total;
+    float v = area2(c, a, p) * inv_total;
+    float w = 1.f - u - v;
+
+    constexpr float eps = -1e-6f;
+    if (u < eps || v < eps || w < eps) {
+        return false;
+    }
+
+    *out_height = u * a.z + v * b.z + w * c.z;
+    return true;
+}
+
+// Real-Time Collision Detection 5.1.5
+static inline Vector3 closestPointOnTri(Vector3 p, Vector3 a, Vector3 b,
+                                        Vector3 c)
+{
+    Vector3 ab = b - a;
+    Vector3 ac = c - a;
+    Vector3 ap = p - a;
+
+    float d1 = dot(ab, ap);
+    float d2 = dot(ac, ap);
+    if (d1 <= 0.f && d2 <= 0.f) {
+        return a;
+    }
+
+    Vector3 bp = p - b;
+    float d3 = dot(ab, bp);
+    float d4 = dot(ac, bp);
+    if (d3 >= 0.f && d4 <= d3) {
+        return b;
+    }
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f) {
+        return a + ab * (d1 / (d1 - d3));
+    }
+
+    Vector3 cp = p - c;
+    float d5 = dot(ab, cp);
+    float d6 = dot(ac, cp);
+    if (d6 >= 0.f && d5 <= d6) {
+        return c;
+    }
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f) {
+        return a + ac * (d2 / (d2 - d6));
+    }
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f) {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    float denom = 1.f / (va + vb + vc);
+    float v = vb * denom;
+    float w = vc * denom;
+    return a + ab * v + ac * w;
+}
+
+uint32_t Navmesh::findPoly(Vector3 pos)
+{
+    if (numTris == 0) {
+        return sentinel;
+    }
+
+    uint32_t stack[TriBVH::maxDepth];
+    CountT stack_size = 0;
+    stack[stack_size++] = 0;
+
+    uint32_t closest_poly = sentinel;
+    float closest_dist = FLT_MAX;
+
+    while (stack_size > 0) {
+        const TriBVH::Node &node = triBVH.nodes[stack[--stack_size]];
+        const AABB &bounds = node.bounds;
+
+        if (pos.x < bounds.pMin.x || pos.x > bounds.pMax.x ||
+                pos.y < bounds.pMin.y || pos.y > bounds.pMax.y) {
+            continue;
+        }
+
+        // Vertical distance to the node can't beat the current closest
+        float node_dist = fmaxf(fmaxf(bounds.pMin.z - pos.z, 0.f),
+                                pos.z - bounds.pMax.z);
+        if (node_dist >= closest_dist) {
+            continue;
+        }
+
+        if (node.numTris == 0) {
+            stack[stack_size++] = node.childOrFirstTri;
+            stack[stack_size++] = node.childOrFirstTri + 1;
+            continue;
+        }
+
+        for (uint32_t i = 0; i < node.numTris; i++) {
+            uint32_t tri = triBVH.triIndices[node.childOrFirstTri + i];
+
+            Vector3 a, b, c;
+            getTriangleVertices(tri, &a, &b, &c);
+
+            float height;
+            if (!triContainsXY(a, b, c, pos, &height)) {
+                continue;
+            }
+
+            float dist = fabsf(height - pos.z);
+            if (dist < closest_dist) {
+                closest_dist = dist;
+                closest_poly = tri;
+            }
+        }
+    }
+
+    return closest_poly;
+}
+
+Vector3 Navmesh::closestPointOnNavmesh(Vector3 pos, uint32_t *out_poly)
+{
+    if (numTris == 0) {
+        if (out_poly != nullptr) {
+            *out_poly = sentinel;
+        }
+        return pos;
+    }
+
+    uint32_t stack[TriBVH::maxDepth];
+    CountT stack_size = 0;
+    stack[stack_size++] = 0;
+
+    AABB pos_aabb = AABB::point(pos);
+
+    Vector3 closest_point = pos;
+    uint32_t closest_poly = sentinel;
+    float closest_dist2 = FLT_MAX;
+
+    while (stack_size > 0) {
+        const TriBVH::Node &node = triBVH.nodes[stack[--stack_size]];
+        if (node.bounds.distance2(pos_aabb) >= closest_dist2) {
+            continue;
+        }
+
+        if (node.numTris == 0) {
+            // Visit the nearer child first so it tightens the bound before
+            // the other is tested
+            uint32_t left = node.childOrFirstTri;
+            uint32_t right = left + 1;
+            float left_dist2 = triBVH.nodes[left].bounds.distance2(pos_aabb);
+            float right_dist2 =
+                triBVH.nodes[right].bounds.distance2(pos_aabb);
+
+            if (left_dist2 < right_dist2) {
+                stack[stack_size++] = right;
+                stack[stack_size++] = left;
+            } else {
+                stack[stack_size++] = left;
+                stack[stack_size++] = right;
+            }
+            continue;
+        }
+
+        for (uint32_t i = 0; i < node.numTris; i++) {
+            uint32_t tri = triBVH.triIndices[node.childOrFirstTri + i];
+
+            Vector3 a, b, c;
+            getTriangleVertices(tri, &a, &b, &c);
+
+            Vector3 tri_point = closestPointOnTri(pos, a, b, c);
+            float dist2 = tri_point.distance2(pos);
+            if (dist2 < closest_dist2) {
+                closest_dist2 = dist2;
+                closest_point = tri_point;
+                closest_poly = tri;
+            }
+        }
+    }
+
+    if (out_poly != nullptr) {
+        *out_poly = closest_poly;
+    }
+
+    return closest_point;
+}
+
+void Navmesh::findPolys(const Vector3 *positions,
+                        uint32_t *in_out_polys,
+                        CountT num_positions)
+{
+    for (CountT i = 0; i < num_positions; i++) {
+        Vector3 pos = positions[i];
+        uint32_t prev_poly = in_out_polys[i];
+
+        uint32_t found_poly = sentinel;
+        if (prev_poly != sentinel) {
+            float height;
+
+            Vector3 a, b, c;
+            getTriangleVertices(prev_poly, &a, &b, &c);
+            if (triContainsXY(a, b, c, pos, &height)) {
+                found_poly = prev_poly;
+            }
+
+            for (CountT j = 0; found_poly == sentinel && j < 3; j++) {
+                uint32_t adjacent = triAdjacency[3 * prev_poly + j];
+                if (adjacent == sentinel) {
+                    continue;
+                }
+
+                getTriangleVertices(adjacent, &a, &b, &c);
+                if (triContainsXY(a, b, c, pos, &height)) {
+                    found_poly = adjacent;
+                }
+            }
+        }
+
+        if (found_poly == sentinel) {
+            found_poly = findPoly(pos);
+        }
+
+        in_out_polys[i] = found_poly;
+    }
+}
+
+void Navmesh::closestPointsOnNavmesh(const Vector3 *positions,
+                                     Vector3 *out_points,
+                                     uint32_t *out_polys,
+                                     CountT num_positions)
+{
+    for (CountT i = 0; i < num_positions; i++) {
+        out_points[i] = closestPointOnNavmesh(positions[i],
+            out_polys == nullptr ? nullptr : &out_polys[i]);
+    }
+}
+
+// Starts a new query on generation stamped state. Generation 0 is reserved
+// for never visited entries, so the stamps only need to be cleared when the
+// counter wraps.
+static inline void pathFindNextGeneration(uint32_t *generation,
+                                          uint32_t *stamps,
+                                          CountT num_stamps)
+{
+    if (++*generation == 0) {
+        utils::zeroN<uint32_t>(stamps, num_stamps);
+        *generation = 1;
+    }
+}
+
+// Marks node as touched by the current query, resetting the state that
+// would otherwise have been cleared up front.
+static inline void pathFindTouch(Navmesh::PathFindState *state, uint32_t node)
+{
+    if (state->visitGenerations[node] == state->generation) {
+        return;
+    }
+
+    state->visitGenerations[node] = state->generation;
+    state->costs[node] = FLT_MAX;
+    state->parents[node] = Navmesh::sentinel;
+    state->heapIndex[node] = Navmesh::sentinel;
+}
+
+static inline bool pathFindVisited(const Navmesh::PathFindState *state,
+                                   uint32_t node)
+{
+    return state->visitGenerations[node] == state->generation &&
+        state->costs[node] != FLT_MAX;
+}
+
+static inline void pathFindRelax(Navmesh::PathFindQueue &prio_queue,
+                                 Navmesh::PathFindState *state,
+                                 uint32_t node,
+                                 uint32_t parent,
+                                 float cost,
+                                 float heuristic)
+{
+    pathFindTouch(state, node);
+    if (cost >= state->costs[node]) {
+        return;
+    }
+
+    state->costs[node] = cost;
+    state->parents[node] = parent;
+
+    float priority = cost + heuristic;
+    if (prio_queue.heapIndex[node] == Navmesh::sentinel) {
+        prio_queue.add(node, priority);
+    } else {
+        prio_queue.decreaseCost(node, priority);
+    }
+}
+
+// A* over the triangles accepted by filter. With goal_poly set to sentinel
+// this becomes a Dijkstra's search over every reachable accepted triangle.
+// Returns true if goal_poly was reached.
+template <typename FilterFn>
+static bool pathFindTris(Navmesh &navmesh,
+                         uint32_t start_poly,
+                         Vector3 start_pos,
+                         uint32_t goal_poly,
+                         Vector3 goal_pos,
+                         Navmesh::PathFindState *state,
+                         FilterFn &&filter)
+{
+    pathFindNextGeneration(&state->generation, state->visitGenerations,
+                           navmesh.numTris);
+
+    bool use_heuristic = goal_poly != Navmesh::sentinel;
+
+    float *costs = state->costs;
+    Vector3 *entry_points = state->entryPoints;
+
+    Navmesh::PathFindQueue prio_queue {
+        .costs = state->priorities,
+        .heap = state->heap,
+        .heapIndex = state->heapIndex,
+        .heapSize = 0,
+    };
+
+    pathFindTouch(state, start_poly);
+    entry_points[start_poly] = start_pos;
+    pathFindRelax(prio_queue, state, start_poly, Navmesh::sentinel, 0.f,
+        use_heuristic ? start_pos.distance(goal_pos) : 0.f);
+
+    while (prio_queue.heapSize > 0) {
+        uint32_t min_poly = prio_queue.removeMin();
+        if (min_poly == goal_poly) {
+            return true;
+        }
+
+        Vector3 cur_pos = entry_points[min_poly];
+        float cost_so_far = costs[min_poly];
+
+        Vector3 a, b, c;
+        navmesh.getTriangleVertices(min_poly, &a, &b, &c);
+
+        Vector3 edge_midpoints[3] = {
+            (a + b) / 2.f,
+            (b + c) / 2.f,
+            (c + a) / 2.f,
+        };
+
+        MADRONA_UNROLL
+        for (CountT i = 0; i < 3; i++) {
+            uint32_t adjacent = navmesh.triAdjacency[3 * min_poly + i];
+            if (adjacent == Navmesh::sentinel || !filter(adjacent)) {
+                continue;
+            }
+
+            Vector3 edge_midpoint = edge_midpoints[i];
+            float new_cost = cost_so_far + cur_pos.distance(edge_midpoint);
+
+            pathFindTouch(state, adjacent);
+            if (new_cost >= costs[adjacent]) {
+                continue;
+            }
+
+            entry_points[adjacent] = edge_midpoint;
+
+            // The straight line distance never overestimates the remaining
+            // cost, and is consistent with the midpoint to midpoint costs, so
+            // an expanded triangle is never improved upon later.
+            pathFindRelax(prio_queue, state, adjacent, min_poly, new_cost,
+                use_heuristic ? edge_midpoint.distance(goal_pos) : 0.f);
+        }
+    }
+
+    return false;
+}
+
+// Writes the chain of parents ending at last_node into out_path, in order,
+// and returns its length.
+static inline uint32_t pathFindWriteChain(const Navmesh::PathFindState *state,
+                                          uint32_t last_node,
+                                          uint32_t *out_path)
+{
+    uint32_t path_len = 0;
+    for (uint32_t node = last_node; node != Navmesh::sentinel;
+         node = state->parents[node]) {
+        path_len++;
+    }
+
+    uint32_t path_idx = path_len;
+    for (uint32_t node = last_node; node != Navmesh::sentinel;
+         node = state->parents[node]) {
+        out_path[--path_idx] = node;
+    }
+
+    return path_len;
+}
+
+uint32_t Navmesh::findCorridor(uint32_t start_poly,
+                               Vector3 start_pos,
+                               uint32_t goal_poly,
+                               Vector3 goal_pos,
+                               PathFindState *state,
+                               uint32_t *out_corridor,
+                               float *out_path_cost)
+{
+    bool found = pathFindTris(*this, start_poly, start_pos,
+        goal_poly, goal_pos, state, [](uint32_t) { return true; });
+
+    if (!found) {
+        return 0;
+    }
+
+    if (out_path_cost != nullptr) {
+        *out_path_cost = state->costs[goal_poly] +
+            state->entryPoints[goal_poly].distance(goal_pos);
+    }
+
+    return pathFindWriteChain(state, goal_poly, out_corridor);
+}
+
+// Twice the signed area of abc in the XY plane, positive if c is to the left
+// of the line from a to b.
+static inline float funnelArea2(Vector3 a, Vector3 b, Vector3 c)
+{
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+static inline bool funnelPointsEqual(Vector3 a, Vector3 b)
+{
+    Vector3 diff = b - a;
+    return diff.x * diff.x + diff.y * diff.y < 1e-12f;
+}
+
+CountT Navmesh::stringPull(Vector3 start_pos,
+                           Vector3 goal_pos,
+                           const uint32_t *corridor,
+                           uint32_t corridor_len,
+                           Vector3 *out_waypoints,
+                           CountT max_waypoints)
+{
+    if (corridor_len == 0 || max_waypoints == 0) {
+        return 0;
+    }
+
+    // Portal i is the edge shared by corridor[i] and corridor[i + 1], with
+    // the final portal collapsed onto the goal. Left and right are as seen
+    // travelling along the corridor.
+    auto getPortal = [&](uint32_t portal_idx, Vector3 *left, Vector3 *right) {
+        if (portal_idx == corridor_len - 1) {
+            *left = goal_pos;
+            *right = goal_pos;
+            return;
+        }
+
+        uint32_t tri = corridor[portal_idx];
+        uint32_t next = corridor[portal_idx + 1];
+
+        uint32_t edge_idx = 0;
+        while (triAdjacency[3 * tri + edge_idx] != next) {
+            edge_idx++;
+        }
+
+        Vector3 p = vertices[triIndices[3 * tri + edge_idx]];
+        Vector3 q = vertices[triIndices[3 * tri + (edge_idx + 1) % 3]];
+        Vector3 opposite = vertices[triIndices[3 * tri + (edge_idx + 2) % 3]];
+
+        // The opposite vertex is behind the portal, so q is to its left if
+        // the triangle winds counterclockwise
+        if (funnelArea2(opposite, p, q) > 0.f) {
+            *left = q;
+            *right = p;
+        } else {
+            *left = p;
+            *right = q;
+        }
+    };
+
+    CountT num_waypoints = 0;
+    out_waypoints[num_waypoints++] = start_pos;
+
+    Vector3 apex = start_pos;
+    Vector3 left = start_pos;
+    Vector3 right = start_pos;
+    uint32_t left_idx = 0;
+    uint32_t right_idx = 0;
+
+    for (uint32_t i = 0; i < corridor_len && num_waypoints < max_waypoints;
+         i++) {
+        Vector3 new_left, new_right;
+        getPortal(i, &new_left, &new_right);
+
+        // An apex lying on the portal (a start point on the edge shared with
+        // the next triangle) can't narrow the funnel in either direction, so
+        // leave the funnel closed until a portal actually opens it.
+        if (funnelPointsEqual(apex, left) && funnelPointsEqual(apex, right) &&
+                !funnelPointsEqual(apex, new_left) &&
+                !funnelPointsEqual(apex, new_right) &&
+                fabsf(funnelArea2(apex, new_left, new_right)) <=
+                    1e-5f * new_left.distance(new_right)) {
+            continue;
+        }
+
+        // Try to narrow the funnel from the right
+        if (funnelArea2(apex, right, new_right) >= 0.f) {
+            if (funnelPointsEqual(apex, right) ||
+                    funnelArea2(apex, left, new_right) < 0.f) {
+                right = new_right;
+                right_idx = i;
+            } else {
+                // The right side crossed over the left, so the left vertex
+                // is a corner of the path. Restart the scan from there.
+                apex = left;
+                out_waypoints[num_waypoints++] = apex;
+                right = apex;
+                right_idx = left_idx;
+                i = left_idx;
+                continue;
+            }
+        }
+
+        // Try to narrow the funnel from the left
+        if (funnelArea2(apex, left, new_left) <= 0.f) {
+            if (funnelPointsEqual(apex, left) ||
+                    funnelArea2(apex, right, new_left) > 0.f) {
+                left = new_left;
+                left_idx = i;
+            } else {
+                apex = right;
+                out_waypoints[num_waypoints++] = apex;
+                left = apex;
+                left_idx = right_idx;
+                i = right_idx;
+                continue;
+            }
+        }
+    }
+
+    if (num_waypoints < max_waypoints &&
+            !funnelPointsEqual(out_waypoints[num_waypoints - 1], goal_pos)) {
+        out_waypoints[num_waypoints++] = goal_pos;
+    }
+
+    return num_waypoints;
+}
+
+CountT Navmesh::findPath(uint32_t start_poly,
+                         Vector3 start_pos,
+                         uint32_t goal_poly,
+                         Vector3 goal_pos,
+                         PathFindState *state,
+                         Vector3 *out_waypoints,
+                         CountT max_waypoints)
+{
+    // The heap is empty once the search finishes, so it doubles as the
+    // corridor buffer.
+    uint32_t *corridor = state->heap;
+
+    uint32_t corridor_len = findCorridor(start_poly, start_pos,
+        goal_poly, goal_pos, state, corridor);
+
+    return stringPull(start_pos, goal_pos, corridor, corridor_len,
+                      out_waypoints, max_waypoints);
+}
+
+uint32_t Navmesh::findCorridorHierarchical(uint32_t start_poly,
+                                           Vector3 start_pos,
+                                           uint32_t goal_poly,
+                                           Vector3 goal_pos,
+                                           HierarchicalPathFindState *state,
+                                           uint32_t *out_corridor,
+                                           float *out_path_cost)
+{
+    assert(hierarchy.numRegions > 0);
+
+    const uint32_t *tri_regions = hierarchy.triRegions;
+    uint32_t start_region = tri_regions[start_poly];
+    uint32_t goal_region = tri_regions[goal_poly];
+
+    PathFindState *tri_state = &state->tris;
+
+    auto finishCorridor = [&]() {
+        if (out_path_cost != nullptr) {
+            *out_path_cost = tri_state->costs[goal_poly] +
+                tri_state->entryPoints[goal_poly].distance(goal_pos);
+        }
+
+        return pathFindWriteChain(tri_state, goal_poly, out_corridor);
+    };
+
+    // The refinement search is allowed into every region along the coarse
+    // path as well as the regions bordering them, which gives the fine path
+    // room to cut corners the portal placement didn't.
+    auto markRegionAndNeighbors = [&](uint32_t region) {
+        uint32_t region_stamp = state->regionGeneration;
+        state->regionGenerations[region] = region_stamp;
+
+        uint32_t portals_end = hierarchy.regionPortalOffsets[region + 1];
+        for (uint32_t i = hierarchy.regionPortalOffsets[region];
+             i < portals_end; i++) {
+            uint32_t portal = hierarchy.regionPortals[i];
+            state->regionGenerations[hierarchy.portalRegions[2 * portal]] =
+                region_stamp;
+            state->regionGenerations[hierarchy.portalRegions[2 * portal + 1]] =
+                region_stamp;
+        }
+    };
+
+    auto refine = [&]() {
+        uint32_t region_stamp = state->regionGeneration;
+        return pathFindTris(*this, start_poly, start_pos,
+            goal_poly, goal_pos, tri_state, [&](uint32_t tri) {
+                return state->regionGenerations[tri_regions[tri]] ==
+                    region_stamp;
+            });
+    };
+
+    // Nearby queries don't need the portal graph. This can still fail if the
+    // path leaves the neighboring regions, in which case fall through to the
+    // full search.
+    if (start_region == goal_region) {
+        pathFindNextGeneration(&state->regionGeneration,
+            state->regionGenerations, hierarchy.numRegions);
+        markRegionAndNeighbors(start_region);
+
+        if (refine()) {
+            return finishCorridor();
+        }
+    }
+
+    auto portalSide = [&](uint32_t portal, uint32_t region) {
+        return hierarchy.portalRegions[2 * portal] == region ? 0 : 1;
+    };
+
+    // Costs from each portal of the goal region to the goal. The midpoint
+    // costs are close enough to symmetric to search outwards from the goal.
+    uint32_t goal_portals_start = hierarchy.regionPortalOffsets[goal_region];
+    uint32_t goal_portals_end = hierarchy.regionPortalOffsets[goal_region + 1];
+
+    pathFindTris(*this, goal_poly, goal_pos, sentinel, goal_pos, tri_state,
+        [&](uint32_t tri) {
+            return tri_regions[tri] == goal_region;
+        });
+
+    for (uint32_t i = goal_portals_start; i < goal_portals_end; i++) {
+        uint32_t portal = hierarchy.regionPortals[i];
+        uint32_t tri =
+            hierarchy.portalTris[2 * portal + portalSide(portal, goal_region)];
+
+        state->portalGoalCosts[portal] = pathFindVisited(tri_state, tri) ?
+            tri_state->costs[tri] + tri_state->entryPoints[tri].distance(
+                hierarchy.portalPositions[portal]) : FLT_MAX;
+    }
+
+    // Costs from the start to each portal of the start region, which seed
+    // the portal graph search
+    pathFindTris(*this, start_poly, start_pos, sentinel, goal_pos, tri_state,
+        [&](uint32_t tri) {
+            return tri_regions[tri] == start_region;
+        });
+
+    PathFindState *portal_state = &state->portals;
+    uint32_t goal_node = hierarchy.numPortals;
+    pathFindNextGeneration(&portal_state->generation,
+                           portal_state->visitGenerations, goal_node + 1);
+
+    PathFindQueue prio_queue {
+        .costs = portal_state->priorities,
+        .heap = portal_state->heap,
+        .heapIndex = portal_state->heapIndex,
+        .heapSize = 0,
+    };
+
+    uint32_t start_portals_start = hierarchy.regionPortalOffsets[start_region];
+    uint32_t start_portals_end =
+        hierarchy.regionPortalOffsets[start_region + 1];
+    for (uint32_t i = start_portals_start; i < start_portals_end; i++) {
+        uint32_t portal = hierarchy.regionPortals[i];
+        uint32_t tri =
+            hierarchy.portalTris[2 * portal + portalSide(portal, start_region)];
+        if (!pathFindVisited(tri_state, tri)) {
+            continue;
+        }
+
+        Vector3 portal_pos = hierarchy.portalPositions[portal];
+        float cost = tri_state->costs[tri] +
+            tri_state->entryPoints[tri].distance(portal_pos);
+
+        pathFindRelax(prio_queue, portal_state, portal, sentinel, cost,
+                      portal_pos.distance(goal_pos));
+    }
+
+    bool found_coarse = false;
+    while (prio_queue.heapSize > 0) {
+        uint32_t min_portal = prio_queue.removeMin();
+        if (min_portal == goal_node) {
+            found_coarse = true;
+            break;
+        }
+
+        float cost_so_far = portal_state->costs[min_portal];
+
+        MADRONA_UNROLL
+        for (uint32_t side = 0; side < 2; side++) {
+            uint32_t region = hierarchy.portalRegions[2 * min_portal + side];
+            uint32_t local_idx =
+                hierarchy.portalLocalIdxs[2 * min_portal + side];
+
+            uint32_t portals_start = hierarchy.regionPortalOffsets[region];
+            uint32_t num_region_portals =
+                hierarchy.regionPortalOffsets[region + 1] - portals_start;
+            const float *portal_costs = hierarchy.regionPortalCosts +
+                hierarchy.regionCostOffsets[region] +
+                local_idx * num_region_portals;
+
+            for (uint32_t i = 0; i < num_region_portals; i++) {
+                float edge_cost = portal_costs[i];
+                if (i == local_idx || edge_cost == FLT_MAX) {
+                    continue;
+                }
+
+                uint32_t portal = hierarchy.regionPortals[portals_start + i];
+
+                pathFindRelax(prio_queue, portal_state, portal, min_portal,
+                    cost_so_far + edge_cost,
+                    hierarchy.portalPositions[portal].distance(goal_pos));
+            }
+
+            if (region == goal_region &&
+                    state->portalGoalCosts[min_portal] != FLT_MAX) {
+                pathFindRelax(prio_queue, portal_state, goal_node, min_portal,
+                    cost_so_far + state->portalGoalCosts[min_portal], 0.f);
+            }
+        }
+    }
+
+    if (!found_coarse) {
+        return 0;
+    }
+
+    pathFindNextGeneration(&state->regionGeneration, state->regionGenerations,
+                           hierarchy.numRegions);
+
+    markRegionAndNeighbors(start_region);
+    markRegionAndNeighbors(goal_region);
+    for (uint32_t portal = portal_state->parents[goal_node];
+         portal != sentinel; portal = portal_state->parents[portal]) {
+        markRegionAndNeighbors(hierarchy.portalRegions[2 * portal]);
+        markRegionAndNeighbors(hierarchy.portalRegions[2 * portal + 1]);
+    }
+
+    // The coarse path always has a refinement, since every portal to portal
+    // cost came from a path inside the regions being searched
+    bool found = refine();
+    assert(found);
+    (void)found;
+
+    return finishCorridor();
+}
+
+CountT Navmesh::findPathHierarchical(uint32_t start_poly,
+                                     Vector3 start_pos,
+                                     uint32_t goal_poly,
+                                     Vector3 goal_pos,
+                                     HierarchicalPathFindState *state,
+                                     Vector3 *out_waypoints,
+                                     CountT max_waypoints)
+{
+    uint32_t *corridor = state->tris.heap;
+
+    uint32_t corridor_len = findCorridorHierarchical(start_poly, start_pos,
+        goal_poly, goal_pos, state, corridor);
+
+    return stringPull(start_pos, goal_pos, corridor, corridor_len,
+                      out_waypoints, max_waypoints);
+}
+
 static inline uint32_t hashNavmeshEdge(uint32_t a, uint32_t b)
 {
     // MurmurHash2 Finalizer
@@ -120,13 +908,475 @@ static inline uint32_t hashNavmeshEdge(uint32_t a, uint32_t b)
     return b;
 }
 
+// Top down object median split, sized so the traversal stack in the queries
+// can never overflow.
+static Navmesh::TriBVH buildNavmeshTriBVH(Navmesh &navmesh)
+{
+    using TriBVH = Navmesh::TriBVH;
+    using Node = TriBVH::Node;
+
+    uint32_t num_tris = navmesh.numTris;
+
+    // A binary tree with at least one triangle per leaf
+    uint32_t max_nodes = std::max(2 * num_tris, 1_u32);
+    Node *nodes = (Node *)rawAlloc(sizeof(Node) * max_nodes);
+    uint32_t *tri_indices =
+        (uint32_t *)rawAlloc(sizeof(uint32_t) * num_tris);
+
+    Vector3 *centroids = (Vector3 *)rawAlloc(sizeof(Vector3) * num_tris);
+    AABB *tri_aabbs = (AABB *)rawAlloc(sizeof(AABB) * num_tris);
+    for (uint32_t tri = 0; tri < num_tris; tri++) {
+        Vector3 a, b, c;
+        navmesh.getTriangleVertices(tri, &a, &b, &c);
+
+        AABB aabb = AABB::point(a);
+        aabb.expand(b);
+        aabb.expand(c);
+
+        tri_indices[tri] = tri;
+        centroids[tri] = (a + b + c) / 3.f;
+        tri_aabbs[tri] = aabb;
+    }
+
+    struct BuildTask {
+        uint32_t node;
+        uint32_t firstTri;
+        uint32_t numTris;
+    };
+
+    BuildTask stack[TriBVH::maxDepth];
+    CountT stack_size = 0;
+    stack[stack_size++] = { 0, 0, num_tris };
+
+    uint32_t num_nodes = 1;
+    while (stack_size > 0) {
+        BuildTask task = stack[--stack_size];
+        Node &node = nodes[task.node];
+
+        AABB bounds = AABB::invalid();
+        AABB centroid_bounds = AABB::invalid();
+        for (uint32_t i = 0; i < task.numTris; i++) {
+            uint32_t tri = tri_indices[task.firstTri + i];
+            bounds = AABB::merge(bounds, tri_aabbs[tri]);
+            centroid_bounds.expand(centroids[tri]);
+        }
+        node.bounds = bounds;
+
+        if (task.numTris <= TriBVH::maxLeafTris) {
+            node.childOrFirstTri = task.firstTri;
+            node.numTris = task.numTris;
+            continue;
+        }
+
+        Vector3 extent = centroid_bounds.pMax - centroid_bounds.pMin;
+        CountT axis = 0;
+        if (extent.y > extent[axis]) {
+            axis = 1;
+        }
+        if (extent.z > extent[axis]) {
+            axis = 2;
+        }
+
+        // Hoare quickselect, leaving the lower half of the triangles along
+        // axis in the first half of the range
+        uint32_t mid = task.firstTri + task.numTris / 2;
+        {
+            int64_t lo = task.firstTri;
+            int64_t hi = task.firstTri + task.numTris - 1;
+            while (lo < hi) {
+                float pivot = centroids[tri_indices[(lo + hi) / 2]][axis];
+
+                int64_t i = lo;
+                int64_t j = hi;
+                while (i <= j) {
+                    while (centroids[tri_indices[i]][axis] < pivot) {
+                        i++;
+                    }
+                    while (centroids[tri_indices[j]][axis] > pivot) {
+                        j--;
+                    }
+
+                    if (i <= j) {
+                        std::swap(tri_indices[i], tri_indices[j]);
+                        i++;
+                        j--;
+                    }
+                }
+
+                if ((int64_t)mid <= j) {
+                    hi = j;
+                } else if ((int64_t)mid >= i) {
+                    lo = i;
+                } else {
+                    break;
+                }
+            }
+        }
+
+        uint32_t left = num_nodes;
+        num_nodes += 2;
+
+        node.childOrFirstTri = left;
+        node.numTris = 0;
+
+        stack[stack_size++] = {
+            left + 1, mid, task.firstTri + task.numTris - mid };
+        stack[stack_size++] = { left, task.firstTri, mid - task.firstTri };
+    }
+
+    rawDealloc(tri_aabbs);
+    rawDealloc(centroids);
+
+    return TriBVH {
+        .nodes = nodes,
+        .triIndices = tri_indices,
+        .numNodes = num_nodes,
+    };
+}
+
+// Groups triangles into connected regions of roughly region_size triangles
+// by breadth first flood fill, joins each pair of adjacent regions with a
+// portal, then computes the in region path cost between every pair of
+// portals on each region.
+static Navmesh::Hierarchy buildNavmeshHierarchy(Navmesh &navmesh,
+                                                uint32_t region_size)
+{
+    using Hierarchy = Navmesh::Hierarchy;
+    constexpr uint32_t sentinel = Navmesh::sentinel;
+
+    uint32_t num_tris = navmesh.numTris;
+    const uint32_t *tri_adjacency = navmesh.triAdjacency;
+
+    uint32_t *tri_regions = (uint32_t *)rawAlloc(sizeof(uint32_t) * num_tris);
+    utils::fillN<uint32_t>(tri_regions, sentinel, num_tris);
+
+    uint32_t num_regions = 0;
+    {
+        uint32_t *queue_data =
+            (uint32_t *)rawAlloc(sizeof(uint32_t) * num_tris);
+
+        for (uint32_t seed = 0; seed < num_tris; seed++) {
+            if (tri_regions[seed] != sentinel) {
+                continue;
+            }
+
+            uint32_t region = num_regions++;
+
+            ArrayQueue<uint32_t> queue(queue_data, num_tris);
+            queue.add(seed);
+            tri_regions[seed] = region;
+            uint32_t region_tris = 1;
+
+            while (!queue.isEmpty() && region_tris < region_size) {
+                uint32_t tri = queue.remove();
+
+                for (CountT i = 0; i < 3 && region_tris < region_size; i++) {
+                    uint32_t adjacent = tri_adjacency[3 * tri + i];
+                    if (adjacent == sentinel ||
+                            tri_regions[adjacent] != sentinel) {
+                        continue;
+                    }
+
+                    tri_regions[adjacent] = region;
+                    region_tris++;
+                    queue.add(adjacent);
+                }
+            }
+        }
+
+        rawDealloc(queue_data);
+    }
+
+    auto edgeMidpoint = [&navmesh](uint32_t tri, uint32_t edge_idx) {
+        Vector3 a = navmesh.vertices[navmesh.triIndices[3 * tri + edge_idx]];
+        Vector3 b = navmesh.vertices[
+            navmesh.triIndices[3 * tri + (edge_idx + 1) % 3]];
+        return (a + b) / 2.f;
+    };
+
+    // Find the edges crossing between regions, grouped by region pair in an
+    // open addressing table. Each group becomes one portal, placed on the
+    // crossing edge closest to the average of the group's edge midpoints.
+    struct PairEntry {
+        uint32_t regionA;
+        uint32_t regionB;
+        Vector3 midpointSum;
+        uint32_t numCrossings;
+        uint32_t bestTriA;
+        uint32_t bestTriB;
+        float bestDist;
+        Vector3 bestPos;
+    };
+
+    uint32_t num_crossings = 0;
+    for (uint32_t tri = 0; tri < num_tris; tri++) {
+        for (CountT i = 0; i < 3; i++) {
+            uint32_t adjacent = tri_adjacency[3 * tri + i];
+            if (adjacent != sentinel && tri < adjacent &&
+                    tri_regions[tri] != tri_regions[adjacent]) {
+                num_crossings++;
+            }
+        }
+    }
+
+    uint32_t pair_tbl_size = utils::int32NextPow2(
+        std::max(2 * num_crossings, 16_u32));
+    auto *pair_tbl =
+        (PairEntry *)rawAlloc(sizeof(PairEntry) * pair_tbl_size);
+    for (uint32_t i = 0; i < pair_tbl_size; i++) {
+        pair_tbl[i].regionA = sentinel;
+    }
+
+    auto findPair = [&](uint32_t region_a, uint32_t region_b) -> PairEntry & {
+        uint32_t idx = hashNavmeshEdge(region_a, region_b) &
+            (pair_tbl_size - 1);
+
+        while (pair_tbl[idx].regionA != sentinel && (
+                pair_tbl[idx].regionA != region_a ||
+                pair_tbl[idx].regionB != region_b)) {
+            idx = (idx + 1) & (pair_tbl_size - 1);
+        }
+
+        PairEntry &entry = pair_tbl[idx];
+        if (entry.regionA == sentinel) {
+            entry = PairEntry {
+                .regionA = region_a,
+                .regionB = region_b,
+                .midpointSum = Vector3::zero(),
+                .numCrossings = 0,
+                .bestTriA = sentinel,
+                .bestTriB = sentinel,
+                .bestDist = FLT_MAX,
+                .bestPos = Vector3::zero(),
+            };
+        }
+
+        return entry;
+    };
+
+    // Calls fn(tri_a, tri_b, edge midpoint) for every crossing edge, with
+    // tri_a in the lower numbered region
+    auto forEachCrossing = [&](auto &&fn) {
+        for (uint32_t tri = 0; tri < num_tris; tri++) {
+            for (uint32_t i = 0; i < 3; i++) {
+                uint32_t adjacent = tri_adjacency[3 * tri + i];
+                if (adjacent == sentinel || adjacent < tri ||
+                        tri_regions[tri] == tri_regions[adjacent]) {
+                    continue;
+                }
+
+                Vector3 midpoint = edgeMidpoint(tri, i);
+                if (tri_regions[tri] < tri_regions[adjacent]) {
+                    fn(tri, adjacent, midpoint);
+                } else {
+                    fn(adjacent, tri, midpoint);
+                }
+            }
+        }
+    };
+
+    forEachCrossing([&](uint32_t tri_a, uint32_t tri_b, Vector3 midpoint) {
+        PairEntry &entry = findPair(tri_regions[tri_a], tri_regions[tri_b]);
+        entry.midpointSum += midpoint;
+        entry.numCrossings++;
+    });
+
+    forEachCrossing([&](uint32_t tri_a, uint32_t tri_b, Vector3 midpoint) {
+        PairEntry &entry = findPair(tri_regions[tri_a], tri_regions[tri_b]);
+        Vector3 center = entry.midpointSum / float(entry.numCrossings);
+
+        float dist = midpoint.distance2(center);
+        if (dist < entry.bestDist) {
+            entry.bestDist = dist;
+            entry.bestTriA = tri_a;
+            entry.bestTriB = tri_b;
+            entry.bestPos = midpoint;
+        }
+    });
+
+    uint32_t num_portals = 0;
+    for (uint32_t i = 0; i < pair_tbl_size; i++) {
+        if (pair_tbl[i].regionA != sentinel) {
+            num_portals++;
+        }
+    }
+
+    uint32_t *region_portal_offsets =
+        (uint32_t *)rawAlloc(sizeof(uint32_t) * (num_regions + 1));
+    uint32_t *region_portals =
+        (uint32_t *)rawAlloc(sizeof(uint32_t) * 2 * num_portals);
+    uint32_t *region_cost_offsets =
+        (uint32_t *)rawAlloc(sizeof(uint32_t) * num_regions);
+    uint32_t *portal_regions =
+        (uint32_t *)rawAlloc(sizeof(uint32_t) * 2 * num_portals);
+    uint32_t *portal_local_idxs =
+        (uint32_t *)rawAlloc(sizeof(uint32_t) * 2 * num_portals);
+    uint32_t *portal_tris =
+        (uint32_t *)rawAlloc(sizeof(uint32_t) * 2 * num_portals);
+    Vector3 *portal_positions =
+        (Vector3 *)rawAlloc(sizeof(Vector3) * num_portals);
+
+    utils::zeroN<uint32_t>(region_portal_offsets, num_regions + 1);
+
+    {
+        uint32_t portal = 0;
+        for (uint32_t i = 0; i < pair_tbl_size; i++) {
+            const PairEntry &entry = pair_tbl[i];
+            if (entry.regionA == sentinel) {
+                continue;
+            }
+
+            portal_regions[2 * portal] = entry.regionA;
+            portal_regions[2 * portal + 1] = entry.regionB;
+            portal_tris[2 * portal] = entry.bestTriA;
+            portal_tris[2 * portal + 1] = entry.bestTriB;
+            portal_positions[portal] = entry.bestPos;
+
+            region_portal_offsets[entry.regionA + 1]++;
+            region_portal_offsets[entry.regionB + 1]++;
+
+            portal++;
+        }
+    }
+
+    rawDealloc(pair_tbl);
+
+    uint32_t num_costs = 0;
+    for (uint32_t region = 0; region < num_regions; region++) {
+        uint32_t num_region_portals = region_portal_offsets[region + 1];
+        region_cost_offsets[region] = num_costs;
+        num_costs += num_region_portals * num_region_portals;
+
+        region_portal_offsets[region + 1] += region_portal_offsets[region];
+    }
+
+    {
+        uint32_t *region_fill =
+            (uint32_t *)rawAlloc(sizeof(uint32_t) * num_regions);
+        utils::zeroN<uint32_t>(region_fill, num_regions);
+
+        for (uint32_t portal = 0; portal < num_portals; portal++) {
+            for (uint32_t side = 0; side < 2; side++) {
+                uint32_t region = portal_regions[2 * portal + side];
+                uint32_t local_idx = region_fill[region]++;
+
+                region_portals[region_portal_offsets[region] + local_idx] =
+                    portal;
+                portal_local_idxs[2 * portal + side] = local_idx;
+            }
+        }
+
+        rawDealloc(region_fill);
+    }
+
+    float *region_portal_costs =
+        (float *)rawAlloc(sizeof(float) * num_costs);
+
+    {
+        float *costs = (float *)rawAlloc(sizeof(float) * num_tris);
+        float *priorities = (float *)rawAlloc(sizeof(float) * num_tris);
+        Vector3 *entry_points =
+            (Vector3 *)rawAlloc(sizeof(Vector3) * num_tris);
+        uint32_t *parents = (uint32_t *)rawAlloc(sizeof(uint32_t) * num_tris);
+        uint32_t *heap = (uint32_t *)rawAlloc(sizeof(uint32_t) * num_tris);
+        uint32_t *heap_index =
+            (uint32_t *)rawAlloc(sizeof(uint32_t) * num_tris);
+        uint32_t *visit_generations =
+            (uint32_t *)rawAlloc(sizeof(uint32_t) * num_tris);
+        utils::zeroN<uint32_t>(visit_generations, num_tris);
+
+        Navmesh::PathFindState state {
+            .costs = costs,
+            .priorities = priorities,
+            .entryPoints = entry_points,
+            .parents = parents,
+            .heap = heap,
+            .heapIndex = heap_index,
+            .visitGenerations = visit_generations,
+            .generation = 0,
+        };
+
+        for (uint32_t region = 0; region < num_regions; region++) {
+            uint32_t portals_start = region_portal_offsets[region];
+            uint32_t num_region_portals =
+                region_portal_offsets[region + 1] - portals_start;
+            float *region_costs =
+                region_portal_costs + region_cost_offsets[region];
+
+            auto portalTri = [&](uint32_t portal) {
+                return portal_tris[2 * portal +
+                    (portal_regions[2 * portal] == region ? 0 : 1)];
+            };
+
+            for (uint32_t i = 0; i < num_region_portals; i++) {
+                uint32_t src_portal = region_portals[portals_start + i];
+
+                pathFindTris(navmesh, portalTri(src_portal),
+                    portal_positions[src_portal], sentinel, Vector3::zero(),
+                    &state, [&](uint32_t tri) {
+                        return tri_regions[tri] == region;
+                    });
+
+                for (uint32_t j = 0; j < num_region_portals; j++) {
+                    uint32_t dst_portal = region_portals[portals_start + j];
+                    uint32_t dst_tri = portalTri(dst_portal);
+
+                    float cost;
+                    if (i == j) {
+                        cost = 0.f;
+                    } else if (pathFindVisited(&state, dst_tri)) {
+                        cost = costs[dst_tri] + entry_points[dst_tri].distance(
+                            portal_positions[dst_portal]);
+                    } else {
+                        cost = FLT_MAX;
+                    }
+
+                    region_costs[i * num_region_portals + j] = cost;
+                }
+            }
+        }
+
+        rawDealloc(visit_generations);
+        rawDealloc(heap_index);
+        rawDealloc(heap);
+        rawDealloc(parents);
+        rawDealloc(entry_points);
+        rawDealloc(priorities);
+        rawDealloc(costs);
+    }
+
+    uint64_t num_bytes =
+        sizeof(uint32_t) * (uint64_t)num_tris +
+        sizeof(uint32_t) * (uint64_t)(num_regions + 1) +
+        sizeof(uint32_t) * (uint64_t)num_regions +
+        sizeof(float) * (uint64_t)num_costs +
+        (3 * sizeof(uint32_t) * 2 + sizeof(Vector3)) * (uint64_t)num_portals +
+        sizeof(uint32_t) * 2 * (uint64_t)num_portals;
+
+    return Hierarchy {
+        .triRegions = tri_regions,
+        .regionPortalOffsets = region_portal_offsets,
+        .regionPortals = region_portals,
+        .regionCostOffsets = region_cost_offsets,
+        .regionPortalCosts = region_portal_costs,
+        .portalRegions = portal_regions,
+        .portalLocalIdxs = portal_local_idxs,
+        .portalTris = portal_tris,
+        .portalPositions = portal_positions,
+        .numRegions = num_regions,
+        .numPortals = num_portals,
+        .numBytes = num_bytes,
+    };
+}
+
 Navmesh Navmesh::initFromPolygons(
     Vector3 *poly_vertices,
     uint32_t *poly_idxs,
     uint32_t *poly_idx_offsets,
     uint32_t *poly_sizes,
     uint32_t num_verts,
-    uint32_t num_polys)
+    uint32_t num_polys,
+    uint32_t hierarchy_region_size)
 {
     Vector3 *out_vertices = (Vector3 *)rawAlloc(sizeof(Vector3) * num_verts);
     utils::copyN<Vector3>(out_vertices, poly_vertices, num_verts);
@@ -305,14 +1555,25 @@ Navmesh Navmesh::initFromPolygons(
 
     rawDealloc(edge_tbl);
 
-    return Navmesh {
+    Navmesh navmesh {
         .vertices = out_vertices,
         .triIndices = tri_indices,
         .triAdjacency = tri_adjacency,
         .triSampleAliasTable = alias_tbl,
         .numVerts = num_verts,
         .numTris = num_tris,
+        .triBVH = {},
+        .hierarchy = {},
     };
+
+    navmesh.triBVH = buildNavmeshTriBVH(navmesh);
+
+    if (hierarchy_region_size > 0) {
+        navmesh.hierarchy =
+            buildNavmeshHierarchy(navmesh, hierarchy_region_size);
+    }
+
+    return navmesh;
 }
 
 }
@@ -0,0 +1,461 @@
+#include <madrona/navmesh.hpp>
+#include <madrona/memory.hpp>
+#include <madrona/utils.hpp>
+
+#if defined(__linux__) or defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace madrona {
+
+using namespace math;
+
+namespace {
+
+// Table files are the header, padded to a cache line, followed by the
+// source polys and then the distance rows, each also starting on a cache
+// line. The distance rows are used straight out of the mapping.
+struct DistanceTableHeader {
+    static constexpr inline uint32_t magic = 0x4D44'544E; // "NTDM"
+    static constexpr inline uint32_t version = 1;
+
+    uint32_t fileMagic;
+    uint32_t fileVersion;
+    uint32_t numSources;
+    uint32_t numTris;
+    uint64_t navmeshHash;
+};
+
+constexpr uint64_t tableHeaderBytes = utils::roundUp(
+    sizeof(DistanceTableHeader), (size_t)MADRONA_CACHE_LINE);
+
+inline uint64_t tableSourcesBytes(uint32_t num_sources)
+{
+    return utils::roundUp(sizeof(uint32_t) * (uint64_t)num_sources,
+                          (uint64_t)MADRONA_CACHE_LINE);
+}
+
+inline uint64_t tableDistancesBytes(uint32_t num_sources, uint32_t num_tris)
+{
+    return sizeof(float) * (uint64_t)num_sources * (uint64_t)num_tris;
+}
+
+// Ties a saved table to the navmesh it was built from. Not cryptographic,
+// just needs to catch a table saved for an edited navmesh.
+uint64_t hashNavmesh(const Navmesh &navmesh)
+{
+    uint64_t hash = 0x9E37'79B9'7F4A'7C15_u64;
+
+    auto mix = [](uint64_t v) {
+        // MurmurHash3 64 bit finalizer
+        v ^= v >> 33;
+        v *= 0xFF51'AFD7'ED55'8CCD_u64;
+        v ^= v >> 33;
+        v *= 0xC4CE'B9FE'1A85'EC53_u64;
+        v ^= v >> 33;
+        return v;
+    };
+
+    auto addBytes = [&](const void *data, uint64_t num_bytes) {
+        hash = mix(hash ^ mix(num_bytes));
+
+        const char *bytes = (const char *)data;
+        uint64_t offset = 0;
+        for (; offset + 8 <= num_bytes; offset += 8) {
+            uint64_t word;
+            memcpy(&word, bytes + offset, 8);
+            hash = mix(hash ^ mix(word)) + 0x9E37'79B9'7F4A'7C15_u64;
+        }
+
+        if (offset < num_bytes) {
+            uint64_t word = 0;
+            memcpy(&word, bytes + offset, num_bytes - offset);
+            hash = mix(hash ^ mix(word)) + 0x9E37'79B9'7F4A'7C15_u64;
+        }
+    };
+
+    addBytes(navmesh.vertices, sizeof(Vector3) * navmesh.numVerts);
+    addBytes(navmesh.triIndices, sizeof(uint32_t) * 3 * navmesh.numTris);
+
+    return hash;
+}
+
+// Single allocation laid out exactly like a table file, so save() writes it
+// out in one go
+void * allocTable(uint32_t num_sources, uint32_t num_tris,
+                  uint64_t *out_num_bytes)
+{
+    uint64_t num_bytes = tableHeaderBytes + tableSourcesBytes(num_sources) +
+        tableDistancesBytes(num_sources, num_tris);
+
+    void *base = rawAllocAligned(num_bytes, MADRONA_CACHE_LINE);
+    memset(base, 0, tableHeaderBytes + tableSourcesBytes(num_sources));
+
+    *out_num_bytes = num_bytes;
+    return base;
+}
+
+NavmeshDistanceTable tableFromBase(void *base,
+                                   uint32_t num_sources,
+                                   uint32_t num_tris)
+{
+    char *sources = (char *)base + tableHeaderBytes;
+    char *distances = sources + tableSourcesBytes(num_sources);
+
+    return NavmeshDistanceTable {
+        .sourcePolys = (const uint32_t *)sources,
+        .distances = (const float *)distances,
+        .numSources = num_sources,
+        .numTris = num_tris,
+    };
+}
+
+// Scratch buffers for dijkstrasFromPoly
+struct DijkstrasBuffers {
+    Navmesh::DijkstrasState state;
+
+    DijkstrasBuffers(uint32_t num_tris)
+    {
+        state.distances = (float *)rawAlloc(sizeof(float) * num_tris);
+        state.entryPoints = (Vector3 *)rawAlloc(sizeof(Vector3) * num_tris);
+        state.heap = (uint32_t *)rawAlloc(sizeof(uint32_t) * num_tris);
+        state.heapIndex = (uint32_t *)rawAlloc(sizeof(uint32_t) * num_tris);
+    }
+
+    ~DijkstrasBuffers()
+    {
+        rawDealloc(state.heapIndex);
+        rawDealloc(state.heap);
+        rawDealloc(state.entryPoints);
+        rawDealloc(state.distances);
+    }
+};
+
+void fillDistanceRow(Navmesh &navmesh,
+                     uint32_t source_poly,
+                     Vector3 source_pos,
+                     DijkstrasBuffers &buffers,
+                     float *out_row)
+{
+    utils::fillN<float>(out_row, FLT_MAX, navmesh.numTris);
+
+    navmesh.dijkstrasFromPoly(source_poly, source_pos, buffers.state,
+        [out_row](uint32_t poly, Vector3, float dist) {
+            out_row[poly] = dist;
+        });
+}
+
+Vector3 triCentroid(Navmesh &navmesh, uint32_t tri)
+{
+    Vector3 a, b, c;
+    navmesh.getTriangleVertices(tri, &a, &b, &c);
+    return (a + b + c) / 3.f;
+}
+
+void * mapTableFile(const char *path, uint64_t *out_num_bytes)
+{
+#if defined(__linux__) or defined(__APPLE__)
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return nullptr;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 ||
+            (uint64_t)file_stat.st_size < tableHeaderBytes) {
+        close(fd);
+        return nullptr;
+    }
+
+    uint64_t num_bytes = (uint64_t)file_stat.st_size;
+    void *base = mmap(nullptr, num_bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED) {
+        return nullptr;
+    }
+
+    *out_num_bytes = num_bytes;
+    return base;
+#elif defined(_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) ||
+            (uint64_t)file_size.QuadPart < tableHeaderBytes) {
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY,
+                                        0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        return nullptr;
+    }
+
+    void *base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+
+    if (base == nullptr) {
+        return nullptr;
+    }
+
+    *out_num_bytes = (uint64_t)file_size.QuadPart;
+    return base;
+#else
+    STATIC_UNIMPLEMENTED();
+#endif
+}
+
+void unmapTableFile(void *base, uint64_t num_bytes)
+{
+#if defined(__linux__) or defined(__APPLE__)
+    munmap(base, num_bytes);
+#elif defined(_WIN32)
+    (void)num_bytes;
+    UnmapViewOfFile(base);
+#else
+    STATIC_UNIMPLEMENTED();
+#endif
+}
+
+}
+
+NavmeshDistanceTableStorage::NavmeshDistanceTableStorage()
+    : base_(nullptr),
+      numBytes_(0),
+      mapped_(false),
+      table_ {}
+{}
+
+NavmeshDistanceTableStorage::NavmeshDistanceTableStorage(
+        void *base, uint64_t num_bytes, bool mapped,
+        NavmeshDistanceTable table)
+    : base_(base),
+      numBytes_(num_bytes),
+      mapped_(mapped),
+      table_(table)
+{}
+
+NavmeshDistanceTableStorage::NavmeshDistanceTableStorage(
+        NavmeshDistanceTableStorage &&o)
+    : base_(o.base_),
+      numBytes_(o.numBytes_),
+      mapped_(o.mapped_),
+      table_(o.table_)
+{
+    o.base_ = nullptr;
+}
+
+NavmeshDistanceTableStorage::~NavmeshDistanceTableStorage()
+{
+    if (base_ == nullptr) {
+        return;
+    }
+
+    if (mapped_) {
+        unmapTableFile(base_, numBytes_);
+    } else {
+        rawDeallocAligned(base_);
+    }
+}
+
+NavmeshDistanceTableStorage & NavmeshDistanceTableStorage::operator=(
+    NavmeshDistanceTableStorage &&o)
+{
+    this->~NavmeshDistanceTableStorage();
+    new (this) NavmeshDistanceTableStorage(std::move(o));
+
+    return *this;
+}
+
+NavmeshDistanceTableStorage NavmeshDistanceTableStorage::build(
+    Navmesh &navmesh,
+    const uint32_t *source_polys,
+    const Vector3 *source_positions,
+    uint32_t num_sources)
+{
+    uint32_t num_tris = navmesh.numTris;
+
+    uint64_t num_bytes;
+    void *base = allocTable(num_sources, num_tris, &num_bytes);
+    NavmeshDistanceTable table = tableFromBase(base, num_sources, num_tris);
+
+    utils::copyN<uint32_t>((uint32_t *)table.sourcePolys, source_polys,
+                           num_sources);
+
+    DijkstrasBuffers buffers(num_tris);
+    for (uint32_t i = 0; i < num_sources; i++) {
+        fillDistanceRow(navmesh, source_polys[i], source_positions[i],
+            buffers, (float *)table.distances + (uint64_t)i * num_tris);
+    }
+
+    return NavmeshDistanceTableStorage(base, num_bytes, false, table);
+}
+
+NavmeshDistanceTableStorage NavmeshDistanceTableStorage::buildLandmarks(
+    Navmesh &navmesh,
+    uint32_t num_landmarks)
+{
+    uint32_t num_tris = navmesh.numTris;
+    if (num_tris == 0) {
+        num_landmarks = 0;
+    }
+
+    uint64_t num_bytes;
+    void *base = allocTable(num_landmarks, num_tris, &num_bytes);
+    NavmeshDistanceTable table = tableFromBase(base, num_landmarks, num_tris);
+
+    uint32_t *landmarks = (uint32_t *)table.sourcePolys;
+
+    DijkstrasBuffers buffers(num_tris);
+
+    // Distance from each triangle to its nearest landmark so far. Seeded
+    // with the distances from triangle 0, so the first landmark is the
+    // triangle farthest from it rather than triangle 0 itself.
+    float *nearest_dists = (float *)rawAlloc(sizeof(float) * num_tris);
+    if (num_landmarks > 0) {
+        fillDistanceRow(navmesh, 0, triCentroid(navmesh, 0), buffers,
+                        nearest_dists);
+    }
+
+    for (uint32_t i = 0; i < num_landmarks; i++) {
+        // Unreached triangles (FLT_MAX) are on islands no landmark covers
+        // yet, so they win first
+        uint32_t farthest = 0;
+        for (uint32_t tri = 1; tri < num_tris; tri++) {
+            if (nearest_dists[tri] > nearest_dists[farthest]) {
+                farthest = tri;
+            }
+        }
+
+        landmarks[i] = farthest;
+
+        float *row = (float *)table.distances + (uint64_t)i * num_tris;
+        fillDistanceRow(navmesh, farthest, triCentroid(navmesh, farthest),
+                        buffers, row);
+
+        for (uint32_t tri = 0; tri < num_tris; tri++) {
+            float dist = row[tri];
+            if (i == 0 || dist < nearest_dists[tri]) {
+                nearest_dists[tri] = dist;
+            }
+        }
+    }
+
+    rawDealloc(nearest_dists);
+
+    return NavmeshDistanceTableStorage(base, num_bytes, false, table);
+}
+
+bool NavmeshDistanceTableStorage::save(const char *path,
+                                       const Navmesh &navmesh) const
+{
+    if (base_ == nullptr || navmesh.numTris != table_.numTris) {
+        return false;
+    }
+
+    DistanceTableHeader hdr {
+        .fileMagic = DistanceTableHeader::magic,
+        .fileVersion = DistanceTableHeader::version,
+        .numSources = table_.numSources,
+        .numTris = table_.numTris,
+        .navmeshHash = hashNavmesh(navmesh),
+    };
+
+    uint64_t body_offset = tableHeaderBytes;
+    uint64_t body_bytes = tableSourcesBytes(table_.numSources) +
+        tableDistancesBytes(table_.numSources, table_.numTris);
+    const char *body = (const char *)table_.sourcePolys;
+
+    // Write to a temporary file and rename, so concurrently starting
+    // processes never map a partially written table
+#if defined(_WIN32)
+    uint64_t pid = GetCurrentProcessId();
+#else
+    uint64_t pid = getpid();
+#endif
+    std::string tmp_path = std::string(path) + ".tmp" + std::to_string(pid);
+
+    FILE *file = fopen(tmp_path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    char padding[tableHeaderBytes] {};
+    memcpy(padding, &hdr, sizeof(DistanceTableHeader));
+
+    bool success =
+        fwrite(padding, 1, body_offset, file) == body_offset &&
+        fwrite(body, 1, body_bytes, file) == body_bytes;
+
+    success = fclose(file) == 0 && success;
+
+    if (success) {
+#if defined(_WIN32)
+        success = MoveFileExA(tmp_path.c_str(), path,
+                              MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        success = rename(tmp_path.c_str(), path) == 0;
+#endif
+    }
+
+    if (!success) {
+        remove(tmp_path.c_str());
+    }
+
+    return success;
+}
+
+NavmeshDistanceTableStorage NavmeshDistanceTableStorage::load(
+    const char *path,
+    const Navmesh &navmesh)
+{
+    uint64_t num_bytes;
+    void *base = mapTableFile(path, &num_bytes);
+    if (base == nullptr) {
+        return NavmeshDistanceTableStorage();
+    }
+
+    const auto *hdr = (const DistanceTableHeader *)base;
+
+    bool valid = hdr->fileMagic == DistanceTableHeader::magic &&
+        hdr->fileVersion == DistanceTableHeader::version &&
+        hdr->numTris == navmesh.numTris &&
+        num_bytes == tableHeaderBytes + tableSourcesBytes(hdr->numSources) +
+            tableDistancesBytes(hdr->numSources, hdr->numTris) &&
+        hdr->navmeshHash == hashNavmesh(navmesh);
+
+    if (!valid) {
+        unmapTableFile(base, num_bytes);
+        return NavmeshDistanceTableStorage();
+    }
+
+    NavmeshDistanceTable table =
+        tableFromBase(base, hdr->numSources, hdr->numTris);
+
+    for (uint32_t i = 0; i < table.numSources; i++) {
+        if (table.sourcePolys[i] >= table.numTris) {
+            unmapTableFile(base, num_bytes);
+            return NavmeshDistanceTableStorage();
+        }
+    }
+
+    return NavmeshDistanceTableStorage(base, num_bytes, true, table);
+}
+
+}
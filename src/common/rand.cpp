@@ -0,0 +1,279 @@
+#include <madrona/rand.hpp>
+
+#if defined(MADRONA_X64) && defined(__AVX512F__)
+#define MADRONA_RAND_AVX512 1
+#include <immintrin.h>
+#elif defined(MADRONA_X64) && defined(__AVX2__)
+#define MADRONA_RAND_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace madrona::rand {
+
+/*
+The bulk functions evaluate split_i for a run of consecutive counters, one
+counter per 32 bit lane. Threefry2x32 is only adds, rotates and xors, so
+the vector version below is split_i formula for formula and produces the
+same keys. Postprocessing into floats or ranges is then either done with
+the same operations in vector form (fillUniform) or by handing the keys
+to the scalar sample function, so results never depend on the ISA.
+*/
+
+namespace {
+
+#if defined(MADRONA_RAND_AVX512)
+
+struct U32Lanes {
+    static constexpr CountT width = 16;
+
+    __m512i v;
+
+    static U32Lanes splat(uint32_t x) { return { _mm512_set1_epi32((int)x) }; }
+
+    static U32Lanes counters(uint32_t first)
+    {
+        __m512i offsets = _mm512_setr_epi32(
+            0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        return { _mm512_add_epi32(_mm512_set1_epi32((int)first), offsets) };
+    }
+
+    friend U32Lanes operator+(U32Lanes a, U32Lanes b)
+    {
+        return { _mm512_add_epi32(a.v, b.v) };
+    }
+
+    friend U32Lanes operator^(U32Lanes a, U32Lanes b)
+    {
+        return { _mm512_xor_si512(a.v, b.v) };
+    }
+
+    template <int R>
+    U32Lanes rotl() const { return { _mm512_rol_epi32(v, R) }; }
+
+    void store(uint32_t *out) const
+    {
+        _mm512_storeu_si512((void *)out, v);
+    }
+
+    // Vector form of bitsToFloat01: (bits >> 8) * 2^-24. Both steps are
+    // exact, so this matches the scalar conversion bit for bit.
+    void storeFloat01(float *out) const
+    {
+        __m512 f = _mm512_cvtepi32_ps(_mm512_srli_epi32(v, 8));
+        _mm512_storeu_ps(out, _mm512_mul_ps(f, _mm512_set1_ps(0x1p-24f)));
+    }
+};
+
+#elif defined(MADRONA_RAND_AVX2)
+
+struct U32Lanes {
+    static constexpr CountT width = 8;
+
+    __m256i v;
+
+    static U32Lanes splat(uint32_t x) { return { _mm256_set1_epi32((int)x) }; }
+
+    static U32Lanes counters(uint32_t first)
+    {
+        __m256i offsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        return { _mm256_add_epi32(_mm256_set1_epi32((int)first), offsets) };
+    }
+
+    friend U32Lanes operator+(U32Lanes a, U32Lanes b)
+    {
+        return { _mm256_add_epi32(a.v, b.v) };
+    }
+
+    friend U32Lanes operator^(U32Lanes a, U32Lanes b)
+    {
+        return { _mm256_xor_si256(a.v, b.v) };
+    }
+
+    template <int R>
+    U32Lanes rotl() const
+    {
+        return { _mm256_or_si256(_mm256_slli_epi32(v, R),
+                                 _mm256_srli_epi32(v, 32 - R)) };
+    }
+
+    void store(uint32_t *out) const
+    {
+        _mm256_storeu_si256((__m256i *)out, v);
+    }
+
+    void storeFloat01(float *out) const
+    {
+        __m256 f = _mm256_cvtepi32_ps(_mm256_srli_epi32(v, 8));
+        _mm256_storeu_ps(out, _mm256_mul_ps(f, _mm256_set1_ps(0x1p-24f)));
+    }
+};
+
+#endif
+
+#if defined(MADRONA_RAND_AVX512) || defined(MADRONA_RAND_AVX2)
+
+#define MADRONA_RAND_SIMD 1
+
+struct KeyLanes {
+    U32Lanes a;
+    U32Lanes b;
+};
+
+template <int R>
+inline void threefryRound(U32Lanes &x0, U32Lanes &x1)
+{
+    x0 = x0 + x1;
+    x1 = x1.rotl<R>();
+    x1 = x1 ^ x0;
+}
+
+template <int R0, int R1, int R2, int R3>
+inline void threefryRounds4(U32Lanes &x0, U32Lanes &x1)
+{
+    threefryRound<R0>(x0, x1);
+    threefryRound<R1>(x0, x1);
+    threefryRound<R2>(x0, x1);
+    threefryRound<R3>(x0, x1);
+}
+
+// split_i(src, first + lane) for every lane, with idx_upper = 0.
+inline KeyLanes splitLanes(RandKey src, uint32_t first)
+{
+    U32Lanes ks0 = U32Lanes::splat(src.a);
+    U32Lanes ks1 = U32Lanes::splat(src.b);
+    U32Lanes ks2 = U32Lanes::splat(0x1BD11BDA ^ src.a ^ src.b);
+
+    U32Lanes x0 = U32Lanes::counters(first) + ks0;
+    U32Lanes x1 = ks1;
+
+    threefryRounds4<13, 15, 26, 6>(x0, x1);
+    x0 = x0 + ks1;
+    x1 = x1 + ks2 + U32Lanes::splat(1);
+    threefryRounds4<17, 29, 16, 24>(x0, x1);
+    x0 = x0 + ks2;
+    x1 = x1 + ks0 + U32Lanes::splat(2);
+    threefryRounds4<13, 15, 26, 6>(x0, x1);
+    x0 = x0 + ks0;
+    x1 = x1 + ks1 + U32Lanes::splat(3);
+    threefryRounds4<17, 29, 16, 24>(x0, x1);
+    x0 = x0 + ks1;
+    x1 = x1 + ks2 + U32Lanes::splat(4);
+    threefryRounds4<13, 15, 26, 6>(x0, x1);
+
+    return {
+        x0 + ks2,
+        x1 + ks0 + U32Lanes::splat(5),
+    };
+}
+
+#endif
+
+}
+
+void splitN(RandKey src, RandKey *out, CountT n, uint32_t first_idx)
+{
+    CountT i = 0;
+
+#ifdef MADRONA_RAND_SIMD
+    constexpr CountT W = U32Lanes::width;
+    for (; i + W <= n; i += W) {
+        KeyLanes k = splitLanes(src, first_idx + (uint32_t)i);
+
+        uint32_t a[W], b[W];
+        k.a.store(a);
+        k.b.store(b);
+
+        for (CountT j = 0; j < W; j++) {
+            out[i + j] = RandKey { a[j], b[j] };
+        }
+    }
+#endif
+
+    for (; i < n; i++) {
+        out[i] = split_i(src, first_idx + (uint32_t)i);
+    }
+}
+
+void fillUniform(RandKey src, float *out, CountT n, uint32_t first_idx)
+{
+    CountT i = 0;
+
+#ifdef MADRONA_RAND_SIMD
+    constexpr CountT W = U32Lanes::width;
+    for (; i + W <= n; i += W) {
+        KeyLanes k = splitLanes(src, first_idx + (uint32_t)i);
+        (k.a ^ k.b).storeFloat01(out + i);
+    }
+#endif
+
+    for (; i < n; i++) {
+        out[i] = sampleUniform(split_i(src, first_idx + (uint32_t)i));
+    }
+}
+
+void fillNormal(RandKey src, float *out, CountT n, uint32_t first_idx)
+{
+    CountT i = 0;
+
+#ifdef MADRONA_RAND_SIMD
+    // Only key generation is vectorized. The transcendental part goes
+    // through the scalar libm calls so results match sampleNormal exactly;
+    // a vector log / cos approximation would differ in the last bits.
+    constexpr CountT W = U32Lanes::width;
+    for (; i + W <= n; i += W) {
+        KeyLanes k = splitLanes(src, first_idx + (uint32_t)i);
+
+        uint32_t a[W], b[W];
+        k.a.store(a);
+        k.b.store(b);
+
+        for (CountT j = 0; j < W; j++) {
+            out[i + j] = sampleNormal(RandKey { a[j], b[j] });
+        }
+    }
+#endif
+
+    for (; i < n; i++) {
+        out[i] = sampleNormal(split_i(src, first_idx + (uint32_t)i));
+    }
+}
+
+void fillI32Range(RandKey src, int32_t *out, CountT n, int32_t a, int32_t b,
+                  uint32_t first_idx)
+{
+    CountT i = 0;
+
+#ifdef MADRONA_RAND_SIMD
+    uint32_t s = (uint32_t)(b - a);
+
+    constexpr CountT W = U32Lanes::width;
+    for (; i + W <= n; i += W) {
+        uint32_t first = first_idx + (uint32_t)i;
+        KeyLanes k = splitLanes(src, first);
+
+        uint32_t bits[W];
+        (k.a ^ k.b).store(bits);
+
+        for (CountT j = 0; j < W; j++) {
+            uint64_t m = (uint64_t)bits[j] * (uint64_t)s;
+            uint32_t l = (uint32_t)m;
+            uint32_t h = (uint32_t)(m >> 32);
+
+            if (l < s) [[unlikely]] {
+                // Possible rejection, defer to the scalar loop so the
+                // resampling sequence is the same.
+                RandKey lane_k = split_i(src, first + (uint32_t)j);
+                out[i + j] = sampleI32(lane_k, a, b);
+            } else {
+                out[i + j] = (int32_t)h + a;
+            }
+        }
+    }
+#endif
+
+    for (; i < n; i++) {
+        out[i] = sampleI32(split_i(src, first_idx + (uint32_t)i), a, b);
+    }
+}
+
+}
@@ -2,6 +2,7 @@
 #include <madrona/physics.hpp>
 
 #include "physics_impl.hpp"
+#include "primitive_contacts.hpp"
 
 namespace madrona::phys::broadphase {
 
@@ -9,10 +10,301 @@ using namespace base;
 using namespace math;
 using namespace geo;
 
+static inline uint32_t numGridBuckets(CountT max_leaves)
+{
+    uint32_t num_buckets = 16;
+    while ((CountT)num_buckets < 2 * max_leaves) {
+        num_buckets *= 2;
+    }
+
+    return num_buckets;
+}
+
+UniformGrid::UniformGrid(CountT max_leaves, float cell_size)
+    : level_cell_sizes_(),
+      inv_level_cell_sizes_(),
+      bucket_mask_(numGridBuckets(max_leaves) - 1),
+      bucket_starts_((int32_t *)rawAlloc(
+          sizeof(int32_t) * (numGridBuckets(max_leaves) + 1))),
+      entry_keys_((CellKey *)rawAlloc(sizeof(CellKey) * max_leaves)),
+      entry_aabbs_((AABB *)rawAlloc(sizeof(AABB) * max_leaves)),
+      entry_leaves_((int32_t *)rawAlloc(sizeof(int32_t) * max_leaves)),
+      leaf_keys_((CellKey *)rawAlloc(sizeof(CellKey) * max_leaves)),
+      leaf_buckets_((uint32_t *)rawAlloc(sizeof(uint32_t) * max_leaves)),
+      large_leaves_((int32_t *)rawAlloc(sizeof(int32_t) * max_leaves)),
+      num_large_(0),
+      num_entries_(0),
+      occupied_levels_(0),
+      bounds_(AABB::invalid())
+{
+    assert(cell_size > 0.f);
+
+    for (int32_t i = 0; i < maxLevels; i++) {
+        level_cell_sizes_[i] = cell_size;
+        inv_level_cell_sizes_[i] = 1.f / cell_size;
+        cell_size *= 2.f;
+    }
+}
+
+void UniformGrid::build(const AABB *leaf_aabbs, CountT num_leaves)
+{
+    constexpr uint32_t large_bucket = 0xFFFF'FFFF_u32;
+    const uint32_t num_buckets = bucket_mask_ + 1;
+
+    num_large_ = 0;
+    num_entries_ = 0;
+    occupied_levels_ = 0;
+    bounds_ = AABB::invalid();
+
+    for (uint32_t i = 0; i <= num_buckets; i++) {
+        bucket_starts_[i] = 0;
+    }
+
+    // Count leaves per bucket
+    for (CountT leaf_idx = 0; leaf_idx < num_leaves; leaf_idx++) {
+        const AABB &leaf_aabb = leaf_aabbs[leaf_idx];
+
+        CellKey &key = leaf_keys_[leaf_idx];
+        if (!leafCell(leaf_aabb, &key)) {
+            leaf_buckets_[leaf_idx] = large_bucket;
+            large_leaves_[num_large_++] = (int32_t)leaf_idx;
+            continue;
+        }
+
+        uint32_t bucket = bucketIdx(key);
+        leaf_buckets_[leaf_idx] = bucket;
+        bucket_starts_[bucket] += 1;
+
+        num_entries_ += 1;
+        occupied_levels_ |= 1_u32 << key.level;
+        bounds_ = AABB::merge(bounds_, leaf_aabb);
+    }
+
+    // Inclusive prefix sum, so each start is the end of its bucket until
+    // the scatter below moves it back
+    for (uint32_t i = 1; i < num_buckets; i++) {
+        bucket_starts_[i] += bucket_starts_[i - 1];
+    }
+    bucket_starts_[num_buckets] = num_entries_;
+
+    // Scatter back to front to keep leaves in order within each bucket
+    for (CountT leaf_idx = num_leaves - 1; leaf_idx >= 0; leaf_idx--) {
+        uint32_t bucket = leaf_buckets_[leaf_idx];
+        if (bucket == large_bucket) {
+            continue;
+        }
+
+        int32_t entry_idx = --bucket_starts_[bucket];
+        entry_keys_[entry_idx] = leaf_keys_[leaf_idx];
+        entry_aabbs_[entry_idx] = leaf_aabbs[leaf_idx];
+        entry_leaves_[entry_idx] = (int32_t)leaf_idx;
+    }
+}
+
+SweepAndPrune::SweepAndPrune(CountT max_leaves)
+    : sort_axis_(0),
+      order_((int32_t *)rawAlloc(sizeof(int32_t) * max_leaves)),
+      min_keys_((float *)rawAlloc(sizeof(float) * max_leaves)),
+      tmp_order_((int32_t *)rawAlloc(sizeof(int32_t) * max_leaves)),
+      tmp_min_keys_((float *)rawAlloc(sizeof(float) * max_leaves)),
+      sorted_aabbs_((AABB *)rawAlloc(sizeof(AABB) * max_leaves)),
+      large_leaves_((int32_t *)rawAlloc(sizeof(int32_t) * max_leaves)),
+      num_large_(0),
+      num_leaves_(-1),
+      max_width_(0.f),
+      bounds_(AABB::invalid())
+{}
+
+// Sorts along the axis where the leaf centers are most spread out, which
+// leaves the fewest leaves in each query's range (RTCD 7.5.2)
+void SweepAndPrune::chooseAxis(const AABB *leaf_aabbs)
+{
+    Vector3 sum = Vector3::zero();
+    Vector3 sum2 = Vector3::zero();
+    CountT num_finite = 0;
+
+    for (CountT i = 0; i < (CountT)num_leaves_; i++) {
+        Vector3 center = (leaf_aabbs[i].pMin + leaf_aabbs[i].pMax) / 2.f;
+
+        // Also false for NaN and infinite centers
+        if (!(fabsf(center.x) <= FLT_MAX && fabsf(center.y) <= FLT_MAX &&
+                fabsf(center.z) <= FLT_MAX)) {
+            continue;
+        }
+
+        sum += center;
+        sum2 += Vector3 {
+            center.x * center.x,
+            center.y * center.y,
+            center.z * center.z,
+        };
+        num_finite += 1;
+    }
+
+    sort_axis_ = 0;
+    if (num_finite == 0) {
+        return;
+    }
+
+    Vector3 mean = sum / float(num_finite);
+    Vector3 variance = sum2 / float(num_finite) - Vector3 {
+        mean.x * mean.x,
+        mean.y * mean.y,
+        mean.z * mean.z,
+    };
+
+    if (variance.y > variance[sort_axis_]) {
+        sort_axis_ = 1;
+    }
+    if (variance.z > variance[sort_axis_]) {
+        sort_axis_ = 2;
+    }
+}
+
+// Bottom up merge sort of order_ by min_keys_. Only used when the leaf set
+// changes, otherwise the previous order is almost sorted already.
+void SweepAndPrune::sortFull()
+{
+    const CountT n = num_leaves_;
+
+    for (CountT width = 1; width < n; width *= 2) {
+        for (CountT lo = 0; lo < n; lo += 2 * width) {
+            CountT mid = std::min(lo + width, n);
+            CountT hi = std::min(lo + 2 * width, n);
+
+            CountT a = lo, b = mid, out = lo;
+            while (a < mid && b < hi) {
+                // Ties take from the left run to keep the sort stable
+                CountT src = min_keys_[b] < min_keys_[a] ? b++ : a++;
+                tmp_order_[out] = order_[src];
+                tmp_min_keys_[out] = min_keys_[src];
+                out++;
+            }
+
+            while (a < mid) {
+                tmp_order_[out] = order_[a];
+                tmp_min_keys_[out] = min_keys_[a];
+                out++;
+                a++;
+            }
+
+            while (b < hi) {
+                tmp_order_[out] = order_[b];
+                tmp_min_keys_[out] = min_keys_[b];
+                out++;
+                b++;
+            }
+        }
+
+        std::swap(order_, tmp_order_);
+        std::swap(min_keys_, tmp_min_keys_);
+    }
+}
+
+void SweepAndPrune::build(const AABB *leaf_aabbs, CountT num_leaves)
+{
+    bool full_sort = num_leaves != (CountT)num_leaves_;
+    num_leaves_ = (int32_t)num_leaves;
+
+    if (full_sort) {
+        for (CountT i = 0; i < num_leaves; i++) {
+            order_[i] = (int32_t)i;
+        }
+    } else {
+        for (CountT i = 0; i < num_leaves; i++) {
+            min_keys_[i] = leaf_aabbs[order_[i]].pMin[sort_axis_];
+        }
+
+        // Insertion sort is close to linear for the small frame to frame
+        // motion. Give up on it if the order changed a lot (e.g. the leaf
+        // IDs were reassigned on reset).
+        CountT max_moves = 4 * num_leaves;
+        CountT num_moves = 0;
+        for (CountT i = 1; i < num_leaves && num_moves <= max_moves; i++) {
+            int32_t leaf_idx = order_[i];
+            float key = min_keys_[i];
+
+            CountT j = i;
+            while (j > 0 && min_keys_[j - 1] > key) {
+                order_[j] = order_[j - 1];
+                min_keys_[j] = min_keys_[j - 1];
+                j--;
+            }
+
+            order_[j] = leaf_idx;
+            min_keys_[j] = key;
+            num_moves += i - j;
+        }
+
+        full_sort = num_moves > max_moves;
+    }
+
+    if (full_sort) {
+        chooseAxis(leaf_aabbs);
+
+        for (CountT i = 0; i < num_leaves; i++) {
+            min_keys_[i] = leaf_aabbs[order_[i]].pMin[sort_axis_];
+        }
+
+        sortFull();
+    }
+
+    float width_sum = 0.f;
+    CountT num_finite = 0;
+    for (CountT i = 0; i < num_leaves; i++) {
+        const AABB &leaf_aabb = leaf_aabbs[i];
+        float width = leaf_aabb.pMax[sort_axis_] - leaf_aabb.pMin[sort_axis_];
+
+        // Also false for NaN and infinite widths
+        if (width <= FLT_MAX) {
+            width_sum += width;
+            num_finite += 1;
+        }
+    }
+
+    float large_width = num_finite > 0 ?
+        largeWidthScale * width_sum / float(num_finite) : 0.f;
+
+    num_large_ = 0;
+    bounds_ = AABB::invalid();
+    float max_width = 0.f;
+    for (CountT i = 0; i < num_leaves; i++) {
+        int32_t leaf_idx = order_[i];
+        const AABB &leaf_aabb = leaf_aabbs[leaf_idx];
+
+        bool finite = true;
+#pragma unroll
+        for (CountT j = 0; j < 3; j++) {
+            finite = finite && fabsf(leaf_aabb.pMin[j]) <= FLT_MAX &&
+                fabsf(leaf_aabb.pMax[j]) <= FLT_MAX;
+        }
+
+        float width = leaf_aabb.pMax[sort_axis_] - leaf_aabb.pMin[sort_axis_];
+        if (!finite || width > large_width) {
+            // Inverted infinite bounds, so even unbounded queries don't
+            // overlap the slot
+            sorted_aabbs_[i] = AABB {
+                /* .pMin = */ Vector3 { INFINITY, INFINITY, INFINITY },
+                /* .pMax = */ Vector3 { -INFINITY, -INFINITY, -INFINITY },
+            };
+            large_leaves_[num_large_++] = leaf_idx;
+            continue;
+        }
+
+        sorted_aabbs_[i] = leaf_aabb;
+        max_width = fmaxf(max_width, width);
+        bounds_ = AABB::merge(bounds_, leaf_aabb);
+    }
+
+    // Slack for rounding in the query's min_key - max_width_
+    max_width_ = max_width * 1.001f;
+}
+
 BVH::BVH(const ObjectManager *obj_mgr,
          CountT max_leaves,
          float leaf_velocity_expansion,
-         float leaf_accel_expansion)
+         float leaf_accel_expansion,
+         const Config &config)
     : nodes_((Node *)rawAlloc(sizeof(Node) *
                             numInternalNodes(max_leaves))),
       num_nodes_(0),
@@ -30,7 +322,11 @@ BVH::BVH(const ObjectManager *obj_mgr,
       num_allocated_leaves_(max_leaves),
       leaf_velocity_expansion_(leaf_velocity_expansion),
       leaf_accel_expansion_(leaf_accel_expansion),
-      force_rebuild_(true)
+      force_rebuild_(true),
+      backend_(config.backend),
+      grid_(config.backend == Backend::UniformGrid ? max_leaves : 0,
+            config.gridCellSize),
+      sap_(config.backend == Backend::SweepAndPrune ? max_leaves : 0)
 {}
 
 CountT BVH::numInternalNodes(CountT num_leaves) const
@@ -547,6 +843,11 @@ MADRONA_ALWAYS_INLINE static inline float atomicMaxF(float *addr, float value)
 
 void BVH::refitLeaf(LeafID leaf_id, const AABB &leaf_aabb)
 {
+    // The other backends are rebuilt by finishRefit instead
+    if (backend_ != Backend::BVH) {
+        return;
+    }
+
     uint32_t leaf_parent = leaf_parents_[leaf_id.id];
 
     int32_t node_idx = int32_t(leaf_parent >> 2_u32);
@@ -646,6 +947,14 @@ void BVH::refitLeaf(LeafID leaf_id, const AABB &leaf_aabb)
 
 void BVH::updateTree()
 {
+    if (backend_ != Backend::BVH) {
+        // Neither structure is refit in place, so they're rebuilt from
+        // scratch every time the leaves are updated
+        force_rebuild_ = false;
+        finishRefit();
+        return;
+    }
+
     if (force_rebuild_) {
         force_rebuild_ = false;
         rebuild();
@@ -653,72 +962,29 @@ void BVH::updateTree()
     //rebuild();
 }
 
+void BVH::finishRefit()
+{
+    CountT num_leaves = num_leaves_.load_relaxed();
+
+    switch (backend_) {
+    case Backend::UniformGrid: {
+        grid_.build(leaf_aabbs_, num_leaves);
+    } break;
+    case Backend::SweepAndPrune: {
+        sap_.build(leaf_aabbs_, num_leaves);
+    } break;
+    default: break;
+    }
+}
+
 Entity BVH::traceRay(Vector3 o,
                      Vector3 d,
                      float *out_hit_t,
                      Vector3 *out_hit_normal,
                      float t_max)
 {
-    using namespace math;
-
-    Diag3x3 inv_d = Diag3x3::fromVec(d).inv();
-
-    int32_t stack[32];
-    stack[0] = 0;
-    CountT stack_size = 1;
-
-    Entity closest_hit_entity = Entity::none();
-    Vector3 closest_hit_normal;
-
-    while (stack_size > 0) { 
-        int32_t node_idx = stack[--stack_size];
-        const Node &node = nodes_[node_idx];
-        for (int i = 0; i < 4; i++) {
-            if (!node.hasChild(i)) {
-                continue; // Technically this could be break?
-            };
-
-            madrona::math::AABB child_aabb {
-                /* .pMin = */ {
-                    node.minX[i],
-                    node.minY[i],
-                    node.minZ[i],
-                },
-                /* .pMax = */ {
-                    node.maxX[i],
-                    node.maxY[i],
-                    node.maxZ[i],
-                },
-            };
-
-            if (child_aabb.rayIntersects(o, inv_d, 0.f, t_max)) {
-                if (node.isLeaf(i)) {
-                    int32_t leaf_idx = node.leafIDX(i);
-                    
-                    float hit_t;
-                    Vector3 leaf_hit_normal;
-                    bool leaf_hit = traceRayIntoLeaf(
-                        leaf_idx, o, d, 0.f, t_max, &hit_t, &leaf_hit_normal);
-
-                    if (leaf_hit) {
-                        t_max = hit_t;
-                        closest_hit_entity = leaf_entities_[leaf_idx];
-                        closest_hit_normal = leaf_hit_normal;
-                    }
-                } else {
-                    stack[stack_size++] = node.children[i];
-                }
-            }
-        }
-    }
-    
-    if (closest_hit_entity == Entity::none()) {
-        return Entity::none();
-    }
-
-    *out_hit_t = t_max;
-    *out_hit_normal = closest_hit_normal;
-    return closest_hit_entity;
+    return traceRayFiltered(o, d, out_hit_t, out_hit_normal, t_max,
+                            [](Entity) { return true; });
 }
 
 static inline bool traceRayIntoPlane(
@@ -747,6 +1013,103 @@ static inline bool traceRayIntoPlane(
     return true;
 }
 
+// ray_o and ray_d are in the space of the capsule, which is centered on the
+// origin with its segment along Z
+static inline bool traceRayIntoCapsule(
+    const CollisionPrimitive::Capsule &capsule,
+    Vector3 ray_o, Vector3 ray_d,
+    float t_min, float t_max,
+    float *hit_t,
+    Vector3 *hit_normal)
+{
+    float half_height = 0.5f * capsule.cylinderHeight;
+
+    // intersectRayZOriginCapsule needs a normalized direction and the
+    // segment starting at the origin
+    float ray_d_len = ray_d.length();
+    Vector3 base_ray_o = ray_o;
+    base_ray_o.z += half_height;
+
+    float t = intersectRayZOriginCapsule(base_ray_o, ray_d / ray_d_len,
+        capsule.radius, capsule.cylinderHeight);
+
+    if (t == FLT_MAX) {
+        return false;
+    }
+
+    t /= ray_d_len;
+    if (t < t_min || t > t_max) {
+        return false;
+    }
+
+    Vector3 hit_pos = ray_o + t * ray_d;
+    Vector3 core_pos {
+        0,
+        0,
+        fminf(fmaxf(hit_pos.z, -half_height), half_height),
+    };
+
+    Vector3 from_core = hit_pos - core_pos;
+    float from_core_len2 = from_core.length2();
+
+    *hit_t = t;
+    *hit_normal = from_core_len2 > 0.f ?
+        from_core / sqrtf(from_core_len2) : Vector3 { 0, 0, 1 };
+    return true;
+}
+
+// Slab test. ray_o and ray_d are in the space of the box, which is centered
+// on the origin.
+static inline bool traceRayIntoBox(
+    const CollisionPrimitive::Box &box,
+    Vector3 ray_o, Vector3 ray_d,
+    float t_min, float t_max,
+    float *hit_t,
+    Vector3 *hit_normal)
+{
+    Vector3 h = box.halfExtents;
+
+    float t_first = t_min;
+    float t_last = t_max;
+    Vector3 first_normal = Vector3::zero();
+
+#pragma unroll
+    for (CountT i = 0; i < 3; i++) {
+        if (ray_d[i] == 0.f) {
+            if (ray_o[i] < -h[i] || ray_o[i] > h[i]) {
+                return false;
+            }
+            continue;
+        }
+
+        float inv_d = 1.f / ray_d[i];
+        float t_near = (-h[i] - ray_o[i]) * inv_d;
+        float t_far = (h[i] - ray_o[i]) * inv_d;
+
+        float near_sign = -1.f;
+        if (t_near > t_far) {
+            std::swap(t_near, t_far);
+            near_sign = 1.f;
+        }
+
+        if (t_near > t_first) {
+            t_first = t_near;
+            first_normal = Vector3::zero();
+            first_normal[i] = near_sign;
+        }
+
+        t_last = fminf(t_last, t_far);
+
+        if (t_first > t_last) {
+            return false;
+        }
+    }
+
+    *hit_t = t_first;
+    *hit_normal = first_normal;
+    return true;
+}
+
 // RTCD 5.3.8 (modified from segment to ray). Algorithm also in GPU Gems 2.
 // Intersect ray r(t)=ray_o + , t_min <= t <=t_max against convex polyhedron
 // specified by the n halfspaces defined by the planes p[]. On exit tfirst
@@ -866,6 +1229,26 @@ bool BVH::traceRayIntoLeaf(int32_t leaf_idx,
             hit_prim = traceRayIntoPlane(
                 obj_ray_o, obj_ray_d, t_min, t_max, hit_t, &obj_hit_normal);
         } break;
+        case CollisionPrimitive::Type::Capsule: {
+            hit_prim = traceRayIntoCapsule(prim->capsule,
+                obj_ray_o, obj_ray_d, t_min, t_max, hit_t, &obj_hit_normal);
+        } break;
+        case CollisionPrimitive::Type::Box: {
+            hit_prim = traceRayIntoBox(prim->box,
+                obj_ray_o, obj_ray_d, t_min, t_max, hit_t, &obj_hit_normal);
+        } break;
+        case CollisionPrimitive::Type::Heightfield: {
+            // The ray is already in unscaled object space
+            hit_prim = prims::traceRayIntoHeightfield(
+                prims::makeHeightfieldShape(prim->heightfield,
+                                            Diag3x3 { 1, 1, 1 }),
+                obj_ray_o, obj_ray_d, t_min, t_max, hit_t, &obj_hit_normal);
+        } break;
+        case CollisionPrimitive::Type::TriangleMesh: {
+            hit_prim = prim->triangleMesh.bvh.traceRay(
+                obj_ray_o, obj_ray_d, hit_t, &obj_hit_normal, t_max) &&
+                *hit_t >= t_min;
+        } break;
         case CollisionPrimitive::Type::Sphere: {
             assert(false);
         } break;
@@ -903,6 +1286,24 @@ inline void updateLeafPositionsEntry(
     bvh.updateLeafPosition(leaf_id, pos, rot, scale, vel.linear, obj_aabb);
 }
 
+// Sleeping bodies don't move during the physics step, so their leaves can be
+// left alone after integration
+inline void updateAwakeLeafPositionsEntry(
+    Context &ctx,
+    const LeafID &leaf_id,
+    const Position &pos,
+    const Rotation &rot,
+    const Scale &scale,
+    const ObjectID &obj_id,
+    const Velocity &vel)
+{
+    if (ctx.singleton<IslandState>().isAsleep(leaf_id)) {
+        return;
+    }
+
+    updateLeafPositionsEntry(ctx, leaf_id, pos, rot, scale, obj_id, vel);
+}
+
 // FIXME currently unused
 inline void expandLeavesEntry(
     Context &ctx,
@@ -919,12 +1320,26 @@ inline void updateBVHEntry(Context &, BVH &bvh)
     bvh.updateTree();
 }
 
+inline void finishRefitEntry(Context &, BVH &bvh)
+{
+    bvh.finishRefit();
+}
+
 inline void refitEntry(Context &ctx, LeafID leaf_id)
 {
     BVH &bvh = ctx.singleton<BVH>();
     bvh.refitLeaf(leaf_id, bvh.getLeafAABB(leaf_id));
 }
 
+inline void refitAwakeEntry(Context &ctx, LeafID leaf_id)
+{
+    if (ctx.singleton<IslandState>().isAsleep(leaf_id)) {
+        return;
+    }
+
+    refitEntry(ctx, leaf_id);
+}
+
 inline void findIntersectingEntry(
     Context &ctx,
     const Entity &e,
@@ -932,30 +1347,34 @@ inline void findIntersectingEntry(
 {
     BVH &bvh = ctx.singleton<BVH>();
     ObjectManager &obj_mgr = *ctx.singleton<ObjectData>().mgr;
+    const IslandState &islands = ctx.singleton<IslandState>();
+
+    // Static and sleeping bodies never need to collide with each other, so
+    // they don't search the BVH themselves. Pairs between them and an active
+    // body are emitted from the active body's side.
+    auto isActive = [&](Loc loc, LeafID leaf) {
+        return ctx.getDirect<ResponseType>(RGDCols::ResponseType, loc) !=
+            ResponseType::Static && !islands.isAsleep(leaf);
+    };
 
     // FIXME: should have a flag for passing this
     // directly into the system
     Loc a_loc = ctx.loc(e);
-    bool a_is_static = 
-        ctx.getDirect<ResponseType>(RGDCols::ResponseType, a_loc) ==
-        ResponseType::Static;
+    if (!isActive(a_loc, leaf_id)) {
+        return;
+    }
 
     ObjectID a_obj = ctx.getDirect<ObjectID>(RGDCols::ObjectID, a_loc);
 
     CountT a_num_prims = obj_mgr.rigidBodyPrimitiveCounts[a_obj.idx];
 
     bvh.findLeafIntersecting(leaf_id, [&](Entity intersecting_entity) {
-        if (e.id < intersecting_entity.id) {
-            Loc b_loc = ctx.loc(intersecting_entity);
-
-            // FIXME: Change this so static objects are kept in a separate BVH
-            // and this check can be removed.
-            if (a_is_static &&
-                ctx.getDirect<ResponseType>(RGDCols::ResponseType, b_loc) ==
-                    ResponseType::Static) {
-                return;
-            }
+        Loc b_loc = ctx.loc(intersecting_entity);
+        LeafID b_leaf =
+            ctx.getDirect<LeafID>(RGDCols::LeafID, b_loc);
 
+        // Pairs of active bodies are emitted once, from the lower ID
+        if (!isActive(b_loc, b_leaf) || e.id < intersecting_entity.id) {
             // We don't expand the primitive AABBs by movement (only object
             // AABBs) so we just unconditionally emit narrowphase checks
             // between each pair of primitives in the entity. Narrowphase
@@ -1035,7 +1454,8 @@ TaskGraphNodeID setupPostIntegrationTasks(
 
     // FIXME: can we avoid doing a full tree refit here?
     auto update_leaves =
-        builder.addToGraph<ParallelForNode<Context, updateLeafPositionsEntry,
+        builder.addToGraph<ParallelForNode<Context,
+            updateAwakeLeafPositionsEntry,
             LeafID, 
             Position,
             Rotation,
@@ -1044,9 +1464,12 @@ TaskGraphNodeID setupPostIntegrationTasks(
             Velocity>>(deps);
 
     auto refit = builder.addToGraph<ParallelForNode<Context,
-        broadphase::refitEntry, broadphase::LeafID>>({update_leaves});
+        broadphase::refitAwakeEntry, broadphase::LeafID>>({update_leaves});
 
-    return refit;
+    auto finish_refit = builder.addToGraph<ParallelForNode<Context,
+        broadphase::finishRefitEntry, broadphase::BVH>>({refit});
+
+    return finish_refit;
 }
 
 }
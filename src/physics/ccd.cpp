@@ -0,0 +1,442 @@
+#include <madrona/physics.hpp>
+#include <madrona/context.hpp>
+
+#include "physics_impl.hpp"
+#include "gjk.hpp"
+
+namespace madrona::phys {
+
+using namespace base;
+using namespace math;
+
+CCDState::CCDState(CountT max_leaves)
+{
+    bodies = (Body *)rawAlloc(sizeof(Body) * max_leaves);
+    maxLeaves = max_leaves;
+
+    clear();
+}
+
+void CCDState::clear()
+{
+    for (CountT i = 0; i < maxLeaves; i++) {
+        bodies[i] = Body {
+            .startPosition = Vector3::zero(),
+            .enabled = 0,
+        };
+    }
+}
+
+}
+
+namespace madrona::phys::ccd {
+
+using namespace base;
+using namespace math;
+
+namespace {
+
+// World space pose of a rigid body during the sweep
+struct SweepPose {
+    Vector3 pos;
+    Quat rot;
+    Diag3x3 scale;
+};
+
+// A flagged body's primitive, or one it can hit, placed in the world
+struct SweepPrimitive {
+    const CollisionPrimitive *prim;
+    SweepPose pose;
+};
+
+}
+
+inline void recordStartPositions(Context &ctx,
+                                 broadphase::LeafID leaf_id,
+                                 const Position &pos)
+{
+    CCDState::Body &body = ctx.singleton<CCDState>().bodies[leaf_id.id];
+
+    if (body.enabled) {
+        body.startPosition = pos;
+    }
+}
+
+static inline bool isConvex(CollisionPrimitive::Type type)
+{
+    switch (type) {
+    case CollisionPrimitive::Type::Sphere:
+    case CollisionPrimitive::Type::Hull:
+    case CollisionPrimitive::Type::Capsule:
+    case CollisionPrimitive::Type::Box: {
+        return true;
+    }
+    default: {
+        return false;
+    }
+    }
+}
+
+// Point of a convex primitive furthest along world space direction v
+static inline Vector3 supportPoint(const SweepPrimitive &p, Vector3 v)
+{
+    const CollisionPrimitive &prim = *p.prim;
+    const SweepPose &pose = p.pose;
+
+    auto radiusOffset = [v](float radius) {
+        float v_len = v.length();
+        return v_len > 0.f ? (radius / v_len) * v : Vector3::zero();
+    };
+
+    switch (prim.type) {
+    case CollisionPrimitive::Type::Sphere: {
+        return pose.pos + radiusOffset(pose.scale.d0 * prim.sphere.radius);
+    }
+    case CollisionPrimitive::Type::Capsule: {
+        Vector3 axis = pose.rot.rotateVec(math::up);
+        float half_height =
+            0.5f * pose.scale.d2 * prim.capsule.cylinderHeight;
+        if (dot(axis, v) < 0.f) {
+            half_height = -half_height;
+        }
+
+        return pose.pos + half_height * axis +
+            radiusOffset(pose.scale.d0 * prim.capsule.radius);
+    }
+    case CollisionPrimitive::Type::Box: {
+        Vector3 local_v = pose.rot.inv().rotateVec(v);
+        Vector3 h = pose.scale * prim.box.halfExtents;
+        Vector3 corner {
+            copysignf(h.x, local_v.x),
+            copysignf(h.y, local_v.y),
+            copysignf(h.z, local_v.z),
+        };
+
+        return pose.pos + pose.rot.rotateVec(corner);
+    }
+    case CollisionPrimitive::Type::Hull: {
+        const geo::HalfEdgeMesh &mesh = prim.hull.halfEdgeMesh;
+
+        // The support of a scaled hull is the scaled support of the hull in
+        // the scaled direction
+        Vector3 local_v = pose.scale * pose.rot.inv().rotateVec(v);
+
+        Vector3 support = mesh.vertices[0];
+        float max_dot = dot(support, local_v);
+        for (CountT i = 1; i < (CountT)mesh.numVertices; i++) {
+            float vert_dot = dot(mesh.vertices[i], local_v);
+            if (vert_dot > max_dot) {
+                max_dot = vert_dot;
+                support = mesh.vertices[i];
+            }
+        }
+
+        return pose.pos + pose.rot.rotateVec(pose.scale * support);
+    }
+    default: MADRONA_UNREACHABLE();
+    }
+}
+
+// Distance between a convex primitive a and b, which is either convex or a
+// plane. Returns 0 if they overlap, otherwise also the direction from the
+// closest point on a to the closest point on b.
+static inline float primitiveDistance(const SweepPrimitive &a,
+                                      const SweepPrimitive &b,
+                                      Vector3 *normal)
+{
+    if (b.prim->type == CollisionPrimitive::Type::Plane) {
+        Vector3 plane_normal = b.pose.rot.rotateVec(math::up);
+        Vector3 deepest = supportPoint(a, -plane_normal);
+
+        *normal = -plane_normal;
+        return fmaxf(dot(plane_normal, deepest - b.pose.pos), 0.f);
+    }
+
+    auto supportFn = [&](Vector3 v, Vector3 *a_support_out,
+                         Vector3 *b_support_out) {
+        Vector3 a_support = supportPoint(a, v);
+        Vector3 b_support = supportPoint(b, -v);
+
+        *a_support_out = a_support;
+        *b_support_out = b_support;
+
+        return a_support - b_support;
+    };
+
+    Vector3 init_v = a.pose.pos - b.pose.pos;
+    if (init_v.length2() == 0.f) {
+        init_v = math::up;
+    }
+
+    geo::GJKWithPoints gjk;
+    float dist2 = gjk.computeDistance2(supportFn, init_v, 1e-10f);
+
+    if (dist2 <= 0.f) {
+        return 0.f;
+    }
+
+    Vector3 a_closest, b_closest;
+    gjk.getClosestPoints(&a_closest, &b_closest);
+
+    float dist = sqrtf(dist2);
+    *normal = (b_closest - a_closest) / dist;
+
+    return dist;
+}
+
+// Conservative advancement of a, translating by delta over the step,
+// towards b, which is held at its end of step pose. Rotation over the step
+// isn't swept. Distance between convex shapes under a translation is
+// convex in t, so stepping by the distance over the closing speed along
+// the current normal never passes the first time of impact. Returns the
+// fraction of delta a can move before it gets within target_separation of
+// b, or 1 if it never does, along with the direction from a to b at that
+// point. Pairs that already overlap or touch at the start are left to the
+// narrowphase.
+static inline float advanceTowards(SweepPrimitive a,
+                                   const SweepPrimitive &b,
+                                   Vector3 delta,
+                                   float target_separation,
+                                   Vector3 *hit_normal)
+{
+    Vector3 start = a.pose.pos;
+
+    Vector3 normal;
+    float dist = primitiveDistance(a, b, &normal);
+    if (dist == 0.f) {
+        return 1.f;
+    }
+
+    // Never stop a body closer than it started
+    target_separation = fminf(target_separation, 0.5f * dist);
+
+    float t = 0.f;
+    for (CountT i = 0; i < CCDState::maxAdvanceIterations; i++) {
+        if (dist <= target_separation) {
+            *hit_normal = normal;
+            return t;
+        }
+
+        float closing_speed = dot(delta, normal);
+        if (closing_speed <= 0.f) {
+            return 1.f;
+        }
+
+        t += (dist - target_separation) / closing_speed;
+        if (t >= 1.f) {
+            return 1.f;
+        }
+
+        a.pose.pos = start + t * delta;
+        dist = primitiveDistance(a, b, &normal);
+
+        // Only reachable through GJK error, t is still conservative
+        if (dist == 0.f) {
+            *hit_normal = delta / delta.length();
+            return t;
+        }
+    }
+
+    *hit_normal = normal;
+    return t;
+}
+
+// Sweeps every convex primitive of a flagged body along its motion over
+// the step against the bodies its swept bounding box overlaps: static,
+// kinematic, sleeping and other dynamic bodies alike. Other bodies are
+// held where the solver left them. Two flagged bodies aren't swept against
+// each other, since either may already have been clamped. Heightfields and
+// triangle meshes aren't convex, so only the path of the body's center is
+// checked against them.
+//
+// A stopped body loses the part of its velocity closing in on what it hit.
+// Otherwise, a hit the next step's narrowphase doesn't catch in time, like
+// a grazing one on an edge, just gets clamped again every step.
+inline void clampFastMotion(Context &ctx,
+                            Entity e,
+                            broadphase::LeafID leaf_id,
+                            ResponseType response_type,
+                            Position &pos,
+                            const Rotation &rot,
+                            const Scale &scale,
+                            const ObjectID &obj_id,
+                            Velocity &vel)
+{
+    const CCDState &ccd_state = ctx.singleton<CCDState>();
+    const CCDState::Body &body = ccd_state.bodies[leaf_id.id];
+
+    if (!body.enabled || response_type != ResponseType::Dynamic) {
+        return;
+    }
+
+    const ObjectManager &obj_mgr = *ctx.singleton<ObjectData>().mgr;
+    AABB obj_aabb = obj_mgr.rigidBodyAABBs[obj_id.idx];
+
+    // Radius of the largest sphere around the origin inside the AABB, used
+    // to scale distances to the size of the body
+    float inner_radius = FLT_MAX;
+#pragma unroll
+    for (CountT i = 0; i < 3; i++) {
+        float face_dist = fminf(-obj_aabb.pMin[i], obj_aabb.pMax[i]);
+        inner_radius = fminf(inner_radius, face_dist * scale[i]);
+    }
+    inner_radius = fmaxf(inner_radius, 0.f);
+
+    Vector3 start = body.startPosition;
+    Vector3 delta = Vector3(pos) - start;
+    float motion = delta.length();
+
+    if (motion == 0.f ||
+            motion < CCDState::minMotionFraction * inner_radius) {
+        return;
+    }
+
+    float target_separation =
+        CCDState::targetSeparationFraction * inner_radius;
+
+    AABB swept_aabb = AABB::merge(
+        obj_aabb.applyTRS(start, rot, scale),
+        obj_aabb.applyTRS(pos, rot, scale));
+
+    const uint32_t prim_offset = obj_mgr.rigidBodyPrimitiveOffsets[obj_id.idx];
+    const uint32_t num_prims = obj_mgr.rigidBodyPrimitiveCounts[obj_id.idx];
+
+    float hit_t = 1.f;
+    // Direction from the body to what it hit, and the hit body's velocity
+    Vector3 hit_normal = Vector3::zero();
+    Vector3 hit_velocity = Vector3::zero();
+
+    ctx.singleton<broadphase::BVH>().findIntersecting(swept_aabb,
+    [&](Entity other) {
+        if (other == e) {
+            return;
+        }
+
+        Loc other_loc = ctx.loc(other);
+        auto other_leaf = ctx.getDirect<broadphase::LeafID>(
+            RGDCols::LeafID, other_loc);
+        if (ccd_state.bodies[other_leaf.id].enabled &&
+                ctx.getDirect<ResponseType>(
+                    RGDCols::ResponseType, other_loc) ==
+                ResponseType::Dynamic) {
+            return;
+        }
+
+        ObjectID other_obj =
+            ctx.getDirect<ObjectID>(RGDCols::ObjectID, other_loc);
+        SweepPose other_pose {
+            .pos = ctx.getDirect<Position>(RGDCols::Position, other_loc),
+            .rot = ctx.getDirect<Rotation>(RGDCols::Rotation, other_loc),
+            .scale = ctx.getDirect<Scale>(RGDCols::Scale, other_loc),
+        };
+
+        const uint32_t other_prim_offset =
+            obj_mgr.rigidBodyPrimitiveOffsets[other_obj.idx];
+        const uint32_t other_num_prims =
+            obj_mgr.rigidBodyPrimitiveCounts[other_obj.idx];
+
+        for (uint32_t i = 0; i < num_prims; i++) {
+            SweepPrimitive a {
+                .prim = &obj_mgr.collisionPrimitives[prim_offset + i],
+                .pose = { start, rot, scale },
+            };
+
+            if (!isConvex(a.prim->type)) {
+                continue;
+            }
+
+            for (uint32_t j = 0; j < other_num_prims; j++) {
+                SweepPrimitive b {
+                    .prim = &obj_mgr.collisionPrimitives[
+                        other_prim_offset + j],
+                    .pose = other_pose,
+                };
+
+                if (!isConvex(b.prim->type) &&
+                        b.prim->type != CollisionPrimitive::Type::Plane) {
+                    continue;
+                }
+
+                Vector3 normal;
+                float t = advanceTowards(
+                    a, b, delta, target_separation, &normal);
+
+                if (t < hit_t) {
+                    hit_t = t;
+                    hit_normal = normal;
+                    hit_velocity = ctx.getDirect<Velocity>(
+                        RGDCols::Velocity, other_loc).linear;
+                }
+            }
+        }
+    });
+
+    float ray_hit_t;
+    Vector3 ray_hit_normal;
+    Entity ray_hit = ctx.singleton<broadphase::BVH>().traceRayFiltered(
+        start, delta, &ray_hit_t, &ray_hit_normal, hit_t, [&](Entity other) {
+            ObjectID other_obj = ctx.get<ObjectID>(other);
+            CollisionPrimitive::Type type = obj_mgr.collisionPrimitives[
+                obj_mgr.rigidBodyPrimitiveOffsets[other_obj.idx]].type;
+
+            return type == CollisionPrimitive::Type::Heightfield ||
+                type == CollisionPrimitive::Type::TriangleMesh;
+        });
+
+    if (ray_hit != Entity::none()) {
+        // Back off along the ray until the inner sphere is
+        // target_separation away from the plane of the hit
+        float cos_theta =
+            fmaxf(fabsf(dot(delta / motion, ray_hit_normal)), 0.1f);
+        float t = fmaxf(ray_hit_t -
+            (inner_radius + target_separation) / (cos_theta * motion), 0.f);
+
+        if (t < hit_t) {
+            hit_t = t;
+            hit_normal = dot(ray_hit_normal, delta) > 0.f ?
+                ray_hit_normal : -ray_hit_normal;
+            hit_velocity = ctx.get<Velocity>(ray_hit).linear;
+        }
+    }
+
+    if (hit_t >= 1.f) {
+        return;
+    }
+
+    pos = start + hit_t * delta;
+
+    float closing_speed = dot(vel.linear - hit_velocity, hit_normal);
+    if (closing_speed > 0.f) {
+        vel.linear -= closing_speed * hit_normal;
+    }
+}
+
+TaskGraphNodeID setupPreSolveTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps)
+{
+    return builder.addToGraph<ParallelForNode<Context,
+        recordStartPositions,
+            broadphase::LeafID,
+            Position
+        >>(deps);
+}
+
+TaskGraphNodeID setupTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps)
+{
+    return builder.addToGraph<ParallelForNode<Context,
+        clampFastMotion,
+            Entity,
+            broadphase::LeafID,
+            ResponseType,
+            Position,
+            Rotation,
+            Scale,
+            ObjectID,
+            Velocity
+        >>(deps);
+}
+
+}
@@ -0,0 +1,390 @@
+#pragma once
+
+#include <madrona/math.hpp>
+
+#include <cassert>
+#include <cfloat>
+
+namespace madrona::geo {
+
+/*
+EPA (Expanding Polytope Algorithm) Implementation. Like gjk.hpp, this is
+intended to be a private implementation file for geo.cpp, but factored out
+into a header so it can be unit tested.
+
+EPA picks up where GJK leaves off when the origin is inside the Minkowski
+difference A - B: starting from the final GJK simplex, it repeatedly
+expands the face of a polytope inside A - B that is closest to the origin
+with a new support point in that face's normal direction. When the support
+point doesn't move the face further out, the face is (within tolerance) on
+the boundary of A - B and its normal and distance are the direction and
+depth of minimum penetration.
+
+Refer to Collision Detection in Interactive 3D Environments, Gino van den
+Bergen, Section 4.4 (Penetration Depth).
+
+The polytope is stored in fixed size arrays so the whole computation stays
+on the stack. If it runs out of space, the best face so far is returned,
+which is a slight underestimate of the true penetration.
+*/
+
+using namespace math;
+
+struct EPAResult {
+    // Direction from A to B along which moving B by depth separates the
+    // hulls
+    Vector3 normal;
+    float depth;
+    // Point on A that is deepest inside B
+    Vector3 aPoint;
+    bool valid;
+};
+
+struct EPA {
+    static constexpr inline CountT maxVertices = 64;
+    static constexpr inline CountT maxFaces = 128;
+    static constexpr inline CountT maxHorizonEdges = 64;
+    static constexpr inline CountT maxIters = 48;
+
+    struct Face {
+        uint8_t v[3];
+        Vector3 normal;
+        float d;
+    };
+
+    Vector3 Y[maxVertices];
+    Vector3 aPoints[maxVertices];
+    CountT nY;
+
+    Face faces[maxFaces];
+    CountT numFaces;
+
+    // Y and a_points are the GJK simplex that encloses the origin, n_y can
+    // be less than 4 if GJK terminated early because the origin was on the
+    // simplex.
+    template <typename Fn>
+    inline EPAResult computePenetration(
+        Fn &&support_fn, const Vector3 *init_Y, const Vector3 *init_a_points,
+        CountT n_y, float err_tolerance);
+
+private:
+    template <typename Fn>
+    inline bool buildTetrahedron(Fn &&support_fn, float err_tolerance);
+
+    template <typename Fn>
+    inline bool tryAddSupport(Fn &&support_fn, Vector3 dir,
+                              float err_tolerance);
+
+    inline bool addFace(CountT a, CountT b, CountT c);
+};
+
+template <typename Fn>
+bool EPA::tryAddSupport(Fn &&support_fn, Vector3 dir, float err_tolerance)
+{
+    Vector3 a_support, b_support;
+    Vector3 w = support_fn(dir, &a_support, &b_support);
+
+    for (CountT i = 0; i < nY; i++) {
+        if (w.distance2(Y[i]) <= err_tolerance * err_tolerance) {
+            return false;
+        }
+    }
+
+    Y[nY] = w;
+    aPoints[nY] = a_support;
+    nY += 1;
+
+    return true;
+}
+
+// Grows a degenerate GJK simplex into a tetrahedron. Each new point has to
+// be off the affine hull of the existing ones.
+template <typename Fn>
+bool EPA::buildTetrahedron(Fn &&support_fn, float err_tolerance)
+{
+    constexpr Vector3 axes[3] {
+        { 1, 0, 0 },
+        { 0, 1, 0 },
+        { 0, 0, 1 },
+    };
+
+    // GJK always leaves at least one point, but seed the simplex anyway so
+    // the cases below never read Y[0] unset
+    if (nY == 0) {
+        tryAddSupport(support_fn, axes[0], err_tolerance);
+    }
+
+    if (nY == 1) {
+        for (CountT i = 0; i < 3 && nY == 1; i++) {
+            if (!tryAddSupport(support_fn, axes[i], err_tolerance)) {
+                tryAddSupport(support_fn, -axes[i], err_tolerance);
+            }
+        }
+
+        if (nY == 1) {
+            return false;
+        }
+    }
+
+    if (nY == 2) {
+        Vector3 d = Y[1] - Y[0];
+
+        // Search perpendicular to the segment, starting from the axis the
+        // segment is least aligned with
+        CountT min_axis = 0;
+        float min_abs = fabsf(d.x);
+        if (fabsf(d.y) < min_abs) {
+            min_axis = 1;
+            min_abs = fabsf(d.y);
+        }
+        if (fabsf(d.z) < min_abs) {
+            min_axis = 2;
+        }
+
+        Vector3 p1 = cross(d, axes[min_axis]).normalize();
+        Vector3 p2 = cross(d, p1).normalize();
+
+        Vector3 dirs[4] { p1, -p1, p2, -p2 };
+        for (CountT i = 0; i < 4 && nY == 2; i++) {
+            Vector3 cand_dir = dirs[i];
+            Vector3 a_support, b_support;
+            Vector3 w = support_fn(cand_dir, &a_support, &b_support);
+
+            if (cross(w - Y[0], d).length2() >
+                    err_tolerance * err_tolerance * d.length2()) {
+                Y[2] = w;
+                aPoints[2] = a_support;
+                nY = 3;
+            }
+        }
+
+        if (nY == 2) {
+            return false;
+        }
+    }
+
+    if (nY == 3) {
+        Vector3 n = cross(Y[1] - Y[0], Y[2] - Y[0]);
+        float n_len2 = n.length2();
+        if (n_len2 == 0.f) {
+            return false;
+        }
+        n /= sqrtf(n_len2);
+
+        for (Vector3 dir : { n, -n }) {
+            Vector3 a_support, b_support;
+            Vector3 w = support_fn(dir, &a_support, &b_support);
+
+            if (fabsf(dot(w - Y[0], n)) > err_tolerance) {
+                Y[3] = w;
+                aPoints[3] = a_support;
+                nY = 4;
+                break;
+            }
+        }
+
+        if (nY == 3) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool EPA::addFace(CountT a, CountT b, CountT c)
+{
+    if (numFaces == maxFaces) {
+        return false;
+    }
+
+    Vector3 n = cross(Y[b] - Y[a], Y[c] - Y[a]);
+    float n_len2 = n.length2();
+    if (n_len2 == 0.f) {
+        return false;
+    }
+
+    n /= sqrtf(n_len2);
+
+    faces[numFaces++] = Face {
+        { uint8_t(a), uint8_t(b), uint8_t(c) },
+        n,
+        dot(n, Y[a]),
+    };
+
+    return true;
+}
+
+template <typename Fn>
+EPAResult EPA::computePenetration(
+    Fn &&support_fn, const Vector3 *init_Y, const Vector3 *init_a_points,
+    CountT n_y, float err_tolerance)
+{
+    EPAResult result;
+    result.valid = false;
+
+    nY = n_y;
+    for (CountT i = 0; i < n_y; i++) {
+        Y[i] = init_Y[i];
+        aPoints[i] = init_a_points[i];
+    }
+
+    if (nY < 4 && !buildTetrahedron(support_fn, err_tolerance)) {
+        return result;
+    }
+
+    // Wind the tetrahedron so all normals point away from its centroid
+    {
+        Vector3 centroid = 0.25f * (Y[0] + Y[1] + Y[2] + Y[3]);
+        Vector3 n = cross(Y[1] - Y[0], Y[2] - Y[0]);
+        if (dot(n, Y[0] - centroid) < 0.f) {
+            std::swap(Y[1], Y[2]);
+            std::swap(aPoints[1], aPoints[2]);
+        }
+    }
+
+    numFaces = 0;
+    if (!addFace(0, 1, 2) || !addFace(0, 3, 1) ||
+        !addFace(0, 2, 3) || !addFace(1, 3, 2)) {
+        return result;
+    }
+
+    // The origin has to be inside the starting polytope. Allow it to be
+    // slightly outside, since GJK terminates with the origin on the simplex
+    // when the hulls are just touching.
+    for (CountT i = 0; i < numFaces; i++) {
+        if (faces[i].d < -err_tolerance) {
+            return result;
+        }
+    }
+
+    CountT closest_face = 0;
+    for (CountT iter = 0; iter < maxIters; iter++) {
+        closest_face = 0;
+        for (CountT i = 1; i < numFaces; i++) {
+            if (faces[i].d < faces[closest_face].d) {
+                closest_face = i;
+            }
+        }
+
+        Face face = faces[closest_face];
+
+        if (nY == maxVertices) {
+            break;
+        }
+
+        Vector3 a_support, b_support;
+        Vector3 w = support_fn(face.normal, &a_support, &b_support);
+
+        // Support point doesn't expand the polytope, the closest face is on
+        // the boundary of A - B
+        float w_d = dot(w, face.normal);
+        if (w_d - face.d <= err_tolerance * fmaxf(1.f, face.d)) {
+            break;
+        }
+
+        CountT new_idx = nY;
+        Y[nY] = w;
+        aPoints[nY] = a_support;
+        nY += 1;
+
+        // Remove every face that can see w, keeping track of the horizon:
+        // edges that belonged to exactly one removed face. Edges are stored
+        // with the winding of the removed face, so the new faces built on
+        // them keep facing outward.
+        uint8_t horizon[maxHorizonEdges][2];
+        CountT num_horizon = 0;
+        bool overflow = false;
+
+        for (CountT i = 0; i < numFaces;) {
+            Face &cur = faces[i];
+            if (dot(cur.normal, w) - cur.d <= 0.f) {
+                i++;
+                continue;
+            }
+
+            for (CountT j = 0; j < 3; j++) {
+                uint8_t e0 = cur.v[j];
+                uint8_t e1 = cur.v[(j + 1) % 3];
+
+                bool found_twin = false;
+                for (CountT k = 0; k < num_horizon; k++) {
+                    if (horizon[k][0] == e1 && horizon[k][1] == e0) {
+                        horizon[k][0] = horizon[num_horizon - 1][0];
+                        horizon[k][1] = horizon[num_horizon - 1][1];
+                        num_horizon -= 1;
+                        found_twin = true;
+                        break;
+                    }
+                }
+
+                if (!found_twin) {
+                    if (num_horizon == maxHorizonEdges) {
+                        overflow = true;
+                        break;
+                    }
+
+                    horizon[num_horizon][0] = e0;
+                    horizon[num_horizon][1] = e1;
+                    num_horizon += 1;
+                }
+            }
+
+            cur = faces[numFaces - 1];
+            numFaces -= 1;
+        }
+
+        if (overflow) {
+            return result;
+        }
+
+        for (CountT i = 0; i < num_horizon; i++) {
+            if (!addFace(horizon[i][0], horizon[i][1], new_idx)) {
+                return result;
+            }
+        }
+    }
+
+    // Search one last time in case the loop ran out of iterations or space
+    closest_face = 0;
+    for (CountT i = 1; i < numFaces; i++) {
+        if (faces[i].d < faces[closest_face].d) {
+            closest_face = i;
+        }
+    }
+
+    const Face &face = faces[closest_face];
+
+    // Barycentric coordinates of the origin's projection onto the face give
+    // the matching point on A
+    Vector3 p = face.normal * face.d;
+    Vector3 v0 = Y[face.v[0]];
+    Vector3 e1 = Y[face.v[1]] - v0;
+    Vector3 e2 = Y[face.v[2]] - v0;
+    Vector3 to_p = p - v0;
+
+    float d11 = dot(e1, e1);
+    float d12 = dot(e1, e2);
+    float d22 = dot(e2, e2);
+    float dp1 = dot(to_p, e1);
+    float dp2 = dot(to_p, e2);
+    float denom = d11 * d22 - d12 * d12;
+
+    float l1, l2;
+    if (denom == 0.f) {
+        l1 = l2 = 1.f / 3.f;
+    } else {
+        l1 = (d22 * dp1 - d12 * dp2) / denom;
+        l2 = (d11 * dp2 - d12 * dp1) / denom;
+    }
+    float l0 = 1.f - l1 - l2;
+
+    result.normal = face.normal;
+    result.depth = fmaxf(face.d, 0.f);
+    result.aPoint = l0 * aPoints[face.v[0]] + l1 * aPoints[face.v[1]] +
+        l2 * aPoints[face.v[2]];
+    result.valid = true;
+
+    return result;
+}
+
+}
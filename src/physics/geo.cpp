@@ -2,6 +2,7 @@
 
 //#define MADRONA_GJK_DEBUG
 #include "gjk.hpp"
+#include "epa.hpp"
 
 namespace madrona::geo {
 
@@ -9,7 +10,7 @@ using namespace math;
 
 MADRONA_ALWAYS_INLINE static inline
 Vector3 getHullSupportPointGJK(
-    HalfEdgeMesh &hull,
+    const HalfEdgeMesh &hull,
     Vector3 v)
 {
     // FIXME, upgrade HalfEdgeMesh to support getting neighboring vertices to
@@ -58,4 +59,55 @@ float hullClosestPointToOriginGJK(
     return dist2;
 }
 
+HullHullGJKResult hullHullGJKEPA(
+    const HalfEdgeMesh &a,
+    const HalfEdgeMesh &b,
+    float err_tolerance2)
+{
+    auto supportFn = [&a, &b]
+    (Vector3 v, Vector3 *a_support_out, Vector3 *b_support_out)
+    {
+        Vector3 a_support = getHullSupportPointGJK(a, v);
+        Vector3 b_support = getHullSupportPointGJK(b, -v);
+
+        *a_support_out = a_support;
+        *b_support_out = b_support;
+
+        return a_support - b_support;
+    };
+
+    GJKWithPoints gjk;
+    float dist2 = gjk.computeDistance2(
+        supportFn, b.vertices[0] - a.vertices[0], err_tolerance2);
+
+    HullHullGJKResult result;
+
+    if (dist2 > 0.f) {
+        Vector3 a_closest, b_closest;
+        gjk.getClosestPoints(&a_closest, &b_closest);
+
+        float dist = sqrtf(dist2);
+
+        result.distance = dist;
+        result.normal = (b_closest - a_closest) / dist;
+        result.depth = 0.f;
+        result.aPoint = a_closest;
+        result.valid = true;
+
+        return result;
+    }
+
+    EPA epa;
+    EPAResult epa_result = epa.computePenetration(
+        supportFn, gjk.Y, gjk.aPoints, gjk.nY, sqrtf(err_tolerance2));
+
+    result.distance = 0.f;
+    result.normal = epa_result.normal;
+    result.depth = epa_result.depth;
+    result.aPoint = epa_result.aPoint;
+    result.valid = epa_result.valid;
+
+    return result;
+}
+
 }
@@ -134,9 +134,14 @@ struct GJKWithPoints : GJK<GJKWithPoints> {
                 lambdas[1] * bPoints[1] + lambdas[2] * bPoints[2];
         } break;
         case 4: {
-            // 4 simplex means we enclose origin,
-            // we don't know the closest point. Leave this case here so
-            // user doesn't trigger undefined behavior calling getClosestPoints
+            // 4 simplex means we enclose origin, so the shapes overlap and
+            // there is no unique closest pair. Return the barycentric
+            // combination anyway (a_out and b_out coincide up to FP error)
+            // so callers never read uninitialized outputs.
+            *a_out = lambdas[0] * aPoints[0] + lambdas[1] * aPoints[1] +
+                lambdas[2] * aPoints[2] + lambdas[3] * aPoints[3];
+            *b_out = lambdas[0] * bPoints[0] + lambdas[1] * bPoints[1] +
+                lambdas[2] * bPoints[2] + lambdas[3] * bPoints[3];
         } break;
         default: MADRONA_UNREACHABLE();
         }
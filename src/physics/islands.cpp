@@ -0,0 +1,291 @@
+#include <madrona/physics.hpp>
+#include <madrona/context.hpp>
+
+#include "physics_impl.hpp"
+
+namespace madrona::phys {
+
+using namespace base;
+using namespace math;
+
+IslandState::IslandState(CountT max_leaves, bool enable_sleeping)
+{
+    bodies = (Body *)rawAlloc(sizeof(Body) * max_leaves);
+    maxLeaves = max_leaves;
+    enabled = enable_sleeping;
+
+    clear();
+}
+
+int32_t IslandState::findRoot(int32_t leaf_idx)
+{
+    while (true) {
+        AtomicI32Ref parent_ref(bodies[leaf_idx].parent);
+        int32_t parent = parent_ref.load<sync::relaxed>();
+
+        if (parent == leaf_idx) {
+            return leaf_idx;
+        }
+
+        int32_t grandparent = AtomicI32Ref(bodies[parent].parent).
+            load<sync::relaxed>();
+
+        // Path halving. Racing with other finds is fine: every write just
+        // points a body at one of its own ancestors.
+        parent_ref.store<sync::relaxed>(grandparent);
+        leaf_idx = grandparent;
+    }
+}
+
+void IslandState::link(broadphase::LeafID a_leaf, broadphase::LeafID b_leaf)
+{
+    if (!enabled) {
+        return;
+    }
+
+    int32_t a_root = findRoot(a_leaf.id);
+    int32_t b_root = findRoot(b_leaf.id);
+
+    while (a_root != b_root) {
+        // Always hang the higher root under the lower one so concurrent
+        // links can't create a cycle
+        if (a_root < b_root) {
+            std::swap(a_root, b_root);
+        }
+
+        AtomicI32Ref parent_ref(bodies[a_root].parent);
+        int32_t expected = a_root;
+        if (parent_ref.compare_exchange_weak<
+                sync::relaxed, sync::relaxed>(expected, b_root)) {
+            break;
+        }
+
+        a_root = findRoot(a_root);
+        b_root = findRoot(b_root);
+    }
+}
+
+void IslandState::clear()
+{
+    for (CountT i = 0; i < maxLeaves; i++) {
+        bodies[i] = Body {
+            .parent = int32_t(i),
+            .sleepTimer = 0.f,
+            .islandSleepTimer = 0.f,
+            .dynamic = 0,
+            .asleep = 0,
+            .sleepPosition = Vector3::zero(),
+            .sleepRotation = Quat { 1, 0, 0, 0 },
+        };
+    }
+}
+
+}
+
+namespace madrona::phys::islands {
+
+using namespace base;
+using namespace math;
+
+inline void wakeDrivenBodies(Context &ctx,
+                             broadphase::LeafID leaf_id,
+                             const Position &pos,
+                             const Rotation &rot,
+                             const Velocity &vel,
+                             const ExternalForce &ext_force,
+                             const ExternalTorque &ext_torque)
+{
+    IslandState &islands = ctx.singleton<IslandState>();
+    IslandState::Body &body = islands.bodies[leaf_id.id];
+
+    if (!body.asleep) {
+        return;
+    }
+
+    // Sleeping bodies have their velocities zeroed and are never moved by
+    // the solver, so any velocity, force or change of pose here was set by
+    // the user
+    auto isZero = [](Vector3 v) {
+        return v.x == 0.f && v.y == 0.f && v.z == 0.f;
+    };
+
+    auto moved = [&]() {
+        Vector3 x = pos;
+        Quat q = rot;
+
+        return x.x != body.sleepPosition.x || x.y != body.sleepPosition.y ||
+            x.z != body.sleepPosition.z || q.w != body.sleepRotation.w ||
+            q.x != body.sleepRotation.x || q.y != body.sleepRotation.y ||
+            q.z != body.sleepRotation.z;
+    };
+
+    if (!isZero(vel.linear) || !isZero(vel.angular) ||
+            !isZero(ext_force) || !isZero(ext_torque) || moved()) {
+        body.sleepTimer = 0.f;
+        islands.wake(leaf_id);
+    }
+}
+
+inline void linkJointIslands(Context &ctx,
+                             const JointConstraint &joint)
+{
+    Loc l1 = ctx.loc(joint.e1);
+    Loc l2 = ctx.loc(joint.e2);
+
+    if (ctx.getDirect<ResponseType>(RGDCols::ResponseType, l1) !=
+            ResponseType::Dynamic ||
+        ctx.getDirect<ResponseType>(RGDCols::ResponseType, l2) !=
+            ResponseType::Dynamic) {
+        return;
+    }
+
+    ctx.singleton<IslandState>().link(
+        ctx.getDirect<broadphase::LeafID>(RGDCols::LeafID, l1),
+        ctx.getDirect<broadphase::LeafID>(RGDCols::LeafID, l2));
+}
+
+inline void updateSleepTimers(Context &ctx,
+                              broadphase::LeafID leaf_id,
+                              ResponseType response_type,
+                              const Velocity &vel)
+{
+    IslandState &islands = ctx.singleton<IslandState>();
+    IslandState::Body &body = islands.bodies[leaf_id.id];
+
+    // Static and kinematic bodies never sleep and don't join islands
+    if (!islands.enabled || response_type != ResponseType::Dynamic) {
+        body.dynamic = 0;
+        body.asleep = 0;
+        return;
+    }
+
+    body.dynamic = 1;
+
+    if (body.asleep) {
+        return;
+    }
+
+    constexpr float lin_tol2 =
+        IslandState::linearSleepVelocity * IslandState::linearSleepVelocity;
+    constexpr float ang_tol2 =
+        IslandState::angularSleepVelocity * IslandState::angularSleepVelocity;
+
+    if (vel.linear.length2() > lin_tol2 ||
+            vel.angular.length2() > ang_tol2) {
+        body.sleepTimer = 0.f;
+    } else {
+        body.sleepTimer += ctx.singleton<PhysicsSystemState>().deltaT;
+    }
+}
+
+inline void updateIslands(Context &ctx,
+                          IslandState &islands)
+{
+    if (!islands.enabled) {
+        return;
+    }
+
+    const CountT num_leaves = ctx.singleton<broadphase::BVH>().numLeaves();
+    IslandState::Body *bodies = islands.bodies;
+
+    for (CountT i = 0; i < num_leaves; i++) {
+        bodies[i].islandSleepTimer = FLT_MAX;
+    }
+
+    for (CountT i = 0; i < num_leaves; i++) {
+        if (!bodies[i].dynamic) {
+            continue;
+        }
+
+        IslandState::Body &root = bodies[islands.findRoot(i)];
+        root.islandSleepTimer =
+            fminf(root.islandSleepTimer, bodies[i].sleepTimer);
+    }
+
+    // Islands sleep and wake as a whole. A sleeping body that was woken by a
+    // contact this step keeps its timer, so it goes back to sleep with its
+    // island if whatever touched it is also at rest.
+    for (CountT i = 0; i < num_leaves; i++) {
+        if (!bodies[i].dynamic) {
+            continue;
+        }
+
+        const IslandState::Body &root = bodies[islands.findRoot(i)];
+        bodies[i].asleep =
+            root.islandSleepTimer >= IslandState::timeToSleep ? 1 : 0;
+    }
+
+    // Awake bodies start the next step in their own island. This has to
+    // happen after every root is resolved above, but since islands are now
+    // either entirely awake or entirely asleep, it never splits a sleeping
+    // island.
+    for (CountT i = 0; i < num_leaves; i++) {
+        if (bodies[i].dynamic && !bodies[i].asleep) {
+            bodies[i].parent = int32_t(i);
+        }
+    }
+}
+
+inline void clearSleepingVelocities(Context &ctx,
+                                    broadphase::LeafID leaf_id,
+                                    const Position &pos,
+                                    const Rotation &rot,
+                                    Velocity &vel)
+{
+    IslandState::Body &body = ctx.singleton<IslandState>().bodies[leaf_id.id];
+
+    if (body.asleep) {
+        vel.linear = Vector3::zero();
+        vel.angular = Vector3::zero();
+
+        body.sleepPosition = pos;
+        body.sleepRotation = rot;
+    }
+}
+
+TaskGraphNodeID setupWakeTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps)
+{
+    return builder.addToGraph<ParallelForNode<Context,
+        wakeDrivenBodies,
+            broadphase::LeafID,
+            Position,
+            Rotation,
+            Velocity,
+            ExternalForce,
+            ExternalTorque
+        >>(deps);
+}
+
+TaskGraphNodeID setupTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps)
+{
+    auto link_joints = builder.addToGraph<ParallelForNode<Context,
+        linkJointIslands,
+            JointConstraint
+        >>(deps);
+
+    auto update_timers = builder.addToGraph<ParallelForNode<Context,
+        updateSleepTimers,
+            broadphase::LeafID,
+            ResponseType,
+            Velocity
+        >>({link_joints});
+
+    auto update_islands = builder.addToGraph<ParallelForNode<Context,
+        updateIslands,
+            IslandState
+        >>({update_timers});
+
+    return builder.addToGraph<ParallelForNode<Context,
+        clearSleepingVelocities,
+            broadphase::LeafID,
+            Position,
+            Rotation,
+            Velocity
+        >>({update_islands});
+}
+
+}
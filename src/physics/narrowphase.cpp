@@ -87,19 +87,195 @@ private:
 #undef MADRONA_GPU_COND
 #define MADRONA_GPU_COND(...)
 
+#if defined(MADRONA_X64) && defined(__AVX2__) && defined(__FMA__)
+#define MADRONA_NARROWPHASE_AVX2 1
+#include "sat_avx2.hpp"
+#endif
+
+#include "primitive_contacts.hpp"
+
+namespace madrona::phys {
+
+ContactCache::ContactCache(CountT max_dynamic_objects)
+{
+    // Budget roughly 4 touching pairs per object and keep the table at most
+    // half full so probe sequences stay short
+    capacity = utils::int32NextPow2(
+        std::max(uint32_t(max_dynamic_objects) * 8, 64_u32));
+    entries = (Entry *)rawAlloc(sizeof(Entry) * capacity);
+    liveEntries = (uint32_t *)rawAlloc(sizeof(uint32_t) * capacity);
+    curStep = 0;
+
+    clear();
+}
+
+static inline uint32_t contactCacheHash(uint64_t key)
+{
+    return utils::int32Hash(uint32_t(key) ^ uint32_t(key >> 32));
+}
+
+int32_t ContactCache::findOrInsert(uint64_t key)
+{
+    const uint32_t mask = capacity - 1;
+    uint32_t idx = contactCacheHash(key) & mask;
+
+    for (int32_t probe = 0; probe < maxProbes; probe++) {
+        Entry &entry = entries[idx];
+        AtomicRef<uint64_t> key_ref(entry.key);
+
+        uint64_t cur_key = key_ref.load<sync::acquire>();
+        while (cur_key == emptyKey &&
+               !key_ref.compare_exchange_weak<
+                   sync::acq_rel, sync::acquire>(cur_key, key)) {}
+
+        if (cur_key == emptyKey) {
+            // Newly inserted, no history for this pair yet
+            entry.lastStep = curStep;
+            entry.satFeature = SATFeature::None;
+            entry.numPoints = 0;
+            entry.normal = math::Vector3::zero();
+
+            uint32_t live_idx = AtomicU32Ref(numLive).fetch_add_relaxed(1);
+            liveEntries[live_idx] = idx;
+            entry.liveIdx = live_idx;
+
+            return int32_t(idx);
+        }
+
+        if (cur_key == key) {
+            entry.lastStep = curStep;
+            return int32_t(idx);
+        }
+
+        idx = (idx + 1) & mask;
+    }
+
+    return -1;
+}
+
+void ContactCache::advanceStep()
+{
+    const uint32_t mask = capacity - 1;
+
+    // Remove entries that weren't touched last step. Deletion shifts
+    // later members of the probe chain back into the hole rather than
+    // leaving tombstones. Moved entries keep their place in liveEntries,
+    // and the removed one is swapped with the last live entry, so
+    // liveEntries[i] is rechecked after each removal.
+    uint32_t i = 0;
+    while (i < numLive) {
+        uint32_t entry_idx = liveEntries[i];
+        if (entries[entry_idx].lastStep == curStep) {
+            i++;
+            continue;
+        }
+
+        uint32_t hole = entry_idx;
+        uint32_t j = entry_idx;
+        while (true) {
+            j = (j + 1) & mask;
+            if (entries[j].key == emptyKey) {
+                break;
+            }
+
+            uint32_t home = contactCacheHash(entries[j].key) & mask;
+
+            bool home_in_range = hole <= j ?
+                (hole < home && home <= j) :
+                (hole < home || home <= j);
+
+            if (home_in_range) {
+                continue;
+            }
+
+            entries[hole] = entries[j];
+            liveEntries[entries[hole].liveIdx] = hole;
+            hole = j;
+        }
+
+        entries[hole].key = emptyKey;
+
+        numLive -= 1;
+        if (i != numLive) {
+            uint32_t last_idx = liveEntries[numLive];
+            liveEntries[i] = last_idx;
+            entries[last_idx].liveIdx = i;
+        }
+    }
+
+    curStep++;
+}
+
+void ContactCache::clear()
+{
+    for (uint32_t i = 0; i < capacity; i++) {
+        entries[i].key = emptyKey;
+    }
+
+    numLive = 0;
+}
+
+}
+
 namespace madrona::phys::narrowphase {
 
 using namespace base;
 using namespace math;
 using namespace geo;
 
+namespace consts {
+// Hull pairs with more edge pairs than this skip SAT, whose edge query is
+// quadratic in hull complexity, and use GJK + EPA instead. Picked with
+// tests/hull_collision_bench.cpp: GJK + EPA wins on overlapping pairs from
+// roughly 2k edge pairs and on mostly separated pairs from roughly 8k.
+constexpr inline uint32_t gjkMinEdgePairs = 4096;
+// EPA normals at least this close to a face normal of either hull get a
+// clipped face manifold, otherwise a single contact point is generated
+constexpr inline float gjkFaceContactCos = 0.99f;
+// FIXME: absolute cap on the speculative margin, should be scaled by object
+// size. Bodies moving further than this between narrowphase passes rely on
+// the CCD pass instead, so they don't pull in contacts with everything
+// along their path.
+constexpr inline float maxSpeculativeDistance = 1.f;
+// SAT only picks an edge contact over a face contact, or face B over face A
+// as the reference, when its separation is larger by these margins (see
+// Dirk Gregorius' "The Separating Axis Test between Convex Polyhedra").
+// Separations are negative for overlapping hulls, so the relative tolerances
+// favor faces.
+constexpr inline float satEdgeRelTolerance = 0.9f;
+constexpr inline float satFaceRelTolerance = 0.98f;
+constexpr inline float satAbsTolerance = 0.0025f;
+}
+
 enum class NarrowphaseTest : uint32_t {
     SphereSphere = 1,
     HullHull = 2,
     SphereHull = 3,
-    PlanePlane = 4,
-    SpherePlane = 5,
-    HullPlane = 6,
+    CapsuleCapsule = 4,
+    SphereCapsule = 5,
+    HullCapsule = 6,
+    BoxBox = 8,
+    SphereBox = 9,
+    HullBox = 10,
+    CapsuleBox = 12,
+    HeightfieldHeightfield = 16,
+    SphereHeightfield = 17,
+    HullHeightfield = 18,
+    CapsuleHeightfield = 20,
+    BoxHeightfield = 24,
+    TriangleMeshTriangleMesh = 32,
+    SphereTriangleMesh = 33,
+    HullTriangleMesh = 34,
+    CapsuleTriangleMesh = 36,
+    BoxTriangleMesh = 40,
+    HeightfieldTriangleMesh = 48,
+    PlanePlane = 64,
+    SpherePlane = 65,
+    HullPlane = 66,
+    CapsulePlane = 68,
+    BoxPlane = 72,
+    HeightfieldPlane = 80,
+    TriangleMeshPlane = 96,
 };
 
 struct FaceQuery {
@@ -118,6 +294,12 @@ struct EdgeQuery {
 struct HullState {
     HalfEdgeMesh mesh;
     Vector3 center;
+#ifdef MADRONA_NARROWPHASE_AVX2
+    // SoA copies of mesh for the AVX2 SAT queries. nullptr when not built,
+    // in which case the scalar queries are used.
+    const avx2::HullVertices *soaVertices = nullptr;
+    const avx2::HullEdges *soaEdges = nullptr;
+#endif
 };
 
 struct Manifold {
@@ -133,6 +315,8 @@ enum class ContactType {
     SATPlane,
     SATFace,
     SATEdge,
+    // Capsule, box and heightfield contacts, with b as the reference
+    Primitive,
 };
 
 struct SphereContact {
@@ -221,6 +405,25 @@ static HullState makeHullState(
 
 }
 
+#ifdef MADRONA_NARROWPHASE_AVX2
+// Only hulls whose edges are tested in the inner loop of the edge query
+// need soa_edges.
+static void buildSoAHullState(HullState &h,
+                              avx2::HullVertices *soa_vertices,
+                              avx2::HullEdges *soa_edges)
+{
+    if (avx2::canBuildHullVertices(h.mesh)) {
+        avx2::buildHullVertices(h.mesh, soa_vertices);
+        h.soaVertices = soa_vertices;
+    }
+
+    if (soa_edges != nullptr && avx2::canBuildHullEdges(h.mesh)) {
+        avx2::buildHullEdges(h.mesh, soa_edges);
+        h.soaEdges = soa_edges;
+    }
+}
+#endif
+
 // Returns the signed distance
 static inline float getDistanceFromPlane(
     const Plane &plane, const Vector3 &a)
@@ -303,6 +506,12 @@ static float getHullDistanceFromPlane(
     constexpr CountT elems_per_iter = 1;
 #endif
 
+#ifdef MADRONA_NARROWPHASE_AVX2
+    if (h.soaVertices != nullptr) {
+        return avx2::hullMinDot(*h.soaVertices, plane.normal) - plane.d;
+    }
+#endif
+
     float min_dot_n = FLT_MAX;
 
     auto computeVertexDotN = [&h, &plane](CountT vert_idx) {
@@ -539,6 +748,20 @@ static EdgeQuery queryEdgeDirections(
         edgeBMaxDistance, max_lane_idx);
 
 #else
+#ifdef MADRONA_NARROWPHASE_AVX2
+    if (b.soaEdges != nullptr) {
+        avx2::EdgeQueryResult simd_query =
+            avx2::queryEdgeDirections(a.mesh, a.center, *b.soaEdges);
+
+        return {
+            simd_query.separation,
+            simd_query.normal,
+            simd_query.hedgeIdxA,
+            simd_query.hedgeIdxB,
+        };
+    }
+#endif
+
     for (CountT edge_idx_a = 0; edge_idx_a < a_num_edges; edge_idx_a++) {
         int32_t he_idx_a = a.mesh.edgeToHalfEdge(edge_idx_a);
         for (CountT edge_idx_b = 0; edge_idx_b < b_num_edges; edge_idx_b++) {
@@ -656,15 +879,76 @@ struct SATResult {
     SATContact contact;
 };
 
-static inline SATResult doSAT(MADRONA_GPU_COND(int32_t mwgpu_lane_id,)
-                              const HullState &a, const HullState &b)
+// Re-tests the axis cached from the last time SAT ran on this pair. For
+// pairs whose AABBs overlap but whose hulls are apart, the old separating
+// axis almost always still separates, which skips the full face & edge
+// searches.
+static inline float cachedSATSeparation(
+    MADRONA_GPU_COND(int32_t mwgpu_lane_id,)
+    const HullState &a, const HullState &b,
+    const ContactCache::Entry &cache_entry)
+{
+    switch (cache_entry.satFeature) {
+    case ContactCache::SATFeature::FaceA: {
+        return getHullDistanceFromPlane(MADRONA_GPU_COND(mwgpu_lane_id,)
+            a.mesh.facePlanes[cache_entry.satIdxA], b);
+    } break;
+    case ContactCache::SATFeature::FaceB: {
+        return getHullDistanceFromPlane(MADRONA_GPU_COND(mwgpu_lane_id,)
+            b.mesh.facePlanes[cache_entry.satIdxB], a);
+    } break;
+    case ContactCache::SATFeature::EdgeAB: {
+        uint32_t hedge_idx_a = cache_entry.satIdxA;
+        uint32_t hedge_idx_b = cache_entry.satIdxB;
+
+        HalfEdge cur_hedge_a = a.mesh.halfEdges[hedge_idx_a];
+        HalfEdge twin_hedge_a = a.mesh.halfEdges[a.mesh.twinIDX(hedge_idx_a)];
+        HalfEdge cur_hedge_b = b.mesh.halfEdges[hedge_idx_b];
+        HalfEdge twin_hedge_b = b.mesh.halfEdges[b.mesh.twinIDX(hedge_idx_b)];
+
+        if (!buildsMinkowskiFace(a.mesh, b.mesh, cur_hedge_a, twin_hedge_a,
+                                 cur_hedge_b, twin_hedge_b)) {
+            return -FLT_MAX;
+        }
+
+        return edgeDistance(a, b, cur_hedge_a, cur_hedge_b).separation;
+    } break;
+    default: {
+        return -FLT_MAX;
+    } break;
+    }
+}
+
+static inline void cacheSATFeature(ContactCache::Entry *cache_entry,
+                                   ContactCache::SATFeature feature,
+                                   uint32_t idx_a,
+                                   uint32_t idx_b)
+{
+    if (cache_entry == nullptr) {
+        return;
+    }
+
+    cache_entry->satFeature = feature;
+    cache_entry->satIdxA = idx_a;
+    cache_entry->satIdxB = idx_b;
+}
+
+// Full face & edge searches of doSAT, for callers that already re-tested
+// the cached axis
+static inline SATResult doSATQueries(MADRONA_GPU_COND(int32_t mwgpu_lane_id,)
+                                     const HullState &a, const HullState &b,
+                                     ContactCache::Entry *cache_entry,
+                                     float max_sep)
 {
     PROF_START(sat_face_ctr, narrowphaseSATFaceClocks);
 
     FaceQuery faceQueryA =
         queryFaceDirections(MADRONA_GPU_COND(mwgpu_lane_id,) a, b);
-    if (faceQueryA.separation > 0.0f) {
+    if (faceQueryA.separation > max_sep) {
         // There is a separating axis - no collision
+        cacheSATFeature(cache_entry, ContactCache::SATFeature::FaceA,
+                        uint32_t(faceQueryA.faceIdx), 0);
+
         SATResult result;
         result.type = ContactType::None;
 
@@ -673,8 +957,11 @@ static inline SATResult doSAT(MADRONA_GPU_COND(int32_t mwgpu_lane_id,)
 
     FaceQuery faceQueryB =
         queryFaceDirections(MADRONA_GPU_COND(mwgpu_lane_id,) b, a);
-    if (faceQueryB.separation > 0.0f) {
+    if (faceQueryB.separation > max_sep) {
         // There is a separating axis - no collision
+        cacheSATFeature(cache_entry, ContactCache::SATFeature::FaceB,
+                        0, uint32_t(faceQueryB.faceIdx));
+
         SATResult result;
         result.type = ContactType::None;
 
@@ -686,8 +973,12 @@ static inline SATResult doSAT(MADRONA_GPU_COND(int32_t mwgpu_lane_id,)
 
     EdgeQuery edgeQuery =
         queryEdgeDirections(MADRONA_GPU_COND(mwgpu_lane_id,) a, b);
-    if (edgeQuery.separation > 0.0f) {
+    if (edgeQuery.separation > max_sep) {
         // There is a separating axis - no collision
+        cacheSATFeature(cache_entry, ContactCache::SATFeature::EdgeAB,
+                        uint32_t(edgeQuery.edgeIdxA),
+                        uint32_t(edgeQuery.edgeIdxB));
+
         SATResult result;
         result.type = ContactType::None;
 
@@ -698,11 +989,30 @@ static inline SATResult doSAT(MADRONA_GPU_COND(int32_t mwgpu_lane_id,)
 
     PROF_START(sat_finish_ctr, narrowphaseSATFinishClocks);
 
-    bool bIsFaceContactA = faceQueryA.separation > edgeQuery.separation;
-    bool bIsFaceContactB = faceQueryB.separation > edgeQuery.separation;
-
-    if (bIsFaceContactA || bIsFaceContactB) {
-        bool a_is_ref = faceQueryA.separation >= faceQueryB.separation;
+    // Nearly parallel edges and the two faces of a resting pair separate by
+    // almost the same amount, so without a bias the contact would flip
+    // between edge and face contacts, and between reference faces, from
+    // step to step under resting stacks.
+    float max_face_separation =
+        fmaxf(faceQueryA.separation, faceQueryB.separation);
+    bool is_edge_contact = edgeQuery.separation >
+        consts::satEdgeRelTolerance * max_face_separation +
+        consts::satAbsTolerance;
+
+    if (!is_edge_contact) {
+        bool a_is_ref = faceQueryB.separation <=
+            consts::satFaceRelTolerance * faceQueryA.separation +
+            consts::satAbsTolerance;
+
+        // The axis of minimum penetration is the most likely to separate
+        // the pair again once it comes apart
+        if (a_is_ref) {
+            cacheSATFeature(cache_entry, ContactCache::SATFeature::FaceA,
+                            uint32_t(faceQueryA.faceIdx), 0);
+        } else {
+            cacheSATFeature(cache_entry, ContactCache::SATFeature::FaceB,
+                            0, uint32_t(faceQueryB.faceIdx));
+        }
 
         Plane ref_plane = a_is_ref ? faceQueryA.plane : faceQueryB.plane;
         CountT ref_face_idx =
@@ -728,6 +1038,10 @@ static inline SATResult doSAT(MADRONA_GPU_COND(int32_t mwgpu_lane_id,)
 
         return result;
     } else {
+        cacheSATFeature(cache_entry, ContactCache::SATFeature::EdgeAB,
+                        uint32_t(edgeQuery.edgeIdxA),
+                        uint32_t(edgeQuery.edgeIdxB));
+
         SATResult result;
         result.type = ContactType::SATEdge;
         result.contact.normal = edgeQuery.normal;
@@ -738,15 +1052,60 @@ static inline SATResult doSAT(MADRONA_GPU_COND(int32_t mwgpu_lane_id,)
     }
 }
 
+#ifdef MADRONA_NARROWPHASE_AVX2
+// Builds the SoA copies the AVX2 queries use, only once a pair actually
+// needs the full SAT search. Out of line so callers that return early
+// (cached axis, GJK) don't reserve the copies' stack space.
+static MADRONA_NO_INLINE SATResult doSATQueriesSoA(
+    const HullState &a, const HullState &b,
+    ContactCache::Entry *cache_entry,
+    float max_sep)
+{
+    HullState a_soa = a;
+    HullState b_soa = b;
+
+    avx2::HullVertices a_soa_vertices;
+    avx2::HullVertices b_soa_vertices;
+    avx2::HullEdges b_soa_edges;
+    buildSoAHullState(a_soa, &a_soa_vertices, nullptr);
+    buildSoAHullState(b_soa, &b_soa_vertices, &b_soa_edges);
+
+    return doSATQueries(a_soa, b_soa, cache_entry, max_sep);
+}
+#endif
+
+// Hulls closer than max_sep still get a contact, with negative depth
+static inline SATResult doSAT(MADRONA_GPU_COND(int32_t mwgpu_lane_id,)
+                              const HullState &a, const HullState &b,
+                              ContactCache::Entry *cache_entry,
+                              float max_sep)
+{
+    if (cache_entry != nullptr && cachedSATSeparation(
+            MADRONA_GPU_COND(mwgpu_lane_id,) a, b, *cache_entry) > max_sep) {
+        SATResult result;
+        result.type = ContactType::None;
+
+        return result;
+    }
+
+#ifdef MADRONA_NARROWPHASE_AVX2
+    return doSATQueriesSoA(a, b, cache_entry, max_sep);
+#else
+    return doSATQueries(MADRONA_GPU_COND(mwgpu_lane_id,)
+        a, b, cache_entry, max_sep);
+#endif
+}
+
 SATResult doSATPlane(MADRONA_GPU_COND(const int32_t mwgpu_lane_id,)
-                     const Plane &plane, const HullState &h)
+                     const Plane &plane, const HullState &h,
+                     float max_sep)
 {
     PROF_START(sat_plane_ctr, narrowphaseSATPlaneClocks);
 
     float separation = getHullDistanceFromPlane(
         MADRONA_GPU_COND(mwgpu_lane_id,) plane, h);
 
-    if (separation > 0.0f) {
+    if (separation > max_sep) {
         SATResult result;
         result.type = ContactType::None;
 
@@ -768,6 +1127,130 @@ SATResult doSATPlane(MADRONA_GPU_COND(const int32_t mwgpu_lane_id,)
     return result;
 }
 
+static inline std::pair<CountT, float> findMostAlignedFace(
+    const HullState &h, Vector3 dir)
+{
+    float max_dot = -FLT_MAX;
+    CountT max_face = 0;
+
+    const CountT num_faces = (CountT)h.mesh.numFaces;
+    for (CountT i = 0; i < num_faces; i++) {
+        float face_dot = dot(h.mesh.facePlanes[i].normal, dir);
+        if (face_dot > max_dot) {
+            max_dot = face_dot;
+            max_face = i;
+        }
+    }
+
+    return { max_face, max_dot };
+}
+
+// GJK + EPA replacement for doSAT on complex hulls. GJK (for hulls within
+// max_sep) and EPA (for overlapping hulls) only give a direction and a
+// distance or depth, so when that direction matches a face normal, the
+// manifold is built by clipping faces exactly like a SAT face contact.
+// Otherwise (edge contacts or curved hulls) a single contact point is
+// returned in *point_contact, as a ContactType::Sphere result, with
+// negative depth for separated hulls.
+static inline SATResult doGJKEPA(const HullState &a, const HullState &b,
+                                 ContactCache::Entry *cache_entry,
+                                 SphereContact *point_contact,
+                                 float max_sep)
+{
+    if (cache_entry != nullptr && cachedSATSeparation(
+            a, b, *cache_entry) > max_sep) {
+        SATResult result;
+        result.type = ContactType::None;
+
+        return result;
+    }
+
+    HullHullGJKResult gjk = hullHullGJKEPA(a.mesh, b.mesh, 1e-10f);
+
+    if (gjk.distance > max_sep) {
+        // Cache the face closest to the separating direction: it's cheap to
+        // re-test and usually keeps separating the pair next step
+        auto [sep_face_idx, sep_face_dot] =
+            findMostAlignedFace(a, gjk.normal);
+        (void)sep_face_dot;
+
+        cacheSATFeature(cache_entry, ContactCache::SATFeature::FaceA,
+                        uint32_t(sep_face_idx), 0);
+
+        SATResult result;
+        result.type = ContactType::None;
+
+        return result;
+    }
+
+    if (!gjk.valid) {
+        // EPA can't build a polytope around the origin when the hulls are
+        // barely touching, SAT handles this case exactly. The cached axis
+        // was already re-tested above.
+#ifdef MADRONA_NARROWPHASE_AVX2
+        return doSATQueriesSoA(a, b, cache_entry, max_sep);
+#else
+        return doSATQueries(a, b, cache_entry, max_sep);
+#endif
+    }
+
+    Vector3 normal = gjk.normal;
+
+    auto [a_face_idx, a_face_dot] = findMostAlignedFace(a, normal);
+    auto [b_face_idx, b_face_dot] = findMostAlignedFace(b, -normal);
+
+    if (fmaxf(a_face_dot, b_face_dot) >= consts::gjkFaceContactCos) {
+        bool a_is_ref = a_face_dot >= b_face_dot;
+
+        CountT ref_face_idx;
+        Plane ref_plane;
+        CountT incident_face_idx;
+        uint32_t mask;
+        if (a_is_ref) {
+            ref_face_idx = a_face_idx;
+            ref_plane = a.mesh.facePlanes[a_face_idx];
+            incident_face_idx = findIncidentFace(b, ref_plane.normal);
+            mask = 0_u32;
+
+            cacheSATFeature(cache_entry, ContactCache::SATFeature::FaceA,
+                            uint32_t(ref_face_idx), 0);
+        } else {
+            ref_face_idx = b_face_idx;
+            ref_plane = b.mesh.facePlanes[b_face_idx];
+            incident_face_idx = findIncidentFace(a, ref_plane.normal);
+            mask = 1_u32 << 31_u32;
+
+            cacheSATFeature(cache_entry, ContactCache::SATFeature::FaceB,
+                            0, uint32_t(ref_face_idx));
+        }
+
+        SATResult result;
+        result.type = ContactType::SATFace;
+        result.contact.normal = ref_plane.normal;
+        result.contact.planeDOrSeparation = ref_plane.d;
+        result.contact.refFaceIdxOrEdgeIdxA = uint32_t(ref_face_idx) | mask;
+        result.contact.incidentFaceIdxOrEdgeIdxB = uint32_t(incident_face_idx);
+
+        return result;
+    }
+
+    cacheSATFeature(cache_entry, ContactCache::SATFeature::None, 0, 0);
+
+    // Same layout as the sphere contacts: b is the reference, the normal
+    // points from b to a and the point is on a's surface. One of distance
+    // and depth is always 0.
+    *point_contact = SphereContact {
+        .normal = -normal,
+        .pt = gjk.aPoint,
+        .depth = gjk.depth - gjk.distance,
+    };
+
+    SATResult result;
+    result.type = ContactType::Sphere;
+
+    return result;
+}
+
 static Manifold buildFaceContactManifold(
     Vector3 contact_normal,
     Vector3 *contacts,
@@ -888,7 +1371,8 @@ MADRONA_ALWAYS_INLINE static inline Manifold createFaceContact(
 #ifdef MADRONA_GPU_MODE
                                   Mat3x4 ref_txfm, Mat3x4 other_txfm,
 #endif
-                                  Vector3 world_offset, Quat to_world_frame)
+                                  Vector3 world_offset, Quat to_world_frame,
+                                  float max_sep)
 {
     // Collect incident vertices: FIXME should have face indices
     Vector3 *incident_vertices_tmp = (Vector3 *)tmp_buf1;
@@ -959,19 +1443,22 @@ MADRONA_ALWAYS_INLINE static inline Manifold createFaceContact(
         } while (hedge_idx != start_hedge_idx);
     }
 
-    assert(num_clipped_vertices > 0);
+    // Separated hulls (speculative contacts) can clip to nothing when the
+    // incident face doesn't overlap the reference face once projected onto
+    // it, e.g. a box just past the edge of a thin plate. The manifold is
+    // left empty then, like when every clipped vertex is above max_sep.
 
     // clipping_input has the result due to the final swap
 
-    // Filter clipping_input to ones below ref_plane and save penetration depth
+    // Filter clipping_input to ones below ref_plane (or within max_sep of
+    // it) and save penetration depth
     float *penetration_depths = (float *)clipping_dst;
 
     CountT num_below_plane = 0;
     for (CountT i = 0; i < num_clipped_vertices; ++i) {
         Vector3 vertex = clipping_input[i];
-        if (float d = getDistanceFromPlane(ref_plane, vertex); d <= 0.0f) {
+        if (float d = getDistanceFromPlane(ref_plane, vertex); d <= max_sep) {
             // Project the point onto the reference plane
-            // (d guaranteed to be negative)
             clipping_input[num_below_plane] = vertex - d * ref_plane.normal;
             penetration_depths[num_below_plane] = -d;
 
@@ -995,7 +1482,8 @@ static Manifold createFacePlaneContact(Plane plane,
                                        Mat3x4 hull_txfm,
 #endif
                                        Vector3 world_offset,
-                                       Quat to_world_frame)
+                                       Quat to_world_frame,
+                                       float max_sep)
 {
     // Collect incident vertices: FIXME should have face indices
     CountT num_incident_vertices = 0;
@@ -1012,9 +1500,8 @@ static Manifold createFacePlaneContact(Plane plane,
             vertex = hull_txfm.txfmPoint(vertex);
 #endif
 
-            if (float d = getDistanceFromPlane(plane, vertex); d <= 0.0f) {
+            if (float d = getDistanceFromPlane(plane, vertex); d <= max_sep) {
                 // Project the point onto the reference plane
-                // (d guaranteed to be negative)
                 contacts_tmp[num_incident_vertices] =
                     vertex - d * plane.normal;
                 penetration_depths_tmp[num_incident_vertices] = -d;
@@ -1133,17 +1620,85 @@ static Manifold createEdgeContact(Vector3 normal,
                              world_offset, to_world_frame);
 }
 
+// Carries impulses over from the pair's previous manifold by matching
+// points in the reference body's local space, so the solver can warm start
+// from the last solution. Points with no match start from zero.
+static inline void updateCachedContactPoints(
+    Context &ctx,
+    int32_t cache_idx,
+    Loc ref_loc,
+    const Vector4 *points,
+    int32_t num_points,
+    Vector3 normal)
+{
+    if (cache_idx == -1) {
+        return;
+    }
+
+    ContactCache &contact_cache = ctx.singleton<ContactCache>();
+    ContactCache::Entry &entry = contact_cache.entries[cache_idx];
+
+    Vector3 ref_pos = ctx.getDirect<Position>(RGDCols::Position, ref_loc);
+    Quat to_ref_local =
+        ctx.getDirect<Rotation>(RGDCols::Rotation, ref_loc).inv();
+
+    int32_t num_prev_points = entry.numPoints;
+    if (dot(entry.normal, normal) < ContactCache::normalMatchCos) {
+        num_prev_points = 0;
+    }
+
+    Vector3 local_points[4];
+    float normal_impulses[4];
+    float tangent_impulses[4][2];
+
+    constexpr float max_match_dist2 = ContactCache::pointMatchDistance *
+        ContactCache::pointMatchDistance;
+
+    for (int32_t i = 0; i < num_points; i++) {
+        Vector3 local = to_ref_local.rotateVec(points[i].xyz() - ref_pos);
+        local_points[i] = local;
+
+        normal_impulses[i] = 0.f;
+        tangent_impulses[i][0] = 0.f;
+        tangent_impulses[i][1] = 0.f;
+
+        float closest_dist2 = max_match_dist2;
+        for (int32_t j = 0; j < num_prev_points; j++) {
+            float dist2 = local.distance2(entry.localPoints[j]);
+            if (dist2 < closest_dist2) {
+                closest_dist2 = dist2;
+                normal_impulses[i] = entry.normalImpulses[j];
+                tangent_impulses[i][0] = entry.tangentImpulses[j][0];
+                tangent_impulses[i][1] = entry.tangentImpulses[j][1];
+            }
+        }
+    }
+
+    entry.numPoints = num_points;
+    entry.normal = normal;
+    for (int32_t i = 0; i < num_points; i++) {
+        entry.localPoints[i] = local_points[i];
+        entry.normalImpulses[i] = normal_impulses[i];
+        entry.tangentImpulses[i][0] = tangent_impulses[i][0];
+        entry.tangentImpulses[i][1] = tangent_impulses[i][1];
+    }
+}
+
 static inline void addManifoldContacts(
     Context &ctx,
     Manifold manifold,
-    Loc ref_loc, Loc other_loc)
+    Loc ref_loc, Loc other_loc,
+    int32_t cache_idx)
 {
     PROF_START(save_contacts_ctr, narrowphaseSaveContactsClocks);
 
     const auto &physics_sys = ctx.singleton<PhysicsSystemState>();
 
     Loc c = ctx.makeTemporary(physics_sys.contactArchetypeID);
-    ctx.getDirect<ContactConstraint>(RGDCols::ContactConstraint, c) = {
+    ContactConstraint &contact =
+        ctx.getDirect<ContactConstraint>(RGDCols::ContactConstraint, c);
+
+    contact = {
         ref_loc,
         other_loc,
         {
@@ -1158,7 +1713,11 @@ static inline void addManifoldContacts(
         },
         manifold.numContactPoints,
         manifold.normal,
+        cache_idx,
     };
+
+    updateCachedContactPoints(ctx, cache_idx, ref_loc, contact.points,
+                              contact.numPoints, contact.normal);
 }
 
 static inline void addSinglePointContact(
@@ -1167,13 +1726,16 @@ static inline void addSinglePointContact(
     Vector3 normal,
     float depth,
     Loc ref_loc,
-    Loc other_loc)
+    Loc other_loc,
+    int32_t cache_idx)
 {
     const auto &physics_sys = ctx.singleton<PhysicsSystemState>();
 
     Loc c = ctx.makeTemporary(physics_sys.contactArchetypeID);
+    ContactConstraint &contact =
+        ctx.getDirect<ContactConstraint>(RGDCols::ContactConstraint, c);
 
-    ctx.getDirect<ContactConstraint>(RGDCols::ContactConstraint, c) = {
+    contact = {
         ref_loc,
         other_loc,
         {
@@ -1184,7 +1746,11 @@ static inline void addSinglePointContact(
         },
         1,
         normal,
+        cache_idx,
     };
+
+    updateCachedContactPoints(ctx, cache_idx, ref_loc, contact.points,
+                              contact.numPoints, contact.normal);
 }
 
 #ifdef MADRONA_GPU_MODE
@@ -1199,6 +1765,7 @@ struct NarrowphaseResult {
     ContactType type;
     SphereContact sphere;
     SATContact sat;
+    prims::Contact primitive;
     const Vector3 *aVertices;
     const Vector3 *bVertices;
     const HalfEdge *aHalfEdges;
@@ -1207,6 +1774,150 @@ struct NarrowphaseResult {
     const uint32_t *bFaceHedgeRoots;
 };
 
+// margin grows the radius for speculative contacts, see primitiveResult
+static inline prims::CapsuleShape makeCapsuleShape(
+    const CollisionPrimitive::Capsule &capsule,
+    Vector3 pos, Quat rot, Diag3x3 scale,
+    float margin = 0.f)
+{
+    assert(scale.d0 == scale.d1);
+
+    Vector3 half_segment = rot.rotateVec(
+        { 0, 0, 0.5f * scale.d2 * capsule.cylinderHeight });
+
+    return prims::CapsuleShape {
+        .p1 = pos - half_segment,
+        .p2 = pos + half_segment,
+        .radius = scale.d0 * capsule.radius + margin,
+    };
+}
+
+static inline prims::BoxShape makeBoxShape(
+    const CollisionPrimitive::Box &box,
+    Vector3 pos, Quat rot, Diag3x3 scale)
+{
+    return prims::BoxShape {
+        .center = pos,
+        .rot = rot,
+        .halfExtents = scale * box.halfExtents,
+    };
+}
+
+static inline Plane makeWorldPlane(Vector3 pos, Quat rot)
+{
+    Vector3 plane_normal = rot.rotateVec({ 0, 0, 1 });
+
+    return Plane {
+        plane_normal,
+        dot(plane_normal, pos),
+    };
+}
+
+// The primitive routines don't take a speculative margin themselves (other
+// than box vs box and box vs plane), so round shapes are tested with their
+// radius grown by the margin instead. This takes the margin back out of the
+// depths, and if b was the grown shape, moves the points back onto its
+// actual surface.
+static inline NarrowphaseResult primitiveResult(
+    bool hit, const prims::Contact &contact,
+    float grown_margin = 0.f, bool b_grown = false)
+{
+    NarrowphaseResult result;
+    if (!hit) {
+        result.type = ContactType::None;
+        return result;
+    }
+
+    result.type = ContactType::Primitive;
+    result.primitive = contact;
+
+    for (CountT i = 0; i < (CountT)contact.numPoints; i++) {
+        result.primitive.depths[i] -= grown_margin;
+
+        if (b_grown) {
+            result.primitive.points[i] -= grown_margin * contact.normal;
+        }
+    }
+    result.aVertices = nullptr;
+    result.bVertices = nullptr;
+    result.aHalfEdges = nullptr;
+    result.bHalfEdges = nullptr;
+    result.aFaceHedgeRoots = nullptr;
+    result.bFaceHedgeRoots = nullptr;
+    return result;
+}
+
+// Shared by the hull vs hull and hull vs box tests, the latter passing the
+// box in as a scaled unit box hull
+static inline NarrowphaseResult hullHullNarrowphase(
+    MADRONA_GPU_COND(const int32_t mwgpu_lane_id,)
+    const HalfEdgeMesh &a_he_mesh, const HalfEdgeMesh &b_he_mesh,
+    Vector3 a_pos, Vector3 b_pos,
+    Quat a_rot, Quat b_rot,
+    Diag3x3 a_scale, Diag3x3 b_scale,
+    CountT max_num_tmp_vertices,
+    CountT max_num_tmp_faces,
+    Vector3 *txfm_vertex_buffer,
+    Plane *txfm_face_buffer,
+    ContactCache::Entry *cache_entry,
+    float max_sep)
+{
+    assert(a_he_mesh.numFaces + b_he_mesh.numFaces < 
+           max_num_tmp_faces);
+
+    assert(a_he_mesh.numVertices + b_he_mesh.numVertices < 
+           max_num_tmp_vertices);
+
+    PROF_START(txfm_hull_ctr, narrowphaseTxfmHullCtrs);
+
+    HullState a_hull_state = makeHullState(MADRONA_GPU_COND(mwgpu_lane_id,)
+        a_he_mesh, a_pos, a_rot, a_scale, txfm_vertex_buffer,
+        txfm_face_buffer);
+
+    txfm_vertex_buffer += a_hull_state.mesh.numVertices;
+    txfm_face_buffer += a_hull_state.mesh.numFaces;
+
+    HullState b_hull_state = makeHullState(MADRONA_GPU_COND(mwgpu_lane_id,)
+        b_he_mesh, b_pos, b_rot, b_scale, txfm_vertex_buffer,
+        txfm_face_buffer);
+
+    MADRONA_GPU_COND(__syncwarp(mwGPU::allActive));
+
+    PROF_END(txfm_hull_ctr);
+
+    NarrowphaseResult result;
+
+#ifdef MADRONA_GPU_MODE
+    const SATResult sat = doSAT(mwgpu_lane_id,
+        a_hull_state, b_hull_state, cache_entry, max_sep);
+#else
+    SATResult sat;
+    if (a_he_mesh.numEdges() * b_he_mesh.numEdges() >
+            consts::gjkMinEdgePairs) {
+        sat = doGJKEPA(a_hull_state, b_hull_state, cache_entry,
+                       &result.sphere, max_sep);
+    } else {
+        sat = doSAT(a_hull_state, b_hull_state, cache_entry, max_sep);
+    }
+#endif
+
+    result.type = sat.type;
+    result.sat = sat.contact;
+#ifdef MADRONA_GPU_MODE
+    result.aVertices = a_he_mesh.vertices;
+    result.bVertices = b_he_mesh.vertices;
+#else
+    result.aVertices = a_hull_state.mesh.vertices;
+    result.bVertices = b_hull_state.mesh.vertices;
+#endif
+    result.aHalfEdges = a_hull_state.mesh.halfEdges;
+    result.bHalfEdges = b_hull_state.mesh.halfEdges;
+    result.aFaceHedgeRoots = a_hull_state.mesh.faceBaseHalfEdges;
+    result.bFaceHedgeRoots = b_hull_state.mesh.faceBaseHalfEdges;
+
+    return result;
+}
+
 MADRONA_ALWAYS_INLINE static inline NarrowphaseResult narrowphaseDispatch(
     MADRONA_GPU_COND(const int32_t mwgpu_lane_id,)
     NarrowphaseTest test_type,
@@ -1217,7 +1928,10 @@ MADRONA_ALWAYS_INLINE static inline NarrowphaseResult narrowphaseDispatch(
     CountT max_num_tmp_vertices,
     CountT max_num_tmp_faces,
     Vector3 *txfm_vertex_buffer,
-    Plane *txfm_face_buffer)
+    Plane *txfm_face_buffer,
+    prims::UnitBoxHull *unit_box_hull,
+    ContactCache::Entry *cache_entry,
+    float max_sep)
 {
     PROF_START(switch_body_ctr, narrowphaseSwitchClocks);
 
@@ -1235,7 +1949,7 @@ MADRONA_ALWAYS_INLINE static inline NarrowphaseResult narrowphaseDispatch(
         Vector3 to_b = b_pos - a_pos;
         float dist = to_b.length();
 
-        if (dist > a_radius + b_radius) {
+        if (dist > a_radius + b_radius + max_sep) {
             NarrowphaseResult result;
             result.type = ContactType::None;
             return result;
@@ -1272,52 +1986,11 @@ MADRONA_ALWAYS_INLINE static inline NarrowphaseResult narrowphaseDispatch(
         return result;
     } break;
     case NarrowphaseTest::HullHull: {
-        // Get half edge mesh for hull A and hull B
-        const auto &a_he_mesh = a_prim->hull.halfEdgeMesh;
-        const auto &b_he_mesh = b_prim->hull.halfEdgeMesh;
-
-        assert(a_he_mesh.numFaces + b_he_mesh.numFaces < 
-               max_num_tmp_faces);
-
-        assert(a_he_mesh.numVertices + b_he_mesh.numVertices < 
-               max_num_tmp_vertices);
-
-        PROF_START(txfm_hull_ctr, narrowphaseTxfmHullCtrs);
-
-        HullState a_hull_state = makeHullState(MADRONA_GPU_COND(mwgpu_lane_id,)
-            a_he_mesh, a_pos, a_rot, a_scale, txfm_vertex_buffer,
-            txfm_face_buffer);
-
-        txfm_vertex_buffer += a_hull_state.mesh.numVertices;
-        txfm_face_buffer += a_hull_state.mesh.numFaces;
-
-        HullState b_hull_state = makeHullState(MADRONA_GPU_COND(mwgpu_lane_id,)
-            b_he_mesh, b_pos, b_rot, b_scale, txfm_vertex_buffer,
-            txfm_face_buffer);
-
-        MADRONA_GPU_COND(__syncwarp(mwGPU::allActive));
-
-        PROF_END(txfm_hull_ctr);
-
-        const SATResult sat = doSAT(MADRONA_GPU_COND(mwgpu_lane_id,)
-            a_hull_state, b_hull_state);
-
-        NarrowphaseResult result;
-        result.type = sat.type;
-        result.sat = sat.contact;
-#ifdef MADRONA_GPU_MODE
-        result.aVertices = a_he_mesh.vertices;
-        result.bVertices = b_he_mesh.vertices;
-#else
-        result.aVertices = a_hull_state.mesh.vertices;
-        result.bVertices = b_hull_state.mesh.vertices;
-#endif
-        result.aHalfEdges = a_hull_state.mesh.halfEdges;
-        result.bHalfEdges = b_hull_state.mesh.halfEdges;
-        result.aFaceHedgeRoots = a_hull_state.mesh.faceBaseHalfEdges;
-        result.bFaceHedgeRoots = b_hull_state.mesh.faceBaseHalfEdges;
-
-        return result;
+        return hullHullNarrowphase(MADRONA_GPU_COND(mwgpu_lane_id,)
+            a_prim->hull.halfEdgeMesh, b_prim->hull.halfEdgeMesh,
+            a_pos, b_pos, a_rot, b_rot, a_scale, b_scale,
+            max_num_tmp_vertices, max_num_tmp_faces,
+            txfm_vertex_buffer, txfm_face_buffer, cache_entry, max_sep);
     } break;
     case NarrowphaseTest::SphereHull: {
         float sphere_radius;
@@ -1347,7 +2020,8 @@ MADRONA_ALWAYS_INLINE static inline NarrowphaseResult narrowphaseDispatch(
         float hull_dist2 = hullClosestPointToOriginGJK(
             b_hull_state.mesh, 1e-10f, &to_hull_closest_pt);
 
-        if (hull_dist2 > sphere_radius * sphere_radius) {
+        float max_dist = sphere_radius + max_sep;
+        if (hull_dist2 > max_dist * max_dist) {
             NarrowphaseResult result;
             result.type = ContactType::None;
             return result;
@@ -1357,7 +2031,7 @@ MADRONA_ALWAYS_INLINE static inline NarrowphaseResult narrowphaseDispatch(
 
         if (hull_dist2 == 0.f) {
             // Need to do SAT
-            float max_sep = -FLT_MAX;
+            float max_face_sep = -FLT_MAX;
             Vector3 sep_normal;
             const CountT num_faces = b_hull_state.mesh.numFaces;
             for (CountT i = 0; i < num_faces; i++) {
@@ -1365,22 +2039,22 @@ MADRONA_ALWAYS_INLINE static inline NarrowphaseResult narrowphaseDispatch(
                 // hull has already been moved so sphere is at origin
                 float face_dist = -plane.d;
 
-                if (face_dist > max_sep) {
-                    max_sep = face_dist;
+                if (face_dist > max_face_sep) {
+                    max_face_sep = face_dist;
                     sep_normal = plane.normal;
                 }
             }
 
             // Discrepancy between SAT and GJK
-            if (max_sep > 0.f) {
-                assert(max_sep < 1e-5f);
+            if (max_face_sep > 0.f) {
+                assert(max_face_sep < 1e-5f);
                 NarrowphaseResult result;
                 result.type = ContactType::None;
                 return result;
             }
             sphere_contact.normal = sep_normal;
             sphere_contact.pt = a_pos + sep_normal * sphere_radius;
-            sphere_contact.depth = -max_sep;
+            sphere_contact.depth = -max_face_sep;
         } else {
             float to_hull_len = sqrtf(hull_dist2);
 
@@ -1405,6 +2079,231 @@ MADRONA_ALWAYS_INLINE static inline NarrowphaseResult narrowphaseDispatch(
         result.bFaceHedgeRoots = nullptr;
         return result;
     } break;
+    case NarrowphaseTest::CapsuleCapsule: {
+        prims::Contact contact;
+        bool hit = prims::capsuleCapsule(
+            makeCapsuleShape(a_prim->capsule, a_pos, a_rot, a_scale, max_sep),
+            makeCapsuleShape(b_prim->capsule, b_pos, b_rot, b_scale),
+            &contact);
+
+        return primitiveResult(hit, contact, max_sep);
+    } break;
+    case NarrowphaseTest::SphereCapsule: {
+        assert(a_scale.d0 == a_scale.d1 && a_scale.d0 == a_scale.d2);
+
+        prims::Contact contact;
+        bool hit = prims::sphereCapsule(
+            a_pos, a_scale.d0 * a_prim->sphere.radius + max_sep,
+            makeCapsuleShape(b_prim->capsule, b_pos, b_rot, b_scale),
+            &contact);
+
+        return primitiveResult(hit, contact, max_sep);
+    } break;
+    case NarrowphaseTest::HullCapsule: {
+        const auto &a_he_mesh = a_prim->hull.halfEdgeMesh;
+        assert(a_he_mesh.numFaces < max_num_tmp_faces);
+        assert(a_he_mesh.numVertices < max_num_tmp_vertices);
+
+        HullState a_hull_state = makeHullState(MADRONA_GPU_COND(mwgpu_lane_id,)
+            a_he_mesh, a_pos, a_rot, a_scale,
+            txfm_vertex_buffer, txfm_face_buffer);
+
+        MADRONA_GPU_COND(__syncwarp(mwGPU::allActive));
+
+        prims::Contact contact;
+        bool hit = prims::hullCapsule(a_hull_state.mesh,
+            makeCapsuleShape(b_prim->capsule, b_pos, b_rot, b_scale, max_sep),
+            &contact);
+
+        return primitiveResult(hit, contact, max_sep, true);
+    } break;
+    case NarrowphaseTest::BoxBox: {
+        prims::Contact contact;
+        bool hit = prims::boxBox(
+            makeBoxShape(a_prim->box, a_pos, a_rot, a_scale),
+            makeBoxShape(b_prim->box, b_pos, b_rot, b_scale),
+            &contact, max_sep);
+
+        return primitiveResult(hit, contact);
+    } break;
+    case NarrowphaseTest::SphereBox: {
+        assert(a_scale.d0 == a_scale.d1 && a_scale.d0 == a_scale.d2);
+
+        prims::Contact contact;
+        bool hit = prims::sphereBox(
+            a_pos, a_scale.d0 * a_prim->sphere.radius + max_sep,
+            makeBoxShape(b_prim->box, b_pos, b_rot, b_scale),
+            &contact);
+
+        return primitiveResult(hit, contact, max_sep);
+    } break;
+    case NarrowphaseTest::HullBox: {
+        // Arbitrary hulls have no closed form test, so the box goes through
+        // the hull path as a scaled unit box
+        *unit_box_hull = prims::makeUnitBoxHull();
+
+        Vector3 half_extents = b_prim->box.halfExtents;
+        Diag3x3 box_scale {
+            b_scale.d0 * half_extents.x,
+            b_scale.d1 * half_extents.y,
+            b_scale.d2 * half_extents.z,
+        };
+
+        return hullHullNarrowphase(MADRONA_GPU_COND(mwgpu_lane_id,)
+            a_prim->hull.halfEdgeMesh, unit_box_hull->mesh(),
+            a_pos, b_pos, a_rot, b_rot, a_scale, box_scale,
+            max_num_tmp_vertices, max_num_tmp_faces,
+            txfm_vertex_buffer, txfm_face_buffer, cache_entry, max_sep);
+    } break;
+    case NarrowphaseTest::CapsuleBox: {
+        prims::Contact contact;
+        bool hit = prims::capsuleBox(
+            makeCapsuleShape(a_prim->capsule, a_pos, a_rot, a_scale, max_sep),
+            makeBoxShape(b_prim->box, b_pos, b_rot, b_scale),
+            &contact);
+
+        return primitiveResult(hit, contact, max_sep);
+    } break;
+    case NarrowphaseTest::HeightfieldHeightfield: {
+        // Heightfields must be static, this should never be called
+        assert(false);
+        MADRONA_UNREACHABLE();
+    } break;
+    case NarrowphaseTest::SphereHeightfield: {
+        assert(a_scale.d0 == a_scale.d1 && a_scale.d0 == a_scale.d2);
+
+        prims::Contact contact;
+        bool hit = prims::sphereHeightfield(
+            a_pos, a_scale.d0 * a_prim->sphere.radius + max_sep,
+            prims::makeHeightfieldShape(b_prim->heightfield, b_scale),
+            b_pos, b_rot, &contact);
+
+        return primitiveResult(hit, contact, max_sep);
+    } break;
+    case NarrowphaseTest::HullHeightfield: {
+        const auto &a_he_mesh = a_prim->hull.halfEdgeMesh;
+        assert(a_he_mesh.numFaces < max_num_tmp_faces);
+        assert(a_he_mesh.numVertices < max_num_tmp_vertices);
+
+        HullState a_hull_state = makeHullState(MADRONA_GPU_COND(mwgpu_lane_id,)
+            a_he_mesh, a_pos, a_rot, a_scale,
+            txfm_vertex_buffer, txfm_face_buffer);
+
+        MADRONA_GPU_COND(__syncwarp(mwGPU::allActive));
+
+        prims::Contact contact;
+        bool hit = prims::hullHeightfield(a_hull_state.mesh,
+            prims::makeHeightfieldShape(b_prim->heightfield, b_scale),
+            b_pos, b_rot, &contact);
+
+        return primitiveResult(hit, contact);
+    } break;
+    case NarrowphaseTest::CapsuleHeightfield: {
+        prims::Contact contact;
+        bool hit = prims::capsuleHeightfield(
+            makeCapsuleShape(a_prim->capsule, a_pos, a_rot, a_scale, max_sep),
+            prims::makeHeightfieldShape(b_prim->heightfield, b_scale),
+            b_pos, b_rot, &contact);
+
+        return primitiveResult(hit, contact, max_sep);
+    } break;
+    case NarrowphaseTest::BoxHeightfield: {
+        // Same path as hulls, with the box as a scaled unit box
+        *unit_box_hull = prims::makeUnitBoxHull();
+
+        Vector3 half_extents = a_prim->box.halfExtents;
+        Diag3x3 box_scale {
+            a_scale.d0 * half_extents.x,
+            a_scale.d1 * half_extents.y,
+            a_scale.d2 * half_extents.z,
+        };
+
+        HullState a_hull_state = makeHullState(MADRONA_GPU_COND(mwgpu_lane_id,)
+            unit_box_hull->mesh(), a_pos, a_rot, box_scale,
+            txfm_vertex_buffer, txfm_face_buffer);
+
+        MADRONA_GPU_COND(__syncwarp(mwGPU::allActive));
+
+        prims::Contact contact;
+        bool hit = prims::hullHeightfield(a_hull_state.mesh,
+            prims::makeHeightfieldShape(b_prim->heightfield, b_scale),
+            b_pos, b_rot, &contact);
+
+        return primitiveResult(hit, contact);
+    } break;
+    case NarrowphaseTest::TriangleMeshTriangleMesh: {
+        // Triangle meshes must be static, this should never be called
+        assert(false);
+        MADRONA_UNREACHABLE();
+    } break;
+    case NarrowphaseTest::SphereTriangleMesh: {
+        assert(a_scale.d0 == a_scale.d1 && a_scale.d0 == a_scale.d2);
+
+        prims::Contact contact;
+        bool hit = prims::sphereTriangleMesh(
+            a_pos, a_scale.d0 * a_prim->sphere.radius + max_sep,
+            prims::makeTriangleMeshShape(b_prim->triangleMesh, b_scale),
+            b_pos, b_rot, &contact);
+
+        return primitiveResult(hit, contact, max_sep);
+    } break;
+    case NarrowphaseTest::HullTriangleMesh: {
+        const auto &a_he_mesh = a_prim->hull.halfEdgeMesh;
+        assert(a_he_mesh.numFaces < max_num_tmp_faces);
+        assert(a_he_mesh.numVertices < max_num_tmp_vertices);
+
+        HullState a_hull_state = makeHullState(MADRONA_GPU_COND(mwgpu_lane_id,)
+            a_he_mesh, a_pos, a_rot, a_scale,
+            txfm_vertex_buffer, txfm_face_buffer);
+
+        MADRONA_GPU_COND(__syncwarp(mwGPU::allActive));
+
+        prims::Contact contact;
+        bool hit = prims::hullTriangleMesh(a_hull_state.mesh,
+            prims::makeTriangleMeshShape(b_prim->triangleMesh, b_scale),
+            b_pos, b_rot, &contact);
+
+        return primitiveResult(hit, contact);
+    } break;
+    case NarrowphaseTest::CapsuleTriangleMesh: {
+        prims::Contact contact;
+        bool hit = prims::capsuleTriangleMesh(
+            makeCapsuleShape(a_prim->capsule, a_pos, a_rot, a_scale, max_sep),
+            prims::makeTriangleMeshShape(b_prim->triangleMesh, b_scale),
+            b_pos, b_rot, &contact);
+
+        return primitiveResult(hit, contact, max_sep);
+    } break;
+    case NarrowphaseTest::BoxTriangleMesh: {
+        // Same path as hulls, with the box as a scaled unit box
+        *unit_box_hull = prims::makeUnitBoxHull();
+
+        Vector3 half_extents = a_prim->box.halfExtents;
+        Diag3x3 box_scale {
+            a_scale.d0 * half_extents.x,
+            a_scale.d1 * half_extents.y,
+            a_scale.d2 * half_extents.z,
+        };
+
+        HullState a_hull_state = makeHullState(MADRONA_GPU_COND(mwgpu_lane_id,)
+            unit_box_hull->mesh(), a_pos, a_rot, box_scale,
+            txfm_vertex_buffer, txfm_face_buffer);
+
+        MADRONA_GPU_COND(__syncwarp(mwGPU::allActive));
+
+        prims::Contact contact;
+        bool hit = prims::hullTriangleMesh(a_hull_state.mesh,
+            prims::makeTriangleMeshShape(b_prim->triangleMesh, b_scale),
+            b_pos, b_rot, &contact);
+
+        return primitiveResult(hit, contact);
+    } break;
+    case NarrowphaseTest::HeightfieldTriangleMesh: {
+        // Heightfields and triangle meshes must be static, this should
+        // never be called
+        assert(false);
+        MADRONA_UNREACHABLE();
+    } break;
     case NarrowphaseTest::PlanePlane: {
         // Planes must be static, this should never be called
         assert(false);
@@ -1425,7 +2324,7 @@ MADRONA_ALWAYS_INLINE static inline NarrowphaseResult narrowphaseDispatch(
         float t = plane_normal.dot(a_pos) - d;
 
         float penetration = sphere_radius - t;
-        if (penetration < 0) {
+        if (penetration < -max_sep) {
             NarrowphaseResult result;
             result.type = ContactType::None;
             return result;
@@ -1487,7 +2386,7 @@ MADRONA_ALWAYS_INLINE static inline NarrowphaseResult narrowphaseDispatch(
         };
 
         const SATResult sat = doSATPlane(
-            MADRONA_GPU_COND(mwgpu_lane_id,) plane, a_hull_state);
+            MADRONA_GPU_COND(mwgpu_lane_id,) plane, a_hull_state, max_sep);
 
         NarrowphaseResult result;
         result.type = sat.type;
@@ -1505,6 +2404,34 @@ MADRONA_ALWAYS_INLINE static inline NarrowphaseResult narrowphaseDispatch(
         result.bFaceHedgeRoots = nullptr;
         return result;
     } break;
+    case NarrowphaseTest::CapsulePlane: {
+        prims::Contact contact;
+        bool hit = prims::capsulePlane(
+            makeCapsuleShape(a_prim->capsule, a_pos, a_rot, a_scale, max_sep),
+            makeWorldPlane(b_pos, b_rot), &contact);
+
+        return primitiveResult(hit, contact, max_sep);
+    } break;
+    case NarrowphaseTest::BoxPlane: {
+        prims::Contact contact;
+        bool hit = prims::boxPlane(
+            makeBoxShape(a_prim->box, a_pos, a_rot, a_scale),
+            makeWorldPlane(b_pos, b_rot), &contact, max_sep);
+
+        return primitiveResult(hit, contact);
+    } break;
+    case NarrowphaseTest::HeightfieldPlane: {
+        // Heightfields and planes must be static, this should never be
+        // called
+        assert(false);
+        MADRONA_UNREACHABLE();
+    } break;
+    case NarrowphaseTest::TriangleMeshPlane: {
+        // Triangle meshes and planes must be static, this should never be
+        // called
+        assert(false);
+        MADRONA_UNREACHABLE();
+    } break;
     default: MADRONA_UNREACHABLE();
     }
 }
@@ -1517,7 +2444,9 @@ MADRONA_ALWAYS_INLINE static inline void generateContacts(
     Vector3 a_pos, Quat a_rot, Diag3x3 a_scale,
     Vector3 b_pos, Quat b_rot, Diag3x3 b_scale,
 #endif
-    void *thread_tmp_storage_a, void *thread_tmp_storage_b)
+    int32_t cache_idx,
+    void *thread_tmp_storage_a, void *thread_tmp_storage_b,
+    float max_sep)
 {
     switch (narrowphase_result.type) {
     case ContactType::None: {
@@ -1527,7 +2456,7 @@ MADRONA_ALWAYS_INLINE static inline void generateContacts(
         SphereContact sphere_contact = narrowphase_result.sphere;
 
         addSinglePointContact(ctx, sphere_contact.pt, sphere_contact.normal,
-                              sphere_contact.depth, b_loc, a_loc);
+                              sphere_contact.depth, b_loc, a_loc, cache_idx);
     } break;
     case ContactType::SATPlane: {
         // Plane is always b, always reference
@@ -1556,14 +2485,16 @@ MADRONA_ALWAYS_INLINE static inline void generateContacts(
             hull_txfm,
 #endif
             { 0, 0, 0, },
-            { 1, 0, 0, 0 });
+            { 1, 0, 0, 0 },
+            max_sep);
 
         // Sadly there are cases where two objects are just barely
         // touching and post contact clipping all the clipped contacts
         // are just barely separated due to FP32. For now just don't
         // make a Contact in this situation.
         if (manifold.numContactPoints > 0) {
-            addManifoldContacts(ctx, manifold, ref_loc, other_loc);
+            addManifoldContacts(ctx, manifold, ref_loc, other_loc,
+                                cache_idx);
         }
     } break;
     case ContactType::SATFace: {
@@ -1638,14 +2569,16 @@ MADRONA_ALWAYS_INLINE static inline void generateContacts(
             other_txfm,
 #endif
             { 0, 0, 0, },
-            { 1, 0, 0, 0 });
+            { 1, 0, 0, 0 },
+            max_sep);
 
         // Sadly there are cases where two objects are just barely
         // touching and post contact clipping all the clipped contacts
         // are just barely separated due to FP32. For now just don't
         // make a Contact in this situation.
         if (manifold.numContactPoints > 0) {
-            addManifoldContacts(ctx, manifold, ref_loc, other_loc);
+            addManifoldContacts(ctx, manifold, ref_loc, other_loc,
+                                cache_idx);
         }
     } break;
     case ContactType::SATEdge: {
@@ -1669,12 +2602,89 @@ MADRONA_ALWAYS_INLINE static inline void generateContacts(
 #endif
             { 0, 0, 0 }, { 1, 0, 0, 0 });
 
-        addManifoldContacts(ctx, manifold, ref_loc, other_loc);
+        addManifoldContacts(ctx, manifold, ref_loc, other_loc,
+                            cache_idx);
+    } break;
+    case ContactType::Primitive: {
+        const prims::Contact &contact = narrowphase_result.primitive;
+
+        Manifold manifold = buildFaceContactManifold(
+            contact.normal,
+            (Vector3 *)contact.points,
+            (float *)contact.depths,
+            contact.numPoints,
+            { 0, 0, 0 }, { 1, 0, 0, 0 });
+
+        addManifoldContacts(ctx, manifold, b_loc, a_loc, cache_idx);
     } break;
     default: MADRONA_UNREACHABLE();
     }
 }
 
+// Keyed on the post-swap ordering so the cached SAT features always refer
+// to the same hull. Returns -1 (no cache) for pairs the key can't represent.
+static inline int32_t lookupContactCache(
+    Context &ctx,
+    Loc a_loc, Loc b_loc,
+    uint32_t a_prim_offset, uint32_t b_prim_offset)
+{
+    auto a_leaf = ctx.getDirect<broadphase::LeafID>(RGDCols::LeafID, a_loc);
+    auto b_leaf = ctx.getDirect<broadphase::LeafID>(RGDCols::LeafID, b_loc);
+
+    if (!ContactCache::keyFits(a_leaf, b_leaf,
+                               a_prim_offset, b_prim_offset)) {
+        return -1;
+    }
+
+    return ctx.singleton<ContactCache>().findOrInsert(ContactCache::makeKey(
+        a_leaf, b_leaf, a_prim_offset, b_prim_offset));
+}
+
+// Touching dynamic bodies share an island. A sleeping body is only woken by
+// something that can push it: an awake dynamic body or a moving kinematic
+// one. Resting on static or still kinematic geometry lets it keep sleeping.
+static inline void linkContactIslands(Context &ctx, Loc a_loc, Loc b_loc)
+{
+    IslandState &islands = ctx.singleton<IslandState>();
+
+    ResponseType a_type = ctx.getDirect<ResponseType>(
+        RGDCols::ResponseType, a_loc);
+    ResponseType b_type = ctx.getDirect<ResponseType>(
+        RGDCols::ResponseType, b_loc);
+
+    auto a_leaf = ctx.getDirect<broadphase::LeafID>(RGDCols::LeafID, a_loc);
+    auto b_leaf = ctx.getDirect<broadphase::LeafID>(RGDCols::LeafID, b_loc);
+
+    auto canWake = [&](ResponseType type, Loc loc, broadphase::LeafID leaf) {
+        switch (type) {
+        case ResponseType::Dynamic: {
+            return !islands.isAsleep(leaf);
+        }
+        case ResponseType::Kinematic: {
+            const Velocity &vel =
+                ctx.getDirect<Velocity>(RGDCols::Velocity, loc);
+            return vel.linear.length2() > 0.f || vel.angular.length2() > 0.f;
+        }
+        default: return false;
+        }
+    };
+
+    bool a_dynamic = a_type == ResponseType::Dynamic;
+    bool b_dynamic = b_type == ResponseType::Dynamic;
+
+    if (a_dynamic && canWake(b_type, b_loc, b_leaf)) {
+        islands.wake(a_leaf);
+    }
+
+    if (b_dynamic && canWake(a_type, a_loc, a_leaf)) {
+        islands.wake(b_leaf);
+    }
+
+    if (a_dynamic && b_dynamic) {
+        islands.link(a_leaf, b_leaf);
+    }
+}
+
 static inline void runNarrowphase(
     Context &ctx,
     const CandidateCollision &candidate_collision
@@ -1716,6 +2726,9 @@ static inline void runNarrowphase(
     Vector3 tmp_vertices_buffer[max_num_tmp_vertices];
 #endif
 
+    // Only filled in by the hull vs box test
+    prims::UnitBoxHull unit_box_hull;
+
     PROF_END(setup_ctr);
 
     PROF_START(prep_ctr, narrowphasePrepClocks);
@@ -1725,18 +2738,20 @@ static inline void runNarrowphase(
 
     const ObjectManager &obj_mgr = *ctx.singleton<ObjectData>().mgr;
 
+    uint32_t a_prim_offset = candidate_collision.aPrim;
+    uint32_t b_prim_offset = candidate_collision.bPrim;
     uint32_t a_prim_idx, b_prim_idx;
     {
         ObjectID a_obj = ctx.getDirect<ObjectID>(RGDCols::ObjectID, a_loc);
         ObjectID b_obj = ctx.getDirect<ObjectID>(RGDCols::ObjectID, b_loc);
     
-        const uint32_t a_prim_offset =
+        const uint32_t a_prim_base =
             obj_mgr.rigidBodyPrimitiveOffsets[a_obj.idx];
-        const uint32_t b_prim_offset  =
+        const uint32_t b_prim_base  =
             obj_mgr.rigidBodyPrimitiveOffsets[b_obj.idx];
     
-        a_prim_idx = a_prim_offset + candidate_collision.aPrim;
-        b_prim_idx = b_prim_offset + candidate_collision.bPrim;
+        a_prim_idx = a_prim_base + a_prim_offset;
+        b_prim_idx = b_prim_base + b_prim_offset;
     }
 
     const CollisionPrimitive *a_prim =
@@ -1752,6 +2767,7 @@ static inline void runNarrowphase(
         std::swap(a_loc, b_loc);
         std::swap(a_prim, b_prim);
         std::swap(a_prim_idx, b_prim_idx);
+        std::swap(a_prim_offset, b_prim_offset);
         std::swap(raw_type_a, raw_type_b);
     }
 
@@ -1762,6 +2778,10 @@ static inline void runNarrowphase(
     const Diag3x3 a_scale(ctx.getDirect<Scale>(RGDCols::Scale, a_loc));
     const Diag3x3 b_scale(ctx.getDirect<Scale>(RGDCols::Scale, b_loc));
 
+    // Pairs that could close the gap between them before the next
+    // narrowphase pass get speculative contacts, which the solver only acts
+    // on if the gap actually closes
+    float max_sep;
     {
         AABB a_obj_aabb = obj_mgr.primitiveAABBs[a_prim_idx];
         AABB b_obj_aabb = obj_mgr.primitiveAABBs[b_prim_idx];
@@ -1769,7 +2789,26 @@ static inline void runNarrowphase(
         AABB a_world_aabb = a_obj_aabb.applyTRS(a_pos, a_rot, a_scale);
         AABB b_world_aabb = b_obj_aabb.applyTRS(b_pos, b_rot, b_scale);
 
-        if (!a_world_aabb.intersects(b_world_aabb)) {
+        const Velocity &a_vel =
+            ctx.getDirect<Velocity>(RGDCols::Velocity, a_loc);
+        const Velocity &b_vel =
+            ctx.getDirect<Velocity>(RGDCols::Velocity, b_loc);
+
+        // Bound on how fast any point of either primitive can move
+        // towards the other
+        float a_radius =
+            0.5f * (a_world_aabb.pMax - a_world_aabb.pMin).length();
+        float b_radius =
+            0.5f * (b_world_aabb.pMax - b_world_aabb.pMin).length();
+        float closing_speed = (a_vel.linear - b_vel.linear).length() +
+            a_vel.angular.length() * a_radius +
+            b_vel.angular.length() * b_radius;
+
+        max_sep = fminf(closing_speed *
+            ctx.singleton<PhysicsSystemState>().contactDeltaT,
+            consts::maxSpeculativeDistance);
+
+        if (a_world_aabb.distance2(b_world_aabb) > max_sep * max_sep) {
 #ifdef MADRONA_GPU_MODE
             lane_active = false;
 #else
@@ -1786,6 +2825,14 @@ static inline void runNarrowphase(
     }
 #endif
 
+#ifdef MADRONA_GPU_MODE
+    const int32_t cache_idx = lane_active ? lookupContactCache(
+        ctx, a_loc, b_loc, a_prim_offset, b_prim_offset) : -1;
+#else
+    const int32_t cache_idx = lookupContactCache(
+        ctx, a_loc, b_loc, a_prim_offset, b_prim_offset);
+#endif
+
     const NarrowphaseTest test_type {raw_type_a | raw_type_b};
 
     PROF_END(prep_ctr);
@@ -1793,6 +2840,11 @@ static inline void runNarrowphase(
 #ifdef MADRONA_GPU_MODE
     NarrowphaseResult thread_result;
 
+    // Lanes can belong to different worlds, so the leader's entry is
+    // shuffled as a pointer into its own world's cache
+    ContactCache::Entry *lane_cache_entry = cache_idx == -1 ? nullptr :
+        &ctx.singleton<ContactCache>().entries[cache_idx];
+
 #if 0
     active_mask = __brev(active_mask);
     int32_t leader_idx = __clz(active_mask);
@@ -1860,7 +2912,11 @@ static inline void runNarrowphase(
             warp_a_scale, warp_b_scale,
             warp_a_prim, warp_b_prim,
             max_num_tmp_vertices, max_num_tmp_faces,
-            smem_vertices_buffer, smem_faces_buffer);
+            smem_vertices_buffer, smem_faces_buffer,
+            &unit_box_hull,
+            (ContactCache::Entry *)__shfl_sync(mwGPU::allActive,
+                (uint64_t)lane_cache_entry, leader_idx),
+            __shfl_sync(mwGPU::allActive, max_sep, leader_idx));
 
         if (mwgpu_lane_id == leader_idx) {
             thread_result = warp_result;
@@ -1881,9 +2937,14 @@ static inline void runNarrowphase(
                          a_loc, b_loc,
                          a_pos, a_rot, a_scale,
                          b_pos, b_rot, b_scale,
+                         cache_idx,
                          tmp_faces_buffer,
-                         tmp_faces_buffer + max_num_tmp_faces / 2);
-        
+                         tmp_faces_buffer + max_num_tmp_faces / 2,
+                         max_sep);
+
+        if (thread_result.type != ContactType::None) {
+            linkContactIslands(ctx, a_loc, b_loc);
+        }
     }
 #else
     NarrowphaseResult result = narrowphaseDispatch(
@@ -1893,12 +2954,22 @@ static inline void runNarrowphase(
         a_scale, b_scale,
         a_prim, b_prim,
         max_num_tmp_vertices, max_num_tmp_faces,
-        tmp_vertices_buffer, tmp_faces_buffer);
+        tmp_vertices_buffer, tmp_faces_buffer,
+        &unit_box_hull,
+        cache_idx == -1 ? nullptr :
+            &ctx.singleton<ContactCache>().entries[cache_idx],
+        max_sep);
 
     generateContacts(ctx, result,
                      a_loc, b_loc,
+                     cache_idx,
                      tmp_faces_buffer,
-                     tmp_faces_buffer + max_num_tmp_faces / 2);
+                     tmp_faces_buffer + max_num_tmp_faces / 2,
+                     max_sep);
+
+    if (result.type != ContactType::None) {
+        linkContactIslands(ctx, a_loc, b_loc);
+    }
 #endif
 }
 
@@ -1940,6 +3011,30 @@ inline void runNarrowphaseSystem(
 #endif
 }
 
+inline void advanceContactCache(Context &,
+                                ContactCache &contact_cache)
+{
+    contact_cache.advanceStep();
+}
+
+// Runs in parallel across worlds. Within a world, backward shift deletion
+// depends on the order of the probe chains, so each table is aged out by a
+// single thread walking its live entries.
+TaskGraphNodeID setupContactCacheTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps)
+{
+    return builder.addToGraph<ParallelForNode<Context,
+        advanceContactCache, ContactCache>>(deps);
+}
+
+#ifndef MADRONA_GPU_MODE
+void runCandidate(Context &ctx, const CandidateCollision &candidate)
+{
+    runNarrowphaseSystem(ctx, candidate);
+}
+#endif
+
 TaskGraphNodeID setupTasks(
     TaskGraphBuilder &builder,
     Span<const TaskGraphNodeID> deps)
@@ -4,6 +4,7 @@
 #include "physics_impl.hpp"
 #include "xpbd.hpp"
 #include "tgs.hpp"
+#include "primitive_contacts.hpp"
 
 namespace madrona::phys {
 
@@ -74,6 +75,7 @@ static void initPhysicsState(Context &ctx,
                              float delta_t,
                              CountT num_substeps,
                              Vector3 gravity,
+                             PhysicsSystem::Solver solver,
                              uint32_t contact_archetype_id,
                              uint32_t joint_archetype_id)
 {
@@ -83,6 +85,8 @@ static void initPhysicsState(Context &ctx,
     ctx.singleton<PhysicsSystemState>() = {
         .deltaT = delta_t,
         .h = h,
+        .contactDeltaT =
+            solver == PhysicsSystem::Solver::TGS ? delta_t : h,
         .g = gravity,
         .gMagnitude = g_mag,
         .restitutionThreshold = 2.f * g_mag * h,
@@ -99,7 +103,9 @@ void init(Context &ctx,
           CountT num_substeps,
           math::Vector3 gravity,
           CountT max_dynamic_objects,
-          Solver solver)
+          Solver solver,
+          const broadphase::Config &broadphase_config,
+          bool enable_sleeping)
 {
     broadphase::BVH &bvh = ctx.singleton<broadphase::BVH>();
 
@@ -108,11 +114,18 @@ void init(Context &ctx,
     constexpr float max_inst_accel = 100.f;
     new (&bvh) broadphase::BVH(
         obj_mgr, max_dynamic_objects, 2.f * delta_t,
-        max_inst_accel * delta_t * delta_t);
+        max_inst_accel * delta_t * delta_t, broadphase_config);
+
+    new (&ctx.singleton<ContactCache>()) ContactCache(max_dynamic_objects);
+    new (&ctx.singleton<IslandState>()) IslandState(
+        max_dynamic_objects, enable_sleeping);
+    new (&ctx.singleton<CCDState>()) CCDState(max_dynamic_objects);
 
     uint32_t contact_archetype_id, joint_archetype_id;
     switch (solver) {
-    case Solver::XPBD: {
+    case Solver::XPBD:
+    case Solver::XPBDBatched:
+    case Solver::XPBDFused: {
         xpbd::getSolverArchetypeIDs(&contact_archetype_id,
                                     &joint_archetype_id);
     } break;
@@ -124,11 +137,13 @@ void init(Context &ctx,
     }
 
     initPhysicsState(
-        ctx, delta_t, num_substeps, gravity,
+        ctx, delta_t, num_substeps, gravity, solver,
         contact_archetype_id, joint_archetype_id);
 
     switch (solver) {
-    case Solver::XPBD: {
+    case Solver::XPBD:
+    case Solver::XPBDBatched:
+    case Solver::XPBDFused: {
         xpbd::init(ctx);
     } break;
     case Solver::TGS: {
@@ -145,6 +160,10 @@ void reset(Context &ctx)
     broadphase::BVH &bvh = ctx.singleton<broadphase::BVH>();
     bvh.rebuildOnUpdate();
     bvh.clearLeaves();
+
+    ctx.singleton<ContactCache>().clear();
+    ctx.singleton<IslandState>().clear();
+    ctx.singleton<CCDState>().clear();
 }
 
 broadphase::LeafID registerEntity(Context &ctx,
@@ -156,6 +175,71 @@ broadphase::LeafID registerEntity(Context &ctx,
     return bvh.reserveLeaf(e, obj_id);
 }
 
+void setContinuousCollision(Context &ctx, Entity e, bool enabled)
+{
+    auto leaf_id = ctx.get<broadphase::LeafID>(e);
+
+    ctx.singleton<CCDState>().bodies[leaf_id.id].enabled = enabled ? 1 : 0;
+}
+
+// SAT on the world axes and the box's axes. The 9 edge axes are skipped,
+// like the hull test below, which only checks the world axes.
+static bool boxOverlapsAABB(const CollisionPrimitive::Box &box,
+                            Vector3 pos, Quat rot, Diag3x3 scale,
+                            AABB aabb)
+{
+    Mat3x3 box_axes = Mat3x3::fromQuat(rot);
+    Vector3 box_h = scale * box.halfExtents;
+
+    Vector3 aabb_center = 0.5f * (aabb.pMin + aabb.pMax);
+    Vector3 aabb_h = 0.5f * (aabb.pMax - aabb.pMin);
+    Vector3 to_box = pos - aabb_center;
+
+#pragma unroll
+    for (CountT i = 0; i < 3; i++) {
+        float box_radius = box_h.x * fabsf(box_axes[0][i]) +
+            box_h.y * fabsf(box_axes[1][i]) +
+            box_h.z * fabsf(box_axes[2][i]);
+
+        if (fabsf(to_box[i]) >= box_radius + aabb_h[i]) {
+            return false;
+        }
+    }
+
+#pragma unroll
+    for (CountT i = 0; i < 3; i++) {
+        Vector3 axis = box_axes[i];
+        float aabb_radius = aabb_h.x * fabsf(axis.x) +
+            aabb_h.y * fabsf(axis.y) + aabb_h.z * fabsf(axis.z);
+
+        if (fabsf(dot(to_box, axis)) >= box_h[i] + aabb_radius) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool capsuleOverlapsAABB(const CollisionPrimitive::Capsule &capsule,
+                                Vector3 pos, Quat rot, Diag3x3 scale,
+                                AABB aabb)
+{
+    float r = scale.d0 * capsule.radius;
+    Vector3 half_segment = rot.rotateVec(
+        { 0, 0, 0.5f * scale.d2 * capsule.cylinderHeight });
+
+    Vector3 aabb_center = 0.5f * (aabb.pMin + aabb.pMax);
+    Vector3 aabb_h = 0.5f * (aabb.pMax - aabb.pMin);
+    Vector3 to_capsule = pos - aabb_center;
+
+    Vector3 seg_pt, box_pt;
+    float dist2 = prims::segmentBoxClosestPoints(
+        to_capsule - half_segment, to_capsule + half_segment, aabb_h,
+        &seg_pt, &box_pt);
+
+    return dist2 < r * r;
+}
+
 bool checkEntityAABBOverlap(
     Context &ctx, math::AABB aabb, Entity e)
 {
@@ -174,7 +258,9 @@ bool checkEntityAABBOverlap(
         uint32_t prim_idx = base_prim_offset + prim_offset;
 
         const CollisionPrimitive &prim = obj_mgr.collisionPrimitives[prim_idx];
-        if (prim.type != CollisionPrimitive::Type::Hull) {
+        if (prim.type != CollisionPrimitive::Type::Hull &&
+                prim.type != CollisionPrimitive::Type::Box &&
+                prim.type != CollisionPrimitive::Type::Capsule) {
             continue;
         }
 
@@ -184,7 +270,24 @@ bool checkEntityAABBOverlap(
         if (!txfmed_aabb.overlaps(aabb)) {
             continue;
         }
-        
+
+        if (prim.type == CollisionPrimitive::Type::Box) {
+            if (boxOverlapsAABB(prim.box, e_pos, e_rot, e_scale, aabb)) {
+                overlap = true;
+                break;
+            }
+            continue;
+        }
+
+        if (prim.type == CollisionPrimitive::Type::Capsule) {
+            if (capsuleOverlapsAABB(prim.capsule,
+                                    e_pos, e_rot, e_scale, aabb)) {
+                overlap = true;
+                break;
+            }
+            continue;
+        }
+
         const Vector3 *vertices = prim.hull.halfEdgeMesh.vertices;
         CountT num_verts = (CountT)prim.hull.halfEdgeMesh.numVertices;
 
@@ -273,6 +376,8 @@ Entity makeFixedJoint(
         },
         .r1 = r1,
         .r2 = r2,
+        .linearImpulse = math::Vector3::zero(),
+        .angularImpulse = math::Vector3::zero(),
     };
 
     return e;
@@ -300,6 +405,8 @@ Entity makeHingeJoint(
         },
         .r1 = r1,
         .r2 = r2,
+        .linearImpulse = math::Vector3::zero(),
+        .angularImpulse = math::Vector3::zero(),
     };
 
     return e;
@@ -327,9 +434,14 @@ void registerTypes(ECSRegistry &registry,
 
     registry.registerSingleton<PhysicsSystemState>();
     registry.registerSingleton<ObjectData>();
+    registry.registerSingleton<ContactCache>();
+    registry.registerSingleton<IslandState>();
+    registry.registerSingleton<CCDState>();
 
     switch (solver) {
-    case Solver::XPBD: {
+    case Solver::XPBD:
+    case Solver::XPBDBatched:
+    case Solver::XPBDFused: {
         xpbd::registerTypes(registry);
     } break;
     case Solver::TGS: {
@@ -354,24 +466,39 @@ TaskGraphNodeID setupPhysicsStepTasks(
     CountT num_substeps,
     Solver solver)
 {
+    auto wake_bodies = islands::setupWakeTasks(builder, deps);
+
     auto broadphase_prep =
-        broadphase::setupPreIntegrationTasks(builder, deps);
+        broadphase::setupPreIntegrationTasks(builder, {wake_bodies});
+
+    auto contact_cache_update =
+        narrowphase::setupContactCacheTasks(builder, {broadphase_prep});
+
+    auto ccd_prep = ccd::setupPreSolveTasks(builder, {contact_cache_update});
 
     TaskGraphNodeID solver_finished;
     switch (solver) {
-    case Solver::XPBD: {
+    case Solver::XPBD:
+    case Solver::XPBDBatched:
+    case Solver::XPBDFused: {
         solver_finished = xpbd::setupXPBDSolverTasks(
-            builder, broadphase_prep, num_substeps);
+            builder, ccd_prep, num_substeps,
+            solver != Solver::XPBD,
+            solver == Solver::XPBDFused);
     } break;
     case Solver::TGS: {
         solver_finished = tgs::setupTGSSolverTasks(
-            builder, broadphase_prep, num_substeps);
+            builder, ccd_prep, num_substeps);
     } break;
     default: MADRONA_UNREACHABLE();
     }
 
+    auto clamp_motion = ccd::setupTasks(builder, {solver_finished});
+
+    auto update_islands = islands::setupTasks(builder, {clamp_motion});
+
     auto broadphase_post =
-        broadphase::setupPostIntegrationTasks(builder, {solver_finished});
+        broadphase::setupPostIntegrationTasks(builder, {update_islands});
 
     auto physics_done = broadphase_post;
 
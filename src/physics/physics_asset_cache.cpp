@@ -0,0 +1,708 @@
+#include <madrona/physics_assets.hpp>
+#include <madrona/utils.hpp>
+
+#if defined(__linux__) or defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace madrona::phys {
+using namespace geo;
+using namespace math;
+
+namespace {
+
+enum class CookedAssetType : uint32_t {
+    RigidBodyAssets = 1,
+    MeshBVH = 2,
+};
+
+// Cache files are the header, padded to a cache line, followed directly by
+// the cooked blob. The asset struct in the header has every pointer
+// replaced with its byte offset from the start of the blob.
+struct CookedAssetHeader {
+    static constexpr inline uint32_t magic = 0x4348'434d; // "MCHC"
+
+    uint32_t fileMagic;
+    uint32_t version;
+    CookedAssetType type;
+    uint32_t layoutHash;
+    uint64_t sourceHash;
+    uint64_t numBlobBytes;
+
+    union {
+        RigidBodyAssets rigidBodyAssets;
+        MeshBVH meshBVH;
+    };
+};
+
+constexpr uint64_t cookedBlobOffset =
+    utils::roundUp(sizeof(CookedAssetHeader), (size_t)MADRONA_CACHE_LINE);
+
+// Catches struct layout changes that weren't accompanied by a
+// formatVersion bump
+constexpr uint32_t computeLayoutHash()
+{
+    uint32_t hash = 2166136261u;
+    for (uint64_t size : {
+            sizeof(HalfEdge),
+            sizeof(Plane),
+            sizeof(Vector3),
+            sizeof(CollisionPrimitive),
+            sizeof(AABB),
+            sizeof(RigidBodyMetadata),
+            sizeof(RigidBodyAssets),
+            sizeof(MeshBVH::Node),
+            sizeof(MeshBVH::LeafGeometry),
+            sizeof(MeshBVH::LeafMaterial),
+            sizeof(MeshBVH),
+         }) {
+        hash = (hash ^ uint32_t(size)) * 16777619u;
+    }
+
+    return hash;
+}
+
+// Not cryptographic, just needs to make accidental collisions between
+// different source assets vanishingly unlikely
+struct SourceHasher {
+    uint64_t state = 0x9E37'79B9'7F4A'7C15_u64;
+
+    static inline uint64_t mix(uint64_t v)
+    {
+        // MurmurHash3 64 bit finalizer
+        v ^= v >> 33;
+        v *= 0xFF51'AFD7'ED55'8CCD_u64;
+        v ^= v >> 33;
+        v *= 0xC4CE'B9FE'1A85'EC53_u64;
+        v ^= v >> 33;
+        return v;
+    }
+
+    inline void addWord(uint64_t v)
+    {
+        state = mix(state ^ mix(v)) + 0x9E37'79B9'7F4A'7C15_u64;
+    }
+
+    inline void addBytes(const void *data, uint64_t num_bytes)
+    {
+        addWord(num_bytes);
+
+        const char *bytes = (const char *)data;
+        uint64_t offset = 0;
+        for (; offset + 8 <= num_bytes; offset += 8) {
+            uint64_t word;
+            memcpy(&word, bytes + offset, 8);
+            addWord(word);
+        }
+
+        if (offset < num_bytes) {
+            uint64_t word = 0;
+            memcpy(&word, bytes + offset, num_bytes - offset);
+            addWord(word);
+        }
+    }
+
+    template <typename T>
+    inline void add(T v)
+    {
+        static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>);
+        addBytes(&v, sizeof(T));
+    }
+
+    inline void addMesh(const imp::SourceMesh &mesh, bool with_materials)
+    {
+        add(mesh.numVertices);
+        add(mesh.numFaces);
+        addBytes(mesh.positions, sizeof(Vector3) * mesh.numVertices);
+
+        uint64_t num_indices;
+        if (mesh.faceCounts == nullptr) {
+            add(0_u32);
+            num_indices = 3 * (uint64_t)mesh.numFaces;
+        } else {
+            add(1_u32);
+            addBytes(mesh.faceCounts, sizeof(uint32_t) * mesh.numFaces);
+
+            num_indices = 0;
+            for (uint32_t i = 0; i < mesh.numFaces; i++) {
+                num_indices += mesh.faceCounts[i];
+            }
+        }
+        addBytes(mesh.indices, sizeof(uint32_t) * num_indices);
+
+        if (with_materials) {
+            if (mesh.faceMaterials == nullptr) {
+                add(0_u32);
+            } else {
+                add(1_u32);
+                addBytes(mesh.faceMaterials,
+                         sizeof(uint32_t) * mesh.numFaces);
+            }
+        }
+    }
+};
+
+template <typename T>
+T * toOffset(T *ptr, const void *base)
+{
+    return (T *)(uintptr_t)((const char *)ptr - (const char *)base);
+}
+
+template <typename T>
+T * fromOffset(T *offset, void *base)
+{
+    return (T *)((char *)base + (uintptr_t)offset);
+}
+
+template <typename T>
+bool offsetInBounds(T *offset, uint64_t num_elems, uint64_t num_blob_bytes)
+{
+    uint64_t start = (uint64_t)(uintptr_t)offset;
+    return start <= num_blob_bytes &&
+        num_elems <= (num_blob_bytes - start) / sizeof(T);
+}
+
+bool writeCookedFile(const char *path,
+                     const CookedAssetHeader &hdr,
+                     const void *blob)
+{
+    // Write to a temporary file and rename, so concurrently starting
+    // processes never map a partially written cache file
+#if defined(_WIN32)
+    uint64_t pid = GetCurrentProcessId();
+#else
+    uint64_t pid = getpid();
+#endif
+    std::string tmp_path = std::string(path) + ".tmp" + std::to_string(pid);
+
+    FILE *file = fopen(tmp_path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    constexpr uint64_t num_padding_bytes =
+        cookedBlobOffset - sizeof(CookedAssetHeader);
+    char padding[num_padding_bytes + 1] {};
+
+    bool success =
+        fwrite(&hdr, sizeof(CookedAssetHeader), 1, file) == 1 &&
+        fwrite(padding, 1, num_padding_bytes, file) == num_padding_bytes &&
+        fwrite(blob, 1, hdr.numBlobBytes, file) == hdr.numBlobBytes;
+
+    success = fclose(file) == 0 && success;
+
+    if (success) {
+#if defined(_WIN32)
+        success = MoveFileExA(tmp_path.c_str(), path,
+                              MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        success = rename(tmp_path.c_str(), path) == 0;
+#endif
+    }
+
+    if (!success) {
+        remove(tmp_path.c_str());
+    }
+
+    return success;
+}
+
+// Maps the file copy-on-write: pointer fixups only dirty the pages they
+// touch, the rest stays backed by the page cache.
+void * mapCookedFile(const char *path, uint64_t *out_num_bytes)
+{
+#if defined(__linux__) or defined(__APPLE__)
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return nullptr;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 ||
+            (uint64_t)file_stat.st_size < cookedBlobOffset) {
+        close(fd);
+        return nullptr;
+    }
+
+    uint64_t num_bytes = (uint64_t)file_stat.st_size;
+    void *base = mmap(nullptr, num_bytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED) {
+        return nullptr;
+    }
+
+    *out_num_bytes = num_bytes;
+    return base;
+#elif defined(_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) ||
+            (uint64_t)file_size.QuadPart < cookedBlobOffset) {
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY,
+                                        0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        return nullptr;
+    }
+
+    void *base = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);
+
+    if (base == nullptr) {
+        return nullptr;
+    }
+
+    *out_num_bytes = (uint64_t)file_size.QuadPart;
+    return base;
+#else
+    STATIC_UNIMPLEMENTED();
+#endif
+}
+
+void unmapCookedFile(void *base, uint64_t num_bytes)
+{
+#if defined(__linux__) or defined(__APPLE__)
+    munmap(base, num_bytes);
+#elif defined(_WIN32)
+    (void)num_bytes;
+    UnmapViewOfFile(base);
+#else
+    STATIC_UNIMPLEMENTED();
+#endif
+}
+
+// Returns the header if the file is a cache entry of the right type,
+// format and source hash
+CookedAssetHeader * validateCookedFile(void *base,
+                                       uint64_t num_bytes,
+                                       CookedAssetType type,
+                                       uint64_t source_hash)
+{
+    auto hdr = (CookedAssetHeader *)base;
+
+    if (hdr->fileMagic != CookedAssetHeader::magic ||
+            hdr->version != CookedAssetCache::formatVersion ||
+            hdr->layoutHash != computeLayoutHash() ||
+            hdr->type != type ||
+            hdr->sourceHash != source_hash ||
+            hdr->numBlobBytes != num_bytes - cookedBlobOffset) {
+        return nullptr;
+    }
+
+    return hdr;
+}
+
+}
+
+CookedAssetMapping::CookedAssetMapping()
+    : base_(nullptr),
+      numBytes_(0)
+{}
+
+CookedAssetMapping::CookedAssetMapping(void *base, uint64_t num_bytes)
+    : base_(base),
+      numBytes_(num_bytes)
+{}
+
+CookedAssetMapping::CookedAssetMapping(CookedAssetMapping &&o)
+    : base_(o.base_),
+      numBytes_(o.numBytes_)
+{
+    o.base_ = nullptr;
+    o.numBytes_ = 0;
+}
+
+CookedAssetMapping::~CookedAssetMapping()
+{
+    if (base_ != nullptr) {
+        unmapCookedFile(base_, numBytes_);
+    }
+}
+
+CookedAssetMapping & CookedAssetMapping::operator=(CookedAssetMapping &&o)
+{
+    if (base_ != nullptr) {
+        unmapCookedFile(base_, numBytes_);
+    }
+
+    base_ = o.base_;
+    numBytes_ = o.numBytes_;
+    o.base_ = nullptr;
+    o.numBytes_ = 0;
+
+    return *this;
+}
+
+uint64_t CookedAssetCache::hashRigidBodySources(
+    Span<const imp::SourceMesh> convex_hull_meshes,
+    Span<const SourceCollisionObject> collision_objs,
+    bool build_convex_hulls,
+    const HullSimplificationConfig *simplify_cfg)
+{
+    SourceHasher hasher;
+    hasher.add(CookedAssetType::RigidBodyAssets);
+    hasher.add(build_convex_hulls);
+
+    if (simplify_cfg == nullptr) {
+        hasher.add(0_u32);
+    } else {
+        hasher.add(1_u32);
+        hasher.add(simplify_cfg->maxFaces);
+        hasher.add(simplify_cfg->maxVertices);
+    }
+
+    hasher.add(convex_hull_meshes.size());
+    for (const imp::SourceMesh &mesh : convex_hull_meshes) {
+        hasher.addMesh(mesh, false);
+    }
+
+    hasher.add(collision_objs.size());
+    for (const SourceCollisionObject &obj : collision_objs) {
+        hasher.add(obj.invMass);
+        hasher.add(obj.friction.muS);
+        hasher.add(obj.friction.muD);
+
+        hasher.add(obj.prims.size());
+        for (const SourceCollisionPrimitive &prim : obj.prims) {
+            hasher.add(prim.type);
+
+            switch (prim.type) {
+            case CollisionPrimitive::Type::Sphere: {
+                hasher.add(prim.sphere.radius);
+            } break;
+            case CollisionPrimitive::Type::Hull: {
+                hasher.add(prim.hullInput.hullIDX);
+            } break;
+            case CollisionPrimitive::Type::Capsule: {
+                hasher.add(prim.capsule.radius);
+                hasher.add(prim.capsule.cylinderHeight);
+            } break;
+            case CollisionPrimitive::Type::Box: {
+                hasher.add(prim.box.halfExtents.x);
+                hasher.add(prim.box.halfExtents.y);
+                hasher.add(prim.box.halfExtents.z);
+            } break;
+            case CollisionPrimitive::Type::Heightfield: {
+                const auto &hf = prim.heightfieldInput;
+                hasher.add(hf.numRows);
+                hasher.add(hf.numCols);
+                hasher.add(hf.cellSize);
+                hasher.add(hf.minHeight);
+                hasher.add(hf.heightScale);
+                hasher.addBytes(hf.samples, sizeof(uint16_t) *
+                    (uint64_t)hf.numRows * (uint64_t)hf.numCols);
+            } break;
+            case CollisionPrimitive::Type::TriangleMesh: {
+                hasher.addMesh(*prim.triangleMeshInput.mesh, true);
+            } break;
+            case CollisionPrimitive::Type::Plane: break;
+            }
+        }
+    }
+
+    return hasher.state;
+}
+
+uint64_t CookedAssetCache::hashMeshBVHSources(
+    Span<const imp::SourceMesh> src_meshes)
+{
+    SourceHasher hasher;
+    hasher.add(CookedAssetType::MeshBVH);
+
+    hasher.add(src_meshes.size());
+    for (const imp::SourceMesh &mesh : src_meshes) {
+        hasher.addMesh(mesh, true);
+    }
+
+    return hasher.state;
+}
+
+bool CookedAssetCache::saveRigidBodyAssets(
+    const char *path,
+    uint64_t source_hash,
+    const RigidBodyAssets &assets,
+    const void *blob,
+    CountT num_blob_bytes)
+{
+    CookedAssetHeader hdr;
+    memset(&hdr, 0, sizeof(CookedAssetHeader));
+    hdr.fileMagic = CookedAssetHeader::magic;
+    hdr.version = formatVersion;
+    hdr.type = CookedAssetType::RigidBodyAssets;
+    hdr.layoutHash = computeLayoutHash();
+    hdr.sourceHash = source_hash;
+    hdr.numBlobBytes = (uint64_t)num_blob_bytes;
+
+    RigidBodyAssets &hdr_assets = hdr.rigidBodyAssets;
+    hdr_assets = assets;
+
+    hdr_assets.hullData.halfEdges =
+        toOffset(assets.hullData.halfEdges, blob);
+    hdr_assets.hullData.faceBaseHalfEdges =
+        toOffset(assets.hullData.faceBaseHalfEdges, blob);
+    hdr_assets.hullData.facePlanes =
+        toOffset(assets.hullData.facePlanes, blob);
+    hdr_assets.hullData.vertices =
+        toOffset(assets.hullData.vertices, blob);
+    hdr_assets.heightfieldSamples =
+        toOffset(assets.heightfieldSamples, blob);
+    hdr_assets.meshBVHData = toOffset(assets.meshBVHData, blob);
+    hdr_assets.primitives = toOffset(assets.primitives, blob);
+    hdr_assets.primitiveAABBs = toOffset(assets.primitiveAABBs, blob);
+    hdr_assets.metadatas = toOffset(assets.metadatas, blob);
+    hdr_assets.objAABBs = toOffset(assets.objAABBs, blob);
+    hdr_assets.primOffsets = toOffset(assets.primOffsets, blob);
+    hdr_assets.primCounts = toOffset(assets.primCounts, blob);
+
+    // The hull, heightfield and triangle mesh primitives inside the blob
+    // also point into it. Write out a copy of the blob with those converted to offsets.
+    char *blob_copy = (char *)malloc(num_blob_bytes);
+    memcpy(blob_copy, blob, num_blob_bytes);
+
+    CollisionPrimitive *prims =
+        fromOffset(hdr_assets.primitives, blob_copy);
+    for (CountT i = 0; i < (CountT)assets.totalNumPrimitives; i++) {
+        if (prims[i].type == CollisionPrimitive::Type::Heightfield) {
+            prims[i].heightfield.samples =
+                toOffset(prims[i].heightfield.samples, blob);
+            continue;
+        }
+
+        if (prims[i].type == CollisionPrimitive::Type::TriangleMesh) {
+            MeshBVH &bvh = prims[i].triangleMesh.bvh;
+            bvh.nodes = toOffset(bvh.nodes, blob);
+            bvh.leafGeos = toOffset(bvh.leafGeos, blob);
+            bvh.leafMats = toOffset(bvh.leafMats, blob);
+            bvh.vertices = toOffset(bvh.vertices, blob);
+            continue;
+        }
+
+        if (prims[i].type != CollisionPrimitive::Type::Hull) {
+            continue;
+        }
+
+        HalfEdgeMesh &mesh = prims[i].hull.halfEdgeMesh;
+        mesh.halfEdges = toOffset(mesh.halfEdges, blob);
+        mesh.faceBaseHalfEdges = toOffset(mesh.faceBaseHalfEdges, blob);
+        mesh.facePlanes = toOffset(mesh.facePlanes, blob);
+        mesh.vertices = toOffset(mesh.vertices, blob);
+    }
+
+    bool success = writeCookedFile(path, hdr, blob_copy);
+    free(blob_copy);
+
+    return success;
+}
+
+bool CookedAssetCache::saveMeshBVH(
+    const char *path,
+    uint64_t source_hash,
+    const MeshBVH &bvh,
+    const void *blob,
+    CountT num_blob_bytes)
+{
+    CookedAssetHeader hdr;
+    memset(&hdr, 0, sizeof(CookedAssetHeader));
+    hdr.fileMagic = CookedAssetHeader::magic;
+    hdr.version = formatVersion;
+    hdr.type = CookedAssetType::MeshBVH;
+    hdr.layoutHash = computeLayoutHash();
+    hdr.sourceHash = source_hash;
+    hdr.numBlobBytes = (uint64_t)num_blob_bytes;
+
+    MeshBVH &hdr_bvh = hdr.meshBVH;
+    hdr_bvh = bvh;
+    hdr_bvh.nodes = toOffset(bvh.nodes, blob);
+    hdr_bvh.leafGeos = toOffset(bvh.leafGeos, blob);
+    hdr_bvh.leafMats = toOffset(bvh.leafMats, blob);
+    hdr_bvh.vertices = toOffset(bvh.vertices, blob);
+
+    return writeCookedFile(path, hdr, blob);
+}
+
+CookedAssetMapping CookedAssetCache::loadRigidBodyAssets(
+    const char *path,
+    uint64_t source_hash,
+    RigidBodyAssets *out_assets)
+{
+    uint64_t num_bytes;
+    void *base = mapCookedFile(path, &num_bytes);
+    if (base == nullptr) {
+        return CookedAssetMapping();
+    }
+
+    CookedAssetMapping mapping(base, num_bytes);
+
+    CookedAssetHeader *hdr = validateCookedFile(
+        base, num_bytes, CookedAssetType::RigidBodyAssets, source_hash);
+    if (hdr == nullptr) {
+        return CookedAssetMapping();
+    }
+
+    char *blob = (char *)base + cookedBlobOffset;
+    const uint64_t num_blob_bytes = hdr->numBlobBytes;
+
+    RigidBodyAssets assets = hdr->rigidBodyAssets;
+    RigidBodyAssets::HullData &hull_data = assets.hullData;
+
+    // Guard against truncated or corrupted files before following any
+    // offsets
+    if (!offsetInBounds(hull_data.halfEdges, hull_data.numHalfEdges,
+                        num_blob_bytes) ||
+        !offsetInBounds(hull_data.faceBaseHalfEdges, hull_data.numFaces,
+                        num_blob_bytes) ||
+        !offsetInBounds(hull_data.facePlanes, hull_data.numFaces,
+                        num_blob_bytes) ||
+        !offsetInBounds(hull_data.vertices, hull_data.numVerts,
+                        num_blob_bytes) ||
+        !offsetInBounds(assets.heightfieldSamples,
+                        assets.numHeightfieldSamples, num_blob_bytes) ||
+        !offsetInBounds(assets.meshBVHData, assets.numMeshBVHBytes,
+                        num_blob_bytes) ||
+        !offsetInBounds(assets.primitives, assets.totalNumPrimitives,
+                        num_blob_bytes) ||
+        !offsetInBounds(assets.primitiveAABBs, assets.totalNumPrimitives,
+                        num_blob_bytes) ||
+        !offsetInBounds(assets.metadatas, assets.numObjs, num_blob_bytes) ||
+        !offsetInBounds(assets.objAABBs, assets.numObjs, num_blob_bytes) ||
+        !offsetInBounds(assets.primOffsets, assets.numObjs,
+                        num_blob_bytes) ||
+        !offsetInBounds(assets.primCounts, assets.numObjs,
+                        num_blob_bytes)) {
+        return CookedAssetMapping();
+    }
+
+    hull_data.halfEdges = fromOffset(hull_data.halfEdges, blob);
+    hull_data.faceBaseHalfEdges =
+        fromOffset(hull_data.faceBaseHalfEdges, blob);
+    hull_data.facePlanes = fromOffset(hull_data.facePlanes, blob);
+    hull_data.vertices = fromOffset(hull_data.vertices, blob);
+    assets.heightfieldSamples = fromOffset(assets.heightfieldSamples, blob);
+    assets.meshBVHData = fromOffset(assets.meshBVHData, blob);
+    assets.primitives = fromOffset(assets.primitives, blob);
+    assets.primitiveAABBs = fromOffset(assets.primitiveAABBs, blob);
+    assets.metadatas = fromOffset(assets.metadatas, blob);
+    assets.objAABBs = fromOffset(assets.objAABBs, blob);
+    assets.primOffsets = fromOffset(assets.primOffsets, blob);
+    assets.primCounts = fromOffset(assets.primCounts, blob);
+
+    for (CountT i = 0; i < (CountT)assets.totalNumPrimitives; i++) {
+        CollisionPrimitive &prim = assets.primitives[i];
+        if (prim.type == CollisionPrimitive::Type::Heightfield) {
+            auto &hf = prim.heightfield;
+            if (!offsetInBounds(hf.samples,
+                    (uint64_t)hf.numRows * (uint64_t)hf.numCols,
+                    num_blob_bytes)) {
+                return CookedAssetMapping();
+            }
+
+            hf.samples = fromOffset(hf.samples, blob);
+            continue;
+        }
+
+        if (prim.type == CollisionPrimitive::Type::TriangleMesh) {
+            MeshBVH &bvh = prim.triangleMesh.bvh;
+            if (!offsetInBounds(bvh.nodes, bvh.numNodes, num_blob_bytes) ||
+                !offsetInBounds(bvh.leafGeos, bvh.numLeaves,
+                                num_blob_bytes) ||
+                !offsetInBounds(bvh.leafMats, bvh.numLeaves,
+                                num_blob_bytes) ||
+                !offsetInBounds(bvh.vertices, bvh.numVerts,
+                                num_blob_bytes)) {
+                return CookedAssetMapping();
+            }
+
+            bvh.nodes = fromOffset(bvh.nodes, blob);
+            bvh.leafGeos = fromOffset(bvh.leafGeos, blob);
+            bvh.leafMats = fromOffset(bvh.leafMats, blob);
+            bvh.vertices = fromOffset(bvh.vertices, blob);
+            continue;
+        }
+
+        if (prim.type != CollisionPrimitive::Type::Hull) {
+            continue;
+        }
+
+        HalfEdgeMesh &mesh = prim.hull.halfEdgeMesh;
+        if (!offsetInBounds(mesh.halfEdges, mesh.numHalfEdges,
+                            num_blob_bytes) ||
+            !offsetInBounds(mesh.faceBaseHalfEdges, mesh.numFaces,
+                            num_blob_bytes) ||
+            !offsetInBounds(mesh.facePlanes, mesh.numFaces,
+                            num_blob_bytes) ||
+            !offsetInBounds(mesh.vertices, mesh.numVertices,
+                            num_blob_bytes)) {
+            return CookedAssetMapping();
+        }
+
+        mesh.halfEdges = fromOffset(mesh.halfEdges, blob);
+        mesh.faceBaseHalfEdges = fromOffset(mesh.faceBaseHalfEdges, blob);
+        mesh.facePlanes = fromOffset(mesh.facePlanes, blob);
+        mesh.vertices = fromOffset(mesh.vertices, blob);
+    }
+
+    *out_assets = assets;
+    return mapping;
+}
+
+CookedAssetMapping CookedAssetCache::loadMeshBVH(
+    const char *path,
+    uint64_t source_hash,
+    MeshBVH *out_bvh)
+{
+    uint64_t num_bytes;
+    void *base = mapCookedFile(path, &num_bytes);
+    if (base == nullptr) {
+        return CookedAssetMapping();
+    }
+
+    CookedAssetMapping mapping(base, num_bytes);
+
+    CookedAssetHeader *hdr = validateCookedFile(
+        base, num_bytes, CookedAssetType::MeshBVH, source_hash);
+    if (hdr == nullptr) {
+        return CookedAssetMapping();
+    }
+
+    char *blob = (char *)base + cookedBlobOffset;
+    const uint64_t num_blob_bytes = hdr->numBlobBytes;
+
+    MeshBVH bvh = hdr->meshBVH;
+
+    if (!offsetInBounds(bvh.nodes, bvh.numNodes, num_blob_bytes) ||
+        !offsetInBounds(bvh.leafGeos, bvh.numLeaves, num_blob_bytes) ||
+        !offsetInBounds(bvh.leafMats, bvh.numLeaves, num_blob_bytes) ||
+        !offsetInBounds(bvh.vertices, bvh.numVerts, num_blob_bytes)) {
+        return CookedAssetMapping();
+    }
+
+    bvh.nodes = fromOffset(bvh.nodes, blob);
+    bvh.leafGeos = fromOffset(bvh.leafGeos, blob);
+    bvh.leafMats = fromOffset(bvh.leafMats, blob);
+    bvh.vertices = fromOffset(bvh.vertices, blob);
+
+    *out_bvh = bvh;
+    return mapping;
+}
+
+}
@@ -1,10 +1,16 @@
 #include <madrona/physics_assets.hpp>
 #include <madrona/importer.hpp>
+#include <madrona/heap_array.hpp>
+#include <madrona/sync.hpp>
 
 #ifdef MADRONA_CUDA_SUPPORT
 #include <madrona/cuda_utils.hpp>
 #endif
 
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <thread>
 #include <unordered_map>
 
 namespace madrona::phys {
@@ -746,10 +752,352 @@ static inline HalfEdgeMesh buildHalfEdgeMesh(
     };
 }
 
+namespace {
+
+struct HullSimplificationStats {
+    float error;
+    uint32_t numFacesBefore;
+    uint32_t numVertsBefore;
+    uint32_t numEdgesBefore;
+    uint32_t numFacesAfter;
+    uint32_t numVertsAfter;
+    uint32_t numEdgesAfter;
+};
+
+}
+
+// Vertices of the intersection of the half spaces below planes, merged
+// within epsilon. Returns -1 if the result doesn't fit in max_verts.
+static CountT intersectHalfSpaces(const Plane *planes,
+                                  CountT num_planes,
+                                  float epsilon,
+                                  Vector3 *out_verts,
+                                  CountT max_verts)
+{
+    CountT num_verts = 0;
+
+    for (CountT i = 0; i < num_planes; i++) {
+        for (CountT j = i + 1; j < num_planes; j++) {
+            Vector3 ij = cross(planes[i].normal, planes[j].normal);
+
+            for (CountT k = j + 1; k < num_planes; k++) {
+                float det = dot(ij, planes[k].normal);
+                if (fabsf(det) < 1e-6f) {
+                    continue;
+                }
+
+                Vector3 jk = cross(planes[j].normal, planes[k].normal);
+                Vector3 ki = cross(planes[k].normal, planes[i].normal);
+
+                Vector3 v = (planes[i].d * jk + planes[j].d * ki +
+                             planes[k].d * ij) / det;
+
+                bool inside = true;
+                for (CountT l = 0; l < num_planes; l++) {
+                    if (distToPlane(planes[l], v) > epsilon) {
+                        inside = false;
+                        break;
+                    }
+                }
+
+                if (!inside) {
+                    continue;
+                }
+
+                bool duplicate = false;
+                for (CountT l = 0; l < num_verts; l++) {
+                    if (out_verts[l].distance2(v) <= epsilon * epsilon) {
+                        duplicate = true;
+                        break;
+                    }
+                }
+
+                if (duplicate) {
+                    continue;
+                }
+
+                if (num_verts == max_verts) {
+                    return -1;
+                }
+
+                out_verts[num_verts++] = v;
+            }
+        }
+    }
+
+    return num_verts;
+}
+
+// Builds the polygon for each plane out of the vertices lying on it,
+// wound counter clockwise around the plane normal. Planes that don't touch
+// the polytope are dropped. Returns false if the result isn't a closed
+// polytope.
+static bool buildHalfSpaceMesh(const Plane *planes,
+                               CountT num_planes,
+                               const Vector3 *verts,
+                               CountT num_verts,
+                               float epsilon,
+                               StackAlloc &tmp_alloc,
+                               imp::SourceMesh *out_mesh)
+{
+    uint32_t *vert_remap = tmp_alloc.allocN<uint32_t>(num_verts);
+    for (CountT i = 0; i < num_verts; i++) {
+        vert_remap[i] = 0xFFFF'FFFF;
+    }
+
+    // Each vertex is on at least 3 faces, but bound by the worst case to be
+    // safe with near degenerate input
+    uint32_t *indices = tmp_alloc.allocN<uint32_t>(num_planes * num_verts);
+    uint32_t *face_counts = tmp_alloc.allocN<uint32_t>(num_planes);
+    Vector3 *positions = tmp_alloc.allocN<Vector3>(num_verts);
+
+    std::pair<float, uint32_t> *sorted_face_verts =
+        tmp_alloc.allocN<std::pair<float, uint32_t>>(num_verts);
+
+    CountT num_faces = 0;
+    CountT num_indices = 0;
+    CountT num_used_verts = 0;
+
+    for (CountT plane_idx = 0; plane_idx < num_planes; plane_idx++) {
+        Plane plane = planes[plane_idx];
+
+        Vector3 centroid = Vector3::zero();
+        CountT num_face_verts = 0;
+        for (CountT i = 0; i < num_verts; i++) {
+            if (fabsf(distToPlane(plane, verts[i])) <= epsilon) {
+                sorted_face_verts[num_face_verts++] = { 0.f, (uint32_t)i };
+                centroid += verts[i];
+            }
+        }
+
+        if (num_face_verts < 3) {
+            continue;
+        }
+
+        centroid /= (float)num_face_verts;
+
+        Vector3 u, v;
+        plane.normal.frame(&u, &v);
+
+        for (CountT i = 0; i < num_face_verts; i++) {
+            Vector3 to_vert = verts[sorted_face_verts[i].second] - centroid;
+            sorted_face_verts[i].first =
+                atan2f(dot(to_vert, v), dot(to_vert, u));
+        }
+
+        std::sort(sorted_face_verts, sorted_face_verts + num_face_verts);
+
+        for (CountT i = 0; i < num_face_verts; i++) {
+            uint32_t vert_idx = sorted_face_verts[i].second;
+            if (vert_remap[vert_idx] == 0xFFFF'FFFF) {
+                vert_remap[vert_idx] = (uint32_t)num_used_verts;
+                positions[num_used_verts++] = verts[vert_idx];
+            }
+
+            indices[num_indices++] = vert_remap[vert_idx];
+        }
+
+        face_counts[num_faces++] = (uint32_t)num_face_verts;
+    }
+
+    // Euler characteristic of a closed polytope, every edge is shared by 2
+    // faces
+    if (num_indices % 2 != 0 ||
+            num_used_verts - num_indices / 2 + num_faces != 2) {
+        return false;
+    }
+
+    *out_mesh = imp::SourceMesh {
+        .positions = positions,
+        .normals = nullptr,
+        .tangentAndSigns = nullptr,
+        .uvs = nullptr,
+        .indices = indices,
+        .faceCounts = face_counts,
+        .faceMaterials = nullptr,
+        .numVertices = (uint32_t)num_used_verts,
+        .numFaces = (uint32_t)num_faces,
+        .materialIDX = 0,
+    };
+
+    return true;
+}
+
+// Exact distance from p to the closest point on the hull, 0 if inside
+static float hullPointDistance(const HalfEdgeMesh &hull, Vector3 p)
+{
+    float min_dist = FLT_MAX;
+    bool outside = false;
+
+    for (uint32_t face_idx = 0; face_idx < hull.numFaces; face_idx++) {
+        Plane plane = hull.facePlanes[face_idx];
+        float plane_dist = distToPlane(plane, p);
+
+        // The closest point is on a face that can see p
+        if (plane_dist <= 0.f) {
+            continue;
+        }
+        outside = true;
+
+        Vector3 proj = p - plane_dist * plane.normal;
+
+        bool in_face = true;
+        float edge_dist2 = FLT_MAX;
+        uint32_t hedge_idx = hull.faceBaseHalfEdges[face_idx];
+        uint32_t start_hedge_idx = hedge_idx;
+        do {
+            const HalfEdge &hedge = hull.halfEdges[hedge_idx];
+            Vector3 a = hull.vertices[hedge.rootVertex];
+            Vector3 b = hull.vertices[
+                hull.halfEdges[hedge.next].rootVertex];
+
+            Vector3 ab = b - a;
+            if (dot(cross(ab, proj - a), plane.normal) < 0.f) {
+                in_face = false;
+            }
+
+            float t = dot(p - a, ab) / fmaxf(ab.length2(), FLT_MIN);
+            t = fminf(fmaxf(t, 0.f), 1.f);
+            edge_dist2 = fminf(edge_dist2, p.distance2(a + t * ab));
+
+            hedge_idx = hedge.next;
+        } while (hedge_idx != start_hedge_idx);
+
+        min_dist = fminf(min_dist,
+            in_face ? plane_dist : sqrtf(edge_dist2));
+    }
+
+    return outside ? min_dist : 0.f;
+}
+
+// Approximates the hull with at most max_faces of its supporting planes by
+// greedily cutting a bounding box with the plane the current approximation
+// violates most, until the face or vertex budget runs out. The result
+// always contains the original hull, so simplification can only add
+// contacts at a distance up to the reported error, never miss them.
+static bool simplifyHull(const HalfEdgeMesh &hull,
+                         const HullSimplificationConfig &cfg,
+                         StackAlloc &tmp_alloc,
+                         HalfEdgeMesh *out_mesh,
+                         HullSimplificationStats *out_stats)
+{
+    *out_stats = HullSimplificationStats {
+        .error = 0.f,
+        .numFacesBefore = hull.numFaces,
+        .numVertsBefore = hull.numVertices,
+        .numEdgesBefore = hull.numEdges(),
+        .numFacesAfter = hull.numFaces,
+        .numVertsAfter = hull.numVertices,
+        .numEdgesAfter = hull.numEdges(),
+    };
+
+    if (hull.numFaces <= cfg.maxFaces &&
+            hull.numVertices <= cfg.maxVertices) {
+        return false;
+    }
+
+    // The starting box needs 6 faces and 8 vertices
+    const CountT max_faces = std::max(cfg.maxFaces, 6_u32);
+    const CountT max_verts = std::max(cfg.maxVertices, 8_u32);
+
+    float epsilon =
+        computePlaneEpsilon(Span(hull.vertices, hull.numVertices));
+    // Plane intersections are far less accurate than the hull vertices
+    // they came from
+    epsilon *= 64.f;
+
+    AABB aabb = AABB::point(hull.vertices[0]);
+    for (uint32_t i = 1; i < hull.numVertices; i++) {
+        aabb.expand(hull.vertices[i]);
+    }
+
+    Plane *planes = tmp_alloc.allocN<Plane>(max_faces);
+    planes[0] = { {  1,  0,  0 },  aabb.pMax.x };
+    planes[1] = { { -1,  0,  0 }, -aabb.pMin.x };
+    planes[2] = { {  0,  1,  0 },  aabb.pMax.y };
+    planes[3] = { {  0, -1,  0 }, -aabb.pMin.y };
+    planes[4] = { {  0,  0,  1 },  aabb.pMax.z };
+    planes[5] = { {  0,  0, -1 }, -aabb.pMin.z };
+    CountT num_planes = 6;
+
+    // Room for the worst case from numerically duplicated vertices that
+    // escape merging
+    const CountT max_scratch_verts = 4 * max_faces;
+    Vector3 *verts = tmp_alloc.allocN<Vector3>(max_scratch_verts);
+    Vector3 *candidate_verts = tmp_alloc.allocN<Vector3>(max_scratch_verts);
+
+    CountT num_verts = intersectHalfSpaces(planes, num_planes, epsilon,
+                                           verts, max_scratch_verts);
+    if (num_verts == -1) {
+        return false;
+    }
+
+    while (num_planes < max_faces) {
+        float max_violation = epsilon;
+        CountT violated_face = -1;
+        for (CountT i = 0; i < num_verts; i++) {
+            for (uint32_t face_idx = 0; face_idx < hull.numFaces;
+                 face_idx++) {
+                float violation =
+                    distToPlane(hull.facePlanes[face_idx], verts[i]);
+
+                if (violation > max_violation) {
+                    max_violation = violation;
+                    violated_face = face_idx;
+                }
+            }
+        }
+
+        // Every vertex is on the original hull (within tolerance)
+        if (violated_face == -1) {
+            break;
+        }
+
+        planes[num_planes] = hull.facePlanes[violated_face];
+
+        CountT num_candidate_verts = intersectHalfSpaces(
+            planes, num_planes + 1, epsilon,
+            candidate_verts, max_scratch_verts);
+
+        if (num_candidate_verts == -1 || num_candidate_verts > max_verts) {
+            break;
+        }
+
+        num_planes += 1;
+        std::swap(verts, candidate_verts);
+        num_verts = num_candidate_verts;
+    }
+
+    imp::SourceMesh simplified_src;
+    bool valid = buildHalfSpaceMesh(planes, num_planes, verts, num_verts,
+                                    epsilon, tmp_alloc, &simplified_src);
+    if (!valid) {
+        return false;
+    }
+
+    HalfEdgeMesh simplified = buildHalfEdgeMesh(tmp_alloc, simplified_src);
+
+    float error = 0.f;
+    for (uint32_t i = 0; i < simplified.numVertices; i++) {
+        error = fmaxf(error, hullPointDistance(hull, simplified.vertices[i]));
+    }
+
+    *out_mesh = simplified;
+
+    out_stats->error = error;
+    out_stats->numFacesAfter = simplified.numFaces;
+    out_stats->numVertsAfter = simplified.numVertices;
+    out_stats->numEdgesAfter = simplified.numEdges();
+
+    return true;
+}
+
 static bool processConvexHull(const imp::SourceMesh &src_mesh,
                               bool build_hull,
+                              const HullSimplificationConfig *simplify_cfg,
                               StackAlloc &tmp_alloc,
-                              HalfEdgeMesh *out_mesh)
+                              HalfEdgeMesh *out_mesh,
+                              HullSimplificationStats *out_stats)
 {
     if (!build_hull) {
         // Just assume the input geometry is a convex hull with coplanar faces
@@ -770,19 +1118,28 @@ static bool processConvexHull(const imp::SourceMesh &src_mesh,
         *out_mesh = editMeshToRuntimeMesh(tmp_alloc, hull_data.mesh);
     }
 
+    if (simplify_cfg != nullptr) {
+        HalfEdgeMesh built_mesh = *out_mesh;
+        simplifyHull(built_mesh, *simplify_cfg, tmp_alloc,
+                     out_mesh, out_stats);
+    }
+
     return true;
 }
 
 static bool processConvexHulls(
     Span<const imp::SourceMesh> in_meshes,
     bool build_convex_hulls,
+    const HullSimplificationConfig *simplify_cfg,
     StackAlloc &tmp_alloc,
-    HalfEdgeMesh *out_meshes)
+    HalfEdgeMesh *out_meshes,
+    HullSimplificationStats *out_stats)
 {
     for (CountT hull_idx = 0; hull_idx < in_meshes.size(); hull_idx++) {
         const imp::SourceMesh &mesh = in_meshes[hull_idx];
         bool success = processConvexHull(
-            mesh, build_convex_hulls, tmp_alloc, &out_meshes[hull_idx]);
+            mesh, build_convex_hulls, simplify_cfg, tmp_alloc,
+            &out_meshes[hull_idx], &out_stats[hull_idx]);
 
         if (!success) {
             return false;
@@ -1013,15 +1370,55 @@ static inline MassProperties computeMassProperties(
                 .off = Vector3::zero(),
             };
             continue;
-        } else if (prim.type == CollisionPrimitive::Type::Plane) {
-            // Plane has infinite mass / inertia. The rest of the
-            // object must as well
+        } else if (prim.type == CollisionPrimitive::Type::Plane ||
+                   prim.type == CollisionPrimitive::Type::Heightfield ||
+                   prim.type == CollisionPrimitive::Type::TriangleMesh) {
+            // Static only primitives have infinite mass / inertia. The
+            // rest of the object must as well
 
             return MassProperties {
                 Diag3x3::uniform(INFINITY),
                 Vector3::zero(),
                 Quat { 1, 0, 0, 0 },
             };
+        } else if (prim.type == CollisionPrimitive::Type::Box) {
+            // Box and capsule are centered on the origin, so they only move
+            // the COM through their mass
+            Vector3 h = prim.box.halfExtents;
+            float m = 8.f * h.x * h.y * h.z * density;
+
+            float old_m_total = m_total;
+            m_total += m;
+            x_total = x_total * old_m_total / m_total;
+
+            C_total += Symmetric3x3 {
+                .diag = m / 3.f * Vector3 { h.x * h.x, h.y * h.y, h.z * h.z },
+                .off = Vector3::zero(),
+            };
+            continue;
+        } else if (prim.type == CollisionPrimitive::Type::Capsule) {
+            float r = prim.capsule.radius;
+            float h = prim.capsule.cylinderHeight;
+
+            float m_cylinder = math::pi * r * r * h * density;
+            float m_caps = 4.f / 3.f * math::pi * r * r * r * density;
+            float m = m_cylinder + m_caps;
+
+            float old_m_total = m_total;
+            m_total += m;
+            x_total = x_total * old_m_total / m_total;
+
+            // The hemispherical caps are offset by h / 2 along Z, with
+            // their own centroids a further 3r / 8 out
+            float radial = m_cylinder * r * r / 4.f + m_caps * r * r / 5.f;
+            float axial = m_cylinder * h * h / 12.f +
+                m_caps * (h * h / 4.f + 3.f * r * h / 8.f + r * r / 5.f);
+
+            C_total += Symmetric3x3 {
+                .diag = Vector3 { radial, radial, axial },
+                .off = Vector3::zero(),
+            };
+            continue;
         }
 
         // Hull primitive
@@ -1150,22 +1547,18 @@ static inline RigidBodyMassData toMassData(const MassProperties &mass_props,
     };
 }
 
-static void computeRigidBodiesMetadata(
+static void computeRigidBodyMetadata(
     const HalfEdgeMesh *convex_hulls,
-    Span<const SourceCollisionObject> collision_objs,
-    RigidBodyMetadata *out_metadatas)
+    const SourceCollisionObject &collision_obj,
+    RigidBodyMetadata *out_metadata)
 {
-    for (CountT obj_idx = 0; obj_idx < collision_objs.size(); obj_idx++) {
-        const SourceCollisionObject &collision_obj = collision_objs[obj_idx];
-
-        MassProperties mass_props = computeMassProperties(
-            convex_hulls, collision_obj);
+    MassProperties mass_props = computeMassProperties(
+        convex_hulls, collision_obj);
 
-        out_metadatas[obj_idx] = RigidBodyMetadata {
-            .mass = toMassData(mass_props, collision_obj.invMass),
-            .friction = collision_obj.friction,
-        };
-    }
+    *out_metadata = RigidBodyMetadata {
+        .mass = toMassData(mass_props, collision_obj.invMass),
+        .friction = collision_obj.friction,
+    };
 }
 
 static void setupSpherePrimitive(const SourceCollisionPrimitive &src_prim,
@@ -1194,6 +1587,96 @@ static void setupPlanePrimitive(const SourceCollisionPrimitive &,
     };
 }
 
+static void setupCapsulePrimitive(const SourceCollisionPrimitive &src_prim,
+                                  CollisionPrimitive *out_prim,
+                                  AABB *out_aabb)
+{
+    out_prim->capsule = src_prim.capsule;
+
+    const float r = src_prim.capsule.radius;
+    const float half_z = 0.5f * src_prim.capsule.cylinderHeight + r;
+
+    *out_aabb = AABB {
+        .pMin = { -r, -r, -half_z },
+        .pMax = { r, r, half_z },
+    };
+}
+
+static void setupBoxPrimitive(const SourceCollisionPrimitive &src_prim,
+                              CollisionPrimitive *out_prim,
+                              AABB *out_aabb)
+{
+    out_prim->box = src_prim.box;
+
+    const Vector3 h = src_prim.box.halfExtents;
+
+    *out_aabb = AABB {
+        .pMin = -h,
+        .pMax = h,
+    };
+}
+
+// Copies the samples to *samples_out, which is advanced past them
+static void setupHeightfieldPrimitive(const SourceCollisionPrimitive &src_prim,
+                                      uint16_t **samples_out,
+                                      CollisionPrimitive *out_prim,
+                                      AABB *out_aabb)
+{
+    const auto &src = src_prim.heightfieldInput;
+    assert(src.numRows >= 2 && src.numCols >= 2);
+
+    const CountT num_samples = (CountT)src.numRows * (CountT)src.numCols;
+
+    uint16_t *samples = *samples_out;
+    memcpy(samples, src.samples, sizeof(uint16_t) * num_samples);
+    *samples_out += num_samples;
+
+    uint16_t min_sample = 0xFFFF;
+    uint16_t max_sample = 0;
+    for (CountT i = 0; i < num_samples; i++) {
+        min_sample = std::min(min_sample, samples[i]);
+        max_sample = std::max(max_sample, samples[i]);
+    }
+
+    out_prim->heightfield = CollisionPrimitive::Heightfield {
+        .samples = samples,
+        .numRows = src.numRows,
+        .numCols = src.numCols,
+        .cellSize = src.cellSize,
+        .minHeight = src.minHeight,
+        .heightScale = src.heightScale,
+    };
+
+    const float half_x = 0.5f * float(src.numCols - 1) * src.cellSize;
+    const float half_y = 0.5f * float(src.numRows - 1) * src.cellSize;
+
+    *out_aabb = AABB {
+        .pMin = {
+            -half_x,
+            -half_y,
+            src.minHeight + src.heightScale * float(min_sample),
+        },
+        .pMax = {
+            half_x,
+            half_y,
+            src.minHeight + src.heightScale * float(max_sample),
+        },
+    };
+}
+
+// *bvh points into the packed assets, and is advanced to the next mesh
+static void setupTriangleMeshPrimitive(const MeshBVH **bvh,
+                                       CollisionPrimitive *out_prim,
+                                       AABB *out_aabb)
+{
+    out_prim->triangleMesh = CollisionPrimitive::TriangleMesh {
+        .bvh = **bvh,
+    };
+
+    *out_aabb = (*bvh)->rootAABB;
+    *bvh += 1;
+}
+
 static void setupHullPrimitive(const SourceCollisionPrimitive &src_prim,
                                const HalfEdgeMesh *hull_meshes,
                                CollisionPrimitive *out_prim,
@@ -1214,6 +1697,8 @@ static void setupHullPrimitive(const SourceCollisionPrimitive &src_prim,
 static void setupRigidBodyAABBsAndPrimitives(
     HalfEdgeMesh *hull_meshes,
     Span<const SourceCollisionObject> collision_objs,
+    uint16_t *heightfield_samples,
+    const MeshBVH *mesh_bvhs,
     CollisionPrimitive *out_prims,
     AABB *out_prim_aabbs,
     AABB *out_obj_aabbs,
@@ -1247,6 +1732,19 @@ static void setupRigidBodyAABBsAndPrimitives(
             case Type::Plane: {
                 setupPlanePrimitive(src_prim, out_prim, &prim_aabb);
             } break;
+            case Type::Capsule: {
+                setupCapsulePrimitive(src_prim, out_prim, &prim_aabb);
+            } break;
+            case Type::Box: {
+                setupBoxPrimitive(src_prim, out_prim, &prim_aabb);
+            } break;
+            case Type::Heightfield: {
+                setupHeightfieldPrimitive(src_prim, &heightfield_samples,
+                                          out_prim, &prim_aabb);
+            } break;
+            case Type::TriangleMesh: {
+                setupTriangleMeshPrimitive(&mesh_bvhs, out_prim, &prim_aabb);
+            } break;
             case Type::Hull: {
                 setupHullPrimitive(src_prim, hull_meshes,
                     out_prim, &prim_aabb);
@@ -1265,37 +1763,176 @@ static void setupRigidBodyAABBsAndPrimitives(
     }
 }
 
-void * RigidBodyAssets::processRigidBodyAssets(
+// SAT cost of a hull against a copy of itself: face queries test every
+// vertex of the other hull, the edge query tests every pair of edges
+static inline float estimateSATCost(uint32_t num_faces,
+                                    uint32_t num_verts,
+                                    uint32_t num_edges)
+{
+    return 2.f * (float)num_faces * (float)num_verts +
+        (float)num_edges * (float)num_edges;
+}
+
+static void computeSimplificationReports(
+    Span<const SourceCollisionObject> collision_objs,
+    const HullSimplificationStats *hull_stats,
+    HullSimplificationReport *out_reports)
+{
+    for (CountT obj_idx = 0; obj_idx < collision_objs.size(); obj_idx++) {
+        const SourceCollisionObject &collision_obj = collision_objs[obj_idx];
+
+        HullSimplificationReport report {
+            .maxError = 0.f,
+            .estimatedSATSpeedup = 1.f,
+            .numFacesBefore = 0,
+            .numFacesAfter = 0,
+            .numVertsBefore = 0,
+            .numVertsAfter = 0,
+        };
+
+        float cost_before = 0.f;
+        float cost_after = 0.f;
+        for (const SourceCollisionPrimitive &prim : collision_obj.prims) {
+            if (prim.type != CollisionPrimitive::Type::Hull) {
+                continue;
+            }
+
+            const HullSimplificationStats &stats =
+                hull_stats[prim.hullInput.hullIDX];
+
+            report.maxError = fmaxf(report.maxError, stats.error);
+            report.numFacesBefore += stats.numFacesBefore;
+            report.numFacesAfter += stats.numFacesAfter;
+            report.numVertsBefore += stats.numVertsBefore;
+            report.numVertsAfter += stats.numVertsAfter;
+
+            cost_before += estimateSATCost(stats.numFacesBefore,
+                stats.numVertsBefore, stats.numEdgesBefore);
+            cost_after += estimateSATCost(stats.numFacesAfter,
+                stats.numVertsAfter, stats.numEdgesAfter);
+        }
+
+        if (cost_after > 0.f) {
+            report.estimatedSATSpeedup = cost_before / cost_after;
+        }
+
+        out_reports[obj_idx] = report;
+    }
+}
+
+// Runs fn(worker_idx, item_idx) for every item in [0, num_items), with
+// items handed out dynamically to num_workers threads. The calling thread
+// is worker 0.
+template <typename Fn>
+static void parallelFor(CountT num_workers, CountT num_items, Fn &&fn)
+{
+    num_workers = std::min(num_workers, num_items);
+    if (num_workers <= 1) {
+        for (CountT i = 0; i < num_items; i++) {
+            fn(0, i);
+        }
+        return;
+    }
+
+    AtomicI64 next_item(0);
+
+    auto worker_loop = [&](CountT worker_idx) {
+        while (true) {
+            CountT item_idx = (CountT)next_item.fetch_add_relaxed(1);
+            if (item_idx >= num_items) {
+                break;
+            }
+
+            fn(worker_idx, item_idx);
+        }
+    };
+
+    HeapArray<std::thread> threads(num_workers - 1);
+    for (CountT i = 0; i < threads.size(); i++) {
+        threads.emplace(i, worker_loop, i + 1);
+    }
+
+    worker_loop(0);
+
+    for (CountT i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+}
+
+// Copies the built hulls into a single buffer and fills in the per
+// primitive and per object data. Buffer offsets are assigned in hull and
+// object order before any work is handed out, so the output is identical
+// for any num_workers.
+static void * packRigidBodyAssets(
     Span<const imp::SourceMesh> convex_hull_meshes,
     Span<const SourceCollisionObject> collision_objs,
-    bool build_convex_hulls,
+    HalfEdgeMesh *built_hulls,
+    CountT num_workers,
     StackAlloc &tmp_alloc,
     RigidBodyAssets *out_assets,
     CountT *out_num_bytes)
 {
-    auto tmp_frame = tmp_alloc.push();
-
-    HalfEdgeMesh *built_hulls =
-        tmp_alloc.allocN<HalfEdgeMesh>(convex_hull_meshes.size());
-
-    auto hull_build_frame = tmp_alloc.push();
+    struct HullOffsets {
+        CountT halfEdge;
+        CountT face;
+        CountT vert;
+    };
 
-    bool hull_success = processConvexHulls(convex_hull_meshes,
-                                           build_convex_hulls,
-                                           tmp_alloc,
-                                           built_hulls);
+    auto tmp_frame = tmp_alloc.push();
 
-    if (!hull_success) {
-        tmp_alloc.pop(hull_build_frame);
-        tmp_alloc.pop(tmp_frame);
-        return nullptr;
-    }
+    HullOffsets *hull_offsets =
+        tmp_alloc.allocN<HullOffsets>(convex_hull_meshes.size());
 
     CountT total_num_prims = 0;
+    CountT total_num_heightfield_samples = 0;
+    CountT total_num_triangle_meshes = 0;
     for (CountT obj_idx = 0; obj_idx < collision_objs.size(); obj_idx++) {
         const SourceCollisionObject &collision_obj = collision_objs[obj_idx];
         CountT cur_num_prims = collision_obj.prims.size();
         total_num_prims += cur_num_prims;
+
+        for (const SourceCollisionPrimitive &prim : collision_obj.prims) {
+            if (prim.type == CollisionPrimitive::Type::Heightfield) {
+                total_num_heightfield_samples +=
+                    (CountT)prim.heightfieldInput.numRows *
+                    (CountT)prim.heightfieldInput.numCols;
+            } else if (prim.type == CollisionPrimitive::Type::TriangleMesh) {
+                total_num_triangle_meshes += 1;
+            }
+        }
+    }
+
+    // Build the triangle mesh BVHs up front so their sizes are known. Each
+    // is copied into the packed buffer below, so their blobs are temporary.
+    MeshBVH *mesh_bvhs = tmp_alloc.allocN<MeshBVH>(total_num_triangle_meshes);
+    void **mesh_bvh_blobs =
+        tmp_alloc.allocN<void *>(total_num_triangle_meshes);
+    int64_t *mesh_bvh_offsets =
+        tmp_alloc.allocN<int64_t>(total_num_triangle_meshes);
+    CountT *mesh_bvh_sizes =
+        tmp_alloc.allocN<CountT>(total_num_triangle_meshes);
+
+    int64_t total_mesh_bvh_bytes = 0;
+    {
+        CountT mesh_idx = 0;
+        for (const SourceCollisionObject &collision_obj : collision_objs) {
+            for (const SourceCollisionPrimitive &prim : collision_obj.prims) {
+                if (prim.type != CollisionPrimitive::Type::TriangleMesh) {
+                    continue;
+                }
+
+                mesh_bvh_blobs[mesh_idx] = MeshBVHBuilder::build(
+                    Span<const imp::SourceMesh>(
+                        prim.triangleMeshInput.mesh, 1),
+                    tmp_alloc, &mesh_bvhs[mesh_idx],
+                    &mesh_bvh_sizes[mesh_idx]);
+
+                mesh_bvh_offsets[mesh_idx] = total_mesh_bvh_bytes;
+                total_mesh_bvh_bytes += (int64_t)utils::roundUpPow2(
+                    (uint64_t)mesh_bvh_sizes[mesh_idx], 64);
+                mesh_idx++;
+            }
+        }
     }
 
     CountT total_num_halfedges = 0;
@@ -1305,6 +1942,12 @@ void * RigidBodyAssets::processRigidBodyAssets(
          hull_idx++) {
         const HalfEdgeMesh &hull_mesh = built_hulls[hull_idx];
 
+        hull_offsets[hull_idx] = {
+            .halfEdge = total_num_halfedges,
+            .face = total_num_faces,
+            .vert = total_num_verts,
+        };
+
         total_num_halfedges += hull_mesh.numHalfEdges;
         total_num_faces += hull_mesh.numFaces;
         total_num_verts += hull_mesh.numVertices;
@@ -1325,6 +1968,9 @@ void * RigidBodyAssets::processRigidBodyAssets(
             collision_objs.size(), // prim_offsets
         (int64_t)sizeof(uint32_t) *
             collision_objs.size(), // prim_counts
+        (int64_t)sizeof(uint16_t) *
+            total_num_heightfield_samples, // heightfield samples
+        total_mesh_bvh_bytes, // mesh BVHs
     });
 
     int64_t buffer_offsets[buffer_sizes.size() - 1];
@@ -1342,6 +1988,10 @@ void * RigidBodyAssets::processRigidBodyAssets(
             .numFaces = (uint32_t)total_num_faces,
             .numVerts = (uint32_t)total_num_verts,
         },
+        .heightfieldSamples = (uint16_t *)(buffer + buffer_offsets[9]),
+        .numHeightfieldSamples = (uint32_t)total_num_heightfield_samples,
+        .meshBVHData = (uint8_t *)(buffer + buffer_offsets[10]),
+        .numMeshBVHBytes = (uint64_t)total_mesh_bvh_bytes,
         .primitives = (CollisionPrimitive *)(buffer + buffer_offsets[3]),
         .primitiveAABBs = (AABB *)(buffer + buffer_offsets[4]),
         .metadatas = (RigidBodyMetadata *)(buffer + buffer_offsets[5]),
@@ -1353,18 +2003,16 @@ void * RigidBodyAssets::processRigidBodyAssets(
         .numObjs = (uint32_t)collision_objs.size(),
     };
 
-    CountT cur_halfedge_offset = 0;
-    CountT cur_face_offset = 0;
-    CountT cur_vert_offset = 0;
-    for (CountT hull_idx = 0; hull_idx < convex_hull_meshes.size();
-         hull_idx++) {
+    parallelFor(num_workers, convex_hull_meshes.size(),
+                [&](CountT, CountT hull_idx) {
         HalfEdgeMesh &hull_mesh = built_hulls[hull_idx];
+        const HullOffsets &offsets = hull_offsets[hull_idx];
 
-        HalfEdge *he_out = &assets.hullData.halfEdges[cur_halfedge_offset];
+        HalfEdge *he_out = &assets.hullData.halfEdges[offsets.halfEdge];
         uint32_t *face_bases_out =
-            &assets.hullData.faceBaseHalfEdges[cur_face_offset];
-        Plane *face_planes_out = &assets.hullData.facePlanes[cur_face_offset];
-        Vector3 *verts_out = &assets.hullData.vertices[cur_vert_offset];
+            &assets.hullData.faceBaseHalfEdges[offsets.face];
+        Plane *face_planes_out = &assets.hullData.facePlanes[offsets.face];
+        Vector3 *verts_out = &assets.hullData.vertices[offsets.vert];
 
         memcpy(he_out, hull_mesh.halfEdges,
                sizeof(HalfEdge) * hull_mesh.numHalfEdges);
@@ -1379,24 +2027,43 @@ void * RigidBodyAssets::processRigidBodyAssets(
         hull_mesh.faceBaseHalfEdges = face_bases_out;
         hull_mesh.facePlanes = face_planes_out;
         hull_mesh.vertices = verts_out;
+    });
 
-        cur_halfedge_offset += hull_mesh.numHalfEdges;
-        cur_face_offset += hull_mesh.numFaces;
-        cur_vert_offset += hull_mesh.numVertices;
-    }
+    // Move the BVHs into the buffer, rebasing their pointers
+    for (CountT i = 0; i < total_num_triangle_meshes; i++) {
+        MeshBVH &bvh = mesh_bvhs[i];
+        char *src = (char *)mesh_bvh_blobs[i];
+        char *dst = (char *)assets.meshBVHData + mesh_bvh_offsets[i];
 
-    tmp_alloc.pop(hull_build_frame);
+        memcpy(dst, src, mesh_bvh_sizes[i]);
+
+        auto rebase = [&](auto *ptr) {
+            return (decltype(ptr))(dst + ((char *)ptr - src));
+        };
+
+        bvh.nodes = rebase(bvh.nodes);
+        bvh.leafGeos = rebase(bvh.leafGeos);
+        bvh.leafMats = rebase(bvh.leafMats);
+        bvh.vertices = rebase(bvh.vertices);
+
+        free(src);
+    }
 
     setupRigidBodyAABBsAndPrimitives(built_hulls,
                                      collision_objs,
+                                     assets.heightfieldSamples,
+                                     mesh_bvhs,
                                      assets.primitives,
                                      assets.primitiveAABBs,
                                      assets.objAABBs,
                                      assets.primOffsets,
                                      assets.primCounts);
 
-    computeRigidBodiesMetadata(
-        built_hulls, collision_objs, assets.metadatas);
+    parallelFor(num_workers, collision_objs.size(),
+                [&](CountT, CountT obj_idx) {
+        computeRigidBodyMetadata(built_hulls, collision_objs[obj_idx],
+                                 &assets.metadatas[obj_idx]);
+    });
 
     tmp_alloc.pop(tmp_frame);
 
@@ -1405,4 +2072,263 @@ void * RigidBodyAssets::processRigidBodyAssets(
     return buffer;
 }
 
+void * RigidBodyAssets::processRigidBodyAssets(
+    Span<const imp::SourceMesh> convex_hull_meshes,
+    Span<const SourceCollisionObject> collision_objs,
+    bool build_convex_hulls,
+    StackAlloc &tmp_alloc,
+    RigidBodyAssets *out_assets,
+    CountT *out_num_bytes,
+    const HullSimplificationConfig *simplify_cfg,
+    HullSimplificationReport *out_simplify_reports)
+{
+    auto tmp_frame = tmp_alloc.push();
+
+    HalfEdgeMesh *built_hulls =
+        tmp_alloc.allocN<HalfEdgeMesh>(convex_hull_meshes.size());
+    HullSimplificationStats *hull_stats =
+        tmp_alloc.allocN<HullSimplificationStats>(convex_hull_meshes.size());
+
+    auto hull_build_frame = tmp_alloc.push();
+
+    bool hull_success = processConvexHulls(convex_hull_meshes,
+                                           build_convex_hulls,
+                                           simplify_cfg,
+                                           tmp_alloc,
+                                           built_hulls,
+                                           hull_stats);
+
+    if (!hull_success) {
+        tmp_alloc.pop(hull_build_frame);
+        tmp_alloc.pop(tmp_frame);
+        return nullptr;
+    }
+
+    void *buffer = packRigidBodyAssets(convex_hull_meshes, collision_objs,
+        built_hulls, 1, tmp_alloc, out_assets, out_num_bytes);
+
+    if (out_simplify_reports != nullptr) {
+        computeSimplificationReports(collision_objs, hull_stats,
+                                     out_simplify_reports);
+    }
+
+    tmp_alloc.pop(hull_build_frame);
+    tmp_alloc.pop(tmp_frame);
+
+    return buffer;
+}
+
+void * RigidBodyAssets::processRigidBodyAssets(
+    Span<const imp::SourceMesh> convex_hull_meshes,
+    Span<const SourceCollisionObject> collision_objs,
+    bool build_convex_hulls,
+    CountT num_threads,
+    RigidBodyAssets *out_assets,
+    CountT *out_num_bytes,
+    const HullSimplificationConfig *simplify_cfg,
+    HullSimplificationReport *out_simplify_reports)
+{
+    if (num_threads == 0) {
+        num_threads = (CountT)std::max(std::thread::hardware_concurrency(),
+                                       1u);
+    }
+
+    CountT num_workers = std::min(num_threads,
+        std::max(convex_hull_meshes.size(), collision_objs.size()));
+    num_workers = std::max(num_workers, (CountT)1);
+
+    // Each worker builds into its own scratch allocator, which stays alive
+    // until the hulls have been copied into the output buffer. Hulls are
+    // written by index, so which worker builds which hull doesn't matter.
+    HeapArray<StackAlloc> worker_allocs(num_workers);
+    for (CountT i = 0; i < num_workers; i++) {
+        worker_allocs.emplace(i);
+    }
+
+    HeapArray<HalfEdgeMesh> built_hulls(convex_hull_meshes.size());
+    HeapArray<HullSimplificationStats> hull_stats(convex_hull_meshes.size());
+
+    AtomicU32 num_failed(0);
+    parallelFor(num_workers, convex_hull_meshes.size(),
+                [&](CountT worker_idx, CountT hull_idx) {
+        bool success = processConvexHull(convex_hull_meshes[hull_idx],
+            build_convex_hulls, simplify_cfg, worker_allocs[worker_idx],
+            &built_hulls[hull_idx], &hull_stats[hull_idx]);
+
+        if (!success) {
+            num_failed.fetch_add_relaxed(1);
+        }
+    });
+
+    if (num_failed.load_relaxed() > 0) {
+        return nullptr;
+    }
+
+    void *buffer = packRigidBodyAssets(convex_hull_meshes, collision_objs,
+        built_hulls.data(), num_workers, worker_allocs[0],
+        out_assets, out_num_bytes);
+
+    if (out_simplify_reports != nullptr) {
+        computeSimplificationReports(collision_objs, hull_stats.data(),
+                                     out_simplify_reports);
+    }
+
+    return buffer;
+}
+
+// Reads the next whitespace separated header field of a PGM file, skipping
+// comments. Returns false on EOF or if the field isn't a number.
+static bool readPGMHeaderField(std::ifstream &file, uint32_t *out)
+{
+    int c = file.get();
+    while (c != EOF) {
+        if (c == '#') {
+            while (c != EOF && c != '\n') {
+                c = file.get();
+            }
+        } else if (!isspace(c)) {
+            break;
+        } else {
+            c = file.get();
+        }
+    }
+
+    if (c < '0' || c > '9') {
+        return false;
+    }
+
+    uint64_t v = 0;
+    while (c >= '0' && c <= '9') {
+        v = v * 10 + uint64_t(c - '0');
+        if (v > 0xFFFF'FFFF) {
+            return false;
+        }
+        c = file.get();
+    }
+
+    // Exactly one whitespace character separates the last header field
+    // from the samples, which has now been consumed
+    if (c != EOF && !isspace(c)) {
+        return false;
+    }
+
+    *out = (uint32_t)v;
+    return true;
+}
+
+Optional<HeightfieldImage> HeightfieldImage::loadPGM(const char *path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return Optional<HeightfieldImage>::none();
+    }
+
+    char magic[2];
+    file.read(magic, 2);
+    if (!file || magic[0] != 'P' || magic[1] != '5') {
+        return Optional<HeightfieldImage>::none();
+    }
+
+    uint32_t num_cols, num_rows, max_val;
+    if (!readPGMHeaderField(file, &num_cols) ||
+            !readPGMHeaderField(file, &num_rows) ||
+            !readPGMHeaderField(file, &max_val)) {
+        return Optional<HeightfieldImage>::none();
+    }
+
+    if (num_cols < 2 || num_rows < 2 || max_val == 0 || max_val > 0xFFFF) {
+        return Optional<HeightfieldImage>::none();
+    }
+
+    const CountT num_samples = (CountT)num_rows * (CountT)num_cols;
+    const CountT bytes_per_sample = max_val < 256 ? 1 : 2;
+
+    HeapArray<uint8_t> raw(num_samples * bytes_per_sample);
+    file.read((char *)raw.data(), raw.size());
+    if (!file) {
+        return Optional<HeightfieldImage>::none();
+    }
+
+    HeightfieldImage img {
+        .samples = HeapArray<uint16_t>(num_samples),
+        .numRows = num_rows,
+        .numCols = num_cols,
+    };
+
+    for (CountT row = 0; row < (CountT)num_rows; row++) {
+        // Flip so that row 0 of the heightfield is the -Y edge
+        const uint8_t *src_row =
+            raw.data() + (num_rows - 1 - row) * num_cols * bytes_per_sample;
+        uint16_t *dst_row = img.samples.data() + row * num_cols;
+
+        for (CountT col = 0; col < (CountT)num_cols; col++) {
+            uint32_t v;
+            if (bytes_per_sample == 1) {
+                v = src_row[col];
+            } else {
+                v = (uint32_t(src_row[2 * col]) << 8) |
+                    uint32_t(src_row[2 * col + 1]);
+            }
+
+            v = std::min(v, max_val);
+            dst_row[col] = (uint16_t)((v * 65535 + max_val / 2) / max_val);
+        }
+    }
+
+    return img;
+}
+
+HeightfieldImage HeightfieldImage::quantize(Span<const float> heights,
+                                            uint32_t num_rows,
+                                            uint32_t num_cols,
+                                            float *out_min_height,
+                                            float *out_max_height)
+{
+    const CountT num_samples = (CountT)num_rows * (CountT)num_cols;
+    assert(heights.size() == num_samples);
+
+    float min_height = FLT_MAX;
+    float max_height = -FLT_MAX;
+    for (float h : heights) {
+        min_height = std::min(min_height, h);
+        max_height = std::max(max_height, h);
+    }
+
+    HeightfieldImage img {
+        .samples = HeapArray<uint16_t>(num_samples),
+        .numRows = num_rows,
+        .numCols = num_cols,
+    };
+
+    const float range = max_height - min_height;
+    const float to_sample = range > 0.f ? 65535.f / range : 0.f;
+    for (CountT i = 0; i < num_samples; i++) {
+        float v = std::round((heights[i] - min_height) * to_sample);
+        img.samples[i] = (uint16_t)std::clamp(v, 0.f, 65535.f);
+    }
+
+    *out_min_height = min_height;
+    *out_max_height = max_height;
+
+    return img;
+}
+
+SourceCollisionPrimitive HeightfieldImage::makePrimitive(
+    float cell_size,
+    float min_height,
+    float max_height) const
+{
+    return SourceCollisionPrimitive {
+        .type = CollisionPrimitive::Type::Heightfield,
+        .heightfieldInput = {
+            .samples = samples.data(),
+            .numRows = numRows,
+            .numCols = numCols,
+            .cellSize = cell_size,
+            .minHeight = min_height,
+            .heightScale = (max_height - min_height) / 65535.f,
+        },
+    };
+}
+
 }
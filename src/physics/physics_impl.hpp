@@ -7,6 +7,10 @@ namespace madrona::phys {
 struct PhysicsSystemState {
     float deltaT;
     float h;
+    // Time between narrowphase passes: deltaT for TGS, which runs the
+    // narrowphase once per step, and h for XPBD, which runs it every
+    // substep. Speculative contacts cover the motion over this interval.
+    float contactDeltaT;
     math::Vector3 g;
     float gMagnitude;
     float restitutionThreshold;
@@ -16,6 +20,195 @@ struct PhysicsSystemState {
 
 struct CandidateTemporary : Archetype<CandidateCollision> {};
 
+// Persistent per-world cache of narrowphase and solver state for each
+// colliding primitive pair. CandidateCollisions are rebuilt from scratch
+// every step, so entries are keyed by (leaf, leaf, prim, prim), which stays
+// stable for as long as both bodies are registered with the broadphase.
+struct ContactCache {
+    static constexpr inline uint64_t emptyKey = ~0_u64;
+    static constexpr inline int32_t maxProbes = 32;
+
+    // FIXME: absolute distance (in reference body space) under which a new
+    // contact point inherits the impulses of an old one. Should be scaled
+    // by object size.
+    static constexpr inline float pointMatchDistance = 0.05f;
+    // Cached impulses are dropped if the contact normal rotates further
+    // than this between steps (or the reference body flips)
+    static constexpr inline float normalMatchCos = 0.9f;
+
+    // Which axis separated the pair (or determined the contact type) the
+    // last time SAT ran on it
+    enum class SATFeature : uint32_t {
+        None,
+        FaceA,
+        FaceB,
+        EdgeAB,
+    };
+
+    struct Entry {
+        uint64_t key;
+        uint32_t lastStep;
+        SATFeature satFeature;
+        uint32_t satIdxA;
+        uint32_t satIdxB;
+        int32_t numPoints;
+        math::Vector3 normal;
+        math::Vector3 localPoints[4];
+        // Accumulated impulses per point. Only the TGS solver warm starts
+        // from (and writes back) these: XPBD's positional multipliers are
+        // reset every substep, so under XPBD the cache only saves SAT work.
+        float normalImpulses[4];
+        float tangentImpulses[4][2];
+        // Position of this entry in liveEntries
+        uint32_t liveIdx;
+    };
+
+    ContactCache(CountT max_dynamic_objects);
+
+    // Keys pack 24 bits per leaf and 8 bits per primitive. Pairs that
+    // don't fit must skip the cache rather than alias another pair's entry.
+    static inline bool keyFits(broadphase::LeafID a_leaf,
+                               broadphase::LeafID b_leaf,
+                               uint32_t a_prim,
+                               uint32_t b_prim);
+
+    static inline uint64_t makeKey(broadphase::LeafID a_leaf,
+                                   broadphase::LeafID b_leaf,
+                                   uint32_t a_prim,
+                                   uint32_t b_prim);
+
+    // Returns the entry index for key, inserting a fresh entry if needed.
+    // Returns -1 if the probe sequence is exhausted.
+    int32_t findOrInsert(uint64_t key);
+
+    // Drops entries that weren't touched during the last step. Only visits
+    // live entries, not the whole table. Must not run concurrently with
+    // findOrInsert.
+    void advanceStep();
+
+    // Drops all entries, needed whenever leaf IDs get recycled
+    void clear();
+
+    Entry *entries;
+    // Indices of every occupied entry, in no particular order
+    uint32_t *liveEntries;
+    uint32_t numLive;
+    uint32_t capacity;
+    uint32_t curStep;
+};
+
+bool ContactCache::keyFits(broadphase::LeafID a_leaf,
+                           broadphase::LeafID b_leaf,
+                           uint32_t a_prim,
+                           uint32_t b_prim)
+{
+    // The all ones leaf ID is excluded so no key can equal emptyKey
+    constexpr int32_t leaf_limit = (1 << 24) - 1;
+
+    return a_leaf.id >= 0 && a_leaf.id < leaf_limit &&
+        b_leaf.id >= 0 && b_leaf.id < leaf_limit &&
+        a_prim < 256 && b_prim < 256;
+}
+
+uint64_t ContactCache::makeKey(broadphase::LeafID a_leaf,
+                               broadphase::LeafID b_leaf,
+                               uint32_t a_prim,
+                               uint32_t b_prim)
+{
+    assert(keyFits(a_leaf, b_leaf, a_prim, b_prim));
+
+    return (uint64_t(a_leaf.id) << 40) | (uint64_t(b_leaf.id) << 16) |
+        (uint64_t(a_prim) << 8) | uint64_t(b_prim);
+}
+
+// Per-world simulation islands and sleep state, indexed by broadphase LeafID.
+// Islands are rebuilt every step with a union-find over touching and jointed
+// dynamic bodies. Links inside sleeping islands are kept, so a contact with
+// any member of a sleeping island pulls the whole island back in. Only
+// active when sleeping was enabled in PhysicsSystem::init, otherwise every
+// body stays awake and no islands are built.
+struct IslandState {
+    // FIXME: these should be configurable through PhysicsSystem::init
+    static constexpr inline float linearSleepVelocity = 0.05f;
+    static constexpr inline float angularSleepVelocity = 0.05f;
+    // Seconds every body in an island must stay below the sleep velocities
+    // before the island goes to sleep
+    static constexpr inline float timeToSleep = 0.5f;
+
+    struct Body {
+        int32_t parent;
+        float sleepTimer;
+        // Minimum sleepTimer over the island, only valid for island roots
+        float islandSleepTimer;
+        uint32_t dynamic;
+        uint32_t asleep;
+        // Pose a sleeping body was left at, a different pose at the start
+        // of the next step means it was moved from outside and wakes it
+        math::Vector3 sleepPosition;
+        math::Quat sleepRotation;
+    };
+
+    IslandState(CountT max_leaves, bool enable_sleeping);
+
+    inline bool isAsleep(broadphase::LeafID leaf_id) const;
+
+    // Wakes a single body. The rest of its island is woken the next time
+    // islands are evaluated.
+    inline void wake(broadphase::LeafID leaf_id);
+
+    int32_t findRoot(int32_t leaf_idx);
+    void link(broadphase::LeafID a_leaf, broadphase::LeafID b_leaf);
+
+    // Wakes every body and drops all island links
+    void clear();
+
+    Body *bodies;
+    CountT maxLeaves;
+    bool enabled;
+};
+
+bool IslandState::isAsleep(broadphase::LeafID leaf_id) const
+{
+    return bodies[leaf_id.id].asleep != 0;
+}
+
+void IslandState::wake(broadphase::LeafID leaf_id)
+{
+    AtomicU32Ref asleep(bodies[leaf_id.id].asleep);
+    asleep.store<sync::relaxed>(0);
+}
+
+// Per-world continuous collision state, indexed by broadphase LeafID.
+// Bodies flagged with PhysicsSystem::setContinuousCollision record their
+// pose before the solver runs. Afterwards, their convex primitives are
+// swept along the step's motion with conservative advancement, stopping
+// them short of any body they would have passed through. Speculative contacts from the next step's narrowphase
+// then handle the actual collision.
+struct CCDState {
+    // Bodies moving less than this fraction of their inner radius during
+    // a step can't pass through anything, so they aren't tested
+    static constexpr inline float minMotionFraction = 0.5f;
+    // Gap left between a stopped body and the surface it hit, as a
+    // fraction of the body's inner radius
+    static constexpr inline float targetSeparationFraction = 0.02f;
+    // Conservative advancement steps per primitive pair before giving up
+    // and stopping the body where the last step left it
+    static constexpr inline CountT maxAdvanceIterations = 16;
+
+    struct Body {
+        math::Vector3 startPosition;
+        uint32_t enabled;
+    };
+
+    CCDState(CountT max_leaves);
+
+    // Clears every flag, needed whenever leaf IDs get recycled
+    void clear();
+
+    Body *bodies;
+    CountT maxLeaves;
+};
+
 namespace broadphase {
 
 TaskGraphNodeID setupBVHTasks(
@@ -34,6 +227,50 @@ TaskGraphNodeID setupPostIntegrationTasks(
 
 namespace narrowphase {
 
+TaskGraphNodeID setupTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps);
+
+TaskGraphNodeID setupContactCacheTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps);
+
+#ifndef MADRONA_GPU_MODE
+// Runs the narrowphase for a single candidate pair, for solvers that fold
+// the narrowphase into their own taskgraph node on the CPU. Callers must
+// reset the tmp allocator afterwards, like the node from setupTasks does.
+void runCandidate(Context &ctx, const CandidateCollision &candidate);
+#endif
+
+}
+
+namespace islands {
+
+// Wakes sleeping bodies that have been given a velocity or external force
+// since the last step. Must run before broadphase pair generation.
+TaskGraphNodeID setupWakeTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps);
+
+// Builds islands from this step's contacts and joints and puts islands that
+// have come to rest to sleep. Must run after the solver and before the
+// post-integration BVH refit.
+TaskGraphNodeID setupTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps);
+
+}
+
+namespace ccd {
+
+// Records the start of step position of flagged bodies. Must run before
+// the solver.
+TaskGraphNodeID setupPreSolveTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps);
+
+// Clamps the motion of flagged bodies against the bodies they would have
+// passed through. Must run after the solver and before islands are updated.
 TaskGraphNodeID setupTasks(
     TaskGraphBuilder &builder,
     Span<const TaskGraphNodeID> deps);
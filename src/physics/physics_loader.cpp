@@ -212,6 +212,8 @@ CountT PhysicsLoader::loadRigidBodies(const RigidBodyAssets &assets)
     uint32_t *hull_face_base_halfedges;
     Plane *hull_face_planes;
     Vector3 *hull_verts;
+    uint16_t *heightfield_samples;
+    uint8_t *mesh_bvh_data;
     switch (impl_->execMode) {
     case ExecMode::CPU: {
         memcpy(prim_aabbs_dst, assets.primitiveAABBs,
@@ -243,6 +245,14 @@ CountT PhysicsLoader::loadRigidBodies(const RigidBodyAssets &assets)
                sizeof(Plane) * assets.hullData.numFaces);
         memcpy(hull_verts, assets.hullData.vertices,
                sizeof(Vector3) * assets.hullData.numVerts);
+
+        heightfield_samples = (uint16_t *)malloc(
+            sizeof(uint16_t) * assets.numHeightfieldSamples);
+        memcpy(heightfield_samples, assets.heightfieldSamples,
+               sizeof(uint16_t) * assets.numHeightfieldSamples);
+
+        mesh_bvh_data = (uint8_t *)malloc(assets.numMeshBVHBytes);
+        memcpy(mesh_bvh_data, assets.meshBVHData, assets.numMeshBVHBytes);
     } break;
     case ExecMode::CUDA: {
 #ifndef MADRONA_CUDA_SUPPORT
@@ -286,6 +296,16 @@ CountT PhysicsLoader::loadRigidBodies(const RigidBodyAssets &assets)
         cudaMemcpy(hull_verts, assets.hullData.vertices,
                    sizeof(Vector3) * assets.hullData.numVerts,
                    cudaMemcpyHostToDevice);
+
+        heightfield_samples = (uint16_t *)cu::allocGPU(
+            sizeof(uint16_t) * assets.numHeightfieldSamples);
+        cudaMemcpy(heightfield_samples, assets.heightfieldSamples,
+                   sizeof(uint16_t) * assets.numHeightfieldSamples,
+                   cudaMemcpyHostToDevice);
+
+        mesh_bvh_data = (uint8_t *)cu::allocGPU(assets.numMeshBVHBytes);
+        cudaMemcpy(mesh_bvh_data, assets.meshBVHData,
+                   assets.numMeshBVHBytes, cudaMemcpyHostToDevice);
 #endif
     }
     }
@@ -297,6 +317,29 @@ CountT PhysicsLoader::loadRigidBodies(const RigidBodyAssets &assets)
 
     for (CountT i = 0; i < (CountT)assets.totalNumPrimitives; i++) {
         CollisionPrimitive &cur_primitive = primitives_tmp[i];
+        if (cur_primitive.type == CollisionPrimitive::Type::Heightfield) {
+            CountT sample_offset = cur_primitive.heightfield.samples -
+                assets.heightfieldSamples;
+            cur_primitive.heightfield.samples =
+                heightfield_samples + sample_offset;
+            continue;
+        }
+
+        if (cur_primitive.type == CollisionPrimitive::Type::TriangleMesh) {
+            MeshBVH &bvh = cur_primitive.triangleMesh.bvh;
+
+            auto rebase = [&](auto *ptr) {
+                CountT byte_offset = (uint8_t *)ptr - assets.meshBVHData;
+                return (decltype(ptr))(mesh_bvh_data + byte_offset);
+            };
+
+            bvh.nodes = rebase(bvh.nodes);
+            bvh.leafGeos = rebase(bvh.leafGeos);
+            bvh.leafMats = rebase(bvh.leafMats);
+            bvh.vertices = rebase(bvh.vertices);
+            continue;
+        }
+
         if (cur_primitive.type != CollisionPrimitive::Type::Hull) continue;
 
         HalfEdgeMesh &he_mesh = cur_primitive.hull.halfEdgeMesh;
@@ -0,0 +1,2077 @@
+#pragma once
+
+#include <madrona/geo.hpp>
+#include <madrona/physics.hpp>
+
+#include "gjk.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <utility>
+
+namespace madrona::phys::prims {
+
+/*
+Contact routines for the capsule, box and heightfield primitives. This is
+intended to be a private implementation file for narrowphase.cpp, but
+factored out into a header so the routines can be unit tested.
+
+All inputs are in world space. Every routine follows the same convention,
+which matches the sphere vs plane contact in narrowphase.cpp: b is the
+reference body, the normal points out of b towards a, and each contact
+point lies on the surface of b, with a's deepest point at
+point - normal * depth.
+
+Routines taking max_separation also report features that are apart by up
+to that distance, as speculative contacts with negative depth.
+
+Heightfields and triangle meshes are always b. Their routines gather per
+triangle candidates in b's local space and merge them into one manifold
+with a single normal, so objects sliding across them don't catch on the
+internal edges between triangles.
+*/
+
+using namespace math;
+
+constexpr inline int32_t maxContactPoints = 8;
+
+// Segments closer to parallel than this get a contact at both ends of their
+// overlap rather than a single closest point
+constexpr inline float parallelCos = 0.999f;
+
+// Box vs box edge axes need to beat the best face axis by this much to be
+// used. Face contacts give a full manifold, so they're preferred.
+constexpr inline float boxEdgeAxisTolerance = 5e-3f;
+
+struct Contact {
+    Vector3 normal;
+    Vector3 points[maxContactPoints];
+    float depths[maxContactPoints];
+    int32_t numPoints;
+};
+
+// Capsule around the segment from p1 to p2
+struct CapsuleShape {
+    Vector3 p1;
+    Vector3 p2;
+    float radius;
+};
+
+struct BoxShape {
+    Vector3 center;
+    Quat rot;
+    Vector3 halfExtents;
+};
+
+// Half edge mesh of the box with corners at (+-1, +-1, +-1). Hull routines
+// take boxes in this form, scaled by the box's half extents.
+struct UnitBoxHull {
+    geo::HalfEdge halfEdges[24];
+    uint32_t faceBaseHalfEdges[6];
+    geo::Plane facePlanes[6];
+    Vector3 vertices[8];
+
+    inline geo::HalfEdgeMesh mesh()
+    {
+        return geo::HalfEdgeMesh {
+            .halfEdges = halfEdges,
+            .faceBaseHalfEdges = faceBaseHalfEdges,
+            .facePlanes = facePlanes,
+            .vertices = vertices,
+            .numHalfEdges = 24,
+            .numFaces = 6,
+            .numVertices = 8,
+        };
+    }
+};
+
+inline UnitBoxHull makeUnitBoxHull()
+{
+    // Twins are at 2e and 2e + 1 to match HalfEdgeMesh::twinIDX
+    return UnitBoxHull {
+        .halfEdges = {
+            { 2, 0, 0 }, { 19, 3, 5 }, { 4, 3, 0 }, { 22, 2, 4 },
+            { 6, 2, 0 }, { 20, 1, 3 }, { 0, 1, 0 }, { 16, 0, 2 },
+            { 10, 4, 1 }, { 18, 5, 2 }, { 12, 5, 1 }, { 17, 6, 3 },
+            { 14, 6, 1 }, { 21, 7, 4 }, { 8, 7, 1 }, { 23, 4, 5 },
+            { 9, 1, 2 }, { 5, 5, 3 }, { 7, 4, 2 }, { 15, 0, 5 },
+            { 11, 2, 3 }, { 3, 6, 4 }, { 13, 3, 4 }, { 1, 7, 5 },
+        },
+        .faceBaseHalfEdges = { 0, 8, 7, 5, 3, 1 },
+        .facePlanes = {
+            { { 0, 0, -1 }, 1 },
+            { { 0, 0, 1 }, 1 },
+            { { 0, -1, 0 }, 1 },
+            { { 1, 0, 0 }, 1 },
+            { { 0, 1, 0 }, 1 },
+            { { -1, 0, 0 }, 1 },
+        },
+        .vertices = {
+            { -1, -1, -1 }, { 1, -1, -1 }, { 1, 1, -1 }, { -1, 1, -1 },
+            { -1, -1, 1 }, { 1, -1, 1 }, { 1, 1, 1 }, { -1, 1, 1 },
+        },
+    };
+}
+
+inline float clamp01(float t)
+{
+    return fminf(fmaxf(t, 0.f), 1.f);
+}
+
+inline void addContactPoint(Contact *out, Vector3 point, float depth)
+{
+    int32_t idx = out->numPoints++;
+    out->points[idx] = point;
+    out->depths[idx] = depth;
+}
+
+// Any unit vector perpendicular to v
+inline Vector3 perpendicular(Vector3 v)
+{
+    Vector3 other = fabsf(v.x) < 0.9f ?
+        Vector3 { 1, 0, 0 } : Vector3 { 0, 1, 0 };
+    return cross(v, other).normalize();
+}
+
+// Parameter of the point on segment [a, b] closest to p
+inline float closestPointOnSegment(Vector3 p, Vector3 a, Vector3 b)
+{
+    Vector3 ab = b - a;
+    float len2 = ab.length2();
+    if (len2 == 0.f) {
+        return 0.f;
+    }
+
+    return clamp01(dot(p - a, ab) / len2);
+}
+
+// RTCD 5.1.9. Parameters of the closest points on segments [p1, q1] and
+// [p2, q2].
+inline void closestPointsBetweenSegments(
+    Vector3 p1, Vector3 q1, Vector3 p2, Vector3 q2,
+    float *s_out, float *t_out)
+{
+    constexpr float eps = 1e-12f;
+
+    Vector3 d1 = q1 - p1;
+    Vector3 d2 = q2 - p2;
+    Vector3 r = p1 - p2;
+
+    float a = d1.length2();
+    float e = d2.length2();
+    float f = dot(d2, r);
+
+    float s, t;
+    if (a <= eps && e <= eps) {
+        s = 0.f;
+        t = 0.f;
+    } else if (a <= eps) {
+        s = 0.f;
+        t = clamp01(f / e);
+    } else {
+        float c = dot(d1, r);
+        if (e <= eps) {
+            t = 0.f;
+            s = clamp01(-c / a);
+        } else {
+            float b = dot(d1, d2);
+            float denom = a * e - b * b;
+
+            // Parallel segments have no unique answer, pick s = 0
+            s = denom > 0.f ? clamp01((b * f - c * e) / denom) : 0.f;
+            t = (b * s + f) / e;
+
+            if (t < 0.f) {
+                t = 0.f;
+                s = clamp01(-c / a);
+            } else if (t > 1.f) {
+                t = 1.f;
+                s = clamp01((b - c) / a);
+            }
+        }
+    }
+
+    *s_out = s;
+    *t_out = t;
+}
+
+// Contact between two spheres, which is also the single point contact
+// between any pair of rounded primitives once their closest core points are
+// known
+inline bool sphereSphere(Vector3 a_center, float a_radius,
+                         Vector3 b_center, float b_radius,
+                         Contact *out)
+{
+    Vector3 to_a = a_center - b_center;
+    float dist2 = to_a.length2();
+    float radius_sum = a_radius + b_radius;
+
+    if (dist2 > radius_sum * radius_sum) {
+        return false;
+    }
+
+    float dist = sqrtf(dist2);
+    Vector3 normal = dist > 0.f ? to_a / dist : math::up;
+
+    out->normal = normal;
+    out->numPoints = 0;
+    addContactPoint(out, b_center + normal * b_radius, radius_sum - dist);
+
+    return true;
+}
+
+inline bool sphereCapsule(Vector3 sphere_center, float sphere_radius,
+                          const CapsuleShape &capsule,
+                          Contact *out)
+{
+    float t = closestPointOnSegment(sphere_center, capsule.p1, capsule.p2);
+    Vector3 core_pt = capsule.p1 + t * (capsule.p2 - capsule.p1);
+
+    return sphereSphere(sphere_center, sphere_radius,
+                        core_pt, capsule.radius, out);
+}
+
+inline bool capsuleCapsule(const CapsuleShape &a,
+                           const CapsuleShape &b,
+                           Contact *out)
+{
+    Vector3 a_dir = a.p2 - a.p1;
+    Vector3 b_dir = b.p2 - b.p1;
+
+    float s, t;
+    closestPointsBetweenSegments(a.p1, a.p2, b.p1, b.p2, &s, &t);
+
+    Vector3 a_core = a.p1 + s * a_dir;
+    Vector3 b_core = b.p1 + t * b_dir;
+
+    Vector3 to_a = a_core - b_core;
+    float dist2 = to_a.length2();
+    float radius_sum = a.radius + b.radius;
+
+    if (dist2 > radius_sum * radius_sum) {
+        return false;
+    }
+
+    float dist = sqrtf(dist2);
+
+    Vector3 normal;
+    if (dist > 0.f) {
+        normal = to_a / dist;
+    } else {
+        Vector3 axis_cross = cross(b_dir, a_dir);
+        if (axis_cross.length2() > 0.f) {
+            normal = axis_cross.normalize();
+        } else if (b_dir.length2() > 0.f) {
+            normal = perpendicular(b_dir.normalize());
+        } else {
+            normal = math::up;
+        }
+    }
+
+    out->normal = normal;
+    out->numPoints = 0;
+
+    // Capsules lying side by side get a contact at each end of the overlap
+    // of their segments, otherwise they can roll around the single point.
+    float a_len2 = a_dir.length2();
+    float b_len2 = b_dir.length2();
+    if (a_len2 > 0.f && b_len2 > 0.f &&
+            fabsf(dot(a_dir, b_dir)) > parallelCos * sqrtf(a_len2 * b_len2)) {
+        float t1 = dot(a.p1 - b.p1, b_dir) / b_len2;
+        float t2 = dot(a.p2 - b.p1, b_dir) / b_len2;
+
+        float t_min = fmaxf(fminf(t1, t2), 0.f);
+        float t_max = fminf(fmaxf(t1, t2), 1.f);
+
+        if (t_max > t_min) {
+            for (float overlap_t : { t_min, t_max }) {
+                Vector3 b_pt = b.p1 + overlap_t * b_dir;
+                Vector3 a_pt = a.p1 +
+                    closestPointOnSegment(b_pt, a.p1, a.p2) * a_dir;
+
+                float depth = radius_sum - dot(a_pt - b_pt, normal);
+                if (depth >= 0.f) {
+                    addContactPoint(out, b_pt + normal * b.radius, depth);
+                }
+            }
+
+            if (out->numPoints > 0) {
+                return true;
+            }
+        }
+    }
+
+    addContactPoint(out, b_core + normal * b.radius, radius_sum - dist);
+
+    return true;
+}
+
+inline bool capsulePlane(const CapsuleShape &capsule,
+                         geo::Plane plane,
+                         Contact *out)
+{
+    out->normal = plane.normal;
+    out->numPoints = 0;
+
+    for (Vector3 p : { capsule.p1, capsule.p2 }) {
+        float dist = dot(plane.normal, p) - plane.d;
+        if (dist <= capsule.radius) {
+            addContactPoint(out, p - dist * plane.normal,
+                            capsule.radius - dist);
+        }
+    }
+
+    return out->numPoints > 0;
+}
+
+inline bool sphereBox(Vector3 sphere_center, float sphere_radius,
+                      const BoxShape &box,
+                      Contact *out)
+{
+    Vector3 h = box.halfExtents;
+    Vector3 local = box.rot.inv().rotateVec(sphere_center - box.center);
+
+    Vector3 clamped {
+        fminf(fmaxf(local.x, -h.x), h.x),
+        fminf(fmaxf(local.y, -h.y), h.y),
+        fminf(fmaxf(local.z, -h.z), h.z),
+    };
+
+    Vector3 local_normal;
+    Vector3 local_point;
+    float depth;
+
+    Vector3 diff = local - clamped;
+    float dist2 = diff.length2();
+    if (dist2 > 0.f) {
+        if (dist2 > sphere_radius * sphere_radius) {
+            return false;
+        }
+
+        float dist = sqrtf(dist2);
+        local_normal = diff / dist;
+        local_point = clamped;
+        depth = sphere_radius - dist;
+    } else {
+        // Center is inside the box, push out through the closest face
+        CountT min_axis = 0;
+        float min_face_dist = FLT_MAX;
+        for (CountT i = 0; i < 3; i++) {
+            float face_dist = h[i] - fabsf(local[i]);
+            if (face_dist < min_face_dist) {
+                min_face_dist = face_dist;
+                min_axis = i;
+            }
+        }
+
+        float sign = local[min_axis] < 0.f ? -1.f : 1.f;
+
+        local_normal = Vector3::zero();
+        local_normal[min_axis] = sign;
+        local_point = local;
+        local_point[min_axis] = sign * h[min_axis];
+        depth = sphere_radius + min_face_dist;
+    }
+
+    out->normal = box.rot.rotateVec(local_normal);
+    out->numPoints = 0;
+    addContactPoint(out, box.rot.rotateVec(local_point) + box.center, depth);
+
+    return true;
+}
+
+// Clips segment [p, q] to the slab -h <= x[axis] <= h, narrowing [t0, t1]
+inline bool clipSegmentToSlab(Vector3 p, Vector3 q, CountT axis, float h,
+                              float *t0, float *t1)
+{
+    float start = p[axis];
+    float delta = q[axis] - start;
+
+    if (delta == 0.f) {
+        return start >= -h && start <= h;
+    }
+
+    float ta = (-h - start) / delta;
+    float tb = (h - start) / delta;
+    if (ta > tb) {
+        std::swap(ta, tb);
+    }
+
+    *t0 = fmaxf(*t0, ta);
+    *t1 = fminf(*t1, tb);
+
+    return *t0 <= *t1;
+}
+
+// Closest points between segment [p, q] and the origin centered box with
+// half extents h, in the box's space. Returns the squared distance, which
+// is 0 if the segment touches the box.
+inline float segmentBoxClosestPoints(Vector3 p, Vector3 q, Vector3 h,
+                                     Vector3 *seg_pt_out, Vector3 *box_pt_out)
+{
+    auto clampToBox = [h](Vector3 v) {
+        return Vector3 {
+            fminf(fmaxf(v.x, -h.x), h.x),
+            fminf(fmaxf(v.y, -h.y), h.y),
+            fminf(fmaxf(v.z, -h.z), h.z),
+        };
+    };
+
+    {
+        float t0 = 0.f, t1 = 1.f;
+        if (clipSegmentToSlab(p, q, 0, h.x, &t0, &t1) &&
+                clipSegmentToSlab(p, q, 1, h.y, &t0, &t1) &&
+                clipSegmentToSlab(p, q, 2, h.z, &t0, &t1)) {
+            Vector3 inside = p + t0 * (q - p);
+            *seg_pt_out = inside;
+            *box_pt_out = inside;
+            return 0.f;
+        }
+    }
+
+    // The closest features are either an endpoint of the segment against
+    // the box, or the segment against one of the box's 12 edges
+    float min_dist2 = FLT_MAX;
+    auto testPair = [&](Vector3 seg_pt, Vector3 box_pt) {
+        float dist2 = seg_pt.distance2(box_pt);
+        if (dist2 < min_dist2) {
+            min_dist2 = dist2;
+            *seg_pt_out = seg_pt;
+            *box_pt_out = box_pt;
+        }
+    };
+
+    testPair(p, clampToBox(p));
+    testPair(q, clampToBox(q));
+
+    for (CountT axis = 0; axis < 3; axis++) {
+        CountT u = (axis + 1) % 3;
+        CountT v = (axis + 2) % 3;
+
+        for (float su : { -1.f, 1.f }) {
+            for (float sv : { -1.f, 1.f }) {
+                Vector3 e1, e2;
+                e1[axis] = -h[axis];
+                e2[axis] = h[axis];
+                e1[u] = e2[u] = su * h[u];
+                e1[v] = e2[v] = sv * h[v];
+
+                float s, t;
+                closestPointsBetweenSegments(p, q, e1, e2, &s, &t);
+                testPair(p + s * (q - p), e1 + t * (e2 - e1));
+            }
+        }
+    }
+
+    return min_dist2;
+}
+
+inline bool capsuleBox(const CapsuleShape &capsule,
+                       const BoxShape &box,
+                       Contact *out)
+{
+    Quat to_local = box.rot.inv();
+    Vector3 p = to_local.rotateVec(capsule.p1 - box.center);
+    Vector3 q = to_local.rotateVec(capsule.p2 - box.center);
+    Vector3 h = box.halfExtents;
+    float r = capsule.radius;
+
+    auto finish = [&](Vector3 local_normal) {
+        out->normal = box.rot.rotateVec(local_normal);
+        for (int32_t i = 0; i < out->numPoints; i++) {
+            out->points[i] = box.rot.rotateVec(out->points[i]) + box.center;
+        }
+    };
+
+    // Contacts for both ends of the segment against face (axis, sign),
+    // clipped to the face's sides
+    auto addFaceContacts = [&](CountT axis, float sign) {
+        float t0 = 0.f, t1 = 1.f;
+        CountT u = (axis + 1) % 3;
+        CountT v = (axis + 2) % 3;
+        if (!clipSegmentToSlab(p, q, u, h[u], &t0, &t1) ||
+                !clipSegmentToSlab(p, q, v, h[v], &t0, &t1)) {
+            return;
+        }
+
+        CountT num_ends = t1 > t0 ? 2 : 1;
+        for (CountT i = 0; i < num_ends; i++) {
+            Vector3 pt = p + (i == 0 ? t0 : t1) * (q - p);
+            float depth = r + h[axis] - sign * pt[axis];
+            if (depth >= 0.f) {
+                pt[axis] = sign * h[axis];
+                addContactPoint(out, pt, depth);
+            }
+        }
+    };
+
+    out->numPoints = 0;
+
+    Vector3 seg_pt, box_pt;
+    float dist2 = segmentBoxClosestPoints(p, q, h, &seg_pt, &box_pt);
+
+    if (dist2 > 0.f) {
+        if (dist2 > r * r) {
+            return false;
+        }
+
+        float dist = sqrtf(dist2);
+        Vector3 local_normal = (seg_pt - box_pt) / dist;
+
+        // A capsule resting on a face gets a contact at both ends
+        for (CountT axis = 0; axis < 3; axis++) {
+            if (fabsf(local_normal[axis]) > parallelCos) {
+                float sign = local_normal[axis] < 0.f ? -1.f : 1.f;
+                addFaceContacts(axis, sign);
+
+                if (out->numPoints > 0) {
+                    Vector3 face_normal = Vector3::zero();
+                    face_normal[axis] = sign;
+                    finish(face_normal);
+                    return true;
+                }
+            }
+        }
+
+        addContactPoint(out, box_pt, r - dist);
+        finish(local_normal);
+        return true;
+    }
+
+    // The segment passes through the box. Push the capsule out through the
+    // face it penetrates least.
+    CountT best_axis = 0;
+    float best_sign = 1.f;
+    float best_sep = -FLT_MAX;
+    for (CountT axis = 0; axis < 3; axis++) {
+        for (float sign : { -1.f, 1.f }) {
+            float sep = fminf(sign * p[axis], sign * q[axis]) - r - h[axis];
+            if (sep > best_sep) {
+                best_sep = sep;
+                best_axis = axis;
+                best_sign = sign;
+            }
+        }
+    }
+
+    for (Vector3 end : { p, q }) {
+        float depth = r + h[best_axis] - best_sign * end[best_axis];
+        if (depth >= 0.f) {
+            Vector3 pt {
+                fminf(fmaxf(end.x, -h.x), h.x),
+                fminf(fmaxf(end.y, -h.y), h.y),
+                fminf(fmaxf(end.z, -h.z), h.z),
+            };
+            pt[best_axis] = best_sign * h[best_axis];
+            addContactPoint(out, pt, depth);
+        }
+    }
+
+    Vector3 face_normal = Vector3::zero();
+    face_normal[best_axis] = best_sign;
+    finish(face_normal);
+
+    return true;
+}
+
+inline bool boxPlane(const BoxShape &box,
+                     geo::Plane plane,
+                     Contact *out,
+                     float max_separation = 0.f)
+{
+    Mat3x3 axes = Mat3x3::fromQuat(box.rot);
+    Vector3 h = box.halfExtents;
+
+    // Fast reject with the box's extent along the normal
+    float radius = h.x * fabsf(dot(axes[0], plane.normal)) +
+        h.y * fabsf(dot(axes[1], plane.normal)) +
+        h.z * fabsf(dot(axes[2], plane.normal));
+    if (dot(plane.normal, box.center) - plane.d > radius + max_separation) {
+        return false;
+    }
+
+    out->normal = plane.normal;
+    out->numPoints = 0;
+
+    for (CountT i = 0; i < 8; i++) {
+        Vector3 corner = box.center +
+            ((i & 1) ? h.x : -h.x) * axes[0] +
+            ((i & 2) ? h.y : -h.y) * axes[1] +
+            ((i & 4) ? h.z : -h.z) * axes[2];
+
+        float dist = dot(plane.normal, corner) - plane.d;
+        if (dist <= max_separation) {
+            addContactPoint(out, corner - dist * plane.normal, -dist);
+        }
+    }
+
+    return out->numPoints > 0;
+}
+
+// Sutherland-Hodgman clip of a convex polygon against the half space
+// dot(normal, x) <= d. dst needs room for num_src + 1 vertices.
+inline CountT clipPolygonToPlane(const Vector3 *src, CountT num_src,
+                                 Vector3 normal, float d, Vector3 *dst)
+{
+    CountT num_dst = 0;
+    for (CountT i = 0; i < num_src; i++) {
+        Vector3 cur = src[i];
+        Vector3 next = src[(i + 1) % num_src];
+
+        float cur_dist = dot(normal, cur) - d;
+        float next_dist = dot(normal, next) - d;
+
+        if (cur_dist <= 0.f) {
+            dst[num_dst++] = cur;
+        }
+
+        if ((cur_dist <= 0.f) != (next_dist <= 0.f)) {
+            float t = cur_dist / (cur_dist - next_dist);
+            dst[num_dst++] = cur + t * (next - cur);
+        }
+    }
+
+    return num_dst;
+}
+
+// 15 axis SAT (RTCD 4.4.1), then either a clipped face manifold or a single
+// edge contact
+inline bool boxBox(const BoxShape &a, const BoxShape &b, Contact *out,
+                   float max_separation = 0.f)
+{
+    Mat3x3 a_axes = Mat3x3::fromQuat(a.rot);
+    Mat3x3 b_axes = Mat3x3::fromQuat(b.rot);
+    Vector3 a_h = a.halfExtents;
+    Vector3 b_h = b.halfExtents;
+    Vector3 to_a = a.center - b.center;
+
+    auto projectedRadius = [](const Mat3x3 &axes, Vector3 h, Vector3 axis) {
+        return h.x * fabsf(dot(axes[0], axis)) +
+            h.y * fabsf(dot(axes[1], axis)) +
+            h.z * fabsf(dot(axes[2], axis));
+    };
+
+    auto separation = [&](Vector3 axis) {
+        return fabsf(dot(to_a, axis)) - projectedRadius(a_axes, a_h, axis) -
+            projectedRadius(b_axes, b_h, axis);
+    };
+
+    // Face axes. b's faces come first so they win ties, since b is the
+    // preferred reference.
+    float face_sep = -FLT_MAX;
+    bool a_is_ref = false;
+    CountT ref_axis = 0;
+    for (CountT i = 0; i < 3; i++) {
+        float sep = separation(b_axes[i]);
+        if (sep > max_separation) {
+            return false;
+        }
+
+        if (sep > face_sep) {
+            face_sep = sep;
+            ref_axis = i;
+        }
+    }
+
+    for (CountT i = 0; i < 3; i++) {
+        float sep = separation(a_axes[i]);
+        if (sep > max_separation) {
+            return false;
+        }
+
+        if (sep > face_sep + boxEdgeAxisTolerance) {
+            face_sep = sep;
+            a_is_ref = true;
+            ref_axis = i;
+        }
+    }
+
+    // Edge axes. Parallel edges give a degenerate axis that is already
+    // covered by the face axes.
+    float edge_sep = -FLT_MAX;
+    Vector3 edge_normal;
+    CountT a_edge_axis = 0, b_edge_axis = 0;
+    for (CountT i = 0; i < 3; i++) {
+        for (CountT j = 0; j < 3; j++) {
+            Vector3 axis = cross(a_axes[i], b_axes[j]);
+            float len2 = axis.length2();
+            if (len2 < 1e-6f) {
+                continue;
+            }
+
+            axis /= sqrtf(len2);
+            float sep = separation(axis);
+            if (sep > max_separation) {
+                return false;
+            }
+
+            if (sep > edge_sep) {
+                edge_sep = sep;
+                edge_normal = axis;
+                a_edge_axis = i;
+                b_edge_axis = j;
+            }
+        }
+    }
+
+    out->numPoints = 0;
+
+    if (edge_sep > face_sep + boxEdgeAxisTolerance) {
+        if (dot(edge_normal, to_a) < 0.f) {
+            edge_normal = -edge_normal;
+        }
+
+        // Support edges: a's edge closest to b and b's edge closest to a
+        Vector3 a_mid = a.center;
+        Vector3 b_mid = b.center;
+        for (CountT k = 0; k < 3; k++) {
+            if (k != a_edge_axis) {
+                float sign = dot(a_axes[k], edge_normal) > 0.f ? -1.f : 1.f;
+                a_mid += sign * a_h[k] * a_axes[k];
+            }
+
+            if (k != b_edge_axis) {
+                float sign = dot(b_axes[k], edge_normal) > 0.f ? 1.f : -1.f;
+                b_mid += sign * b_h[k] * b_axes[k];
+            }
+        }
+
+        Vector3 a_half_edge = a_h[a_edge_axis] * a_axes[a_edge_axis];
+        Vector3 b_half_edge = b_h[b_edge_axis] * b_axes[b_edge_axis];
+
+        float s, t;
+        closestPointsBetweenSegments(
+            a_mid - a_half_edge, a_mid + a_half_edge,
+            b_mid - b_half_edge, b_mid + b_half_edge, &s, &t);
+
+        out->normal = edge_normal;
+        addContactPoint(out,
+            b_mid - b_half_edge + 2.f * t * b_half_edge, -edge_sep);
+
+        return true;
+    }
+
+    const BoxShape &ref = a_is_ref ? a : b;
+    const BoxShape &incident = a_is_ref ? b : a;
+    const Mat3x3 &ref_axes = a_is_ref ? a_axes : b_axes;
+    const Mat3x3 &incident_axes = a_is_ref ? b_axes : a_axes;
+
+    Vector3 ref_normal = ref_axes[ref_axis];
+    if (dot(ref_normal, incident.center - ref.center) < 0.f) {
+        ref_normal = -ref_normal;
+    }
+
+    // Incident face is the face of the other box most opposed to ref_normal
+    CountT incident_axis = 0;
+    float max_align = -1.f;
+    for (CountT i = 0; i < 3; i++) {
+        float align = fabsf(dot(incident_axes[i], ref_normal));
+        if (align > max_align) {
+            max_align = align;
+            incident_axis = i;
+        }
+    }
+
+    float incident_sign =
+        dot(incident_axes[incident_axis], ref_normal) > 0.f ? -1.f : 1.f;
+
+    CountT iu = (incident_axis + 1) % 3;
+    CountT iv = (incident_axis + 2) % 3;
+    Vector3 incident_center = incident.center + incident_sign *
+        incident.halfExtents[incident_axis] * incident_axes[incident_axis];
+    Vector3 incident_u = incident.halfExtents[iu] * incident_axes[iu];
+    Vector3 incident_v = incident.halfExtents[iv] * incident_axes[iv];
+
+    Vector3 poly_a[maxContactPoints] = {
+        incident_center - incident_u - incident_v,
+        incident_center + incident_u - incident_v,
+        incident_center + incident_u + incident_v,
+        incident_center - incident_u + incident_v,
+    };
+    Vector3 poly_b[maxContactPoints];
+    CountT num_poly = 4;
+
+    // Clip against the 4 side planes of the reference face
+    Vector3 *src = poly_a;
+    Vector3 *dst = poly_b;
+    for (CountT k = 0; k < 3 && num_poly > 0; k++) {
+        if (k == ref_axis) {
+            continue;
+        }
+
+        Vector3 side = ref_axes[k];
+        float center_proj = dot(side, ref.center);
+        float h = ref.halfExtents[k];
+
+        num_poly = clipPolygonToPlane(src, num_poly, side,
+                                      center_proj + h, dst);
+        std::swap(src, dst);
+
+        num_poly = clipPolygonToPlane(src, num_poly, -side,
+                                      -center_proj + h, dst);
+        std::swap(src, dst);
+    }
+
+    float ref_d = dot(ref_normal, ref.center) + ref.halfExtents[ref_axis];
+
+    for (CountT i = 0; i < num_poly; i++) {
+        Vector3 pt = src[i];
+        float dist = dot(ref_normal, pt) - ref_d;
+        if (dist > max_separation) {
+            continue;
+        }
+
+        if (a_is_ref) {
+            // The incident point is already on b's surface
+            addContactPoint(out, pt, -dist);
+        } else {
+            addContactPoint(out, pt - dist * ref_normal, -dist);
+        }
+    }
+
+    out->normal = a_is_ref ? -ref_normal : ref_normal;
+
+    return out->numPoints > 0;
+}
+
+// hull is a, the capsule is b. hull must already be in world space.
+inline bool hullCapsule(const geo::HalfEdgeMesh &hull,
+                        const CapsuleShape &capsule,
+                        Contact *out)
+{
+    const CountT num_verts = (CountT)hull.numVertices;
+    const CountT num_faces = (CountT)hull.numFaces;
+    const float r = capsule.radius;
+
+    auto supportFn = [&](Vector3 v, Vector3 *a_support_out,
+                         Vector3 *b_support_out) {
+        float max_dot = -FLT_MAX;
+        Vector3 hull_support = hull.vertices[0];
+        for (CountT i = 0; i < num_verts; i++) {
+            float d = dot(hull.vertices[i], v);
+            if (d > max_dot) {
+                max_dot = d;
+                hull_support = hull.vertices[i];
+            }
+        }
+
+        Vector3 seg_support = dot(capsule.p1, v) < dot(capsule.p2, v) ?
+            capsule.p1 : capsule.p2;
+
+        *a_support_out = hull_support;
+        *b_support_out = seg_support;
+
+        return hull_support - seg_support;
+    };
+
+    geo::GJKWithPoints gjk;
+    float dist2 = gjk.computeDistance2(
+        supportFn, capsule.p1 - hull.vertices[0], 1e-10f);
+
+    out->numPoints = 0;
+
+    // Contacts for both ends of the segment against face_idx, clipped to
+    // the face's sides. Normal points out of the capsule, into the face.
+    auto addFaceContacts = [&](CountT face_idx) {
+        geo::Plane plane = hull.facePlanes[face_idx];
+
+        float t0 = 0.f, t1 = 1.f;
+        Vector3 seg_dir = capsule.p2 - capsule.p1;
+
+        uint32_t start_hedge = hull.faceBaseHalfEdges[face_idx];
+        uint32_t cur_hedge = start_hedge;
+        do {
+            const geo::HalfEdge &hedge = hull.halfEdges[cur_hedge];
+            Vector3 v1 = hull.vertices[hedge.rootVertex];
+            Vector3 v2 =
+                hull.vertices[hull.halfEdges[hedge.next].rootVertex];
+
+            // Faces are counter clockwise, so this points out of the face
+            Vector3 side = cross(v2 - v1, plane.normal);
+            float start_dist = dot(side, capsule.p1 - v1);
+            float delta = dot(side, seg_dir);
+
+            if (delta == 0.f) {
+                if (start_dist > 0.f) {
+                    return;
+                }
+            } else {
+                float t = -start_dist / delta;
+                if (delta > 0.f) {
+                    t1 = fminf(t1, t);
+                } else {
+                    t0 = fmaxf(t0, t);
+                }
+            }
+
+            cur_hedge = hedge.next;
+        } while (cur_hedge != start_hedge);
+
+        if (t0 > t1) {
+            return;
+        }
+
+        CountT num_ends = t1 > t0 ? 2 : 1;
+        for (CountT i = 0; i < num_ends; i++) {
+            Vector3 pt = capsule.p1 + (i == 0 ? t0 : t1) * seg_dir;
+            float depth = r - (dot(plane.normal, pt) - plane.d);
+            if (depth >= 0.f) {
+                addContactPoint(out, pt - r * plane.normal, depth);
+            }
+        }
+
+        out->normal = -plane.normal;
+    };
+
+    if (dist2 > 0.f) {
+        if (dist2 > r * r) {
+            return false;
+        }
+
+        Vector3 hull_pt, seg_pt;
+        gjk.getClosestPoints(&hull_pt, &seg_pt);
+
+        float dist = sqrtf(dist2);
+        Vector3 normal = (hull_pt - seg_pt) / dist;
+
+        // A capsule resting on a face gets a contact at both ends
+        CountT aligned_face = -1;
+        float max_align = parallelCos;
+        for (CountT i = 0; i < num_faces; i++) {
+            float align = -dot(hull.facePlanes[i].normal, normal);
+            if (align > max_align) {
+                max_align = align;
+                aligned_face = i;
+            }
+        }
+
+        if (aligned_face != -1) {
+            addFaceContacts(aligned_face);
+            if (out->numPoints > 0) {
+                return true;
+            }
+        }
+
+        out->normal = normal;
+        addContactPoint(out, seg_pt + r * normal, r - dist);
+        return true;
+    }
+
+    // The segment passes through the hull. Push the capsule out through the
+    // face it penetrates least.
+    CountT best_face = 0;
+    float best_sep = -FLT_MAX;
+    for (CountT i = 0; i < num_faces; i++) {
+        geo::Plane plane = hull.facePlanes[i];
+        float sep = fminf(dot(plane.normal, capsule.p1),
+                          dot(plane.normal, capsule.p2)) - r - plane.d;
+        if (sep > best_sep) {
+            best_sep = sep;
+            best_face = i;
+        }
+    }
+
+    geo::Plane plane = hull.facePlanes[best_face];
+    out->normal = -plane.normal;
+    for (Vector3 end : { capsule.p1, capsule.p2 }) {
+        float depth = r - (dot(plane.normal, end) - plane.d);
+        if (depth >= 0.f) {
+            addContactPoint(out, end - r * plane.normal, depth);
+        }
+    }
+
+    return out->numPoints > 0;
+}
+
+constexpr inline int32_t maxContactCandidates = 64;
+
+// Per feature contacts against the triangles of a heightfield or triangle
+// mesh, in its local space. Same convention as Contact, but each with its
+// own normal.
+struct ContactCandidates {
+    Vector3 points[maxContactCandidates];
+    Vector3 normals[maxContactCandidates];
+    float depths[maxContactCandidates];
+    int32_t numCandidates;
+    // Candidates closer than this are the same feature
+    float mergeDist2;
+};
+
+inline void initContactCandidates(float merge_dist,
+                                  ContactCandidates *cands)
+{
+    cands->numCandidates = 0;
+    cands->mergeDist2 = merge_dist * merge_dist;
+}
+
+inline void addContactCandidate(ContactCandidates *cands,
+                                    Vector3 point, Vector3 normal,
+                                    float depth)
+{
+    const int32_t num_cands = cands->numCandidates;
+
+    // Neighboring triangles report the same closest edge or vertex
+    int32_t replace_idx = -1;
+    for (int32_t i = 0; i < num_cands; i++) {
+        if ((cands->points[i] - point).length2() <= cands->mergeDist2) {
+            if (depth <= cands->depths[i]) {
+                return;
+            }
+
+            replace_idx = i;
+            break;
+        }
+    }
+
+    if (replace_idx == -1) {
+        if (num_cands < maxContactCandidates) {
+            replace_idx = cands->numCandidates++;
+        } else {
+            // Full, so keep the deepest
+            float min_depth = depth;
+            for (int32_t i = 0; i < num_cands; i++) {
+                if (cands->depths[i] < min_depth) {
+                    min_depth = cands->depths[i];
+                    replace_idx = i;
+                }
+            }
+
+            if (replace_idx == -1) {
+                return;
+            }
+        }
+    }
+
+    cands->points[replace_idx] = point;
+    cands->normals[replace_idx] = normal;
+    cands->depths[replace_idx] = depth;
+}
+
+// Merges the candidates into a world space contact with at most 4 points.
+// The normal is the depth weighted average of the candidate normals, and
+// each candidate's depth is projected onto it. Candidates facing away from
+// the merged normal come from internal edges and are dropped.
+inline bool finishMergedContact(ContactCandidates &cands,
+                                Vector3 surface_pos, Quat surface_rot,
+                                Contact *out)
+{
+    int32_t num_cands = cands.numCandidates;
+    if (num_cands == 0) {
+        return false;
+    }
+
+    Vector3 normal_sum = Vector3::zero();
+    int32_t deepest_idx = 0;
+    for (int32_t i = 0; i < num_cands; i++) {
+        normal_sum += fmaxf(cands.depths[i], 1e-6f) * cands.normals[i];
+
+        if (cands.depths[i] > cands.depths[deepest_idx]) {
+            deepest_idx = i;
+        }
+    }
+
+    float normal_len = normal_sum.length();
+    Vector3 normal = normal_len > 0.f ?
+        normal_sum / normal_len : cands.normals[deepest_idx];
+
+    int32_t num_projected = 0;
+    for (int32_t i = 0; i < num_cands; i++) {
+        Vector3 cand_normal = cands.normals[i];
+        float align = dot(cand_normal, normal);
+        if (align <= 0.f) {
+            continue;
+        }
+
+        Vector3 deepest_pt = cands.points[i] - cand_normal * cands.depths[i];
+        float depth = cands.depths[i] * align;
+
+        cands.points[num_projected] = deepest_pt + normal * depth;
+        cands.depths[num_projected] = depth;
+        num_projected++;
+    }
+
+    if (num_projected == 0) {
+        return false;
+    }
+
+    // Keep the deepest point, the point farthest from it, the point
+    // farthest from the line through both and then the point farthest from
+    // all three. Points too close to the ones already picked are skipped,
+    // so the result never degenerates. If every point is on one line, the
+    // two ends of it are kept.
+    const Vector3 *pts = cands.points;
+    const float min_dist2 = cands.mergeDist2;
+
+    int32_t picked[4];
+    int32_t num_picked = 0;
+
+    {
+        int32_t a = 0;
+        for (int32_t i = 1; i < num_projected; i++) {
+            if (cands.depths[i] > cands.depths[a]) {
+                a = i;
+            }
+        }
+        picked[num_picked++] = a;
+    }
+
+    {
+        int32_t b = -1;
+        float max_dist2 = min_dist2;
+        for (int32_t i = 0; i < num_projected; i++) {
+            float dist2 = (pts[i] - pts[picked[0]]).length2();
+            if (dist2 > max_dist2) {
+                max_dist2 = dist2;
+                b = i;
+            }
+        }
+
+        if (b != -1) {
+            picked[num_picked++] = b;
+        }
+    }
+
+    if (num_picked == 2) {
+        Vector3 ab = pts[picked[1]] - pts[picked[0]];
+        int32_t c = -1;
+        float max_area2 = min_dist2 * ab.length2();
+        for (int32_t i = 0; i < num_projected; i++) {
+            float area2 = cross(ab, pts[i] - pts[picked[0]]).length2();
+            if (area2 > max_area2) {
+                max_area2 = area2;
+                c = i;
+            }
+        }
+
+        if (c != -1) {
+            picked[num_picked++] = c;
+        } else {
+            // All on a line, so keep both ends of it instead
+            int32_t far_end = picked[0];
+            float max_dist2 = 0.f;
+            for (int32_t i = 0; i < num_projected; i++) {
+                float dist2 = (pts[i] - pts[picked[1]]).length2();
+                if (dist2 > max_dist2) {
+                    max_dist2 = dist2;
+                    far_end = i;
+                }
+            }
+            picked[0] = far_end;
+        }
+    }
+
+    if (num_picked == 3) {
+        int32_t d = -1;
+        float max_dist2 = min_dist2;
+        for (int32_t i = 0; i < num_projected; i++) {
+            float dist2 = FLT_MAX;
+            for (int32_t j = 0; j < 3; j++) {
+                dist2 = fminf(dist2, (pts[i] - pts[picked[j]]).length2());
+            }
+
+            if (dist2 > max_dist2) {
+                max_dist2 = dist2;
+                d = i;
+            }
+        }
+
+        if (d != -1) {
+            picked[num_picked++] = d;
+        }
+    }
+
+    out->normal = surface_rot.rotateVec(normal);
+    out->numPoints = 0;
+    for (int32_t i = 0; i < num_picked; i++) {
+        int32_t idx = picked[i];
+        addContactPoint(out,
+            surface_rot.rotateVec(pts[idx]) + surface_pos,
+                        cands.depths[idx]);
+    }
+
+    return true;
+}
+
+// Heightfield with the object's scale folded into the grid spacing and
+// heights. Routines take its position and rotation separately.
+struct HeightfieldShape {
+    const uint16_t *samples;
+    int32_t numRows;
+    int32_t numCols;
+    float cellSize;
+    float minHeight;
+    float heightScale;
+};
+
+inline HeightfieldShape makeHeightfieldShape(
+    const CollisionPrimitive::Heightfield &hf,
+    Diag3x3 scale)
+{
+    // Cells must stay square
+    assert(scale.d0 == scale.d1);
+
+    return HeightfieldShape {
+        .samples = hf.samples,
+        .numRows = (int32_t)hf.numRows,
+        .numCols = (int32_t)hf.numCols,
+        .cellSize = scale.d0 * hf.cellSize,
+        .minHeight = scale.d2 * hf.minHeight,
+        .heightScale = scale.d2 * hf.heightScale,
+    };
+}
+
+inline float heightfieldHeight(const HeightfieldShape &hf,
+                               int32_t row, int32_t col)
+{
+    return hf.minHeight +
+        hf.heightScale * float(hf.samples[row * hf.numCols + col]);
+}
+
+inline Vector3 heightfieldVertex(const HeightfieldShape &hf,
+                                 int32_t row, int32_t col)
+{
+    return Vector3 {
+        (float(col) - 0.5f * float(hf.numCols - 1)) * hf.cellSize,
+        (float(row) - 0.5f * float(hf.numRows - 1)) * hf.cellSize,
+        heightfieldHeight(hf, row, col),
+    };
+}
+
+// Continuous column (x) or row (y) coordinate of a local space position
+inline float heightfieldGridCoord(float v, float cell_size, int32_t n)
+{
+    return v / cell_size + 0.5f * float(n - 1);
+}
+
+// Inclusive range of cells, indexed by their lower left vertex
+struct HeightfieldCellRange {
+    int32_t rowMin;
+    int32_t rowMax;
+    int32_t colMin;
+    int32_t colMax;
+};
+
+// Cells overlapping the local space box [p_min, p_max] in x and y. Returns
+// false if the box is off the grid.
+inline bool heightfieldCellRange(const HeightfieldShape &hf,
+                                 Vector3 p_min, Vector3 p_max,
+                                 HeightfieldCellRange *out)
+{
+    auto toCell = [&](float v, int32_t n) {
+        float c = floorf(heightfieldGridCoord(v, hf.cellSize, n));
+        // Clamp before the cast so far away boxes can't overflow it
+        return (int32_t)fminf(fmaxf(c, -1.f), float(n));
+    };
+
+    out->colMin = std::max(toCell(p_min.x, hf.numCols), 0);
+    out->colMax = std::min(toCell(p_max.x, hf.numCols), hf.numCols - 2);
+    out->rowMin = std::max(toCell(p_min.y, hf.numRows), 0);
+    out->rowMax = std::min(toCell(p_max.y, hf.numRows), hf.numRows - 2);
+
+    return out->colMin <= out->colMax && out->rowMin <= out->rowMax;
+}
+
+// Calls fn(a, b, c) for the two triangles of the cell, which are counter
+// clockwise seen from above. The first covers the half of the cell below
+// its diagonal from (row, col) to (row + 1, col + 1).
+template <typename Fn>
+inline void heightfieldCellTriangles(const HeightfieldShape &hf,
+                                     int32_t row, int32_t col,
+                                     Fn &&fn)
+{
+    Vector3 v00 = heightfieldVertex(hf, row, col);
+    Vector3 v01 = heightfieldVertex(hf, row, col + 1);
+    Vector3 v11 = heightfieldVertex(hf, row + 1, col + 1);
+    Vector3 v10 = heightfieldVertex(hf, row + 1, col);
+
+    fn(v00, v01, v11);
+    fn(v00, v11, v10);
+}
+
+// Height and normal of the surface at local (x, y). Returns false off the
+// grid.
+inline bool heightfieldSurfaceAt(const HeightfieldShape &hf,
+                                 float x, float y,
+                                 float *height_out,
+                                 Vector3 *normal_out)
+{
+    float fc = heightfieldGridCoord(x, hf.cellSize, hf.numCols);
+    float fr = heightfieldGridCoord(y, hf.cellSize, hf.numRows);
+
+    // Written so NaNs fail too
+    if (!(fc >= 0.f && fc <= float(hf.numCols - 1) &&
+          fr >= 0.f && fr <= float(hf.numRows - 1))) {
+        return false;
+    }
+
+    int32_t col = std::min((int32_t)fc, hf.numCols - 2);
+    int32_t row = std::min((int32_t)fr, hf.numRows - 2);
+    float u = fc - float(col);
+    float v = fr - float(row);
+
+    float h00 = heightfieldHeight(hf, row, col);
+    float h01 = heightfieldHeight(hf, row, col + 1);
+    float h11 = heightfieldHeight(hf, row + 1, col + 1);
+    float h10 = heightfieldHeight(hf, row + 1, col);
+
+    float du, dv;
+    if (u >= v) {
+        du = h01 - h00;
+        dv = h11 - h01;
+    } else {
+        du = h11 - h10;
+        dv = h10 - h00;
+    }
+
+    *height_out = h00 + u * du + v * dv;
+    *normal_out = Vector3 {
+        -du / hf.cellSize,
+        -dv / hf.cellSize,
+        1.f,
+    }.normalize();
+
+    return true;
+}
+
+// Smoothed normal at a grid vertex, from central differences
+inline Vector3 heightfieldVertexNormal(const HeightfieldShape &hf,
+                                       int32_t row, int32_t col)
+{
+    int32_t col_lo = std::max(col - 1, 0);
+    int32_t col_hi = std::min(col + 1, hf.numCols - 1);
+    int32_t row_lo = std::max(row - 1, 0);
+    int32_t row_hi = std::min(row + 1, hf.numRows - 1);
+
+    float dx = (heightfieldHeight(hf, row, col_hi) -
+        heightfieldHeight(hf, row, col_lo)) /
+        (float(col_hi - col_lo) * hf.cellSize);
+    float dy = (heightfieldHeight(hf, row_hi, col) -
+        heightfieldHeight(hf, row_lo, col)) /
+        (float(row_hi - row_lo) * hf.cellSize);
+
+    return Vector3 { -dx, -dy, 1.f }.normalize();
+}
+
+inline Vector3 closestPointOnTriangle(Vector3 p,
+                                      Vector3 a, Vector3 b, Vector3 c)
+{
+    return p + geo::triangleClosestPointToOrigin(
+        a - p, b - p, c - p, b - a, c - a);
+}
+
+// Whether surface_pt, dist2 away from p, is locally the closest point on
+// the surface to p. Closest points on the edges and corners of one triangle
+// often aren't, because a neighboring triangle is closer. Those are the
+// contacts that snag objects on internal edges.
+inline bool heightfieldIsLocalClosestPoint(const HeightfieldShape &hf,
+                                           Vector3 p,
+                                           Vector3 surface_pt,
+                                           float dist2)
+{
+    float eps = 1e-3f * hf.cellSize;
+    Vector3 extent { eps, eps, 0 };
+
+    HeightfieldCellRange range;
+    if (!heightfieldCellRange(hf, surface_pt - extent, surface_pt + extent,
+                              &range)) {
+        return true;
+    }
+
+    float closer_dist2 = dist2 * (1.f - 1e-4f) - eps * eps;
+
+    bool closest = true;
+    for (int32_t row = range.rowMin; row <= range.rowMax; row++) {
+        for (int32_t col = range.colMin; col <= range.colMax; col++) {
+            heightfieldCellTriangles(hf, row, col,
+                    [&](Vector3 a, Vector3 b, Vector3 c) {
+                Vector3 pt = closestPointOnTriangle(p, a, b, c);
+                if ((p - pt).length2() < closer_dist2) {
+                    closest = false;
+                }
+            });
+        }
+    }
+
+    return closest;
+}
+
+// Adds candidates for a sphere at local position center
+inline void addSphereHeightfieldCandidates(const HeightfieldShape &hf,
+                                           Vector3 center, float radius,
+                                           ContactCandidates *cands)
+{
+    float surface_height;
+    Vector3 surface_normal;
+    if (heightfieldSurfaceAt(hf, center.x, center.y,
+                             &surface_height, &surface_normal) &&
+            center.z < surface_height) {
+        // Center is under the surface, push it back out along the normal
+        // of the triangle above it
+        float depth = (surface_height - center.z) * surface_normal.z + radius;
+        Vector3 deepest_pt = center - surface_normal * radius;
+        addContactCandidate(cands, deepest_pt + surface_normal * depth,
+                                surface_normal, depth);
+        return;
+    }
+
+    Vector3 extent { radius, radius, radius };
+    HeightfieldCellRange range;
+    if (!heightfieldCellRange(hf, center - extent, center + extent, &range)) {
+        return;
+    }
+
+    for (int32_t row = range.rowMin; row <= range.rowMax; row++) {
+        for (int32_t col = range.colMin; col <= range.colMax; col++) {
+            heightfieldCellTriangles(hf, row, col,
+                    [&](Vector3 a, Vector3 b, Vector3 c) {
+                Vector3 closest = closestPointOnTriangle(center, a, b, c);
+
+                Vector3 to_center = center - closest;
+                float dist2 = to_center.length2();
+                if (dist2 > radius * radius ||
+                        !heightfieldIsLocalClosestPoint(
+                            hf, center, closest, dist2)) {
+                    return;
+                }
+
+                float dist = sqrtf(dist2);
+                Vector3 normal = dist > 0.f ?
+                    to_center / dist : cross(b - a, c - a).normalize();
+
+                addContactCandidate(cands, closest, normal,
+                                        radius - dist);
+            });
+        }
+    }
+}
+
+inline bool sphereHeightfield(Vector3 sphere_center, float sphere_radius,
+                              const HeightfieldShape &hf,
+                              Vector3 hf_pos, Quat hf_rot,
+                              Contact *out)
+{
+    Vector3 center = hf_rot.inv().rotateVec(sphere_center - hf_pos);
+
+    ContactCandidates cands;
+    initContactCandidates(1e-3f * hf.cellSize, &cands);
+
+    addSphereHeightfieldCandidates(hf, center, sphere_radius, &cands);
+
+    return finishMergedContact(cands, hf_pos, hf_rot, out);
+}
+
+// The ends of the capsule are handled as spheres, plus the closest points
+// between its segment and the triangle edges underneath it
+inline bool capsuleHeightfield(const CapsuleShape &capsule,
+                               const HeightfieldShape &hf,
+                               Vector3 hf_pos, Quat hf_rot,
+                               Contact *out)
+{
+    Quat to_local = hf_rot.inv();
+    Vector3 p1 = to_local.rotateVec(capsule.p1 - hf_pos);
+    Vector3 p2 = to_local.rotateVec(capsule.p2 - hf_pos);
+    const float r = capsule.radius;
+
+    ContactCandidates cands;
+    initContactCandidates(1e-3f * hf.cellSize, &cands);
+
+    addSphereHeightfieldCandidates(hf, p1, r, &cands);
+    addSphereHeightfieldCandidates(hf, p2, r, &cands);
+
+    Vector3 extent { r, r, r };
+    Vector3 seg_min {
+        fminf(p1.x, p2.x), fminf(p1.y, p2.y), fminf(p1.z, p2.z) };
+    Vector3 seg_max {
+        fmaxf(p1.x, p2.x), fmaxf(p1.y, p2.y), fmaxf(p1.z, p2.z) };
+
+    HeightfieldCellRange range;
+    if (heightfieldCellRange(hf, seg_min - extent, seg_max + extent, &range)) {
+        auto edgeCandidate = [&](Vector3 e1, Vector3 e2) {
+            float s, t;
+            closestPointsBetweenSegments(p1, p2, e1, e2, &s, &t);
+
+            // Segment ends were already handled as spheres
+            if (s <= 0.f || s >= 1.f) {
+                return;
+            }
+
+            Vector3 seg_pt = p1 + s * (p2 - p1);
+            Vector3 edge_pt = e1 + t * (e2 - e1);
+
+            float surface_height;
+            Vector3 surface_normal;
+            if (heightfieldSurfaceAt(hf, seg_pt.x, seg_pt.y,
+                                     &surface_height, &surface_normal) &&
+                    seg_pt.z < surface_height) {
+                float depth =
+                    (surface_height - seg_pt.z) * surface_normal.z + r;
+                Vector3 deepest_pt = seg_pt - surface_normal * r;
+                addContactCandidate(&cands,
+                    deepest_pt + surface_normal * depth,
+                    surface_normal, depth);
+                return;
+            }
+
+            Vector3 to_seg = seg_pt - edge_pt;
+            float dist2 = to_seg.length2();
+            if (dist2 > r * r || dist2 == 0.f ||
+                    !heightfieldIsLocalClosestPoint(
+                        hf, seg_pt, edge_pt, dist2)) {
+                return;
+            }
+
+            float dist = sqrtf(dist2);
+            addContactCandidate(&cands, edge_pt, to_seg / dist, r - dist);
+        };
+
+        for (int32_t row = range.rowMin; row <= range.rowMax; row++) {
+            for (int32_t col = range.colMin; col <= range.colMax; col++) {
+                // Each cell contributes its lower and left edges plus the
+                // diagonal. The upper and right edges of the range close
+                // it off.
+                Vector3 v00 = heightfieldVertex(hf, row, col);
+                Vector3 v01 = heightfieldVertex(hf, row, col + 1);
+                Vector3 v11 = heightfieldVertex(hf, row + 1, col + 1);
+                Vector3 v10 = heightfieldVertex(hf, row + 1, col);
+
+                edgeCandidate(v00, v01);
+                edgeCandidate(v00, v10);
+                edgeCandidate(v00, v11);
+
+                if (row == range.rowMax) {
+                    edgeCandidate(v10, v11);
+                }
+
+                if (col == range.colMax) {
+                    edgeCandidate(v01, v11);
+                }
+            }
+        }
+    }
+
+    return finishMergedContact(cands, hf_pos, hf_rot, out);
+}
+
+// hull is a, in world space. Hull vertices under the surface and grid
+// vertices inside the hull give contacts. Grid vertices push the hull out
+// through the faces that look down into the terrain, so a hull resting on
+// it is never pushed sideways. Edge vs edge crossings with neither are
+// missed, which only matters for hulls much smaller than a cell.
+inline bool hullHeightfield(const geo::HalfEdgeMesh &hull,
+                            const HeightfieldShape &hf,
+                            Vector3 hf_pos, Quat hf_rot,
+                            Contact *out)
+{
+    Quat to_local = hf_rot.inv();
+    const CountT num_verts = (CountT)hull.numVertices;
+    const CountT num_faces = (CountT)hull.numFaces;
+
+    ContactCandidates cands;
+    initContactCandidates(1e-3f * hf.cellSize, &cands);
+
+    Vector3 local_min { FLT_MAX, FLT_MAX, FLT_MAX };
+    Vector3 local_max { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (CountT i = 0; i < num_verts; i++) {
+        Vector3 v = to_local.rotateVec(hull.vertices[i] - hf_pos);
+        local_min = Vector3::min(local_min, v);
+        local_max = Vector3::max(local_max, v);
+
+        float surface_height;
+        Vector3 surface_normal;
+        if (!heightfieldSurfaceAt(hf, v.x, v.y,
+                                  &surface_height, &surface_normal) ||
+                v.z >= surface_height) {
+            continue;
+        }
+
+        float depth = (surface_height - v.z) * surface_normal.z;
+        addContactCandidate(&cands, v + surface_normal * depth,
+                                surface_normal, depth);
+    }
+
+    HeightfieldCellRange range;
+    if (heightfieldCellRange(hf, local_min, local_max, &range)) {
+        for (int32_t row = range.rowMin; row <= range.rowMax + 1; row++) {
+            for (int32_t col = range.colMin; col <= range.colMax + 1; col++) {
+                Vector3 grid_pt = heightfieldVertex(hf, row, col);
+                if (grid_pt.z < local_min.z || grid_pt.z > local_max.z) {
+                    continue;
+                }
+
+                Vector3 world_pt = hf_rot.rotateVec(grid_pt) + hf_pos;
+                Vector3 world_vert_normal = hf_rot.rotateVec(
+                    heightfieldVertexNormal(hf, row, col));
+
+                float max_sep = -FLT_MAX;
+                float max_terrain_sep = -FLT_MAX;
+                CountT max_face = -1;
+                for (CountT i = 0; i < num_faces; i++) {
+                    geo::Plane plane = hull.facePlanes[i];
+                    float sep = dot(plane.normal, world_pt) - plane.d;
+                    max_sep = fmaxf(max_sep, sep);
+
+                    if (dot(plane.normal, world_vert_normal) < 0.f &&
+                            sep > max_terrain_sep) {
+                        max_terrain_sep = sep;
+                        max_face = i;
+                    }
+                }
+
+                if (max_sep >= 0.f || max_face == -1) {
+                    continue;
+                }
+
+                Vector3 normal =
+                    -to_local.rotateVec(hull.facePlanes[max_face].normal);
+                addContactCandidate(&cands, grid_pt, normal,
+                                        -max_terrain_sep);
+            }
+        }
+    }
+
+    return finishMergedContact(cands, hf_pos, hf_rot, out);
+}
+
+// Triangle mesh with the object's scale applied to its vertices as they're
+// fetched. Routines take its position and rotation separately.
+struct TriangleMeshShape {
+    const MeshBVH *bvh;
+    Diag3x3 scale;
+};
+
+inline TriangleMeshShape makeTriangleMeshShape(
+    const CollisionPrimitive::TriangleMesh &mesh, Diag3x3 scale)
+{
+    return TriangleMeshShape {
+        .bvh = &mesh.bvh,
+        .scale = scale,
+    };
+}
+
+// Calls fn(a, b, c) for the triangles whose bounds overlap the local space
+// box
+template <typename Fn>
+inline void triangleMeshOverlaps(const TriangleMeshShape &mesh,
+                                 Vector3 p_min, Vector3 p_max,
+                                 Fn &&fn)
+{
+    Diag3x3 inv_scale = mesh.scale.inv();
+    AABB query {
+        .pMin = inv_scale * p_min,
+        .pMax = inv_scale * p_max,
+    };
+
+    mesh.bvh->findOverlaps(query, [&](Vector3 a, Vector3 b, Vector3 c) {
+        fn(mesh.scale * a, mesh.scale * b, mesh.scale * c);
+    });
+}
+
+// Unit normal of the side the triangle is counter clockwise from. Returns
+// false for degenerate triangles.
+inline bool triangleFrontNormal(Vector3 a, Vector3 b, Vector3 c,
+                                Vector3 *normal_out)
+{
+    Vector3 n = cross(b - a, c - a);
+    float len = n.length();
+    if (len == 0.f) {
+        return false;
+    }
+
+    *normal_out = n / len;
+    return true;
+}
+
+// Mesh version of heightfieldIsLocalClosestPoint. Only triangles facing p
+// count, since the back of a triangle can't be touched.
+inline bool triangleMeshIsLocalClosestPoint(const TriangleMeshShape &mesh,
+                                            Vector3 p,
+                                            Vector3 surface_pt,
+                                            float dist2,
+                                            float eps)
+{
+    Vector3 extent { eps, eps, eps };
+    float closer_dist2 = dist2 * (1.f - 1e-4f) - eps * eps;
+
+    bool closest = true;
+    triangleMeshOverlaps(mesh, surface_pt - extent, surface_pt + extent,
+            [&](Vector3 a, Vector3 b, Vector3 c) {
+        Vector3 n;
+        if (!triangleFrontNormal(a, b, c, &n) || dot(p - a, n) < 0.f) {
+            return;
+        }
+
+        Vector3 pt = closestPointOnTriangle(p, a, b, c);
+        if ((p - pt).length2() < closer_dist2) {
+            closest = false;
+        }
+    });
+
+    return closest;
+}
+
+// Adds candidates for a sphere at local position center. Spheres whose
+// center has passed behind a triangle are pushed back out through its
+// face, but only if they're over it, so a neighboring triangle's back
+// doesn't pull them through.
+inline void addSphereTriangleMeshCandidates(const TriangleMeshShape &mesh,
+                                            Vector3 center, float radius,
+                                            ContactCandidates *cands)
+{
+    Vector3 extent { radius, radius, radius };
+    float eps = 1e-3f * radius;
+
+    triangleMeshOverlaps(mesh, center - extent, center + extent,
+            [&](Vector3 a, Vector3 b, Vector3 c) {
+        Vector3 n;
+        if (!triangleFrontNormal(a, b, c, &n)) {
+            return;
+        }
+
+        float plane_dist = dot(center - a, n);
+        if (plane_dist > radius || plane_dist < -radius) {
+            return;
+        }
+
+        Vector3 closest = closestPointOnTriangle(center, a, b, c);
+        Vector3 projected = center - plane_dist * n;
+        if ((closest - projected).length2() <= eps * eps) {
+            addContactCandidate(cands, closest, n, radius - plane_dist);
+            return;
+        }
+
+        if (plane_dist <= 0.f) {
+            return;
+        }
+
+        Vector3 to_center = center - closest;
+        float dist2 = to_center.length2();
+        if (dist2 > radius * radius ||
+                !triangleMeshIsLocalClosestPoint(
+                    mesh, center, closest, dist2, eps)) {
+            return;
+        }
+
+        float dist = sqrtf(dist2);
+        addContactCandidate(cands, closest, to_center / dist,
+                            radius - dist);
+    });
+}
+
+inline bool sphereTriangleMesh(Vector3 sphere_center, float sphere_radius,
+                               const TriangleMeshShape &mesh,
+                               Vector3 mesh_pos, Quat mesh_rot,
+                               Contact *out)
+{
+    Vector3 center = mesh_rot.inv().rotateVec(sphere_center - mesh_pos);
+
+    ContactCandidates cands;
+    initContactCandidates(1e-3f * sphere_radius, &cands);
+
+    addSphereTriangleMeshCandidates(mesh, center, sphere_radius, &cands);
+
+    return finishMergedContact(cands, mesh_pos, mesh_rot, out);
+}
+
+// Same approach as capsuleHeightfield
+inline bool capsuleTriangleMesh(const CapsuleShape &capsule,
+                                const TriangleMeshShape &mesh,
+                                Vector3 mesh_pos, Quat mesh_rot,
+                                Contact *out)
+{
+    Quat to_local = mesh_rot.inv();
+    Vector3 p1 = to_local.rotateVec(capsule.p1 - mesh_pos);
+    Vector3 p2 = to_local.rotateVec(capsule.p2 - mesh_pos);
+    const float r = capsule.radius;
+    const float eps = 1e-3f * r;
+
+    ContactCandidates cands;
+    initContactCandidates(eps, &cands);
+
+    addSphereTriangleMeshCandidates(mesh, p1, r, &cands);
+    addSphereTriangleMeshCandidates(mesh, p2, r, &cands);
+
+    Vector3 extent { r, r, r };
+    Vector3 seg_min {
+        fminf(p1.x, p2.x), fminf(p1.y, p2.y), fminf(p1.z, p2.z) };
+    Vector3 seg_max {
+        fmaxf(p1.x, p2.x), fmaxf(p1.y, p2.y), fmaxf(p1.z, p2.z) };
+
+    triangleMeshOverlaps(mesh, seg_min - extent, seg_max + extent,
+            [&](Vector3 a, Vector3 b, Vector3 c) {
+        Vector3 n;
+        if (!triangleFrontNormal(a, b, c, &n)) {
+            return;
+        }
+
+        auto edgeCandidate = [&](Vector3 e1, Vector3 e2) {
+            float s, t;
+            closestPointsBetweenSegments(p1, p2, e1, e2, &s, &t);
+
+            // Segment ends were already handled as spheres
+            if (s <= 0.f || s >= 1.f) {
+                return;
+            }
+
+            Vector3 seg_pt = p1 + s * (p2 - p1);
+            Vector3 edge_pt = e1 + t * (e2 - e1);
+
+            Vector3 to_seg = seg_pt - edge_pt;
+            float dist2 = to_seg.length2();
+            if (dist2 > r * r || dot(to_seg, n) <= 0.f ||
+                    !triangleMeshIsLocalClosestPoint(
+                        mesh, seg_pt, edge_pt, dist2, eps)) {
+                return;
+            }
+
+            float dist = sqrtf(dist2);
+            addContactCandidate(&cands, edge_pt, to_seg / dist, r - dist);
+        };
+
+        edgeCandidate(a, b);
+        edgeCandidate(b, c);
+        edgeCandidate(c, a);
+    });
+
+    return finishMergedContact(cands, mesh_pos, mesh_rot, out);
+}
+
+// hull is a, in world space. Only triangles whose plane cuts through the
+// hull are considered. Hull vertices behind such a triangle and over it
+// get a contact along its normal, and triangle vertices inside the hull are
+// pushed out through the hull faces that look into the triangle. As with
+// heightfields, edge vs edge crossings with neither are missed.
+inline bool hullTriangleMesh(const geo::HalfEdgeMesh &hull,
+                             const TriangleMeshShape &mesh,
+                             Vector3 mesh_pos, Quat mesh_rot,
+                             Contact *out)
+{
+    Quat to_local = mesh_rot.inv();
+    const CountT num_verts = (CountT)hull.numVertices;
+    const CountT num_faces = (CountT)hull.numFaces;
+
+    auto localVertex = [&](CountT i) {
+        return to_local.rotateVec(hull.vertices[i] - mesh_pos);
+    };
+
+    Vector3 local_min { FLT_MAX, FLT_MAX, FLT_MAX };
+    Vector3 local_max { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (CountT i = 0; i < num_verts; i++) {
+        Vector3 v = localVertex(i);
+        local_min = Vector3::min(local_min, v);
+        local_max = Vector3::max(local_max, v);
+    }
+
+    ContactCandidates cands;
+    initContactCandidates(1e-3f * (local_max - local_min).length(), &cands);
+
+    triangleMeshOverlaps(mesh, local_min, local_max,
+            [&](Vector3 a, Vector3 b, Vector3 c) {
+        Vector3 n;
+        if (!triangleFrontNormal(a, b, c, &n)) {
+            return;
+        }
+
+        float min_dist = FLT_MAX;
+        float max_dist = -FLT_MAX;
+        for (CountT i = 0; i < num_verts; i++) {
+            float dist = dot(localVertex(i) - a, n);
+            min_dist = fminf(min_dist, dist);
+            max_dist = fmaxf(max_dist, dist);
+        }
+
+        if (min_dist >= 0.f || max_dist <= 0.f) {
+            return;
+        }
+
+        Vector3 tri_verts[3] = { a, b, c };
+
+        for (CountT i = 0; i < num_verts; i++) {
+            Vector3 v = localVertex(i);
+            float dist = dot(v - a, n);
+            if (dist >= 0.f) {
+                continue;
+            }
+
+            bool over_tri = true;
+            for (CountT j = 0; j < 3; j++) {
+                Vector3 e1 = tri_verts[j];
+                Vector3 e2 = tri_verts[(j + 1) % 3];
+                if (dot(cross(e2 - e1, v - e1), n) < 0.f) {
+                    over_tri = false;
+                    break;
+                }
+            }
+
+            if (over_tri) {
+                addContactCandidate(&cands, v - dist * n, n, -dist);
+            }
+        }
+
+        Vector3 world_n = mesh_rot.rotateVec(n);
+        for (Vector3 tri_vert : tri_verts) {
+            Vector3 world_pt = mesh_rot.rotateVec(tri_vert) + mesh_pos;
+
+            float max_sep = -FLT_MAX;
+            float max_facing_sep = -FLT_MAX;
+            CountT max_face = -1;
+            for (CountT i = 0; i < num_faces; i++) {
+                geo::Plane plane = hull.facePlanes[i];
+                float sep = dot(plane.normal, world_pt) - plane.d;
+                max_sep = fmaxf(max_sep, sep);
+
+                if (dot(plane.normal, world_n) < 0.f &&
+                        sep > max_facing_sep) {
+                    max_facing_sep = sep;
+                    max_face = i;
+                }
+            }
+
+            if (max_sep >= 0.f || max_face == -1) {
+                continue;
+            }
+
+            Vector3 normal =
+                -to_local.rotateVec(hull.facePlanes[max_face].normal);
+            addContactCandidate(&cands, tri_vert, normal, -max_facing_sep);
+        }
+    });
+
+    return finishMergedContact(cands, mesh_pos, mesh_rot, out);
+}
+
+// Möller-Trumbore, hitting either side of the triangle
+inline bool traceRayIntoTriangle(Vector3 ray_o, Vector3 ray_d,
+                                 Vector3 a, Vector3 b, Vector3 c,
+                                 float *t_out)
+{
+    Vector3 e1 = b - a;
+    Vector3 e2 = c - a;
+
+    Vector3 p = cross(ray_d, e2);
+    float det = dot(e1, p);
+    if (det == 0.f) {
+        return false;
+    }
+
+    float inv_det = 1.f / det;
+    Vector3 s = ray_o - a;
+
+    float u = dot(s, p) * inv_det;
+    if (u < 0.f || u > 1.f) {
+        return false;
+    }
+
+    Vector3 q = cross(s, e1);
+    float v = dot(ray_d, q) * inv_det;
+    if (v < 0.f || u + v > 1.f) {
+        return false;
+    }
+
+    *t_out = dot(e2, q) * inv_det;
+    return true;
+}
+
+// ray_o and ray_d are in the space of the heightfield. Walks the cells
+// under the ray in order with a 2D DDA, so the first cell with a hit has
+// the closest one. The normal is the triangle's upward facing normal.
+inline bool traceRayIntoHeightfield(const HeightfieldShape &hf,
+                                    Vector3 ray_o, Vector3 ray_d,
+                                    float t_min, float t_max,
+                                    float *hit_t,
+                                    Vector3 *hit_normal)
+{
+    const float half_extents[2] = {
+        0.5f * float(hf.numCols - 1) * hf.cellSize,
+        0.5f * float(hf.numRows - 1) * hf.cellSize,
+    };
+
+    // Clip the ray to the grid's footprint
+    float t_enter = t_min;
+    float t_exit = t_max;
+    for (CountT i = 0; i < 2; i++) {
+        float h = half_extents[i];
+        if (ray_d[i] == 0.f) {
+            if (ray_o[i] < -h || ray_o[i] > h) {
+                return false;
+            }
+            continue;
+        }
+
+        float inv_d = 1.f / ray_d[i];
+        float t_near = (-h - ray_o[i]) * inv_d;
+        float t_far = (h - ray_o[i]) * inv_d;
+        if (t_near > t_far) {
+            std::swap(t_near, t_far);
+        }
+
+        t_enter = fmaxf(t_enter, t_near);
+        t_exit = fminf(t_exit, t_far);
+    }
+
+    if (t_enter > t_exit) {
+        return false;
+    }
+
+    Vector3 start = ray_o + t_enter * ray_d;
+
+    int32_t cell[2];
+    int32_t step[2];
+    float t_next[2];
+    float t_delta[2];
+    const int32_t num_verts[2] = { hf.numCols, hf.numRows };
+    for (CountT i = 0; i < 2; i++) {
+        float coord = heightfieldGridCoord(
+            start[i], hf.cellSize, num_verts[i]);
+        cell[i] = std::clamp((int32_t)floorf(coord), 0, num_verts[i] - 2);
+
+        if (ray_d[i] == 0.f) {
+            step[i] = 0;
+            t_next[i] = FLT_MAX;
+            t_delta[i] = FLT_MAX;
+            continue;
+        }
+
+        step[i] = ray_d[i] > 0.f ? 1 : -1;
+
+        int32_t boundary = ray_d[i] > 0.f ? cell[i] + 1 : cell[i];
+        float boundary_pos = (float(boundary) -
+            0.5f * float(num_verts[i] - 1)) * hf.cellSize;
+
+        t_next[i] = (boundary_pos - ray_o[i]) / ray_d[i];
+        t_delta[i] = hf.cellSize / fabsf(ray_d[i]);
+    }
+
+    while (true) {
+        float closest_t = FLT_MAX;
+        Vector3 closest_normal;
+        heightfieldCellTriangles(hf, cell[1], cell[0],
+                [&](Vector3 a, Vector3 b, Vector3 c) {
+            float t;
+            if (traceRayIntoTriangle(ray_o, ray_d, a, b, c, &t) &&
+                    t >= t_min && t <= t_max && t < closest_t) {
+                closest_t = t;
+                closest_normal = cross(b - a, c - a);
+            }
+        });
+
+        if (closest_t != FLT_MAX) {
+            *hit_t = closest_t;
+            *hit_normal = closest_normal.normalize();
+            return true;
+        }
+
+        CountT axis = t_next[0] < t_next[1] ? 0 : 1;
+        if (t_next[axis] > t_exit) {
+            return false;
+        }
+
+        cell[axis] += step[axis];
+        if (cell[axis] < 0 || cell[axis] > num_verts[axis] - 2) {
+            return false;
+        }
+
+        t_next[axis] += t_delta[axis];
+    }
+}
+
+}
@@ -0,0 +1,346 @@
+#pragma once
+
+#include <madrona/geo.hpp>
+
+#include <cfloat>
+#include <immintrin.h>
+
+namespace madrona::phys::avx2 {
+
+/*
+AVX2 versions of the hull vs hull SAT queries. This is intended to be a
+private implementation file for narrowphase.cpp, but factored out into a
+header so the kernels can be unit tested against the scalar versions.
+
+The GPU narrowphase spreads support point and edge pair evaluations across
+the lanes of a warp. These kernels do the same across the 8 lanes of an AVX2
+register, using structure of arrays copies of the transformed hull data
+built once per hull pair.
+*/
+
+constexpr inline int32_t numLanes = 8;
+
+// Hulls with more vertices or edges than this take the scalar path
+constexpr inline int32_t maxHullVertices = 256;
+constexpr inline int32_t maxHullEdges = 256;
+
+// The tail is padded to a multiple of 8 with copies of the first vertex, so
+// min reductions can run over whole registers without masking.
+struct alignas(32) HullVertices {
+    float x[maxHullVertices];
+    float y[maxHullVertices];
+    float z[maxHullVertices];
+    int32_t numVertices;
+};
+
+// Per edge data for the hull whose edges are tested 8 at a time. The adjacent
+// face normals are stored negated, which is how the second hull's normals
+// enter the Minkowski face test.
+struct alignas(32) HullEdges {
+    float originX[maxHullEdges];
+    float originY[maxHullEdges];
+    float originZ[maxHullEdges];
+    float dirX[maxHullEdges];
+    float dirY[maxHullEdges];
+    float dirZ[maxHullEdges];
+    float negNormal1X[maxHullEdges];
+    float negNormal1Y[maxHullEdges];
+    float negNormal1Z[maxHullEdges];
+    float negNormal2X[maxHullEdges];
+    float negNormal2Y[maxHullEdges];
+    float negNormal2Z[maxHullEdges];
+    int32_t numEdges;
+};
+
+struct EdgeQueryResult {
+    float separation;
+    math::Vector3 normal;
+    // Half edge indices, matching the scalar edge query
+    int32_t hedgeIdxA;
+    int32_t hedgeIdxB;
+};
+
+inline bool canBuildHullVertices(const geo::HalfEdgeMesh &mesh)
+{
+    return mesh.numVertices > 0 &&
+        (int32_t)mesh.numVertices <= maxHullVertices;
+}
+
+inline bool canBuildHullEdges(const geo::HalfEdgeMesh &mesh)
+{
+    return (int32_t)mesh.numEdges() <= maxHullEdges;
+}
+
+inline void buildHullVertices(const geo::HalfEdgeMesh &mesh,
+                              HullVertices *out)
+{
+    const int32_t num_verts = (int32_t)mesh.numVertices;
+    for (int32_t i = 0; i < num_verts; i++) {
+        math::Vector3 v = mesh.vertices[i];
+        out->x[i] = v.x;
+        out->y[i] = v.y;
+        out->z[i] = v.z;
+    }
+
+    const int32_t num_padded = (num_verts + numLanes - 1) & ~(numLanes - 1);
+    for (int32_t i = num_verts; i < num_padded; i++) {
+        out->x[i] = out->x[0];
+        out->y[i] = out->y[0];
+        out->z[i] = out->z[0];
+    }
+
+    out->numVertices = num_verts;
+}
+
+inline void buildHullEdges(const geo::HalfEdgeMesh &mesh, HullEdges *out)
+{
+    const int32_t num_edges = (int32_t)mesh.numEdges();
+    for (int32_t i = 0; i < num_edges; i++) {
+        uint32_t hedge_idx = mesh.edgeToHalfEdge(i);
+        geo::HalfEdge cur = mesh.halfEdges[hedge_idx];
+        geo::HalfEdge twin = mesh.halfEdges[mesh.twinIDX(hedge_idx)];
+
+        math::Vector3 p1 = mesh.vertices[cur.rootVertex];
+        math::Vector3 p2 = mesh.vertices[mesh.halfEdges[cur.next].rootVertex];
+        math::Vector3 dir = p2 - p1;
+
+        math::Vector3 n1 = mesh.facePlanes[cur.face].normal;
+        math::Vector3 n2 = mesh.facePlanes[twin.face].normal;
+
+        out->originX[i] = p1.x;
+        out->originY[i] = p1.y;
+        out->originZ[i] = p1.z;
+        out->dirX[i] = dir.x;
+        out->dirY[i] = dir.y;
+        out->dirZ[i] = dir.z;
+        out->negNormal1X[i] = -n1.x;
+        out->negNormal1Y[i] = -n1.y;
+        out->negNormal1Z[i] = -n1.z;
+        out->negNormal2X[i] = -n2.x;
+        out->negNormal2Y[i] = -n2.y;
+        out->negNormal2Z[i] = -n2.z;
+    }
+
+    out->numEdges = num_edges;
+}
+
+MADRONA_ALWAYS_INLINE inline float hmin(__m256 v)
+{
+    __m128 m = _mm_min_ps(_mm256_castps256_ps128(v),
+                          _mm256_extractf128_ps(v, 1));
+    m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_min_ss(m, _mm_movehdup_ps(m));
+
+    return _mm_cvtss_f32(m);
+}
+
+MADRONA_ALWAYS_INLINE inline __m256 dot3(__m256 ax, __m256 ay, __m256 az,
+                                         __m256 bx, __m256 by, __m256 bz)
+{
+    return _mm256_fmadd_ps(ax, bx,
+        _mm256_fmadd_ps(ay, by, _mm256_mul_ps(az, bz)));
+}
+
+// min over all vertices of dot(v, n), the support point of the hull in
+// direction -n
+inline float hullMinDot(const HullVertices &verts, math::Vector3 n)
+{
+    const __m256 nx = _mm256_set1_ps(n.x);
+    const __m256 ny = _mm256_set1_ps(n.y);
+    const __m256 nz = _mm256_set1_ps(n.z);
+
+    __m256 min_dot = _mm256_set1_ps(FLT_MAX);
+
+    const int32_t num_verts = verts.numVertices;
+    for (int32_t i = 0; i < num_verts; i += numLanes) {
+        __m256 d = dot3(_mm256_load_ps(verts.x + i),
+                        _mm256_load_ps(verts.y + i),
+                        _mm256_load_ps(verts.z + i),
+                        nx, ny, nz);
+
+        min_dot = _mm256_min_ps(min_dot, d);
+    }
+
+    return hmin(min_dot);
+}
+
+// Tests every edge of a against every edge of b, 8 edges of b at a time.
+// Returns as soon as a batch finds a separating axis, otherwise the maximum
+// separation, with ties going to the pair the scalar loop would reach first.
+inline EdgeQueryResult queryEdgeDirections(const geo::HalfEdgeMesh &a_mesh,
+                                           math::Vector3 a_center,
+                                           const HullEdges &b_edges)
+{
+    const int32_t a_num_edges = (int32_t)a_mesh.numEdges();
+    const int32_t b_num_edges = b_edges.numEdges;
+
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 neg_flt_max = _mm256_set1_ps(-FLT_MAX);
+    const __m256i lane_offsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    __m256 best_sep = neg_flt_max;
+    __m256 best_nx = zero;
+    __m256 best_ny = zero;
+    __m256 best_nz = zero;
+    __m256i best_a = _mm256_setzero_si256();
+    __m256i best_b = _mm256_setzero_si256();
+
+    bool found_separating = false;
+    for (int32_t edge_idx_a = 0;
+         edge_idx_a < a_num_edges && !found_separating; edge_idx_a++) {
+        uint32_t hedge_idx_a = a_mesh.edgeToHalfEdge(edge_idx_a);
+        geo::HalfEdge cur_a = a_mesh.halfEdges[hedge_idx_a];
+        geo::HalfEdge twin_a = a_mesh.halfEdges[a_mesh.twinIDX(hedge_idx_a)];
+
+        math::Vector3 a_p1 = a_mesh.vertices[cur_a.rootVertex];
+        math::Vector3 a_dir =
+            a_mesh.vertices[a_mesh.halfEdges[cur_a.next].rootVertex] - a_p1;
+        math::Vector3 a_n1 = a_mesh.facePlanes[cur_a.face].normal;
+        math::Vector3 a_n2 = a_mesh.facePlanes[twin_a.face].normal;
+        math::Vector3 a_bxa = cross(a_n2, a_n1);
+        math::Vector3 a_to_edge = a_p1 - a_center;
+
+        const __m256 n1x = _mm256_set1_ps(a_n1.x);
+        const __m256 n1y = _mm256_set1_ps(a_n1.y);
+        const __m256 n1z = _mm256_set1_ps(a_n1.z);
+        const __m256 n2x = _mm256_set1_ps(a_n2.x);
+        const __m256 n2y = _mm256_set1_ps(a_n2.y);
+        const __m256 n2z = _mm256_set1_ps(a_n2.z);
+        const __m256 bxax = _mm256_set1_ps(a_bxa.x);
+        const __m256 bxay = _mm256_set1_ps(a_bxa.y);
+        const __m256 bxaz = _mm256_set1_ps(a_bxa.z);
+        const __m256 dax = _mm256_set1_ps(a_dir.x);
+        const __m256 day = _mm256_set1_ps(a_dir.y);
+        const __m256 daz = _mm256_set1_ps(a_dir.z);
+        const __m256 pax = _mm256_set1_ps(a_p1.x);
+        const __m256 pay = _mm256_set1_ps(a_p1.y);
+        const __m256 paz = _mm256_set1_ps(a_p1.z);
+        const __m256 tex = _mm256_set1_ps(a_to_edge.x);
+        const __m256 tey = _mm256_set1_ps(a_to_edge.y);
+        const __m256 tez = _mm256_set1_ps(a_to_edge.z);
+        const __m256i a_idx = _mm256_set1_epi32(hedge_idx_a);
+
+        for (int32_t edge_idx_b = 0; edge_idx_b < b_num_edges;
+             edge_idx_b += numLanes) {
+            __m256i b_edge = _mm256_add_epi32(
+                _mm256_set1_epi32(edge_idx_b), lane_offsets);
+            __m256 in_range = _mm256_castsi256_ps(_mm256_cmpgt_epi32(
+                _mm256_set1_epi32(b_num_edges), b_edge));
+
+            // c & d in isMinkowskiFace
+            __m256 cx = _mm256_load_ps(b_edges.negNormal1X + edge_idx_b);
+            __m256 cy = _mm256_load_ps(b_edges.negNormal1Y + edge_idx_b);
+            __m256 cz = _mm256_load_ps(b_edges.negNormal1Z + edge_idx_b);
+            __m256 dx = _mm256_load_ps(b_edges.negNormal2X + edge_idx_b);
+            __m256 dy = _mm256_load_ps(b_edges.negNormal2Y + edge_idx_b);
+            __m256 dz = _mm256_load_ps(b_edges.negNormal2Z + edge_idx_b);
+
+            __m256 dxcx = _mm256_fmsub_ps(dy, cz, _mm256_mul_ps(dz, cy));
+            __m256 dxcy = _mm256_fmsub_ps(dz, cx, _mm256_mul_ps(dx, cz));
+            __m256 dxcz = _mm256_fmsub_ps(dx, cy, _mm256_mul_ps(dy, cx));
+
+            __m256 cba = dot3(cx, cy, cz, bxax, bxay, bxaz);
+            __m256 dba = dot3(dx, dy, dz, bxax, bxay, bxaz);
+            __m256 adc = dot3(n1x, n1y, n1z, dxcx, dxcy, dxcz);
+            __m256 bdc = dot3(n2x, n2y, n2z, dxcx, dxcy, dxcz);
+
+            __m256 is_minkowski = _mm256_and_ps(
+                _mm256_and_ps(
+                    _mm256_cmp_ps(_mm256_mul_ps(cba, dba), zero, _CMP_LT_OQ),
+                    _mm256_cmp_ps(_mm256_mul_ps(adc, bdc), zero, _CMP_LT_OQ)),
+                _mm256_cmp_ps(_mm256_mul_ps(cba, bdc), zero, _CMP_GT_OQ));
+
+            __m256 dbx = _mm256_load_ps(b_edges.dirX + edge_idx_b);
+            __m256 dby = _mm256_load_ps(b_edges.dirY + edge_idx_b);
+            __m256 dbz = _mm256_load_ps(b_edges.dirZ + edge_idx_b);
+
+            __m256 nx = _mm256_fmsub_ps(day, dbz, _mm256_mul_ps(daz, dby));
+            __m256 ny = _mm256_fmsub_ps(daz, dbx, _mm256_mul_ps(dax, dbz));
+            __m256 nz = _mm256_fmsub_ps(dax, dby, _mm256_mul_ps(day, dbx));
+
+            __m256 len2 = dot3(nx, ny, nz, nx, ny, nz);
+            __m256 valid = _mm256_and_ps(
+                _mm256_and_ps(is_minkowski, in_range),
+                _mm256_cmp_ps(len2, zero, _CMP_NEQ_OQ));
+
+            // Parallel edges produce len2 == 0, which is masked out below
+            __m256 inv_len = _mm256_div_ps(_mm256_set1_ps(1.f),
+                                           _mm256_sqrt_ps(len2));
+            nx = _mm256_mul_ps(nx, inv_len);
+            ny = _mm256_mul_ps(ny, inv_len);
+            nz = _mm256_mul_ps(nz, inv_len);
+
+            // Orient the normal to point away from a's center
+            __m256 flip = _mm256_and_ps(
+                _mm256_cmp_ps(dot3(nx, ny, nz, tex, tey, tez), zero,
+                              _CMP_LT_OQ),
+                _mm256_set1_ps(-0.f));
+            nx = _mm256_xor_ps(nx, flip);
+            ny = _mm256_xor_ps(ny, flip);
+            nz = _mm256_xor_ps(nz, flip);
+
+            __m256 sep = dot3(
+                nx, ny, nz,
+                _mm256_sub_ps(
+                    _mm256_load_ps(b_edges.originX + edge_idx_b), pax),
+                _mm256_sub_ps(
+                    _mm256_load_ps(b_edges.originY + edge_idx_b), pay),
+                _mm256_sub_ps(
+                    _mm256_load_ps(b_edges.originZ + edge_idx_b), paz));
+            sep = _mm256_blendv_ps(neg_flt_max, sep, valid);
+
+            __m256 better = _mm256_cmp_ps(sep, best_sep, _CMP_GT_OQ);
+            __m256i better_i = _mm256_castps_si256(better);
+
+            best_sep = _mm256_blendv_ps(best_sep, sep, better);
+            best_nx = _mm256_blendv_ps(best_nx, nx, better);
+            best_ny = _mm256_blendv_ps(best_ny, ny, better);
+            best_nz = _mm256_blendv_ps(best_nz, nz, better);
+            best_a = _mm256_blendv_epi8(best_a, a_idx, better_i);
+            best_b = _mm256_blendv_epi8(best_b,
+                _mm256_add_epi32(b_edge, b_edge), better_i);
+
+            if (_mm256_movemask_ps(
+                    _mm256_cmp_ps(sep, zero, _CMP_GT_OQ)) != 0) {
+                found_separating = true;
+                break;
+            }
+        }
+    }
+
+    alignas(32) float lane_sep[numLanes];
+    alignas(32) float lane_nx[numLanes];
+    alignas(32) float lane_ny[numLanes];
+    alignas(32) float lane_nz[numLanes];
+    alignas(32) int32_t lane_a[numLanes];
+    alignas(32) int32_t lane_b[numLanes];
+
+    _mm256_store_ps(lane_sep, best_sep);
+    _mm256_store_ps(lane_nx, best_nx);
+    _mm256_store_ps(lane_ny, best_ny);
+    _mm256_store_ps(lane_nz, best_nz);
+    _mm256_store_si256((__m256i *)lane_a, best_a);
+    _mm256_store_si256((__m256i *)lane_b, best_b);
+
+    int32_t best_lane = 0;
+    for (int32_t i = 1; i < numLanes; i++) {
+        bool better = lane_sep[i] > lane_sep[best_lane] ||
+            (lane_sep[i] == lane_sep[best_lane] &&
+             (lane_a[i] < lane_a[best_lane] ||
+              (lane_a[i] == lane_a[best_lane] &&
+               lane_b[i] < lane_b[best_lane])));
+
+        if (better) {
+            best_lane = i;
+        }
+    }
+
+    return {
+        lane_sep[best_lane],
+        { lane_nx[best_lane], lane_ny[best_lane], lane_nz[best_lane] },
+        lane_a[best_lane],
+        lane_b[best_lane],
+    };
+}
+
+}
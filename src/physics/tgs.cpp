@@ -9,8 +9,32 @@
 
 namespace madrona::phys::tgs {
 
-struct Contact : Archetype<ContactConstraint> {};
-struct Joint : Archetype<JointConstraint> {};
+struct TGSContactState {
+    math::Vector3 tangent1;
+    math::Vector3 tangent2;
+    math::Vector3 localAnchorsRef[4];
+    math::Vector3 localAnchorsAlt[4];
+    float baseSeparation[4];
+    float normalMass[4];
+    float tangentMass[4][2];
+    float normalImpulse[4];
+    float tangentImpulse[4][2];
+    float friction;
+    float invMassRef;
+    float invMassAlt;
+    math::Diag3x3 invInertiaRef;
+    math::Diag3x3 invInertiaAlt;
+};
+
+struct TGSJointState {
+    float invMass1;
+    float invMass2;
+    math::Diag3x3 invInertia1;
+    math::Diag3x3 invInertia2;
+};
+
+struct Contact : Archetype<ContactConstraint, TGSContactState> {};
+struct Joint : Archetype<JointConstraint, TGSJointState> {};
 
 // Any per-body solver state would go in components in this bundle
 // (check XPBDRigidBodyState for example).
@@ -18,15 +42,144 @@ struct TGSRigidBodyState : Bundle<
 > {};
 
 struct SolverState {
-    Query<JointConstraint> jointQuery;
-    Query<ContactConstraint> contactQuery;
+    Query<JointConstraint, TGSJointState> jointQuery;
+    Query<ContactConstraint, TGSContactState> contactQuery;
 };
 
 using namespace base;
 using namespace math;
 
+// FIXME: these should be configurable through PhysicsSystem::init
+namespace consts {
+// Contact stiffness is capped relative to the substep rate below, matching
+// Solver2D's choice of a quarter of the substep frequency
+constexpr inline float contactHertz = 30.f;
+constexpr inline float contactDampingRatio = 10.f;
+constexpr inline float jointDampingRatio = 2.f;
+// Upper bound on the velocity used to push apart overlapping shapes
+constexpr inline float maxBiasVelocity = 3.f;
+}
+
+// Soft constraint coefficients, see Erin Catto's "Solver2D" post and
+// "Soft Constraints" GDC 2011 talk
+struct Softness {
+    float biasRate;
+    float massScale;
+    float impulseScale;
+};
+
+static inline Softness makeSoftness(float hertz, float damping_ratio, float h)
+{
+    if (hertz == 0.f) {
+        return { 0.f, 1.f, 0.f };
+    }
+
+    float omega = 2.f * math::pi * hertz;
+    float a1 = 2.f * damping_ratio + h * omega;
+    float a2 = h * omega * a1;
+    float a3 = 1.f / (1.f + a2);
+
+    return {
+        .biasRate = omega / a1,
+        .massScale = a2 * a3,
+        .impulseScale = a3,
+    };
+}
+
+static inline float getContactHertz(float h)
+{
+    return fminf(consts::contactHertz, 0.25f / h);
+}
+
+static inline void getInvMassProperties(Context &ctx,
+                                        const ObjectManager &obj_mgr,
+                                        Loc loc,
+                                        float *inv_m,
+                                        Diag3x3 *inv_I)
+{
+    ResponseType response_type =
+        ctx.getDirect<ResponseType>(RGDCols::ResponseType, loc);
+
+    // Kinematic bodies follow their velocity and are never pushed back by
+    // constraints. Sleeping bodies are held in place until their island
+    // wakes, their BVH leaves aren't refit in the meantime.
+    if (response_type != ResponseType::Dynamic ||
+            ctx.singleton<IslandState>().isAsleep(
+                ctx.getDirect<broadphase::LeafID>(RGDCols::LeafID, loc))) {
+        *inv_m = 0.f;
+        *inv_I = Diag3x3 { 0.f, 0.f, 0.f };
+        return;
+    }
+
+    ObjectID obj_id = ctx.getDirect<ObjectID>(RGDCols::ObjectID, loc);
+    const RigidBodyMetadata &metadata = obj_mgr.metadata[obj_id.idx];
+
+    *inv_m = metadata.mass.invMass;
+    *inv_I = Diag3x3::fromVec(metadata.mass.invInertiaTensor);
+}
+
+// Applies the world space inverse inertia tensor of a body with orientation
+// q to v
+static inline Vector3 applyInvInertia(Quat q, Diag3x3 inv_I, Vector3 v)
+{
+    return q.rotateVec(inv_I * q.inv().rotateVec(v));
+}
+
+static inline float computeEffectiveMass(float inv_m1, float inv_m2,
+                                         Diag3x3 inv_I1, Diag3x3 inv_I2,
+                                         Quat q1, Quat q2,
+                                         Vector3 r1, Vector3 r2,
+                                         Vector3 dir)
+{
+    Vector3 r1_x_dir = cross(r1, dir);
+    Vector3 r2_x_dir = cross(r2, dir);
+
+    float k = inv_m1 + inv_m2 +
+        dot(r1_x_dir, applyInvInertia(q1, inv_I1, r1_x_dir)) +
+        dot(r2_x_dir, applyInvInertia(q2, inv_I2, r2_x_dir));
+
+    return k > 0.f ? 1.f / k : 0.f;
+}
+
+// Cramer's rule, K is expected to be symmetric positive definite
+static inline Vector3 solve3x3(const Mat3x3 &K, Vector3 b)
+{
+    float det = K.determinant();
+    if (det != 0.f) {
+        det = 1.f / det;
+    }
+
+    Mat3x3 Kx { b, K[1], K[2] };
+    Mat3x3 Ky { K[0], b, K[2] };
+    Mat3x3 Kz { K[0], K[1], b };
+
+    return Vector3 {
+        det * Kx.determinant(),
+        det * Ky.determinant(),
+        det * Kz.determinant(),
+    };
+}
+
+static inline void applyImpulse(Vector3 &v1, Vector3 &omega1,
+                                Vector3 &v2, Vector3 &omega2,
+                                float inv_m1, float inv_m2,
+                                Diag3x3 inv_I1, Diag3x3 inv_I2,
+                                Quat q1, Quat q2,
+                                Vector3 r1, Vector3 r2,
+                                Vector3 impulse)
+{
+    v1 -= inv_m1 * impulse;
+    omega1 -= applyInvInertia(q1, inv_I1, cross(r1, impulse));
+
+    v2 += inv_m2 * impulse;
+    omega2 += applyInvInertia(q2, inv_I2, cross(r2, impulse));
+}
+
 void registerTypes(ECSRegistry &registry)
 {
+    registry.registerComponent<TGSContactState>();
+    registry.registerComponent<TGSJointState>();
+
     registry.registerArchetype<Joint>();
     registry.registerArchetype<Contact>();
 
@@ -44,8 +197,8 @@ void registerTypes(ECSRegistry &registry)
 void init(Context &ctx)
 {
     ctx.singleton<SolverState>() = {
-        .jointQuery = ctx.query<JointConstraint>(),
-        .contactQuery = ctx.query<ContactConstraint>(),
+        .jointQuery = ctx.query<JointConstraint, TGSJointState>(),
+        .contactQuery = ctx.query<ContactConstraint, TGSContactState>(),
     };
 }
 
@@ -56,49 +209,427 @@ void getSolverArchetypeIDs(uint32_t *contact_archetype_id,
     *joint_archetype_id = TypeTracker::typeID<Joint>();
 }
 
+static inline void solveJointAngular(JointConstraint &joint,
+                                     TGSJointState &state,
+                                     Quat q1, Quat q2,
+                                     Vector3 &omega1, Vector3 &omega2,
+                                     Softness softness,
+                                     bool use_bias)
+{
+    auto applyInvInertiaSum = [&](Vector3 v) {
+        return applyInvInertia(q1, state.invInertia1, v) +
+            applyInvInertia(q2, state.invInertia2, v);
+    };
+
+    float mass_scale = 1.f;
+    float impulse_scale = 0.f;
+    if (use_bias) {
+        mass_scale = softness.massScale;
+        impulse_scale = softness.impulseScale;
+    }
+
+    Vector3 cdot = omega2 - omega1;
+
+    Vector3 impulse;
+    switch (joint.type) {
+    case JointConstraint::Type::Fixed: {
+        JointConstraint::Fixed fixed_data = joint.fixed;
+
+        Quat orientation1 = (q1 * fixed_data.attachRot1).normalize();
+        Quat orientation2 = (q2 * fixed_data.attachRot2).normalize();
+
+        // Rotation vector taking orientation1 to orientation2
+        Quat diff = orientation2 * orientation1.inv();
+        Vector3 c = 2.f * Vector3 { diff.x, diff.y, diff.z };
+        if (diff.w < 0.f) {
+            c = -c;
+        }
+
+        Vector3 bias = Vector3::zero();
+        if (use_bias) {
+            bias = softness.biasRate * c;
+        }
+
+        Mat3x3 K {
+            applyInvInertiaSum(Vector3 { 1, 0, 0 }),
+            applyInvInertiaSum(Vector3 { 0, 1, 0 }),
+            applyInvInertiaSum(Vector3 { 0, 0, 1 }),
+        };
+
+        impulse = -mass_scale * solve3x3(K, cdot + bias) -
+            impulse_scale * joint.angularImpulse;
+    } break;
+    case JointConstraint::Type::Hinge: {
+        JointConstraint::Hinge hinge_data = joint.hinge;
+
+        Vector3 a1 = q1.rotateVec(hinge_data.a1Local);
+        Vector3 a2 = q2.rotateVec(hinge_data.a2Local);
+
+        // Only rotation perpendicular to the hinge axis is constrained
+        Vector3 b, c;
+        a1.frame(&b, &c);
+        b = b.normalize();
+        c = c.normalize();
+
+        // For small misalignments, a1 x a2 is the rotation vector of body 2
+        // relative to body 1
+        Vector3 err = cross(a1, a2);
+
+        float bias_b = 0.f;
+        float bias_c = 0.f;
+        if (use_bias) {
+            bias_b = softness.biasRate * dot(err, b);
+            bias_c = softness.biasRate * dot(err, c);
+        }
+
+        Vector3 inv_I_b = applyInvInertiaSum(b);
+        Vector3 inv_I_c = applyInvInertiaSum(c);
+
+        float k_bb = dot(b, inv_I_b);
+        float k_bc = dot(b, inv_I_c);
+        float k_cc = dot(c, inv_I_c);
+
+        float det = k_bb * k_cc - k_bc * k_bc;
+        if (det != 0.f) {
+            det = 1.f / det;
+        }
+
+        float rhs_b = dot(cdot, b) + bias_b;
+        float rhs_c = dot(cdot, c) + bias_c;
+
+        float x_b = det * (k_cc * rhs_b - k_bc * rhs_c);
+        float x_c = det * (k_bb * rhs_c - k_bc * rhs_b);
+
+        float impulse_b = -mass_scale * x_b -
+            impulse_scale * dot(joint.angularImpulse, b);
+        float impulse_c = -mass_scale * x_c -
+            impulse_scale * dot(joint.angularImpulse, c);
+
+        impulse = impulse_b * b + impulse_c * c;
+    } break;
+    default: MADRONA_UNREACHABLE();
+    }
+
+    joint.angularImpulse += impulse;
+
+    omega1 -= applyInvInertia(q1, state.invInertia1, impulse);
+    omega2 += applyInvInertia(q2, state.invInertia2, impulse);
+}
+
+static inline void solveJointLinear(JointConstraint &joint,
+                                    TGSJointState &state,
+                                    Vector3 x1, Vector3 x2,
+                                    Quat q1, Quat q2,
+                                    Vector3 &v1, Vector3 &v2,
+                                    Vector3 &omega1, Vector3 &omega2,
+                                    Softness softness,
+                                    bool use_bias)
+{
+    Vector3 r1 = q1.rotateVec(joint.r1);
+    Vector3 r2 = q2.rotateVec(joint.r2);
+
+    Vector3 target_offset = Vector3::zero();
+    if (joint.type == JointConstraint::Type::Fixed) {
+        // Fixed joints hold a fixed distance along the a1 axis
+        Quat axes_rot = (q1 * joint.fixed.attachRot1).normalize();
+        target_offset = joint.fixed.separation * axes_rot.rotateVec(math::fwd);
+    }
+
+    Vector3 cdot = v2 + cross(omega2, r2) - v1 - cross(omega1, r1);
+
+    Vector3 bias = Vector3::zero();
+    float mass_scale = 1.f;
+    float impulse_scale = 0.f;
+    if (use_bias) {
+        Vector3 c = (x2 + r2) - (x1 + r1) - target_offset;
+
+        bias = softness.biasRate * c;
+        mass_scale = softness.massScale;
+        impulse_scale = softness.impulseScale;
+    }
+
+    auto applyK = [&](Vector3 e) {
+        return (state.invMass1 + state.invMass2) * e +
+            cross(applyInvInertia(q1, state.invInertia1, cross(r1, e)), r1) +
+            cross(applyInvInertia(q2, state.invInertia2, cross(r2, e)), r2);
+    };
+
+    Mat3x3 K {
+        applyK(Vector3 { 1, 0, 0 }),
+        applyK(Vector3 { 0, 1, 0 }),
+        applyK(Vector3 { 0, 0, 1 }),
+    };
+
+    Vector3 impulse = -mass_scale * solve3x3(K, cdot + bias) -
+        impulse_scale * joint.linearImpulse;
+
+    joint.linearImpulse += impulse;
+
+    applyImpulse(v1, omega1, v2, omega2,
+                 state.invMass1, state.invMass2,
+                 state.invInertia1, state.invInertia2,
+                 q1, q2, r1, r2, impulse);
+}
+
 static inline void solveJoints(Context &ctx,
                                SolverState &solver,
                                bool use_bias)
 {
-    (void)ctx;
-    (void)solver;
-    (void)use_bias;
+    const auto &physics_sys = ctx.singleton<PhysicsSystemState>();
+    float h = physics_sys.h;
+
+    Softness softness = makeSoftness(
+        2.f * getContactHertz(h), consts::jointDampingRatio, h);
+
+    ctx.iterateQuery(solver.jointQuery,
+    [&](JointConstraint &joint, TGSJointState &state) {
+        Loc l1 = ctx.loc(joint.e1);
+        Loc l2 = ctx.loc(joint.e2);
+
+        Vector3 x1 = ctx.getDirect<Position>(RGDCols::Position, l1);
+        Vector3 x2 = ctx.getDirect<Position>(RGDCols::Position, l2);
+        Quat q1 = ctx.getDirect<Rotation>(RGDCols::Rotation, l1);
+        Quat q2 = ctx.getDirect<Rotation>(RGDCols::Rotation, l2);
+
+        Velocity &vel1 = ctx.getDirect<Velocity>(RGDCols::Velocity, l1);
+        Velocity &vel2 = ctx.getDirect<Velocity>(RGDCols::Velocity, l2);
+
+        Vector3 v1 = vel1.linear;
+        Vector3 omega1 = vel1.angular;
+        Vector3 v2 = vel2.linear;
+        Vector3 omega2 = vel2.angular;
+
+        solveJointAngular(joint, state, q1, q2, omega1, omega2,
+                          softness, use_bias);
+
+        solveJointLinear(joint, state, x1, x2, q1, q2,
+                         v1, v2, omega1, omega2, softness, use_bias);
+
+        vel1 = { v1, omega1 };
+        vel2 = { v2, omega2 };
+    });
 }
 
 static inline void solveContacts(Context &ctx,
                                  SolverState &solver,
                                  bool use_bias)
 {
-    ctx.iterateQuery(solver.contactQuery, [&](ContactConstraint &contact) {
-        // Solve contact
-        (void)contact;
-        (void)use_bias;
+    const auto &physics_sys = ctx.singleton<PhysicsSystemState>();
+    float h = physics_sys.h;
+    float inv_h = 1.f / h;
+
+    Softness softness = makeSoftness(
+        getContactHertz(h), consts::contactDampingRatio, h);
+
+    ctx.iterateQuery(solver.contactQuery,
+    [&](ContactConstraint &contact, TGSContactState &state) {
+        Vector3 x_ref = ctx.getDirect<Position>(RGDCols::Position, contact.ref);
+        Vector3 x_alt = ctx.getDirect<Position>(RGDCols::Position, contact.alt);
+        Quat q_ref = ctx.getDirect<Rotation>(RGDCols::Rotation, contact.ref);
+        Quat q_alt = ctx.getDirect<Rotation>(RGDCols::Rotation, contact.alt);
+
+        Velocity &vel_ref =
+            ctx.getDirect<Velocity>(RGDCols::Velocity, contact.ref);
+        Velocity &vel_alt =
+            ctx.getDirect<Velocity>(RGDCols::Velocity, contact.alt);
+
+        Vector3 v_ref = vel_ref.linear;
+        Vector3 omega_ref = vel_ref.angular;
+        Vector3 v_alt = vel_alt.linear;
+        Vector3 omega_alt = vel_alt.angular;
+
+        // The contact normal points from the reference body to the other
+        // body, so a positive normal impulse pushes alt away from ref
+        Vector3 n = contact.normal;
+
+        for (CountT i = 0; i < contact.numPoints; i++) {
+            Vector3 r_ref = q_ref.rotateVec(state.localAnchorsRef[i]);
+            Vector3 r_alt = q_alt.rotateVec(state.localAnchorsAlt[i]);
+
+            // Separation is tracked relative to the narrowphase result
+            // using the bodies' motion since then
+            float s = dot((x_alt + r_alt) - (x_ref + r_ref), n) +
+                state.baseSeparation[i];
+
+            float velocity_bias = 0.f;
+            float mass_scale = 1.f;
+            float impulse_scale = 0.f;
+            if (s > 0.f) {
+                // Speculative: allow the gap to close within the substep
+                velocity_bias = s * inv_h;
+            } else if (use_bias) {
+                velocity_bias = fmaxf(softness.biasRate * s,
+                                      -consts::maxBiasVelocity);
+                mass_scale = softness.massScale;
+                impulse_scale = softness.impulseScale;
+            }
+
+            Vector3 dv = v_alt + cross(omega_alt, r_alt) -
+                v_ref - cross(omega_ref, r_ref);
+            float vn = dot(dv, n);
+
+            float old_impulse = state.normalImpulse[i];
+            float impulse = -state.normalMass[i] * mass_scale *
+                (vn + velocity_bias) - impulse_scale * old_impulse;
+
+            float new_impulse = fmaxf(old_impulse + impulse, 0.f);
+            impulse = new_impulse - old_impulse;
+            state.normalImpulse[i] = new_impulse;
+
+            applyImpulse(v_ref, omega_ref, v_alt, omega_alt,
+                         state.invMassRef, state.invMassAlt,
+                         state.invInertiaRef, state.invInertiaAlt,
+                         q_ref, q_alt, r_ref, r_alt, impulse * n);
+        }
+
+        for (CountT i = 0; i < contact.numPoints; i++) {
+            Vector3 r_ref = q_ref.rotateVec(state.localAnchorsRef[i]);
+            Vector3 r_alt = q_alt.rotateVec(state.localAnchorsAlt[i]);
+
+            Vector3 dv = v_alt + cross(omega_alt, r_alt) -
+                v_ref - cross(omega_ref, r_ref);
+
+            float vt1 = dot(dv, state.tangent1);
+            float vt2 = dot(dv, state.tangent2);
+
+            float old_impulse1 = state.tangentImpulse[i][0];
+            float old_impulse2 = state.tangentImpulse[i][1];
+
+            float new_impulse1 =
+                old_impulse1 - state.tangentMass[i][0] * vt1;
+            float new_impulse2 =
+                old_impulse2 - state.tangentMass[i][1] * vt2;
+
+            // Clamp to the friction cone
+            float max_friction = state.friction * state.normalImpulse[i];
+            float friction_len2 =
+                new_impulse1 * new_impulse1 + new_impulse2 * new_impulse2;
+            if (friction_len2 > max_friction * max_friction) {
+                float scale = max_friction / sqrtf(friction_len2);
+                new_impulse1 *= scale;
+                new_impulse2 *= scale;
+            }
+
+            state.tangentImpulse[i][0] = new_impulse1;
+            state.tangentImpulse[i][1] = new_impulse2;
+
+            Vector3 impulse =
+                (new_impulse1 - old_impulse1) * state.tangent1 +
+                (new_impulse2 - old_impulse2) * state.tangent2;
+
+            applyImpulse(v_ref, omega_ref, v_alt, omega_alt,
+                         state.invMassRef, state.invMassAlt,
+                         state.invInertiaRef, state.invInertiaAlt,
+                         q_ref, q_alt, r_ref, r_alt, impulse);
+        }
+
+        vel_ref = { v_ref, omega_ref };
+        vel_alt = { v_alt, omega_alt };
     });
 }
 
 inline void prepareContacts(Context &ctx,
-                            ContactConstraint constraint)
+                            const ContactConstraint &contact,
+                            TGSContactState &state)
 {
-    (void)ctx;
-    (void)constraint;
+    const ObjectManager &obj_mgr = *ctx.singleton<ObjectData>().mgr;
+
+    Vector3 x_ref = ctx.getDirect<Position>(RGDCols::Position, contact.ref);
+    Vector3 x_alt = ctx.getDirect<Position>(RGDCols::Position, contact.alt);
+    Quat q_ref = ctx.getDirect<Rotation>(RGDCols::Rotation, contact.ref);
+    Quat q_alt = ctx.getDirect<Rotation>(RGDCols::Rotation, contact.alt);
+
+    getInvMassProperties(ctx, obj_mgr, contact.ref,
+                         &state.invMassRef, &state.invInertiaRef);
+    getInvMassProperties(ctx, obj_mgr, contact.alt,
+                         &state.invMassAlt, &state.invInertiaAlt);
+
+    {
+        ObjectID obj_ref = ctx.getDirect<ObjectID>(
+            RGDCols::ObjectID, contact.ref);
+        ObjectID obj_alt = ctx.getDirect<ObjectID>(
+            RGDCols::ObjectID, contact.alt);
+
+        state.friction = 0.5f * (obj_mgr.metadata[obj_ref.idx].friction.muD +
+                                 obj_mgr.metadata[obj_alt.idx].friction.muD);
+    }
+
+    Vector3 n = contact.normal;
+
+    Vector3 t1, t2;
+    n.frame(&t1, &t2);
+    state.tangent1 = t1.normalize();
+    state.tangent2 = t2.normalize();
+
+    const ContactCache::Entry *cache_entry = nullptr;
+    if (contact.cacheEntry != -1) {
+        cache_entry =
+            &ctx.singleton<ContactCache>().entries[contact.cacheEntry];
+    }
+
+    for (CountT i = 0; i < contact.numPoints; i++) {
+        Vector4 pt = contact.points[i];
+
+        // Anchor both bodies at the midpoint between the surfaces
+        Vector3 anchor = pt.xyz() - 0.5f * pt.w * n;
+
+        Vector3 r_ref = anchor - x_ref;
+        Vector3 r_alt = anchor - x_alt;
+
+        state.localAnchorsRef[i] = q_ref.inv().rotateVec(r_ref);
+        state.localAnchorsAlt[i] = q_alt.inv().rotateVec(r_alt);
+        state.baseSeparation[i] = -pt.w;
+
+        state.normalMass[i] = computeEffectiveMass(
+            state.invMassRef, state.invMassAlt,
+            state.invInertiaRef, state.invInertiaAlt,
+            q_ref, q_alt, r_ref, r_alt, n);
+        state.tangentMass[i][0] = computeEffectiveMass(
+            state.invMassRef, state.invMassAlt,
+            state.invInertiaRef, state.invInertiaAlt,
+            q_ref, q_alt, r_ref, r_alt, state.tangent1);
+        state.tangentMass[i][1] = computeEffectiveMass(
+            state.invMassRef, state.invMassAlt,
+            state.invInertiaRef, state.invInertiaAlt,
+            q_ref, q_alt, r_ref, r_alt, state.tangent2);
+
+        if (cache_entry != nullptr) {
+            // Narrowphase already matched these points with last step's
+            // manifold
+            state.normalImpulse[i] = cache_entry->normalImpulses[i];
+            state.tangentImpulse[i][0] = cache_entry->tangentImpulses[i][0];
+            state.tangentImpulse[i][1] = cache_entry->tangentImpulses[i][1];
+        } else {
+            state.normalImpulse[i] = 0.f;
+            state.tangentImpulse[i][0] = 0.f;
+            state.tangentImpulse[i][1] = 0.f;
+        }
+    }
 }
 
 inline void prepareJoints(Context &ctx,
-                          JointConstraint constraint)
+                          const JointConstraint &joint,
+                          TGSJointState &state)
 {
-    (void)ctx;
-    (void)constraint;
+    const ObjectManager &obj_mgr = *ctx.singleton<ObjectData>().mgr;
+
+    getInvMassProperties(ctx, obj_mgr, ctx.loc(joint.e1),
+                         &state.invMass1, &state.invInertia1);
+    getInvMassProperties(ctx, obj_mgr, ctx.loc(joint.e2),
+                         &state.invMass2, &state.invInertia2);
 }
 
 inline void integrateVelocities(Context &ctx,
                                 Rotation q,
                                 ResponseType response_type,
+                                broadphase::LeafID leaf_id,
                                 ExternalForce ext_force,
                                 ExternalTorque ext_torque,
                                 ObjectID obj_id,
                                 Velocity &vel)
 {
-    if (response_type == ResponseType::Static) {
+    if (response_type == ResponseType::Static ||
+            ctx.singleton<IslandState>().isAsleep(leaf_id)) {
         return;
     }
 
@@ -133,7 +664,7 @@ inline void integrateVelocities(Context &ctx,
 
     // Integrate omega in local space
     omega_local +=
-        h * inv_I * (tau_ext_local - (cross(omega_local, I * omega)));
+        h * inv_I * (tau_ext_local - (cross(omega_local, I * omega_local)));
 
     omega = q.rotateVec(omega_local);
 
@@ -144,17 +675,77 @@ inline void integrateVelocities(Context &ctx,
 }
 
 inline void warmStartContacts(Context &ctx,
-                              ContactConstraint constraint)
+                              SolverState &solver)
 {
-    (void)ctx;
-    (void)constraint;
+    ctx.iterateQuery(solver.contactQuery,
+    [&](ContactConstraint &contact, TGSContactState &state) {
+        Quat q_ref = ctx.getDirect<Rotation>(RGDCols::Rotation, contact.ref);
+        Quat q_alt = ctx.getDirect<Rotation>(RGDCols::Rotation, contact.alt);
+
+        Velocity &vel_ref =
+            ctx.getDirect<Velocity>(RGDCols::Velocity, contact.ref);
+        Velocity &vel_alt =
+            ctx.getDirect<Velocity>(RGDCols::Velocity, contact.alt);
+
+        Vector3 v_ref = vel_ref.linear;
+        Vector3 omega_ref = vel_ref.angular;
+        Vector3 v_alt = vel_alt.linear;
+        Vector3 omega_alt = vel_alt.angular;
+
+        for (CountT i = 0; i < contact.numPoints; i++) {
+            Vector3 r_ref = q_ref.rotateVec(state.localAnchorsRef[i]);
+            Vector3 r_alt = q_alt.rotateVec(state.localAnchorsAlt[i]);
+
+            Vector3 impulse = state.normalImpulse[i] * contact.normal +
+                state.tangentImpulse[i][0] * state.tangent1 +
+                state.tangentImpulse[i][1] * state.tangent2;
+
+            applyImpulse(v_ref, omega_ref, v_alt, omega_alt,
+                         state.invMassRef, state.invMassAlt,
+                         state.invInertiaRef, state.invInertiaAlt,
+                         q_ref, q_alt, r_ref, r_alt, impulse);
+        }
+
+        vel_ref = { v_ref, omega_ref };
+        vel_alt = { v_alt, omega_alt };
+    });
 }
 
 inline void warmStartJoints(Context &ctx,
-                            JointConstraint constraint)
+                            SolverState &solver)
 {
-    (void)ctx;
-    (void)constraint;
+    ctx.iterateQuery(solver.jointQuery,
+    [&](JointConstraint &joint, TGSJointState &state) {
+        Loc l1 = ctx.loc(joint.e1);
+        Loc l2 = ctx.loc(joint.e2);
+
+        Quat q1 = ctx.getDirect<Rotation>(RGDCols::Rotation, l1);
+        Quat q2 = ctx.getDirect<Rotation>(RGDCols::Rotation, l2);
+
+        Velocity &vel1 = ctx.getDirect<Velocity>(RGDCols::Velocity, l1);
+        Velocity &vel2 = ctx.getDirect<Velocity>(RGDCols::Velocity, l2);
+
+        Vector3 v1 = vel1.linear;
+        Vector3 omega1 = vel1.angular;
+        Vector3 v2 = vel2.linear;
+        Vector3 omega2 = vel2.angular;
+
+        Vector3 r1 = q1.rotateVec(joint.r1);
+        Vector3 r2 = q2.rotateVec(joint.r2);
+
+        applyImpulse(v1, omega1, v2, omega2,
+                     state.invMass1, state.invMass2,
+                     state.invInertia1, state.invInertia2,
+                     q1, q2, r1, r2, joint.linearImpulse);
+
+        omega1 -= applyInvInertia(q1, state.invInertia1,
+                                  joint.angularImpulse);
+        omega2 += applyInvInertia(q2, state.invInertia2,
+                                  joint.angularImpulse);
+
+        vel1 = { v1, omega1 };
+        vel2 = { v2, omega2 };
+    });
 }
 
 inline void solveJointsBiased(Context &ctx,
@@ -170,10 +761,15 @@ inline void solveContactsBiased(Context &ctx,
 }
 
 inline void integratePositions(Context &ctx,
+                               broadphase::LeafID leaf_id,
                                Position &pos,
                                Rotation &rot,
                                Velocity vel)
 {
+    if (ctx.singleton<IslandState>().isAsleep(leaf_id)) {
+        return;
+    }
+
     Vector3 x = pos;
     Quat q = rot;
 
@@ -206,6 +802,24 @@ inline void solveContactsUnbiased(Context &ctx,
     solveContacts(ctx, solver, false);
 }
 
+inline void storeContactImpulses(Context &ctx,
+                                 const ContactConstraint &contact,
+                                 const TGSContactState &state)
+{
+    if (contact.cacheEntry == -1) {
+        return;
+    }
+
+    ContactCache::Entry &cache_entry =
+        ctx.singleton<ContactCache>().entries[contact.cacheEntry];
+
+    for (CountT i = 0; i < contact.numPoints; i++) {
+        cache_entry.normalImpulses[i] = state.normalImpulse[i];
+        cache_entry.tangentImpulses[i][0] = state.tangentImpulse[i][0];
+        cache_entry.tangentImpulses[i][1] = state.tangentImpulse[i][1];
+    }
+}
+
 TaskGraphNodeID setupTGSSolverTasks(
     TaskGraphBuilder &builder,
     TaskGraphNodeID broadphase,
@@ -236,19 +850,22 @@ TaskGraphNodeID setupTGSSolverTasks(
 
     cur_node = builder.addToGraph<ParallelForNode<Context,
         prepareContacts,
-            ContactConstraint
+            ContactConstraint,
+            TGSContactState
         >>({cur_node});
 
     cur_node = builder.addToGraph<ParallelForNode<Context,
         prepareJoints,
-            JointConstraint
+            JointConstraint,
+            TGSJointState
         >>({cur_node});
-            
+
     for (CountT i = 0; i < num_substeps; i++) {
         cur_node = builder.addToGraph<ParallelForNode<Context,
             integrateVelocities,
                 Rotation,
                 ResponseType,
+                broadphase::LeafID,
                 ExternalForce,
                 ExternalTorque,
                 ObjectID,
@@ -256,15 +873,15 @@ TaskGraphNodeID setupTGSSolverTasks(
             >>({cur_node});
 
         cur_node = builder.addToGraph<ParallelForNode<Context,
-            warmStartContacts,
-                ContactConstraint
+            warmStartJoints,
+                SolverState
             >>({cur_node});
 
         cur_node = builder.addToGraph<ParallelForNode<Context,
             warmStartContacts,
-                ContactConstraint
+                SolverState
             >>({cur_node});
-         
+
         cur_node = builder.addToGraph<ParallelForNode<Context,
             solveJointsBiased,
                 SolverState
@@ -277,6 +894,7 @@ TaskGraphNodeID setupTGSSolverTasks(
 
         cur_node = builder.addToGraph<ParallelForNode<Context,
             integratePositions,
+                broadphase::LeafID,
                 Position,
                 Rotation,
                 Velocity
@@ -293,8 +911,14 @@ TaskGraphNodeID setupTGSSolverTasks(
             >>({cur_node});
     }
 
-    // For now, we don't have any persistent contacts support, so clear
-    // the contacts (free the memory).
+    // Accumulated impulses outlive the Contact entities in the contact
+    // cache, where next step's prepareContacts picks them up
+    cur_node = builder.addToGraph<ParallelForNode<Context,
+        storeContactImpulses,
+            ContactConstraint,
+            TGSContactState
+        >>({cur_node});
+
     auto clear_contacts = builder.addToGraph<
         ClearTmpNode<Contact>>({cur_node});
 
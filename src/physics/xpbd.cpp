@@ -4,6 +4,10 @@
 #include "physics_impl.hpp"
 #include "xpbd.hpp"
 
+#ifndef MADRONA_GPU_MODE
+#include "xpbd_batch.hpp"
+#endif
+
 namespace madrona::phys::xpbd {
 
 struct XPBDContactState {
@@ -17,11 +21,6 @@ struct Contact : Archetype<
 
 struct Joint : Archetype<JointConstraint> {};
 
-struct SolverState {
-    Query<JointConstraint> jointQuery;
-    Query<ContactConstraint, XPBDContactState> contactQuery;
-};
-
 struct SubstepPrevState {
     math::Vector3 prevPosition;
     math::Quat prevRotation;
@@ -52,6 +51,18 @@ namespace XPBDCols {
 using namespace base;
 using namespace math;
 
+struct SolverState {
+    Query<JointConstraint> jointQuery;
+    Query<ContactConstraint, XPBDContactState> contactQuery;
+#ifndef MADRONA_GPU_MODE
+    // Only used by FusedSubstepNode, which runs outside of ParallelForNode
+    Query<Position, Rotation, Velocity, ObjectID, ResponseType,
+          broadphase::LeafID, ExternalForce, ExternalTorque,
+          SubstepPrevState, PreSolvePositional, PreSolveVelocity> bodyQuery;
+    Query<CandidateCollision> candidateQuery;
+#endif
+};
+
 static inline bool hasNaN(Vector3 v)
 {
     return isnan(v.x) || isnan(v.y) || isnan(v.z);
@@ -103,6 +114,7 @@ inline void substepRigidBodies(Context &ctx,
                                const Velocity &vel,
                                const ObjectID &obj_id,
                                ResponseType response_type,
+                               const broadphase::LeafID &leaf_id,
                                ExternalForce &ext_force,
                                ExternalTorque &ext_torque,
                                SubstepPrevState &prev_state,
@@ -115,7 +127,10 @@ inline void substepRigidBodies(Context &ctx,
     Vector3 v = vel.linear;
     Vector3 omega = vel.angular;
 
-    if (response_type == ResponseType::Static) {
+    // Sleeping bodies are held in place like static ones until a contact
+    // wakes them
+    if (response_type == ResponseType::Static ||
+            ctx.singleton<IslandState>().isAsleep(leaf_id)) {
         // FIXME: currently presolve_pos and prev_state need to be set every
         // frame even for static objects. A better solution would be on
         // creation / making a non-static object static, these variables are
@@ -210,6 +225,20 @@ static inline float generalizedInverseMass(Vector3 torque_axis,
     return inv_m + dot(torque_axis, rot_axis);
 }
 
+// Static and kinematic bodies are never pushed by constraints. Sleeping
+// bodies are held in place as well, since their BVH leaves aren't refit
+// until their island wakes.
+static inline bool isImmovable(Context &ctx, Loc loc)
+{
+    if (ctx.getDirect<ResponseType>(RGDCols::ResponseType, loc) !=
+            ResponseType::Dynamic) {
+        return true;
+    }
+
+    return ctx.singleton<IslandState>().isAsleep(
+        ctx.getDirect<broadphase::LeafID>(RGDCols::LeafID, loc));
+}
+
 static float computePositionalLambda(
     Vector3 torque_axis1, Vector3 torque_axis2,
     Vector3 rot_axis1, Vector3 rot_axis2,
@@ -418,28 +447,51 @@ getLocalSpaceContacts(const PreSolvePositional &presolve_pos1,
     return { r1, r2 };
 }
 
+// Points are weighted by penetration depth. Speculative points (negative
+// depth) get no weight, unless every point is speculative, in which case
+// they're weighted equally.
+static inline float getContactPointWeight(const ContactConstraint &contact,
+                                          CountT i,
+                                          float penetration_sum)
+{
+    if (penetration_sum == 0.f) {
+        return 1.f / float(contact.numPoints);
+    }
+
+    return fmaxf(contact.points[i].w, 0.f) / penetration_sum;
+}
+
+static inline float getPenetrationSum(const ContactConstraint &contact)
+{
+    float penetration_sum = 0.f;
+    for (CountT i = 0; i < contact.numPoints; i++) {
+        penetration_sum += fmaxf(contact.points[i].w, 0.f);
+    }
+
+    return penetration_sum;
+}
+
 static bool getAvgContact(ContactConstraint contact, Vector3 *avg_out, float *penetration_out)
 {
     Vector3 avg_contact = Vector3::zero();
 
+    if (contact.numPoints == 0) {
+        return true;
+    }
+
     float max_penetration = -FLT_MAX;
-    float penetration_sum = 0.f;
     for (CountT i = 0; i < contact.numPoints; i++) {
         Vector4 pt = contact.points[i];
         if (pt.w > max_penetration) {
             max_penetration = pt.w;
         }
-
-        penetration_sum += pt.w;
-    }
-
-    if (penetration_sum == 0.f) {
-        return true;
     }
 
+    float penetration_sum = getPenetrationSum(contact);
     for (CountT i = 0; i < contact.numPoints; i++) {
         Vector4 pt = contact.points[i];
-        avg_contact += pt.w / penetration_sum * pt.xyz();
+        avg_contact += getContactPointWeight(contact, i, penetration_sum) *
+            pt.xyz();
     }
 
     *avg_out = avg_contact;
@@ -456,6 +508,15 @@ static inline void handleContact(Context &ctx,
                                  ContactConstraint contact,
                                  float *lambdas)
 {
+    bool immovable1 = isImmovable(ctx, contact.ref);
+    bool immovable2 = isImmovable(ctx, contact.alt);
+
+    // Nothing to solve between two bodies that can't move, like a sleeping
+    // body resting on kinematic geometry
+    if (immovable1 && immovable2) {
+        return;
+    }
+
     Position *x1_ptr = &ctx.getDirect<Position>(RGDCols::Position, contact.ref);
     Position *x2_ptr = &ctx.getDirect<Position>(RGDCols::Position, contact.alt);
 
@@ -476,11 +537,6 @@ static inline void handleContact(Context &ctx,
         RGDCols::ObjectID, contact.ref);
     ObjectID obj_id2 = ctx.getDirect<ObjectID>(RGDCols::ObjectID, contact.alt);
 
-    ResponseType resp_type1 = ctx.getDirect<ResponseType>(
-        RGDCols::ResponseType, contact.ref);
-    ResponseType resp_type2 = ctx.getDirect<ResponseType>(
-        RGDCols::ResponseType, contact.alt);
-
     RigidBodyMetadata metadata1 = obj_mgr.metadata[obj_id1.idx];
     RigidBodyMetadata metadata2 = obj_mgr.metadata[obj_id2.idx];
 
@@ -496,12 +552,12 @@ static inline void handleContact(Context &ctx,
     Vector3 inv_I1 = metadata1.mass.invInertiaTensor;
     Vector3 inv_I2 = metadata2.mass.invInertiaTensor;
 
-    if (resp_type1 == ResponseType::Static) {
+    if (immovable1) {
         inv_m1 = 0.f;
         inv_I1 = Vector3::zero();
     }
 
-    if (resp_type2 == ResponseType::Static) {
+    if (immovable2) {
         inv_m2 = 0.f;
         inv_I2 = Vector3::zero();
     }
@@ -610,6 +666,15 @@ inline void handleJointConstraint(Context &ctx,
     Loc l1 = ctx.loc(joint.e1);
     Loc l2 = ctx.loc(joint.e2);
 
+    bool immovable1 = isImmovable(ctx, l1);
+    bool immovable2 = isImmovable(ctx, l2);
+
+    // Nothing to solve between two bodies that can't move, like a sleeping
+    // body resting on kinematic geometry
+    if (immovable1 && immovable2) {
+        return;
+    }
+
     Vector3 *x1_ptr = &ctx.getDirect<Position>(RGDCols::Position, l1);
     Vector3 *x2_ptr = &ctx.getDirect<Position>(RGDCols::Position, l2);
     Quat *q1_ptr = &ctx.getDirect<Rotation>(RGDCols::Rotation, l1);
@@ -618,10 +683,6 @@ inline void handleJointConstraint(Context &ctx,
     Vector3 x2 = *x2_ptr;
     Quat q1 = *q1_ptr;
     Quat q2 = *q2_ptr;
-    ResponseType resp_type1 = ctx.getDirect<ResponseType>(
-        RGDCols::ResponseType, l1);
-    ResponseType resp_type2 = ctx.getDirect<ResponseType>(
-        RGDCols::ResponseType, l2);
     ObjectID obj_id1 = ctx.getDirect<ObjectID>(RGDCols::ObjectID, l1);
     ObjectID obj_id2 = ctx.getDirect<ObjectID>(RGDCols::ObjectID, l2);
 
@@ -632,7 +693,7 @@ inline void handleJointConstraint(Context &ctx,
     float inv_m1 = metadata1.mass.invMass;
     Vector3 inv_I1 = metadata1.mass.invInertiaTensor;
 
-    if (resp_type1 == ResponseType::Static) {
+    if (immovable1) {
         inv_m1 = 0.f;
         inv_I1 = Vector3::zero();
     }
@@ -640,7 +701,7 @@ inline void handleJointConstraint(Context &ctx,
     float inv_m2 = metadata2.mass.invMass;
     Vector3 inv_I2 = metadata2.mass.invInertiaTensor;
 
-    if (resp_type2 == ResponseType::Static) {
+    if (immovable2) {
         inv_m2 = 0.f;
         inv_I2 = Vector3::zero();
     }
@@ -739,8 +800,13 @@ inline void setVelocities(Context &ctx,
                           const Position &pos,
                           const Rotation &rot,
                           const SubstepPrevState &prev_state,
+                          const broadphase::LeafID &leaf_id,
                           Velocity &vel)
 {
+    if (ctx.singleton<IslandState>().isAsleep(leaf_id)) {
+        return;
+    }
+
     const auto &physics_sys = ctx.singleton<PhysicsSystemState>();
     float h = physics_sys.h;
 
@@ -920,6 +986,15 @@ static inline void solveVelocitiesForContact(Context &ctx,
                                              float h,
                                              float restitution_threshold)
 {
+    bool immovable1 = isImmovable(ctx, contact.ref);
+    bool immovable2 = isImmovable(ctx, contact.alt);
+
+    // Nothing to solve between two bodies that can't move, like a sleeping
+    // body resting on kinematic geometry
+    if (immovable1 && immovable2) {
+        return;
+    }
+
     Velocity *v1_out = &ctx.getDirect<Velocity>(RGDCols::Velocity, contact.ref);
     Velocity *v2_out = &ctx.getDirect<Velocity>(RGDCols::Velocity, contact.alt);
 
@@ -939,11 +1014,6 @@ static inline void solveVelocitiesForContact(Context &ctx,
     ObjectID obj_id1 = ctx.getDirect<ObjectID>(RGDCols::ObjectID, contact.ref);
     ObjectID obj_id2 = ctx.getDirect<ObjectID>(RGDCols::ObjectID, contact.alt);
 
-    ResponseType resp_type1 = ctx.getDirect<ResponseType>(
-        RGDCols::ResponseType, contact.ref);
-    ResponseType resp_type2 = ctx.getDirect<ResponseType>(
-        RGDCols::ResponseType, contact.alt);
-
     RigidBodyMetadata metadata1 = obj_mgr.metadata[obj_id1.idx];
     RigidBodyMetadata metadata2 = obj_mgr.metadata[obj_id2.idx];
 
@@ -955,12 +1025,12 @@ static inline void solveVelocitiesForContact(Context &ctx,
     Vector3 inv_I1 = metadata1.mass.invInertiaTensor;
     Vector3 inv_I2 = metadata2.mass.invInertiaTensor;
 
-    if (resp_type1 == ResponseType::Static) {
+    if (immovable1) {
         inv_m1 = 0.f;
         inv_I1 = Vector3::zero();
     }
 
-    if (resp_type2 == ResponseType::Static) {
+    if (immovable2) {
         inv_m2 = 0.f;
         inv_I2 = Vector3::zero();
     }
@@ -975,6 +1045,11 @@ static inline void solveVelocitiesForContact(Context &ctx,
             return;
         }
 
+        // Speculative contact whose gap never closed during the substep
+        if (contact_pos_penetration <= 0.f && lambdaN[0] == 0.f) {
+            return;
+        }
+
         auto [r1, r2] = getLocalSpaceContacts(presolve_pos1, presolve_pos2,
             avg_contact_pos, contact_pos_penetration, contact.normal);
 
@@ -1009,10 +1084,7 @@ static inline void solveVelocitiesForContact(Context &ctx,
             vn_bar);
     }
 
-    float penetration_sum = 0.f;
-    for (CountT i = 0; i < contact.numPoints; i++) {
-        penetration_sum += contact.points[i].w;
-    }
+    float penetration_sum = getPenetrationSum(contact);
 
     for (CountT i = 0; i < contact.numPoints; i++) {
         auto [r1, r2] = getLocalSpaceContacts(presolve_pos1, presolve_pos2,
@@ -1031,7 +1103,8 @@ static inline void solveVelocitiesForContact(Context &ctx,
             mu_d, h,
             r1, r2,
             r1_world, r2_world,
-            lambdaN[0] * (contact.points[i].w / penetration_sum));
+            lambdaN[0] *
+                getContactPointWeight(contact, i, penetration_sum));
     }
 
     *v1_out = Velocity { v1, omega1 };
@@ -1051,6 +1124,584 @@ inline void solveVelocities(Context &ctx, SolverState &solver)
     });
 }
 
+#ifndef MADRONA_GPU_MODE
+struct ColoredContact {
+    ContactConstraint *contact;
+    XPBDContactState *state;
+};
+
+// Contacts grouped by color, see batch::colorContacts. Allocated with
+// tmpAlloc, so only valid for the current substep.
+struct ContactColoring {
+    ColoredContact *contacts;
+    CountT numContacts;
+    uint32_t colorOffsets[batch::numColorBuckets + 1];
+};
+
+struct BatchBody {
+    Loc loc;
+    bool immovable;
+    float invMass;
+    Vector3 invI;
+    RigidBodyMetadata metadata;
+};
+
+static inline batch::Vec3<float> toLanes(Vector3 v)
+{
+    return { v.x, v.y, v.z };
+}
+
+static inline batch::Quat4<float> toLanes(Quat q)
+{
+    return { q.w, q.x, q.y, q.z };
+}
+
+static inline Vector3 fromLanes(batch::Vec3<float> v)
+{
+    return { v.x, v.y, v.z };
+}
+
+static inline Quat fromLanes(batch::Quat4<float> q)
+{
+    return { q.w, q.x, q.y, q.z };
+}
+
+static inline BatchBody getBatchBody(Context &ctx,
+                                     const ObjectManager &obj_mgr,
+                                     Loc loc)
+{
+    ObjectID obj_id = ctx.getDirect<ObjectID>(RGDCols::ObjectID, loc);
+
+    RigidBodyMetadata metadata = obj_mgr.metadata[obj_id.idx];
+
+    bool immovable = isImmovable(ctx, loc);
+
+    return BatchBody {
+        .loc = loc,
+        .immovable = immovable,
+        .invMass = immovable ? 0.f : metadata.mass.invMass,
+        .invI = immovable ?
+            Vector3::zero() : metadata.mass.invInertiaTensor,
+        .metadata = metadata,
+    };
+}
+
+static ContactColoring colorContacts(Context &ctx, SolverState &solver_state)
+{
+    ContactColoring coloring;
+    coloring.numContacts = 0;
+
+    ctx.iterateQuery(solver_state.contactQuery,
+    [&](ContactConstraint &, XPBDContactState &) {
+        coloring.numContacts += 1;
+    });
+
+    const CountT num_contacts = coloring.numContacts;
+    if (num_contacts == 0) {
+        for (CountT i = 0; i <= batch::numColorBuckets; i++) {
+            coloring.colorOffsets[i] = 0;
+        }
+        coloring.contacts = nullptr;
+        return coloring;
+    }
+
+    const CountT num_bodies = ctx.singleton<broadphase::BVH>().numLeaves();
+
+    auto unsorted = (ColoredContact *)ctx.tmpAlloc(
+        sizeof(ColoredContact) * num_contacts);
+    auto body_a = (uint32_t *)ctx.tmpAlloc(sizeof(uint32_t) * num_contacts);
+    auto body_b = (uint32_t *)ctx.tmpAlloc(sizeof(uint32_t) * num_contacts);
+    auto colors = (uint32_t *)ctx.tmpAlloc(sizeof(uint32_t) * num_contacts);
+    auto sorted = (uint32_t *)ctx.tmpAlloc(sizeof(uint32_t) * num_contacts);
+    auto body_masks = (uint64_t *)ctx.tmpAlloc(sizeof(uint64_t) * num_bodies);
+
+    auto getBodyIdx = [&](Loc loc) {
+        if (isImmovable(ctx, loc)) {
+            return batch::staticBody;
+        }
+
+        return (uint32_t)ctx.getDirect<broadphase::LeafID>(
+            RGDCols::LeafID, loc).id;
+    };
+
+    CountT contact_idx = 0;
+    ctx.iterateQuery(solver_state.contactQuery,
+    [&](ContactConstraint &contact, XPBDContactState &contact_solver_state) {
+        unsorted[contact_idx] = { &contact, &contact_solver_state };
+        body_a[contact_idx] = getBodyIdx(contact.ref);
+        body_b[contact_idx] = getBodyIdx(contact.alt);
+        contact_idx += 1;
+    });
+
+    batch::colorContacts(body_a, body_b, num_contacts, num_bodies,
+                         body_masks, colors, sorted,
+                         coloring.colorOffsets);
+
+    coloring.contacts = (ColoredContact *)ctx.tmpAlloc(
+        sizeof(ColoredContact) * num_contacts);
+    for (CountT i = 0; i < num_contacts; i++) {
+        coloring.contacts[i] = unsorted[sorted[i]];
+    }
+
+    return coloring;
+}
+
+// Returns false for contacts handleContact would skip
+static inline bool gatherPositionRecord(Context &ctx,
+                                        const ObjectManager &obj_mgr,
+                                        const ContactConstraint &contact,
+                                        batch::PositionBatch<float> *out)
+{
+    Vector3 avg_contact_pos;
+    float contact_pos_penetration;
+    bool zero_separation = getAvgContact(
+        contact, &avg_contact_pos, &contact_pos_penetration);
+    if (zero_separation) {
+        return false;
+    }
+
+    BatchBody body1 = getBatchBody(ctx, obj_mgr, contact.ref);
+    BatchBody body2 = getBatchBody(ctx, obj_mgr, contact.alt);
+
+    if (body1.immovable && body2.immovable) {
+        return false;
+    }
+
+    SubstepPrevState prev1 = ctx.getDirect<SubstepPrevState>(
+        XPBDCols::SubstepPrevState, contact.ref);
+    SubstepPrevState prev2 = ctx.getDirect<SubstepPrevState>(
+        XPBDCols::SubstepPrevState, contact.alt);
+
+    PreSolvePositional presolve_pos1 = ctx.getDirect<PreSolvePositional>(
+        XPBDCols::PreSolvePositional, contact.ref);
+    PreSolvePositional presolve_pos2 = ctx.getDirect<PreSolvePositional>(
+        XPBDCols::PreSolvePositional, contact.alt);
+
+    auto [r1, r2] = getLocalSpaceContacts(
+        presolve_pos1, presolve_pos2,
+        avg_contact_pos, contact_pos_penetration, contact.normal);
+
+    Vector3 x1 = ctx.getDirect<Position>(RGDCols::Position, contact.ref);
+    Vector3 x2 = ctx.getDirect<Position>(RGDCols::Position, contact.alt);
+
+    Quat q1 = ctx.getDirect<Rotation>(RGDCols::Rotation, contact.ref);
+    Quat q2 = ctx.getDirect<Rotation>(RGDCols::Rotation, contact.alt);
+
+    *out = batch::PositionBatch<float> {
+        .x1 = toLanes(x1),
+        .x2 = toLanes(x2),
+        .q1 = toLanes(q1),
+        .q2 = toLanes(q2),
+        .prevX1 = toLanes(prev1.prevPosition),
+        .prevX2 = toLanes(prev2.prevPosition),
+        .prevQ1 = toLanes(prev1.prevRotation),
+        .prevQ2 = toLanes(prev2.prevRotation),
+        .invMass1 = body1.invMass,
+        .invMass2 = body2.invMass,
+        .invI1 = toLanes(body1.invI),
+        .invI2 = toLanes(body2.invI),
+        .r1 = toLanes(r1),
+        .r2 = toLanes(r2),
+        .normal = toLanes(contact.normal),
+        .muS = 0.5f * (body1.metadata.friction.muS +
+                       body2.metadata.friction.muS),
+        .lambdaN = 0.f,
+    };
+
+    return true;
+}
+
+static inline void scatterPositionRecord(
+    Context &ctx,
+    const ColoredContact &colored,
+    const batch::PositionBatch<float> &record)
+{
+    const ContactConstraint &contact = *colored.contact;
+
+    // Immovable bodies are never moved, skipping them also avoids racing
+    // writes from contacts of the same color sharing one
+    if (!isImmovable(ctx, contact.ref)) {
+        ctx.getDirect<Position>(RGDCols::Position, contact.ref) =
+            fromLanes(record.x1);
+        ctx.getDirect<Rotation>(RGDCols::Rotation, contact.ref) =
+            fromLanes(record.q1);
+    }
+
+    if (!isImmovable(ctx, contact.alt)) {
+        ctx.getDirect<Position>(RGDCols::Position, contact.alt) =
+            fromLanes(record.x2);
+        ctx.getDirect<Rotation>(RGDCols::Rotation, contact.alt) =
+            fromLanes(record.q2);
+    }
+
+    colored.state->lambdaN[0] = record.lambdaN;
+}
+
+// Returns false for contacts solveVelocitiesForContact would skip
+static inline bool gatherVelocityRecord(Context &ctx,
+                                        const ObjectManager &obj_mgr,
+                                        const ContactConstraint &contact,
+                                        const float lambdaN[4],
+                                        batch::VelocityBatch<float> *out)
+{
+    Vector3 avg_contact_pos;
+    float contact_pos_penetration;
+    bool zero_separation = getAvgContact(
+        contact, &avg_contact_pos, &contact_pos_penetration);
+    if (zero_separation) {
+        return false;
+    }
+
+    // Speculative contact whose gap never closed during the substep
+    if (contact_pos_penetration <= 0.f && lambdaN[0] == 0.f) {
+        return false;
+    }
+
+    BatchBody body1 = getBatchBody(ctx, obj_mgr, contact.ref);
+    BatchBody body2 = getBatchBody(ctx, obj_mgr, contact.alt);
+
+    if (body1.immovable && body2.immovable) {
+        return false;
+    }
+
+    Velocity vel1 = ctx.getDirect<Velocity>(RGDCols::Velocity, contact.ref);
+    Velocity vel2 = ctx.getDirect<Velocity>(RGDCols::Velocity, contact.alt);
+
+    Quat q1 = ctx.getDirect<Rotation>(RGDCols::Rotation, contact.ref);
+    Quat q2 = ctx.getDirect<Rotation>(RGDCols::Rotation, contact.alt);
+
+    PreSolvePositional presolve_pos1 = ctx.getDirect<PreSolvePositional>(
+        XPBDCols::PreSolvePositional, contact.ref);
+    PreSolvePositional presolve_pos2 = ctx.getDirect<PreSolvePositional>(
+        XPBDCols::PreSolvePositional, contact.alt);
+
+    PreSolveVelocity presolve_vel1 =
+        ctx.getDirect<PreSolveVelocity>(XPBDCols::PreSolveVelocity, contact.ref);
+    PreSolveVelocity presolve_vel2 =
+        ctx.getDirect<PreSolveVelocity>(XPBDCols::PreSolveVelocity, contact.alt);
+
+    auto [r1, r2] = getLocalSpaceContacts(presolve_pos1, presolve_pos2,
+        avg_contact_pos, contact_pos_penetration, contact.normal);
+
+    Vector3 v_bar = computeRelativeVelocity(
+        presolve_vel1.v, presolve_vel2.v,
+        presolve_vel1.omega, presolve_vel2.omega,
+        presolve_pos1.q.rotateVec(r1), presolve_pos2.q.rotateVec(r2));
+
+    *out = batch::VelocityBatch<float> {
+        .v1 = toLanes(vel1.linear),
+        .v2 = toLanes(vel2.linear),
+        .omega1 = toLanes(vel1.angular),
+        .omega2 = toLanes(vel2.angular),
+        .q1 = toLanes(q1),
+        .q2 = toLanes(q2),
+        .invMass1 = body1.invMass,
+        .invMass2 = body2.invMass,
+        .invI1 = toLanes(body1.invI),
+        .invI2 = toLanes(body2.invI),
+        .normal = toLanes(contact.normal),
+        .muD = 0.5f * (body1.metadata.friction.muD +
+                       body2.metadata.friction.muD),
+        .restitutionR1 = toLanes(r1),
+        .restitutionR2 = toLanes(r2),
+        .vnBar = dot(contact.normal, v_bar),
+        .frictionR1 = {},
+        .frictionR2 = {},
+        .frictionLambda = {},
+    };
+
+    float penetration_sum = getPenetrationSum(contact);
+
+    for (CountT i = 0; i < contact.numPoints; i++) {
+        auto [pt_r1, pt_r2] = getLocalSpaceContacts(
+            presolve_pos1, presolve_pos2,
+            contact.points[i].xyz(), contact.points[i].w, contact.normal);
+
+        out->frictionR1[i] = toLanes(pt_r1);
+        out->frictionR2[i] = toLanes(pt_r2);
+        out->frictionLambda[i] =
+            lambdaN[0] * getContactPointWeight(contact, i, penetration_sum);
+    }
+
+    return true;
+}
+
+static inline void scatterVelocityRecord(
+    Context &ctx,
+    const ContactConstraint &contact,
+    const batch::VelocityBatch<float> &record)
+{
+    if (!isImmovable(ctx, contact.ref)) {
+        ctx.getDirect<Velocity>(RGDCols::Velocity, contact.ref) = Velocity {
+            fromLanes(record.v1),
+            fromLanes(record.omega1),
+        };
+    }
+
+    if (!isImmovable(ctx, contact.alt)) {
+        ctx.getDirect<Velocity>(RGDCols::Velocity, contact.alt) = Velocity {
+            fromLanes(record.v2),
+            fromLanes(record.omega2),
+        };
+    }
+}
+
+// Contacts within a color share no dynamic bodies, so they can be gathered
+// and solved together. The overflow color has no such guarantee and is
+// solved one contact at a time.
+inline void solvePositionsBatched(Context &ctx, SolverState &solver_state)
+{
+    ObjectManager &obj_mgr = *ctx.singleton<ObjectData>().mgr;
+
+    ContactColoring coloring = colorContacts(ctx, solver_state);
+
+    if (coloring.numContacts > 0) {
+        auto records = (batch::PositionBatch<float> *)ctx.tmpAlloc(
+            sizeof(batch::PositionBatch<float>) * coloring.numContacts);
+        auto record_contacts = (uint32_t *)ctx.tmpAlloc(
+            sizeof(uint32_t) * coloring.numContacts);
+
+        for (CountT color = 0; color < batch::numColorBuckets; color++) {
+            const CountT color_start = coloring.colorOffsets[color];
+            const CountT color_end = coloring.colorOffsets[color + 1];
+            const CountT flush_size =
+                color == batch::overflowColor ? 1 : color_end - color_start;
+
+            CountT num_records = 0;
+            for (CountT i = color_start; i < color_end; i++) {
+                const ColoredContact &colored = coloring.contacts[i];
+
+                for (CountT j = 0; j < 4; j++) {
+                    colored.state->lambdaN[j] = 0.f;
+                }
+
+                if (gatherPositionRecord(ctx, obj_mgr, *colored.contact,
+                                         &records[num_records])) {
+                    record_contacts[num_records++] = (uint32_t)i;
+                }
+
+                if (num_records == flush_size || i == color_end - 1) {
+                    batch::solvePositionRecords(records, num_records);
+
+                    for (CountT j = 0; j < num_records; j++) {
+                        scatterPositionRecord(
+                            ctx, coloring.contacts[record_contacts[j]],
+                            records[j]);
+                    }
+
+                    num_records = 0;
+                }
+            }
+        }
+    }
+
+    ctx.iterateQuery(solver_state.jointQuery, [&](JointConstraint joint) {
+        handleJointConstraint(ctx, joint);
+    });
+}
+
+inline void solveVelocitiesBatched(Context &ctx, SolverState &solver)
+{
+    ObjectManager &obj_mgr = *ctx.singleton<ObjectData>().mgr;
+    PhysicsSystemState &physics_sys = ctx.singleton<PhysicsSystemState>();
+
+    ContactColoring coloring = colorContacts(ctx, solver);
+
+    if (coloring.numContacts == 0) {
+        return;
+    }
+
+    auto records = (batch::VelocityBatch<float> *)ctx.tmpAlloc(
+        sizeof(batch::VelocityBatch<float>) * coloring.numContacts);
+    auto record_contacts = (uint32_t *)ctx.tmpAlloc(
+        sizeof(uint32_t) * coloring.numContacts);
+
+    for (CountT color = 0; color < batch::numColorBuckets; color++) {
+        const CountT color_start = coloring.colorOffsets[color];
+        const CountT color_end = coloring.colorOffsets[color + 1];
+        const CountT flush_size =
+            color == batch::overflowColor ? 1 : color_end - color_start;
+
+        CountT num_records = 0;
+        for (CountT i = color_start; i < color_end; i++) {
+            const ColoredContact &colored = coloring.contacts[i];
+
+            if (gatherVelocityRecord(ctx, obj_mgr, *colored.contact,
+                                     colored.state->lambdaN,
+                                     &records[num_records])) {
+                record_contacts[num_records++] = (uint32_t)i;
+            }
+
+            if (num_records == flush_size || i == color_end - 1) {
+                batch::solveVelocityRecords(records, num_records,
+                    physics_sys.h, physics_sys.restitutionThreshold);
+
+                for (CountT j = 0; j < num_records; j++) {
+                    scatterVelocityRecord(
+                        ctx, *coloring.contacts[record_contacts[j]].contact,
+                        records[j]);
+                }
+
+                num_records = 0;
+            }
+        }
+    }
+}
+#endif
+
+#ifndef MADRONA_GPU_MODE
+// Runs all the substeps of a step for one world in a single node. Compared
+// to the per phase nodes, setVelocities for bodies without contacts is
+// merged into the next substep's integration pass, and the velocities of
+// bodies with contacts are computed right before the velocity solve that
+// reads them, so every body is streamed once per substep instead of twice.
+class FusedSubstepNode : public NodeBase {
+public:
+    inline FusedSubstepNode(CountT num_substeps, bool batched);
+
+    inline void run(Context &ctx, TaskGraph &taskgraph);
+
+private:
+    CountT num_substeps_;
+    bool batched_;
+};
+
+FusedSubstepNode::FusedSubstepNode(CountT num_substeps, bool batched)
+    : num_substeps_(num_substeps),
+      batched_(batched)
+{}
+
+static inline void setContactBodyVelocity(Context &ctx,
+                                          Loc loc,
+                                          uint8_t *velocity_set)
+{
+    broadphase::LeafID leaf_id =
+        ctx.getDirect<broadphase::LeafID>(RGDCols::LeafID, loc);
+
+    if (velocity_set[leaf_id.id]) {
+        return;
+    }
+    velocity_set[leaf_id.id] = 1;
+
+    setVelocities(ctx,
+        ctx.getDirect<Position>(RGDCols::Position, loc),
+        ctx.getDirect<Rotation>(RGDCols::Rotation, loc),
+        ctx.getDirect<SubstepPrevState>(XPBDCols::SubstepPrevState, loc),
+        leaf_id,
+        ctx.getDirect<Velocity>(RGDCols::Velocity, loc));
+}
+
+void FusedSubstepNode::run(Context &ctx, TaskGraph &taskgraph)
+{
+    SolverState &solver = ctx.singleton<SolverState>();
+    const CountT num_leaves = ctx.singleton<broadphase::BVH>().numLeaves();
+
+    ctx.iterateQuery(solver.bodyQuery, [&](
+            Position &pos, Rotation &rot, Velocity &vel, ObjectID &obj_id,
+            ResponseType &response_type, broadphase::LeafID &leaf_id,
+            ExternalForce &ext_force, ExternalTorque &ext_torque,
+            SubstepPrevState &prev_state, PreSolvePositional &presolve_pos,
+            PreSolveVelocity &presolve_vel) {
+        substepRigidBodies(ctx, pos, rot, vel, obj_id, response_type,
+                           leaf_id, ext_force, ext_torque, prev_state,
+                           presolve_pos, presolve_vel);
+    });
+
+    for (CountT i = 0; i < num_substeps_; i++) {
+        ctx.iterateQuery(solver.candidateQuery,
+        [&](CandidateCollision &candidate) {
+            narrowphase::runCandidate(ctx, candidate);
+        });
+        taskgraph.resetTmpAlloc();
+
+        if (batched_) {
+            solvePositionsBatched(ctx, solver);
+        } else {
+            solvePositions(ctx, solver);
+        }
+
+        auto velocity_set = (uint8_t *)ctx.tmpAlloc(
+            sizeof(uint8_t) * (num_leaves > 0 ? num_leaves : 1));
+        for (CountT j = 0; j < num_leaves; j++) {
+            velocity_set[j] = 0;
+        }
+
+        ctx.iterateQuery(solver.contactQuery,
+        [&](ContactConstraint &contact, XPBDContactState &) {
+            setContactBodyVelocity(ctx, contact.ref, velocity_set);
+            setContactBodyVelocity(ctx, contact.alt, velocity_set);
+        });
+
+        if (batched_) {
+            solveVelocitiesBatched(ctx, solver);
+        } else {
+            solveVelocities(ctx, solver);
+        }
+
+        // Bodies without contacts don't have their velocity touched by
+        // the velocity solve, so it can be set in the same pass that
+        // integrates the next substep
+        bool integrate_next = i + 1 < num_substeps_;
+
+        ctx.iterateQuery(solver.bodyQuery, [&](
+                Position &pos, Rotation &rot, Velocity &vel, ObjectID &obj_id,
+                ResponseType &response_type, broadphase::LeafID &leaf_id,
+                ExternalForce &ext_force, ExternalTorque &ext_torque,
+                SubstepPrevState &prev_state,
+                PreSolvePositional &presolve_pos,
+                PreSolveVelocity &presolve_vel) {
+            if (!velocity_set[leaf_id.id]) {
+                setVelocities(ctx, pos, rot, prev_state, leaf_id, vel);
+            }
+
+            if (integrate_next) {
+                substepRigidBodies(ctx, pos, rot, vel, obj_id, response_type,
+                                   leaf_id, ext_force, ext_torque, prev_state,
+                                   presolve_pos, presolve_vel);
+            }
+        });
+
+        taskgraph.clearTemporaries<Contact>();
+        taskgraph.resetTmpAlloc();
+    }
+}
+#endif
+
+static TaskGraphNodeID addSolvePositionsNode(TaskGraphBuilder &builder,
+                                             TaskGraphNodeID dep,
+                                             bool batched)
+{
+#ifndef MADRONA_GPU_MODE
+    if (batched) {
+        return builder.addToGraph<ParallelForNode<Context,
+            solvePositionsBatched, SolverState>>({dep});
+    }
+#else
+    // Contacts are already spread across threads on the GPU
+    (void)batched;
+#endif
+
+    return builder.addToGraph<ParallelForNode<Context,
+        solvePositions, SolverState>>({dep});
+}
+
+static TaskGraphNodeID addSolveVelocitiesNode(TaskGraphBuilder &builder,
+                                              TaskGraphNodeID dep,
+                                              bool batched)
+{
+#ifndef MADRONA_GPU_MODE
+    if (batched) {
+        return builder.addToGraph<ParallelForNode<Context,
+            solveVelocitiesBatched, SolverState>>({dep});
+    }
+#else
+    (void)batched;
+#endif
+
+    return builder.addToGraph<ParallelForNode<Context,
+        solveVelocities, SolverState>>({dep});
+}
+
 void registerTypes(ECSRegistry &registry)
 {
     registry.registerComponent<SubstepPrevState>();
@@ -1072,6 +1723,12 @@ void init(Context &ctx)
     ctx.singleton<SolverState>() = {
         .jointQuery = ctx.query<JointConstraint>(),
         .contactQuery = ctx.query<ContactConstraint, XPBDContactState>(),
+#ifndef MADRONA_GPU_MODE
+        .bodyQuery = ctx.query<Position, Rotation, Velocity, ObjectID,
+            ResponseType, broadphase::LeafID, ExternalForce, ExternalTorque,
+            SubstepPrevState, PreSolvePositional, PreSolveVelocity>(),
+        .candidateQuery = ctx.query<CandidateCollision>(),
+#endif
     };
 }
 
@@ -1085,10 +1742,25 @@ void getSolverArchetypeIDs(uint32_t *contact_archetype_id,
 TaskGraphNodeID setupXPBDSolverTasks(
     TaskGraphBuilder &builder,
     TaskGraphNodeID broadphase,
-    CountT num_substeps)
+    CountT num_substeps,
+    bool batched,
+    bool fused)
 {
     auto cur_node = broadphase;
 
+#ifndef MADRONA_GPU_MODE
+    if (fused) {
+        cur_node = builder.addDefaultNode<FusedSubstepNode>(
+            {cur_node}, num_substeps, batched);
+
+        return builder.addToGraph<
+            ClearTmpNode<CandidateTemporary>>({cur_node});
+    }
+#else
+    // The GPU backend already spreads each phase across all worlds
+    (void)fused;
+#endif
+
 #ifdef MADRONA_GPU_MODE
     cur_node = 
         builder.addToGraph<SortArchetypeNode<Joint, WorldID>>({cur_node});
@@ -1098,7 +1770,7 @@ TaskGraphNodeID setupXPBDSolverTasks(
     for (CountT i = 0; i < num_substeps; i++) {
         auto rgb_update = builder.addToGraph<ParallelForNode<Context,
             substepRigidBodies, Position, Rotation, Velocity, ObjectID,
-            ResponseType, ExternalForce, ExternalTorque,
+            ResponseType, broadphase::LeafID, ExternalForce, ExternalTorque,
             SubstepPrevState, PreSolvePositional,
             PreSolveVelocity>>({cur_node});
 
@@ -1112,16 +1784,14 @@ TaskGraphNodeID setupXPBDSolverTasks(
             {run_narrowphase});
 #endif
 
-        auto solve_pos = builder.addToGraph<ParallelForNode<Context,
-            solvePositions, SolverState>>(
-                {run_narrowphase});
+        auto solve_pos = addSolvePositionsNode(
+            builder, run_narrowphase, batched);
 
         auto vel_set = builder.addToGraph<ParallelForNode<Context,
             setVelocities, Position, Rotation,
-            SubstepPrevState, Velocity>>({solve_pos});
+            SubstepPrevState, broadphase::LeafID, Velocity>>({solve_pos});
 
-        auto solve_vel = builder.addToGraph<ParallelForNode<Context,
-            solveVelocities, SolverState>>({vel_set});
+        auto solve_vel = addSolveVelocitiesNode(builder, vel_set, batched);
 
         auto clear_contacts = builder.addToGraph<
             ClearTmpNode<Contact>>({solve_vel});
@@ -14,6 +14,8 @@ void init(Context &ctx);
 TaskGraphNodeID setupXPBDSolverTasks(
     TaskGraphBuilder &builder,
     TaskGraphNodeID broadphase,
-    CountT num_substeps);
+    CountT num_substeps,
+    bool batched,
+    bool fused);
 
 }
@@ -0,0 +1,710 @@
+#pragma once
+
+#include <madrona/macros.hpp>
+#include <madrona/types.hpp>
+
+#include <cmath>
+#include <cstdint>
+
+#if defined(MADRONA_X64) && defined(__AVX2__) && defined(__FMA__)
+#define MADRONA_XPBD_BATCH_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace madrona::phys::xpbd::batch {
+
+/*
+Graph colored, batched versions of the XPBD contact solve. This is intended
+to be a private implementation file for xpbd.cpp, but factored out into a
+header so the kernels and the coloring can be unit tested without the ECS.
+
+Contacts are greedily colored so no two contacts of the same color share a
+non-static body. Within a color, contacts are independent, so they're
+gathered into structure of arrays batches, solved side by side across the
+lanes of a register, and scattered back. Static bodies never receive
+updates, so they don't constrain the coloring.
+
+The kernels are written once against a lane type F: float runs one contact
+at a time (used for the overflow color and when AVX2 isn't available), and
+Float8 runs 8 contacts per AVX2 register. The math mirrors the scalar
+functions in xpbd.cpp formula for formula; lanes where the scalar code
+would early out are left untouched with blend() rather than branches.
+*/
+
+// Used color bits per body. Contacts that can't get a color below this are
+// put in the overflow color and solved one at a time.
+constexpr inline CountT maxColors = 64;
+constexpr inline CountT overflowColor = maxColors;
+constexpr inline CountT numColorBuckets = maxColors + 1;
+constexpr inline uint32_t staticBody = 0xFFFF'FFFF;
+
+template <typename F>
+struct Vec3 {
+    F x, y, z;
+};
+
+template <typename F>
+struct Quat4 {
+    F w, x, y, z;
+};
+
+inline float blend(bool m, float a, float b)
+{
+    return m ? a : b;
+}
+
+inline float laneSqrt(float a)
+{
+    return sqrtf(a);
+}
+
+inline float laneMin(float a, float b)
+{
+    return fminf(a, b);
+}
+
+inline float laneAbs(float a)
+{
+    return fabsf(a);
+}
+
+#ifdef MADRONA_XPBD_BATCH_AVX2
+constexpr inline CountT numLanes = 8;
+
+struct Mask8 {
+    __m256 v;
+};
+
+struct Float8 {
+    __m256 v;
+
+    Float8() = default;
+    Float8(__m256 o) : v(o) {}
+    Float8(float f) : v(_mm256_set1_ps(f)) {}
+};
+
+inline Float8 operator+(Float8 a, Float8 b)
+{
+    return _mm256_add_ps(a.v, b.v);
+}
+
+inline Float8 operator-(Float8 a, Float8 b)
+{
+    return _mm256_sub_ps(a.v, b.v);
+}
+
+inline Float8 operator*(Float8 a, Float8 b)
+{
+    return _mm256_mul_ps(a.v, b.v);
+}
+
+inline Float8 operator/(Float8 a, Float8 b)
+{
+    return _mm256_div_ps(a.v, b.v);
+}
+
+inline Float8 operator-(Float8 a)
+{
+    return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.f));
+}
+
+inline Mask8 operator<(Float8 a, Float8 b)
+{
+    return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) };
+}
+
+inline Mask8 operator<=(Float8 a, Float8 b)
+{
+    return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) };
+}
+
+inline Mask8 operator>(Float8 a, Float8 b)
+{
+    return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) };
+}
+
+inline Mask8 operator==(Float8 a, Float8 b)
+{
+    return { _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ) };
+}
+
+// Unordered, so NaN lanes compare not equal like they do for scalars
+inline Mask8 operator!=(Float8 a, Float8 b)
+{
+    return { _mm256_cmp_ps(a.v, b.v, _CMP_NEQ_UQ) };
+}
+
+inline Mask8 operator&(Mask8 a, Mask8 b)
+{
+    return { _mm256_and_ps(a.v, b.v) };
+}
+
+inline Float8 blend(Mask8 m, Float8 a, Float8 b)
+{
+    return _mm256_blendv_ps(b.v, a.v, m.v);
+}
+
+inline Float8 laneSqrt(Float8 a)
+{
+    return _mm256_sqrt_ps(a.v);
+}
+
+// Matches fminf when b is NaN, _mm256_min_ps returns its second operand
+inline Float8 laneMin(Float8 a, Float8 b)
+{
+    return _mm256_min_ps(b.v, a.v);
+}
+
+inline Float8 laneAbs(Float8 a)
+{
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a.v);
+}
+#else
+constexpr inline CountT numLanes = 1;
+#endif
+
+template <typename F>
+using MaskOf = decltype(F() > F());
+
+template <typename F>
+inline Vec3<F> operator+(Vec3<F> a, Vec3<F> b)
+{
+    return { a.x + b.x, a.y + b.y, a.z + b.z };
+}
+
+template <typename F>
+inline Vec3<F> operator-(Vec3<F> a, Vec3<F> b)
+{
+    return { a.x - b.x, a.y - b.y, a.z - b.z };
+}
+
+template <typename F>
+inline Vec3<F> operator-(Vec3<F> a)
+{
+    return { -a.x, -a.y, -a.z };
+}
+
+template <typename F>
+inline Vec3<F> operator*(Vec3<F> a, F b)
+{
+    return { a.x * b, a.y * b, a.z * b };
+}
+
+template <typename F>
+inline Vec3<F> operator*(F a, Vec3<F> b)
+{
+    return b * a;
+}
+
+template <typename F>
+inline F dot(Vec3<F> a, Vec3<F> b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+template <typename F>
+inline Vec3<F> cross(Vec3<F> a, Vec3<F> b)
+{
+    return {
+        a.y * b.z - a.z * b.y,
+        a.z * b.x - a.x * b.z,
+        a.x * b.y - a.y * b.x,
+    };
+}
+
+template <typename F>
+inline Vec3<F> multDiag(Vec3<F> diag, Vec3<F> v)
+{
+    return { diag.x * v.x, diag.y * v.y, diag.z * v.z };
+}
+
+template <typename F>
+inline F length(Vec3<F> v)
+{
+    return laneSqrt(dot(v, v));
+}
+
+template <typename F>
+inline Vec3<F> blend(MaskOf<F> m, Vec3<F> a, Vec3<F> b)
+{
+    return { blend(m, a.x, b.x), blend(m, a.y, b.y), blend(m, a.z, b.z) };
+}
+
+template <typename F>
+inline Quat4<F> blend(MaskOf<F> m, Quat4<F> a, Quat4<F> b)
+{
+    return {
+        blend(m, a.w, b.w),
+        blend(m, a.x, b.x),
+        blend(m, a.y, b.y),
+        blend(m, a.z, b.z),
+    };
+}
+
+template <typename F>
+inline Quat4<F> inv(Quat4<F> q)
+{
+    return { q.w, -q.x, -q.y, -q.z };
+}
+
+template <typename F>
+inline Vec3<F> rotate(Quat4<F> q, Vec3<F> v)
+{
+    Vec3<F> pure { q.x, q.y, q.z };
+
+    Vec3<F> pure_x_v = cross(pure, v);
+    Vec3<F> pure_x_pure_x_v = cross(pure, pure_x_v);
+
+    return v + F(2.f) * ((pure_x_v * q.w) + pure_x_pure_x_v);
+}
+
+// Quat::fromAngularVec(u) * q
+template <typename F>
+inline Quat4<F> pureMul(Vec3<F> u, Quat4<F> q)
+{
+    return {
+        (F(0.f) * q.w - u.x * q.x - u.y * q.y - u.z * q.z),
+        (F(0.f) * q.x + u.x * q.w + u.y * q.z - u.z * q.y),
+        (F(0.f) * q.y - u.x * q.z + u.y * q.w + u.z * q.x),
+        (F(0.f) * q.z + u.x * q.y - u.y * q.x + u.z * q.w),
+    };
+}
+
+template <typename F>
+inline Quat4<F> normalize(Quat4<F> q)
+{
+    F inv_length = F(1.f) /
+        laneSqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+
+    return { q.w * inv_length, q.x * inv_length,
+             q.y * inv_length, q.z * inv_length };
+}
+
+// Per contact inputs to the position solve. Body 1 is contact.ref. r1 and
+// r2 are the averaged contact point in each body's presolve local space,
+// and inverse mass / inertia are already zeroed for static bodies.
+template <typename F>
+struct PositionBatch {
+    Vec3<F> x1, x2;
+    Quat4<F> q1, q2;
+    Vec3<F> prevX1, prevX2;
+    Quat4<F> prevQ1, prevQ2;
+    F invMass1, invMass2;
+    Vec3<F> invI1, invI2;
+    Vec3<F> r1, r2;
+    Vec3<F> normal;
+    F muS;
+    // Output, lambdaN[0] of the contact
+    F lambdaN;
+};
+
+constexpr inline CountT maxFrictionPoints = 4;
+
+// Per contact inputs to the velocity solve. vnBar and the restitution
+// contact point are computed from presolve state during the gather, which
+// also drops the contacts the scalar code skips entirely.
+// Friction points past the contact's numPoints have a zero lambda, which
+// makes them no-ops like in the scalar loop.
+template <typename F>
+struct VelocityBatch {
+    Vec3<F> v1, v2;
+    Vec3<F> omega1, omega2;
+    Quat4<F> q1, q2;
+    F invMass1, invMass2;
+    Vec3<F> invI1, invI2;
+    Vec3<F> normal;
+    F muD;
+    Vec3<F> restitutionR1, restitutionR2;
+    F vnBar;
+    Vec3<F> frictionR1[maxFrictionPoints];
+    Vec3<F> frictionR2[maxFrictionPoints];
+    F frictionLambda[maxFrictionPoints];
+};
+
+template <typename F>
+struct UpdateState {
+    Vec3<F> x1, x2;
+    Quat4<F> q1, q2;
+};
+
+template <typename F>
+inline void applyPositionalUpdate(UpdateState<F> &s,
+                                  Vec3<F> rot_axis_local1,
+                                  Vec3<F> rot_axis_local2,
+                                  F inv_m1, F inv_m2,
+                                  Vec3<F> n,
+                                  F delta_lambda)
+{
+    s.x1 = s.x1 + (delta_lambda * inv_m1) * n;
+    s.x2 = s.x2 - (delta_lambda * inv_m2) * n;
+
+    F half_lambda = F(0.5f) * delta_lambda;
+
+    Vec3<F> q1_update_angular = rotate(s.q1, half_lambda * rot_axis_local1);
+    Vec3<F> q2_update_angular = rotate(s.q2, half_lambda * rot_axis_local2);
+
+    Quat4<F> q1_delta = pureMul(q1_update_angular, s.q1);
+    Quat4<F> q2_delta = pureMul(q2_update_angular, s.q2);
+
+    s.q1 = normalize(Quat4<F> {
+        s.q1.w + q1_delta.w, s.q1.x + q1_delta.x,
+        s.q1.y + q1_delta.y, s.q1.z + q1_delta.z,
+    });
+
+    s.q2 = normalize(Quat4<F> {
+        s.q2.w - q2_delta.w, s.q2.x - q2_delta.x,
+        s.q2.y - q2_delta.y, s.q2.z - q2_delta.z,
+    });
+}
+
+template <typename F>
+inline void solveContactPositions(PositionBatch<F> &b)
+{
+    UpdateState<F> s { b.x1, b.x2, b.q1, b.q2 };
+
+    Vec3<F> p1 = rotate(s.q1, b.r1) + s.x1;
+    Vec3<F> p2 = rotate(s.q2, b.r2) + s.x2;
+
+    F d = dot(p1 - p2, b.normal);
+    MaskOf<F> active = d > F(0.f);
+
+    F lambda_n;
+    {
+        Vec3<F> n_local1 = rotate(inv(s.q1), b.normal);
+        Vec3<F> n_local2 = rotate(inv(s.q2), b.normal);
+
+        Vec3<F> torque_axis1 = cross(b.r1, n_local1);
+        Vec3<F> torque_axis2 = cross(b.r2, n_local2);
+
+        Vec3<F> rot_axis1 = multDiag(b.invI1, torque_axis1);
+        Vec3<F> rot_axis2 = multDiag(b.invI2, torque_axis2);
+
+        F w1 = b.invMass1 + dot(torque_axis1, rot_axis1);
+        F w2 = b.invMass2 + dot(torque_axis2, rot_axis2);
+
+        lambda_n = -d / (w1 + w2 + F(0.f));
+
+        applyPositionalUpdate(s, rot_axis1, rot_axis2,
+                              b.invMass1, b.invMass2, b.normal, lambda_n);
+    }
+
+    Vec3<F> p1_hat = rotate(b.prevQ1, b.r1) + b.prevX1;
+    Vec3<F> p2_hat = rotate(b.prevQ2, b.r2) + b.prevX2;
+
+    p1 = rotate(s.q1, b.r1) + s.x1;
+    p2 = rotate(s.q2, b.r2) + s.x2;
+
+    Vec3<F> delta_p = (p1 - p1_hat) - (p2 - p2_hat);
+    Vec3<F> delta_p_t = delta_p - dot(delta_p, b.normal) * b.normal;
+
+    F tangential_magnitude = length(delta_p_t);
+    MaskOf<F> has_tangent = tangential_magnitude > F(0.f);
+
+    Vec3<F> t_world = delta_p_t * (F(1.f) /
+        blend(has_tangent, tangential_magnitude, F(1.f)));
+    Vec3<F> t_local1 = rotate(inv(s.q1), t_world);
+    Vec3<F> t_local2 = rotate(inv(s.q2), t_world);
+
+    Vec3<F> friction_torque_axis1 = cross(b.r1, t_local1);
+    Vec3<F> friction_torque_axis2 = cross(b.r2, t_local2);
+
+    Vec3<F> friction_rot_axis1 = multDiag(b.invI1, friction_torque_axis1);
+    Vec3<F> friction_rot_axis2 = multDiag(b.invI2, friction_torque_axis2);
+
+    F fw1 = b.invMass1 + dot(friction_torque_axis1, friction_rot_axis1);
+    F fw2 = b.invMass2 + dot(friction_torque_axis2, friction_rot_axis2);
+
+    F lambda_t = -tangential_magnitude / (fw1 + fw2 + F(0.f));
+
+    MaskOf<F> apply_friction =
+        has_tangent & (lambda_t > lambda_n * b.muS);
+
+    UpdateState<F> friction_s = s;
+    applyPositionalUpdate(friction_s, friction_rot_axis1, friction_rot_axis2,
+                          b.invMass1, b.invMass2, t_world, lambda_t);
+
+    s.x1 = blend(apply_friction, friction_s.x1, s.x1);
+    s.x2 = blend(apply_friction, friction_s.x2, s.x2);
+    s.q1 = blend(apply_friction, friction_s.q1, s.q1);
+    s.q2 = blend(apply_friction, friction_s.q2, s.q2);
+
+    b.x1 = blend(active, s.x1, b.x1);
+    b.x2 = blend(active, s.x2, b.x2);
+    b.q1 = blend(active, s.q1, b.q1);
+    b.q2 = blend(active, s.q2, b.q2);
+    b.lambdaN = blend(active, lambda_n, F(0.f));
+}
+
+template <typename F>
+struct VelocityState {
+    Vec3<F> v1, v2;
+    Vec3<F> omega1, omega2;
+};
+
+template <typename F>
+inline Vec3<F> relativeVelocity(const VelocityState<F> &s,
+                                Vec3<F> r1_world, Vec3<F> r2_world)
+{
+    return (s.v1 + cross(s.omega1, r1_world)) -
+        (s.v2 + cross(s.omega2, r2_world));
+}
+
+template <typename F>
+inline void applyImpulse(VelocityState<F> &s,
+                         MaskOf<F> mask,
+                         Quat4<F> q1, Quat4<F> q2,
+                         F inv_m1, F inv_m2,
+                         Vec3<F> dir,
+                         Vec3<F> rot_axis_local1,
+                         Vec3<F> rot_axis_local2,
+                         F impulse_magnitude)
+{
+    Vec3<F> v1 = s.v1 + dir * impulse_magnitude * inv_m1;
+    Vec3<F> v2 = s.v2 - dir * impulse_magnitude * inv_m2;
+
+    Vec3<F> omega1 = s.omega1 +
+        rotate(q1, impulse_magnitude * rot_axis_local1);
+    Vec3<F> omega2 = s.omega2 -
+        rotate(q2, impulse_magnitude * rot_axis_local2);
+
+    s.v1 = blend(mask, v1, s.v1);
+    s.v2 = blend(mask, v2, s.v2);
+    s.omega1 = blend(mask, omega1, s.omega1);
+    s.omega2 = blend(mask, omega2, s.omega2);
+}
+
+template <typename F>
+inline void solveContactVelocities(VelocityBatch<F> &b,
+                                   float h,
+                                   float restitution_threshold)
+{
+    VelocityState<F> s { b.v1, b.v2, b.omega1, b.omega2 };
+
+    {
+        Vec3<F> r1_world = rotate(b.q1, b.restitutionR1);
+        Vec3<F> r2_world = rotate(b.q2, b.restitutionR2);
+
+        Vec3<F> torque_axis1 =
+            cross(b.restitutionR1, rotate(inv(b.q1), b.normal));
+        Vec3<F> torque_axis2 =
+            cross(b.restitutionR2, rotate(inv(b.q2), b.normal));
+
+        F vn = dot(b.normal, relativeVelocity(s, r1_world, r2_world));
+
+        F e = blend(laneAbs(b.vnBar) <= F(restitution_threshold),
+                    F(0.f), F(0.3f));
+
+        F restitution_magnitude = laneMin(-e * b.vnBar, F(0.f)) - vn;
+
+        Vec3<F> rot_axis1 = multDiag(b.invI1, torque_axis1);
+        Vec3<F> rot_axis2 = multDiag(b.invI2, torque_axis2);
+
+        F w1 = b.invMass1 + dot(torque_axis1, rot_axis1);
+        F w2 = b.invMass2 + dot(torque_axis2, rot_axis2);
+
+        F impulse_magnitude =
+            restitution_magnitude * (F(1.f) / (w1 + w2));
+
+        applyImpulse(s, impulse_magnitude != F(0.f),
+                     b.q1, b.q2, b.invMass1, b.invMass2, b.normal,
+                     rot_axis1, rot_axis2, impulse_magnitude);
+    }
+
+    for (CountT i = 0; i < maxFrictionPoints; i++) {
+        Vec3<F> r1 = b.frictionR1[i];
+        Vec3<F> r2 = b.frictionR2[i];
+
+        Vec3<F> v = relativeVelocity(s, rotate(b.q1, r1), rotate(b.q2, r2));
+
+        F vn = dot(b.normal, v);
+        Vec3<F> vt = v - b.normal * vn;
+
+        F vt_len = length(vt);
+        MaskOf<F> has_tangent = vt_len != F(0.f);
+
+        Vec3<F> delta_world =
+            vt * (F(1.f) / blend(has_tangent, vt_len, F(1.f)));
+
+        Vec3<F> torque_axis1 = cross(r1, rotate(inv(b.q1), delta_world));
+        Vec3<F> torque_axis2 = cross(r2, rotate(inv(b.q2), delta_world));
+
+        Vec3<F> rot_axis1 = multDiag(b.invI1, torque_axis1);
+        Vec3<F> rot_axis2 = multDiag(b.invI2, torque_axis2);
+
+        F w1 = b.invMass1 + dot(torque_axis1, rot_axis1);
+        F w2 = b.invMass2 + dot(torque_axis2, rot_axis2);
+
+        F inv_mass_scale = F(1.f) / (w1 + w2);
+
+        F dynamic_friction_magnitude =
+            b.muD * laneAbs(b.frictionLambda[i]) * inv_mass_scale / F(h);
+
+        F corrected_magnitude = -laneMin(dynamic_friction_magnitude, vt_len);
+
+        F impulse_magnitude = corrected_magnitude * inv_mass_scale;
+
+        applyImpulse(s, has_tangent & (impulse_magnitude != F(0.f)),
+                     b.q1, b.q2, b.invMass1, b.invMass2, delta_world,
+                     rot_axis1, rot_axis2, impulse_magnitude);
+    }
+
+    b.v1 = s.v1;
+    b.v2 = s.v2;
+    b.omega1 = s.omega1;
+    b.omega2 = s.omega2;
+}
+
+#ifdef MADRONA_XPBD_BATCH_AVX2
+// Transposes up to 8 per contact records into one batch. Missing lanes are
+// filled with copies of the first record and their results are dropped by
+// storeLanes.
+template <template <typename> class BatchT>
+inline void loadLanes(const BatchT<float> *records,
+                      CountT num_records,
+                      BatchT<Float8> *out)
+{
+    constexpr CountT num_fields = sizeof(BatchT<float>) / sizeof(float);
+    static_assert(sizeof(BatchT<Float8>) == sizeof(Float8) * num_fields);
+
+    const float *src = (const float *)records;
+    float *dst = (float *)out;
+
+    for (CountT lane = 0; lane < numLanes; lane++) {
+        CountT record_idx = lane < num_records ? lane : 0;
+        const float *record = src + record_idx * num_fields;
+
+        for (CountT field = 0; field < num_fields; field++) {
+            dst[field * numLanes + lane] = record[field];
+        }
+    }
+}
+
+template <template <typename> class BatchT>
+inline void storeLanes(const BatchT<Float8> &batch,
+                       CountT num_records,
+                       BatchT<float> *records)
+{
+    constexpr CountT num_fields = sizeof(BatchT<float>) / sizeof(float);
+
+    const float *src = (const float *)&batch;
+    float *dst = (float *)records;
+
+    for (CountT lane = 0; lane < num_records; lane++) {
+        float *record = dst + lane * num_fields;
+
+        for (CountT field = 0; field < num_fields; field++) {
+            record[field] = src[field * numLanes + lane];
+        }
+    }
+}
+#endif
+
+// Solves num_records independent contacts, numLanes at a time
+inline void solvePositionRecords(PositionBatch<float> *records,
+                                 CountT num_records)
+{
+#ifdef MADRONA_XPBD_BATCH_AVX2
+    for (CountT base = 0; base < num_records; base += numLanes) {
+        CountT num_lanes = num_records - base < numLanes ?
+            num_records - base : numLanes;
+
+        PositionBatch<Float8> batch;
+        loadLanes(records + base, num_lanes, &batch);
+        solveContactPositions(batch);
+        storeLanes(batch, num_lanes, records + base);
+    }
+#else
+    for (CountT i = 0; i < num_records; i++) {
+        solveContactPositions(records[i]);
+    }
+#endif
+}
+
+inline void solveVelocityRecords(VelocityBatch<float> *records,
+                                 CountT num_records,
+                                 float h,
+                                 float restitution_threshold)
+{
+#ifdef MADRONA_XPBD_BATCH_AVX2
+    for (CountT base = 0; base < num_records; base += numLanes) {
+        CountT num_lanes = num_records - base < numLanes ?
+            num_records - base : numLanes;
+
+        VelocityBatch<Float8> batch;
+        loadLanes(records + base, num_lanes, &batch);
+        solveContactVelocities(batch, h, restitution_threshold);
+        storeLanes(batch, num_lanes, records + base);
+    }
+#else
+    for (CountT i = 0; i < num_records; i++) {
+        solveContactVelocities(records[i], h, restitution_threshold);
+    }
+#endif
+}
+
+// Greedy coloring of the contact graph. body_a / body_b are per contact
+// body indices less than num_bodies, or staticBody. body_masks is scratch
+// space for num_bodies entries. Writes contact indices grouped by color to
+// sorted_out, with color c occupying
+// [color_offsets_out[c], color_offsets_out[c + 1]). Contacts keep their
+// relative order within a color, so results only depend on the input order.
+inline void colorContacts(const uint32_t *body_a,
+                          const uint32_t *body_b,
+                          CountT num_contacts,
+                          CountT num_bodies,
+                          uint64_t *body_masks,
+                          uint32_t *colors_tmp,
+                          uint32_t *sorted_out,
+                          uint32_t *color_offsets_out)
+{
+    for (CountT i = 0; i < num_bodies; i++) {
+        body_masks[i] = 0;
+    }
+
+    uint32_t color_counts[numColorBuckets] = {};
+
+    for (CountT i = 0; i < num_contacts; i++) {
+        uint32_t a = body_a[i];
+        uint32_t b = body_b[i];
+
+        uint64_t used = 0;
+        if (a != staticBody) {
+            used |= body_masks[a];
+        }
+        if (b != staticBody) {
+            used |= body_masks[b];
+        }
+
+        uint32_t color;
+        if (used == ~0_u64) {
+            color = overflowColor;
+        } else {
+            color = (uint32_t)__builtin_ctzll(~used);
+            uint64_t bit = 1_u64 << color;
+
+            if (a != staticBody) {
+                body_masks[a] |= bit;
+            }
+            if (b != staticBody) {
+                body_masks[b] |= bit;
+            }
+        }
+
+        colors_tmp[i] = color;
+        color_counts[color]++;
+    }
+
+    uint32_t offset = 0;
+    for (CountT c = 0; c < numColorBuckets; c++) {
+        color_offsets_out[c] = offset;
+        offset += color_counts[c];
+        color_counts[c] = color_offsets_out[c];
+    }
+    color_offsets_out[numColorBuckets] = offset;
+
+    for (CountT i = 0; i < num_contacts; i++) {
+        sorted_out[color_counts[colors_tmp[i]]++] = (uint32_t)i;
+    }
+}
+
+}
@@ -604,10 +604,11 @@ static void makeBatchFrame(vk::Device& dev,
     VkDeviceSize instance_size = (cfg.numWorlds * cfg.maxInstancesPerWorld) * sizeof(InstanceData);
     vk::LocalBuffer instances = alloc.makeLocalBuffer(instance_size).value();
 
-    VkDeviceSize instance_offset_size = (cfg.numWorlds) * sizeof(uint32_t);
+    // One offset per world, plus the total at the end
+    VkDeviceSize instance_offset_size = (cfg.numWorlds + 1) * sizeof(uint32_t);
     vk::LocalBuffer instance_offsets = alloc.makeLocalBuffer(instance_offset_size).value();
 
-    VkDeviceSize view_offset_size = (cfg.numWorlds) * sizeof(uint32_t);
+    VkDeviceSize view_offset_size = (cfg.numWorlds + 1) * sizeof(uint32_t);
     vk::LocalBuffer view_offsets = alloc.makeLocalBuffer(view_offset_size).value();
 
     VkCommandPool prepare_cmdpool = vk::makeCmdPool(dev, dev.gfxQF);
@@ -1324,85 +1325,64 @@ static void issueMemoryBarrier(vk::Device &dev,
                               0, nullptr, 0, nullptr);
 }
 
-static void sortInstancesAndViewsCPU(EngineInterop *interop)
+// On the CPU backend each world writes its instances and views directly into
+// its own fixed size range of the staging buffers (see
+// RenderingSystem::init). Rather than packing those ranges on the CPU, build
+// one copy region per world that moves its filled slots to their packed
+// location in the GPU buffer, so the transfer itself does the compaction.
+// Consecutive regions that are contiguous on both sides (the preceding
+// world was full) are merged. Also writes the per world offsets and returns
+// the total element count. world_copies selects which of the two staging
+// copies each world exported (see RenderECSBridge::exportedCopyCPU).
+static uint32_t buildWorldCopyRegionsCPU(const uint32_t *world_counts,
+                                         const uint32_t *world_copies,
+                                         uint32_t max_per_world,
+                                         VkDeviceSize elem_bytes,
+                                         uint32_t num_worlds,
+                                         VkBufferCopy *out_regions,
+                                         uint32_t *out_num_regions,
+                                         uint32_t *out_offsets)
 {
-    for (uint32_t i = 0; i < *interop->bridge.totalNumInstances; ++i) {
-        interop->iotaArrayInstancesCPU[i] = i;
-    }
-
-    for (uint32_t i = 0; i < *interop->bridge.totalNumViews; ++i) {
-        interop->iotaArrayViewsCPU[i] = i;
-    }
-
-    { // Sort the indices based on worldID/entityID number
-        std::sort(interop->iotaArrayInstancesCPU, 
-                  interop->iotaArrayInstancesCPU + *interop->bridge.totalNumInstances,
-                  [&interop] (uint32_t a, uint32_t b) {
-                      return interop->bridge.instancesWorldIDs[a] < interop->bridge.instancesWorldIDs[b];
-                  });
-
-        std::sort(interop->iotaArrayViewsCPU,
-                  interop->iotaArrayViewsCPU + *interop->bridge.totalNumViews,
-                  [&interop] (uint32_t a, uint32_t b) {
-                      return interop->bridge.viewsWorldIDs[a] < interop->bridge.viewsWorldIDs[b];
-                  });
-    }
-
-    InstanceData *instances = (InstanceData *)interop->instancesCPU->ptr;
-    PerspectiveCameraData *views = (PerspectiveCameraData *)interop->viewsCPU->ptr;
-
-    { // Write the sorted array of views and instances
-        for (uint32_t i = 0; i < *interop->bridge.totalNumInstances; ++i) {
-            instances[i] = interop->bridge.instances[interop->iotaArrayInstancesCPU[i]];
-
-            // We also need to have the sorted instance IDs in order to extract the offsets
-            interop->sortedInstanceWorldIDs[i] = 
-                interop->bridge.instancesWorldIDs[interop->iotaArrayInstancesCPU[i]];
-        }
-
-        for (uint32_t i = 0; i < *interop->bridge.totalNumViews; ++i) {
-            views[i] = interop->bridge.views[interop->iotaArrayViewsCPU[i]];
-
-            interop->sortedViewWorldIDs[i] = 
-                interop->bridge.viewsWorldIDs[interop->iotaArrayViewsCPU[i]];
-        }
-    }
-}
-
-static void computeInstanceOffsets(EngineInterop *interop, uint32_t num_worlds)
-{
-    uint32_t *instanceOffsets = (uint32_t *)interop->instanceOffsetsCPU->ptr;
-
-    for (int i = 0; i < (int)num_worlds; ++i) {
-        instanceOffsets[i] = 0;
-    }
-
-    for (uint32_t i = 1; i < *interop->bridge.totalNumInstances; ++i) {
-        uint32_t current_world_id = (uint32_t)(interop->sortedInstanceWorldIDs[i] >> 32);
-        uint32_t prev_world_id = (uint32_t)(interop->sortedInstanceWorldIDs[i-1] >> 32);
-
-        if (current_world_id != prev_world_id) {
-            instanceOffsets[current_world_id] = i;
+    uint32_t total = 0;
+    uint32_t num_regions = 0;
+
+    for (uint32_t world_idx = 0; world_idx < num_worlds; world_idx++) {
+        uint32_t count = world_counts[world_idx];
+        out_offsets[world_idx] = total;
+
+        // The worlds drop anything past their slot range, a larger count
+        // would copy the neighbouring world's slots
+        assert(count <= max_per_world);
+
+        if (count > 0) {
+            VkDeviceSize src_range = world_idx +
+                (VkDeviceSize)world_copies[world_idx] * num_worlds;
+            VkDeviceSize src_offset =
+                src_range * max_per_world * elem_bytes;
+            VkDeviceSize dst_offset = (VkDeviceSize)total * elem_bytes;
+            VkDeviceSize num_bytes = (VkDeviceSize)count * elem_bytes;
+
+            VkBufferCopy *prev = num_regions > 0 ?
+                &out_regions[num_regions - 1] : nullptr;
+
+            if (prev && prev->srcOffset + prev->size == src_offset &&
+                    prev->dstOffset + prev->size == dst_offset) {
+                prev->size += num_bytes;
+            } else {
+                out_regions[num_regions++] = {
+                    .srcOffset = src_offset,
+                    .dstOffset = dst_offset,
+                    .size = num_bytes,
+                };
+            }
         }
-    }
-}
-
-static void computeViewOffsets(EngineInterop *interop, uint32_t num_worlds)
-{
-    uint32_t *viewOffsets = (uint32_t *)interop->viewOffsetsCPU->ptr;
 
-    for (int i = 0; i < (int)num_worlds; ++i) {
-        viewOffsets[i] = 0;
+        total += count;
     }
+    out_offsets[num_worlds] = total;
 
-    for (uint32_t i = 1; i < *interop->bridge.totalNumViews; ++i) {
-        uint32_t current_world_id = (uint32_t)(interop->sortedViewWorldIDs[i] >> 32);
-        uint32_t prev_world_id = (uint32_t)(interop->sortedViewWorldIDs[i-1] >> 32);
-
-        if (current_world_id != prev_world_id) {
-            viewOffsets[current_world_id] = i;
-        }
-    }
+    *out_num_regions = num_regions;
+    return total;
 }
 
 void BatchRenderer::prepareForRendering(BatchRenderInfo info,
@@ -1411,22 +1391,42 @@ void BatchRenderer::prepareForRendering(BatchRenderInfo info,
     // Circles between 0 to number of frames (not anymore, there is only one frame now)
     uint32_t frame_index = impl->currentFrame;
 
+    BatchFrame &frame_data = impl->batchFrames[frame_index];
+
+    // On the CPU backend this must happen before the offsets staging buffers
+    // below are rewritten. It also frees the staging copy the last upload
+    // read (see the end of this function).
+    { // Wait for the frame to be ready
+        if (frame_data.latestOp != LatestOperation::None) {
+            impl->dev.dt.waitForFences(impl->dev.hdl, 1, 
+                                       &frame_data.getLatestFence(),
+                                       VK_TRUE, UINT64_MAX);
+        }
+    }
+
     { // Flush CPU buffers if we used CPU buffers
         if (interop->viewsCPU.has_value()) {
-            *interop->bridge.totalNumViews = interop->bridge.totalNumViewsCPUInc->load_acquire();
-            *interop->bridge.totalNumInstances = interop->bridge.totalNumInstancesCPUInc->load_acquire();
+            *interop->bridge.totalNumInstances = buildWorldCopyRegionsCPU(
+                interop->bridge.numInstancesPerWorldCPU,
+                interop->bridge.exportedCopyCPU,
+                interop->maxInstancesPerWorld,
+                sizeof(shader::PackedInstanceData), info.numWorlds,
+                interop->instanceCopyRegionsCPU,
+                &interop->numInstanceCopyRegionsCPU,
+                (uint32_t *)interop->instanceOffsetsCPU->ptr);
+
+            *interop->bridge.totalNumViews = buildWorldCopyRegionsCPU(
+                interop->bridge.numViewsPerWorldCPU,
+                interop->bridge.exportedCopyCPU,
+                interop->maxViewsPerWorld,
+                sizeof(shader::PackedViewData), info.numWorlds,
+                interop->viewCopyRegionsCPU,
+                &interop->numViewCopyRegionsCPU,
+                (uint32_t *)interop->viewOffsetsCPU->ptr);
 
             info.numInstances = *interop->bridge.totalNumInstances;
             info.numViews = *interop->bridge.totalNumViews;
 
-            interop->bridge.totalNumViewsCPUInc->store_release(0);
-            interop->bridge.totalNumInstancesCPUInc->store_release(0);
-
-            // First, need to perform the sorts
-            sortInstancesAndViewsCPU(interop);
-            computeInstanceOffsets(interop, info.numWorlds);
-            computeViewOffsets(interop, info.numWorlds);
-
             // Need to flush engine input state before copy
             interop->viewsCPU->flush(impl->dev);
             interop->viewOffsetsCPU->flush(impl->dev);
@@ -1441,16 +1441,6 @@ void BatchRenderer::prepareForRendering(BatchRenderInfo info,
     }
 
 
-    BatchFrame &frame_data = impl->batchFrames[frame_index];
-
-    { // Wait for the frame to be ready
-        if (frame_data.latestOp != LatestOperation::None) {
-            impl->dev.dt.waitForFences(impl->dev.hdl, 1, 
-                                       &frame_data.getLatestFence(),
-                                       VK_TRUE, UINT64_MAX);
-        }
-    }
-
     BatchImportedBuffers &batch_buffers = getImportedBuffers(frame_index);
 
     // Start the command buffer and stuff
@@ -1462,36 +1452,54 @@ void BatchRenderer::prepareForRendering(BatchRenderInfo info,
         REQ_VK(impl->dev.dt.beginCommandBuffer(draw_cmd, &begin_info));
     }
 
-    { // Import the views
-        VkDeviceSize num_views_bytes = info.numViews *
-            sizeof(shader::PackedViewData);
+    if (interop->viewsCPU.has_value()) {
+        // Packs each world's slot range while copying
+        if (interop->numViewCopyRegionsCPU > 0) {
+            impl->dev.dt.cmdCopyBuffer(draw_cmd, interop->viewsHdl,
+                                 batch_buffers.views.buffer,
+                                 interop->numViewCopyRegionsCPU,
+                                 interop->viewCopyRegionsCPU);
+        }
 
-        VkBufferCopy view_data_copy = {
-            .srcOffset = 0, .dstOffset = 0,
-            .size = num_views_bytes
-        };
+        if (interop->numInstanceCopyRegionsCPU > 0) {
+            impl->dev.dt.cmdCopyBuffer(draw_cmd, interop->instancesHdl,
+                                 batch_buffers.instances.buffer,
+                                 interop->numInstanceCopyRegionsCPU,
+                                 interop->instanceCopyRegionsCPU);
+        }
+    } else {
+        { // Import the views
+            VkDeviceSize num_views_bytes = info.numViews *
+                sizeof(shader::PackedViewData);
+
+            VkBufferCopy view_data_copy = {
+                .srcOffset = 0, .dstOffset = 0,
+                .size = num_views_bytes
+            };
 
-       impl->dev.dt.cmdCopyBuffer(draw_cmd, interop->viewsHdl,
-                             batch_buffers.views.buffer,
-                             1, &view_data_copy);
-    }
+           impl->dev.dt.cmdCopyBuffer(draw_cmd, interop->viewsHdl,
+                                 batch_buffers.views.buffer,
+                                 1, &view_data_copy);
+        }
 
-    { // Import the instances
-        VkDeviceSize num_instances_bytes = info.numInstances *
-            sizeof(shader::PackedInstanceData);
+        { // Import the instances
+            VkDeviceSize num_instances_bytes = info.numInstances *
+                sizeof(shader::PackedInstanceData);
 
-        VkBufferCopy instance_data_copy = {
-            .srcOffset = 0, .dstOffset = 0,
-            .size = num_instances_bytes
-        };
+            VkBufferCopy instance_data_copy = {
+                .srcOffset = 0, .dstOffset = 0,
+                .size = num_instances_bytes
+            };
 
-        impl->dev.dt.cmdCopyBuffer(draw_cmd, interop->instancesHdl,
-                             batch_buffers.instances.buffer,
-                             1, &instance_data_copy);
+            impl->dev.dt.cmdCopyBuffer(draw_cmd, interop->instancesHdl,
+                                 batch_buffers.instances.buffer,
+                                 1, &instance_data_copy);
+        }
     }
 
+    // The offsets end with the total count after the last world
     { // Import the offsets for instances
-        VkDeviceSize num_offsets_bytes = info.numWorlds *
+        VkDeviceSize num_offsets_bytes = (info.numWorlds + 1) *
             sizeof(int32_t);
 
         VkBufferCopy offsets_data_copy = {
@@ -1505,7 +1513,7 @@ void BatchRenderer::prepareForRendering(BatchRenderInfo info,
     }
 
     { // Import the offsets for views
-        VkDeviceSize num_offsets_bytes = info.numWorlds *
+        VkDeviceSize num_offsets_bytes = (info.numWorlds + 1) *
             sizeof(int32_t);
 
         VkBufferCopy offsets_data_copy = {
@@ -1542,6 +1550,15 @@ void BatchRenderer::prepareForRendering(BatchRenderInfo info,
     REQ_VK(impl->dev.dt.resetFences(impl->dev.hdl, 1, &frame_data.prepareFence));
     REQ_VK(impl->dev.dt.queueSubmit(impl->renderQueue, 1, &submit_info, frame_data.prepareFence));
 
+    if (interop->viewsCPU.has_value()) {
+        // The worlds write the next step's instances and views into the
+        // other staging copy while this upload runs. The wait on the
+        // frame's latest fence at the top of the next prepareForRendering
+        // guarantees this copy is free again before the worlds switch back.
+        // All worlds step together, so they all exported the same copy.
+        *interop->bridge.uploadCopyCPU = interop->bridge.exportedCopyCPU[0];
+    }
+
     frame_data.latestOp = LatestOperation::RenderPrepare;
 
     didRender = true;
@@ -0,0 +1,720 @@
+#include "cpu_raycaster.hpp"
+
+#include <madrona/heap_array.hpp>
+#include <madrona/mesh_bvh.hpp>
+#include <madrona/physics_assets.hpp>
+#include <madrona/stack_alloc.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(MADRONA_X64) && defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace madrona::render {
+
+using namespace math;
+
+namespace {
+
+constexpr uint32_t tileSize = 8;
+constexpr uint32_t packetSize = tileSize * tileSize;
+constexpr uint32_t tlasLeafSize = 2;
+constexpr uint32_t tlasStackSize = 64;
+
+struct TLASNode {
+    AABB bounds;
+    // Internal nodes: index of the left child, the right child follows it.
+    // Leaves: first entry in the world's instance order array.
+    uint32_t leftOrFirst;
+    // 0 for internal nodes
+    uint32_t numInstances;
+};
+
+// World space to object space transform of one instance, plus the object's
+// BVH (nullptr if the instance's objectID isn't loaded).
+struct InstanceTransform {
+    Quat invRot;
+    Vector3 pos;
+    Diag3x3 invScale;
+    const phys::MeshBVH *bvh;
+};
+
+// Rays are stored structure of arrays so one node's bounds can be tested
+// against the whole packet at once. Lanes past numRays (partial tiles at
+// the image edge) get a negative tMax, which never passes the slab test.
+struct alignas(32) RayPacket {
+    float oX[packetSize];
+    float oY[packetSize];
+    float oZ[packetSize];
+    float invDX[packetSize];
+    float invDY[packetSize];
+    float invDZ[packetSize];
+    float tMax[packetSize];
+    Vector3 d[packetSize];
+    int32_t hitInstance[packetSize];
+    uint32_t numRays;
+
+    Vector3 origin(uint32_t ray) const
+    {
+        return { oX[ray], oY[ray], oZ[ray] };
+    }
+};
+
+struct LoadedObject {
+    phys::MeshBVH bvh;
+    void *blob;
+};
+
+using RayMask = uint64_t;
+static_assert(packetSize == sizeof(RayMask) * 8);
+
+// Returns a bit per ray whose [0, tMax] interval overlaps aabb
+inline RayMask packetHitsAABB(const AABB &aabb, const RayPacket &packet)
+{
+    RayMask mask = 0;
+
+#if defined(MADRONA_X64) && defined(__AVX2__)
+    const __m256 min_x = _mm256_set1_ps(aabb.pMin.x);
+    const __m256 min_y = _mm256_set1_ps(aabb.pMin.y);
+    const __m256 min_z = _mm256_set1_ps(aabb.pMin.z);
+    const __m256 max_x = _mm256_set1_ps(aabb.pMax.x);
+    const __m256 max_y = _mm256_set1_ps(aabb.pMax.y);
+    const __m256 max_z = _mm256_set1_ps(aabb.pMax.z);
+    const __m256 zero = _mm256_setzero_ps();
+
+    for (uint32_t i = 0; i < packetSize; i += 8) {
+        __m256 o_x = _mm256_load_ps(packet.oX + i);
+        __m256 o_y = _mm256_load_ps(packet.oY + i);
+        __m256 o_z = _mm256_load_ps(packet.oZ + i);
+        __m256 inv_d_x = _mm256_load_ps(packet.invDX + i);
+        __m256 inv_d_y = _mm256_load_ps(packet.invDY + i);
+        __m256 inv_d_z = _mm256_load_ps(packet.invDZ + i);
+
+        __m256 tx0 = _mm256_mul_ps(_mm256_sub_ps(min_x, o_x), inv_d_x);
+        __m256 tx1 = _mm256_mul_ps(_mm256_sub_ps(max_x, o_x), inv_d_x);
+        __m256 ty0 = _mm256_mul_ps(_mm256_sub_ps(min_y, o_y), inv_d_y);
+        __m256 ty1 = _mm256_mul_ps(_mm256_sub_ps(max_y, o_y), inv_d_y);
+        __m256 tz0 = _mm256_mul_ps(_mm256_sub_ps(min_z, o_z), inv_d_z);
+        __m256 tz1 = _mm256_mul_ps(_mm256_sub_ps(max_z, o_z), inv_d_z);
+
+        __m256 t_near = _mm256_max_ps(
+            _mm256_max_ps(_mm256_min_ps(tx0, tx1), _mm256_min_ps(ty0, ty1)),
+            _mm256_max_ps(_mm256_min_ps(tz0, tz1), zero));
+        __m256 t_far = _mm256_min_ps(
+            _mm256_min_ps(_mm256_max_ps(tx0, tx1), _mm256_max_ps(ty0, ty1)),
+            _mm256_min_ps(_mm256_max_ps(tz0, tz1),
+                          _mm256_load_ps(packet.tMax + i)));
+
+        uint32_t lanes = (uint32_t)_mm256_movemask_ps(
+            _mm256_cmp_ps(t_near, t_far, _CMP_LE_OQ));
+        mask |= (RayMask)lanes << i;
+    }
+#else
+    for (uint32_t i = 0; i < packetSize; i++) {
+        float tx0 = (aabb.pMin.x - packet.oX[i]) * packet.invDX[i];
+        float tx1 = (aabb.pMax.x - packet.oX[i]) * packet.invDX[i];
+        float ty0 = (aabb.pMin.y - packet.oY[i]) * packet.invDY[i];
+        float ty1 = (aabb.pMax.y - packet.oY[i]) * packet.invDY[i];
+        float tz0 = (aabb.pMin.z - packet.oZ[i]) * packet.invDZ[i];
+        float tz1 = (aabb.pMax.z - packet.oZ[i]) * packet.invDZ[i];
+
+        float t_near = fmaxf(fmaxf(fminf(tx0, tx1), fminf(ty0, ty1)),
+                             fmaxf(fminf(tz0, tz1), 0.f));
+        float t_far = fminf(fminf(fmaxf(tx0, tx1), fmaxf(ty0, ty1)),
+                            fminf(fmaxf(tz0, tz1), packet.tMax[i]));
+
+        if (t_near <= t_far) {
+            mask |= (RayMask)1 << i;
+        }
+    }
+#endif
+
+    return mask;
+}
+
+// Minimal fork / join pool: run() hands out item indices to the workers
+// and the calling thread until all num_items are done.
+class WorkerPool {
+public:
+    WorkerPool(uint32_t num_threads)
+        : threads_(),
+          lock_(),
+          wake_(),
+          done_(),
+          generation_(0),
+          numActive_(0),
+          exit_(false),
+          nextItem_(0),
+          numItems_(0),
+          fn_(nullptr),
+          fnData_(nullptr)
+    {
+        // The calling thread is the last worker
+        for (uint32_t i = 1; i < num_threads; i++) {
+            threads_.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard guard(lock_);
+            exit_ = true;
+        }
+        wake_.notify_all();
+
+        for (std::thread &t : threads_) {
+            t.join();
+        }
+    }
+
+    uint32_t numThreads() const { return (uint32_t)threads_.size() + 1; }
+
+    template <typename Fn>
+    void run(uint32_t num_items, Fn &&fn)
+    {
+        if (num_items == 0) {
+            return;
+        }
+
+        {
+            std::lock_guard guard(lock_);
+            fn_ = [](void *data, uint32_t item) {
+                (*(Fn *)data)(item);
+            };
+            fnData_ = &fn;
+            numItems_ = num_items;
+            nextItem_.store(0, std::memory_order_relaxed);
+            numActive_ = (uint32_t)threads_.size();
+            generation_++;
+        }
+        wake_.notify_all();
+
+        processItems();
+
+        std::unique_lock guard(lock_);
+        done_.wait(guard, [this]() { return numActive_ == 0; });
+    }
+
+private:
+    void processItems()
+    {
+        uint32_t item;
+        while ((item = nextItem_.fetch_add(1, std::memory_order_relaxed)) <
+               numItems_) {
+            fn_(fnData_, item);
+        }
+    }
+
+    void workerLoop()
+    {
+        uint64_t seen_generation = 0;
+        while (true) {
+            {
+                std::unique_lock guard(lock_);
+                wake_.wait(guard, [&]() {
+                    return exit_ || generation_ != seen_generation;
+                });
+
+                if (exit_) {
+                    return;
+                }
+
+                seen_generation = generation_;
+            }
+
+            processItems();
+
+            bool last;
+            {
+                std::lock_guard guard(lock_);
+                last = --numActive_ == 0;
+            }
+
+            if (last) {
+                done_.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> threads_;
+    std::mutex lock_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    uint64_t generation_;
+    uint32_t numActive_;
+    bool exit_;
+
+    std::atomic<uint32_t> nextItem_;
+    uint32_t numItems_;
+    void (*fn_)(void *, uint32_t);
+    void *fnData_;
+};
+
+}
+
+struct CPURaycaster::Impl {
+    Config cfg;
+    WorkerPool pool;
+
+    std::vector<LoadedObject> objects;
+
+    // Bridge storage. Views and instances use a fixed stride per world.
+    HeapArray<PerspectiveCameraData> views;
+    HeapArray<InstanceData> instances;
+    HeapArray<int32_t> viewOffsets;
+    HeapArray<int32_t> instanceOffsets;
+    HeapArray<uint32_t> numViewsPerWorld;
+    HeapArray<uint32_t> numInstancesPerWorld;
+    uint32_t totalNumViews;
+    uint32_t totalNumInstances;
+    RenderECSBridge bridge;
+
+    // Packed view index => world index, filled by readECS
+    HeapArray<uint32_t> viewWorlds;
+
+    // Per world top level BVH state, same stride as instances (nodes use
+    // 2x the stride)
+    HeapArray<TLASNode> tlasNodes;
+    HeapArray<uint32_t> tlasNumNodes;
+    HeapArray<uint32_t> tlasOrder;
+    HeapArray<AABB> instanceAABBs;
+    HeapArray<InstanceTransform> instanceTxfms;
+
+    HeapArray<float> depthOut;
+    HeapArray<int32_t> instanceIDOut;
+
+    inline Impl(const Config &cfg);
+    inline ~Impl();
+
+    inline void buildTLAS(uint32_t world_idx);
+    inline void traceTile(uint32_t tile_idx);
+    inline void tracePacket(uint32_t world_idx, RayPacket &packet) const;
+};
+
+static uint32_t defaultNumThreads()
+{
+    uint32_t num = std::thread::hardware_concurrency();
+    return num == 0 ? 1 : num;
+}
+
+CPURaycaster::Impl::Impl(const Config &c)
+    : cfg(c),
+      pool(c.numThreads == 0 ? defaultNumThreads() : c.numThreads),
+      objects(),
+      views(c.numWorlds * c.maxViewsPerWorld),
+      instances(c.numWorlds * c.maxInstancesPerWorld),
+      viewOffsets(c.numWorlds + 1),
+      instanceOffsets(c.numWorlds + 1),
+      numViewsPerWorld(c.numWorlds),
+      numInstancesPerWorld(c.numWorlds),
+      totalNumViews(0),
+      totalNumInstances(0),
+      bridge(),
+      viewWorlds(c.numWorlds * c.maxViewsPerWorld),
+      tlasNodes(2 * c.numWorlds * c.maxInstancesPerWorld),
+      tlasNumNodes(c.numWorlds),
+      tlasOrder(c.numWorlds * c.maxInstancesPerWorld),
+      instanceAABBs(c.numWorlds * c.maxInstancesPerWorld),
+      instanceTxfms(c.numWorlds * c.maxInstancesPerWorld),
+      depthOut((CountT)c.numWorlds * c.maxViewsPerWorld *
+               c.renderWidth * c.renderHeight),
+      instanceIDOut((CountT)c.numWorlds * c.maxViewsPerWorld *
+                    c.renderWidth * c.renderHeight)
+{
+    for (uint32_t i = 0; i < c.numWorlds; i++) {
+        numViewsPerWorld[i] = 0;
+        numInstancesPerWorld[i] = 0;
+        tlasNumNodes[i] = 0;
+    }
+
+    bridge = RenderECSBridge {
+        .views = views.data(),
+        .instances = instances.data(),
+        .instanceOffsets = instanceOffsets.data(),
+        .viewOffsets = viewOffsets.data(),
+        .totalNumViews = &totalNumViews,
+        .totalNumInstances = &totalNumInstances,
+        .numViewsPerWorldCPU = numViewsPerWorld.data(),
+        .numInstancesPerWorldCPU = numInstancesPerWorld.data(),
+        // Traced synchronously in render(), so one copy is enough
+        .exportedCopyCPU = nullptr,
+        .uploadCopyCPU = nullptr,
+        .numWorldsCPU = c.numWorlds,
+        .renderWidth = (int32_t)c.renderWidth,
+        .renderHeight = (int32_t)c.renderHeight,
+        .voxels = nullptr,
+        .maxViewsPerworld = c.maxViewsPerWorld,
+        .maxInstancesPerWorld = c.maxInstancesPerWorld,
+        .isGPUBackend = false,
+    };
+}
+
+CPURaycaster::Impl::~Impl()
+{
+    for (LoadedObject &obj : objects) {
+        free(obj.blob);
+    }
+}
+
+void CPURaycaster::Impl::buildTLAS(uint32_t world_idx)
+{
+    uint32_t base = world_idx * cfg.maxInstancesPerWorld;
+    uint32_t num_instances = numInstancesPerWorld[world_idx];
+
+    const InstanceData *world_instances = instances.data() + base;
+    AABB *aabbs = instanceAABBs.data() + base;
+    InstanceTransform *txfms = instanceTxfms.data() + base;
+    uint32_t *order = tlasOrder.data() + base;
+    TLASNode *nodes = tlasNodes.data() + 2 * base;
+
+    uint32_t num_valid = 0;
+    for (uint32_t i = 0; i < num_instances; i++) {
+        const InstanceData &inst = world_instances[i];
+
+        if (inst.objectID < 0 || inst.objectID >= (int32_t)objects.size()) {
+            txfms[i].bvh = nullptr;
+            continue;
+        }
+
+        const phys::MeshBVH &bvh = objects[inst.objectID].bvh;
+
+        txfms[i] = InstanceTransform {
+            .invRot = inst.rotation.inv(),
+            .pos = inst.position,
+            .invScale = inst.scale.inv(),
+            .bvh = &bvh,
+        };
+        aabbs[i] = bvh.rootAABB.applyTRS(
+            inst.position, inst.rotation, inst.scale);
+        order[num_valid++] = i;
+    }
+
+    if (num_valid == 0) {
+        tlasNumNodes[world_idx] = 0;
+        return;
+    }
+
+    auto centroid = [&](uint32_t inst_idx) {
+        const AABB &aabb = aabbs[inst_idx];
+        return (aabb.pMin + aabb.pMax) * 0.5f;
+    };
+
+    nodes[0].leftOrFirst = 0;
+    nodes[0].numInstances = num_valid;
+    uint32_t num_nodes = 1;
+
+    uint32_t stack[tlasStackSize];
+    stack[0] = 0;
+    uint32_t stack_size = 1;
+
+    // Object median splits along the widest centroid axis
+    while (stack_size > 0) {
+        TLASNode &node = nodes[stack[--stack_size]];
+        uint32_t first = node.leftOrFirst;
+        uint32_t count = node.numInstances;
+
+        AABB bounds = aabbs[order[first]];
+        AABB centroid_bounds = AABB::point(centroid(order[first]));
+        for (uint32_t i = first + 1; i < first + count; i++) {
+            bounds = AABB::merge(bounds, aabbs[order[i]]);
+            centroid_bounds.expand(centroid(order[i]));
+        }
+        node.bounds = bounds;
+
+        Vector3 extent = centroid_bounds.pMax - centroid_bounds.pMin;
+        if (count <= tlasLeafSize || fmaxf(extent.x, fmaxf(extent.y,
+                extent.z)) == 0.f || stack_size + 2 > tlasStackSize) {
+            continue;
+        }
+
+        CountT axis = 0;
+        if (extent.y > extent[axis]) {
+            axis = 1;
+        }
+        if (extent.z > extent[axis]) {
+            axis = 2;
+        }
+
+        uint32_t mid = count / 2;
+        std::nth_element(order + first, order + first + mid,
+                         order + first + count,
+            [&](uint32_t a, uint32_t b) {
+                return centroid(a)[axis] < centroid(b)[axis];
+            });
+
+        uint32_t left_idx = num_nodes;
+        num_nodes += 2;
+
+        nodes[left_idx].leftOrFirst = first;
+        nodes[left_idx].numInstances = mid;
+        nodes[left_idx + 1].leftOrFirst = first + mid;
+        nodes[left_idx + 1].numInstances = count - mid;
+
+        node.leftOrFirst = left_idx;
+        node.numInstances = 0;
+
+        stack[stack_size++] = left_idx;
+        stack[stack_size++] = left_idx + 1;
+    }
+
+    tlasNumNodes[world_idx] = num_nodes;
+}
+
+// Packet traversal: each stack entry carries the mask of rays that hit its
+// parent, rays drop out of a subtree as soon as they miss its bounds.
+void CPURaycaster::Impl::tracePacket(uint32_t world_idx,
+                                     RayPacket &packet) const
+{
+    if (tlasNumNodes[world_idx] == 0) {
+        return;
+    }
+
+    uint32_t base = world_idx * cfg.maxInstancesPerWorld;
+    const TLASNode *nodes = tlasNodes.data() + 2 * base;
+    const uint32_t *order = tlasOrder.data() + base;
+    const AABB *aabbs = instanceAABBs.data() + base;
+    const InstanceTransform *txfms = instanceTxfms.data() + base;
+
+    struct StackEntry {
+        uint32_t node;
+        RayMask active;
+    };
+
+    StackEntry stack[tlasStackSize];
+    stack[0] = { 0, ~(RayMask)0 };
+    uint32_t stack_size = 1;
+
+    while (stack_size > 0) {
+        StackEntry entry = stack[--stack_size];
+        const TLASNode &node = nodes[entry.node];
+
+        RayMask active = entry.active & packetHitsAABB(node.bounds, packet);
+        if (active == 0) {
+            continue;
+        }
+
+        if (node.numInstances == 0) {
+            // Visit the child nearer to the first active ray first
+            uint32_t left = node.leftOrFirst;
+            Vector3 o = packet.origin((uint32_t)std::countr_zero(active));
+            const AABB &l = nodes[left].bounds;
+            const AABB &r = nodes[left + 1].bounds;
+            float l_dist2 = ((l.pMin + l.pMax) * 0.5f - o).length2();
+            float r_dist2 = ((r.pMin + r.pMax) * 0.5f - o).length2();
+
+            uint32_t near = l_dist2 <= r_dist2 ? left : left + 1;
+            uint32_t far = near == left ? left + 1 : left;
+
+            stack[stack_size++] = { far, active };
+            stack[stack_size++] = { near, active };
+            continue;
+        }
+
+        for (uint32_t i = node.leftOrFirst;
+             i < node.leftOrFirst + node.numInstances; i++) {
+            uint32_t inst_idx = order[i];
+            const InstanceTransform &txfm = txfms[inst_idx];
+
+            RayMask inst_rays = active & packetHitsAABB(aabbs[inst_idx], packet);
+            while (inst_rays != 0) {
+                uint32_t ray = (uint32_t)std::countr_zero(inst_rays);
+                inst_rays &= inst_rays - 1;
+
+                // Affine transforms keep the ray parameter, so the hit t
+                // in object space is directly comparable with tMax.
+                Vector3 o_obj = txfm.invScale *
+                    txfm.invRot.rotateVec(packet.origin(ray) - txfm.pos);
+                Vector3 d_obj = txfm.invScale *
+                    txfm.invRot.rotateVec(packet.d[ray]);
+
+                float hit_t;
+                Vector3 hit_normal;
+                if (txfm.bvh->traceRay(o_obj, d_obj, &hit_t, &hit_normal,
+                                       packet.tMax[ray])) {
+                    packet.tMax[ray] = hit_t;
+                    packet.hitInstance[ray] = (int32_t)inst_idx;
+                }
+            }
+        }
+    }
+}
+
+void CPURaycaster::Impl::traceTile(uint32_t tile_idx)
+{
+    const uint32_t width = cfg.renderWidth;
+    const uint32_t height = cfg.renderHeight;
+    const uint32_t tiles_x = (width + tileSize - 1) / tileSize;
+    const uint32_t tiles_y = (height + tileSize - 1) / tileSize;
+    const uint32_t tiles_per_view = tiles_x * tiles_y;
+
+    uint32_t view_idx = tile_idx / tiles_per_view;
+    uint32_t view_tile = tile_idx % tiles_per_view;
+    uint32_t tile_x = (view_tile % tiles_x) * tileSize;
+    uint32_t tile_y = (view_tile / tiles_x) * tileSize;
+
+    uint32_t world_idx = viewWorlds[view_idx];
+    uint32_t local_view = view_idx - (uint32_t)viewOffsets[world_idx];
+    const PerspectiveCameraData &cam =
+        views[world_idx * cfg.maxViewsPerWorld + local_view];
+
+    // cam.rotation takes world space to view space (x right, y forward,
+    // z up). Rays are generated with a view space y component of 1, so the
+    // hit t is in units of view space depth; the output below converts it
+    // to Euclidean distance from the camera, like draw_deferred.hlsl.
+    Quat view_to_world = cam.rotation.inv();
+
+    uint32_t tile_w = std::min(tileSize, width - tile_x);
+    uint32_t tile_h = std::min(tileSize, height - tile_y);
+
+    RayPacket packet;
+    packet.numRays = tile_w * tile_h;
+
+    for (uint32_t ray = 0; ray < packetSize; ray++) {
+        uint32_t x = ray % tile_w;
+        uint32_t y = ray / tile_w;
+        if (ray >= packet.numRays) {
+            x = y = 0;
+        }
+
+        float ndc_x = 2.f * ((float)(tile_x + x) + 0.5f) /
+            (float)width - 1.f;
+        float ndc_y = 2.f * ((float)(tile_y + y) + 0.5f) /
+            (float)height - 1.f;
+
+        Vector3 view_d {
+            ndc_x / cam.xScale,
+            1.f,
+            ndc_y / cam.yScale,
+        };
+
+        Vector3 d = view_to_world.rotateVec(view_d);
+        Vector3 o = cam.position + cam.zNear * d;
+
+        packet.oX[ray] = o.x;
+        packet.oY[ray] = o.y;
+        packet.oZ[ray] = o.z;
+        packet.invDX[ray] = 1.f / d.x;
+        packet.invDY[ray] = 1.f / d.y;
+        packet.invDZ[ray] = 1.f / d.z;
+        packet.tMax[ray] = ray < packet.numRays ? FLT_MAX : -1.f;
+        packet.d[ray] = d;
+        packet.hitInstance[ray] = -1;
+    }
+
+    tracePacket(world_idx, packet);
+
+    uint64_t view_base = (uint64_t)view_idx * width * height;
+    for (uint32_t y = 0; y < tile_h; y++) {
+        for (uint32_t x = 0; x < tile_w; x++) {
+            uint32_t ray = y * tile_w + x;
+            uint64_t out_idx = view_base +
+                (uint64_t)(tile_y + y) * width + (tile_x + x);
+
+            int32_t hit = packet.hitInstance[ray];
+            instanceIDOut[out_idx] = hit;
+            depthOut[out_idx] = hit == -1 ? 0.f :
+                (cam.zNear + packet.tMax[ray]) * packet.d[ray].length();
+        }
+    }
+}
+
+CPURaycaster::CPURaycaster(const Config &cfg)
+    : impl_(new Impl(cfg))
+{}
+
+CPURaycaster::CPURaycaster(CPURaycaster &&) = default;
+CPURaycaster::~CPURaycaster() = default;
+
+CountT CPURaycaster::loadObjects(Span<const imp::SourceObject> objs)
+{
+    StackAlloc tmp_alloc;
+
+    for (const imp::SourceObject &obj : objs) {
+        LoadedObject loaded;
+        CountT num_bytes;
+        loaded.blob = phys::MeshBVHBuilder::build(
+            Span<const imp::SourceMesh>(obj.meshes.data(),
+                                        obj.meshes.size()),
+            tmp_alloc, &loaded.bvh, &num_bytes);
+
+        impl_->objects.push_back(loaded);
+    }
+
+    return (CountT)impl_->objects.size();
+}
+
+const RenderECSBridge * CPURaycaster::bridge() const
+{
+    return &impl_->bridge;
+}
+
+void CPURaycaster::readECS()
+{
+    Impl &impl = *impl_;
+
+    uint32_t total_views = 0;
+    uint32_t total_instances = 0;
+    for (uint32_t world_idx = 0; world_idx < impl.cfg.numWorlds;
+         world_idx++) {
+        uint32_t num_views = impl.numViewsPerWorld[world_idx];
+        assert(num_views <= impl.cfg.maxViewsPerWorld);
+
+        impl.viewOffsets[world_idx] = (int32_t)total_views;
+        impl.instanceOffsets[world_idx] = (int32_t)total_instances;
+
+        for (uint32_t i = 0; i < num_views; i++) {
+            impl.viewWorlds[total_views + i] = world_idx;
+        }
+
+        total_views += num_views;
+        total_instances += impl.numInstancesPerWorld[world_idx];
+    }
+
+    impl.viewOffsets[impl.cfg.numWorlds] = (int32_t)total_views;
+    impl.instanceOffsets[impl.cfg.numWorlds] = (int32_t)total_instances;
+
+    impl.totalNumViews = total_views;
+    impl.totalNumInstances = total_instances;
+}
+
+void CPURaycaster::render()
+{
+    Impl &impl = *impl_;
+
+    impl.pool.run(impl.cfg.numWorlds, [&impl](uint32_t world_idx) {
+        impl.buildTLAS(world_idx);
+    });
+
+    uint32_t tiles_x = (impl.cfg.renderWidth + tileSize - 1) / tileSize;
+    uint32_t tiles_y = (impl.cfg.renderHeight + tileSize - 1) / tileSize;
+    uint32_t num_tiles = impl.totalNumViews * tiles_x * tiles_y;
+
+    impl.pool.run(num_tiles, [&impl](uint32_t tile_idx) {
+        impl.traceTile(tile_idx);
+    });
+}
+
+const float * CPURaycaster::depthOut() const
+{
+    return impl_->depthOut.data();
+}
+
+const int32_t * CPURaycaster::instanceIDOut() const
+{
+    return impl_->instanceIDOut.data();
+}
+
+uint32_t CPURaycaster::numThreads() const
+{
+    return impl_->pool.numThreads();
+}
+
+}
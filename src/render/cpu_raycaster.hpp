@@ -0,0 +1,70 @@
+#pragma once
+
+#include <madrona/importer.hpp>
+#include <madrona/span.hpp>
+
+#include <memory>
+
+#include "ecs_interop.hpp"
+
+namespace madrona::render {
+
+// Software batch renderer for machines without a GPU. It consumes the same
+// RenderECSBridge as the Vulkan batch renderer on the CPU backend (every
+// world writes into its own slot range, see RenderingSystem::init) and
+// traces every view against that world's instances.
+//
+// Each loaded object gets a phys::MeshBVH. Every frame, a top level BVH
+// over the world space bounds of each world's instances is built, then
+// views are split into 8x8 pixel tiles that are traced as packets through
+// the top level BVH across a pool of worker threads.
+//
+// Outputs are laid out like the Vulkan renderer's: view_idx * height *
+// width + y * width + x, where view_idx is the view's position after
+// packing all worlds' views in world order.
+//   Depth: distance from the camera to the hit, 0 for no hit.
+//   Instance ID: index of the hit instance within its world's instances
+//     for this frame, -1 for no hit.
+class CPURaycaster {
+public:
+    struct Config {
+        uint32_t renderWidth;
+        uint32_t renderHeight;
+        uint32_t numWorlds;
+        uint32_t maxViewsPerWorld;
+        uint32_t maxInstancesPerWorld;
+
+        // 0 uses one thread per hardware thread
+        uint32_t numThreads = 0;
+    };
+
+    CPURaycaster(const Config &cfg);
+    CPURaycaster(CPURaycaster &&);
+    ~CPURaycaster();
+
+    // Builds one MeshBVH from all the meshes of each object. Instances
+    // refer to these by InstanceData::objectID. Returns the number of
+    // objects loaded so far.
+    CountT loadObjects(Span<const imp::SourceObject> objs);
+
+    // Pass this to RenderingSystem::registerTypes / init
+    const RenderECSBridge * bridge() const;
+
+    // Reads the per world counts written by the ECS and computes the
+    // packed view / instance offsets.
+    void readECS();
+
+    // Traces all views read by the last readECS
+    void render();
+
+    const float * depthOut() const;
+    const int32_t * instanceIDOut() const;
+
+    uint32_t numThreads() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+}
@@ -31,13 +31,24 @@ struct RenderECSBridge {
     uint32_t *totalNumViews;
     uint32_t *totalNumInstances;
 
-    AtomicU32 *totalNumViewsCPUInc;
-    AtomicU32 *totalNumInstancesCPUInc;
+    // CPU backend only: world w owns the slots starting at
+    // w * maxInstancesPerWorld in instances (and w * maxViewsPerworld in
+    // views) of each copy (see exportedCopyCPU), and writes how many of
+    // them it filled this step here. The renderer compacts these ranges,
+    // so no cross world sort is needed.
+    uint32_t *numViewsPerWorldCPU;
+    uint32_t *numInstancesPerWorldCPU;
 
-    // Keys used for sorting (most significant 32 bits: world ID; 
-    //                        least significant 32 bits: entity ID)
-    uint64_t *instancesWorldIDs;
-    uint64_t *viewsWorldIDs;
+    // CPU backend only, optional: views and instances hold two copies of
+    // every world's slots, copy c starting at c * numWorldsCPU slot ranges.
+    // Each step a world writes the copy the renderer isn't uploading from
+    // (1 - *uploadCopyCPU) and publishes which one in exportedCopyCPU, so
+    // the simulation never waits on the upload. If exportedCopyCPU is null
+    // there is a single copy. Use worldViewsCPU / worldInstancesCPU to find
+    // a world's last exported step.
+    uint32_t *exportedCopyCPU;
+    uint32_t *uploadCopyCPU;
+    uint32_t numWorldsCPU;
 
     int32_t renderWidth;
     int32_t renderHeight;
@@ -47,6 +58,26 @@ struct RenderECSBridge {
     uint32_t maxInstancesPerWorld;
 
     bool isGPUBackend;
+
+    inline uint64_t worldSlotRangeCPU(uint32_t world_idx) const
+    {
+        uint64_t range = world_idx;
+        if (exportedCopyCPU) {
+            range += (uint64_t)exportedCopyCPU[world_idx] * numWorldsCPU;
+        }
+
+        return range;
+    }
+
+    inline PerspectiveCameraData * worldViewsCPU(uint32_t world_idx) const
+    {
+        return views + worldSlotRangeCPU(world_idx) * maxViewsPerworld;
+    }
+
+    inline InstanceData * worldInstancesCPU(uint32_t world_idx) const
+    {
+        return instances + worldSlotRangeCPU(world_idx) * maxInstancesPerWorld;
+    }
 };
 
 }
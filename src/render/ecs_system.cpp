@@ -4,6 +4,8 @@
 
 #include "ecs_interop.hpp"
 
+#include <cstdio>
+
 namespace madrona::render::RenderingSystem {
 using namespace base;
 using namespace math;
@@ -23,18 +25,35 @@ struct RenderingSystemState {
     uint32_t *voxels;
     float aspectRatio;
 
-    // This is used if on the CPU backend
-    AtomicU32 *totalNumViewsCPU;
-    AtomicU32 *totalNumInstancesCPU;
-
-    // This is used if on the CPU backend
+    // This is used if on the CPU backend. Each world's task graph runs on
+    // a single thread, so these per world cursors don't need to be atomic.
+    // They're published to the bridge and reset by exportCountsCPU.
+    uint32_t numViewsCPU;
+    uint32_t numInstancesCPU;
+    uint32_t maxViewsCPU;
+    uint32_t maxInstancesCPU;
+
+    // Views and instances past a world's slots are dropped and counted here.
+    // exportCountsCPU warns the first step it happens.
+    uint32_t numDroppedViewsCPU;
+    uint32_t numDroppedInstancesCPU;
+    bool reportedDropsCPU;
+
+    // This is used if on the CPU backend: the start of this world's slots
     InstanceData *instancesCPU;
     PerspectiveCameraData *viewsCPU;
 
-    // World IDs (keys used in the key-value sorting)
-    // Also only used when on the CPU backend
-    uint64_t *instanceWorldIDsCPU;
-    uint64_t *viewWorldIDsCPU;
+    // Where this world's counts get published (CPU backend only)
+    uint32_t *numViewsOutCPU;
+    uint32_t *numInstancesOutCPU;
+
+    // Double buffered CPU staging (see RenderECSBridge::exportedCopyCPU).
+    // uploadCopyCPU is null if the bridge has a single copy.
+    InstanceData *instanceCopiesCPU[2];
+    PerspectiveCameraData *viewCopiesCPU[2];
+    const uint32_t *uploadCopyCPU;
+    uint32_t *exportedCopyOutCPU;
+    uint32_t curCopyCPU;
 };
 
 inline void instanceTransformUpdate(Context &ctx,
@@ -53,14 +72,16 @@ inline void instanceTransformUpdate(Context &ctx,
 #else
     (void)renderable;
 
+    (void)e;
+
     // Just update the instance data that is associated with this entity
     auto &system_state = ctx.singleton<RenderingSystemState>();
-    uint32_t instance_id = system_state.totalNumInstancesCPU->fetch_add<sync::acq_rel>(1);
-
-    // Required for stable sorting on CPU
-    system_state.instanceWorldIDsCPU[instance_id] = 
-        ((uint64_t)ctx.worldID().idx << 32) | (uint64_t)e.id;
+    if (system_state.numInstancesCPU == system_state.maxInstancesCPU) {
+        system_state.numDroppedInstancesCPU += 1;
+        return;
+    }
 
+    uint32_t instance_id = system_state.numInstancesCPU++;
     InstanceData &data = system_state.instancesCPU[instance_id];
 #endif
 
@@ -91,13 +112,15 @@ inline void viewTransformUpdate(Context &ctx,
     PerspectiveCameraData &cam_data = 
         ctx.get<PerspectiveCameraData>(cam.cameraEntity);
 #else
-    auto &system_state = ctx.singleton<RenderingSystemState>();
-    uint32_t view_id = system_state.totalNumViewsCPU->fetch_add<sync::acq_rel>(1);
+    (void)e;
 
-    // Required for stable sorting on CPU
-    system_state.viewWorldIDsCPU[view_id] = 
-        ((uint64_t)ctx.worldID().idx << 32) | (uint64_t)e.id;
+    auto &system_state = ctx.singleton<RenderingSystemState>();
+    if (system_state.numViewsCPU == system_state.maxViewsCPU) {
+        system_state.numDroppedViewsCPU += 1;
+        return;
+    }
 
+    uint32_t view_id = system_state.numViewsCPU++;
     PerspectiveCameraData &cam_data = system_state.viewsCPU[view_id];
 #endif
     cam_data.position = camera_pos;
@@ -130,6 +153,48 @@ inline void exportCountsGPU(Context &ctx,
     *sys_state.totalNumInstances = state_mgr->getArchetypeNumRows<
         RenderableArchetype>();
 }
+#else
+// Picks the staging copy the renderer isn't uploading from. The renderer only
+// changes uploadCopyCPU between steps.
+inline void selectCopyCPU(Context &,
+                          RenderingSystemState &sys_state)
+{
+    if (!sys_state.uploadCopyCPU) {
+        return;
+    }
+
+    uint32_t copy = 1 - *sys_state.uploadCopyCPU;
+    sys_state.curCopyCPU = copy;
+    sys_state.instancesCPU = sys_state.instanceCopiesCPU[copy];
+    sys_state.viewsCPU = sys_state.viewCopiesCPU[copy];
+}
+
+inline void exportCountsCPU(Context &ctx,
+                            RenderingSystemState &sys_state)
+{
+    if ((sys_state.numDroppedViewsCPU > 0 ||
+            sys_state.numDroppedInstancesCPU > 0) &&
+            !sys_state.reportedDropsCPU) {
+        fprintf(stderr, "Rendering: world %d is over its limit of %u views "
+                "and %u instances, dropped %u views and %u instances\n",
+                ctx.worldID().idx, sys_state.maxViewsCPU,
+                sys_state.maxInstancesCPU, sys_state.numDroppedViewsCPU,
+                sys_state.numDroppedInstancesCPU);
+        sys_state.reportedDropsCPU = true;
+    }
+
+    *sys_state.numViewsOutCPU = sys_state.numViewsCPU;
+    *sys_state.numInstancesOutCPU = sys_state.numInstancesCPU;
+
+    if (sys_state.exportedCopyOutCPU) {
+        *sys_state.exportedCopyOutCPU = sys_state.curCopyCPU;
+    }
+
+    sys_state.numViewsCPU = 0;
+    sys_state.numInstancesCPU = 0;
+    sys_state.numDroppedViewsCPU = 0;
+    sys_state.numDroppedInstancesCPU = 0;
+}
 #endif
 
 void registerTypes(ECSRegistry &registry,
@@ -186,6 +251,15 @@ void registerTypes(ECSRegistry &registry,
 TaskGraphNodeID setupTasks(TaskGraphBuilder &builder,
                            Span<const TaskGraphNodeID> deps)
 {
+#ifndef MADRONA_GPU_MODE
+    // Picks the staging copy this step writes before anything is exported
+    TaskGraphNodeID select_copy = builder.addToGraph<ParallelForNode<Context,
+        selectCopyCPU,
+            RenderingSystemState
+        >>(deps);
+    deps = Span<const TaskGraphNodeID>(&select_copy, 1);
+#endif
+
     // FIXME: It feels like we should have persistent slots for renderer
     // state rather than needing to continually reset the instance count
     // and recreate the buffer. However, this might be hard to handle with
@@ -231,7 +305,12 @@ TaskGraphNodeID setupTasks(TaskGraphBuilder &builder,
 
     return export_counts;
 #else
-    return viewdata_update;
+    auto export_counts = builder.addToGraph<ParallelForNode<Context,
+        exportCountsCPU,
+            RenderingSystemState
+        >>({viewdata_update});
+
+    return export_counts;
 #endif
 }
 
@@ -245,17 +324,51 @@ void init(Context &ctx,
     system_state.totalNumInstances = bridge->totalNumInstances;
 
 #if !defined(MADRONA_GPU_MODE)
-    // This is just an atomic counter (final value will be moved to
-    // the totalNumViews/Instances variables).
-    system_state.totalNumViewsCPU = bridge->totalNumViewsCPUInc;
-    system_state.totalNumInstancesCPU = bridge->totalNumInstancesCPUInc;
+    // This is only relevant for the CPU backend. Each world gets a fixed
+    // range of the bridge arrays, so the renderer can find every world's
+    // data without sorting (final totals are computed by the renderer).
+    uint32_t world_idx = (uint32_t)ctx.worldID().idx;
+
+    system_state.numViewsCPU = 0;
+    system_state.numInstancesCPU = 0;
+    system_state.maxViewsCPU = bridge->maxViewsPerworld;
+    system_state.maxInstancesCPU = bridge->maxInstancesPerWorld;
+    system_state.numDroppedViewsCPU = 0;
+    system_state.numDroppedInstancesCPU = 0;
+    system_state.reportedDropsCPU = false;
+
+    for (uint32_t copy = 0; copy < 2; copy++) {
+        uint64_t range = world_idx;
+        if (bridge->exportedCopyCPU) {
+            range += (uint64_t)copy * bridge->numWorldsCPU;
+        }
+
+        system_state.instanceCopiesCPU[copy] = bridge->instances +
+            range * bridge->maxInstancesPerWorld;
+        system_state.viewCopiesCPU[copy] = bridge->views +
+            range * bridge->maxViewsPerworld;
+    }
+
+    system_state.curCopyCPU = 0;
+    system_state.instancesCPU = system_state.instanceCopiesCPU[0];
+    system_state.viewsCPU = system_state.viewCopiesCPU[0];
+
+    if (bridge->exportedCopyCPU) {
+        system_state.uploadCopyCPU = bridge->uploadCopyCPU;
+        system_state.exportedCopyOutCPU =
+            bridge->exportedCopyCPU + world_idx;
+        *system_state.exportedCopyOutCPU = 0;
+    } else {
+        system_state.uploadCopyCPU = nullptr;
+        system_state.exportedCopyOutCPU = nullptr;
+    }
 
-    // This is only relevant for the CPU backend
-    system_state.instancesCPU = bridge->instances;
-    system_state.viewsCPU = bridge->views;
+    system_state.numViewsOutCPU = bridge->numViewsPerWorldCPU + world_idx;
+    system_state.numInstancesOutCPU =
+        bridge->numInstancesPerWorldCPU + world_idx;
 
-    system_state.instanceWorldIDsCPU = bridge->instancesWorldIDs;
-    system_state.viewWorldIDsCPU = bridge->viewsWorldIDs;
+    *system_state.numViewsOutCPU = 0;
+    *system_state.numInstancesOutCPU = 0;
 #endif
 
     system_state.aspectRatio = 
@@ -137,12 +137,13 @@ struct EngineInterop {
 
     VkBuffer voxelHdl;
 
-    uint32_t *iotaArrayInstancesCPU;
-    uint32_t *iotaArrayViewsCPU;
-
-    // We need the sorted instance world IDs in order to compute the instance offsets
-    uint64_t *sortedInstanceWorldIDs;
-    uint64_t *sortedViewWorldIDs;
+    // CPU backend only: one region per world (fewer when neighbouring
+    // worlds are full) that packs the per world slot ranges of the staging
+    // buffers into the GPU side buffers. Rebuilt every prepareForRendering.
+    VkBufferCopy *instanceCopyRegionsCPU;
+    VkBufferCopy *viewCopyRegionsCPU;
+    uint32_t numInstanceCopyRegionsCPU;
+    uint32_t numViewCopyRegionsCPU;
 };
 
 struct ShadowOffsets {
@@ -593,23 +593,19 @@ static EngineInterop setupEngineInterop(Device &dev,
     void *instances_base = nullptr;
     void *instance_offsets_base = nullptr;
 
-    void *world_ids_instances_base = nullptr;
-    void *world_ids_views_base = nullptr;
-
 
     { // Create the views buffer
         uint64_t num_views_bytes = num_worlds * max_views_per_world *
             (int64_t)sizeof(render::shader::PackedViewData);
 
         if (!gpu_input) {
-            views_cpu = alloc.makeStagingBuffer(num_views_bytes);
+            // Two copies, see RenderECSBridge::exportedCopyCPU
+            views_cpu = alloc.makeStagingBuffer(2 * num_views_bytes);
             views_hdl = views_cpu->buffer;
 
-            // views_base = views_cpu->ptr;
-            views_base = malloc(sizeof(render::shader::PackedViewData) * num_worlds * max_views_per_world);
-
-            world_ids_instances_base = malloc(sizeof(uint64_t) * num_worlds * max_instances_per_world);
-            world_ids_views_base = malloc(sizeof(uint64_t) * num_worlds * max_views_per_world);
+            // Worlds write straight into their slot ranges of the staging
+            // buffer, prepareForRendering packs them during the upload
+            views_base = views_cpu->ptr;
         } else {
 #ifdef MADRONA_VK_CUDA_SUPPORT
             views_gpu = alloc.makeDedicatedBuffer(
@@ -629,10 +625,9 @@ static EngineInterop setupEngineInterop(Device &dev,
             (int64_t)sizeof(render::shader::PackedInstanceData);
 
         if (!gpu_input) {
-            instances_cpu = alloc.makeStagingBuffer(num_instances_bytes);
+            instances_cpu = alloc.makeStagingBuffer(2 * num_instances_bytes);
             instances_hdl = instances_cpu->buffer;
-            // instances_base = instances_cpu->ptr;
-            instances_base = malloc(sizeof(render::shader::PackedInstanceData) * num_worlds * max_instances_per_world);
+            instances_base = instances_cpu->ptr;
         } else {
 #ifdef MADRONA_VK_CUDA_SUPPORT
             instances_gpu = alloc.makeDedicatedBuffer(
@@ -723,19 +718,36 @@ static EngineInterop setupEngineInterop(Device &dev,
     uint32_t *total_num_views_readback = nullptr;
     uint32_t *total_num_instances_readback = nullptr;
 
-    AtomicU32 *total_num_views_cpu_inc = nullptr;
-    AtomicU32 *total_num_instances_cpu_inc = nullptr;
+    uint32_t *num_views_per_world_cpu = nullptr;
+    uint32_t *num_instances_per_world_cpu = nullptr;
+
+    uint32_t *exported_copy_cpu = nullptr;
+    uint32_t *upload_copy_cpu = nullptr;
+
+    VkBufferCopy *view_copy_regions_cpu = nullptr;
+    VkBufferCopy *instance_copy_regions_cpu = nullptr;
 
     if (!gpu_input) {
         total_num_views_readback = (uint32_t *)malloc(
             2*sizeof(uint32_t));
         total_num_instances_readback = total_num_views_readback + 1;
 
-        total_num_views_cpu_inc = (AtomicU32 *)malloc(2 * sizeof(AtomicU32));
-        total_num_instances_cpu_inc = total_num_views_cpu_inc + 1;
+        num_views_per_world_cpu = (uint32_t *)calloc(
+            2 * num_worlds, sizeof(uint32_t));
+        num_instances_per_world_cpu = num_views_per_world_cpu + num_worlds;
+
+        exported_copy_cpu = (uint32_t *)calloc(
+            num_worlds + 1, sizeof(uint32_t));
+        upload_copy_cpu = exported_copy_cpu + num_worlds;
+        // Nothing is being uploaded yet, worlds start on copy 0
+        *upload_copy_cpu = 1;
+
+        view_copy_regions_cpu = (VkBufferCopy *)malloc(
+            2 * num_worlds * sizeof(VkBufferCopy));
+        instance_copy_regions_cpu = view_copy_regions_cpu + num_worlds;
 
-        total_num_views_cpu_inc->store_release(0);
-        total_num_instances_cpu_inc->store_release(0);
+        *total_num_views_readback = 0;
+        *total_num_instances_readback = 0;
     } else {
 #ifdef MADRONA_VK_CUDA_SUPPORT
         total_num_views_readback = (uint32_t *)cu::allocReadback(
@@ -751,10 +763,11 @@ static EngineInterop setupEngineInterop(Device &dev,
         .viewOffsets = (int32_t *)view_offsets_base,
         .totalNumViews = total_num_views_readback,
         .totalNumInstances = total_num_instances_readback,
-        .totalNumViewsCPUInc = total_num_views_cpu_inc,
-        .totalNumInstancesCPUInc = total_num_instances_cpu_inc,
-        .instancesWorldIDs = (uint64_t *)world_ids_instances_base,
-        .viewsWorldIDs = (uint64_t *)world_ids_views_base,
+        .numViewsPerWorldCPU = num_views_per_world_cpu,
+        .numInstancesPerWorldCPU = num_instances_per_world_cpu,
+        .exportedCopyCPU = exported_copy_cpu,
+        .uploadCopyCPU = upload_copy_cpu,
+        .numWorldsCPU = num_worlds,
         .renderWidth = (int32_t)render_width,
         .renderHeight = (int32_t)render_height,
         .voxels = voxel_buffer_ptr,
@@ -775,18 +788,6 @@ static EngineInterop setupEngineInterop(Device &dev,
 #endif
     }
 
-    uint32_t *iota_array_instances = nullptr;
-    uint32_t *iota_array_views = nullptr;
-    uint64_t *sorted_instance_world_ids = nullptr;
-    uint64_t *sorted_view_world_ids = nullptr;
-
-    if (!gpu_input) {
-        iota_array_instances = (uint32_t *)malloc(sizeof(uint32_t) * num_worlds * max_instances_per_world);
-        iota_array_views = (uint32_t *)malloc(sizeof(uint32_t) * num_worlds * max_views_per_world);
-        sorted_instance_world_ids = (uint64_t *)malloc(sizeof(uint64_t) * num_worlds * max_instances_per_world);
-        sorted_view_world_ids = (uint64_t *)malloc(sizeof(uint64_t) * num_worlds * max_views_per_world);
-    }
-
     return EngineInterop {
         std::move(views_cpu),
         std::move(view_offsets_cpu),
@@ -819,10 +820,10 @@ static EngineInterop setupEngineInterop(Device &dev,
         std::move(voxel_cuda),
 #endif
         voxel_buffer_hdl,
-        iota_array_instances,
-        iota_array_views,
-        sorted_instance_world_ids,
-        sorted_view_world_ids
+        instance_copy_regions_cpu,
+        view_copy_regions_cpu,
+        0,
+        0,
     };
 }
 
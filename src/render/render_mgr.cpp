@@ -1,11 +1,16 @@
 #include <madrona/render/render_mgr.hpp>
 
 #include "render_ctx.hpp"
+#include "cpu_raycaster.hpp"
 
 namespace madrona::render {
 
 const render::RenderECSBridge * RenderManager::bridge() const
 {
+    if (cpuRaycaster_) {
+        return cpuRaycaster_->bridge();
+    }
+
     return rctx_->engine_interop_.gpuBridge ?
         rctx_->engine_interop_.gpuBridge : &rctx_->engine_interop_.bridge;
 }
@@ -14,11 +19,19 @@ CountT RenderManager::loadObjects(Span<const imp::SourceObject> objs,
                                   Span<const imp::SourceMaterial> mats,
                                   Span<const imp::SourceTexture> textures)
 {
+    if (cpuRaycaster_) {
+        return cpuRaycaster_->loadObjects(objs);
+    }
+
     return rctx_->loadObjects(objs, mats, textures);
 }
 
 void RenderManager::configureLighting(Span<const LightConfig> lights)
 {
+    if (cpuRaycaster_) {
+        return;
+    }
+
     rctx_->configureLighting(lights);
 }
 
@@ -26,8 +39,22 @@ RenderManager::RenderManager(
         APIBackend *render_backend,
         GPUDevice *render_dev,
         const Config &cfg)
-    : rctx_(new RenderContext(render_backend, render_dev, cfg))
+    : rctx_(),
+      cpuRaycaster_()
 {
+    if (cfg.cpuRaycast) {
+        assert(cfg.execMode == ExecMode::CPU);
+
+        cpuRaycaster_.reset(new CPURaycaster({
+            .renderWidth = cfg.agentViewWidth,
+            .renderHeight = cfg.agentViewHeight,
+            .numWorlds = cfg.numWorlds,
+            .maxViewsPerWorld = cfg.maxViewsPerWorld,
+            .maxInstancesPerWorld = cfg.maxInstancesPerWorld,
+        }));
+    } else {
+        rctx_.reset(new RenderContext(render_backend, render_dev, cfg));
+    }
 }
 
 RenderManager::RenderManager(RenderManager &&) = default;
@@ -35,6 +62,11 @@ RenderManager::~RenderManager() = default;
 
 void RenderManager::readECS()
 {
+    if (cpuRaycaster_) {
+        cpuRaycaster_->readECS();
+        return;
+    }
+
     uint32_t cur_num_views = *rctx_->engine_interop_.bridge.totalNumViews;
     uint32_t cur_num_instances = *rctx_->engine_interop_.bridge.totalNumInstances;
 
@@ -49,6 +81,11 @@ void RenderManager::readECS()
 
 void RenderManager::batchRender()
 {
+    if (cpuRaycaster_) {
+        cpuRaycaster_->render();
+        return;
+    }
+
     uint32_t cur_num_views = *rctx_->engine_interop_.bridge.totalNumViews;
     uint32_t cur_num_instances = *rctx_->engine_interop_.bridge.totalNumInstances;
 
@@ -65,12 +102,29 @@ void RenderManager::batchRender()
 
 const uint8_t * RenderManager::batchRendererRGBOut() const
 {
+    if (cpuRaycaster_) {
+        return nullptr;
+    }
+
     return rctx_->batchRenderer->getRGBCUDAPtr();
 }
 
 const float * RenderManager::batchRendererDepthOut() const
 {
+    if (cpuRaycaster_) {
+        return cpuRaycaster_->depthOut();
+    }
+
     return rctx_->batchRenderer->getDepthCUDAPtr();
 }
 
+const int32_t * RenderManager::batchRendererInstanceIDOut() const
+{
+    if (cpuRaycaster_) {
+        return cpuRaycaster_->instanceIDOut();
+    }
+
+    return nullptr;
+}
+
 }
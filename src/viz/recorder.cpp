@@ -1,192 +1,997 @@
 #include <madrona/viz/recorder.hpp>
-#include <madrona/viz/interop.hpp>
-
+#include <madrona/crash.hpp>
+#include <madrona/heap_array.hpp>
+#include <madrona/math.hpp>
 #include <madrona/utils.hpp>
 
-#ifdef MADRONA_CUDA_SUPPORT
-#include <madrona/cuda_utils.hpp>
-#endif
+#include "ecs_interop.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace madrona::viz {
 
-struct Recorder::Impl {
-    RenderECSBridge bridge;
-    bool gpuCopyRequired;
+using namespace render;
+using namespace math;
+
+namespace {
+
+constexpr char recordingMagic[8] = { 'M', 'A', 'D', 'R', 'E', 'C', '0', '1' };
+constexpr uint32_t recordingVersion = 1;
+
+struct RecordingHeader {
+    char magic[8];
+    uint32_t version;
     uint32_t numWorlds;
-    uint64_t numInstanceCopyBytes;
-    
-    uint32_t * curEpisodeLengths;
-    bool * doneReadback;
-    InstanceData * curEpisodeInstanceData;
-    PerspectiveCameraData * curEpisodeViewData;
+    uint32_t maxViewsPerWorld;
+    uint32_t maxInstancesPerWorld;
+    uint32_t stepsPerChunk;
+    float positionQuantum;
+};
 
-    InstanceData * recordedInstances;
-    PerspectiveCameraData * recordedViews;
-    uint32_t * recordedEpisodeLengths;
-    uint32_t numRecordedEpisodes;
+struct ChunkIndexEntry {
+    uint64_t fileOffset;
+    uint64_t numBytes;
+    uint64_t firstStep;
+    uint64_t numSteps;
+};
+
+// Last bytes of the file, points at the chunk index
+struct RecordingTrailer {
+    uint64_t indexOffset;
+    uint64_t numChunks;
+    uint64_t numSteps;
+    char magic[8];
+};
 
-    static Impl * init(const Config &cfg);
+// Every value is stored as a uint32 field. Quantized fields are delta
+// encoded as zigzagged differences, raw float bits are XORed with the
+// previous value, so both are 0 when nothing changed.
+enum class FieldKind : uint32_t {
+    Quantized,
+    Bits,
+};
 
-    void record();
+constexpr uint32_t numInstanceFields = 11;
+constexpr FieldKind instanceFieldKinds[numInstanceFields] = {
+    // Position
+    FieldKind::Quantized, FieldKind::Quantized, FieldKind::Quantized,
+    // Rotation
+    FieldKind::Quantized, FieldKind::Quantized, FieldKind::Quantized,
+    FieldKind::Quantized,
+    // Scale
+    FieldKind::Bits, FieldKind::Bits, FieldKind::Bits,
+    // Object ID
+    FieldKind::Quantized,
 };
 
-Recorder::Impl * Recorder::Impl::init(const Config &cfg)
+constexpr uint32_t numViewFields = 10;
+constexpr FieldKind viewFieldKinds[numViewFields] = {
+    // Position
+    FieldKind::Quantized, FieldKind::Quantized, FieldKind::Quantized,
+    // Rotation
+    FieldKind::Quantized, FieldKind::Quantized, FieldKind::Quantized,
+    FieldKind::Quantized,
+    // xScale, yScale, zNear
+    FieldKind::Bits, FieldKind::Bits, FieldKind::Bits,
+};
+
+constexpr float rotationScale = 32767.f;
+
+// Quantized steps of all worlds waiting to be encoded. Each step of each
+// world only takes up the instances and views it exported, packed one
+// after the other, so the size follows the scene rather than
+// maxInstancesPerWorld.
+struct QuantizedChunk {
+    std::vector<uint32_t> instanceFields;
+    std::vector<uint32_t> viewFields;
+    HeapArray<uint32_t> numInstances;
+    HeapArray<uint32_t> numViews;
+    HeapArray<uint8_t> dones;
+    uint64_t firstStep;
+    uint32_t numSteps;
+
+    QuantizedChunk(uint32_t steps_per_chunk, uint32_t num_worlds)
+        : instanceFields(),
+          viewFields(),
+          numInstances((CountT)steps_per_chunk * num_worlds),
+          numViews((CountT)steps_per_chunk * num_worlds),
+          dones((CountT)steps_per_chunk * num_worlds),
+          firstStep(0),
+          numSteps(0)
+    {}
+};
+
+// Decoded steps of all worlds, packed like QuantizedChunk. The offsets
+// locate each step and world in instances / views.
+struct DecodedChunk {
+    std::vector<InstanceData> instances;
+    std::vector<PerspectiveCameraData> views;
+    HeapArray<uint64_t> instanceOffsets;
+    HeapArray<uint64_t> viewOffsets;
+    HeapArray<uint32_t> numInstances;
+    HeapArray<uint32_t> numViews;
+    HeapArray<uint8_t> dones;
+    uint64_t firstStep;
+    uint32_t numSteps;
+
+    DecodedChunk(uint32_t steps_per_chunk, uint32_t num_worlds)
+        : instances(),
+          views(),
+          instanceOffsets((CountT)steps_per_chunk * num_worlds),
+          viewOffsets((CountT)steps_per_chunk * num_worlds),
+          numInstances((CountT)steps_per_chunk * num_worlds),
+          numViews((CountT)steps_per_chunk * num_worlds),
+          dones((CountT)steps_per_chunk * num_worlds),
+          firstStep(0),
+          numSteps(0)
+    {}
+};
+
+inline uint32_t zigzag(int32_t v)
 {
-    bool gpu_copy_required = cfg.execMode == ExecMode::CUDA;
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
 
-#ifdef MADRONA_CUDA_SUPPORT
-    auto alloc = gpu_copy_required ? cu::allocGPU : malloc;
-#else
-    auto alloc = malloc;
-#endif
+inline int32_t unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+inline uint32_t encodeField(FieldKind kind, uint32_t cur, uint32_t prev)
+{
+    if (kind == FieldKind::Quantized) {
+        return zigzag((int32_t)(cur - prev));
+    } else {
+        return cur ^ prev;
+    }
+}
+
+inline uint32_t decodeField(FieldKind kind, uint32_t token, uint32_t prev)
+{
+    if (kind == FieldKind::Quantized) {
+        return prev + (uint32_t)unzigzag(token);
+    } else {
+        return token ^ prev;
+    }
+}
+
+inline uint32_t quantizePosition(float v, float inv_quantum)
+{
+    float q = rintf(v * inv_quantum);
+    // Also maps NaN to 0
+    if (!(q > -2147483520.f)) {
+        q = q < 0.f ? -2147483520.f : 0.f;
+    }
+    q = std::min(q, 2147483520.f);
+
+    return (uint32_t)(int32_t)q;
+}
+
+inline float dequantizePosition(uint32_t v, float quantum)
+{
+    return (float)(int32_t)v * quantum;
+}
+
+void quantizeTransform(Vector3 pos, Quat rot, float inv_quantum,
+                       uint32_t *out)
+{
+    out[0] = quantizePosition(pos.x, inv_quantum);
+    out[1] = quantizePosition(pos.y, inv_quantum);
+    out[2] = quantizePosition(pos.z, inv_quantum);
+
+    // q and -q are the same rotation, keep w positive so slowly rotating
+    // objects produce small deltas.
+    if (rot.w < 0.f) {
+        rot = Quat { -rot.w, -rot.x, -rot.y, -rot.z };
+    }
+
+    auto quantize_component = [](float c) {
+        c = std::clamp(c, -1.f, 1.f);
+        // NaN => 0
+        if (c != c) {
+            c = 0.f;
+        }
+        return (uint32_t)(int32_t)rintf(c * rotationScale);
+    };
+
+    out[3] = quantize_component(rot.w);
+    out[4] = quantize_component(rot.x);
+    out[5] = quantize_component(rot.y);
+    out[6] = quantize_component(rot.z);
+}
+
+void dequantizeTransform(const uint32_t *in, float quantum,
+                         Vector3 *out_pos, Quat *out_rot)
+{
+    *out_pos = Vector3 {
+        dequantizePosition(in[0], quantum),
+        dequantizePosition(in[1], quantum),
+        dequantizePosition(in[2], quantum),
+    };
+
+    Quat rot {
+        (float)(int32_t)in[3] / rotationScale,
+        (float)(int32_t)in[4] / rotationScale,
+        (float)(int32_t)in[5] / rotationScale,
+        (float)(int32_t)in[6] / rotationScale,
+    };
+
+    float len2 = rot.w * rot.w + rot.x * rot.x + rot.y * rot.y +
+        rot.z * rot.z;
+    *out_rot = len2 > 0.f ? rot.normalize() : Quat { 1, 0, 0, 0 };
+}
+
+void quantizeInstance(const InstanceData &inst, float inv_quantum,
+                      uint32_t *out)
+{
+    quantizeTransform(inst.position, inst.rotation, inv_quantum, out);
+    out[7] = std::bit_cast<uint32_t>(inst.scale.d0);
+    out[8] = std::bit_cast<uint32_t>(inst.scale.d1);
+    out[9] = std::bit_cast<uint32_t>(inst.scale.d2);
+    out[10] = (uint32_t)inst.objectID;
+}
 
-    PerspectiveCameraData *interop_view_data = (PerspectiveCameraData *)alloc(
-        sizeof(PerspectiveCameraData) * cfg.maxViewsPerWorld * cfg.numWorlds);
+InstanceData dequantizeInstance(const uint32_t *in, float quantum,
+                                int32_t world_idx)
+{
+    InstanceData inst;
+    dequantizeTransform(in, quantum, &inst.position, &inst.rotation);
+    inst.scale = Diag3x3 {
+        std::bit_cast<float>(in[7]),
+        std::bit_cast<float>(in[8]),
+        std::bit_cast<float>(in[9]),
+    };
+    inst.objectID = (int32_t)in[10];
+    inst.worldIDX = world_idx;
 
-    uint64_t max_instances_per_step = cfg.maxInstancesPerWorld * cfg.numWorlds;
-    uint64_t num_instance_data_bytes_per_step =
-        sizeof(InstanceData) * (uint64_t)max_instances_per_step;
+    return inst;
+}
 
-    InstanceData *interop_instance_data = (InstanceData *)alloc(
-        num_instance_data_bytes_per_step);
+void quantizeView(const PerspectiveCameraData &view, float inv_quantum,
+                  uint32_t *out)
+{
+    quantizeTransform(view.position, view.rotation, inv_quantum, out);
+    out[7] = std::bit_cast<uint32_t>(view.xScale);
+    out[8] = std::bit_cast<uint32_t>(view.yScale);
+    out[9] = std::bit_cast<uint32_t>(view.zNear);
+}
 
-    bool *dones = (bool *)alloc(sizeof(bool) * cfg.numWorlds);
+PerspectiveCameraData dequantizeView(const uint32_t *in, float quantum,
+                                     int32_t world_idx)
+{
+    PerspectiveCameraData view;
+    dequantizeTransform(in, quantum, &view.position, &view.rotation);
+    view.xScale = std::bit_cast<float>(in[7]);
+    view.yScale = std::bit_cast<float>(in[8]);
+    view.zNear = std::bit_cast<float>(in[9]);
+    view.worldIDX = world_idx;
+    view.pad = 0;
+
+    return view;
+}
 
-    PerspectiveCameraData **interop_view_ptrs =
-        (PerspectiveCameraData **)alloc(
-            sizeof(PerspectiveCameraData *) * cfg.numWorlds);
+// Delta tokens are mostly zero: runs of zeros are coded as a single
+// varint with the low bit set, other tokens as varints of token << 1.
+class TokenWriter {
+public:
+    TokenWriter(std::vector<uint8_t> &out)
+        : out_(out),
+          zeroRun_(0)
+    {}
+
+    void push(uint32_t token)
+    {
+        if (token == 0) {
+            zeroRun_++;
+            return;
+        }
 
-    uint32_t *interop_num_views = (uint32_t *)alloc(
-        sizeof(uint32_t) * cfg.numWorlds);
+        flush();
+        writeVarint((uint64_t)token << 1);
+    }
 
-    InstanceData **interop_instance_ptrs = (InstanceData **)alloc(
-        sizeof(InstanceData *) * cfg.numWorlds);
+    void flush()
+    {
+        if (zeroRun_ > 0) {
+            writeVarint((zeroRun_ << 1) | 1);
+            zeroRun_ = 0;
+        }
+    }
 
-    uint32_t *interop_num_instances = (uint32_t *)alloc(
-        sizeof(uint32_t) * cfg.numWorlds);
+private:
+    void writeVarint(uint64_t v)
+    {
+        while (v >= 0x80) {
+            out_.push_back((uint8_t)(v | 0x80));
+            v >>= 7;
+        }
+        out_.push_back((uint8_t)v);
+    }
 
-    bool *done_readback;
-    if (gpu_copy_required) {
-#ifdef MADRONA_CUDA_SUPPORT
-        auto interop_view_ptrs_staging =
-            (PerspectiveCameraData *)cu::allocStaging(
-                sizeof(PerspectiveCameraData *) * cfg.numWorlds);
+    std::vector<uint8_t> &out_;
+    uint64_t zeroRun_;
+};
 
-        auto interop_instance_ptrs_staging = (InstanceData *)cu::allocStaging(
-            sizeof(InstanceData *) * cfg.numWorlds);
+class TokenReader {
+public:
+    TokenReader(const uint8_t *data, uint64_t num_bytes)
+        : cur_(data),
+          end_(data + num_bytes),
+          zeroRun_(0)
+    {}
+
+    uint32_t pop()
+    {
+        if (zeroRun_ > 0) {
+            zeroRun_--;
+            return 0;
+        }
 
-        for (uint32_t i = 0; i < cfg.numWorlds; i++) {
-            view_ptrs_staging[i] =
-                interop_view_data + i * cfg.maxViewsPerWorld;
-            instance_ptrs_staging[i] =
-                interop_instance_data + i * cfg.maxInstancesPerWorld;
+        uint64_t v = readVarint();
+        if ((v & 1) == 0) {
+            return (uint32_t)(v >> 1);
         }
 
-        cudaMemcpy(interop_view_ptrs, interop_view_ptrs_staging,
-                   sizeof(PerspectiveCameraData *) * cfg.numWorlds,
-                   cudaMemcpyHostToDevice);
-        cudaMemcpy(interop_instance_ptrs, interop_instance_ptrs_staging,
-                   sizeof(InstanceData *) * cfg.numWorlds,
-                   cudaMemcpyHostToDevice);
+        zeroRun_ = (v >> 1) - 1;
+        return 0;
+    }
 
-        done_readback = (bool *)cu::allocReadback(
-            sizeof(bool) * cfg.numWorlds);
-#endif
-    } else {
-        for (uint32_t i = 0; i < cfg.numWorlds; i++) {
-            interop_view_ptrs[i] =
-                interop_view_data + i * cfg.maxViewsPerWorld;
-            interop_instance_ptrs[i] =
-                interop_instance_data + i * cfg.maxInstancesPerWorld;
+private:
+    uint64_t readVarint()
+    {
+        uint64_t v = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 7) {
+            if (cur_ == end_) {
+                FATAL("Recording chunk ends unexpectedly");
+            }
+
+            uint8_t b = *cur_++;
+            v |= (uint64_t)(b & 0x7F) << shift;
+            if ((b & 0x80) == 0) {
+                return v;
+            }
         }
 
-        done_readback = nullptr;
+        FATAL("Invalid varint in recording chunk");
     }
 
-    RenderECSBridge bridge {
-        .views = interop_view_ptrs,
-        .numViews = interop_num_views,
-        .instances = interop_instance_ptrs,
-        .numInstances = interop_num_instances,
-        .renderWidth = (int32_t)cfg.renderWidth,
-        .renderHeight = (int32_t)cfg.renderHeight,
-        .episodeDone = dones,
-    };
+    const uint8_t *cur_;
+    const uint8_t *end_;
+    uint64_t zeroRun_;
+};
+
+// Per slot quantized values of the previous step, shared by the encoder
+// and decoder so both apply the same deltas.
+struct DeltaState {
+    HeapArray<uint32_t> instanceFields;
+    HeapArray<uint32_t> viewFields;
+    HeapArray<uint32_t> numInstances;
+    HeapArray<uint32_t> numViews;
+
+    DeltaState(uint32_t num_worlds, uint32_t max_views,
+               uint32_t max_instances)
+        : instanceFields(
+              (CountT)num_worlds * max_instances * numInstanceFields),
+          viewFields((CountT)num_worlds * max_views * numViewFields),
+          numInstances(num_worlds),
+          numViews(num_worlds)
+    {}
+
+    // Chunks start from zeros so they can be decoded on their own
+    void reset()
+    {
+        utils::zeroN<uint32_t>(instanceFields.data(), instanceFields.size());
+        utils::zeroN<uint32_t>(viewFields.data(), viewFields.size());
+        utils::zeroN<uint32_t>(numInstances.data(), numInstances.size());
+        utils::zeroN<uint32_t>(numViews.data(), numViews.size());
+    }
+};
 
-    uint32_t *cur_episode_lens = (uint32_t *)malloc(
-        sizeof(uint32_t) * cfg.numWorlds);
-    utils::zeroN<uint32_t>(cur_episode_lens, cfg.numWorlds);
+void encodeChunk(const QuantizedChunk &chunk,
+                 uint32_t num_worlds,
+                 uint32_t max_views,
+                 uint32_t max_instances,
+                 DeltaState &state,
+                 std::vector<uint8_t> &out)
+{
+    state.reset();
+    out.clear();
 
-    RenderECSBridge bridge;
-    bool gpuCopyRequired;
-    uint32_t numWorlds;
-    uint64_t numInstanceCopyBytes;
-    
-    uint32_t * curEpisodeLens;
-    bool * doneReadback;
-    InstanceData * curEpisodeInstanceData;
-    PerspectiveCameraData * curEpisodeViewData;
-
-    InstanceData * recordedInstances;
-    PerspectiveCameraData * recordedViews;
-    uint32_t * recordedEpisodeLengths;
-    uint32_t numRecordedEpisodes;
-
-    return new Impl {
-        .bridge = bridge,
-        .gpuCopyRequired = gpu_copy_required,
-        .numWorlds = cfg.numWorlds,
-        .numInstanceCopyBytes = num_instance_data_bytes_per_step,
-        .curEpisodeLengths = cur_episode_lens,
-        .doneReadback = done_readback,
-        .curEpisodeInstance
-    };
+    TokenWriter writer(out);
+
+    const uint32_t *instance_fields = chunk.instanceFields.data();
+    const uint32_t *view_fields = chunk.viewFields.data();
+
+    for (uint32_t step = 0; step < chunk.numSteps; step++) {
+        for (uint32_t world_idx = 0; world_idx < num_worlds; world_idx++) {
+            uint64_t step_world = (uint64_t)step * num_worlds + world_idx;
+
+            uint32_t num_instances = chunk.numInstances[step_world];
+            uint32_t num_views = chunk.numViews[step_world];
+
+            writer.push(encodeField(FieldKind::Quantized, num_instances,
+                                    state.numInstances[world_idx]));
+            writer.push(encodeField(FieldKind::Quantized, num_views,
+                                    state.numViews[world_idx]));
+            writer.push(chunk.dones[step_world]);
+
+            state.numInstances[world_idx] = num_instances;
+            state.numViews[world_idx] = num_views;
+
+            uint32_t *instance_state = state.instanceFields.data() +
+                (uint64_t)world_idx * max_instances * numInstanceFields;
+
+            for (uint32_t i = 0; i < num_instances; i++) {
+                uint32_t *prev = instance_state + i * numInstanceFields;
+                for (uint32_t f = 0; f < numInstanceFields; f++) {
+                    writer.push(encodeField(instanceFieldKinds[f],
+                                            instance_fields[f], prev[f]));
+                    prev[f] = instance_fields[f];
+                }
+
+                instance_fields += numInstanceFields;
+            }
+
+            uint32_t *view_state = state.viewFields.data() +
+                (uint64_t)world_idx * max_views * numViewFields;
+
+            for (uint32_t i = 0; i < num_views; i++) {
+                uint32_t *prev = view_state + i * numViewFields;
+                for (uint32_t f = 0; f < numViewFields; f++) {
+                    writer.push(encodeField(viewFieldKinds[f],
+                                            view_fields[f], prev[f]));
+                    prev[f] = view_fields[f];
+                }
+
+                view_fields += numViewFields;
+            }
+        }
+    }
+
+    writer.flush();
 }
 
-void Recorder::Impl::record()
+void decodeChunk(const uint8_t *data,
+                 uint64_t num_bytes,
+                 uint32_t num_steps,
+                 uint32_t num_worlds,
+                 uint32_t max_views,
+                 uint32_t max_instances,
+                 float quantum,
+                 DeltaState &state,
+                 DecodedChunk &chunk)
 {
-    bool *episode_dones;
-    if (gpuCopyRequired) {
-#ifdef MADRONA_CUDA_SUPPORT
-        cudaMemcpy(curEpisodeInstanceData, bridge.instancePtrs[0],
-                   numInstanceCopyBytes, cudaMemcpyDeviceToHost);
+    state.reset();
+    chunk.instances.clear();
+    chunk.views.clear();
+
+    TokenReader reader(data, num_bytes);
+
+    for (uint32_t step = 0; step < num_steps; step++) {
+        for (uint32_t world_idx = 0; world_idx < num_worlds; world_idx++) {
+            uint64_t step_world = (uint64_t)step * num_worlds + world_idx;
+
+            uint32_t num_instances = decodeField(FieldKind::Quantized,
+                reader.pop(), state.numInstances[world_idx]);
+            uint32_t num_views = decodeField(FieldKind::Quantized,
+                reader.pop(), state.numViews[world_idx]);
+            uint32_t done = reader.pop();
+
+            if (num_instances > max_instances || num_views > max_views) {
+                FATAL("Corrupt recording chunk: %u instances, %u views",
+                      num_instances, num_views);
+            }
+
+            state.numInstances[world_idx] = num_instances;
+            state.numViews[world_idx] = num_views;
+
+            chunk.numInstances[step_world] = num_instances;
+            chunk.numViews[step_world] = num_views;
+            chunk.dones[step_world] = done != 0;
+            chunk.instanceOffsets[step_world] = chunk.instances.size();
+            chunk.viewOffsets[step_world] = chunk.views.size();
+
+            uint32_t *instance_state = state.instanceFields.data() +
+                (uint64_t)world_idx * max_instances * numInstanceFields;
+
+            for (uint32_t i = 0; i < num_instances; i++) {
+                uint32_t *prev = instance_state + i * numInstanceFields;
+                for (uint32_t f = 0; f < numInstanceFields; f++) {
+                    prev[f] = decodeField(instanceFieldKinds[f],
+                                          reader.pop(), prev[f]);
+                }
+
+                chunk.instances.push_back(
+                    dequantizeInstance(prev, quantum, (int32_t)world_idx));
+            }
+
+            uint32_t *view_state = state.viewFields.data() +
+                (uint64_t)world_idx * max_views * numViewFields;
+
+            for (uint32_t i = 0; i < num_views; i++) {
+                uint32_t *prev = view_state + i * numViewFields;
+                for (uint32_t f = 0; f < numViewFields; f++) {
+                    prev[f] = decodeField(viewFieldKinds[f],
+                                          reader.pop(), prev[f]);
+                }
+
+                chunk.views.push_back(
+                    dequantizeView(prev, quantum, (int32_t)world_idx));
+            }
+        }
+    }
+}
 
-        cudaMemcpy(doneReadback, bridge.episodeDones,
-                   sizeof(bool) * numWorlds, cudaMemcpyDeviceToHost);
+int fileSeek(FILE *file, uint64_t offset, int origin)
+{
+#if defined(_WIN32)
+    return _fseeki64(file, (int64_t)offset, origin);
+#else
+    return fseeko(file, (off_t)offset, origin);
+#endif
+}
 
-        episode_dones = doneReadback;
+uint64_t fileTell(FILE *file)
+{
+#if defined(_WIN32)
+    return (uint64_t)_ftelli64(file);
+#else
+    return (uint64_t)ftello(file);
 #endif
-    } else {
-        memcpy(cudaEpisodeInstanceData, bridge.instancePtrs[0],
-               numInstanceCopyBytes);
+}
+
+}
+
+struct Recorder::Impl {
+    const RenderECSBridge *bridge;
+    uint32_t numWorlds;
+    uint32_t maxViewsPerWorld;
+    uint32_t maxInstancesPerWorld;
+    uint32_t stepsPerChunk;
+    float positionQuantum;
+
+    std::string outputPath;
+    FILE *file;
+    bool finished;
+
+    // Ring of maxQueuedChunks + 1 chunks: record() fills fillIdx while
+    // the writer thread drains the queued chunks starting at writeIdx.
+    std::vector<QuantizedChunk> chunks;
+    uint32_t fillIdx;
+    uint32_t writeIdx;
+    uint32_t numQueued;
+    uint64_t numSteps;
+
+    std::mutex lock;
+    std::condition_variable chunkQueued;
+    std::condition_variable chunkWritten;
+    bool writerExit;
+    std::thread writer;
+
+    // Writer thread only
+    DeltaState encodeState;
+    std::vector<uint8_t> encoded;
+    std::vector<ChunkIndexEntry> chunkIndex;
+    uint64_t fileOffset;
+
+    Impl(const Config &cfg);
+
+    void submitChunk();
+    void writerLoop();
+    void writeBytes(const void *data, uint64_t num_bytes);
+    void finish();
+};
 
-        episode_dones = bridge.episodeDones;
+Recorder::Impl::Impl(const Config &cfg)
+    : bridge(cfg.bridge),
+      numWorlds(cfg.numWorlds),
+      maxViewsPerWorld(cfg.bridge->maxViewsPerworld),
+      maxInstancesPerWorld(cfg.bridge->maxInstancesPerWorld),
+      stepsPerChunk(cfg.stepsPerChunk),
+      positionQuantum(cfg.positionQuantum),
+      outputPath(cfg.outputPath),
+      file(nullptr),
+      finished(false),
+      chunks(),
+      fillIdx(0),
+      writeIdx(0),
+      numQueued(0),
+      numSteps(0),
+      lock(),
+      chunkQueued(),
+      chunkWritten(),
+      writerExit(false),
+      writer(),
+      encodeState(cfg.numWorlds, maxViewsPerWorld, maxInstancesPerWorld),
+      encoded(),
+      chunkIndex(),
+      fileOffset(0)
+{
+    if (cfg.execMode != ExecMode::CPU) {
+        FATAL("Recorder only supports the CPU backend");
+    }
+
+    assert(stepsPerChunk > 0 && cfg.maxQueuedChunks > 0);
+    assert(positionQuantum > 0.f);
+
+    file = fopen(cfg.outputPath, "wb");
+    if (file == nullptr) {
+        FATAL("Recorder failed to open %s", cfg.outputPath);
     }
 
-    for (uint32_t i = 0; i < numWorlds; i++) {
-        uint32_t episode_len = ++curEpisodeLengths[i];
+    RecordingHeader hdr {
+        .magic = {},
+        .version = recordingVersion,
+        .numWorlds = numWorlds,
+        .maxViewsPerWorld = maxViewsPerWorld,
+        .maxInstancesPerWorld = maxInstancesPerWorld,
+        .stepsPerChunk = stepsPerChunk,
+        .positionQuantum = positionQuantum,
+    };
+    memcpy(hdr.magic, recordingMagic, sizeof(recordingMagic));
+    writeBytes(&hdr, sizeof(RecordingHeader));
+
+    chunks.reserve(cfg.maxQueuedChunks + 1);
+    for (uint32_t i = 0; i < cfg.maxQueuedChunks + 1; i++) {
+        chunks.emplace_back(stepsPerChunk, numWorlds);
+    }
 
-        if (episode_dones[i]) {
+    writer = std::thread([this]() { writerLoop(); });
+}
+
+void Recorder::Impl::writeBytes(const void *data, uint64_t num_bytes)
+{
+    if (fwrite(data, 1, num_bytes, file) != num_bytes) {
+        FATAL("Recorder failed to write to %s", outputPath.c_str());
+    }
+
+    fileOffset += num_bytes;
+}
+
+void Recorder::Impl::submitChunk()
+{
+    std::unique_lock guard(lock);
+    numQueued++;
+    chunkQueued.notify_one();
 
+    // Wait for the next chunk in the ring to be written out
+    fillIdx = (fillIdx + 1) % (uint32_t)chunks.size();
+    chunkWritten.wait(guard, [this]() {
+        return numQueued < (uint32_t)chunks.size();
+    });
+
+    chunks[fillIdx].numSteps = 0;
+}
+
+void Recorder::Impl::writerLoop()
+{
+    while (true) {
+        QuantizedChunk *chunk;
+        {
+            std::unique_lock guard(lock);
+            chunkQueued.wait(guard, [this]() {
+                return numQueued > 0 || writerExit;
+            });
+
+            if (numQueued == 0) {
+                return;
+            }
+
+            chunk = &chunks[writeIdx];
         }
+
+        encodeChunk(*chunk, numWorlds, maxViewsPerWorld,
+                    maxInstancesPerWorld, encodeState, encoded);
+
+        chunkIndex.push_back({
+            .fileOffset = fileOffset,
+            .numBytes = encoded.size(),
+            .firstStep = chunk->firstStep,
+            .numSteps = chunk->numSteps,
+        });
+        writeBytes(encoded.data(), encoded.size());
+
+        {
+            std::lock_guard guard(lock);
+            numQueued--;
+            writeIdx = (writeIdx + 1) % (uint32_t)chunks.size();
+        }
+        chunkWritten.notify_one();
+    }
+}
+
+void Recorder::Impl::finish()
+{
+    if (finished) {
+        return;
+    }
+    finished = true;
+
+    if (chunks[fillIdx].numSteps > 0) {
+        submitChunk();
+    }
+
+    {
+        std::lock_guard guard(lock);
+        writerExit = true;
     }
+    chunkQueued.notify_one();
+    writer.join();
+
+    RecordingTrailer trailer {
+        .indexOffset = fileOffset,
+        .numChunks = chunkIndex.size(),
+        .numSteps = numSteps,
+        .magic = {},
+    };
+    memcpy(trailer.magic, recordingMagic, sizeof(recordingMagic));
+
+    writeBytes(chunkIndex.data(),
+               sizeof(ChunkIndexEntry) * chunkIndex.size());
+    writeBytes(&trailer, sizeof(RecordingTrailer));
+
+    if (fclose(file) != 0) {
+        FATAL("Recorder failed to write to %s", outputPath.c_str());
+    }
+    file = nullptr;
 }
 
 Recorder::Recorder(const Config &cfg)
-    : impl_(Impl::init(cfg))
+    : impl_(new Impl(cfg))
 {}
 
 Recorder::Recorder(Recorder &&o) = default;
-Recorder::~Recorder() = default;
 
-const RenderECSBridge * Recorder::bridge() const
+Recorder::~Recorder()
+{
+    if (impl_) {
+        impl_->finish();
+    }
+}
+
+void Recorder::record(const bool *episode_dones)
+{
+    Impl &impl = *impl_;
+    assert(!impl.finished);
+
+    QuantizedChunk &chunk = impl.chunks[impl.fillIdx];
+    if (chunk.numSteps == 0) {
+        chunk.firstStep = impl.numSteps;
+        // Keeps the capacity of the last time this chunk was filled
+        chunk.instanceFields.clear();
+        chunk.viewFields.clear();
+    }
+
+    const RenderECSBridge *bridge = impl.bridge;
+    const uint32_t num_worlds = impl.numWorlds;
+    const float inv_quantum = 1.f / impl.positionQuantum;
+
+    for (uint32_t world_idx = 0; world_idx < num_worlds; world_idx++) {
+        uint64_t step_world = (uint64_t)chunk.numSteps * num_worlds +
+            world_idx;
+
+        uint32_t num_instances = bridge->numInstancesPerWorldCPU[world_idx];
+        uint32_t num_views = bridge->numViewsPerWorldCPU[world_idx];
+
+        const InstanceData *instances = bridge->worldInstancesCPU(world_idx);
+        size_t instance_offset = chunk.instanceFields.size();
+        chunk.instanceFields.resize(
+            instance_offset + (size_t)num_instances * numInstanceFields);
+
+        for (uint32_t i = 0; i < num_instances; i++) {
+            quantizeInstance(instances[i], inv_quantum,
+                chunk.instanceFields.data() + instance_offset +
+                    (size_t)i * numInstanceFields);
+        }
+
+        const PerspectiveCameraData *views = bridge->worldViewsCPU(world_idx);
+        size_t view_offset = chunk.viewFields.size();
+        chunk.viewFields.resize(
+            view_offset + (size_t)num_views * numViewFields);
+
+        for (uint32_t i = 0; i < num_views; i++) {
+            quantizeView(views[i], inv_quantum,
+                chunk.viewFields.data() + view_offset +
+                    (size_t)i * numViewFields);
+        }
+
+        chunk.numInstances[step_world] = num_instances;
+        chunk.numViews[step_world] = num_views;
+        chunk.dones[step_world] =
+            episode_dones != nullptr && episode_dones[world_idx];
+    }
+
+    chunk.numSteps++;
+    impl.numSteps++;
+
+    if (chunk.numSteps == impl.stepsPerChunk) {
+        impl.submitChunk();
+    }
+}
+
+void Recorder::finish()
+{
+    impl_->finish();
+}
+
+uint64_t Recorder::numRecordedSteps() const
+{
+    return impl_->numSteps;
+}
+
+struct RecordingReader::Impl {
+    FILE *file;
+    RecordingHeader hdr;
+    std::vector<ChunkIndexEntry> chunkIndex;
+    uint64_t numSteps;
+
+    DeltaState decodeState;
+    DecodedChunk decoded;
+    std::vector<uint8_t> compressed;
+    int64_t loadedChunk;
+    uint32_t curStep;
+
+    Impl(FILE *file, const RecordingHeader &hdr);
+    ~Impl();
+
+    static Impl * open(const char *path);
+    void loadChunk(int64_t chunk_idx);
+};
+
+RecordingReader::Impl::Impl(FILE *f, const RecordingHeader &h)
+    : file(f),
+      hdr(h),
+      chunkIndex(),
+      numSteps(0),
+      decodeState(h.numWorlds, h.maxViewsPerWorld, h.maxInstancesPerWorld),
+      decoded(h.stepsPerChunk, h.numWorlds),
+      compressed(),
+      loadedChunk(-1),
+      curStep(0)
+{}
+
+RecordingReader::Impl::~Impl()
+{
+    fclose(file);
+}
+
+void RecordingReader::Impl::loadChunk(int64_t chunk_idx)
+{
+    const ChunkIndexEntry &entry = chunkIndex[chunk_idx];
+
+    if (entry.numSteps > hdr.stepsPerChunk) {
+        FATAL("Corrupt recording index");
+    }
+
+    compressed.resize(entry.numBytes);
+    if (fileSeek(file, entry.fileOffset, SEEK_SET) != 0 ||
+            fread(compressed.data(), 1, entry.numBytes, file) !=
+                entry.numBytes) {
+        FATAL("Failed to read recording chunk %ld", (long)chunk_idx);
+    }
+
+    decodeChunk(compressed.data(), entry.numBytes, (uint32_t)entry.numSteps,
+                hdr.numWorlds, hdr.maxViewsPerWorld, hdr.maxInstancesPerWorld,
+                hdr.positionQuantum, decodeState, decoded);
+
+    decoded.firstStep = entry.firstStep;
+    decoded.numSteps = (uint32_t)entry.numSteps;
+    loadedChunk = chunk_idx;
+}
+
+RecordingReader::Impl * RecordingReader::Impl::open(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        FATAL("Failed to open recording %s", path);
+    }
+
+    RecordingHeader hdr;
+    if (fread(&hdr, sizeof(RecordingHeader), 1, file) != 1 ||
+            memcmp(hdr.magic, recordingMagic, sizeof(recordingMagic)) != 0 ||
+            hdr.version != recordingVersion) {
+        FATAL("%s is not a recording", path);
+    }
+
+    RecordingTrailer trailer;
+    if (fileSeek(file, 0, SEEK_END) != 0 ||
+            fileTell(file) < sizeof(RecordingHeader) +
+                sizeof(RecordingTrailer) ||
+            fileSeek(file, fileTell(file) - sizeof(RecordingTrailer),
+                     SEEK_SET) != 0 ||
+            fread(&trailer, sizeof(RecordingTrailer), 1, file) != 1 ||
+            memcmp(trailer.magic, recordingMagic,
+                   sizeof(recordingMagic)) != 0) {
+        FATAL("Recording %s is incomplete, Recorder::finish wasn't called",
+              path);
+    }
+
+    Impl *impl = new Impl(file, hdr);
+    impl->numSteps = trailer.numSteps;
+    impl->chunkIndex.resize(trailer.numChunks);
+
+    if (fileSeek(file, trailer.indexOffset, SEEK_SET) != 0 ||
+            fread(impl->chunkIndex.data(), sizeof(ChunkIndexEntry),
+                  trailer.numChunks, file) != trailer.numChunks) {
+        FATAL("Failed to read the index of recording %s", path);
+    }
+
+    return impl;
+}
+
+RecordingReader::RecordingReader(const char *path)
+    : impl_(Impl::open(path))
+{}
+
+RecordingReader::RecordingReader(RecordingReader &&o) = default;
+RecordingReader::~RecordingReader() = default;
+
+uint32_t RecordingReader::numWorlds() const
+{
+    return impl_->hdr.numWorlds;
+}
+
+uint64_t RecordingReader::numSteps() const
+{
+    return impl_->numSteps;
+}
+
+void RecordingReader::loadStep(uint64_t step)
+{
+    Impl &impl = *impl_;
+    assert(step < impl.numSteps);
+
+    auto chunk_iter = std::upper_bound(
+        impl.chunkIndex.begin(), impl.chunkIndex.end(), step,
+        [](uint64_t s, const ChunkIndexEntry &entry) {
+            return s < entry.firstStep;
+        });
+    int64_t chunk_idx = (chunk_iter - impl.chunkIndex.begin()) - 1;
+
+    if (chunk_idx != impl.loadedChunk) {
+        impl.loadChunk(chunk_idx);
+    }
+
+    impl.curStep = (uint32_t)(step - impl.decoded.firstStep);
+}
+
+uint32_t RecordingReader::numInstances(uint32_t world_idx) const
+{
+    return impl_->decoded.numInstances[
+        (uint64_t)impl_->curStep * impl_->hdr.numWorlds + world_idx];
+}
+
+const InstanceData * RecordingReader::instances(uint32_t world_idx) const
+{
+    return impl_->decoded.instances.data() + impl_->decoded.instanceOffsets[
+        (uint64_t)impl_->curStep * impl_->hdr.numWorlds + world_idx];
+}
+
+uint32_t RecordingReader::numViews(uint32_t world_idx) const
+{
+    return impl_->decoded.numViews[
+        (uint64_t)impl_->curStep * impl_->hdr.numWorlds + world_idx];
+}
+
+const PerspectiveCameraData * RecordingReader::views(
+    uint32_t world_idx) const
 {
-    return &impl_->bridge;
+    return impl_->decoded.views.data() + impl_->decoded.viewOffsets[
+        (uint64_t)impl_->curStep * impl_->hdr.numWorlds + world_idx];
 }
 
-void Recorder::record()
+bool RecordingReader::episodeDone(uint32_t world_idx) const
 {
-    impl_->record();
+    return impl_->decoded.dones[
+        (uint64_t)impl_->curStep * impl_->hdr.numWorlds + world_idx] != 0;
 }
 
 }
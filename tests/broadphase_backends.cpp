@@ -0,0 +1,494 @@
+/*
+ * Copyright 2021-2022 Brennan Shacklett and contributors
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+#include <gtest/gtest.h>
+
+#include <madrona/physics.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+using namespace madrona;
+using namespace madrona::math;
+using namespace madrona::phys;
+using namespace madrona::phys::broadphase;
+
+namespace {
+
+enum class Scene {
+    Uniform,
+    Clustered,
+    PlaneAndBoxes,
+    MixedSizes,
+};
+
+const char * sceneName(Scene scene)
+{
+    switch (scene) {
+    case Scene::Uniform: return "Uniform";
+    case Scene::Clustered: return "Clustered";
+    case Scene::PlaneAndBoxes: return "PlaneAndBoxes";
+    case Scene::MixedSizes: return "MixedSizes";
+    default: return "";
+    }
+}
+
+constexpr Scene allScenes[] = {
+    Scene::Uniform,
+    Scene::Clustered,
+    Scene::PlaneAndBoxes,
+    Scene::MixedSizes,
+};
+
+AABB boxAt(Vector3 center, float half_extent)
+{
+    return AABB {
+        center - Vector3 { half_extent, half_extent, half_extent },
+        center + Vector3 { half_extent, half_extent, half_extent },
+    };
+}
+
+// Roughly one object per 8 units of volume, with ~1 unit objects
+std::vector<AABB> makeScene(Scene scene, CountT num_leaves, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+
+    float arena = cbrtf(float(num_leaves));
+    std::uniform_real_distribution<float> pos_dist(-arena, arena);
+    std::normal_distribution<float> cluster_dist(0.f, 0.5f * cbrtf(16.f));
+    std::uniform_real_distribution<float> log_size_dist(logf(0.05f),
+                                                        logf(4.f));
+
+    std::vector<AABB> aabbs;
+    aabbs.reserve(num_leaves);
+
+    switch (scene) {
+    case Scene::Uniform: {
+        for (CountT i = 0; i < num_leaves; i++) {
+            Vector3 pos { pos_dist(rng), pos_dist(rng), pos_dist(rng) };
+            aabbs.push_back(boxAt(pos, 0.5f));
+        }
+    } break;
+    case Scene::Clustered: {
+        std::vector<Vector3> centers;
+        for (CountT i = 0; i < std::max(num_leaves / 16, CountT(1)); i++) {
+            centers.push_back({ pos_dist(rng), pos_dist(rng), pos_dist(rng) });
+        }
+
+        for (CountT i = 0; i < num_leaves; i++) {
+            Vector3 center = centers[rng() % centers.size()];
+            Vector3 pos = center + Vector3 {
+                cluster_dist(rng), cluster_dist(rng), cluster_dist(rng) };
+            aabbs.push_back(boxAt(pos, 0.5f));
+        }
+    } break;
+    case Scene::PlaneAndBoxes: {
+        // Infinite ground plane plus a finite but very large slab
+        aabbs.push_back(AABB {
+            { -INFINITY, -INFINITY, -INFINITY },
+            { INFINITY, INFINITY, 0.f },
+        });
+        aabbs.push_back(AABB {
+            { -4.f * arena, -4.f * arena, -1.f },
+            { 4.f * arena, 4.f * arena, 0.25f },
+        });
+
+        for (CountT i = 2; i < num_leaves; i++) {
+            Vector3 pos { pos_dist(rng), pos_dist(rng),
+                0.5f + 0.5f * (pos_dist(rng) + arena) };
+            aabbs.push_back(boxAt(pos, 0.5f));
+        }
+    } break;
+    case Scene::MixedSizes: {
+        for (CountT i = 0; i < num_leaves; i++) {
+            Vector3 pos { pos_dist(rng), pos_dist(rng), pos_dist(rng) };
+            aabbs.push_back(boxAt(pos, expf(log_size_dist(rng))));
+        }
+    } break;
+    default: break;
+    }
+
+    return aabbs;
+}
+
+std::vector<int32_t> bruteForceOverlaps(const std::vector<AABB> &aabbs,
+                                        const AABB &query)
+{
+    std::vector<int32_t> result;
+    for (CountT i = 0; i < (CountT)aabbs.size(); i++) {
+        if (query.overlaps(aabbs[i])) {
+            result.push_back((int32_t)i);
+        }
+    }
+
+    return result;
+}
+
+template <typename Structure>
+std::vector<int32_t> structureOverlaps(const Structure &structure,
+                                       const std::vector<AABB> &aabbs,
+                                       const AABB &query)
+{
+    std::vector<int32_t> result;
+    structure.findIntersecting(aabbs.data(), query, [&](int32_t leaf_idx) {
+        result.push_back(leaf_idx);
+    });
+
+    // Duplicates are an error, so only sort
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::vector<AABB> makeQueries(const std::vector<AABB> &aabbs, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> pos_dist(-20.f, 20.f);
+    std::uniform_real_distribution<float> size_dist(0.f, 6.f);
+
+    std::vector<AABB> queries;
+    for (CountT i = 0; i < (CountT)aabbs.size(); i++) {
+        queries.push_back(aabbs[i]);
+    }
+
+    for (CountT i = 0; i < 64; i++) {
+        queries.push_back(boxAt(
+            { pos_dist(rng), pos_dist(rng), pos_dist(rng) }, size_dist(rng)));
+    }
+
+    // Larger than the cell limit, and unbounded
+    queries.push_back(boxAt(Vector3::zero(), 100.f));
+    queries.push_back(AABB {
+        { -INFINITY, -INFINITY, -INFINITY },
+        { INFINITY, INFINITY, INFINITY },
+    });
+
+    return queries;
+}
+
+template <typename Structure>
+void checkOverlaps(const Structure &structure,
+                   const std::vector<AABB> &aabbs,
+                   const char *name)
+{
+    for (const AABB &query : makeQueries(aabbs, 7)) {
+        std::vector<int32_t> expected = bruteForceOverlaps(aabbs, query);
+        std::vector<int32_t> found = structureOverlaps(structure, aabbs, query);
+        ASSERT_EQ(found, expected) << name;
+    }
+}
+
+struct RayTest {
+    Vector3 o;
+    Vector3 d;
+    float tMax;
+};
+
+std::vector<RayTest> makeRays(uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> pos_dist(-30.f, 30.f);
+    // Mostly short enough for the grid to walk rather than test every leaf
+    std::uniform_real_distribution<float> t_dist(0.f, 0.3f);
+
+    std::vector<RayTest> rays;
+    for (CountT i = 0; i < 256; i++) {
+        Vector3 o { pos_dist(rng), pos_dist(rng), pos_dist(rng) };
+        Vector3 target { pos_dist(rng), pos_dist(rng), pos_dist(rng) };
+        rays.push_back({ o, target - o, t_dist(rng) });
+    }
+
+    for (CountT i = 0; i < 16; i++) {
+        Vector3 o { pos_dist(rng), pos_dist(rng), pos_dist(rng) };
+        Vector3 target { pos_dist(rng), pos_dist(rng), pos_dist(rng) };
+        rays.push_back({ o, target - o, 2.f });
+    }
+
+    // Axis aligned rays exercise the zero direction components
+    rays.push_back({ { -30.f, 0.3f, 0.7f }, { 1.f, 0.f, 0.f }, 60.f });
+    rays.push_back({ { 0.1f, 0.2f, 30.f }, { 0.f, 0.f, -1.f }, 60.f });
+
+    return rays;
+}
+
+template <typename Structure>
+void checkRays(const Structure &structure,
+               const std::vector<AABB> &aabbs,
+               const char *name)
+{
+    for (const RayTest &ray : makeRays(11)) {
+        Diag3x3 inv_d = Diag3x3::fromVec(ray.d).inv();
+
+        std::vector<int32_t> expected;
+        float expected_closest = ray.tMax;
+        for (CountT i = 0; i < (CountT)aabbs.size(); i++) {
+            AABB aabb = aabbs[i];
+            float t;
+            if (aabb.rayIntersects(ray.o, inv_d, 0.f, ray.tMax, t)) {
+                expected.push_back((int32_t)i);
+                expected_closest = fminf(expected_closest, t);
+            }
+        }
+
+        // Without shrinking t_max every leaf the ray touches is visited
+        std::vector<int32_t> found;
+        structure.traceRay(aabbs.data(), ray.o, ray.d, ray.tMax,
+                           [&](int32_t leaf_idx, float t_max) {
+            found.push_back(leaf_idx);
+            return t_max;
+        });
+        std::sort(found.begin(), found.end());
+        ASSERT_EQ(found, expected) << name;
+
+        // Shrinking t_max to each AABB entry finds the closest one
+        float closest = ray.tMax;
+        structure.traceRay(aabbs.data(), ray.o, ray.d, ray.tMax,
+                           [&](int32_t leaf_idx, float t_max) {
+            AABB aabb = aabbs[leaf_idx];
+            float t;
+            if (aabb.rayIntersects(ray.o, inv_d, 0.f, t_max, t)) {
+                closest = fminf(closest, t);
+                return t;
+            }
+            return t_max;
+        });
+        EXPECT_EQ(closest, expected_closest) << name;
+    }
+}
+
+}
+
+TEST(BroadphaseBackends, GridMatchesBruteForce)
+{
+    for (Scene scene : allScenes) {
+        std::vector<AABB> aabbs = makeScene(scene, 1024, 1);
+
+        UniformGrid grid(aabbs.size(), 1.5f);
+        grid.build(aabbs.data(), aabbs.size());
+
+        checkOverlaps(grid, aabbs, sceneName(scene));
+        checkRays(grid, aabbs, sceneName(scene));
+    }
+}
+
+TEST(BroadphaseBackends, SweepAndPruneMatchesBruteForce)
+{
+    for (Scene scene : allScenes) {
+        std::vector<AABB> aabbs = makeScene(scene, 1024, 2);
+
+        SweepAndPrune sap(aabbs.size());
+        sap.build(aabbs.data(), aabbs.size());
+
+        checkOverlaps(sap, aabbs, sceneName(scene));
+        checkRays(sap, aabbs, sceneName(scene));
+    }
+}
+
+TEST(BroadphaseBackends, SweepAndPruneIncrementalUpdate)
+{
+    std::vector<AABB> aabbs = makeScene(Scene::MixedSizes, 1024, 3);
+
+    SweepAndPrune sap(aabbs.size());
+    sap.build(aabbs.data(), aabbs.size());
+
+    std::mt19937 rng(4);
+    std::uniform_real_distribution<float> step_dist(-0.2f, 0.2f);
+
+    // Small motion is handled by the insertion sort
+    for (CountT frame = 0; frame < 4; frame++) {
+        for (AABB &aabb : aabbs) {
+            Vector3 delta { step_dist(rng), step_dist(rng), step_dist(rng) };
+            aabb.pMin += delta;
+            aabb.pMax += delta;
+        }
+
+        sap.build(aabbs.data(), aabbs.size());
+        checkOverlaps(sap, aabbs, "Incremental");
+    }
+
+    // Reshuffling everything falls back to a full sort
+    std::shuffle(aabbs.begin(), aabbs.end(), rng);
+    sap.build(aabbs.data(), aabbs.size());
+    checkOverlaps(sap, aabbs, "Shuffled");
+}
+
+TEST(BroadphaseBackends, BVHFacadeLeafPairs)
+{
+    constexpr CountT num_leaves = 512;
+
+    std::vector<AABB> world_aabbs = makeScene(Scene::Uniform, num_leaves, 5);
+    AABB unit_box = boxAt(Vector3::zero(), 0.5f);
+
+    auto findPairs = [&](Backend backend) {
+        Config config;
+        config.backend = backend;
+        config.gridCellSize = 1.5f;
+
+        BVH bvh(nullptr, num_leaves, 0.f, 0.f, config);
+        std::vector<LeafID> leaves;
+        for (CountT i = 0; i < num_leaves; i++) {
+            leaves.push_back(bvh.reserveLeaf(
+                Entity { 0, (int32_t)i }, base::ObjectID { 0 }));
+
+            AABB aabb = world_aabbs[i];
+            bvh.updateLeafPosition(leaves.back(),
+                (aabb.pMin + aabb.pMax) / 2.f, Quat { 1, 0, 0, 0 },
+                Diag3x3 { 1, 1, 1 }, Vector3::zero(), unit_box);
+        }
+
+        bvh.updateTree();
+        for (LeafID leaf : leaves) {
+            bvh.refitLeaf(leaf, bvh.getLeafAABB(leaf));
+        }
+        bvh.finishRefit();
+
+        std::vector<std::pair<int32_t, int32_t>> pairs;
+        for (LeafID leaf : leaves) {
+            bvh.findLeafIntersecting(leaf, [&](Entity e) {
+                if (leaf.id < e.id) {
+                    pairs.push_back({ leaf.id, e.id });
+                }
+            });
+        }
+        std::sort(pairs.begin(), pairs.end());
+
+        return pairs;
+    };
+
+    auto bvh_pairs = findPairs(Backend::BVH);
+    auto grid_pairs = findPairs(Backend::UniformGrid);
+    auto sap_pairs = findPairs(Backend::SweepAndPrune);
+
+    EXPECT_FALSE(grid_pairs.empty());
+    EXPECT_EQ(grid_pairs, sap_pairs);
+
+    // The BVH tests leaves against their refit node bounds, which can
+    // only be looser
+    EXPECT_TRUE(std::includes(bvh_pairs.begin(), bvh_pairs.end(),
+                              grid_pairs.begin(), grid_pairs.end()));
+}
+
+// Times the broadphase update and the per leaf pair search with every leaf
+// moving at a constant speed and bouncing off the arena walls. The BVH is
+// only refit after it's first built, so its bounds loosen as leaves move.
+TEST(BroadphaseBackends, DISABLED_Bench)
+{
+    constexpr CountT num_leaves = 4096;
+    constexpr CountT num_frames = 300;
+    constexpr float speed = 0.1f;
+
+    const float arena = cbrtf(float(num_leaves));
+    AABB unit_box = boxAt(Vector3::zero(), 0.5f);
+
+    struct Mode {
+        const char *name;
+        Backend backend;
+    };
+
+    using Clock = std::chrono::steady_clock;
+    auto elapsedMS = [](Clock::time_point start, Clock::time_point end) {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    };
+
+    for (Scene scene : allScenes) {
+        std::vector<AABB> start_aabbs = makeScene(scene, num_leaves, 6);
+
+        for (Mode mode : {
+                Mode { "BVH", Backend::BVH },
+                Mode { "UniformGrid", Backend::UniformGrid },
+                Mode { "SweepAndPrune", Backend::SweepAndPrune },
+            }) {
+            Config config;
+            config.backend = mode.backend;
+            config.gridCellSize = 2.f;
+
+            BVH bvh(nullptr, num_leaves, 0.f, 0.f, config);
+
+            std::mt19937 rng(7);
+            std::normal_distribution<float> dir_dist;
+
+            std::vector<LeafID> leaves;
+            std::vector<Vector3> positions;
+            std::vector<Vector3> velocities;
+            std::vector<Diag3x3> scales;
+            for (CountT i = 0; i < num_leaves; i++) {
+                leaves.push_back(bvh.reserveLeaf(
+                    Entity { 0, (int32_t)i }, base::ObjectID { 0 }));
+
+                AABB aabb = start_aabbs[i];
+                Vector3 extent = aabb.pMax - aabb.pMin;
+
+                // The plane and slab stay put, everything else is a scaled
+                // unit box
+                if (extent.x > arena) {
+                    Vector3 center = (aabb.pMin + aabb.pMax) / 2.f;
+                    positions.push_back(
+                        extent.x <= FLT_MAX ? center : Vector3::zero());
+                    velocities.push_back(Vector3::zero());
+                    scales.push_back(extent.x <= FLT_MAX ?
+                        Diag3x3::fromVec(extent) :
+                        Diag3x3 { 1e6f, 1e6f, 1e6f });
+                } else {
+                    Vector3 dir {
+                        dir_dist(rng), dir_dist(rng), dir_dist(rng) };
+                    positions.push_back((aabb.pMin + aabb.pMax) / 2.f);
+                    velocities.push_back(speed * normalize(dir));
+                    scales.push_back(Diag3x3::fromVec(extent));
+                }
+            }
+
+            CountT total_pairs = 0;
+            double build_ms = 0.0;
+            double query_ms = 0.0;
+
+            for (CountT frame = 0; frame < num_frames; frame++) {
+                for (CountT i = 0; i < num_leaves; i++) {
+                    positions[i] += velocities[i];
+
+#pragma unroll
+                    for (CountT j = 0; j < 3; j++) {
+                        if (fabsf(positions[i][j]) > arena &&
+                                positions[i][j] * velocities[i][j] > 0.f) {
+                            velocities[i][j] = -velocities[i][j];
+                        }
+                    }
+
+                    bvh.updateLeafPosition(leaves[i], positions[i],
+                        Quat { 1, 0, 0, 0 }, scales[i], Vector3::zero(),
+                        unit_box);
+                }
+
+                auto build_start = Clock::now();
+
+                bvh.updateTree();
+                for (LeafID leaf : leaves) {
+                    bvh.refitLeaf(leaf, bvh.getLeafAABB(leaf));
+                }
+                bvh.finishRefit();
+
+                auto query_start = Clock::now();
+
+                for (LeafID leaf : leaves) {
+                    bvh.findLeafIntersecting(leaf, [&](Entity e) {
+                        total_pairs += leaf.id < e.id;
+                    });
+                }
+
+                auto query_end = Clock::now();
+
+                build_ms += elapsedMS(build_start, query_start);
+                query_ms += elapsedMS(query_start, query_end);
+            }
+
+            printf("%s %s: build %.3f ms/frame, query %.3f ms/frame, "
+                   "%.1f pairs/frame\n",
+                   sceneName(scene), mode.name, build_ms / num_frames,
+                   query_ms / num_frames, double(total_pairs) / num_frames);
+        }
+    }
+}
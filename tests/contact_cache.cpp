@@ -0,0 +1,235 @@
+/*
+ * Copyright 2021-2022 Brennan Shacklett and contributors
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+#include <gtest/gtest.h>
+
+#include "../src/physics/physics_impl.hpp"
+
+#include <vector>
+
+using namespace madrona;
+using namespace madrona::phys;
+
+namespace {
+
+uint64_t testKey(int32_t i)
+{
+    return ContactCache::makeKey(broadphase::LeafID { i },
+        broadphase::LeafID { i + 1 }, 0, 0);
+}
+
+// The hash is private to narrowphase, so find home slots by inserting each
+// key into an empty table
+std::vector<uint64_t> keysWithHome(ContactCache &cache, uint32_t home,
+                                   int32_t count)
+{
+    std::vector<uint64_t> keys;
+    for (int32_t i = 0; (int32_t)keys.size() < count; i++) {
+        uint64_t key = testKey(i);
+
+        cache.clear();
+        if ((uint32_t)cache.findOrInsert(key) == home) {
+            keys.push_back(key);
+        }
+    }
+    cache.clear();
+
+    return keys;
+}
+
+struct TestCache : ContactCache {
+    TestCache()
+        : ContactCache(0)
+    {}
+
+    ~TestCache()
+    {
+        rawDealloc(entries);
+        rawDealloc(liveEntries);
+    }
+};
+
+// liveEntries must list exactly the occupied slots, each pointing back at
+// its position in the list
+void expectLiveEntriesMatch(const ContactCache &cache)
+{
+    uint32_t num_occupied = 0;
+    for (uint32_t i = 0; i < cache.capacity; i++) {
+        if (cache.entries[i].key != ContactCache::emptyKey) {
+            num_occupied++;
+        }
+    }
+    EXPECT_EQ(cache.numLive, num_occupied);
+
+    for (uint32_t i = 0; i < cache.numLive; i++) {
+        uint32_t idx = cache.liveEntries[i];
+        ASSERT_LT(idx, cache.capacity);
+        EXPECT_NE(cache.entries[idx].key, ContactCache::emptyKey);
+        EXPECT_EQ(cache.entries[idx].liveIdx, i);
+    }
+}
+
+}
+
+TEST(ContactCache, KeyFits)
+{
+    using broadphase::LeafID;
+
+    EXPECT_TRUE(ContactCache::keyFits(LeafID { 0 }, LeafID { 1 }, 0, 255));
+    EXPECT_TRUE(ContactCache::keyFits(
+        LeafID { (1 << 24) - 2 }, LeafID { 0 }, 255, 0));
+
+    // Would alias other pairs or collide with emptyKey
+    EXPECT_FALSE(ContactCache::keyFits(
+        LeafID { (1 << 24) - 1 }, LeafID { 0 }, 0, 0));
+    EXPECT_FALSE(ContactCache::keyFits(
+        LeafID { 0 }, LeafID { 1 << 24 }, 0, 0));
+    EXPECT_FALSE(ContactCache::keyFits(LeafID { 0 }, LeafID { 1 }, 256, 0));
+    EXPECT_FALSE(ContactCache::keyFits(LeafID { 0 }, LeafID { 1 }, 0, 256));
+    EXPECT_FALSE(ContactCache::keyFits(LeafID { -1 }, LeafID { 1 }, 0, 0));
+}
+
+TEST(ContactCache, InsertHitAndExpire)
+{
+    TestCache cache;
+
+    uint64_t key = testKey(5);
+    int32_t idx = cache.findOrInsert(key);
+    ASSERT_GE(idx, 0);
+    EXPECT_EQ(cache.entries[idx].key, key);
+    EXPECT_EQ(cache.entries[idx].numPoints, 0);
+    EXPECT_EQ(cache.entries[idx].satFeature, ContactCache::SATFeature::None);
+
+    cache.entries[idx].numPoints = 3;
+    cache.entries[idx].normalImpulses[0] = 1.5f;
+
+    // Same step and next step hit the existing entry
+    EXPECT_EQ(cache.findOrInsert(key), idx);
+    cache.advanceStep();
+    EXPECT_EQ(cache.findOrInsert(key), idx);
+    EXPECT_EQ(cache.entries[idx].numPoints, 3);
+    EXPECT_EQ(cache.entries[idx].normalImpulses[0], 1.5f);
+
+    // Survives the step it was touched in, then expires
+    cache.advanceStep();
+    EXPECT_EQ(cache.entries[idx].key, key);
+    cache.advanceStep();
+    EXPECT_EQ(cache.entries[idx].key, ContactCache::emptyKey);
+
+    // Reinserted without history
+    EXPECT_EQ(cache.findOrInsert(key), idx);
+    EXPECT_EQ(cache.entries[idx].numPoints, 0);
+}
+
+TEST(ContactCache, BackwardShiftDelete)
+{
+    TestCache cache;
+    const uint32_t mask = cache.capacity - 1;
+
+    // Home on the last slot so the probe chain wraps around
+    const uint32_t home = mask;
+    std::vector<uint64_t> keys = keysWithHome(cache, home, 3);
+    std::vector<uint64_t> next_keys = keysWithHome(cache, 0, 1);
+
+    // Chain: keys[0] @ home, keys[1] @ 0, next_keys[0] (home 0) @ 1,
+    // keys[2] @ 2
+    EXPECT_EQ(cache.findOrInsert(keys[0]), (int32_t)home);
+    EXPECT_EQ(cache.findOrInsert(keys[1]), 0);
+    EXPECT_EQ(cache.findOrInsert(next_keys[0]), 1);
+    EXPECT_EQ(cache.findOrInsert(keys[2]), 2);
+
+    cache.entries[2].numPoints = 2;
+    cache.advanceStep();
+
+    // keys[0] goes stale, everything behind it shifts back by one
+    cache.findOrInsert(keys[1]);
+    cache.findOrInsert(next_keys[0]);
+    cache.findOrInsert(keys[2]);
+    cache.advanceStep();
+
+    EXPECT_EQ(cache.entries[home].key, keys[1]);
+    EXPECT_EQ(cache.entries[0].key, next_keys[0]);
+    EXPECT_EQ(cache.entries[1].key, keys[2]);
+    EXPECT_EQ(cache.entries[1].numPoints, 2);
+    EXPECT_EQ(cache.entries[2].key, ContactCache::emptyKey);
+
+    // Remaining keys are still found with their history
+    EXPECT_EQ(cache.findOrInsert(keys[1]), (int32_t)home);
+    EXPECT_EQ(cache.findOrInsert(next_keys[0]), 0);
+    EXPECT_EQ(cache.findOrInsert(keys[2]), 1);
+    EXPECT_EQ(cache.entries[1].numPoints, 2);
+
+    // Removing next_keys[0] must not move keys[2] in front of its home
+    cache.advanceStep();
+    cache.findOrInsert(keys[1]);
+    cache.findOrInsert(keys[2]);
+    cache.advanceStep();
+
+    EXPECT_EQ(cache.entries[home].key, keys[1]);
+    EXPECT_EQ(cache.entries[0].key, keys[2]);
+    EXPECT_EQ(cache.entries[1].key, ContactCache::emptyKey);
+}
+
+TEST(ContactCache, ProbeExhaustion)
+{
+    TestCache cache;
+
+    std::vector<uint64_t> keys =
+        keysWithHome(cache, 7, ContactCache::maxProbes + 1);
+
+    for (int32_t i = 0; i < ContactCache::maxProbes; i++) {
+        EXPECT_EQ(cache.findOrInsert(keys[i]), 7 + i);
+    }
+
+    EXPECT_EQ(cache.findOrInsert(keys[ContactCache::maxProbes]), -1);
+
+    // Existing keys are still found at the end of the chain
+    EXPECT_EQ(cache.findOrInsert(keys[ContactCache::maxProbes - 1]),
+              7 + ContactCache::maxProbes - 1);
+}
+
+TEST(ContactCache, LiveEntriesFollowDeletes)
+{
+    TestCache cache;
+    const uint32_t mask = cache.capacity - 1;
+
+    // Two wrapping chains plus some scattered keys
+    std::vector<uint64_t> keys = keysWithHome(cache, mask, 4);
+    for (uint64_t key : keysWithHome(cache, 3, 3)) {
+        keys.push_back(key);
+    }
+    for (int32_t i = 0; i < 8; i++) {
+        keys.push_back(testKey(1000 + i));
+    }
+
+    for (uint64_t key : keys) {
+        ASSERT_GE(cache.findOrInsert(key), 0);
+    }
+    expectLiveEntriesMatch(cache);
+
+    // Keep every third key, the rest expire and shift their chains
+    cache.advanceStep();
+    for (size_t i = 0; i < keys.size(); i += 3) {
+        cache.findOrInsert(keys[i]);
+    }
+    cache.advanceStep();
+    expectLiveEntriesMatch(cache);
+
+    for (size_t i = 0; i < keys.size(); i++) {
+        int32_t idx = cache.findOrInsert(keys[i]);
+        ASSERT_GE(idx, 0);
+        // Expired keys come back as fresh inserts
+        EXPECT_EQ(cache.entries[idx].key, keys[i]);
+    }
+    expectLiveEntriesMatch(cache);
+
+    // Everything expires
+    cache.advanceStep();
+    cache.advanceStep();
+    EXPECT_EQ(cache.numLive, 0u);
+    expectLiveEntriesMatch(cache);
+}
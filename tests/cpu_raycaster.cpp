@@ -0,0 +1,451 @@
+#include <gtest/gtest.h>
+
+#include <madrona/mesh_bvh.hpp>
+#include <madrona/physics_assets.hpp>
+#include <madrona/rand.hpp>
+#include <madrona/stack_alloc.hpp>
+
+#include "../src/render/cpu_raycaster.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace madrona;
+using namespace madrona::math;
+using namespace madrona::render;
+
+namespace {
+
+// Unit cube centered on the origin
+struct CubeObject {
+    std::vector<Vector3> positions;
+    std::vector<uint32_t> indices;
+    imp::SourceMesh mesh;
+
+    CubeObject()
+        : positions(),
+          indices(),
+          mesh()
+    {
+        for (int32_t i = 0; i < 8; i++) {
+            positions.push_back({
+                (i & 1) ? 0.5f : -0.5f,
+                (i & 2) ? 0.5f : -0.5f,
+                (i & 4) ? 0.5f : -0.5f,
+            });
+        }
+
+        indices = {
+            0, 2, 3, 0, 3, 1, // -z
+            4, 5, 7, 4, 7, 6, // +z
+            0, 1, 5, 0, 5, 4, // -y
+            2, 6, 7, 2, 7, 3, // +y
+            0, 4, 6, 0, 6, 2, // -x
+            1, 3, 7, 1, 7, 5, // +x
+        };
+
+        mesh = imp::SourceMesh {
+            .positions = positions.data(),
+            .normals = nullptr,
+            .tangentAndSigns = nullptr,
+            .uvs = nullptr,
+            .indices = indices.data(),
+            .faceCounts = nullptr,
+            .faceMaterials = nullptr,
+            .numVertices = (uint32_t)positions.size(),
+            .numFaces = (uint32_t)indices.size() / 3,
+            .materialIDX = 0,
+        };
+    }
+
+    imp::SourceObject object() { return { Span(&mesh, 1) }; }
+};
+
+constexpr float testZNear = 0.1f;
+
+// 90 degree field of view
+PerspectiveCameraData makeCamera(Vector3 pos, Quat view_to_world)
+{
+    return PerspectiveCameraData {
+        .position = pos,
+        .rotation = view_to_world.inv(),
+        .xScale = 1.f,
+        .yScale = 1.f,
+        .zNear = testZNear,
+        .worldIDX = 0,
+        .pad = 0,
+    };
+}
+
+InstanceData makeInstance(Vector3 pos, Quat rot, Diag3x3 scale,
+                          int32_t object_id)
+{
+    return InstanceData {
+        .position = pos,
+        .rotation = rot,
+        .scale = scale,
+        .objectID = object_id,
+        .worldIDX = 0,
+    };
+}
+
+// Mimics what RenderingSystem writes on the CPU backend: a fixed slot
+// range per world plus the per world counts.
+void setWorld(const RenderECSBridge *bridge, uint32_t world_idx,
+              const std::vector<PerspectiveCameraData> &views,
+              const std::vector<InstanceData> &instances)
+{
+    for (size_t i = 0; i < views.size(); i++) {
+        bridge->views[world_idx * bridge->maxViewsPerworld + i] = views[i];
+    }
+    for (size_t i = 0; i < instances.size(); i++) {
+        bridge->instances[world_idx * bridge->maxInstancesPerWorld + i] =
+            instances[i];
+    }
+
+    bridge->numViewsPerWorldCPU[world_idx] = (uint32_t)views.size();
+    bridge->numInstancesPerWorldCPU[world_idx] = (uint32_t)instances.size();
+}
+
+Vector3 pixelViewDir(uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+{
+    return {
+        2.f * ((float)x + 0.5f) / (float)w - 1.f,
+        1.f,
+        2.f * ((float)y + 0.5f) / (float)h - 1.f,
+    };
+}
+
+}
+
+TEST(CPURaycaster, SingleCube)
+{
+    constexpr uint32_t res = 16;
+
+    CubeObject cube;
+    imp::SourceObject obj = cube.object();
+
+    CPURaycaster raycaster({
+        .renderWidth = res,
+        .renderHeight = res,
+        .numWorlds = 1,
+        .maxViewsPerWorld = 1,
+        .maxInstancesPerWorld = 4,
+        .numThreads = 2,
+    });
+    EXPECT_EQ(raycaster.loadObjects(Span(&obj, 1)), 1);
+
+    setWorld(raycaster.bridge(), 0,
+             { makeCamera(Vector3::zero(), Quat { 1, 0, 0, 0 }) },
+             { makeInstance({ 0, 5, 0 }, { 1, 0, 0, 0 }, { 1, 1, 1 }, 0) });
+
+    raycaster.readECS();
+    EXPECT_EQ(*raycaster.bridge()->totalNumViews, 1u);
+    EXPECT_EQ(*raycaster.bridge()->totalNumInstances, 1u);
+
+    raycaster.render();
+
+    const float *depth = raycaster.depthOut();
+    const int32_t *ids = raycaster.instanceIDOut();
+
+    uint32_t num_hits = 0;
+    for (uint32_t y = 0; y < res; y++) {
+        for (uint32_t x = 0; x < res; x++) {
+            Vector3 d = pixelViewDir(x, y, res, res);
+            uint32_t idx = y * res + x;
+
+            // The cube's front face is at y = 4.5
+            bool expect_hit = fabsf(d.x * 4.5f) < 0.5f &&
+                fabsf(d.z * 4.5f) < 0.5f;
+
+            if (expect_hit) {
+                num_hits++;
+                EXPECT_EQ(ids[idx], 0);
+                EXPECT_NEAR(depth[idx], 4.5f * d.length(), 1e-4f);
+            } else {
+                EXPECT_EQ(ids[idx], -1);
+                EXPECT_EQ(depth[idx], 0.f);
+            }
+        }
+    }
+
+    EXPECT_EQ(num_hits, 4u);
+}
+
+TEST(CPURaycaster, PackedViewsAndWorldLocalIDs)
+{
+    constexpr uint32_t res = 8;
+
+    CubeObject cube;
+    imp::SourceObject obj = cube.object();
+
+    CPURaycaster raycaster({
+        .renderWidth = res,
+        .renderHeight = res,
+        .numWorlds = 3,
+        .maxViewsPerWorld = 2,
+        .maxInstancesPerWorld = 4,
+        .numThreads = 3,
+    });
+    raycaster.loadObjects(Span(&obj, 1));
+
+    Quat identity { 1, 0, 0, 0 };
+    Quat look_back = Quat::angleAxis(math::pi, math::up);
+    Quat look_down = Quat::angleAxis(-math::pi / 2.f, math::right);
+
+    // World 0 has instances but no views
+    setWorld(raycaster.bridge(), 0, {},
+             { makeInstance({ 0, 2, 0 }, identity, { 1, 1, 1 }, 0) });
+
+    // World 1: an unloaded object in front, a cube behind and one below
+    setWorld(raycaster.bridge(), 1,
+             {
+                 makeCamera(Vector3::zero(), look_back),
+                 makeCamera({ 0, 10, 0 }, look_down),
+             },
+             {
+                 makeInstance({ 0, 2, 0 }, identity, { 1, 1, 1 }, 7),
+                 makeInstance({ 0, -3, 0 }, identity, { 4, 4, 4 }, 0),
+                 makeInstance({ 0.3f, 10.2f, -10 }, identity, { 12, 12, 12 }, 0),
+             });
+
+    // World 2: a camera with nothing in the world
+    setWorld(raycaster.bridge(), 2,
+             { makeCamera(Vector3::zero(), identity) }, {});
+
+    raycaster.readECS();
+    EXPECT_EQ(*raycaster.bridge()->totalNumViews, 3u);
+    EXPECT_EQ(*raycaster.bridge()->totalNumInstances, 4u);
+    EXPECT_EQ(raycaster.bridge()->viewOffsets[1], 0);
+    EXPECT_EQ(raycaster.bridge()->viewOffsets[2], 2);
+
+    raycaster.render();
+
+    const float *depth = raycaster.depthOut();
+    const int32_t *ids = raycaster.instanceIDOut();
+
+    for (uint32_t y = 0; y < res; y++) {
+        for (uint32_t x = 0; x < res; x++) {
+            Vector3 d = pixelViewDir(x, y, res, res);
+            uint32_t pixel = y * res + x;
+
+            // Both cubes are wide enough that every pixel of the 90 degree
+            // views sees their near face.
+            EXPECT_EQ(ids[pixel], 1);
+            EXPECT_NEAR(depth[pixel], d.length(), 1e-4f);
+
+            EXPECT_EQ(ids[res * res + pixel], 2);
+            EXPECT_NEAR(depth[res * res + pixel], 4.f * d.length(), 1e-4f);
+
+            EXPECT_EQ(ids[2 * res * res + pixel], -1);
+            EXPECT_EQ(depth[2 * res * res + pixel], 0.f);
+        }
+    }
+}
+
+namespace {
+
+struct RandomScene {
+    CubeObject cube;
+    imp::SourceObject obj;
+    phys::MeshBVH bvh;
+    void *bvhBlob;
+
+    std::vector<std::vector<PerspectiveCameraData>> views;
+    std::vector<std::vector<InstanceData>> instances;
+
+    RandomScene(uint32_t num_worlds, uint32_t num_views,
+                uint32_t num_instances, uint32_t seed)
+        : cube(),
+          obj(cube.object()),
+          bvh(),
+          bvhBlob(nullptr),
+          views(num_worlds),
+          instances(num_worlds)
+    {
+        StackAlloc tmp_alloc;
+        CountT num_bytes;
+        bvhBlob = phys::MeshBVHBuilder::build(
+            Span<const imp::SourceMesh>(&cube.mesh, 1), tmp_alloc, &bvh,
+            &num_bytes);
+
+        RNG rng(seed);
+        auto uniform = [&](float lo, float hi) {
+            return lo + (hi - lo) * rng.sampleUniform();
+        };
+        auto random_rot = [&]() {
+            return Quat {
+                uniform(-1.f, 1.f),
+                uniform(-1.f, 1.f),
+                uniform(-1.f, 1.f),
+                uniform(-1.f, 1.f),
+            }.normalize();
+        };
+
+        for (uint32_t world = 0; world < num_worlds; world++) {
+            for (uint32_t i = 0; i < num_views; i++) {
+                views[world].push_back(makeCamera(
+                    { uniform(-2.f, 2.f), uniform(-2.f, 2.f),
+                      uniform(-2.f, 2.f) }, random_rot()));
+            }
+
+            for (uint32_t i = 0; i < num_instances; i++) {
+                instances[world].push_back(makeInstance(
+                    { uniform(-20.f, 20.f), uniform(-20.f, 20.f),
+                      uniform(-20.f, 20.f) },
+                    random_rot(),
+                    { uniform(0.5f, 4.f), uniform(0.5f, 4.f),
+                      uniform(0.5f, 4.f) }, 0));
+            }
+        }
+    }
+
+    ~RandomScene()
+    {
+        free(bvhBlob);
+    }
+
+    void upload(CPURaycaster &raycaster) const
+    {
+        for (size_t world = 0; world < views.size(); world++) {
+            setWorld(raycaster.bridge(), (uint32_t)world, views[world],
+                     instances[world]);
+        }
+    }
+
+    // Traces one pixel against every instance of the world
+    void bruteForce(uint32_t world, uint32_t view, uint32_t x, uint32_t y,
+                    uint32_t w, uint32_t h,
+                    float *out_depth, int32_t *out_id) const
+    {
+        const PerspectiveCameraData &cam = views[world][view];
+        Vector3 d = cam.rotation.inv().rotateVec(pixelViewDir(x, y, w, h));
+        Vector3 o = cam.position + cam.zNear * d;
+
+        float t_max = FLT_MAX;
+        int32_t hit_id = -1;
+        for (size_t i = 0; i < instances[world].size(); i++) {
+            const InstanceData &inst = instances[world][i];
+            Quat inv_rot = inst.rotation.inv();
+            Diag3x3 inv_scale = inst.scale.inv();
+
+            Vector3 o_obj = inv_scale * inv_rot.rotateVec(o - inst.position);
+            Vector3 d_obj = inv_scale * inv_rot.rotateVec(d);
+
+            float t;
+            Vector3 normal;
+            if (bvh.traceRay(o_obj, d_obj, &t, &normal, t_max)) {
+                t_max = t;
+                hit_id = (int32_t)i;
+            }
+        }
+
+        *out_id = hit_id;
+        *out_depth = hit_id == -1 ? 0.f : (cam.zNear + t_max) * d.length();
+    }
+};
+
+}
+
+TEST(CPURaycaster, MatchesBruteForce)
+{
+    // Not a multiple of the tile size in either dimension
+    constexpr uint32_t width = 37;
+    constexpr uint32_t height = 21;
+    constexpr uint32_t num_worlds = 3;
+    constexpr uint32_t num_views = 2;
+    constexpr uint32_t num_instances = 60;
+
+    RandomScene scene(num_worlds, num_views, num_instances, 17);
+
+    for (uint32_t num_threads : { 1u, 4u }) {
+        CPURaycaster raycaster({
+            .renderWidth = width,
+            .renderHeight = height,
+            .numWorlds = num_worlds,
+            .maxViewsPerWorld = num_views,
+            .maxInstancesPerWorld = num_instances,
+            .numThreads = num_threads,
+        });
+        raycaster.loadObjects(Span(&scene.obj, 1));
+        EXPECT_EQ(raycaster.numThreads(), num_threads);
+
+        scene.upload(raycaster);
+        raycaster.readECS();
+        raycaster.render();
+
+        const float *depth = raycaster.depthOut();
+        const int32_t *ids = raycaster.instanceIDOut();
+
+        uint32_t num_hits = 0;
+        for (uint32_t world = 0; world < num_worlds; world++) {
+            for (uint32_t view = 0; view < num_views; view++) {
+                uint32_t view_idx = world * num_views + view;
+
+                for (uint32_t y = 0; y < height; y++) {
+                    for (uint32_t x = 0; x < width; x++) {
+                        uint32_t idx = (view_idx * height + y) * width + x;
+
+                        float ref_depth;
+                        int32_t ref_id;
+                        scene.bruteForce(world, view, x, y, width, height,
+                                         &ref_depth, &ref_id);
+
+                        ASSERT_EQ(ids[idx], ref_id);
+                        ASSERT_NEAR(depth[idx], ref_depth, 1e-4f);
+
+                        if (ref_id != -1) {
+                            num_hits++;
+                        }
+                    }
+                }
+            }
+        }
+
+        // Make sure the scene isn't trivially empty
+        EXPECT_GT(num_hits, 0u);
+    }
+}
+
+TEST(CPURaycaster, DISABLED_Bench)
+{
+    using Clock = std::chrono::steady_clock;
+
+    constexpr uint32_t res = 64;
+    constexpr uint32_t num_worlds = 256;
+    constexpr uint32_t num_instances = 200;
+    constexpr int32_t num_iters = 20;
+
+    RandomScene scene(num_worlds, 1, num_instances, 5);
+
+    CPURaycaster raycaster({
+        .renderWidth = res,
+        .renderHeight = res,
+        .numWorlds = num_worlds,
+        .maxViewsPerWorld = 1,
+        .maxInstancesPerWorld = num_instances,
+    });
+    raycaster.loadObjects(Span(&scene.obj, 1));
+    scene.upload(raycaster);
+
+    raycaster.readECS();
+    raycaster.render();
+
+    auto start = Clock::now();
+    for (int32_t i = 0; i < num_iters; i++) {
+        raycaster.readECS();
+        raycaster.render();
+    }
+    auto end = Clock::now();
+
+    double secs = std::chrono::duration<double>(end - start).count();
+    double rays = (double)num_iters * num_worlds * res * res;
+    double rays_per_sec = rays / secs;
+
+    printf("%u threads: %.2f ms / frame, %.1f Mrays/s, "
+           "%.2f Mrays/s/thread\n",
+           raycaster.numThreads(), 1000.0 * secs / num_iters,
+           rays_per_sec / 1e6,
+           rays_per_sec / 1e6 / raycaster.numThreads());
+}
@@ -9,6 +9,7 @@
 
 #define MADRONA_GJK_DEBUG
 #include "../src/physics/gjk.hpp"
+#include "hull_test_utils.hpp"
 
 #include <array>
 
@@ -46,3 +47,77 @@ TEST(GJK, Solve4SimplexAroundOrigin)
     EXPECT_LT(fabsf(solve_state.v.z), 1e-5f);
     EXPECT_LT(solve_state.vLen2, 1e-5f);
 }
+
+TEST(GJK, HullHullSeparated)
+{
+    using namespace madrona::geo::test;
+
+    TestHull a = makeBox({ 1, 0, 0, 0 }, Vector3::zero());
+    TestHull b = makeBox({ 1, 0, 0, 0 }, { 3, 0.5f, 0 });
+
+    HullHullGJKResult result = hullHullGJKEPA(a.mesh(), b.mesh(), 1e-10f);
+
+    EXPECT_TRUE(result.valid);
+    EXPECT_NEAR(result.distance, 1.f, 1e-5f);
+    EXPECT_NEAR(result.normal.x, 1.f, 1e-5f);
+    EXPECT_NEAR(result.aPoint.x, 1.f, 1e-5f);
+}
+
+TEST(EPA, BoxBoxPenetration)
+{
+    using namespace madrona::geo::test;
+
+    TestHull a = makeBox({ 1, 0, 0, 0 }, Vector3::zero());
+    TestHull b = makeBox({ 1, 0, 0, 0 }, { 0.2f, 1.75f, 0.1f });
+
+    HullHullGJKResult result = hullHullGJKEPA(a.mesh(), b.mesh(), 1e-10f);
+
+    ASSERT_TRUE(result.valid);
+    EXPECT_EQ(result.distance, 0.f);
+    EXPECT_NEAR(result.depth, 0.25f, 1e-4f);
+    EXPECT_NEAR(result.normal.y, 1.f, 1e-4f);
+    EXPECT_NEAR(result.aPoint.y, 1.f, 1e-4f);
+}
+
+// Moving B out along the EPA normal by the penetration depth should leave
+// the hulls just touching
+TEST(EPA, RandomPrismPenetration)
+{
+    using namespace madrona::geo::test;
+
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> pos_dist(-0.8f, 0.8f);
+
+    int32_t num_valid = 0;
+    for (int32_t iter = 0; iter < 200; iter++) {
+        Quat b_rot = randomRotation(rng);
+        Vector3 b_pos { pos_dist(rng), pos_dist(rng), pos_dist(rng) };
+
+        TestHull a = makePrism(randomRotation(rng), Vector3::zero(), 16);
+        TestHull b = makePrism(b_rot, b_pos, 12);
+
+        HullHullGJKResult result =
+            hullHullGJKEPA(a.mesh(), b.mesh(), 1e-10f);
+
+        ASSERT_EQ(result.distance, 0.f);
+        if (!result.valid) {
+            continue;
+        }
+        num_valid++;
+
+        constexpr float tolerance = 1e-3f;
+
+        TestHull b_out = makePrism(b_rot,
+            b_pos + result.normal * (result.depth + tolerance), 12);
+        EXPECT_GT(hullHullGJKEPA(a.mesh(), b_out.mesh(), 1e-10f).distance,
+                  0.f);
+
+        TestHull b_in = makePrism(b_rot,
+            b_pos + result.normal * (result.depth - tolerance), 12);
+        EXPECT_EQ(hullHullGJKEPA(a.mesh(), b_in.mesh(), 1e-10f).distance,
+                  0.f);
+    }
+
+    // EPA should only give up on barely touching hulls
+    EXPECT_GT(num_valid, 190);
+}
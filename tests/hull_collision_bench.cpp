@@ -0,0 +1,151 @@
+/*
+ * Copyright 2021-2022 Brennan Shacklett and contributors
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+#include <gtest/gtest.h>
+
+// Hull vs hull benchmark comparing the cost of the SAT queries against
+// GJK + EPA as hull complexity grows. Used to pick the edge pair count at
+// which the narrowphase switches from SAT to GJK.
+// Disabled by default, run with:
+//   ./physics_tests --gtest_also_run_disabled_tests --gtest_filter='*Bench*'
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+#include "../src/physics/sat_avx2.hpp"
+#include "hull_test_utils.hpp"
+
+#include <chrono>
+#include <cstdio>
+
+using namespace madrona;
+using namespace madrona::geo;
+using namespace madrona::geo::test;
+using namespace madrona::math;
+using namespace madrona::phys;
+
+namespace {
+
+struct HullPair {
+    TestHull a;
+    TestHull b;
+    avx2::HullVertices aVertices;
+    avx2::HullVertices bVertices;
+    avx2::HullEdges bEdges;
+};
+
+// Same queries as doSAT in narrowphase.cpp, minus contact generation
+float runSAT(const HullPair &pair, HalfEdgeMesh a, HalfEdgeMesh b,
+             Vector3 a_center)
+{
+    float max_sep = -FLT_MAX;
+    for (uint32_t i = 0; i < a.numFaces; i++) {
+        Plane plane = a.facePlanes[i];
+        float sep = avx2::hullMinDot(pair.bVertices, plane.normal) - plane.d;
+        max_sep = fmaxf(max_sep, sep);
+        if (sep > 0.f) {
+            return sep;
+        }
+    }
+
+    for (uint32_t i = 0; i < b.numFaces; i++) {
+        Plane plane = b.facePlanes[i];
+        float sep = avx2::hullMinDot(pair.aVertices, plane.normal) - plane.d;
+        max_sep = fmaxf(max_sep, sep);
+        if (sep > 0.f) {
+            return sep;
+        }
+    }
+
+    avx2::EdgeQueryResult edge_query =
+        avx2::queryEdgeDirections(a, a_center, pair.bEdges);
+
+    return fmaxf(max_sep, edge_query.separation);
+}
+
+template <typename Fn>
+double timePairs(std::vector<HullPair> &pairs, Fn &&fn)
+{
+    constexpr int32_t num_reps = 20;
+
+    float sink = 0.f;
+    auto start = std::chrono::steady_clock::now();
+    for (int32_t rep = 0; rep < num_reps; rep++) {
+        for (HullPair &pair : pairs) {
+            sink += fn(pair);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    EXPECT_FALSE(std::isnan(sink));
+
+    return std::chrono::duration<double, std::micro>(end - start).count() /
+        double(num_reps * pairs.size());
+}
+
+}
+
+TEST(HullCollisionBench, DISABLED_SATvsGJK)
+{
+    constexpr int32_t num_pairs = 1000;
+
+    std::mt19937 rng(11);
+
+    for (uint32_t num_sides : { 4, 8, 16, 32, 64 }) {
+        // Overlapping pairs are the worst case for both, since neither can
+        // early out
+        for (float max_offset : { 1.f, 3.f }) {
+            std::uniform_real_distribution<float> pos_dist(
+                -max_offset, max_offset);
+
+            std::vector<HullPair> pairs(num_pairs);
+            for (HullPair &pair : pairs) {
+                pair.a = makePrism(randomRotation(rng), Vector3::zero(),
+                                   num_sides);
+                pair.b = makePrism(randomRotation(rng),
+                    { pos_dist(rng), pos_dist(rng), pos_dist(rng) },
+                    num_sides);
+
+                avx2::buildHullVertices(pair.a.mesh(), &pair.aVertices);
+                avx2::buildHullVertices(pair.b.mesh(), &pair.bVertices);
+                avx2::buildHullEdges(pair.b.mesh(), &pair.bEdges);
+            }
+
+            int32_t num_overlapping = 0;
+            for (HullPair &pair : pairs) {
+                if (hullHullGJKEPA(pair.a.mesh(), pair.b.mesh(),
+                                   1e-10f).distance == 0.f) {
+                    num_overlapping++;
+                }
+            }
+
+            double sat_us = timePairs(pairs, [](HullPair &pair) {
+                HalfEdgeMesh a = pair.a.mesh();
+                Vector3 a_center = Vector3::zero();
+                for (uint32_t i = 0; i < a.numVertices; i++) {
+                    a_center += a.vertices[i];
+                }
+                a_center /= float(a.numVertices);
+
+                return runSAT(pair, a, pair.b.mesh(), a_center);
+            });
+
+            double gjk_us = timePairs(pairs, [](HullPair &pair) {
+                HullHullGJKResult result = hullHullGJKEPA(
+                    pair.a.mesh(), pair.b.mesh(), 1e-10f);
+                return result.distance + result.depth;
+            });
+
+            uint32_t num_edges = 3 * num_sides;
+            printf("%3u verts, %5u edge pairs, %4d / %d overlapping: "
+                   "SAT %.3f us, GJK+EPA %.3f us\n",
+                   2 * num_sides, num_edges * num_edges,
+                   num_overlapping, num_pairs, sat_us, gjk_us);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <madrona/geo.hpp>
+
+#include <random>
+#include <vector>
+
+// Hand built convex hulls for narrowphase tests and benchmarks
+
+namespace madrona::geo::test {
+
+using namespace madrona::math;
+
+struct TestHull {
+    std::vector<HalfEdge> halfEdges;
+    std::vector<uint32_t> faceBaseHalfEdges;
+    std::vector<Plane> facePlanes;
+    std::vector<Vector3> vertices;
+
+    HalfEdgeMesh mesh()
+    {
+        return HalfEdgeMesh {
+            .halfEdges = halfEdges.data(),
+            .faceBaseHalfEdges = faceBaseHalfEdges.data(),
+            .facePlanes = facePlanes.data(),
+            .vertices = vertices.data(),
+            .numHalfEdges = uint32_t(halfEdges.size()),
+            .numFaces = uint32_t(facePlanes.size()),
+            .numVertices = uint32_t(vertices.size()),
+        };
+    }
+};
+
+// Faces are counter clockwise when viewed from outside. Twins are placed at
+// 2e and 2e + 1 to match HalfEdgeMesh::twinIDX.
+inline TestHull makeHull(std::vector<Vector3> vertices,
+                  const std::vector<std::vector<uint32_t>> &faces,
+                  Quat rot, Vector3 pos)
+{
+    TestHull hull;
+    for (Vector3 &v : vertices) {
+        v = rot.rotateVec(v) + pos;
+    }
+    hull.vertices = vertices;
+
+    const uint32_t num_verts = uint32_t(vertices.size());
+    std::vector<int32_t> hedge_lookup(num_verts * num_verts, -1);
+
+    auto getHalfEdge = [&](uint32_t from, uint32_t to) {
+        int32_t &idx = hedge_lookup[from * num_verts + to];
+        if (idx == -1) {
+            int32_t base = int32_t(hull.halfEdges.size());
+            hull.halfEdges.resize(base + 2);
+            idx = base;
+            hedge_lookup[to * num_verts + from] = base + 1;
+        }
+        return uint32_t(idx);
+    };
+
+    for (uint32_t face_idx = 0; face_idx < faces.size(); face_idx++) {
+        const auto &face = faces[face_idx];
+        const uint32_t n = uint32_t(face.size());
+
+        std::vector<uint32_t> face_hedges;
+        for (uint32_t i = 0; i < n; i++) {
+            face_hedges.push_back(getHalfEdge(face[i], face[(i + 1) % n]));
+        }
+
+        for (uint32_t i = 0; i < n; i++) {
+            hull.halfEdges[face_hedges[i]] = HalfEdge {
+                .next = face_hedges[(i + 1) % n],
+                .rootVertex = face[i],
+                .face = face_idx,
+            };
+        }
+
+        Vector3 p0 = vertices[face[0]];
+        Vector3 normal =
+            cross(vertices[face[1]] - p0, vertices[face[2]] - p0).normalize();
+
+        hull.faceBaseHalfEdges.push_back(face_hedges[0]);
+        hull.facePlanes.push_back({ normal, dot(normal, p0) });
+    }
+
+    return hull;
+}
+
+inline TestHull makeBox(Quat rot, Vector3 pos)
+{
+    return makeHull({
+        { -1, -1, -1 },
+        {  1, -1, -1 },
+        {  1,  1, -1 },
+        { -1,  1, -1 },
+        { -1, -1,  1 },
+        {  1, -1,  1 },
+        {  1,  1,  1 },
+        { -1,  1,  1 },
+    }, {
+        { 0, 3, 2, 1 },
+        { 4, 5, 6, 7 },
+        { 0, 1, 5, 4 },
+        { 1, 2, 6, 5 },
+        { 2, 3, 7, 6 },
+        { 3, 0, 4, 7 },
+    }, rot, pos);
+}
+
+// Prism with num_sides sides: 2 * num_sides vertices, 3 * num_sides edges
+// and num_sides + 2 faces
+inline TestHull makePrism(Quat rot, Vector3 pos, uint32_t num_sides = 6)
+{
+    std::vector<Vector3> vertices;
+    for (float z : { -0.5f, 0.5f }) {
+        for (uint32_t i = 0; i < num_sides; i++) {
+            float theta = 2.f * math::pi * float(i) / float(num_sides);
+            vertices.push_back({ cosf(theta), sinf(theta), z });
+        }
+    }
+
+    std::vector<std::vector<uint32_t>> faces;
+    std::vector<uint32_t> bottom, top;
+    for (uint32_t i = 0; i < num_sides; i++) {
+        bottom.push_back(num_sides - 1 - i);
+        top.push_back(num_sides + i);
+
+        uint32_t j = (i + 1) % num_sides;
+        faces.push_back({ i, j, num_sides + j, num_sides + i });
+    }
+    faces.push_back(bottom);
+    faces.push_back(top);
+
+    return makeHull(vertices, faces, rot, pos);
+}
+
+
+inline Quat randomRotation(std::mt19937 &rng)
+{
+    std::normal_distribution<float> dist;
+    return Quat { dist(rng), dist(rng), dist(rng), dist(rng) }.normalize();
+}
+
+}
@@ -0,0 +1,246 @@
+#include <gtest/gtest.h>
+
+#include <madrona/math_batch.hpp>
+#include <madrona/rand.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace madrona;
+using namespace madrona::math;
+
+namespace {
+
+struct Vector3Array {
+    std::vector<float> x, y, z;
+
+    Vector3Array(CountT n) : x(n), y(n), z(n) {}
+
+    Vector3SoA soa() { return { x.data(), y.data(), z.data() }; }
+    Vector3 get(CountT i) const { return { x[i], y[i], z[i] }; }
+};
+
+struct QuatArray {
+    std::vector<float> w, x, y, z;
+
+    QuatArray(CountT n) : w(n), x(n), y(n), z(n) {}
+
+    QuatSoA soa() { return { w.data(), x.data(), y.data(), z.data() }; }
+    Quat get(CountT i) const { return { w[i], x[i], y[i], z[i] }; }
+};
+
+struct TRSInputs {
+    Vector3Array t;
+    QuatArray r;
+    Vector3Array s;
+    Vector3Array aabbMin;
+    Vector3Array aabbMax;
+
+    TRSInputs(CountT n, uint32_t seed)
+        : t(n), r(n), s(n), aabbMin(n), aabbMax(n)
+    {
+        RNG rng(seed);
+        auto uniform = [&](float lo, float hi) {
+            return lo + (hi - lo) * rng.sampleUniform();
+        };
+
+        for (CountT i = 0; i < n; i++) {
+            t.x[i] = uniform(-100.f, 100.f);
+            t.y[i] = uniform(-100.f, 100.f);
+            t.z[i] = uniform(-100.f, 100.f);
+
+            Quat q = Quat {
+                uniform(-1.f, 1.f),
+                uniform(-1.f, 1.f),
+                uniform(-1.f, 1.f),
+                uniform(-1.f, 1.f),
+            }.normalize();
+            r.w[i] = q.w;
+            r.x[i] = q.x;
+            r.y[i] = q.y;
+            r.z[i] = q.z;
+
+            s.x[i] = uniform(0.1f, 4.f);
+            s.y[i] = uniform(0.1f, 4.f);
+            s.z[i] = uniform(0.1f, 4.f);
+
+            Vector3 c { uniform(-5.f, 5.f), uniform(-5.f, 5.f),
+                uniform(-5.f, 5.f) };
+            Vector3 h { uniform(0.f, 3.f), uniform(0.f, 3.f),
+                uniform(0.f, 3.f) };
+            aabbMin.x[i] = c.x - h.x;
+            aabbMin.y[i] = c.y - h.y;
+            aabbMin.z[i] = c.z - h.z;
+            aabbMax.x[i] = c.x + h.x;
+            aabbMax.y[i] = c.y + h.y;
+            aabbMax.z[i] = c.z + h.z;
+        }
+    }
+
+    Diag3x3 scale(CountT i) const { return { s.x[i], s.y[i], s.z[i] }; }
+};
+
+void expectVecNear(Vector3 a, Vector3 b, float tol)
+{
+    EXPECT_NEAR(a.x, b.x, tol);
+    EXPECT_NEAR(a.y, b.y, tol);
+    EXPECT_NEAR(a.z, b.z, tol);
+}
+
+// Covers empty, tail only, exact multiples of 4 and 8 and mixed
+const CountT batchSizes[] = { 0, 1, 3, 4, 7, 8, 9, 16, 31, 100 };
+
+}
+
+TEST(MathBatch, RotateVectorsMatchesScalar)
+{
+    for (CountT n : batchSizes) {
+        TRSInputs in(n, 3);
+        Vector3Array out(n);
+
+        batchRotateVectors(in.r.soa(), in.t.soa(), out.soa(), n);
+
+        for (CountT i = 0; i < n; i++) {
+            Vector3 ref = in.r.get(i).rotateVec(in.t.get(i));
+            expectVecNear(out.get(i), ref, 1e-3f);
+        }
+    }
+}
+
+TEST(MathBatch, RotateVectorsInPlace)
+{
+    constexpr CountT n = 13;
+    TRSInputs in(n, 5);
+    Vector3Array orig = in.t;
+
+    batchRotateVectors(in.r.soa(), in.t.soa(), in.t.soa(), n);
+
+    for (CountT i = 0; i < n; i++) {
+        Vector3 ref = in.r.get(i).rotateVec(orig.get(i));
+        expectVecNear(in.t.get(i), ref, 1e-3f);
+    }
+}
+
+TEST(MathBatch, ComposeTRSMatchesScalar)
+{
+    for (CountT n : batchSizes) {
+        TRSInputs in(n, 7);
+        std::vector<Mat3x4> out(n);
+
+        batchComposeTRS(in.t.soa(), in.r.soa(), in.s.soa(), out.data(), n);
+
+        for (CountT i = 0; i < n; i++) {
+            Mat3x4 ref = Mat3x4::fromTRS(in.t.get(i), in.r.get(i),
+                                         in.scale(i));
+            for (CountT c = 0; c < 4; c++) {
+                expectVecNear(out[i].cols[c], ref.cols[c], 1e-4f);
+            }
+        }
+    }
+}
+
+TEST(MathBatch, TransformAABBsMatchesScalar)
+{
+    for (CountT n : batchSizes) {
+        TRSInputs in(n, 11);
+        Vector3Array out_min(n), out_max(n);
+
+        batchTransformAABBs({ in.aabbMin.soa(), in.aabbMax.soa() },
+                            in.t.soa(), in.r.soa(), in.s.soa(),
+                            { out_min.soa(), out_max.soa() }, n);
+
+        for (CountT i = 0; i < n; i++) {
+            AABB local { in.aabbMin.get(i), in.aabbMax.get(i) };
+            AABB ref = local.applyTRS(in.t.get(i), in.r.get(i),
+                                      in.scale(i));
+
+            expectVecNear(out_min.get(i), ref.pMin, 1e-3f);
+            expectVecNear(out_max.get(i), ref.pMax, 1e-3f);
+        }
+    }
+}
+
+namespace {
+
+constexpr CountT benchN = 1 << 16;
+constexpr CountT benchIters = 200;
+
+template <typename Fn>
+double benchNsPerElem(Fn &&fn)
+{
+    using Clock = std::chrono::steady_clock;
+
+    fn();
+    auto start = Clock::now();
+    for (CountT iter = 0; iter < benchIters; iter++) {
+        fn();
+    }
+    auto end = Clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    return ns / (double)(benchIters * benchN);
+}
+
+}
+
+TEST(MathBatch, DISABLED_BenchRotateVectors)
+{
+    TRSInputs in(benchN, 1);
+    Vector3Array out(benchN);
+    std::vector<Vector3> out_aos(benchN);
+
+    double scalar = benchNsPerElem([&]() {
+        for (CountT i = 0; i < benchN; i++) {
+            out_aos[i] = in.r.get(i).rotateVec(in.t.get(i));
+        }
+    });
+    double batch = benchNsPerElem([&]() {
+        batchRotateVectors(in.r.soa(), in.t.soa(), out.soa(), benchN);
+    });
+
+    printf("rotateVectors: scalar %.2f ns, batch %.2f ns per element\n",
+           scalar, batch);
+}
+
+TEST(MathBatch, DISABLED_BenchComposeTRS)
+{
+    TRSInputs in(benchN, 2);
+    std::vector<Mat3x4> out(benchN);
+
+    double scalar = benchNsPerElem([&]() {
+        for (CountT i = 0; i < benchN; i++) {
+            out[i] = Mat3x4::fromTRS(in.t.get(i), in.r.get(i), in.scale(i));
+        }
+    });
+    double batch = benchNsPerElem([&]() {
+        batchComposeTRS(in.t.soa(), in.r.soa(), in.s.soa(), out.data(),
+                        benchN);
+    });
+
+    printf("composeTRS: scalar %.2f ns, batch %.2f ns per element\n",
+           scalar, batch);
+}
+
+TEST(MathBatch, DISABLED_BenchTransformAABBs)
+{
+    TRSInputs in(benchN, 3);
+    Vector3Array out_min(benchN), out_max(benchN);
+    std::vector<AABB> out_aos(benchN);
+
+    double scalar = benchNsPerElem([&]() {
+        for (CountT i = 0; i < benchN; i++) {
+            AABB local { in.aabbMin.get(i), in.aabbMax.get(i) };
+            out_aos[i] = local.applyTRS(in.t.get(i), in.r.get(i),
+                                        in.scale(i));
+        }
+    });
+    double batch = benchNsPerElem([&]() {
+        batchTransformAABBs({ in.aabbMin.soa(), in.aabbMax.soa() },
+                            in.t.soa(), in.r.soa(), in.s.soa(),
+                            { out_min.soa(), out_max.soa() }, benchN);
+    });
+
+    printf("transformAABBs: scalar %.2f ns, batch %.2f ns per element\n",
+           scalar, batch);
+}
@@ -0,0 +1,894 @@
+#include <gtest/gtest.h>
+
+#include <madrona/navmesh.hpp>
+#include <madrona/memory.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <vector>
+
+using namespace madrona;
+using namespace madrona::math;
+
+namespace {
+
+// Backing storage for a Navmesh::PathFindState over num_nodes nodes
+struct PathFindBuffers {
+    std::vector<float> costs;
+    std::vector<float> priorities;
+    std::vector<Vector3> entryPoints;
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> heap;
+    std::vector<uint32_t> heapIndex;
+    std::vector<uint32_t> visitGenerations;
+
+    Navmesh::PathFindState init(uint32_t num_nodes)
+    {
+        costs.resize(num_nodes);
+        priorities.resize(num_nodes);
+        entryPoints.resize(num_nodes);
+        parents.resize(num_nodes);
+        heap.resize(num_nodes);
+        heapIndex.resize(num_nodes);
+        visitGenerations.resize(num_nodes, 0);
+
+        return Navmesh::PathFindState {
+            .costs = costs.data(),
+            .priorities = priorities.data(),
+            .entryPoints = entryPoints.data(),
+            .parents = parents.data(),
+            .heap = heap.data(),
+            .heapIndex = heapIndex.data(),
+            .visitGenerations = visitGenerations.data(),
+            .generation = 0,
+        };
+    }
+};
+
+// Unit square cells on the XY plane, with blocked cells left out of the
+// navmesh. blocked is indexed [y * width + x].
+struct GridNavmesh {
+    Navmesh navmesh;
+    PathFindBuffers buffers;
+    Navmesh::PathFindState state;
+
+    PathFindBuffers hierarchyTriBuffers;
+    PathFindBuffers hierarchyPortalBuffers;
+    std::vector<float> portalGoalCosts;
+    std::vector<uint32_t> regionGenerations;
+    Navmesh::HierarchicalPathFindState hierarchyState;
+
+    GridNavmesh(uint32_t width, uint32_t height,
+                const std::vector<bool> &blocked,
+                uint32_t hierarchy_region_size = 0)
+    {
+        std::vector<Vector3> verts;
+        for (uint32_t y = 0; y <= height; y++) {
+            for (uint32_t x = 0; x <= width; x++) {
+                verts.push_back(Vector3 { float(x), float(y), 0.f });
+            }
+        }
+
+        std::vector<uint32_t> idxs;
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> sizes;
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                if (!blocked.empty() && blocked[y * width + x]) {
+                    continue;
+                }
+
+                offsets.push_back((uint32_t)idxs.size());
+                sizes.push_back(4);
+                idxs.push_back(y * (width + 1) + x);
+                idxs.push_back(y * (width + 1) + x + 1);
+                idxs.push_back((y + 1) * (width + 1) + x + 1);
+                idxs.push_back((y + 1) * (width + 1) + x);
+            }
+        }
+
+        navmesh = Navmesh::initFromPolygons(verts.data(), idxs.data(),
+            offsets.data(), sizes.data(), (uint32_t)verts.size(),
+            (uint32_t)sizes.size(), hierarchy_region_size);
+
+        state = buffers.init(navmesh.numTris);
+
+        const Navmesh::Hierarchy &hierarchy = navmesh.hierarchy;
+        portalGoalCosts.resize(hierarchy.numPortals);
+        regionGenerations.resize(hierarchy.numRegions, 0);
+
+        hierarchyState = Navmesh::HierarchicalPathFindState {
+            .tris = hierarchyTriBuffers.init(navmesh.numTris),
+            .portals = hierarchyPortalBuffers.init(hierarchy.numPortals + 1),
+            .portalGoalCosts = portalGoalCosts.data(),
+            .regionGenerations = regionGenerations.data(),
+            .regionGeneration = 0,
+        };
+    }
+
+    ~GridNavmesh()
+    {
+        rawDealloc(navmesh.vertices);
+        rawDealloc(navmesh.triIndices);
+        rawDealloc(navmesh.triAdjacency);
+        rawDealloc(navmesh.triSampleAliasTable);
+        rawDealloc(navmesh.triBVH.nodes);
+        rawDealloc(navmesh.triBVH.triIndices);
+
+        const Navmesh::Hierarchy &hierarchy = navmesh.hierarchy;
+        if (hierarchy.numRegions > 0) {
+            rawDealloc(hierarchy.triRegions);
+            rawDealloc(hierarchy.regionPortalOffsets);
+            rawDealloc(hierarchy.regionPortals);
+            rawDealloc(hierarchy.regionCostOffsets);
+            rawDealloc(hierarchy.regionPortalCosts);
+            rawDealloc(hierarchy.portalRegions);
+            rawDealloc(hierarchy.portalLocalIdxs);
+            rawDealloc(hierarchy.portalTris);
+            rawDealloc(hierarchy.portalPositions);
+        }
+    }
+
+    uint32_t triContaining(Vector3 p)
+    {
+        for (uint32_t i = 0; i < navmesh.numTris; i++) {
+            Vector3 a, b, c;
+            navmesh.getTriangleVertices(i, &a, &b, &c);
+
+            auto side = [](Vector3 u, Vector3 v, Vector3 w) {
+                return (v.x - u.x) * (w.y - u.y) - (v.y - u.y) * (w.x - u.x);
+            };
+
+            float d0 = side(a, b, p);
+            float d1 = side(b, c, p);
+            float d2 = side(c, a, p);
+            if ((d0 >= 0.f && d1 >= 0.f && d2 >= 0.f) ||
+                    (d0 <= 0.f && d1 <= 0.f && d2 <= 0.f)) {
+                return i;
+            }
+        }
+
+        return Navmesh::sentinel;
+    }
+
+    CountT findPath(Vector3 start, Vector3 goal, Vector3 *waypoints,
+                    CountT max_waypoints)
+    {
+        return navmesh.findPath(triContaining(start), start,
+            triContaining(goal), goal, &state, waypoints, max_waypoints);
+    }
+};
+
+void expectPointEq(Vector3 a, Vector3 b)
+{
+    EXPECT_FLOAT_EQ(a.x, b.x);
+    EXPECT_FLOAT_EQ(a.y, b.y);
+    EXPECT_FLOAT_EQ(a.z, b.z);
+}
+
+float pathLength(const Vector3 *waypoints, CountT num_waypoints)
+{
+    float len = 0.f;
+    for (CountT i = 1; i < num_waypoints; i++) {
+        len += waypoints[i - 1].distance(waypoints[i]);
+    }
+    return len;
+}
+
+// Checks the path runs from start to goal, only bends at navmesh vertices
+// and bends at every one of corners, in order.
+void expectPathBendsAt(const Vector3 *waypoints, CountT num_waypoints,
+                       Vector3 start, Vector3 goal,
+                       std::vector<Vector3> corners)
+{
+    ASSERT_GE(num_waypoints, 2);
+    expectPointEq(waypoints[0], start);
+    expectPointEq(waypoints[num_waypoints - 1], goal);
+
+    CountT corner_idx = 0;
+    for (CountT i = 1; i < num_waypoints - 1; i++) {
+        Vector3 w = waypoints[i];
+        EXPECT_EQ(w.x, floorf(w.x));
+        EXPECT_EQ(w.y, floorf(w.y));
+
+        if (corner_idx < (CountT)corners.size() &&
+                w.distance(corners[corner_idx]) == 0.f) {
+            corner_idx++;
+        }
+    }
+
+    EXPECT_EQ(corner_idx, (CountT)corners.size());
+}
+
+}
+
+TEST(NavmeshPathFind, StraightCorridor)
+{
+    GridNavmesh grid(10, 1, {});
+
+    Vector3 start { 0.2f, 0.2f, 0.f };
+    Vector3 goal { 9.8f, 0.8f, 0.f };
+
+    Vector3 waypoints[16];
+    CountT num_waypoints = grid.findPath(start, goal, waypoints, 16);
+
+    ASSERT_EQ(num_waypoints, 2);
+    expectPointEq(waypoints[0], start);
+    expectPointEq(waypoints[1], goal);
+}
+
+TEST(NavmeshPathFind, SamePoly)
+{
+    GridNavmesh grid(4, 4, {});
+
+    Vector3 start { 1.2f, 1.1f, 0.f };
+    Vector3 goal { 1.3f, 1.2f, 0.f };
+
+    Vector3 waypoints[16];
+    CountT num_waypoints = grid.findPath(start, goal, waypoints, 16);
+
+    ASSERT_EQ(num_waypoints, 2);
+    expectPointEq(waypoints[1], goal);
+}
+
+TEST(NavmeshPathFind, BendsAroundWall)
+{
+    // Wall along x = 5 with a single gap at the top
+    constexpr uint32_t width = 10;
+    constexpr uint32_t height = 10;
+    std::vector<bool> blocked(width * height, false);
+    for (uint32_t y = 0; y < height - 1; y++) {
+        blocked[y * width + 5] = true;
+    }
+
+    GridNavmesh grid(width, height, blocked);
+
+    Vector3 start { 1.5f, 0.5f, 0.f };
+    Vector3 goal { 8.5f, 0.5f, 0.f };
+
+    std::vector<uint32_t> corridor(grid.navmesh.numTris);
+    float corridor_cost;
+    uint32_t corridor_len = grid.navmesh.findCorridor(
+        grid.triContaining(start), start, grid.triContaining(goal), goal,
+        &grid.state, corridor.data(), &corridor_cost);
+    ASSERT_GT(corridor_len, 0u);
+
+    Vector3 waypoints[32];
+    CountT num_waypoints = grid.navmesh.stringPull(start, goal,
+        corridor.data(), corridor_len, waypoints, 32);
+
+    expectPathBendsAt(waypoints, num_waypoints, start, goal, {
+        Vector3 { 5.f, 9.f, 0.f },
+        Vector3 { 6.f, 9.f, 0.f },
+    });
+    EXPECT_LE(pathLength(waypoints, num_waypoints), corridor_cost);
+
+    // Truncated paths keep the leading waypoints
+    Vector3 truncated[2];
+    ASSERT_EQ(grid.navmesh.stringPull(start, goal, corridor.data(),
+                                      corridor_len, truncated, 2), 2);
+    expectPointEq(truncated[1], waypoints[1]);
+}
+
+TEST(NavmeshPathFind, ZigZag)
+{
+    // Staggered walls, open at the top and bottom respectively
+    constexpr uint32_t width = 12;
+    constexpr uint32_t height = 12;
+    std::vector<bool> blocked(width * height, false);
+    for (uint32_t y = 0; y < height - 2; y++) {
+        blocked[y * width + 3] = true;
+        blocked[(y + 2) * width + 7] = true;
+    }
+
+    GridNavmesh grid(width, height, blocked);
+
+    Vector3 start { 0.5f, 0.5f, 0.f };
+    Vector3 goal { 11.5f, 0.5f, 0.f };
+
+    Vector3 waypoints[32];
+    CountT num_waypoints = grid.findPath(start, goal, waypoints, 32);
+
+    expectPathBendsAt(waypoints, num_waypoints, start, goal, {
+        Vector3 { 3.f, 10.f, 0.f },
+        Vector3 { 4.f, 10.f, 0.f },
+        Vector3 { 7.f, 2.f, 0.f },
+    });
+}
+
+TEST(NavmeshPathFind, Unreachable)
+{
+    // Column x = 2 fully blocked
+    constexpr uint32_t width = 5;
+    constexpr uint32_t height = 5;
+    std::vector<bool> blocked(width * height, false);
+    for (uint32_t y = 0; y < height; y++) {
+        blocked[y * width + 2] = true;
+    }
+
+    GridNavmesh grid(width, height, blocked);
+
+    Vector3 waypoints[16];
+    EXPECT_EQ(grid.findPath(Vector3 { 0.5f, 0.5f, 0.f },
+                            Vector3 { 4.5f, 4.5f, 0.f }, waypoints, 16), 0);
+
+    // The state is still usable afterwards
+    Vector3 goal { 1.5f, 4.5f, 0.f };
+    CountT num_waypoints = grid.findPath(Vector3 { 0.5f, 0.5f, 0.f },
+                                         goal, waypoints, 16);
+    ASSERT_GE(num_waypoints, 2);
+    expectPointEq(waypoints[num_waypoints - 1], goal);
+}
+
+TEST(NavmeshPathFind, ReusedStateMatchesFreshState)
+{
+    constexpr uint32_t width = 16;
+    constexpr uint32_t height = 16;
+    std::vector<bool> blocked(width * height, false);
+    for (uint32_t i = 0; i < width * height; i += 7) {
+        blocked[i] = (i / width) % 3 != 0;
+    }
+
+    GridNavmesh reused(width, height, blocked);
+
+    // Also exercise the generation counter wrapping
+    reused.state.generation = 0xFFFF'FFF0;
+
+    RandKey base_key = rand::initKey(7);
+    for (CountT i = 0; i < 64; i++) {
+        Vector3 start = reused.navmesh.samplePoint(
+            rand::split_i(base_key, 2 * i));
+        Vector3 goal = reused.navmesh.samplePoint(
+            rand::split_i(base_key, 2 * i + 1));
+
+        GridNavmesh fresh(width, height, blocked);
+
+        Vector3 reused_waypoints[64];
+        Vector3 fresh_waypoints[64];
+        CountT num_reused = reused.findPath(start, goal, reused_waypoints, 64);
+        CountT num_fresh = fresh.findPath(start, goal, fresh_waypoints, 64);
+
+        ASSERT_EQ(num_reused, num_fresh);
+        for (CountT j = 0; j < num_reused; j++) {
+            expectPointEq(reused_waypoints[j], fresh_waypoints[j]);
+        }
+    }
+
+    EXPECT_LT(reused.state.generation, 64u);
+}
+
+// Open field with scattered pillars, which leaves plenty of routes between
+// regions
+std::vector<bool> makePillars(uint32_t width, uint32_t height, uint32_t seed)
+{
+    std::vector<bool> blocked(width * height, false);
+
+    RandKey key = rand::initKey(seed);
+    for (uint32_t i = 0; i < width * height / 6; i++) {
+        uint32_t x = rand::sampleI32(rand::split_i(key, 2 * i), 0, width);
+        uint32_t y = rand::sampleI32(rand::split_i(key, 2 * i + 1), 0, height);
+        blocked[y * width + x] = true;
+    }
+
+    return blocked;
+}
+
+TEST(NavmeshHierarchy, MatchesFlatSearch)
+{
+    constexpr uint32_t width = 48;
+    constexpr uint32_t height = 48;
+    GridNavmesh grid(width, height, makePillars(width, height, 5), 32);
+
+    const Navmesh::Hierarchy &hierarchy = grid.navmesh.hierarchy;
+    ASSERT_GT(hierarchy.numRegions, 1u);
+    ASSERT_GT(hierarchy.numPortals, 0u);
+    EXPECT_GT(hierarchy.numBytes, 0u);
+
+    std::vector<uint32_t> corridor(grid.navmesh.numTris);
+
+    RandKey base_key = rand::initKey(11);
+    float max_ratio = 0.f;
+    for (CountT i = 0; i < 200; i++) {
+        uint32_t start_poly, goal_poly;
+        Vector3 start = grid.navmesh.samplePointAndPoly(
+            rand::split_i(base_key, 2 * i), &start_poly);
+        Vector3 goal = grid.navmesh.samplePointAndPoly(
+            rand::split_i(base_key, 2 * i + 1), &goal_poly);
+
+        float flat_cost = 0.f;
+        uint32_t flat_len = grid.navmesh.findCorridor(start_poly, start,
+            goal_poly, goal, &grid.state, corridor.data(), &flat_cost);
+
+        float hierarchy_cost = 0.f;
+        uint32_t hierarchy_len = grid.navmesh.findCorridorHierarchical(
+            start_poly, start, goal_poly, goal, &grid.hierarchyState,
+            corridor.data(), &hierarchy_cost);
+
+        ASSERT_EQ(flat_len == 0, hierarchy_len == 0);
+        if (flat_len == 0) {
+            continue;
+        }
+
+        EXPECT_EQ(corridor[0], start_poly);
+        EXPECT_EQ(corridor[hierarchy_len - 1], goal_poly);
+        for (uint32_t j = 1; j < hierarchy_len; j++) {
+            const uint32_t *adjacency =
+                grid.navmesh.triAdjacency + 3 * corridor[j - 1];
+            EXPECT_TRUE(adjacency[0] == corridor[j] ||
+                        adjacency[1] == corridor[j] ||
+                        adjacency[2] == corridor[j]);
+        }
+
+        EXPECT_GE(hierarchy_cost, flat_cost * 0.999f);
+        max_ratio = std::max(max_ratio, hierarchy_cost / flat_cost);
+    }
+
+    printf("Worst hierarchical / flat path cost: %f\n", max_ratio);
+    EXPECT_LT(max_ratio, 1.1f);
+}
+
+TEST(NavmeshHierarchy, DisconnectedIslands)
+{
+    // Column x = 8 fully blocked
+    constexpr uint32_t width = 17;
+    constexpr uint32_t height = 16;
+    std::vector<bool> blocked(width * height, false);
+    for (uint32_t y = 0; y < height; y++) {
+        blocked[y * width + 8] = true;
+    }
+
+    GridNavmesh grid(width, height, blocked, 16);
+
+    Vector3 waypoints[16];
+    EXPECT_EQ(grid.navmesh.findPathHierarchical(
+        grid.triContaining(Vector3 { 0.5f, 0.5f, 0.f }),
+        Vector3 { 0.5f, 0.5f, 0.f },
+        grid.triContaining(Vector3 { 16.5f, 15.5f, 0.f }),
+        Vector3 { 16.5f, 15.5f, 0.f },
+        &grid.hierarchyState, waypoints, 16), 0);
+
+    Vector3 goal { 7.5f, 15.5f, 0.f };
+    CountT num_waypoints = grid.navmesh.findPathHierarchical(
+        grid.triContaining(Vector3 { 0.5f, 0.5f, 0.f }),
+        Vector3 { 0.5f, 0.5f, 0.f }, grid.triContaining(goal), goal,
+        &grid.hierarchyState, waypoints, 16);
+    ASSERT_GE(num_waypoints, 2);
+    expectPointEq(waypoints[num_waypoints - 1], goal);
+}
+
+// Compares flat and hierarchical query times as the map grows, both for
+// random pairs of points and for pairs a fixed distance apart
+TEST(NavmeshHierarchy, DISABLED_Bench)
+{
+    using Clock = std::chrono::steady_clock;
+
+    for (uint32_t size : { 64u, 128u, 256u, 512u }) {
+        GridNavmesh grid(size, size, makePillars(size, size, 3), 64);
+        const Navmesh::Hierarchy &hierarchy = grid.navmesh.hierarchy;
+
+        uint64_t navmesh_bytes =
+            sizeof(Vector3) * (uint64_t)grid.navmesh.numVerts +
+            (sizeof(uint32_t) * 6 + sizeof(Navmesh::AliasEntry)) *
+                (uint64_t)grid.navmesh.numTris;
+
+        printf("%ux%u: %u tris, %u regions, %u portals, "
+               "hierarchy %.1f KiB on top of %.1f KiB\n",
+               size, size, grid.navmesh.numTris, hierarchy.numRegions,
+               hierarchy.numPortals, hierarchy.numBytes / 1024.0,
+               navmesh_bytes / 1024.0);
+
+        std::vector<uint32_t> corridor(grid.navmesh.numTris);
+
+        for (bool fixed_dist : { false, true }) {
+            constexpr CountT num_queries = 200;
+            RandKey base_key = rand::initKey(17);
+
+            double flat_ms = 0.0;
+            double hierarchy_ms = 0.0;
+            CountT sample_idx = 0;
+            for (CountT i = 0; i < num_queries; i++) {
+                uint32_t start_poly, goal_poly;
+                Vector3 start, goal;
+                do {
+                    start = grid.navmesh.samplePointAndPoly(
+                        rand::split_i(base_key, sample_idx++), &start_poly);
+
+                    if (fixed_dist) {
+                        Vector2 dir = rand::sample2xUniform(
+                            rand::split_i(base_key, sample_idx++));
+                        goal = start + 48.f * normalize(Vector3 {
+                            dir.x - 0.5f, dir.y - 0.5f, 0.f });
+                        goal_poly = grid.triContaining(goal);
+                    } else {
+                        goal = grid.navmesh.samplePointAndPoly(
+                            rand::split_i(base_key, sample_idx++),
+                            &goal_poly);
+                    }
+                } while (goal_poly == Navmesh::sentinel);
+
+                auto flat_start = Clock::now();
+                grid.navmesh.findCorridor(start_poly, start, goal_poly, goal,
+                                          &grid.state, corridor.data());
+                auto hierarchy_start = Clock::now();
+                grid.navmesh.findCorridorHierarchical(start_poly, start,
+                    goal_poly, goal, &grid.hierarchyState, corridor.data());
+                auto hierarchy_end = Clock::now();
+
+                flat_ms += std::chrono::duration<double, std::milli>(
+                    hierarchy_start - flat_start).count();
+                hierarchy_ms += std::chrono::duration<double, std::milli>(
+                    hierarchy_end - hierarchy_start).count();
+            }
+
+            printf("    %s: flat %.3f ms, hierarchical %.3f ms per query\n",
+                   fixed_dist ? "48 units apart" : "random pairs",
+                   flat_ms / num_queries, hierarchy_ms / num_queries);
+        }
+    }
+}
+
+bool triContainsPoint(Navmesh &navmesh, uint32_t tri, Vector3 p)
+{
+    Vector3 a, b, c;
+    navmesh.getTriangleVertices(tri, &a, &b, &c);
+
+    auto side = [](Vector3 u, Vector3 v, Vector3 w) {
+        return (v.x - u.x) * (w.y - u.y) - (v.y - u.y) * (w.x - u.x);
+    };
+
+    constexpr float eps = 1e-5f;
+    float d0 = side(a, b, p);
+    float d1 = side(b, c, p);
+    float d2 = side(c, a, p);
+    return (d0 >= -eps && d1 >= -eps && d2 >= -eps) ||
+        (d0 <= eps && d1 <= eps && d2 <= eps);
+}
+
+// Closest point on a triangle lying in the z = 0 plane
+Vector3 closestPointOnFlatTri(Navmesh &navmesh, uint32_t tri, Vector3 p)
+{
+    Vector3 flat_p { p.x, p.y, 0.f };
+    if (triContainsPoint(navmesh, tri, flat_p)) {
+        return flat_p;
+    }
+
+    Vector3 verts[3];
+    navmesh.getTriangleVertices(tri, &verts[0], &verts[1], &verts[2]);
+
+    Vector3 closest = verts[0];
+    for (CountT i = 0; i < 3; i++) {
+        Vector3 a = verts[i];
+        Vector3 ab = verts[(i + 1) % 3] - a;
+        float t = std::clamp(dot(flat_p - a, ab) / ab.length2(), 0.f, 1.f);
+        Vector3 edge_point = a + t * ab;
+        if (edge_point.distance2(flat_p) < closest.distance2(flat_p)) {
+            closest = edge_point;
+        }
+    }
+
+    return closest;
+}
+
+TEST(NavmeshPointLocation, FindPolyMatchesBruteForce)
+{
+    constexpr uint32_t width = 40;
+    constexpr uint32_t height = 30;
+    GridNavmesh grid(width, height, makePillars(width, height, 9));
+
+    RandKey base_key = rand::initKey(21);
+    for (CountT i = 0; i < 2000; i++) {
+        Vector2 uv = rand::sample2xUniform(rand::split_i(base_key, i));
+        Vector3 pos {
+            uv.x * (width + 4) - 2.f,
+            uv.y * (height + 4) - 2.f,
+            float(i % 5) - 2.f,
+        };
+
+        uint32_t expected = grid.triContaining(pos);
+        uint32_t found = grid.navmesh.findPoly(pos);
+
+        if (expected == Navmesh::sentinel) {
+            EXPECT_EQ(found, Navmesh::sentinel);
+        } else {
+            ASSERT_NE(found, Navmesh::sentinel);
+            EXPECT_TRUE(triContainsPoint(grid.navmesh, found, pos));
+        }
+    }
+}
+
+TEST(NavmeshPointLocation, ClosestPointMatchesBruteForce)
+{
+    constexpr uint32_t width = 40;
+    constexpr uint32_t height = 30;
+    GridNavmesh grid(width, height, makePillars(width, height, 4));
+
+    RandKey base_key = rand::initKey(23);
+    std::vector<Vector3> positions;
+    for (CountT i = 0; i < 2000; i++) {
+        Vector2 uv = rand::sample2xUniform(rand::split_i(base_key, 2 * i));
+        float z = rand::sampleUniform(rand::split_i(base_key, 2 * i + 1));
+
+        positions.push_back(Vector3 {
+            uv.x * (width + 10) - 5.f,
+            uv.y * (height + 10) - 5.f,
+            4.f * z - 2.f,
+        });
+    }
+
+    std::vector<Vector3> closest_points(positions.size());
+    std::vector<uint32_t> closest_polys(positions.size());
+    grid.navmesh.closestPointsOnNavmesh(positions.data(),
+        closest_points.data(), closest_polys.data(), positions.size());
+
+    for (CountT i = 0; i < (CountT)positions.size(); i++) {
+        Vector3 pos = positions[i];
+
+        float expected_dist2 = FLT_MAX;
+        for (uint32_t tri = 0; tri < grid.navmesh.numTris; tri++) {
+            expected_dist2 = std::min(expected_dist2,
+                closestPointOnFlatTri(grid.navmesh, tri, pos).distance2(pos));
+        }
+
+        Vector3 closest = closest_points[i];
+        EXPECT_NEAR(closest.distance2(pos), expected_dist2, 1e-4f);
+
+        ASSERT_NE(closest_polys[i], Navmesh::sentinel);
+        EXPECT_LT(closestPointOnFlatTri(grid.navmesh, closest_polys[i],
+                                        closest).distance(closest), 1e-4f);
+    }
+}
+
+TEST(NavmeshPointLocation, StackedFloors)
+{
+    // Two 4x4 floors, 3 units apart
+    Vector3 verts[] = {
+        { 0, 0, 0 }, { 4, 0, 0 }, { 4, 4, 0 }, { 0, 4, 0 },
+        { 0, 0, 3 }, { 4, 0, 3 }, { 4, 4, 3 }, { 0, 4, 3 },
+    };
+    uint32_t idxs[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    uint32_t offsets[] = { 0, 4 };
+    uint32_t sizes[] = { 4, 4 };
+
+    Navmesh navmesh = Navmesh::initFromPolygons(verts, idxs, offsets, sizes,
+                                                8, 2);
+
+    auto triZ = [&](uint32_t tri) {
+        Vector3 a, b, c;
+        navmesh.getTriangleVertices(tri, &a, &b, &c);
+        return a.z;
+    };
+
+    uint32_t lower = navmesh.findPoly(Vector3 { 1.f, 2.f, 0.4f });
+    uint32_t upper = navmesh.findPoly(Vector3 { 1.f, 2.f, 2.4f });
+    ASSERT_NE(lower, Navmesh::sentinel);
+    ASSERT_NE(upper, Navmesh::sentinel);
+    EXPECT_EQ(triZ(lower), 0.f);
+    EXPECT_EQ(triZ(upper), 3.f);
+
+    EXPECT_EQ(navmesh.findPoly(Vector3 { 5.f, 2.f, 0.f }), Navmesh::sentinel);
+
+    uint32_t closest_poly;
+    Vector3 closest = navmesh.closestPointOnNavmesh(
+        Vector3 { 6.f, 2.f, 2.f }, &closest_poly);
+    expectPointEq(closest, Vector3 { 4.f, 2.f, 3.f });
+    EXPECT_EQ(triZ(closest_poly), 3.f);
+
+    // An agent already on the upper floor stays there even when closer to
+    // the lower one
+    Vector3 positions[] = {
+        { 1.5f, 2.f, 1.f },
+        { 3.5f, 0.5f, 1.f },
+    };
+    uint32_t polys[] = { upper, Navmesh::sentinel };
+    navmesh.findPolys(positions, polys, 2);
+    EXPECT_EQ(triZ(polys[0]), 3.f);
+    EXPECT_EQ(triZ(polys[1]), 0.f);
+
+    rawDealloc(navmesh.vertices);
+    rawDealloc(navmesh.triIndices);
+    rawDealloc(navmesh.triAdjacency);
+    rawDealloc(navmesh.triSampleAliasTable);
+    rawDealloc(navmesh.triBVH.nodes);
+    rawDealloc(navmesh.triBVH.triIndices);
+}
+
+TEST(NavmeshPointLocation, BatchedWalkingAgents)
+{
+    constexpr uint32_t width = 32;
+    constexpr uint32_t height = 32;
+    GridNavmesh grid(width, height, makePillars(width, height, 8));
+
+    constexpr CountT num_agents = 64;
+    std::vector<Vector3> positions(num_agents);
+    std::vector<Vector3> velocities(num_agents);
+    std::vector<uint32_t> polys(num_agents, Navmesh::sentinel);
+
+    RandKey base_key = rand::initKey(29);
+    for (CountT i = 0; i < num_agents; i++) {
+        positions[i] = grid.navmesh.samplePoint(
+            rand::split_i(base_key, 2 * i));
+        Vector2 dir = rand::sample2xUniform(
+            rand::split_i(base_key, 2 * i + 1));
+        velocities[i] = 0.3f * Vector3 { dir.x - 0.5f, dir.y - 0.5f, 0.f };
+    }
+
+    for (CountT step = 0; step < 50; step++) {
+        grid.navmesh.findPolys(positions.data(), polys.data(), num_agents);
+
+        for (CountT i = 0; i < num_agents; i++) {
+            if (grid.triContaining(positions[i]) == Navmesh::sentinel) {
+                EXPECT_EQ(polys[i], Navmesh::sentinel);
+            } else {
+                ASSERT_NE(polys[i], Navmesh::sentinel);
+                EXPECT_TRUE(triContainsPoint(grid.navmesh, polys[i],
+                                             positions[i]));
+            }
+
+            positions[i] += velocities[i];
+        }
+    }
+}
+
+TEST(NavmeshDistanceTable, GoalsMatchDijkstras)
+{
+    constexpr uint32_t width = 24;
+    constexpr uint32_t height = 24;
+    GridNavmesh grid(width, height, makePillars(width, height, 2));
+    Navmesh &navmesh = grid.navmesh;
+
+    uint32_t goal_polys[3];
+    Vector3 goal_positions[3];
+    for (CountT i = 0; i < 3; i++) {
+        goal_positions[i] = navmesh.samplePointAndPoly(
+            rand::split_i(rand::initKey(31), i), &goal_polys[i]);
+    }
+
+    NavmeshDistanceTableStorage storage = NavmeshDistanceTableStorage::build(
+        navmesh, goal_polys, goal_positions, 3);
+    ASSERT_TRUE(storage.valid());
+
+    const NavmeshDistanceTable &table = storage.table();
+    EXPECT_EQ(table.numSources, 3u);
+    EXPECT_EQ(table.numTris, navmesh.numTris);
+
+    std::vector<float> distances(navmesh.numTris);
+    std::vector<Vector3> entry_points(navmesh.numTris);
+    std::vector<uint32_t> heap(navmesh.numTris);
+    std::vector<uint32_t> heap_index(navmesh.numTris);
+
+    for (uint32_t i = 0; i < 3; i++) {
+        EXPECT_EQ(table.sourcePolys[i], goal_polys[i]);
+
+        std::vector<float> expected(navmesh.numTris, FLT_MAX);
+        navmesh.dijkstrasFromPoly(goal_polys[i], goal_positions[i],
+            Navmesh::DijkstrasState {
+                .distances = distances.data(),
+                .entryPoints = entry_points.data(),
+                .heap = heap.data(),
+                .heapIndex = heap_index.data(),
+            }, [&](uint32_t poly, Vector3, float dist) {
+                expected[poly] = dist;
+            });
+
+        for (uint32_t tri = 0; tri < navmesh.numTris; tri++) {
+            EXPECT_EQ(table.distance(i, tri), expected[tri]);
+        }
+    }
+}
+
+TEST(NavmeshDistanceTable, LandmarkLowerBound)
+{
+    // Column x = 20 fully blocked, splitting the map in two
+    constexpr uint32_t width = 24;
+    constexpr uint32_t height = 24;
+    std::vector<bool> blocked = makePillars(width, height, 6);
+    for (uint32_t y = 0; y < height; y++) {
+        blocked[y * width + 20] = true;
+    }
+
+    GridNavmesh grid(width, height, blocked);
+    Navmesh &navmesh = grid.navmesh;
+
+    NavmeshDistanceTableStorage storage =
+        NavmeshDistanceTableStorage::buildLandmarks(navmesh, 8);
+    const NavmeshDistanceTable &table = storage.table();
+    ASSERT_EQ(table.numSources, 8u);
+
+    // Both sides of the wall get a landmark
+    bool left_landmark = false;
+    bool right_landmark = false;
+    for (uint32_t i = 0; i < table.numSources; i++) {
+        Vector3 a, b, c;
+        navmesh.getTriangleVertices(table.sourcePolys[i], &a, &b, &c);
+        left_landmark |= a.x < 20.f;
+        right_landmark |= a.x > 20.f;
+    }
+    EXPECT_TRUE(left_landmark);
+    EXPECT_TRUE(right_landmark);
+
+    std::vector<uint32_t> corridor(navmesh.numTris);
+    RandKey base_key = rand::initKey(37);
+    CountT num_tight = 0;
+    CountT num_reachable = 0;
+    for (CountT i = 0; i < 300; i++) {
+        uint32_t a = rand::sampleI32(rand::split_i(base_key, 2 * i),
+                                     0, navmesh.numTris);
+        uint32_t b = rand::sampleI32(rand::split_i(base_key, 2 * i + 1),
+                                     0, navmesh.numTris);
+
+        Vector3 a_pos, b_pos;
+        {
+            Vector3 v0, v1, v2;
+            navmesh.getTriangleVertices(a, &v0, &v1, &v2);
+            a_pos = (v0 + v1 + v2) / 3.f;
+            navmesh.getTriangleVertices(b, &v0, &v1, &v2);
+            b_pos = (v0 + v1 + v2) / 3.f;
+        }
+
+        float path_cost;
+        uint32_t corridor_len = navmesh.findCorridor(a, a_pos, b, b_pos,
+            &grid.state, corridor.data(), &path_cost);
+
+        float bound = table.landmarkLowerBound(a, b);
+        if (corridor_len == 0) {
+            EXPECT_EQ(bound, FLT_MAX);
+            continue;
+        }
+
+        num_reachable++;
+
+        // Slack for the costs being measured between edge midpoints rather
+        // than triangle centroids
+        ASSERT_LE(bound, path_cost * 1.05f + 1.f);
+        if (bound >= path_cost * 0.5f) {
+            num_tight++;
+        }
+    }
+
+    // The bound should be useful, not just admissible
+    EXPECT_GT(num_tight, num_reachable / 2);
+}
+
+TEST(NavmeshDistanceTable, SaveAndMap)
+{
+    constexpr uint32_t width = 16;
+    constexpr uint32_t height = 16;
+    GridNavmesh grid(width, height, makePillars(width, height, 1));
+    GridNavmesh other(width, height, makePillars(width, height, 2));
+
+    NavmeshDistanceTableStorage built =
+        NavmeshDistanceTableStorage::buildLandmarks(grid.navmesh, 4);
+
+    std::string path = (std::filesystem::temp_directory_path() /
+        "madrona_test_navmesh_distances.bin").string();
+    ASSERT_TRUE(built.save(path.c_str(), grid.navmesh));
+
+    NavmeshDistanceTableStorage mapped =
+        NavmeshDistanceTableStorage::load(path.c_str(), grid.navmesh);
+    ASSERT_TRUE(mapped.valid());
+
+    const NavmeshDistanceTable &built_table = built.table();
+    const NavmeshDistanceTable &mapped_table = mapped.table();
+    ASSERT_EQ(mapped_table.numSources, built_table.numSources);
+    ASSERT_EQ(mapped_table.numTris, built_table.numTris);
+    EXPECT_EQ(memcmp(mapped_table.sourcePolys, built_table.sourcePolys,
+                     sizeof(uint32_t) * built_table.numSources), 0);
+    EXPECT_EQ(memcmp(mapped_table.distances, built_table.distances,
+                     sizeof(float) * built_table.numSources *
+                         built_table.numTris), 0);
+
+    // Tables are tied to the navmesh they were built for
+    EXPECT_FALSE(NavmeshDistanceTableStorage::load(
+        path.c_str(), other.navmesh).valid());
+
+    EXPECT_FALSE(NavmeshDistanceTableStorage::load(
+        (path + ".missing").c_str(), grid.navmesh).valid());
+
+    // The mapping stays valid after being moved
+    NavmeshDistanceTableStorage moved = std::move(mapped);
+    EXPECT_FALSE(mapped.valid());
+    EXPECT_EQ(moved.table().distance(0, 0), built_table.distance(0, 0));
+
+    std::filesystem::remove(path);
+}
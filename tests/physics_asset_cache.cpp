@@ -0,0 +1,763 @@
+/*
+ * Copyright 2021-2022 Brennan Shacklett and contributors
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+#include <gtest/gtest.h>
+
+#include <madrona/physics_assets.hpp>
+
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+using namespace madrona;
+using namespace madrona::geo;
+using namespace madrona::math;
+using namespace madrona::phys;
+
+namespace {
+
+math::Vector3 box_positions[8] {
+    { -1, -1, -1, },
+    {  1, -1, -1, },
+    {  1,  1, -1, },
+    { -1,  1, -1, },
+    { -1, -1,  1, },
+    {  1, -1,  1, },
+    {  1,  1,  1, },
+    { -1,  1,  1, },
+};
+
+uint32_t box_indices[24] {
+    0, 3, 2, 1,
+    4, 5, 6, 7,
+    0, 1, 5, 4,
+    1, 2, 6, 5,
+    2, 3, 7, 6,
+    3, 0, 4, 7,
+};
+
+uint32_t box_face_counts[6] { 4, 4, 4, 4, 4, 4 };
+
+uint32_t box_tri_indices[36] {
+    0, 3, 2, 0, 2, 1,
+    4, 5, 6, 4, 6, 7,
+    0, 1, 5, 0, 5, 4,
+    1, 2, 6, 1, 6, 5,
+    2, 3, 7, 2, 7, 6,
+    3, 0, 4, 3, 4, 7,
+};
+
+imp::SourceMesh makeBoxMesh(bool triangulated)
+{
+    return imp::SourceMesh {
+        .positions = box_positions,
+        .normals = nullptr,
+        .tangentAndSigns = nullptr,
+        .uvs = nullptr,
+        .indices = triangulated ? box_tri_indices : box_indices,
+        .faceCounts = triangulated ? nullptr : box_face_counts,
+        .faceMaterials = nullptr,
+        .numVertices = 8,
+        .numFaces = triangulated ? 12_u32 : 6_u32,
+        .materialIDX = 0,
+    };
+}
+
+std::string tmpCachePath(const char *name)
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+}
+
+TEST(PhysicsAssetCache, SourceHash)
+{
+    imp::SourceMesh box_mesh = makeBoxMesh(false);
+
+    SourceCollisionPrimitive box_prim {
+        .type = CollisionPrimitive::Type::Hull,
+        .hullInput = {
+            .hullIDX = 0,
+        },
+    };
+
+    SourceCollisionObject obj {
+        .prims = Span<const SourceCollisionPrimitive>(&box_prim, 1),
+        .invMass = 1.f,
+        .friction = { .muS = 0.5f, .muD = 0.5f },
+    };
+
+    uint64_t hash = CookedAssetCache::hashRigidBodySources(
+        Span<const imp::SourceMesh>(&box_mesh, 1),
+        Span<const SourceCollisionObject>(&obj, 1), false);
+
+    EXPECT_EQ(hash, CookedAssetCache::hashRigidBodySources(
+        Span<const imp::SourceMesh>(&box_mesh, 1),
+        Span<const SourceCollisionObject>(&obj, 1), false));
+
+    EXPECT_NE(hash, CookedAssetCache::hashRigidBodySources(
+        Span<const imp::SourceMesh>(&box_mesh, 1),
+        Span<const SourceCollisionObject>(&obj, 1), true));
+
+    SourceCollisionObject heavier_obj = obj;
+    heavier_obj.invMass = 0.5f;
+    EXPECT_NE(hash, CookedAssetCache::hashRigidBodySources(
+        Span<const imp::SourceMesh>(&box_mesh, 1),
+        Span<const SourceCollisionObject>(&heavier_obj, 1), false));
+
+    math::Vector3 moved_positions[8];
+    memcpy(moved_positions, box_positions, sizeof(box_positions));
+    moved_positions[6].z = 2.f;
+
+    imp::SourceMesh moved_mesh = box_mesh;
+    moved_mesh.positions = moved_positions;
+    EXPECT_NE(hash, CookedAssetCache::hashRigidBodySources(
+        Span<const imp::SourceMesh>(&moved_mesh, 1),
+        Span<const SourceCollisionObject>(&obj, 1), false));
+}
+
+TEST(PhysicsAssetCache, RigidBodyRoundTrip)
+{
+    imp::SourceMesh box_mesh = makeBoxMesh(false);
+
+    SourceCollisionPrimitive box_prim {
+        .type = CollisionPrimitive::Type::Hull,
+        .hullInput = {
+            .hullIDX = 0,
+        },
+    };
+
+    SourceCollisionPrimitive plane_prim {
+        .type = CollisionPrimitive::Type::Plane,
+        .plane = {},
+    };
+
+    SourceCollisionObject collision_objs[2] {
+        {
+            .prims = Span<const SourceCollisionPrimitive>(&box_prim, 1),
+            .invMass = 1.f,
+            .friction = { .muS = 0.5f, .muD = 0.5f },
+        },
+        {
+            .prims = Span<const SourceCollisionPrimitive>(&plane_prim, 1),
+            .invMass = 0.f,
+            .friction = { .muS = 0.5f, .muD = 0.5f },
+        },
+    };
+
+    StackAlloc tmp_alloc;
+    RigidBodyAssets assets;
+    CountT num_blob_bytes;
+    void *blob = RigidBodyAssets::processRigidBodyAssets(
+        Span<const imp::SourceMesh>(&box_mesh, 1),
+        collision_objs,
+        false,
+        tmp_alloc,
+        &assets,
+        &num_blob_bytes);
+    ASSERT_NE(blob, nullptr);
+
+    uint64_t hash = CookedAssetCache::hashRigidBodySources(
+        Span<const imp::SourceMesh>(&box_mesh, 1), collision_objs, false);
+
+    std::string path = tmpCachePath("madrona_test_rigid_bodies.cooked");
+    ASSERT_TRUE(CookedAssetCache::saveRigidBodyAssets(
+        path.c_str(), hash, assets, blob, num_blob_bytes));
+
+    // Stale hash must miss
+    {
+        RigidBodyAssets loaded;
+        CookedAssetMapping mapping = CookedAssetCache::loadRigidBodyAssets(
+            path.c_str(), hash + 1, &loaded);
+        EXPECT_FALSE(mapping.valid());
+    }
+
+    RigidBodyAssets loaded;
+    CookedAssetMapping mapping = CookedAssetCache::loadRigidBodyAssets(
+        path.c_str(), hash, &loaded);
+    ASSERT_TRUE(mapping.valid());
+
+    EXPECT_EQ(loaded.numConvexHulls, assets.numConvexHulls);
+    EXPECT_EQ(loaded.totalNumPrimitives, assets.totalNumPrimitives);
+    EXPECT_EQ(loaded.numObjs, assets.numObjs);
+    EXPECT_EQ(loaded.hullData.numHalfEdges, assets.hullData.numHalfEdges);
+    EXPECT_EQ(loaded.hullData.numFaces, assets.hullData.numFaces);
+    EXPECT_EQ(loaded.hullData.numVerts, assets.hullData.numVerts);
+
+    EXPECT_EQ(memcmp(loaded.hullData.vertices, assets.hullData.vertices,
+        sizeof(Vector3) * assets.hullData.numVerts), 0);
+    EXPECT_EQ(memcmp(loaded.metadatas, assets.metadatas,
+        sizeof(RigidBodyMetadata) * assets.numObjs), 0);
+    EXPECT_EQ(memcmp(loaded.primCounts, assets.primCounts,
+        sizeof(uint32_t) * assets.numObjs), 0);
+
+    for (CountT i = 0; i < (CountT)assets.totalNumPrimitives; i++) {
+        const CollisionPrimitive &orig = assets.primitives[i];
+        const CollisionPrimitive &prim = loaded.primitives[i];
+        ASSERT_EQ(prim.type, orig.type);
+
+        if (prim.type != CollisionPrimitive::Type::Hull) {
+            continue;
+        }
+
+        const HalfEdgeMesh &orig_mesh = orig.hull.halfEdgeMesh;
+        const HalfEdgeMesh &mesh = prim.hull.halfEdgeMesh;
+        ASSERT_EQ(mesh.numVertices, orig_mesh.numVertices);
+        ASSERT_EQ(mesh.numFaces, orig_mesh.numFaces);
+        ASSERT_EQ(mesh.numHalfEdges, orig_mesh.numHalfEdges);
+
+        // Fixed up pointers land inside the mapping, at the same relative
+        // location as in the original blob
+        EXPECT_EQ((char *)mesh.vertices - (char *)loaded.hullData.halfEdges,
+                  (char *)orig_mesh.vertices -
+                  (char *)assets.hullData.halfEdges);
+
+        for (uint32_t j = 0; j < mesh.numVertices; j++) {
+            EXPECT_EQ(mesh.vertices[j].x, orig_mesh.vertices[j].x);
+            EXPECT_EQ(mesh.vertices[j].y, orig_mesh.vertices[j].y);
+            EXPECT_EQ(mesh.vertices[j].z, orig_mesh.vertices[j].z);
+        }
+
+        for (uint32_t j = 0; j < mesh.numFaces; j++) {
+            EXPECT_EQ(mesh.facePlanes[j].d, orig_mesh.facePlanes[j].d);
+        }
+    }
+
+    free(blob);
+    mapping = CookedAssetMapping();
+    std::filesystem::remove(path);
+}
+
+TEST(PhysicsAssetCache, MeshBVHRoundTrip)
+{
+    imp::SourceMesh box_mesh = makeBoxMesh(true);
+
+    StackAlloc tmp_alloc;
+    MeshBVH bvh;
+    CountT num_blob_bytes;
+    void *blob = MeshBVHBuilder::build(
+        Span<const imp::SourceMesh>(&box_mesh, 1), tmp_alloc,
+        &bvh, &num_blob_bytes);
+    ASSERT_NE(blob, nullptr);
+
+    uint64_t hash = CookedAssetCache::hashMeshBVHSources(
+        Span<const imp::SourceMesh>(&box_mesh, 1));
+
+    std::string path = tmpCachePath("madrona_test_mesh_bvh.cooked");
+    ASSERT_TRUE(CookedAssetCache::saveMeshBVH(
+        path.c_str(), hash, bvh, blob, num_blob_bytes));
+
+    // A rigid body cache file with the same name must not be accepted
+    {
+        RigidBodyAssets loaded;
+        CookedAssetMapping mapping = CookedAssetCache::loadRigidBodyAssets(
+            path.c_str(), hash, &loaded);
+        EXPECT_FALSE(mapping.valid());
+    }
+
+    MeshBVH loaded;
+    CookedAssetMapping mapping = CookedAssetCache::loadMeshBVH(
+        path.c_str(), hash, &loaded);
+    ASSERT_TRUE(mapping.valid());
+
+    EXPECT_EQ(loaded.numNodes, bvh.numNodes);
+    EXPECT_EQ(loaded.numLeaves, bvh.numLeaves);
+    EXPECT_EQ(loaded.numVerts, bvh.numVerts);
+
+    EXPECT_EQ(memcmp(loaded.nodes, bvh.nodes,
+        sizeof(MeshBVH::Node) * bvh.numNodes), 0);
+    EXPECT_EQ(memcmp(loaded.leafGeos, bvh.leafGeos,
+        sizeof(MeshBVH::LeafGeometry) * bvh.numLeaves), 0);
+    EXPECT_EQ(memcmp(loaded.vertices, bvh.vertices,
+        sizeof(Vector3) * bvh.numVerts), 0);
+
+    free(blob);
+    mapping = CookedAssetMapping();
+    std::filesystem::remove(path);
+
+    // Missing files miss
+    mapping = CookedAssetCache::loadMeshBVH(path.c_str(), hash, &loaded);
+    EXPECT_FALSE(mapping.valid());
+}
+
+TEST(PhysicsAssets, ParallelProcessingMatchesSerial)
+{
+    constexpr CountT num_hulls = 64;
+
+    // quickhull building is still stubbed out, so feed in boxes of varying
+    // shape that are already convex
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> scale_dist(0.1f, 3.f);
+    std::uniform_real_distribution<float> offset_dist(-2.f, 2.f);
+
+    std::vector<Vector3> positions(num_hulls * 8);
+    for (CountT i = 0; i < num_hulls; i++) {
+        Diag3x3 scale { scale_dist(rng), scale_dist(rng), scale_dist(rng) };
+        Vector3 offset { offset_dist(rng), offset_dist(rng), offset_dist(rng) };
+
+        for (CountT j = 0; j < 8; j++) {
+            positions[i * 8 + j] = scale * box_positions[j] + offset;
+        }
+    }
+
+    std::vector<imp::SourceMesh> meshes;
+    std::vector<SourceCollisionPrimitive> prims;
+    for (CountT i = 0; i < num_hulls; i++) {
+        imp::SourceMesh mesh = makeBoxMesh(false);
+        mesh.positions = positions.data() + i * 8;
+        meshes.push_back(mesh);
+
+        prims.push_back({
+            .type = CollisionPrimitive::Type::Hull,
+            .hullInput = {
+                .hullIDX = (uint32_t)i,
+            },
+        });
+    }
+
+    // Mix of single and multi hull objects
+    std::vector<SourceCollisionObject> objs;
+    for (CountT i = 0; i < num_hulls;) {
+        CountT num_obj_prims = std::min<CountT>(1 + i % 3, num_hulls - i);
+        objs.push_back({
+            .prims = Span<const SourceCollisionPrimitive>(
+                prims.data() + i, num_obj_prims),
+            .invMass = 1.f,
+            .friction = { .muS = 0.5f, .muD = 0.5f },
+        });
+        i += num_obj_prims;
+    }
+
+    StackAlloc tmp_alloc;
+    RigidBodyAssets serial;
+    CountT num_serial_bytes;
+    void *serial_blob = RigidBodyAssets::processRigidBodyAssets(
+        meshes, objs, false, tmp_alloc, &serial, &num_serial_bytes);
+    ASSERT_NE(serial_blob, nullptr);
+
+    RigidBodyAssets parallel;
+    CountT num_parallel_bytes;
+    void *parallel_blob = RigidBodyAssets::processRigidBodyAssets(
+        meshes, objs, false, 4, &parallel, &num_parallel_bytes);
+    ASSERT_NE(parallel_blob, nullptr);
+
+    ASSERT_EQ(num_serial_bytes, num_parallel_bytes);
+    ASSERT_EQ(serial.hullData.numHalfEdges, parallel.hullData.numHalfEdges);
+    ASSERT_EQ(serial.hullData.numFaces, parallel.hullData.numFaces);
+    ASSERT_EQ(serial.hullData.numVerts, parallel.hullData.numVerts);
+    ASSERT_EQ(serial.totalNumPrimitives, parallel.totalNumPrimitives);
+    ASSERT_EQ(serial.numObjs, parallel.numObjs);
+
+    EXPECT_EQ(memcmp(serial.hullData.halfEdges, parallel.hullData.halfEdges,
+        sizeof(HalfEdge) * serial.hullData.numHalfEdges), 0);
+    EXPECT_EQ(memcmp(serial.hullData.facePlanes,
+        parallel.hullData.facePlanes,
+        sizeof(Plane) * serial.hullData.numFaces), 0);
+    EXPECT_EQ(memcmp(serial.hullData.vertices, parallel.hullData.vertices,
+        sizeof(Vector3) * serial.hullData.numVerts), 0);
+    EXPECT_EQ(memcmp(serial.primitiveAABBs, parallel.primitiveAABBs,
+        sizeof(AABB) * serial.totalNumPrimitives), 0);
+    EXPECT_EQ(memcmp(serial.metadatas, parallel.metadatas,
+        sizeof(RigidBodyMetadata) * serial.numObjs), 0);
+    EXPECT_EQ(memcmp(serial.objAABBs, parallel.objAABBs,
+        sizeof(AABB) * serial.numObjs), 0);
+    EXPECT_EQ(memcmp(serial.primOffsets, parallel.primOffsets,
+        sizeof(uint32_t) * serial.numObjs), 0);
+
+    for (CountT i = 0; i < (CountT)serial.totalNumPrimitives; i++) {
+        const HalfEdgeMesh &a = serial.primitives[i].hull.halfEdgeMesh;
+        const HalfEdgeMesh &b = parallel.primitives[i].hull.halfEdgeMesh;
+
+        EXPECT_EQ(a.vertices - serial.hullData.vertices,
+                  b.vertices - parallel.hullData.vertices);
+        EXPECT_EQ(a.halfEdges - serial.hullData.halfEdges,
+                  b.halfEdges - parallel.hullData.halfEdges);
+        EXPECT_EQ(a.numVertices, b.numVertices);
+    }
+
+    free(serial_blob);
+    free(parallel_blob);
+}
+
+namespace {
+
+// Convex prism around the z axis with num_sides side faces
+struct PrismSource {
+    std::vector<Vector3> positions;
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> faceCounts;
+
+    imp::SourceMesh mesh()
+    {
+        return imp::SourceMesh {
+            .positions = positions.data(),
+            .normals = nullptr,
+            .tangentAndSigns = nullptr,
+            .uvs = nullptr,
+            .indices = indices.data(),
+            .faceCounts = faceCounts.data(),
+            .faceMaterials = nullptr,
+            .numVertices = (uint32_t)positions.size(),
+            .numFaces = (uint32_t)faceCounts.size(),
+            .materialIDX = 0,
+        };
+    }
+};
+
+PrismSource makePrismSource(uint32_t num_sides, float radius, float height)
+{
+    PrismSource prism;
+
+    for (uint32_t i = 0; i < num_sides; i++) {
+        float theta = 2.f * math::pi * float(i) / float(num_sides);
+        prism.positions.push_back({
+            radius * cosf(theta), radius * sinf(theta), -0.5f * height });
+    }
+    for (uint32_t i = 0; i < num_sides; i++) {
+        Vector3 bottom = prism.positions[i];
+        prism.positions.push_back({ bottom.x, bottom.y, 0.5f * height });
+    }
+
+    // Top, counter clockwise seen from +z
+    for (uint32_t i = 0; i < num_sides; i++) {
+        prism.indices.push_back(num_sides + i);
+    }
+    prism.faceCounts.push_back(num_sides);
+
+    // Bottom, counter clockwise seen from -z
+    for (uint32_t i = 0; i < num_sides; i++) {
+        prism.indices.push_back(num_sides - 1 - i);
+    }
+    prism.faceCounts.push_back(num_sides);
+
+    for (uint32_t i = 0; i < num_sides; i++) {
+        uint32_t next = (i + 1) % num_sides;
+        prism.indices.push_back(i);
+        prism.indices.push_back(next);
+        prism.indices.push_back(num_sides + next);
+        prism.indices.push_back(num_sides + i);
+        prism.faceCounts.push_back(4);
+    }
+
+    return prism;
+}
+
+}
+
+TEST(PhysicsAssets, HullSimplification)
+{
+    PrismSource cylinder = makePrismSource(64, 1.f, 2.f);
+    imp::SourceMesh meshes[2] {
+        cylinder.mesh(),
+        makeBoxMesh(false),
+    };
+
+    SourceCollisionPrimitive prims[2];
+    for (uint32_t i = 0; i < 2; i++) {
+        prims[i] = {
+            .type = CollisionPrimitive::Type::Hull,
+            .hullInput = {
+                .hullIDX = i,
+            },
+        };
+    }
+
+    SourceCollisionObject objs[2] {
+        {
+            .prims = Span<const SourceCollisionPrimitive>(&prims[0], 1),
+            .invMass = 1.f,
+            .friction = { .muS = 0.5f, .muD = 0.5f },
+        },
+        {
+            .prims = Span<const SourceCollisionPrimitive>(&prims[1], 1),
+            .invMass = 1.f,
+            .friction = { .muS = 0.5f, .muD = 0.5f },
+        },
+    };
+
+    HullSimplificationConfig simplify_cfg {
+        .maxFaces = 32,
+        .maxVertices = 64,
+    };
+
+    StackAlloc tmp_alloc;
+    RigidBodyAssets assets;
+    CountT num_blob_bytes;
+    HullSimplificationReport reports[2];
+    void *blob = RigidBodyAssets::processRigidBodyAssets(
+        meshes, objs, false, tmp_alloc, &assets, &num_blob_bytes,
+        &simplify_cfg, reports);
+    ASSERT_NE(blob, nullptr);
+
+    // Cylinder
+    {
+        const HullSimplificationReport &report = reports[0];
+        EXPECT_EQ(report.numFacesBefore, 66u);
+        EXPECT_EQ(report.numVertsBefore, 128u);
+        EXPECT_LE(report.numFacesAfter, 32u);
+        EXPECT_LE(report.numVertsAfter, 64u);
+        EXPECT_GT(report.numFacesAfter, 6u);
+        EXPECT_GT(report.maxError, 0.f);
+        EXPECT_LT(report.maxError, 0.1f);
+        EXPECT_GT(report.estimatedSATSpeedup, 2.f);
+
+        const HalfEdgeMesh &mesh = assets.primitives[0].hull.halfEdgeMesh;
+        EXPECT_EQ(mesh.numFaces, report.numFacesAfter);
+        EXPECT_EQ(mesh.numVertices, report.numVertsAfter);
+        EXPECT_EQ(mesh.numVertices - mesh.numEdges() + mesh.numFaces, 2u);
+
+        // The simplified hull contains the original
+        for (const Vector3 &v : cylinder.positions) {
+            for (uint32_t i = 0; i < mesh.numFaces; i++) {
+                Plane plane = mesh.facePlanes[i];
+                EXPECT_LE(dot(plane.normal, v) - plane.d, 1e-4f);
+            }
+        }
+
+        // Face planes point outward
+        for (uint32_t i = 0; i < mesh.numFaces; i++) {
+            EXPECT_GT(mesh.facePlanes[i].d, 0.f);
+        }
+    }
+
+    // Box is already under the limits
+    {
+        const HullSimplificationReport &report = reports[1];
+        EXPECT_EQ(report.numFacesBefore, 6u);
+        EXPECT_EQ(report.numFacesAfter, 6u);
+        EXPECT_EQ(report.numVertsAfter, 8u);
+        EXPECT_EQ(report.maxError, 0.f);
+        EXPECT_EQ(report.estimatedSATSpeedup, 1.f);
+    }
+
+    free(blob);
+}
+
+TEST(PhysicsAssetCache, HeightfieldRoundTrip)
+{
+    constexpr uint32_t num_rows = 4;
+    constexpr uint32_t num_cols = 5;
+
+    std::vector<float> heights(num_rows * num_cols);
+    for (uint32_t row = 0; row < num_rows; row++) {
+        for (uint32_t col = 0; col < num_cols; col++) {
+            heights[row * num_cols + col] = 0.5f * float(row) - float(col);
+        }
+    }
+
+    float min_height, max_height;
+    HeightfieldImage img = HeightfieldImage::quantize(
+        heights, num_rows, num_cols, &min_height, &max_height);
+    EXPECT_EQ(min_height, -4.f);
+    EXPECT_EQ(max_height, 1.5f);
+
+    SourceCollisionPrimitive hf_prim =
+        img.makePrimitive(2.f, min_height, max_height);
+
+    SourceCollisionObject obj {
+        .prims = Span<const SourceCollisionPrimitive>(&hf_prim, 1),
+        .invMass = 0.f,
+        .friction = { .muS = 0.5f, .muD = 0.5f },
+    };
+
+    StackAlloc tmp_alloc;
+    RigidBodyAssets assets;
+    CountT num_blob_bytes;
+    void *blob = RigidBodyAssets::processRigidBodyAssets(
+        {}, Span<const SourceCollisionObject>(&obj, 1), false,
+        tmp_alloc, &assets, &num_blob_bytes);
+    ASSERT_NE(blob, nullptr);
+
+    ASSERT_EQ(assets.numHeightfieldSamples, num_rows * num_cols);
+    const CollisionPrimitive::Heightfield &hf =
+        assets.primitives[0].heightfield;
+    EXPECT_EQ(hf.samples, assets.heightfieldSamples);
+    EXPECT_EQ(hf.numRows, num_rows);
+    EXPECT_EQ(hf.numCols, num_cols);
+
+    // Grid is centered on the origin
+    AABB aabb = assets.primitiveAABBs[0];
+    EXPECT_FLOAT_EQ(aabb.pMin.x, -4.f);
+    EXPECT_FLOAT_EQ(aabb.pMax.x, 4.f);
+    EXPECT_FLOAT_EQ(aabb.pMin.y, -3.f);
+    EXPECT_FLOAT_EQ(aabb.pMax.y, 3.f);
+    EXPECT_NEAR(aabb.pMin.z, -4.f, 1e-4f);
+    EXPECT_NEAR(aabb.pMax.z, 1.5f, 1e-4f);
+
+    for (uint32_t i = 0; i < num_rows * num_cols; i++) {
+        float h = hf.minHeight + hf.heightScale * float(hf.samples[i]);
+        EXPECT_NEAR(h, heights[i], 1e-4f);
+    }
+
+    uint64_t hash = CookedAssetCache::hashRigidBodySources(
+        {}, Span<const SourceCollisionObject>(&obj, 1), false);
+
+    // Sample contents are part of the hash
+    img.samples[7] += 1;
+    EXPECT_NE(hash, CookedAssetCache::hashRigidBodySources(
+        {}, Span<const SourceCollisionObject>(&obj, 1), false));
+    img.samples[7] -= 1;
+
+    std::string path = tmpCachePath("madrona_test_heightfield.cooked");
+    ASSERT_TRUE(CookedAssetCache::saveRigidBodyAssets(
+        path.c_str(), hash, assets, blob, num_blob_bytes));
+
+    RigidBodyAssets loaded;
+    CookedAssetMapping mapping = CookedAssetCache::loadRigidBodyAssets(
+        path.c_str(), hash, &loaded);
+    ASSERT_TRUE(mapping.valid());
+
+    ASSERT_EQ(loaded.numHeightfieldSamples, assets.numHeightfieldSamples);
+    const CollisionPrimitive::Heightfield &loaded_hf =
+        loaded.primitives[0].heightfield;
+    EXPECT_EQ(loaded_hf.samples, loaded.heightfieldSamples);
+    EXPECT_EQ(memcmp(loaded_hf.samples, hf.samples,
+        sizeof(uint16_t) * num_rows * num_cols), 0);
+    EXPECT_EQ(loaded_hf.heightScale, hf.heightScale);
+
+    free(blob);
+    mapping = CookedAssetMapping();
+    std::filesystem::remove(path);
+}
+
+TEST(PhysicsAssetCache, TriangleMeshRoundTrip)
+{
+    imp::SourceMesh tri_mesh = makeBoxMesh(true);
+
+    SourceCollisionPrimitive prims[2];
+    prims[0].type = CollisionPrimitive::Type::TriangleMesh;
+    prims[0].triangleMeshInput = { .mesh = &tri_mesh };
+    prims[1].type = CollisionPrimitive::Type::TriangleMesh;
+    prims[1].triangleMeshInput = { .mesh = &tri_mesh };
+
+    SourceCollisionObject obj {
+        .prims = Span<const SourceCollisionPrimitive>(prims, 2),
+        .invMass = 0.f,
+        .friction = { .muS = 0.5f, .muD = 0.5f },
+    };
+
+    StackAlloc tmp_alloc;
+    RigidBodyAssets assets;
+    CountT num_blob_bytes;
+    void *blob = RigidBodyAssets::processRigidBodyAssets(
+        {}, Span<const SourceCollisionObject>(&obj, 1), false,
+        tmp_alloc, &assets, &num_blob_bytes);
+    ASSERT_NE(blob, nullptr);
+
+    EXPECT_EQ(assets.metadatas[0].mass.invMass, 0.f);
+
+    auto expectBVHInside = [](const RigidBodyAssets &a, const MeshBVH &bvh) {
+        uint8_t *begin = a.meshBVHData;
+        uint8_t *end = a.meshBVHData + a.numMeshBVHBytes;
+        EXPECT_GE((uint8_t *)bvh.nodes, begin);
+        EXPECT_LE((uint8_t *)(bvh.nodes + bvh.numNodes), end);
+        EXPECT_GE((uint8_t *)bvh.vertices, begin);
+        EXPECT_LE((uint8_t *)(bvh.vertices + bvh.numVerts), end);
+    };
+
+    for (CountT i = 0; i < 2; i++) {
+        const MeshBVH &bvh = assets.primitives[i].triangleMesh.bvh;
+        expectBVHInside(assets, bvh);
+        EXPECT_EQ(bvh.numVerts, 8_u32);
+
+        AABB aabb = assets.primitiveAABBs[i];
+        EXPECT_FLOAT_EQ(aabb.pMin.x, -1.f);
+        EXPECT_FLOAT_EQ(aabb.pMax.z, 1.f);
+    }
+    EXPECT_NE(assets.primitives[0].triangleMesh.bvh.nodes,
+              assets.primitives[1].triangleMesh.bvh.nodes);
+
+    uint64_t hash = CookedAssetCache::hashRigidBodySources(
+        {}, Span<const SourceCollisionObject>(&obj, 1), false);
+
+    std::string path = tmpCachePath("madrona_test_triangle_mesh.cooked");
+    ASSERT_TRUE(CookedAssetCache::saveRigidBodyAssets(
+        path.c_str(), hash, assets, blob, num_blob_bytes));
+
+    RigidBodyAssets loaded;
+    CookedAssetMapping mapping = CookedAssetCache::loadRigidBodyAssets(
+        path.c_str(), hash, &loaded);
+    ASSERT_TRUE(mapping.valid());
+
+    ASSERT_EQ(loaded.numMeshBVHBytes, assets.numMeshBVHBytes);
+    for (CountT i = 0; i < 2; i++) {
+        const MeshBVH &bvh = loaded.primitives[i].triangleMesh.bvh;
+        expectBVHInside(loaded, bvh);
+
+        // Down through the top face of the box
+        float hit_t;
+        Vector3 hit_normal;
+        ASSERT_TRUE(bvh.traceRay({ 0.2f, 0.3f, 5 }, { 0, 0, -1 },
+                                 &hit_t, &hit_normal));
+        EXPECT_NEAR(hit_t, 4.f, 1e-5f);
+    }
+
+    free(blob);
+    mapping = CookedAssetMapping();
+    std::filesystem::remove(path);
+}
+
+TEST(PhysicsAssets, HeightfieldPGM)
+{
+    std::string path = tmpCachePath("madrona_test_heightfield.pgm");
+
+    // 3 x 2, 16 bit, with a comment in the header
+    {
+        FILE *file = fopen(path.c_str(), "wb");
+        ASSERT_NE(file, nullptr);
+        fprintf(file, "P5\n# test\n3 2\n1000\n");
+        const uint16_t values[6] = { 0, 100, 200, 1000, 500, 300 };
+        for (uint16_t v : values) {
+            fputc(v >> 8, file);
+            fputc(v & 0xFF, file);
+        }
+        fclose(file);
+    }
+
+    Optional<HeightfieldImage> img = HeightfieldImage::loadPGM(path.c_str());
+    ASSERT_TRUE(img.has_value());
+    EXPECT_EQ(img->numRows, 2u);
+    EXPECT_EQ(img->numCols, 3u);
+
+    // Image rows are flipped, so the last image row is row 0
+    EXPECT_EQ(img->samples[0], 65535);
+    EXPECT_EQ(img->samples[1], (uint16_t)((500 * 65535 + 500) / 1000));
+    EXPECT_EQ(img->samples[3], 0);
+    EXPECT_EQ(img->samples[5], (uint16_t)((200 * 65535 + 500) / 1000));
+
+    // 8 bit samples are widened
+    {
+        FILE *file = fopen(path.c_str(), "wb");
+        ASSERT_NE(file, nullptr);
+        fprintf(file, "P5 2 2 255\n");
+        const uint8_t values[4] = { 0, 255, 128, 1 };
+        fwrite(values, 1, 4, file);
+        fclose(file);
+    }
+
+    Optional<HeightfieldImage> img8 =
+        HeightfieldImage::loadPGM(path.c_str());
+    ASSERT_TRUE(img8.has_value());
+    EXPECT_EQ(img8->samples[0], 128 * 257);
+    EXPECT_EQ(img8->samples[1], 257);
+    EXPECT_EQ(img8->samples[2], 0);
+    EXPECT_EQ(img8->samples[3], 65535);
+
+    // Truncated
+    {
+        FILE *file = fopen(path.c_str(), "wb");
+        ASSERT_NE(file, nullptr);
+        fprintf(file, "P5 2 2 255\n");
+        fputc(0, file);
+        fclose(file);
+    }
+
+    EXPECT_FALSE(HeightfieldImage::loadPGM(path.c_str()).has_value());
+
+    std::filesystem::remove(path);
+}
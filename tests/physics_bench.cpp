@@ -0,0 +1,1116 @@
+/*
+ * Copyright 2021-2022 Brennan Shacklett and contributors
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+#include <gtest/gtest.h>
+
+#include <madrona/mw_cpu.hpp>
+#include <madrona/custom_context.hpp>
+#include <madrona/physics.hpp>
+#include <madrona/physics_assets.hpp>
+#include <madrona/physics_loader.hpp>
+
+#include "../src/physics/physics_impl.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <utility>
+
+// Box stack benchmark comparing the XPBD and TGS solvers. For each solver,
+// finds the fewest substeps at which a stack of boxes settles without
+// drifting, then times a batch of worlds at that substep count.
+// Disabled by default, run with:
+//   ./physics_tests --gtest_also_run_disabled_tests --gtest_filter='*Bench*'
+//
+// The same box stack scene backs the enabled sleep tests below, and the
+// world optionally swaps it for a thin plate scene for the continuous
+// collision tests.
+
+using namespace madrona;
+using namespace madrona::base;
+using namespace madrona::math;
+using namespace madrona::phys;
+
+namespace consts {
+constexpr inline float deltaT = 1.f / 60.f;
+constexpr inline float boxHalfExtent = 1.f;
+// Stacks are initialized with a small gap between boxes so the solvers have
+// to settle them
+constexpr inline float boxGap = 0.01f;
+constexpr inline CountT numSettleSteps = 300;
+// Maximum distance (in half extents) any box can move from its resting
+// position for the stack to count as stable
+constexpr inline float maxDrift = 0.1f;
+// StackLevel of the optional box resting on the ground next to the stack
+constexpr inline int32_t groundLevel = -1;
+constexpr inline int32_t strikerLevel = -2;
+constexpr inline float strikerX = 4.f;
+constexpr inline int32_t noDriveLevel = -3;
+// Thin plate scene: a box flattened into a plate, with a small box fired
+// straight down at it fast enough to cross it in a fraction of a step
+constexpr inline Diag3x3 plateScale { 2.f, 2.f, 0.02f };
+constexpr inline float plateZ = 10.f;
+constexpr inline float bulletScale = 0.1f;
+constexpr inline float bulletZ = 11.f;
+constexpr inline float bulletSpeed = 120.f;
+}
+
+enum class BenchObject : uint32_t {
+    Box,
+    Plane,
+    NumObjects,
+};
+
+struct StackLevel {
+    int32_t level;
+};
+
+struct StackBox : Archetype<RigidBody, StackLevel> {};
+
+struct PlateConfig {
+    ResponseType plateResponse;
+    float bulletX;
+    bool continuousCollision;
+};
+
+struct BenchConfig {
+    ObjectManager *objMgr;
+    PhysicsSystem::Solver solver;
+    CountT numSubsteps;
+    CountT stackHeight;
+    ResponseType groundResponse;
+    bool addStriker;
+    bool enableSleeping;
+    // Replaces the stack and striker with the thin plate scene: the plate
+    // is level 0 and the bullet takes the striker's place
+    const PlateConfig *plate;
+};
+
+// State of a box after the last step. Stack boxes are indexed by level, the
+// striker comes last.
+struct BoxState {
+    Vector3 position;
+    Quat rotation;
+    Velocity velocity;
+    bool asleep;
+    // Only advances while the body is simulated
+    float sleepTimer;
+};
+
+struct BenchInit {};
+
+struct BenchWorld;
+
+class BenchContext : public CustomContext<BenchContext, BenchWorld> {
+public:
+    using CustomContext::CustomContext;
+};
+
+struct BenchWorld : WorldBase {
+    float maxDrift;
+
+    CountT stackHeight;
+    HeapArray<BoxState> boxStates;
+
+    // Set on the body at driveLevel at the start of the next step, then
+    // cleared
+    int32_t driveLevel;
+    Velocity driveVelocity;
+    Vector3 driveForce;
+
+    // Body moved to teleportPosition at the start of the next step, then
+    // cleared
+    int32_t teleportLevel;
+    Vector3 teleportPosition;
+
+    static void registerTypes(ECSRegistry &registry,
+                              const BenchConfig &cfg)
+    {
+        base::registerTypes(registry);
+        PhysicsSystem::registerTypes(registry, cfg.solver);
+
+        registry.registerComponent<StackLevel>();
+        registry.registerArchetype<StackBox>();
+    }
+
+    static void setupTasks(TaskGraphManager &taskgraph_mgr,
+                           const BenchConfig &cfg);
+
+    BenchWorld(BenchContext &ctx, const BenchConfig &cfg, const BenchInit &);
+};
+
+static Entity makeBody(BenchContext &ctx,
+                       Vector3 pos,
+                       BenchObject obj,
+                       ResponseType response_type,
+                       int32_t level)
+{
+    Entity e = ctx.makeEntity<StackBox>();
+    ObjectID obj_id { (int32_t)obj };
+
+    ctx.get<Position>(e) = pos;
+    ctx.get<Rotation>(e) = Quat { 1, 0, 0, 0 };
+    ctx.get<Scale>(e) = Diag3x3 { 1, 1, 1 };
+    ctx.get<ObjectID>(e) = obj_id;
+    ctx.get<ResponseType>(e) = response_type;
+    ctx.get<broadphase::LeafID>(e) =
+        PhysicsSystem::registerEntity(ctx, e, obj_id);
+    ctx.get<Velocity>(e) = {
+        Vector3::zero(),
+        Vector3::zero(),
+    };
+    ctx.get<ExternalForce>(e) = Vector3::zero();
+    ctx.get<ExternalTorque>(e) = Vector3::zero();
+    ctx.get<StackLevel>(e).level = level;
+
+    return e;
+}
+
+static void initPlateScene(BenchContext &ctx, const PlateConfig &cfg)
+{
+    Entity plate = makeBody(ctx, Vector3 { 0, 0, consts::plateZ },
+                            BenchObject::Box, cfg.plateResponse, 0);
+    ctx.get<Scale>(plate) = consts::plateScale;
+
+    Entity bullet = makeBody(ctx,
+        Vector3 { cfg.bulletX, 0, consts::bulletZ },
+        BenchObject::Box, ResponseType::Dynamic, consts::strikerLevel);
+    ctx.get<Scale>(bullet) = Diag3x3::uniform(consts::bulletScale);
+    ctx.get<Velocity>(bullet).linear = -consts::bulletSpeed * math::up;
+
+    PhysicsSystem::setContinuousCollision(ctx, bullet,
+                                          cfg.continuousCollision);
+}
+
+BenchWorld::BenchWorld(BenchContext &ctx,
+                       const BenchConfig &cfg,
+                       const BenchInit &)
+    : WorldBase(ctx),
+      maxDrift(0.f),
+      stackHeight(cfg.stackHeight),
+      boxStates(cfg.stackHeight + 1),
+      driveLevel(consts::noDriveLevel),
+      driveVelocity { Vector3::zero(), Vector3::zero() },
+      driveForce(Vector3::zero()),
+      teleportLevel(consts::noDriveLevel),
+      teleportPosition(Vector3::zero())
+{
+    for (BoxState &state : boxStates) {
+        state = {};
+    }
+
+    PhysicsSystem::init(ctx, cfg.objMgr, consts::deltaT, cfg.numSubsteps,
+                        -9.8f * math::up, cfg.stackHeight + 2, cfg.solver,
+                        {}, cfg.enableSleeping);
+
+    makeBody(ctx, Vector3::zero(), BenchObject::Plane,
+             cfg.groundResponse, consts::groundLevel);
+
+    if (cfg.plate != nullptr) {
+        initPlateScene(ctx, *cfg.plate);
+        return;
+    }
+
+    for (CountT i = 0; i < cfg.stackHeight; i++) {
+        float z = consts::boxHalfExtent +
+            float(i) * (2.f * consts::boxHalfExtent + consts::boxGap);
+
+        makeBody(ctx, Vector3 { 0, 0, z }, BenchObject::Box,
+                 ResponseType::Dynamic, (int32_t)i);
+    }
+
+    if (cfg.addStriker) {
+        makeBody(ctx, Vector3 { consts::strikerX, 0, consts::boxHalfExtent },
+                 BenchObject::Box, ResponseType::Dynamic,
+                 consts::strikerLevel);
+    }
+
+}
+
+static void driveBodies(BenchContext &ctx,
+                        Position &pos,
+                        Velocity &vel,
+                        ExternalForce &ext_force,
+                        StackLevel level)
+{
+    BenchWorld &world = ctx.data();
+
+    if (level.level == world.teleportLevel) {
+        pos = world.teleportPosition;
+        world.teleportLevel = consts::noDriveLevel;
+    }
+
+    if (level.level == world.driveLevel) {
+        vel = world.driveVelocity;
+        ext_force = world.driveForce;
+        world.driveLevel = consts::noDriveLevel;
+    } else {
+        ext_force = Vector3::zero();
+    }
+}
+
+static void measureDrift(BenchContext &ctx,
+                         Position pos,
+                         StackLevel level)
+{
+    if (level.level < 0) {
+        return;
+    }
+
+    Vector3 rest_pos {
+        0,
+        0,
+        consts::boxHalfExtent * (1.f + 2.f * float(level.level)),
+    };
+
+    float drift = pos.distance(rest_pos) / consts::boxHalfExtent;
+
+    BenchWorld &world = ctx.data();
+    world.maxDrift = fmaxf(world.maxDrift, drift);
+}
+
+static void recordBoxState(BenchContext &ctx,
+                           Position pos,
+                           Rotation rot,
+                           const Velocity &vel,
+                           broadphase::LeafID leaf_id,
+                           StackLevel level)
+{
+    BenchWorld &world = ctx.data();
+
+    CountT idx;
+    if (level.level >= 0) {
+        idx = level.level;
+    } else if (level.level == consts::strikerLevel) {
+        idx = world.stackHeight;
+    } else {
+        return;
+    }
+
+    const IslandState &islands = ctx.singleton<IslandState>();
+    world.boxStates[idx] = {
+        .position = pos,
+        .rotation = rot,
+        .velocity = vel,
+        .asleep = islands.isAsleep(leaf_id),
+        .sleepTimer = islands.bodies[leaf_id.id].sleepTimer,
+    };
+}
+
+void BenchWorld::setupTasks(TaskGraphManager &taskgraph_mgr,
+                            const BenchConfig &cfg)
+{
+    TaskGraphBuilder &builder = taskgraph_mgr.init(0);
+
+    auto drive = builder.addToGraph<ParallelForNode<BenchContext,
+        driveBodies,
+            Position,
+            Velocity,
+            ExternalForce,
+            StackLevel
+        >>({});
+
+    auto broadphase = PhysicsSystem::setupBroadphaseTasks(builder, {drive});
+    auto physics = PhysicsSystem::setupPhysicsStepTasks(
+        builder, {broadphase}, cfg.numSubsteps, cfg.solver);
+    auto cleanup = PhysicsSystem::setupCleanupTasks(builder, {physics});
+
+    auto drift = builder.addToGraph<ParallelForNode<BenchContext,
+        measureDrift,
+            Position,
+            StackLevel
+        >>({cleanup});
+
+    builder.addToGraph<ParallelForNode<BenchContext,
+        recordBoxState,
+            Position,
+            Rotation,
+            Velocity,
+            broadphase::LeafID,
+            StackLevel
+        >>({drift});
+}
+
+using BenchExecutor =
+    TaskGraphExecutor<BenchContext, BenchWorld, BenchConfig, BenchInit>;
+
+static void loadBenchObjects(PhysicsLoader &loader)
+{
+    const float e = consts::boxHalfExtent;
+
+    Vector3 box_positions[8] {
+        { -e, -e, -e },
+        {  e, -e, -e },
+        {  e,  e, -e },
+        { -e,  e, -e },
+        { -e, -e,  e },
+        {  e, -e,  e },
+        {  e,  e,  e },
+        { -e,  e,  e },
+    };
+
+    uint32_t box_indices[24] {
+        0, 3, 2, 1,
+        4, 5, 6, 7,
+        0, 1, 5, 4,
+        1, 2, 6, 5,
+        2, 3, 7, 6,
+        3, 0, 4, 7,
+    };
+
+    uint32_t box_face_counts[6] { 4, 4, 4, 4, 4, 4 };
+
+    imp::SourceMesh box_mesh {
+        .positions = box_positions,
+        .normals = nullptr,
+        .tangentAndSigns = nullptr,
+        .uvs = nullptr,
+        .indices = box_indices,
+        .faceCounts = box_face_counts,
+        .faceMaterials = nullptr,
+        .numVertices = 8,
+        .numFaces = 6,
+        .materialIDX = 0,
+    };
+
+    SourceCollisionPrimitive box_prim {
+        .type = CollisionPrimitive::Type::Hull,
+        .hullInput = {
+            .hullIDX = 0,
+        },
+    };
+
+    SourceCollisionPrimitive plane_prim {
+        .type = CollisionPrimitive::Type::Plane,
+        .plane = {},
+    };
+
+    SourceCollisionObject collision_objs[(uint32_t)BenchObject::NumObjects] {
+        {
+            .prims = Span<const SourceCollisionPrimitive>(&box_prim, 1),
+            .invMass = 1.f,
+            .friction = { .muS = 0.5f, .muD = 0.5f },
+        },
+        {
+            .prims = Span<const SourceCollisionPrimitive>(&plane_prim, 1),
+            .invMass = 0.f,
+            .friction = { .muS = 0.5f, .muD = 0.5f },
+        },
+    };
+
+    StackAlloc tmp_alloc;
+    RigidBodyAssets rigid_body_assets;
+    CountT num_rigid_body_data_bytes;
+    void *rigid_body_data = RigidBodyAssets::processRigidBodyAssets(
+        Span<const imp::SourceMesh>(&box_mesh, 1),
+        collision_objs,
+        false,
+        tmp_alloc,
+        &rigid_body_assets,
+        &num_rigid_body_data_bytes);
+
+    ASSERT_NE(rigid_body_data, nullptr);
+
+    loader.loadRigidBodies(rigid_body_assets);
+    free(rigid_body_data);
+}
+
+static float simulateStack(ObjectManager &obj_mgr,
+                           PhysicsSystem::Solver solver,
+                           CountT num_substeps,
+                           CountT stack_height)
+{
+    BenchInit init {};
+    BenchExecutor exec({
+        .numWorlds = 1,
+        .numExportedBuffers = 0,
+        .numWorkers = 1,
+    }, BenchConfig {
+        .objMgr = &obj_mgr,
+        .solver = solver,
+        .numSubsteps = num_substeps,
+        .stackHeight = stack_height,
+        .groundResponse = ResponseType::Static,
+        .addStriker = false,
+        .enableSleeping = false,
+        .plate = nullptr,
+    }, &init, 1);
+
+    for (CountT i = 0; i < consts::numSettleSteps; i++) {
+        exec.run();
+    }
+
+    // Only measure the settled stack
+    exec.getWorldData(0).maxDrift = 0.f;
+    for (CountT i = 0; i < consts::numSettleSteps; i++) {
+        exec.run();
+    }
+
+    return exec.getWorldData(0).maxDrift;
+}
+
+static double timeStack(ObjectManager &obj_mgr,
+                        PhysicsSystem::Solver solver,
+                        CountT num_substeps,
+                        CountT stack_height,
+                        CountT num_worlds,
+                        CountT num_steps)
+{
+    HeapArray<BenchInit> inits(num_worlds);
+    for (CountT i = 0; i < num_worlds; i++) {
+        inits[i] = {};
+    }
+
+    BenchExecutor exec({
+        .numWorlds = (uint32_t)num_worlds,
+        .numExportedBuffers = 0,
+    }, BenchConfig {
+        .objMgr = &obj_mgr,
+        .solver = solver,
+        .numSubsteps = num_substeps,
+        .stackHeight = stack_height,
+        .groundResponse = ResponseType::Static,
+        .addStriker = false,
+        .enableSleeping = false,
+        .plate = nullptr,
+    }, inits.data(), 1);
+
+    auto start = std::chrono::steady_clock::now();
+    for (CountT i = 0; i < num_steps; i++) {
+        exec.run();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::milli>(end - start).count() /
+        double(num_steps);
+}
+
+static CountT findStableSubsteps(ObjectManager &obj_mgr,
+                                 PhysicsSystem::Solver solver,
+                                 CountT stack_height)
+{
+    for (CountT num_substeps = 1; num_substeps <= 64; num_substeps *= 2) {
+        float drift = simulateStack(obj_mgr, solver, num_substeps,
+                                    stack_height);
+
+        if (drift < consts::maxDrift) {
+            return num_substeps;
+        }
+    }
+
+    return -1;
+}
+
+// Runs fn and exits with its result. The parent process only sees the exit
+// code and stderr, so failures are copied to stderr.
+template <typename Fn>
+[[noreturn]] static void runChild(Fn &fn)
+{
+    fn();
+    fflush(stdout);
+
+    const ::testing::TestResult &result =
+        *::testing::UnitTest::GetInstance()->current_test_info()->result();
+    for (int i = 0; i < result.total_part_count(); i++) {
+        const ::testing::TestPartResult &part = result.GetTestPartResult(i);
+        if (part.failed()) {
+            fprintf(stderr, "%s\n", part.message());
+        }
+    }
+
+    exit(result.Failed() ? 1 : 0);
+}
+
+// Solver specific types get process wide IDs, and the solver bundle alias
+// stays bound to the solver of the first executor created in the process,
+// so an executor using a different solver can't be created afterwards
+// (XPBD, XPBDBatched and XPBDFused share their bundle). Runs fn in a child
+// process started from scratch, so the result doesn't depend on which
+// tests already ran in this one.
+template <typename Fn>
+static void runInFreshProcess(Fn &&fn)
+{
+    GTEST_FLAG_SET(death_test_style, "threadsafe");
+
+    EXPECT_EXIT(runChild(fn), ::testing::ExitedWithCode(0), "");
+}
+
+TEST(PhysicsBench, DISABLED_BoxStackXPBDvsTGS)
+{
+    PhysicsLoader loader(ExecMode::CPU, 16);
+    loadBenchObjects(loader);
+    ObjectManager &obj_mgr = loader.getObjectManager();
+
+    constexpr CountT num_worlds = 1024;
+    constexpr CountT num_steps = 200;
+
+    struct Mode {
+        const char *name;
+        PhysicsSystem::Solver solver;
+    };
+
+    for (CountT stack_height : { 4, 8, 16 }) {
+        for (Mode mode : {
+                Mode { "XPBD", PhysicsSystem::Solver::XPBD },
+                Mode { "TGS", PhysicsSystem::Solver::TGS },
+            }) {
+            runInFreshProcess([&]() {
+                CountT num_substeps = findStableSubsteps(
+                    obj_mgr, mode.solver, stack_height);
+
+                if (mode.solver == PhysicsSystem::Solver::TGS) {
+                    EXPECT_NE(num_substeps, -1);
+                }
+
+                double ms = num_substeps == -1 ? 0.0 :
+                    timeStack(obj_mgr, mode.solver, num_substeps,
+                              stack_height, num_worlds, num_steps);
+
+                printf("Stack %ld: %s %ld substeps %.3f ms/step "
+                       "(%ld worlds)\n",
+                       (long)stack_height, mode.name, (long)num_substeps, ms,
+                       (long)num_worlds);
+            });
+        }
+    }
+}
+
+// Times the CPU specific XPBD modes against plain XPBD at a fixed substep
+// count, so only the cost of the solver loop differs
+TEST(PhysicsBench, DISABLED_BoxStackXPBDModes)
+{
+    PhysicsLoader loader(ExecMode::CPU, 16);
+    loadBenchObjects(loader);
+    ObjectManager &obj_mgr = loader.getObjectManager();
+
+    constexpr CountT num_worlds = 1024;
+    constexpr CountT num_steps = 200;
+    constexpr CountT num_substeps = 8;
+    constexpr CountT stack_height = 16;
+
+    struct Mode {
+        const char *name;
+        PhysicsSystem::Solver solver;
+    };
+
+    for (Mode mode : {
+            Mode { "XPBD", PhysicsSystem::Solver::XPBD },
+            Mode { "XPBDBatched", PhysicsSystem::Solver::XPBDBatched },
+            Mode { "XPBDFused", PhysicsSystem::Solver::XPBDFused },
+        }) {
+        float drift = simulateStack(obj_mgr, mode.solver, num_substeps,
+                                    stack_height);
+
+        double ms = timeStack(obj_mgr, mode.solver, num_substeps,
+                              stack_height, num_worlds, num_steps);
+
+        printf("%s: %.3f ms/step, drift %.4f (%ld worlds)\n",
+               mode.name, ms, drift, (long)num_worlds);
+    }
+}
+
+// XPBDBatched solves contacts in a different order than XPBD, so the two
+// can't match exactly, but both should settle a stack to the same resting
+// state
+TEST(PhysicsBench, XPBDBatchedMatchesXPBD)
+{
+    PhysicsLoader loader(ExecMode::CPU, 16);
+    loadBenchObjects(loader);
+    ObjectManager &obj_mgr = loader.getObjectManager();
+
+    auto settle = [&](PhysicsSystem::Solver solver, CountT stack_height) {
+        BenchInit init {};
+        BenchExecutor exec({
+            .numWorlds = 1,
+            .numExportedBuffers = 0,
+            .numWorkers = 1,
+        }, BenchConfig {
+            .objMgr = &obj_mgr,
+            .solver = solver,
+            .numSubsteps = 4,
+            .stackHeight = stack_height,
+            .groundResponse = ResponseType::Static,
+            .addStriker = false,
+            .enableSleeping = false,
+            .plate = nullptr,
+        }, &init, 1);
+
+        BenchWorld &world = exec.getWorldData(0);
+
+        for (CountT i = 0; i < consts::numSettleSteps; i++) {
+            exec.run();
+        }
+
+        world.maxDrift = 0.f;
+        for (CountT i = 0; i < consts::numSettleSteps; i++) {
+            exec.run();
+        }
+
+        HeapArray<BoxState> states(stack_height);
+        for (CountT i = 0; i < states.size(); i++) {
+            states[i] = world.boxStates[i];
+        }
+
+        return std::make_pair(world.maxDrift, std::move(states));
+    };
+
+    for (CountT stack_height : { 4, 8, 16 }) {
+        auto [scalar_drift, scalar] =
+            settle(PhysicsSystem::Solver::XPBD, stack_height);
+        auto [batched_drift, batched] =
+            settle(PhysicsSystem::Solver::XPBDBatched, stack_height);
+
+        EXPECT_LT(scalar_drift, consts::maxDrift) << "Stack " << stack_height;
+        EXPECT_LT(batched_drift, consts::maxDrift) << "Stack " << stack_height;
+
+        // Resting boxes end up within a hundredth of a half extent of each
+        // other, this leaves some headroom
+        for (CountT i = 0; i < stack_height; i++) {
+            float dist = scalar[i].position.distance(batched[i].position);
+            EXPECT_LT(dist / consts::boxHalfExtent, 0.02f)
+                << "Stack " << stack_height << ", box " << i;
+        }
+    }
+}
+
+// XPBDFused runs the same batched position and velocity solves as
+// XPBDBatched, only without a taskgraph node per phase, so both must end up
+// with bit identical bodies
+TEST(PhysicsBench, XPBDFusedMatchesBatched)
+{
+    PhysicsLoader loader(ExecMode::CPU, 16);
+    loadBenchObjects(loader);
+    ObjectManager &obj_mgr = loader.getObjectManager();
+
+    constexpr CountT num_steps = 120;
+    constexpr CountT strike_step = 40;
+
+    auto simulate = [&](PhysicsSystem::Solver solver) {
+        BenchInit init {};
+        BenchExecutor exec({
+            .numWorlds = 1,
+            .numExportedBuffers = 0,
+            .numWorkers = 1,
+        }, BenchConfig {
+            .objMgr = &obj_mgr,
+            .solver = solver,
+            .numSubsteps = 4,
+            .stackHeight = 4,
+            .groundResponse = ResponseType::Static,
+            .addStriker = true,
+            .enableSleeping = false,
+            .plate = nullptr,
+        }, &init, 1);
+
+        BenchWorld &world = exec.getWorldData(0);
+
+        for (CountT i = 0; i < num_steps; i++) {
+            // Knock the settling stack over so the end state depends on
+            // contacts between moving bodies, not just resting ones
+            if (i == strike_step) {
+                world.driveLevel = consts::strikerLevel;
+                world.driveVelocity =
+                    { Vector3 { -8, 0, 0 }, Vector3::zero() };
+            }
+
+            exec.run();
+        }
+
+        HeapArray<BoxState> states(world.boxStates.size());
+        for (CountT i = 0; i < states.size(); i++) {
+            states[i] = world.boxStates[i];
+        }
+
+        return states;
+    };
+
+    HeapArray<BoxState> batched =
+        simulate(PhysicsSystem::Solver::XPBDBatched);
+    HeapArray<BoxState> fused = simulate(PhysicsSystem::Solver::XPBDFused);
+
+    for (CountT i = 0; i < batched.size(); i++) {
+        const BoxState &a = batched[i];
+        const BoxState &b = fused[i];
+
+        EXPECT_EQ(a.position.x, b.position.x) << "Box " << i;
+        EXPECT_EQ(a.position.y, b.position.y) << "Box " << i;
+        EXPECT_EQ(a.position.z, b.position.z) << "Box " << i;
+        EXPECT_EQ(a.rotation.w, b.rotation.w) << "Box " << i;
+        EXPECT_EQ(a.rotation.x, b.rotation.x) << "Box " << i;
+        EXPECT_EQ(a.rotation.y, b.rotation.y) << "Box " << i;
+        EXPECT_EQ(a.rotation.z, b.rotation.z) << "Box " << i;
+        EXPECT_EQ(a.velocity.linear.x, b.velocity.linear.x) << "Box " << i;
+        EXPECT_EQ(a.velocity.linear.y, b.velocity.linear.y) << "Box " << i;
+        EXPECT_EQ(a.velocity.linear.z, b.velocity.linear.z) << "Box " << i;
+        EXPECT_EQ(a.velocity.angular.x, b.velocity.angular.x) << "Box " << i;
+        EXPECT_EQ(a.velocity.angular.y, b.velocity.angular.y) << "Box " << i;
+        EXPECT_EQ(a.velocity.angular.z, b.velocity.angular.z) << "Box " << i;
+    }
+}
+
+// SAT's face / edge tie-break applies to every solver, so check that XPBD
+// stacks still settle along with the TGS ones it was tuned for.
+TEST(PhysicsBench, XPBDStackSettles)
+{
+    PhysicsLoader loader(ExecMode::CPU, 16);
+    loadBenchObjects(loader);
+    ObjectManager &obj_mgr = loader.getObjectManager();
+
+    runInFreshProcess([&]() {
+        for (CountT stack_height : { 4, 8, 16 }) {
+            float drift = simulateStack(obj_mgr, PhysicsSystem::Solver::XPBD,
+                                        4, stack_height);
+
+            EXPECT_LT(drift, consts::maxDrift) << "Stack " << stack_height;
+        }
+    });
+}
+
+TEST(PhysicsBench, TGSSmallStackSettles)
+{
+    PhysicsLoader loader(ExecMode::CPU, 16);
+    loadBenchObjects(loader);
+    ObjectManager &obj_mgr = loader.getObjectManager();
+
+    runInFreshProcess([&]() {
+        for (CountT stack_height : { 2, 4, 8 }) {
+            float drift = simulateStack(obj_mgr, PhysicsSystem::Solver::TGS,
+                                        4, stack_height);
+
+            EXPECT_LT(drift, consts::maxDrift) << "Stack " << stack_height;
+        }
+    });
+}
+
+static BenchConfig sleepTestConfig(ObjectManager &obj_mgr)
+{
+    return BenchConfig {
+        .objMgr = &obj_mgr,
+        .solver = PhysicsSystem::Solver::XPBD,
+        .numSubsteps = 4,
+        .stackHeight = 3,
+        .groundResponse = ResponseType::Static,
+        .addStriker = true,
+        .enableSleeping = true,
+        .plate = nullptr,
+    };
+}
+
+static bool allAsleep(const BenchWorld &world)
+{
+    for (const BoxState &state : world.boxStates) {
+        if (!state.asleep) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+TEST(Islands, RestingStackSleeps)
+{
+    PhysicsLoader loader(ExecMode::CPU, 16);
+    loadBenchObjects(loader);
+
+    BenchInit init {};
+    BenchExecutor exec({
+        .numWorlds = 1,
+        .numExportedBuffers = 0,
+        .numWorkers = 1,
+    }, sleepTestConfig(loader.getObjectManager()), &init, 1);
+
+    BenchWorld &world = exec.getWorldData(0);
+
+    for (CountT i = 0; i < consts::numSettleSteps; i++) {
+        exec.run();
+    }
+
+    ASSERT_TRUE(allAsleep(world));
+
+    HeapArray<BoxState> rest_states(world.boxStates.size());
+    for (CountT i = 0; i < rest_states.size(); i++) {
+        rest_states[i] = world.boxStates[i];
+    }
+
+    // Sleeping bodies stay exactly where they are
+    for (CountT i = 0; i < 60; i++) {
+        exec.run();
+    }
+
+    EXPECT_TRUE(allAsleep(world));
+    for (CountT i = 0; i < rest_states.size(); i++) {
+        Vector3 pos = world.boxStates[i].position;
+        Vector3 rest_pos = rest_states[i].position;
+        EXPECT_EQ(pos.x, rest_pos.x);
+        EXPECT_EQ(pos.y, rest_pos.y);
+        EXPECT_EQ(pos.z, rest_pos.z);
+    }
+}
+
+TEST(Islands, StrikeWakesStack)
+{
+    PhysicsLoader loader(ExecMode::CPU, 16);
+    loadBenchObjects(loader);
+
+    BenchInit init {};
+    BenchExecutor exec({
+        .numWorlds = 1,
+        .numExportedBuffers = 0,
+        .numWorkers = 1,
+    }, sleepTestConfig(loader.getObjectManager()), &init, 1);
+
+    BenchWorld &world = exec.getWorldData(0);
+
+    for (CountT i = 0; i < consts::numSettleSteps; i++) {
+        exec.run();
+    }
+
+    ASSERT_TRUE(allAsleep(world));
+
+    // Slide the striker into the bottom box
+    world.driveLevel = consts::strikerLevel;
+    world.driveVelocity = { Vector3 { -8, 0, 0 }, Vector3::zero() };
+
+    exec.run();
+    EXPECT_FALSE(world.boxStates[world.stackHeight].asleep);
+
+    HeapArray<bool> woken(world.stackHeight);
+    for (CountT i = 0; i < woken.size(); i++) {
+        woken[i] = false;
+    }
+
+    for (CountT step = 0; step < 60; step++) {
+        exec.run();
+
+        for (CountT i = 0; i < woken.size(); i++) {
+            woken[i] = woken[i] || !world.boxStates[i].asleep;
+        }
+    }
+
+    // Only the bottom box is touched, the rest of its island wakes with it
+    for (CountT i = 0; i < woken.size(); i++) {
+        EXPECT_TRUE(woken[i]) << "Box " << i;
+    }
+}
+
+TEST(Islands, DrivenBodiesWake)
+{
+    PhysicsLoader loader(ExecMode::CPU, 16);
+    loadBenchObjects(loader);
+
+    BenchInit init {};
+    BenchExecutor exec({
+        .numWorlds = 1,
+        .numExportedBuffers = 0,
+        .numWorkers = 1,
+    }, sleepTestConfig(loader.getObjectManager()), &init, 1);
+
+    BenchWorld &world = exec.getWorldData(0);
+
+    for (CountT i = 0; i < consts::numSettleSteps; i++) {
+        exec.run();
+    }
+
+    ASSERT_TRUE(allAsleep(world));
+
+    // A velocity wakes the striker, which is in its own island
+    world.driveLevel = consts::strikerLevel;
+    world.driveVelocity = { Vector3 { 0, 1, 0 }, Vector3::zero() };
+    exec.run();
+
+    EXPECT_FALSE(world.boxStates[world.stackHeight].asleep);
+    for (CountT i = 0; i < world.stackHeight; i++) {
+        EXPECT_TRUE(world.boxStates[i].asleep) << "Box " << i;
+    }
+
+    // A force on the top box wakes the whole stack
+    world.driveLevel = int32_t(world.stackHeight - 1);
+    world.driveVelocity = { Vector3::zero(), Vector3::zero() };
+    world.driveForce = 20.f * math::up;
+    exec.run();
+
+    for (CountT i = 0; i < world.stackHeight; i++) {
+        EXPECT_FALSE(world.boxStates[i].asleep) << "Box " << i;
+    }
+}
+
+TEST(Islands, KinematicGroundWakesOnlyWhenMoving)
+{
+    PhysicsLoader loader(ExecMode::CPU, 16);
+    loadBenchObjects(loader);
+
+    BenchConfig cfg = sleepTestConfig(loader.getObjectManager());
+    cfg.groundResponse = ResponseType::Kinematic;
+
+    BenchInit init {};
+    BenchExecutor exec({
+        .numWorlds = 1,
+        .numExportedBuffers = 0,
+        .numWorkers = 1,
+    }, cfg, &init, 1);
+
+    BenchWorld &world = exec.getWorldData(0);
+
+    for (CountT i = 0; i < consts::numSettleSteps; i++) {
+        exec.run();
+    }
+
+    ASSERT_TRUE(allAsleep(world));
+
+    // A still kinematic body touches the bottom box every step, but doesn't
+    // wake it, so the stack isn't simulated or pushed at all
+    float rest_timer = world.boxStates[0].sleepTimer;
+    Vector3 rest_pos = world.boxStates[0].position;
+    for (CountT i = 0; i < 60; i++) {
+        exec.run();
+        ASSERT_EQ(world.boxStates[0].sleepTimer, rest_timer);
+
+        Vector3 pos = world.boxStates[0].position;
+        ASSERT_EQ(pos.x, rest_pos.x);
+        ASSERT_EQ(pos.y, rest_pos.y);
+        ASSERT_EQ(pos.z, rest_pos.z);
+    }
+
+    world.driveLevel = consts::groundLevel;
+    world.driveVelocity = { 0.5f * math::up, Vector3::zero() };
+    exec.run();
+
+    EXPECT_FALSE(world.boxStates[0].asleep);
+}
+
+TEST(Islands, TeleportWakesBody)
+{
+    PhysicsLoader loader(ExecMode::CPU, 16);
+    loadBenchObjects(loader);
+
+    BenchInit init {};
+    BenchExecutor exec({
+        .numWorlds = 1,
+        .numExportedBuffers = 0,
+        .numWorkers = 1,
+    }, sleepTestConfig(loader.getObjectManager()), &init, 1);
+
+    BenchWorld &world = exec.getWorldData(0);
+
+    for (CountT i = 0; i < consts::numSettleSteps; i++) {
+        exec.run();
+    }
+
+    ASSERT_TRUE(allAsleep(world));
+
+    // Lift the striker straight up, it has to wake to fall back down
+    world.teleportLevel = consts::strikerLevel;
+    world.teleportPosition = Vector3 { consts::strikerX, 0, 4 };
+    exec.run();
+
+    const BoxState &striker = world.boxStates[world.stackHeight];
+    EXPECT_FALSE(striker.asleep);
+    EXPECT_LT(striker.position.z, 4.f);
+
+    for (CountT i = 0; i < 120; i++) {
+        exec.run();
+    }
+
+    EXPECT_NEAR(striker.position.z, consts::boxHalfExtent, 0.05f);
+}
+
+TEST(Islands, SleepingIsOffByDefault)
+{
+    PhysicsLoader loader(ExecMode::CPU, 16);
+    loadBenchObjects(loader);
+
+    BenchConfig cfg = sleepTestConfig(loader.getObjectManager());
+    cfg.enableSleeping = false;
+
+    BenchInit init {};
+    BenchExecutor exec({
+        .numWorlds = 1,
+        .numExportedBuffers = 0,
+        .numWorkers = 1,
+    }, cfg, &init, 1);
+
+    BenchWorld &world = exec.getWorldData(0);
+
+    for (CountT i = 0; i < consts::numSettleSteps; i++) {
+        exec.run();
+
+        for (const BoxState &state : world.boxStates) {
+            ASSERT_FALSE(state.asleep);
+        }
+    }
+}
+
+// Steps the thin plate scene, checking after every step that the bullet is
+// still above the plate
+static void shootPlate(const PlateConfig &plate_cfg, CountT num_steps)
+{
+    PhysicsLoader loader(ExecMode::CPU, 16);
+    loadBenchObjects(loader);
+
+    BenchInit init {};
+    BenchExecutor exec({
+        .numWorlds = 1,
+        .numExportedBuffers = 0,
+        .numWorkers = 1,
+    }, BenchConfig {
+        .objMgr = &loader.getObjectManager(),
+        .solver = PhysicsSystem::Solver::XPBD,
+        .numSubsteps = 4,
+        .stackHeight = 1,
+        .groundResponse = ResponseType::Static,
+        .addStriker = false,
+        .enableSleeping = false,
+        .plate = &plate_cfg,
+    }, &init, 1);
+
+    const BenchWorld &world = exec.getWorldData(0);
+    const BoxState &plate = world.boxStates[0];
+    const BoxState &bullet = world.boxStates[1];
+
+    // Without continuous collision, the bullet moves several times its own
+    // size plus the plate's thickness every step and ends up below it
+    const float max_penetration = 0.5f * consts::bulletScale;
+    for (CountT i = 0; i < num_steps; i++) {
+        exec.run();
+
+        float bullet_bottom = bullet.position.z - consts::bulletScale;
+        float plate_top = plate.position.z + consts::plateScale.d2;
+        ASSERT_GT(bullet_bottom, plate_top - max_penetration)
+            << "Step " << i;
+    }
+}
+
+TEST(ContinuousCollision, StopsOnThinPlate)
+{
+    shootPlate({
+        .plateResponse = ResponseType::Static,
+        .bulletX = 0.f,
+        .continuousCollision = true,
+    }, 8);
+}
+
+// The bullet's center passes just outside the plate's edge, but its side
+// still hits it. Only the impact is checked, the bullet then tips off the
+// edge.
+TEST(ContinuousCollision, StopsOnPlateEdge)
+{
+    shootPlate({
+        .plateResponse = ResponseType::Static,
+        .bulletX = consts::plateScale.d0 + 0.5f * consts::bulletScale,
+        .continuousCollision = true,
+    }, 1);
+}
+
+// The plate is knocked down, and stopped by the ground after the last
+// checked step
+TEST(ContinuousCollision, StopsOnDynamicPlate)
+{
+    shootPlate({
+        .plateResponse = ResponseType::Dynamic,
+        .bulletX = 0.f,
+        .continuousCollision = true,
+    }, 8);
+}
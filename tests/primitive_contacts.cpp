@@ -0,0 +1,893 @@
+/*
+ * Copyright 2021-2022 Brennan Shacklett and contributors
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+#include <gtest/gtest.h>
+
+#include "../src/physics/primitive_contacts.hpp"
+#include "hull_test_utils.hpp"
+
+#include <madrona/physics_assets.hpp>
+
+#include <vector>
+
+using namespace madrona;
+using namespace madrona::geo;
+using namespace madrona::geo::test;
+using namespace madrona::math;
+using namespace madrona::phys;
+
+namespace {
+
+void expectVecNear(Vector3 a, Vector3 b, float tolerance)
+{
+    EXPECT_NEAR(a.x, b.x, tolerance);
+    EXPECT_NEAR(a.y, b.y, tolerance);
+    EXPECT_NEAR(a.z, b.z, tolerance);
+}
+
+}
+
+TEST(PrimitiveContacts, UnitBoxHull)
+{
+    prims::UnitBoxHull box = prims::makeUnitBoxHull();
+    HalfEdgeMesh mesh = box.mesh();
+
+    for (uint32_t face = 0; face < mesh.numFaces; face++) {
+        Plane plane = mesh.facePlanes[face];
+        uint32_t num_face_verts = 0;
+        mesh.iterateFaceIndices(face, [&](uint32_t vert_idx) {
+            EXPECT_FLOAT_EQ(dot(plane.normal, mesh.vertices[vert_idx]),
+                            plane.d);
+            num_face_verts++;
+        });
+        EXPECT_EQ(num_face_verts, 4u);
+    }
+
+    for (uint32_t i = 0; i < mesh.numHalfEdges; i++) {
+        HalfEdge hedge = mesh.halfEdges[i];
+        HalfEdge twin = mesh.halfEdges[mesh.twinIDX(i)];
+        EXPECT_EQ(mesh.halfEdges[twin.next].rootVertex, hedge.rootVertex);
+        EXPECT_EQ(mesh.halfEdges[hedge.next].rootVertex, twin.rootVertex);
+        EXPECT_EQ(mesh.halfEdges[hedge.next].face, hedge.face);
+    }
+}
+
+TEST(PrimitiveContacts, ClosestPointsBetweenSegments)
+{
+    float s, t;
+
+    // Crossing at right angles, 1 apart
+    prims::closestPointsBetweenSegments(
+        { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 1 }, { 0, 1, 1 }, &s, &t);
+    EXPECT_FLOAT_EQ(s, 0.5f);
+    EXPECT_FLOAT_EQ(t, 0.5f);
+
+    // Closest point is past the end of the second segment
+    prims::closestPointsBetweenSegments(
+        { 0, 0, 0 }, { 1, 0, 0 }, { 3, 1, 0 }, { 3, 2, 0 }, &s, &t);
+    EXPECT_FLOAT_EQ(s, 1.f);
+    EXPECT_FLOAT_EQ(t, 0.f);
+
+    // Degenerate second segment
+    prims::closestPointsBetweenSegments(
+        { 0, 0, 0 }, { 2, 0, 0 }, { 1, 1, 0 }, { 1, 1, 0 }, &s, &t);
+    EXPECT_FLOAT_EQ(s, 0.5f);
+    EXPECT_FLOAT_EQ(t, 0.f);
+}
+
+TEST(PrimitiveContacts, SphereBox)
+{
+    prims::BoxShape box {
+        .center = { 0, 0, 0 },
+        .rot = Quat::angleAxis(0.3f, math::up),
+        .halfExtents = { 1, 2, 0.5f },
+    };
+
+    prims::Contact contact;
+    EXPECT_FALSE(prims::sphereBox({ 0, 0, 1.6f }, 1.f, box, &contact));
+
+    ASSERT_TRUE(prims::sphereBox({ 0, 0, 1.25f }, 1.f, box, &contact));
+    ASSERT_EQ(contact.numPoints, 1);
+    expectVecNear(contact.normal, math::up, 1e-5f);
+    expectVecNear(contact.points[0], { 0, 0, 0.5f }, 1e-5f);
+    EXPECT_NEAR(contact.depths[0], 0.25f, 1e-5f);
+
+    // Center inside the box, pushed out through the closest face
+    ASSERT_TRUE(prims::sphereBox({ 0, 0, -0.4f }, 0.5f, box, &contact));
+    expectVecNear(contact.normal, -math::up, 1e-5f);
+    EXPECT_NEAR(contact.depths[0], 0.6f, 1e-5f);
+}
+
+TEST(PrimitiveContacts, CapsuleCapsule)
+{
+    prims::CapsuleShape b {
+        .p1 = { -1, 0, 0 },
+        .p2 = { 1, 0, 0 },
+        .radius = 0.5f,
+    };
+
+    prims::Contact contact;
+
+    // Crossed capsules touch at one point
+    prims::CapsuleShape crossed {
+        .p1 = { 0, -1, 0.9f },
+        .p2 = { 0, 1, 0.9f },
+        .radius = 0.5f,
+    };
+    ASSERT_TRUE(prims::capsuleCapsule(crossed, b, &contact));
+    ASSERT_EQ(contact.numPoints, 1);
+    expectVecNear(contact.normal, math::up, 1e-5f);
+    expectVecNear(contact.points[0], { 0, 0, 0.5f }, 1e-5f);
+    EXPECT_NEAR(contact.depths[0], 0.1f, 1e-5f);
+
+    // Parallel capsules get a contact at each end of the overlap
+    prims::CapsuleShape parallel {
+        .p1 = { 0.5f, 0, 0.9f },
+        .p2 = { 2, 0, 0.9f },
+        .radius = 0.5f,
+    };
+    ASSERT_TRUE(prims::capsuleCapsule(parallel, b, &contact));
+    ASSERT_EQ(contact.numPoints, 2);
+    expectVecNear(contact.points[0], { 0.5f, 0, 0.5f }, 1e-5f);
+    expectVecNear(contact.points[1], { 1, 0, 0.5f }, 1e-5f);
+    EXPECT_NEAR(contact.depths[0], 0.1f, 1e-5f);
+    EXPECT_NEAR(contact.depths[1], 0.1f, 1e-5f);
+
+    parallel.p1.z = parallel.p2.z = 1.1f;
+    EXPECT_FALSE(prims::capsuleCapsule(parallel, b, &contact));
+}
+
+TEST(PrimitiveContacts, CapsulePlane)
+{
+    Plane plane { math::up, 0.f };
+
+    prims::CapsuleShape capsule {
+        .p1 = { -1, 0, 0.4f },
+        .p2 = { 1, 0, 0.6f },
+        .radius = 0.5f,
+    };
+
+    prims::Contact contact;
+    ASSERT_TRUE(prims::capsulePlane(capsule, plane, &contact));
+    ASSERT_EQ(contact.numPoints, 1);
+    expectVecNear(contact.points[0], { -1, 0, 0 }, 1e-5f);
+    EXPECT_NEAR(contact.depths[0], 0.1f, 1e-5f);
+
+    capsule.p2.z = 0.3f;
+    ASSERT_TRUE(prims::capsulePlane(capsule, plane, &contact));
+    EXPECT_EQ(contact.numPoints, 2);
+}
+
+TEST(PrimitiveContacts, CapsuleBox)
+{
+    prims::BoxShape box {
+        .center = { 0, 0, 0 },
+        .rot = { 1, 0, 0, 0 },
+        .halfExtents = { 2, 2, 1 },
+    };
+
+    prims::Contact contact;
+
+    // Lying on the top face
+    prims::CapsuleShape resting {
+        .p1 = { -1, 0.5f, 1.4f },
+        .p2 = { 3, 0.5f, 1.4f },
+        .radius = 0.5f,
+    };
+    ASSERT_TRUE(prims::capsuleBox(resting, box, &contact));
+    ASSERT_EQ(contact.numPoints, 2);
+    expectVecNear(contact.normal, math::up, 1e-5f);
+    expectVecNear(contact.points[0], { -1, 0.5f, 1 }, 1e-5f);
+    // Clipped to the side of the face
+    expectVecNear(contact.points[1], { 2, 0.5f, 1 }, 1e-5f);
+    EXPECT_NEAR(contact.depths[0], 0.1f, 1e-5f);
+
+    // Diagonal near an edge
+    prims::CapsuleShape edge {
+        .p1 = { 2.3f, -1, 1.3f },
+        .p2 = { 2.3f, 1, 1.3f },
+        .radius = 0.5f,
+    };
+    ASSERT_TRUE(prims::capsuleBox(edge, box, &contact));
+    ASSERT_EQ(contact.numPoints, 1);
+    expectVecNear(contact.normal,
+        Vector3 { 1, 0, 1 }.normalize(), 1e-5f);
+    EXPECT_NEAR(contact.depths[0], 0.5f - sqrtf(0.18f), 1e-5f);
+
+    edge.p1.x = edge.p2.x = 2.5f;
+    edge.p1.z = edge.p2.z = 1.5f;
+    EXPECT_FALSE(prims::capsuleBox(edge, box, &contact));
+
+    // Through the box, pushed out the top
+    prims::CapsuleShape through {
+        .p1 = { -3, 0, 0.8f },
+        .p2 = { 3, 0, 0.8f },
+        .radius = 0.1f,
+    };
+    ASSERT_TRUE(prims::capsuleBox(through, box, &contact));
+    expectVecNear(contact.normal, math::up, 1e-5f);
+    ASSERT_EQ(contact.numPoints, 2);
+    EXPECT_NEAR(contact.depths[0], 0.3f, 1e-5f);
+}
+
+TEST(PrimitiveContacts, BoxPlane)
+{
+    Plane plane { math::up, 0.f };
+
+    prims::BoxShape box {
+        .center = { 0, 0, 0.9f },
+        .rot = Quat::angleAxis(0.7f, math::up),
+        .halfExtents = { 1, 1, 1 },
+    };
+
+    prims::Contact contact;
+    ASSERT_TRUE(prims::boxPlane(box, plane, &contact));
+    ASSERT_EQ(contact.numPoints, 4);
+    for (int32_t i = 0; i < 4; i++) {
+        EXPECT_NEAR(contact.points[i].z, 0.f, 1e-5f);
+        EXPECT_NEAR(contact.depths[i], 0.1f, 1e-5f);
+    }
+
+    box.center.z = 1.1f;
+    EXPECT_FALSE(prims::boxPlane(box, plane, &contact));
+}
+
+TEST(PrimitiveContacts, BoxBoxStacked)
+{
+    prims::BoxShape bottom {
+        .center = { 0, 0, 0 },
+        .rot = { 1, 0, 0, 0 },
+        .halfExtents = { 2, 2, 0.5f },
+    };
+
+    prims::BoxShape top {
+        .center = { 0.2f, -0.1f, 0.95f },
+        .rot = Quat::angleAxis(0.5f, math::up),
+        .halfExtents = { 0.5f, 0.5f, 0.5f },
+    };
+
+    prims::Contact contact;
+    ASSERT_TRUE(prims::boxBox(top, bottom, &contact));
+    expectVecNear(contact.normal, math::up, 1e-5f);
+    ASSERT_EQ(contact.numPoints, 4);
+    for (int32_t i = 0; i < contact.numPoints; i++) {
+        EXPECT_NEAR(contact.points[i].z, 0.5f, 1e-5f);
+        EXPECT_NEAR(contact.depths[i], 0.05f, 1e-5f);
+    }
+
+    // Swapping the reference still reports points on b's surface
+    ASSERT_TRUE(prims::boxBox(bottom, top, &contact));
+    expectVecNear(contact.normal, -math::up, 1e-5f);
+    ASSERT_EQ(contact.numPoints, 4);
+    for (int32_t i = 0; i < contact.numPoints; i++) {
+        EXPECT_NEAR(contact.points[i].z, 0.45f, 1e-5f);
+        EXPECT_NEAR(contact.depths[i], 0.05f, 1e-5f);
+    }
+}
+
+// Separated pairs within max_separation get contacts with negative depth
+TEST(PrimitiveContacts, BoxSpeculative)
+{
+    Plane plane { math::up, 0.f };
+
+    prims::BoxShape box {
+        .center = { 0, 0, 1.1f },
+        .rot = Quat::angleAxis(0.7f, math::up),
+        .halfExtents = { 1, 1, 1 },
+    };
+
+    prims::Contact contact;
+    ASSERT_TRUE(prims::boxPlane(box, plane, &contact, 0.2f));
+    ASSERT_EQ(contact.numPoints, 4);
+    for (int32_t i = 0; i < 4; i++) {
+        EXPECT_NEAR(contact.points[i].z, 0.f, 1e-5f);
+        EXPECT_NEAR(contact.depths[i], -0.1f, 1e-5f);
+    }
+
+    EXPECT_FALSE(prims::boxPlane(box, plane, &contact, 0.05f));
+
+    prims::BoxShape bottom {
+        .center = { 0, 0, 0 },
+        .rot = { 1, 0, 0, 0 },
+        .halfExtents = { 2, 2, 0.5f },
+    };
+
+    prims::BoxShape top {
+        .center = { 0.2f, -0.1f, 1.1f },
+        .rot = Quat::angleAxis(0.5f, math::up),
+        .halfExtents = { 0.5f, 0.5f, 0.5f },
+    };
+
+    ASSERT_TRUE(prims::boxBox(top, bottom, &contact, 0.2f));
+    expectVecNear(contact.normal, math::up, 1e-5f);
+    ASSERT_EQ(contact.numPoints, 4);
+    for (int32_t i = 0; i < contact.numPoints; i++) {
+        EXPECT_NEAR(contact.points[i].z, 0.5f, 1e-5f);
+        EXPECT_NEAR(contact.depths[i], -0.1f, 1e-5f);
+    }
+
+    EXPECT_FALSE(prims::boxBox(top, bottom, &contact));
+    EXPECT_FALSE(prims::boxBox(top, bottom, &contact, 0.05f));
+}
+
+// The SAT depth of the closed form test should agree with GJK + EPA on the
+// same boxes as hulls
+TEST(PrimitiveContacts, BoxBoxMatchesGJKEPA)
+{
+    std::mt19937 rng(13);
+    std::uniform_real_distribution<float> pos_dist(-2.2f, 2.2f);
+
+    int32_t num_hits = 0;
+    for (int32_t iter = 0; iter < 500; iter++) {
+        Quat a_rot = randomRotation(rng);
+        Quat b_rot = randomRotation(rng);
+        Vector3 a_pos { pos_dist(rng), pos_dist(rng), pos_dist(rng) };
+
+        TestHull a_hull = makeBox(a_rot, a_pos);
+        TestHull b_hull = makeBox(b_rot, Vector3::zero());
+
+        HullHullGJKResult ref = hullHullGJKEPA(
+            a_hull.mesh(), b_hull.mesh(), 1e-10f);
+
+        prims::Contact contact;
+        bool hit = prims::boxBox(
+            { a_pos, a_rot, { 1, 1, 1 } },
+            { Vector3::zero(), b_rot, { 1, 1, 1 } },
+            &contact);
+
+        if (ref.distance > 1e-3f) {
+            EXPECT_FALSE(hit);
+            continue;
+        }
+
+        if (ref.distance > 0.f || ref.depth < 1e-3f || !ref.valid) {
+            continue;
+        }
+
+        ASSERT_TRUE(hit);
+        num_hits++;
+
+        float max_depth = 0.f;
+        for (int32_t i = 0; i < contact.numPoints; i++) {
+            max_depth = fmaxf(max_depth, contact.depths[i]);
+        }
+
+        // Face axes are preferred over slightly better edge axes
+        EXPECT_NEAR(max_depth, ref.depth,
+                    prims::boxEdgeAxisTolerance + 1e-3f);
+
+        // Normal points out of b, towards a
+        EXPECT_GT(dot(contact.normal, a_pos), 0.f);
+    }
+
+    EXPECT_GT(num_hits, 50);
+}
+
+TEST(PrimitiveContacts, HullCapsule)
+{
+    TestHull hull = makeBox({ 1, 0, 0, 0 }, Vector3::zero());
+    HalfEdgeMesh mesh = hull.mesh();
+
+    prims::Contact contact;
+
+    // Lying on the top face, clipped to its sides
+    prims::CapsuleShape resting {
+        .p1 = { -0.5f, 0.2f, 1.4f },
+        .p2 = { 3, 0.2f, 1.4f },
+        .radius = 0.5f,
+    };
+    ASSERT_TRUE(prims::hullCapsule(mesh, resting, &contact));
+    expectVecNear(contact.normal, -math::up, 1e-5f);
+    ASSERT_EQ(contact.numPoints, 2);
+    expectVecNear(contact.points[0], { -0.5f, 0.2f, 0.9f }, 1e-4f);
+    expectVecNear(contact.points[1], { 1, 0.2f, 0.9f }, 1e-4f);
+    EXPECT_NEAR(contact.depths[0], 0.1f, 1e-4f);
+
+    // Upright near a corner
+    prims::CapsuleShape upright {
+        .p1 = { 1.2f, 1.2f, 1.2f },
+        .p2 = { 1.2f, 1.2f, 3 },
+        .radius = 0.5f,
+    };
+    ASSERT_TRUE(prims::hullCapsule(mesh, upright, &contact));
+    ASSERT_EQ(contact.numPoints, 1);
+    expectVecNear(contact.normal, -Vector3 { 1, 1, 1 }.normalize(), 1e-4f);
+    EXPECT_NEAR(contact.depths[0], 0.5f - sqrtf(3 * 0.04f), 1e-4f);
+
+    upright.p1 = { 1.4f, 1.4f, 1.4f };
+    EXPECT_FALSE(prims::hullCapsule(mesh, upright, &contact));
+
+    // Through the hull
+    prims::CapsuleShape through {
+        .p1 = { -2, 0, 0.7f },
+        .p2 = { 2, 0, 0.7f },
+        .radius = 0.1f,
+    };
+    ASSERT_TRUE(prims::hullCapsule(mesh, through, &contact));
+    expectVecNear(contact.normal, -math::up, 1e-5f);
+    ASSERT_EQ(contact.numPoints, 2);
+    EXPECT_NEAR(contact.depths[0], 0.4f, 1e-5f);
+}
+
+namespace {
+
+// Heights in millimeters, so the test functions below quantize exactly
+struct TestHeightfield {
+    std::vector<uint16_t> samples;
+    prims::HeightfieldShape shape;
+};
+
+template <typename Fn>
+TestHeightfield makeTestHeightfield(int32_t num_rows, int32_t num_cols,
+                                    float cell_size, Fn &&height_fn)
+{
+    TestHeightfield hf;
+    hf.samples.resize(num_rows * num_cols);
+    hf.shape = prims::HeightfieldShape {
+        .samples = nullptr,
+        .numRows = num_rows,
+        .numCols = num_cols,
+        .cellSize = cell_size,
+        .minHeight = 0.f,
+        .heightScale = 1e-3f,
+    };
+
+    for (int32_t row = 0; row < num_rows; row++) {
+        for (int32_t col = 0; col < num_cols; col++) {
+            Vector3 v = prims::heightfieldVertex(hf.shape, row, col);
+            hf.samples[row * num_cols + col] =
+                (uint16_t)lroundf(height_fn(v.x, v.y) * 1000.f);
+        }
+    }
+
+    hf.shape.samples = hf.samples.data();
+    return hf;
+}
+
+}
+
+TEST(PrimitiveContacts, HeightfieldSurface)
+{
+    // z = 0.5x + 1 over [-2, 2]
+    TestHeightfield hf = makeTestHeightfield(5, 5, 1.f,
+        [](float x, float) { return 0.5f * x + 1.f; });
+
+    float height;
+    Vector3 normal;
+    ASSERT_TRUE(prims::heightfieldSurfaceAt(
+        hf.shape, 0.3f, -0.7f, &height, &normal));
+    EXPECT_NEAR(height, 1.15f, 1e-5f);
+    expectVecNear(normal, Vector3 { -0.5f, 0, 1 }.normalize(), 1e-5f);
+
+    EXPECT_FALSE(prims::heightfieldSurfaceAt(
+        hf.shape, 2.1f, 0, &height, &normal));
+
+    prims::HeightfieldCellRange range;
+    ASSERT_TRUE(prims::heightfieldCellRange(hf.shape,
+        { -0.5f, 1.5f, 0 }, { 0.5f, 5, 0 }, &range));
+    EXPECT_EQ(range.colMin, 1);
+    EXPECT_EQ(range.colMax, 2);
+    EXPECT_EQ(range.rowMin, 3);
+    EXPECT_EQ(range.rowMax, 3);
+
+    EXPECT_FALSE(prims::heightfieldCellRange(hf.shape,
+        { 3, 0, 0 }, { 4, 1, 0 }, &range));
+}
+
+TEST(PrimitiveContacts, SphereHeightfield)
+{
+    TestHeightfield flat = makeTestHeightfield(6, 6, 1.f,
+        [](float, float) { return 0.f; });
+    Vector3 hf_pos { 0, 0, 1 };
+    Quat hf_rot = Quat::angleAxis(0, math::up);
+
+    prims::Contact contact;
+    ASSERT_TRUE(prims::sphereHeightfield({ 0.3f, 0.2f, 1.4f }, 0.5f,
+        flat.shape, hf_pos, hf_rot, &contact));
+    expectVecNear(contact.normal, math::up, 1e-5f);
+    ASSERT_EQ(contact.numPoints, 1);
+    expectVecNear(contact.points[0], { 0.3f, 0.2f, 1 }, 1e-5f);
+    EXPECT_NEAR(contact.depths[0], 0.1f, 1e-5f);
+
+    // Right over a grid vertex, where every neighboring triangle reports
+    // the same point
+    ASSERT_TRUE(prims::sphereHeightfield({ 0.5f, 0.5f, 1.4f }, 0.5f,
+        flat.shape, hf_pos, hf_rot, &contact));
+    expectVecNear(contact.normal, math::up, 1e-5f);
+    ASSERT_EQ(contact.numPoints, 1);
+
+    EXPECT_FALSE(prims::sphereHeightfield({ 0.3f, 0.2f, 1.6f }, 0.5f,
+        flat.shape, hf_pos, hf_rot, &contact));
+
+    // Center under the surface
+    ASSERT_TRUE(prims::sphereHeightfield({ 0.3f, 0.2f, 0.9f }, 0.5f,
+        flat.shape, hf_pos, hf_rot, &contact));
+    expectVecNear(contact.normal, math::up, 1e-5f);
+    ASSERT_EQ(contact.numPoints, 1);
+    EXPECT_NEAR(contact.depths[0], 0.6f, 1e-5f);
+
+    // On a slope the normal comes from the face under the sphere rather
+    // than the edges around it
+    TestHeightfield slope = makeTestHeightfield(6, 6, 1.f,
+        [](float x, float) { return 0.5f * x + 2.f; });
+    Vector3 slope_normal = Vector3 { -0.5f, 0, 1 }.normalize();
+    Vector3 surface_pt { 0.2f, 0.3f, 3.1f };
+    Vector3 center = surface_pt + 0.45f * slope_normal;
+
+    ASSERT_TRUE(prims::sphereHeightfield(center, 0.5f,
+        slope.shape, hf_pos, hf_rot, &contact));
+    expectVecNear(contact.normal, slope_normal, 1e-4f);
+    ASSERT_EQ(contact.numPoints, 1);
+    expectVecNear(contact.points[0], surface_pt, 1e-4f);
+    EXPECT_NEAR(contact.depths[0], 0.05f, 1e-4f);
+}
+
+TEST(PrimitiveContacts, CapsuleHeightfield)
+{
+    TestHeightfield flat = makeTestHeightfield(8, 8, 0.5f,
+        [](float, float) { return 0.f; });
+    Quat hf_rot = Quat::angleAxis(0, math::up);
+
+    // Lying across several cells
+    prims::CapsuleShape lying {
+        .p1 = { -1.1f, 0.1f, 0.45f },
+        .p2 = { 1.2f, -0.3f, 0.45f },
+        .radius = 0.5f,
+    };
+
+    prims::Contact contact;
+    ASSERT_TRUE(prims::capsuleHeightfield(lying, flat.shape,
+        Vector3::zero(), hf_rot, &contact));
+    expectVecNear(contact.normal, math::up, 1e-5f);
+    ASSERT_GE(contact.numPoints, 2);
+    for (int32_t i = 0; i < contact.numPoints; i++) {
+        EXPECT_NEAR(contact.depths[i], 0.05f, 1e-5f);
+        EXPECT_NEAR(contact.points[i].z, 0, 1e-5f);
+    }
+
+    bool found_ends[2] = { false, false };
+    for (int32_t i = 0; i < contact.numPoints; i++) {
+        Vector3 p = contact.points[i];
+        if (fabsf(p.x - lying.p1.x) < 1e-4f &&
+                fabsf(p.y - lying.p1.y) < 1e-4f) {
+            found_ends[0] = true;
+        }
+        if (fabsf(p.x - lying.p2.x) < 1e-4f &&
+                fabsf(p.y - lying.p2.y) < 1e-4f) {
+            found_ends[1] = true;
+        }
+    }
+    EXPECT_TRUE(found_ends[0]);
+    EXPECT_TRUE(found_ends[1]);
+
+    // Lying across a ridge, touching it only in the middle
+    TestHeightfield ridge = makeTestHeightfield(7, 7, 1.f,
+        [](float x, float) { return 1.5f - 0.5f * fabsf(x); });
+    prims::CapsuleShape across {
+        .p1 = { -2, 0.2f, 1.9f },
+        .p2 = { 2, 0.2f, 1.9f },
+        .radius = 0.5f,
+    };
+
+    ASSERT_TRUE(prims::capsuleHeightfield(across, ridge.shape,
+        Vector3::zero(), hf_rot, &contact));
+    expectVecNear(contact.normal, math::up, 1e-4f);
+    ASSERT_EQ(contact.numPoints, 1);
+    expectVecNear(contact.points[0], { 0, 0.2f, 1.5f }, 1e-4f);
+    EXPECT_NEAR(contact.depths[0], 0.1f, 1e-4f);
+}
+
+TEST(PrimitiveContacts, HullHeightfield)
+{
+    TestHeightfield flat = makeTestHeightfield(9, 9, 0.5f,
+        [](float, float) { return 0.f; });
+    Quat hf_rot = Quat::angleAxis(0, math::up);
+
+    prims::UnitBoxHull unit_box = prims::makeUnitBoxHull();
+    HalfEdgeMesh unit_mesh = unit_box.mesh();
+
+    // Box resting on the grid, slightly sunk in and rotated about Z
+    Vector3 box_pos { 0.1f, 0.05f, 0.49f };
+    Quat box_rot = Quat::angleAxis(0.3f, math::up);
+    Vector3 half_extents { 0.8f, 0.6f, 0.5f };
+
+    std::vector<Vector3> verts(unit_mesh.numVertices);
+    std::vector<Plane> planes(unit_mesh.numFaces);
+    for (uint32_t i = 0; i < unit_mesh.numVertices; i++) {
+        verts[i] = box_rot.rotateVec(
+            Diag3x3::fromVec(half_extents) * unit_mesh.vertices[i]) +
+            box_pos;
+    }
+    for (uint32_t i = 0; i < unit_mesh.numFaces; i++) {
+        Vector3 n = box_rot.rotateVec(unit_mesh.facePlanes[i].normal);
+        Vector3 face_pt = verts[unit_mesh.halfEdges[
+            unit_mesh.faceBaseHalfEdges[i]].rootVertex];
+        planes[i] = Plane { n, dot(n, face_pt) };
+    }
+
+    HalfEdgeMesh box_mesh = unit_mesh;
+    box_mesh.vertices = verts.data();
+    box_mesh.facePlanes = planes.data();
+
+    prims::Contact contact;
+    ASSERT_TRUE(prims::hullHeightfield(box_mesh, flat.shape,
+        Vector3::zero(), hf_rot, &contact));
+    expectVecNear(contact.normal, math::up, 1e-5f);
+    ASSERT_EQ(contact.numPoints, 4);
+    for (int32_t i = 0; i < 4; i++) {
+        EXPECT_NEAR(contact.depths[i], 0.01f, 1e-5f);
+        EXPECT_NEAR(contact.points[i].z, 0, 1e-5f);
+    }
+
+    // A spike poking into the bottom of the box, between its corners
+    TestHeightfield spike = makeTestHeightfield(9, 9, 0.5f,
+        [](float x, float y) {
+            return (x == 0 && y == 0) ? 0.2f : 0.f;
+        });
+    for (uint32_t i = 0; i < unit_mesh.numVertices; i++) {
+        verts[i].z += 0.1f;
+    }
+    for (uint32_t i = 0; i < unit_mesh.numFaces; i++) {
+        planes[i].d += 0.1f * planes[i].normal.z;
+    }
+
+    ASSERT_TRUE(prims::hullHeightfield(box_mesh, spike.shape,
+        Vector3::zero(), hf_rot, &contact));
+    expectVecNear(contact.normal, math::up, 1e-5f);
+    ASSERT_EQ(contact.numPoints, 1);
+    expectVecNear(contact.points[0], { 0, 0, 0.2f }, 1e-5f);
+    EXPECT_NEAR(contact.depths[0], 0.11f, 1e-5f);
+}
+
+TEST(PrimitiveContacts, RayHeightfield)
+{
+    // z = 0.25x + 1 over [-2, 2]
+    TestHeightfield hf = makeTestHeightfield(9, 9, 0.5f,
+        [](float x, float) { return 0.25f * x + 1.f; });
+
+    float hit_t;
+    Vector3 hit_normal;
+
+    // Straight down
+    ASSERT_TRUE(prims::traceRayIntoHeightfield(hf.shape,
+        { 0.3f, -1.1f, 5 }, { 0, 0, -1 }, 0.f, 10.f, &hit_t, &hit_normal));
+    EXPECT_NEAR(hit_t, 5 - 1.075f, 1e-4f);
+    expectVecNear(hit_normal, Vector3 { -0.25f, 0, 1 }.normalize(), 1e-5f);
+
+    // Shallow, crossing many cells before hitting
+    Vector3 ray_o { -3, -1.8f, 2.5f };
+    Vector3 ray_d = Vector3 { 1, 0.7f, -0.4f }.normalize();
+    ASSERT_TRUE(prims::traceRayIntoHeightfield(hf.shape,
+        ray_o, ray_d, 0.f, 100.f, &hit_t, &hit_normal));
+    Vector3 hit_pos = ray_o + hit_t * ray_d;
+    EXPECT_NEAR(hit_pos.z, 0.25f * hit_pos.x + 1.f, 1e-4f);
+    EXPECT_GT(hit_pos.x, -2.f);
+
+    // Cut off by t_max
+    EXPECT_FALSE(prims::traceRayIntoHeightfield(hf.shape,
+        { 0.3f, -1.1f, 5 }, { 0, 0, -1 }, 0.f, 3.f, &hit_t, &hit_normal));
+
+    // Passing over the top
+    EXPECT_FALSE(prims::traceRayIntoHeightfield(hf.shape,
+        { -3, 0, 2.6f }, { 1, 0, 0 }, 0.f, 100.f, &hit_t, &hit_normal));
+
+    // Missing the grid
+    EXPECT_FALSE(prims::traceRayIntoHeightfield(hf.shape,
+        { 3, 0, 5 }, { 0, 0, -1 }, 0.f, 100.f, &hit_t, &hit_normal));
+}
+
+namespace {
+
+// Grid of triangles facing +Z, with z given by height_fn at the vertices
+struct TestTriangleMesh {
+    MeshBVH bvh;
+    void *blob;
+
+    TestTriangleMesh() = default;
+    TestTriangleMesh(const TestTriangleMesh &) = delete;
+    ~TestTriangleMesh() { free(blob); }
+
+    prims::TriangleMeshShape shape() const
+    {
+        return prims::TriangleMeshShape {
+            .bvh = &bvh,
+            .scale = Diag3x3 { 1, 1, 1 },
+        };
+    }
+};
+
+template <typename Fn>
+void makeTestTriangleMesh(int32_t num_cells, float cell_size,
+                          Fn &&height_fn, TestTriangleMesh *out)
+{
+    int32_t num_verts_per_side = num_cells + 1;
+    float origin = -0.5f * cell_size * (float)num_cells;
+
+    std::vector<Vector3> positions;
+    for (int32_t y = 0; y < num_verts_per_side; y++) {
+        for (int32_t x = 0; x < num_verts_per_side; x++) {
+            float px = origin + cell_size * (float)x;
+            float py = origin + cell_size * (float)y;
+            positions.push_back({ px, py, height_fn(px, py) });
+        }
+    }
+
+    std::vector<uint32_t> indices;
+    for (int32_t y = 0; y < num_cells; y++) {
+        for (int32_t x = 0; x < num_cells; x++) {
+            uint32_t v00 = y * num_verts_per_side + x;
+            uint32_t v10 = v00 + 1;
+            uint32_t v01 = v00 + num_verts_per_side;
+            uint32_t v11 = v01 + 1;
+
+            indices.insert(indices.end(), { v00, v10, v11 });
+            indices.insert(indices.end(), { v00, v11, v01 });
+        }
+    }
+
+    imp::SourceMesh src_mesh {
+        .positions = positions.data(),
+        .normals = nullptr,
+        .tangentAndSigns = nullptr,
+        .uvs = nullptr,
+        .indices = indices.data(),
+        .faceCounts = nullptr,
+        .faceMaterials = nullptr,
+        .numVertices = (uint32_t)positions.size(),
+        .numFaces = (uint32_t)indices.size() / 3,
+        .materialIDX = 0,
+    };
+
+    StackAlloc tmp_alloc;
+    CountT num_bytes;
+    out->blob = MeshBVHBuilder::build(Span(&src_mesh, 1), tmp_alloc,
+                                      &out->bvh, &num_bytes);
+}
+
+}
+
+TEST(PrimitiveContacts, SphereTriangleMesh)
+{
+    TestTriangleMesh flat;
+    makeTestTriangleMesh(8, 0.5f, [](float, float) { return 0.f; }, &flat);
+    Quat mesh_rot = Quat::angleAxis(0, math::up);
+
+    // Directly over a vertex shared by six triangles and over the diagonal
+    // edge between two, neither of which should tilt the normal
+    for (Vector3 center : {
+            Vector3 { 0, 0, 0.45f },
+            Vector3 { 0.2f, 0.2f, 0.45f },
+            Vector3 { 0.5f, 0.3f, 0.45f } }) {
+        prims::Contact contact;
+        ASSERT_TRUE(prims::sphereTriangleMesh(center, 0.5f, flat.shape(),
+            Vector3::zero(), mesh_rot, &contact));
+        expectVecNear(contact.normal, math::up, 1e-5f);
+        ASSERT_EQ(contact.numPoints, 1);
+        EXPECT_NEAR(contact.depths[0], 0.05f, 1e-5f);
+        expectVecNear(contact.points[0], { center.x, center.y, 0 }, 1e-5f);
+    }
+
+    // Triangles are one sided
+    prims::Contact contact;
+    EXPECT_FALSE(prims::sphereTriangleMesh({ 0.1f, 0.1f, -0.8f }, 0.5f,
+        flat.shape(), Vector3::zero(), mesh_rot, &contact));
+
+    // Sunk below the surface, but still pushed back out the front
+    ASSERT_TRUE(prims::sphereTriangleMesh({ 0.1f, 0.3f, -0.2f }, 0.5f,
+        flat.shape(), Vector3::zero(), mesh_rot, &contact));
+    expectVecNear(contact.normal, math::up, 1e-5f);
+    EXPECT_NEAR(contact.depths[0], 0.7f, 1e-5f);
+
+    // Off the corner of the mesh, pushed out diagonally. The mesh is moved
+    // and turned so its local +Z is world +X.
+    Quat side_rot = Quat::angleAxis(math::pi / 2.f, { 0, 1, 0 });
+    Vector3 mesh_pos { 1, 2, 3 };
+    Vector3 local_center { 2.2f, 2.2f, 0.1f };
+    ASSERT_TRUE(prims::sphereTriangleMesh(
+        side_rot.rotateVec(local_center) + mesh_pos, 0.5f, flat.shape(),
+        mesh_pos, side_rot, &contact));
+    ASSERT_EQ(contact.numPoints, 1);
+    Vector3 local_normal = Vector3 { 0.2f, 0.2f, 0.1f }.normalize();
+    expectVecNear(contact.normal, side_rot.rotateVec(local_normal), 1e-5f);
+    EXPECT_NEAR(contact.depths[0], 0.5f - 0.3f, 1e-5f);
+    expectVecNear(contact.points[0],
+        side_rot.rotateVec({ 2, 2, 0 }) + mesh_pos, 1e-5f);
+}
+
+TEST(PrimitiveContacts, CapsuleTriangleMesh)
+{
+    TestTriangleMesh flat;
+    makeTestTriangleMesh(8, 0.5f, [](float, float) { return 0.f; }, &flat);
+    Quat mesh_rot = Quat::angleAxis(0, math::up);
+
+    // Lying across many triangles
+    prims::CapsuleShape lying {
+        .p1 = { -1.3f, 0.2f, 0.45f },
+        .p2 = { 1.2f, 0.15f, 0.45f },
+        .radius = 0.5f,
+    };
+
+    prims::Contact contact;
+    ASSERT_TRUE(prims::capsuleTriangleMesh(lying, flat.shape(),
+        Vector3::zero(), mesh_rot, &contact));
+    expectVecNear(contact.normal, math::up, 1e-5f);
+    ASSERT_EQ(contact.numPoints, 2);
+    for (int32_t i = 0; i < 2; i++) {
+        EXPECT_NEAR(contact.depths[i], 0.05f, 1e-5f);
+    }
+    EXPECT_NEAR(fabsf(contact.points[0].x - contact.points[1].x), 2.5f,
+                1e-4f);
+
+    // Lying across the edge of a step down, touching only its corner
+    TestTriangleMesh step;
+    makeTestTriangleMesh(8, 0.5f,
+        [](float x, float) { return x <= 0.f ? 0.f : -1.f; }, &step);
+
+    prims::CapsuleShape over_edge {
+        .p1 = { -1, -0.3f, 0.1f },
+        .p2 = { 1, 0.3f, 0.1f },
+        .radius = 0.2f,
+    };
+    ASSERT_TRUE(prims::capsuleTriangleMesh(over_edge, step.shape(),
+        Vector3::zero(), mesh_rot, &contact));
+    expectVecNear(contact.normal, math::up, 1e-4f);
+    EXPECT_NEAR(contact.depths[0], 0.1f, 1e-4f);
+}
+
+TEST(PrimitiveContacts, HullTriangleMesh)
+{
+    TestTriangleMesh flat;
+    makeTestTriangleMesh(8, 0.5f, [](float, float) { return 0.f; }, &flat);
+    Quat mesh_rot = Quat::angleAxis(0, math::up);
+
+    prims::UnitBoxHull unit_box = prims::makeUnitBoxHull();
+    HalfEdgeMesh unit_mesh = unit_box.mesh();
+
+    // Box resting on the mesh, slightly sunk in and rotated about Z
+    Vector3 box_pos { 0.1f, 0.05f, 0.49f };
+    Quat box_rot = Quat::angleAxis(0.3f, math::up);
+    Vector3 half_extents { 0.8f, 0.6f, 0.5f };
+
+    std::vector<Vector3> verts(unit_mesh.numVertices);
+    std::vector<Plane> planes(unit_mesh.numFaces);
+    for (uint32_t i = 0; i < unit_mesh.numVertices; i++) {
+        verts[i] = box_rot.rotateVec(
+            Diag3x3::fromVec(half_extents) * unit_mesh.vertices[i]) +
+            box_pos;
+    }
+    for (uint32_t i = 0; i < unit_mesh.numFaces; i++) {
+        Vector3 n = box_rot.rotateVec(unit_mesh.facePlanes[i].normal);
+        Vector3 face_pt = verts[unit_mesh.halfEdges[
+            unit_mesh.faceBaseHalfEdges[i]].rootVertex];
+        planes[i] = Plane { n, dot(n, face_pt) };
+    }
+
+    HalfEdgeMesh box_mesh = unit_mesh;
+    box_mesh.vertices = verts.data();
+    box_mesh.facePlanes = planes.data();
+
+    prims::Contact contact;
+    ASSERT_TRUE(prims::hullTriangleMesh(box_mesh, flat.shape(),
+        Vector3::zero(), mesh_rot, &contact));
+    expectVecNear(contact.normal, math::up, 1e-5f);
+    ASSERT_EQ(contact.numPoints, 4);
+    for (int32_t i = 0; i < 4; i++) {
+        EXPECT_NEAR(contact.depths[i], 0.01f, 1e-5f);
+        EXPECT_NEAR(contact.points[i].z, 0, 1e-5f);
+    }
+
+    // Lifted off the mesh
+    for (uint32_t i = 0; i < unit_mesh.numVertices; i++) {
+        verts[i].z += 0.02f;
+    }
+    for (uint32_t i = 0; i < unit_mesh.numFaces; i++) {
+        planes[i].d += 0.02f * planes[i].normal.z;
+    }
+
+    EXPECT_FALSE(prims::hullTriangleMesh(box_mesh, flat.shape(),
+        Vector3::zero(), mesh_rot, &contact));
+}
@@ -2,6 +2,11 @@
 
 #include <madrona/rand.hpp>
 
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
 using namespace madrona;
 
 struct RandomSplitTest : public testing::Test {
@@ -139,3 +144,179 @@ TEST(RandomRange, UpperLimit)
     EXPECT_EQ(r1, 63);
     EXPECT_EQ(r2, 63);
 }
+
+// Lengths around the 8 and 16 lane block sizes plus the tail.
+static const CountT bulkLengths[] = { 0, 1, 7, 8, 9, 15, 16, 17, 33, 100, 257 };
+
+static bool sameBits(float a, float b)
+{
+    return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+TEST(RandomBulk, SplitNMatchesScalar)
+{
+    RandKey k = rand::initKey(17);
+
+    for (CountT n : bulkLengths) {
+        std::vector<RandKey> keys(n);
+        rand::splitN(k, keys.data(), n, 3);
+
+        for (CountT i = 0; i < n; i++) {
+            RandKey ref = rand::split_i(k, 3 + (uint32_t)i);
+            EXPECT_EQ(keys[i].a, ref.a);
+            EXPECT_EQ(keys[i].b, ref.b);
+        }
+    }
+}
+
+TEST(RandomBulk, UniformMatchesScalar)
+{
+    RandKey k = rand::initKey(9);
+
+    for (CountT n : bulkLengths) {
+        std::vector<float> out(n);
+        rand::fillUniform(k, out.data(), n, 11);
+
+        for (CountT i = 0; i < n; i++) {
+            float ref = rand::sampleUniform(rand::split_i(k, 11 + (uint32_t)i));
+            EXPECT_TRUE(sameBits(out[i], ref)) << i;
+        }
+    }
+}
+
+TEST(RandomBulk, NormalMatchesScalar)
+{
+    RandKey k = rand::initKey(23);
+
+    constexpr CountT n = 4096;
+    std::vector<float> out(n);
+    rand::fillNormal(k, out.data(), n);
+
+    double sum = 0.0, sum_sq = 0.0;
+    for (CountT i = 0; i < n; i++) {
+        float ref = rand::sampleNormal(rand::split_i(k, (uint32_t)i));
+        EXPECT_TRUE(sameBits(out[i], ref)) << i;
+        EXPECT_TRUE(std::isfinite(out[i]));
+
+        sum += out[i];
+        sum_sq += (double)out[i] * out[i];
+    }
+
+    double mean = sum / n;
+    double var = sum_sq / n - mean * mean;
+    EXPECT_NEAR(mean, 0.0, 0.1);
+    EXPECT_NEAR(var, 1.0, 0.1);
+}
+
+TEST(RandomBulk, I32RangeMatchesScalar)
+{
+    RandKey k = rand::initKey(31);
+
+    // Include a range with a large s so the rejection path gets exercised.
+    const int32_t ranges[][2] = {
+        { 0, 10 },
+        { -20, 2 },
+        { 0x8000'0000_i32, 0x8000'0000_i32 + 20 },
+        { 0, 0x7000'0000_i32 },
+    };
+
+    for (auto [a, b] : ranges) {
+        for (CountT n : bulkLengths) {
+            std::vector<int32_t> out(n);
+            rand::fillI32Range(k, out.data(), n, a, b, 5);
+
+            for (CountT i = 0; i < n; i++) {
+                int32_t ref = rand::sampleI32(
+                    rand::split_i(k, 5 + (uint32_t)i), a, b);
+                EXPECT_EQ(out[i], ref);
+            }
+        }
+    }
+}
+
+TEST(RandomBulk, CounterWraps)
+{
+    RandKey k = rand::initKey(3);
+
+    constexpr CountT n = 40;
+    uint32_t first = 0xFFFF'FFF0_u32;
+    float out[n];
+    rand::fillUniform(k, out, n, first);
+
+    for (CountT i = 0; i < n; i++) {
+        float ref = rand::sampleUniform(rand::split_i(k, first + (uint32_t)i));
+        EXPECT_TRUE(sameBits(out[i], ref)) << i;
+    }
+}
+
+TEST(RandomBulk, RNGFillMatchesSequential)
+{
+    RNG bulk(77);
+    RNG seq(77);
+
+    float uniforms[19];
+    bulk.fillUniform(uniforms, 19);
+    for (float v : uniforms) {
+        EXPECT_TRUE(sameBits(v, seq.sampleUniform()));
+    }
+
+    float normals[21];
+    bulk.fillNormal(normals, 21);
+    for (float v : normals) {
+        EXPECT_TRUE(sameBits(v, seq.sampleNormal()));
+    }
+
+    int32_t ints[35];
+    bulk.fillI32Range(ints, 35, -5, 100);
+    for (int32_t v : ints) {
+        EXPECT_EQ(v, seq.sampleI32(-5, 100));
+    }
+
+    EXPECT_EQ(bulk.sampleUniform(), seq.sampleUniform());
+}
+
+TEST(RandomBulk, DISABLED_Bench)
+{
+    using Clock = std::chrono::steady_clock;
+    auto ms = [](Clock::time_point start, Clock::time_point end) {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    };
+
+    constexpr CountT n = 1 << 22;
+    std::vector<float> out(n);
+    RandKey k = rand::initKey(1);
+
+    auto start = Clock::now();
+    for (CountT i = 0; i < n; i++) {
+        out[i] = rand::sampleUniform(rand::split_i(k, (uint32_t)i));
+    }
+    auto mid = Clock::now();
+    rand::fillUniform(k, out.data(), n);
+    auto end = Clock::now();
+
+    printf("uniform x %ld: scalar %.2f ms, bulk %.2f ms\n",
+           (long)n, ms(start, mid), ms(mid, end));
+
+    std::vector<int32_t> ints(n);
+    start = Clock::now();
+    for (CountT i = 0; i < n; i++) {
+        ints[i] = rand::sampleI32(rand::split_i(k, (uint32_t)i), 0, 1000);
+    }
+    mid = Clock::now();
+    rand::fillI32Range(k, ints.data(), n, 0, 1000);
+    end = Clock::now();
+
+    printf("i32 range x %ld: scalar %.2f ms, bulk %.2f ms\n",
+           (long)n, ms(start, mid), ms(mid, end));
+
+    start = Clock::now();
+    for (CountT i = 0; i < n; i++) {
+        out[i] = rand::sampleNormal(rand::split_i(k, (uint32_t)i));
+    }
+    mid = Clock::now();
+    rand::fillNormal(k, out.data(), n);
+    end = Clock::now();
+
+    printf("normal x %ld: scalar %.2f ms, bulk %.2f ms\n",
+           (long)n, ms(start, mid), ms(mid, end));
+}
@@ -0,0 +1,514 @@
+#include <gtest/gtest.h>
+
+#include <madrona/math.hpp>
+#include <madrona/rand.hpp>
+#include <madrona/viz/recorder.hpp>
+
+#include "../src/render/ecs_interop.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace madrona;
+using namespace madrona::math;
+using namespace madrona::render;
+using namespace madrona::viz;
+
+namespace {
+
+std::string tmpRecordingPath(const char *name)
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+// Host memory laid out like the CPU backend's bridge
+struct TestBridge {
+    uint32_t numWorlds;
+    std::vector<PerspectiveCameraData> views;
+    std::vector<InstanceData> instances;
+    std::vector<uint32_t> numViews;
+    std::vector<uint32_t> numInstances;
+    RenderECSBridge bridge;
+
+    TestBridge(uint32_t num_worlds, uint32_t max_views,
+               uint32_t max_instances)
+        : numWorlds(num_worlds),
+          views(num_worlds * max_views),
+          instances(num_worlds * max_instances),
+          numViews(num_worlds, 0),
+          numInstances(num_worlds, 0),
+          bridge()
+    {
+        bridge.views = views.data();
+        bridge.instances = instances.data();
+        bridge.numViewsPerWorldCPU = numViews.data();
+        bridge.numInstancesPerWorldCPU = numInstances.data();
+        bridge.maxViewsPerworld = max_views;
+        bridge.maxInstancesPerWorld = max_instances;
+        bridge.isGPUBackend = false;
+    }
+
+    InstanceData * worldInstances(uint32_t world_idx)
+    {
+        return instances.data() + world_idx * bridge.maxInstancesPerWorld;
+    }
+
+    PerspectiveCameraData * worldViews(uint32_t world_idx)
+    {
+        return views.data() + world_idx * bridge.maxViewsPerworld;
+    }
+};
+
+// Deterministic random scene that moves a little every step
+struct SceneSim {
+    TestBridge &bridge;
+    RNG rng;
+
+    SceneSim(TestBridge &b, uint32_t seed)
+        : bridge(b),
+          rng(seed)
+    {}
+
+    float uniform(float lo, float hi)
+    {
+        return lo + (hi - lo) * rng.sampleUniform();
+    }
+
+    Quat randomRot()
+    {
+        return Quat {
+            uniform(-1.f, 1.f),
+            uniform(-1.f, 1.f),
+            uniform(-1.f, 1.f),
+            uniform(-1.f, 1.f),
+        }.normalize();
+    }
+
+    void reset(uint32_t world_idx)
+    {
+        uint32_t max_instances = bridge.bridge.maxInstancesPerWorld;
+        uint32_t num_instances =
+            max_instances / 2 + rng.sampleI32(0, max_instances / 2 + 1);
+        bridge.numInstances[world_idx] = num_instances;
+
+        InstanceData *instances = bridge.worldInstances(world_idx);
+        for (uint32_t i = 0; i < num_instances; i++) {
+            instances[i] = InstanceData {
+                .position = { uniform(-50.f, 50.f), uniform(-50.f, 50.f),
+                              uniform(0.f, 10.f) },
+                .rotation = randomRot(),
+                .scale = { uniform(0.1f, 3.f), uniform(0.1f, 3.f),
+                           uniform(0.1f, 3.f) },
+                .objectID = rng.sampleI32(0, 5),
+                .worldIDX = (int32_t)world_idx,
+            };
+        }
+
+        uint32_t num_views = bridge.bridge.maxViewsPerworld;
+        bridge.numViews[world_idx] = num_views;
+
+        PerspectiveCameraData *views = bridge.worldViews(world_idx);
+        for (uint32_t i = 0; i < num_views; i++) {
+            views[i] = PerspectiveCameraData {
+                .position = { uniform(-10.f, 10.f), uniform(-10.f, 10.f),
+                              1.5f },
+                .rotation = randomRot(),
+                .xScale = uniform(0.5f, 2.f),
+                .yScale = uniform(0.5f, 2.f),
+                .zNear = 0.1f,
+                .worldIDX = (int32_t)world_idx,
+                .pad = 0,
+            };
+        }
+    }
+
+    void step()
+    {
+        for (uint32_t world_idx = 0; world_idx < bridge.numWorlds;
+             world_idx++) {
+            InstanceData *instances = bridge.worldInstances(world_idx);
+            // Every other instance moves and spins
+            for (uint32_t i = 0; i < bridge.numInstances[world_idx];
+                 i += 2) {
+                instances[i].position += Vector3 {
+                    uniform(-0.1f, 0.1f), uniform(-0.1f, 0.1f), 0.f };
+                instances[i].rotation = (Quat::angleAxis(
+                    uniform(-0.05f, 0.05f), math::up) *
+                        instances[i].rotation).normalize();
+            }
+
+            bridge.worldViews(world_idx)[0].position.x += 0.01f;
+        }
+    }
+};
+
+// Like SceneSim, but only produces values the recorder stores exactly:
+// positions on the quantization grid and axis aligned rotations, which
+// survive the 15 bit rotation encoding unchanged. Replays of this scene
+// must match bit for bit.
+struct GridSceneSim {
+    TestBridge &bridge;
+    RNG rng;
+    float quantum;
+
+    GridSceneSim(TestBridge &b, uint32_t seed, float q)
+        : bridge(b),
+          rng(seed),
+          quantum(q)
+    {}
+
+    float gridPosition(int32_t lo, int32_t hi)
+    {
+        return (float)rng.sampleI32(lo, hi) * quantum;
+    }
+
+    Quat gridRot()
+    {
+        // w >= 0, matching the recorder's sign convention for q / -q
+        constexpr Quat rots[] {
+            { 1, 0, 0, 0 },
+            { 0, 1, 0, 0 },
+            { 0, -1, 0, 0 },
+            { 0, 0, 1, 0 },
+            { 0, 0, 0, -1 },
+        };
+
+        return rots[rng.sampleI32(0, 5)];
+    }
+
+    void reset(uint32_t world_idx)
+    {
+        uint32_t max_instances = bridge.bridge.maxInstancesPerWorld;
+        uint32_t num_instances = rng.sampleI32(1, max_instances + 1);
+        bridge.numInstances[world_idx] = num_instances;
+
+        InstanceData *instances = bridge.worldInstances(world_idx);
+        for (uint32_t i = 0; i < num_instances; i++) {
+            instances[i] = InstanceData {
+                .position = { gridPosition(-50000, 50000),
+                              gridPosition(-50000, 50000),
+                              gridPosition(0, 10000) },
+                .rotation = gridRot(),
+                .scale = { rng.sampleUniform() + 0.1f,
+                           rng.sampleUniform() + 0.1f,
+                           rng.sampleUniform() + 0.1f },
+                .objectID = rng.sampleI32(0, 5),
+                .worldIDX = (int32_t)world_idx,
+            };
+        }
+
+        uint32_t num_views = rng.sampleI32(1, bridge.bridge.maxViewsPerworld + 1);
+        bridge.numViews[world_idx] = num_views;
+
+        PerspectiveCameraData *views = bridge.worldViews(world_idx);
+        for (uint32_t i = 0; i < num_views; i++) {
+            views[i] = PerspectiveCameraData {
+                .position = { gridPosition(-10000, 10000),
+                              gridPosition(-10000, 10000),
+                              gridPosition(1000, 2000) },
+                .rotation = gridRot(),
+                .xScale = rng.sampleUniform() + 0.5f,
+                .yScale = rng.sampleUniform() + 0.5f,
+                .zNear = 0.1f,
+                .worldIDX = (int32_t)world_idx,
+                .pad = 0,
+            };
+        }
+    }
+
+    void step()
+    {
+        for (uint32_t world_idx = 0; world_idx < bridge.numWorlds;
+             world_idx++) {
+            InstanceData *instances = bridge.worldInstances(world_idx);
+            for (uint32_t i = 0; i < bridge.numInstances[world_idx];
+                 i += 2) {
+                instances[i].position += Vector3 {
+                    gridPosition(-100, 101), gridPosition(-100, 101), 0.f };
+
+                if (rng.sampleI32(0, 8) == 0) {
+                    instances[i].rotation = gridRot();
+                }
+            }
+
+            bridge.worldViews(world_idx)[0].position.x += 10.f * quantum;
+        }
+    }
+};
+
+bool sameRotation(Quat a, Quat b, float tol)
+{
+    float d = fabsf(a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z);
+    return d > 1.f - tol;
+}
+
+struct RecordedStep {
+    std::vector<std::vector<InstanceData>> instances;
+    std::vector<std::vector<PerspectiveCameraData>> views;
+    std::vector<bool> dones;
+};
+
+}
+
+TEST(Recorder, RoundTrip)
+{
+    constexpr uint32_t num_worlds = 3;
+    constexpr uint32_t num_steps = 150;
+    constexpr float quantum = 1.f / 1024.f;
+
+    std::string path = tmpRecordingPath("madrona_test_recording.bin");
+
+    TestBridge bridge(num_worlds, 2, 12);
+    SceneSim sim(bridge, 7);
+    for (uint32_t i = 0; i < num_worlds; i++) {
+        sim.reset(i);
+    }
+
+    std::vector<RecordedStep> expected;
+    {
+        Recorder recorder({
+            .bridge = &bridge.bridge,
+            .numWorlds = num_worlds,
+            .execMode = ExecMode::CPU,
+            .outputPath = path.c_str(),
+            // The last chunk is partial
+            .stepsPerChunk = 16,
+            .maxQueuedChunks = 2,
+            .positionQuantum = quantum,
+        });
+
+        for (uint32_t step = 0; step < num_steps; step++) {
+            sim.step();
+
+            bool dones[num_worlds];
+            for (uint32_t i = 0; i < num_worlds; i++) {
+                dones[i] = (step + i * 7) % 40 == 39;
+            }
+
+            RecordedStep rec;
+            for (uint32_t i = 0; i < num_worlds; i++) {
+                rec.instances.emplace_back(bridge.worldInstances(i),
+                    bridge.worldInstances(i) + bridge.numInstances[i]);
+                rec.views.emplace_back(bridge.worldViews(i),
+                    bridge.worldViews(i) + bridge.numViews[i]);
+                rec.dones.push_back(dones[i]);
+            }
+            expected.push_back(std::move(rec));
+
+            recorder.record(dones);
+
+            // Episode resets change instance counts and every transform
+            for (uint32_t i = 0; i < num_worlds; i++) {
+                if (dones[i]) {
+                    sim.reset(i);
+                }
+            }
+        }
+
+        EXPECT_EQ(recorder.numRecordedSteps(), num_steps);
+    }
+
+    RecordingReader reader(path.c_str());
+    ASSERT_EQ(reader.numWorlds(), num_worlds);
+    ASSERT_EQ(reader.numSteps(), num_steps);
+
+    // Forwards, then seeking backwards across chunks
+    std::vector<uint64_t> order;
+    for (uint64_t step = 0; step < num_steps; step++) {
+        order.push_back(step);
+    }
+    for (uint64_t step : { 149, 3, 77, 16, 15, 0, 148 }) {
+        order.push_back(step);
+    }
+
+    for (uint64_t step : order) {
+        reader.loadStep(step);
+        const RecordedStep &rec = expected[step];
+
+        for (uint32_t world_idx = 0; world_idx < num_worlds; world_idx++) {
+            ASSERT_EQ(reader.episodeDone(world_idx), rec.dones[world_idx]);
+
+            const auto &ref_instances = rec.instances[world_idx];
+            ASSERT_EQ(reader.numInstances(world_idx), ref_instances.size());
+
+            const InstanceData *instances = reader.instances(world_idx);
+            for (size_t i = 0; i < ref_instances.size(); i++) {
+                const InstanceData &ref = ref_instances[i];
+                const InstanceData &got = instances[i];
+
+                EXPECT_NEAR(got.position.x, ref.position.x, quantum);
+                EXPECT_NEAR(got.position.y, ref.position.y, quantum);
+                EXPECT_NEAR(got.position.z, ref.position.z, quantum);
+                EXPECT_TRUE(sameRotation(got.rotation, ref.rotation, 1e-4f));
+                EXPECT_EQ(got.scale.d0, ref.scale.d0);
+                EXPECT_EQ(got.scale.d1, ref.scale.d1);
+                EXPECT_EQ(got.scale.d2, ref.scale.d2);
+                EXPECT_EQ(got.objectID, ref.objectID);
+                EXPECT_EQ(got.worldIDX, (int32_t)world_idx);
+            }
+
+            const auto &ref_views = rec.views[world_idx];
+            ASSERT_EQ(reader.numViews(world_idx), ref_views.size());
+
+            const PerspectiveCameraData *views = reader.views(world_idx);
+            for (size_t i = 0; i < ref_views.size(); i++) {
+                const PerspectiveCameraData &ref = ref_views[i];
+                const PerspectiveCameraData &got = views[i];
+
+                EXPECT_NEAR(got.position.x, ref.position.x, quantum);
+                EXPECT_NEAR(got.position.y, ref.position.y, quantum);
+                EXPECT_NEAR(got.position.z, ref.position.z, quantum);
+                EXPECT_TRUE(sameRotation(got.rotation, ref.rotation, 1e-4f));
+                EXPECT_EQ(got.xScale, ref.xScale);
+                EXPECT_EQ(got.yScale, ref.yScale);
+                EXPECT_EQ(got.zNear, ref.zNear);
+            }
+        }
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST(Recorder, GridSceneReplaysBitwise)
+{
+    constexpr uint32_t num_worlds = 5;
+    constexpr uint32_t num_steps = 200;
+    constexpr float quantum = 1.f / 1024.f;
+
+    std::string path = tmpRecordingPath("madrona_test_bitwise.bin");
+
+    TestBridge bridge(num_worlds, 3, 16);
+    GridSceneSim sim(bridge, 11, quantum);
+    for (uint32_t i = 0; i < num_worlds; i++) {
+        sim.reset(i);
+    }
+
+    std::vector<RecordedStep> expected;
+    {
+        Recorder recorder({
+            .bridge = &bridge.bridge,
+            .numWorlds = num_worlds,
+            .execMode = ExecMode::CPU,
+            .outputPath = path.c_str(),
+            .stepsPerChunk = 32,
+            .maxQueuedChunks = 1,
+            .positionQuantum = quantum,
+        });
+
+        for (uint32_t step = 0; step < num_steps; step++) {
+            sim.step();
+
+            // Worlds end their episodes at different steps, some of them
+            // mid chunk
+            bool dones[num_worlds];
+            for (uint32_t i = 0; i < num_worlds; i++) {
+                dones[i] = (step + i * 13) % (23 + i) == 0;
+            }
+
+            RecordedStep rec;
+            for (uint32_t i = 0; i < num_worlds; i++) {
+                rec.instances.emplace_back(bridge.worldInstances(i),
+                    bridge.worldInstances(i) + bridge.numInstances[i]);
+                rec.views.emplace_back(bridge.worldViews(i),
+                    bridge.worldViews(i) + bridge.numViews[i]);
+                rec.dones.push_back(dones[i]);
+            }
+            expected.push_back(std::move(rec));
+
+            recorder.record(dones);
+
+            for (uint32_t i = 0; i < num_worlds; i++) {
+                if (dones[i]) {
+                    sim.reset(i);
+                }
+            }
+        }
+    }
+
+    RecordingReader reader(path.c_str());
+    ASSERT_EQ(reader.numWorlds(), num_worlds);
+    ASSERT_EQ(reader.numSteps(), num_steps);
+
+    std::vector<uint64_t> order;
+    for (uint64_t step = 0; step < num_steps; step++) {
+        order.push_back(step);
+    }
+    for (uint64_t step : { 199, 31, 32, 0, 100 }) {
+        order.push_back(step);
+    }
+
+    for (uint64_t step : order) {
+        reader.loadStep(step);
+        const RecordedStep &rec = expected[step];
+
+        for (uint32_t world_idx = 0; world_idx < num_worlds; world_idx++) {
+            ASSERT_EQ(reader.episodeDone(world_idx), rec.dones[world_idx]);
+
+            const auto &ref_instances = rec.instances[world_idx];
+            ASSERT_EQ(reader.numInstances(world_idx), ref_instances.size());
+            EXPECT_EQ(memcmp(reader.instances(world_idx),
+                             ref_instances.data(),
+                             ref_instances.size() * sizeof(InstanceData)), 0)
+                << "step " << step << " world " << world_idx;
+
+            const auto &ref_views = rec.views[world_idx];
+            ASSERT_EQ(reader.numViews(world_idx), ref_views.size());
+            EXPECT_EQ(memcmp(reader.views(world_idx), ref_views.data(),
+                             ref_views.size() *
+                                 sizeof(PerspectiveCameraData)), 0)
+                << "step " << step << " world " << world_idx;
+        }
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST(Recorder, StaticSceneCompresses)
+{
+    constexpr uint32_t num_worlds = 4;
+    constexpr uint32_t max_instances = 64;
+    constexpr uint32_t num_steps = 1000;
+
+    std::string path = tmpRecordingPath("madrona_test_static.bin");
+
+    TestBridge bridge(num_worlds, 1, max_instances);
+    SceneSim sim(bridge, 3);
+    for (uint32_t i = 0; i < num_worlds; i++) {
+        sim.reset(i);
+    }
+
+    uint64_t raw_bytes = 0;
+    {
+        Recorder recorder({
+            .bridge = &bridge.bridge,
+            .numWorlds = num_worlds,
+            .execMode = ExecMode::CPU,
+            .outputPath = path.c_str(),
+        });
+
+        for (uint32_t step = 0; step < num_steps; step++) {
+            recorder.record();
+
+            for (uint32_t i = 0; i < num_worlds; i++) {
+                raw_bytes += sizeof(InstanceData) * bridge.numInstances[i] +
+                    sizeof(PerspectiveCameraData) * bridge.numViews[i];
+            }
+        }
+    }
+
+    uint64_t file_bytes = std::filesystem::file_size(path);
+
+    // Only the first step of each chunk carries data, the rest of the
+    // chunk is zero runs
+    EXPECT_LT(file_bytes * 50, raw_bytes);
+
+    RecordingReader reader(path.c_str());
+    ASSERT_EQ(reader.numSteps(), num_steps);
+    reader.loadStep(num_steps - 1);
+    EXPECT_EQ(reader.numInstances(2), bridge.numInstances[2]);
+    EXPECT_FALSE(reader.episodeDone(2));
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2021-2022 Brennan Shacklett and contributors
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+#include <gtest/gtest.h>
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+#include "../src/physics/sat_avx2.hpp"
+#include "hull_test_utils.hpp"
+
+using namespace madrona;
+using namespace madrona::geo;
+using namespace madrona::math;
+using namespace madrona::phys;
+using namespace madrona::geo::test;
+
+namespace {
+
+Vector3 hullCenter(const HalfEdgeMesh &mesh)
+{
+    Vector3 center = Vector3::zero();
+    for (uint32_t i = 0; i < mesh.numVertices; i++) {
+        center += mesh.vertices[i];
+    }
+
+    return center / float(mesh.numVertices);
+}
+
+// Scalar versions of the edge separation test in narrowphase.cpp
+float refEdgeSeparation(const HalfEdgeMesh &a, Vector3 a_center,
+                        const HalfEdgeMesh &b,
+                        uint32_t hedge_idx_a, uint32_t hedge_idx_b)
+{
+    HalfEdge cur_a = a.halfEdges[hedge_idx_a];
+    HalfEdge twin_a = a.halfEdges[a.twinIDX(hedge_idx_a)];
+    HalfEdge cur_b = b.halfEdges[hedge_idx_b];
+    HalfEdge twin_b = b.halfEdges[b.twinIDX(hedge_idx_b)];
+
+    Vector3 na1 = a.facePlanes[cur_a.face].normal;
+    Vector3 na2 = a.facePlanes[twin_a.face].normal;
+    Vector3 nb1 = -b.facePlanes[cur_b.face].normal;
+    Vector3 nb2 = -b.facePlanes[twin_b.face].normal;
+
+    Vector3 bxa = cross(na2, na1);
+    Vector3 dxc = cross(nb2, nb1);
+    float cba = dot(nb1, bxa);
+    float dba = dot(nb2, bxa);
+    float adc = dot(na1, dxc);
+    float bdc = dot(na2, dxc);
+
+    if (!(cba * dba < 0.f && adc * bdc < 0.f && cba * bdc > 0.f)) {
+        return -FLT_MAX;
+    }
+
+    Vector3 pa = a.vertices[cur_a.rootVertex];
+    Vector3 pb = b.vertices[cur_b.rootVertex];
+    Vector3 dir_a = a.vertices[a.halfEdges[cur_a.next].rootVertex] - pa;
+    Vector3 dir_b = b.vertices[b.halfEdges[cur_b.next].rootVertex] - pb;
+
+    Vector3 n = cross(dir_a, dir_b);
+    float len2 = n.length2();
+    if (len2 == 0.f) {
+        return -FLT_MAX;
+    }
+
+    n /= sqrtf(len2);
+    if (dot(n, pa - a_center) < 0.f) {
+        n = -n;
+    }
+
+    return dot(n, pb - pa);
+}
+
+float refMaxEdgeSeparation(const HalfEdgeMesh &a, Vector3 a_center,
+                           const HalfEdgeMesh &b)
+{
+    float max_sep = -FLT_MAX;
+    for (uint32_t i = 0; i < a.numEdges(); i++) {
+        for (uint32_t j = 0; j < b.numEdges(); j++) {
+            max_sep = fmaxf(max_sep, refEdgeSeparation(a, a_center, b,
+                a.edgeToHalfEdge(i), b.edgeToHalfEdge(j)));
+        }
+    }
+
+    return max_sep;
+}
+
+}
+
+TEST(SATAVX2, HullMinDot)
+{
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> pos_dist(-3.f, 3.f);
+
+    for (int32_t iter = 0; iter < 100; iter++) {
+        TestHull hull = makePrism(randomRotation(rng),
+            { pos_dist(rng), pos_dist(rng), pos_dist(rng) });
+        HalfEdgeMesh mesh = hull.mesh();
+
+        avx2::HullVertices soa;
+        avx2::buildHullVertices(mesh, &soa);
+
+        Vector3 n = randomRotation(rng).rotateVec(math::up);
+
+        float ref = FLT_MAX;
+        for (uint32_t i = 0; i < mesh.numVertices; i++) {
+            ref = fminf(ref, dot(mesh.vertices[i], n));
+        }
+
+        EXPECT_NEAR(avx2::hullMinDot(soa, n), ref, 1e-5f);
+    }
+}
+
+TEST(SATAVX2, QueryEdgeDirections)
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> pos_dist(-1.5f, 1.5f);
+
+    int32_t num_separated = 0;
+    for (int32_t iter = 0; iter < 500; iter++) {
+        TestHull a_hull = makeBox(randomRotation(rng), Vector3::zero());
+        TestHull b_hull = makePrism(randomRotation(rng),
+            { pos_dist(rng), pos_dist(rng), pos_dist(rng) });
+
+        HalfEdgeMesh a = a_hull.mesh();
+        HalfEdgeMesh b = b_hull.mesh();
+        Vector3 a_center = hullCenter(a);
+
+        avx2::HullEdges b_edges;
+        avx2::buildHullEdges(b, &b_edges);
+
+        avx2::EdgeQueryResult query =
+            avx2::queryEdgeDirections(a, a_center, b_edges);
+
+        float ref_max = refMaxEdgeSeparation(a, a_center, b);
+
+        if (ref_max > 0.f) {
+            // Any separating axis ends the query
+            EXPECT_GT(query.separation, 0.f);
+            num_separated++;
+        } else {
+            EXPECT_NEAR(query.separation, ref_max, 1e-4f);
+        }
+
+        // The reported pair has to actually produce the reported separation
+        if (query.separation != -FLT_MAX) {
+            EXPECT_NEAR(refEdgeSeparation(a, a_center, b,
+                query.hedgeIdxA, query.hedgeIdxB), query.separation, 1e-4f);
+        }
+    }
+
+    // Make sure both branches were covered
+    EXPECT_GT(num_separated, 0);
+    EXPECT_LT(num_separated, 500);
+}
+
+#endif
@@ -0,0 +1,359 @@
+/*
+ * Copyright 2021-2022 Brennan Shacklett and contributors
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+#include <gtest/gtest.h>
+
+#include "../src/physics/xpbd_batch.hpp"
+
+#include <random>
+#include <vector>
+
+using namespace madrona;
+using namespace madrona::phys::xpbd;
+
+namespace {
+
+struct ColoringResult {
+    std::vector<uint32_t> sorted;
+    std::vector<uint32_t> offsets;
+};
+
+ColoringResult runColoring(const std::vector<uint32_t> &body_a,
+                           const std::vector<uint32_t> &body_b,
+                           CountT num_bodies)
+{
+    CountT num_contacts = (CountT)body_a.size();
+
+    std::vector<uint64_t> masks(num_bodies);
+    std::vector<uint32_t> colors(num_contacts);
+
+    ColoringResult result;
+    result.sorted.resize(num_contacts);
+    result.offsets.resize(batch::numColorBuckets + 1);
+
+    batch::colorContacts(body_a.data(), body_b.data(), num_contacts,
+                         num_bodies, masks.data(), colors.data(),
+                         result.sorted.data(), result.offsets.data());
+
+    return result;
+}
+
+float randRange(std::mt19937 &rng, float lo, float hi)
+{
+    return std::uniform_real_distribution<float>(lo, hi)(rng);
+}
+
+batch::Vec3<float> randVec(std::mt19937 &rng, float scale)
+{
+    return {
+        randRange(rng, -scale, scale),
+        randRange(rng, -scale, scale),
+        randRange(rng, -scale, scale),
+    };
+}
+
+batch::Vec3<float> randDir(std::mt19937 &rng)
+{
+    batch::Vec3<float> v = randVec(rng, 1.f);
+    float inv_len = 1.f / batch::length(v);
+
+    return v * inv_len;
+}
+
+batch::Quat4<float> randRot(std::mt19937 &rng)
+{
+    return batch::normalize(batch::Quat4<float> {
+        randRange(rng, -1.f, 1.f),
+        randRange(rng, -1.f, 1.f),
+        randRange(rng, -1.f, 1.f),
+        randRange(rng, -1.f, 1.f),
+    });
+}
+
+batch::PositionBatch<float> randPositionRecord(std::mt19937 &rng,
+                                               bool static2)
+{
+    batch::Quat4<float> prev_q1 = randRot(rng);
+    batch::Quat4<float> prev_q2 = randRot(rng);
+
+    // Current rotations are a small perturbation of the previous ones
+    auto perturb = [&](batch::Quat4<float> q) {
+        return batch::normalize(batch::Quat4<float> {
+            q.w + randRange(rng, -0.05f, 0.05f),
+            q.x + randRange(rng, -0.05f, 0.05f),
+            q.y + randRange(rng, -0.05f, 0.05f),
+            q.z + randRange(rng, -0.05f, 0.05f),
+        });
+    };
+
+    batch::Vec3<float> prev_x1 = randVec(rng, 2.f);
+    batch::Vec3<float> prev_x2 = randVec(rng, 2.f);
+
+    return batch::PositionBatch<float> {
+        .x1 = prev_x1 + randVec(rng, 0.05f),
+        .x2 = static2 ? prev_x2 : prev_x2 + randVec(rng, 0.05f),
+        .q1 = perturb(prev_q1),
+        .q2 = static2 ? prev_q2 : perturb(prev_q2),
+        .prevX1 = prev_x1,
+        .prevX2 = prev_x2,
+        .prevQ1 = prev_q1,
+        .prevQ2 = prev_q2,
+        .invMass1 = randRange(rng, 0.1f, 2.f),
+        .invMass2 = static2 ? 0.f : randRange(rng, 0.1f, 2.f),
+        .invI1 = { randRange(rng, 0.1f, 4.f), randRange(rng, 0.1f, 4.f),
+                   randRange(rng, 0.1f, 4.f) },
+        .invI2 = static2 ? batch::Vec3<float> { 0.f, 0.f, 0.f } :
+            batch::Vec3<float> { randRange(rng, 0.1f, 4.f),
+                randRange(rng, 0.1f, 4.f), randRange(rng, 0.1f, 4.f) },
+        .r1 = randVec(rng, 0.5f),
+        .r2 = randVec(rng, 0.5f),
+        .normal = randDir(rng),
+        .muS = randRange(rng, 0.f, 1.f),
+        .lambdaN = 0.f,
+    };
+}
+
+batch::VelocityBatch<float> randVelocityRecord(std::mt19937 &rng,
+                                               CountT num_points)
+{
+    batch::VelocityBatch<float> record {
+        .v1 = randVec(rng, 3.f),
+        .v2 = randVec(rng, 3.f),
+        .omega1 = randVec(rng, 3.f),
+        .omega2 = randVec(rng, 3.f),
+        .q1 = randRot(rng),
+        .q2 = randRot(rng),
+        .invMass1 = randRange(rng, 0.1f, 2.f),
+        .invMass2 = randRange(rng, 0.f, 2.f),
+        .invI1 = { randRange(rng, 0.1f, 4.f), randRange(rng, 0.1f, 4.f),
+                   randRange(rng, 0.1f, 4.f) },
+        .invI2 = { randRange(rng, 0.1f, 4.f), randRange(rng, 0.1f, 4.f),
+                   randRange(rng, 0.1f, 4.f) },
+        .normal = randDir(rng),
+        .muD = randRange(rng, 0.f, 1.f),
+        .restitutionR1 = randVec(rng, 0.5f),
+        .restitutionR2 = randVec(rng, 0.5f),
+        .vnBar = randRange(rng, -3.f, 1.f),
+        .frictionR1 = {},
+        .frictionR2 = {},
+        .frictionLambda = {},
+    };
+
+    for (CountT i = 0; i < num_points; i++) {
+        record.frictionR1[i] = randVec(rng, 0.5f);
+        record.frictionR2[i] = randVec(rng, 0.5f);
+        record.frictionLambda[i] = randRange(rng, -0.2f, 0.f);
+    }
+
+    return record;
+}
+
+void expectNear(batch::Vec3<float> a, batch::Vec3<float> b, float tolerance)
+{
+    EXPECT_NEAR(a.x, b.x, tolerance);
+    EXPECT_NEAR(a.y, b.y, tolerance);
+    EXPECT_NEAR(a.z, b.z, tolerance);
+}
+
+void expectNear(batch::Quat4<float> a, batch::Quat4<float> b,
+                float tolerance)
+{
+    EXPECT_NEAR(a.w, b.w, tolerance);
+    EXPECT_NEAR(a.x, b.x, tolerance);
+    EXPECT_NEAR(a.y, b.y, tolerance);
+    EXPECT_NEAR(a.z, b.z, tolerance);
+}
+
+}
+
+TEST(XPBDBatch, ColoringSeparatesBodies)
+{
+    std::mt19937 rng(5);
+
+    constexpr CountT num_bodies = 200;
+    constexpr CountT num_contacts = 1500;
+
+    std::vector<uint32_t> body_a(num_contacts);
+    std::vector<uint32_t> body_b(num_contacts);
+
+    std::uniform_int_distribution<uint32_t> body_dist(0, num_bodies - 1);
+    for (CountT i = 0; i < num_contacts; i++) {
+        body_a[i] = body_dist(rng);
+
+        if (i % 4 == 0) {
+            body_b[i] = batch::staticBody;
+        } else {
+            do {
+                body_b[i] = body_dist(rng);
+            } while (body_b[i] == body_a[i]);
+        }
+    }
+
+    ColoringResult result = runColoring(body_a, body_b, num_bodies);
+
+    EXPECT_EQ(result.offsets[0], 0u);
+    EXPECT_EQ(result.offsets[batch::numColorBuckets], (uint32_t)num_contacts);
+    EXPECT_EQ(result.offsets[batch::overflowColor],
+              result.offsets[batch::numColorBuckets]);
+
+    std::vector<bool> seen(num_contacts, false);
+
+    for (CountT c = 0; c < batch::maxColors; c++) {
+        std::vector<bool> used(num_bodies, false);
+
+        uint32_t prev_contact = 0;
+        for (uint32_t i = result.offsets[c]; i < result.offsets[c + 1]; i++) {
+            uint32_t contact = result.sorted[i];
+
+            EXPECT_FALSE(seen[contact]);
+            seen[contact] = true;
+
+            if (i > result.offsets[c]) {
+                EXPECT_GT(contact, prev_contact);
+            }
+            prev_contact = contact;
+
+            for (uint32_t body : { body_a[contact], body_b[contact] }) {
+                if (body == batch::staticBody) {
+                    continue;
+                }
+
+                EXPECT_FALSE(used[body]);
+                used[body] = true;
+            }
+        }
+    }
+
+    for (CountT i = 0; i < num_contacts; i++) {
+        EXPECT_TRUE(seen[i]);
+    }
+}
+
+TEST(XPBDBatch, ColoringOverflow)
+{
+    constexpr CountT num_contacts = batch::maxColors + 6;
+
+    // Every contact touches body 0, so each needs its own color
+    std::vector<uint32_t> body_a(num_contacts, 0);
+    std::vector<uint32_t> body_b(num_contacts);
+    for (CountT i = 0; i < num_contacts; i++) {
+        body_b[i] = (uint32_t)(i + 1);
+    }
+
+    ColoringResult result = runColoring(body_a, body_b, num_contacts + 1);
+
+    for (CountT c = 0; c < batch::maxColors; c++) {
+        EXPECT_EQ(result.offsets[c + 1] - result.offsets[c], 1u);
+        EXPECT_EQ(result.sorted[result.offsets[c]], (uint32_t)c);
+    }
+
+    EXPECT_EQ(result.offsets[batch::overflowColor + 1] -
+              result.offsets[batch::overflowColor], 6u);
+}
+
+TEST(XPBDBatch, PositionSolveResolvesPenetration)
+{
+    batch::PositionBatch<float> record {
+        .x1 = { 0.f, 0.f, 0.f },
+        .x2 = { 0.f, 0.f, -0.1f },
+        .q1 = { 1.f, 0.f, 0.f, 0.f },
+        .q2 = { 1.f, 0.f, 0.f, 0.f },
+        .prevX1 = { 0.f, 0.f, 0.f },
+        .prevX2 = { 0.f, 0.f, -0.1f },
+        .prevQ1 = { 1.f, 0.f, 0.f, 0.f },
+        .prevQ2 = { 1.f, 0.f, 0.f, 0.f },
+        .invMass1 = 0.5f,
+        .invMass2 = 0.f,
+        .invI1 = { 1.f, 1.f, 1.f },
+        .invI2 = { 0.f, 0.f, 0.f },
+        .r1 = { 0.f, 0.f, 0.f },
+        .r2 = { 0.f, 0.f, 0.f },
+        .normal = { 0.f, 0.f, 1.f },
+        .muS = 0.5f,
+        .lambdaN = 0.f,
+    };
+
+    batch::PositionBatch<float> separated = record;
+    separated.x2.z = 0.1f;
+
+    batch::PositionBatch<float> records[] = { record, separated };
+    batch::solvePositionRecords(records, 2);
+
+    EXPECT_NEAR(records[0].x1.z, -0.1f, 1e-6f);
+    EXPECT_NEAR(records[0].lambdaN, -0.2f, 1e-6f);
+    EXPECT_EQ(records[0].x2.z, -0.1f);
+
+    // Contacts that aren't penetrating are left alone
+    EXPECT_EQ(records[1].x1.z, 0.f);
+    EXPECT_EQ(records[1].lambdaN, 0.f);
+}
+
+// The batched kernels are the same code as the one contact at a time
+// fallback, but FMA contraction can differ between the two, so compare
+// with a tolerance.
+TEST(XPBDBatch, PositionBatchMatchesSingle)
+{
+    std::mt19937 rng(11);
+
+    constexpr CountT num_records = 61;
+
+    std::vector<batch::PositionBatch<float>> batched;
+    for (CountT i = 0; i < num_records; i++) {
+        batched.push_back(randPositionRecord(rng, i % 3 == 0));
+    }
+
+    std::vector<batch::PositionBatch<float>> single = batched;
+
+    batch::solvePositionRecords(batched.data(), num_records);
+
+    CountT num_solved = 0;
+    for (CountT i = 0; i < num_records; i++) {
+        batch::solveContactPositions(single[i]);
+
+        expectNear(batched[i].x1, single[i].x1, 1e-4f);
+        expectNear(batched[i].x2, single[i].x2, 1e-4f);
+        expectNear(batched[i].q1, single[i].q1, 1e-4f);
+        expectNear(batched[i].q2, single[i].q2, 1e-4f);
+        EXPECT_NEAR(batched[i].lambdaN, single[i].lambdaN, 1e-4f);
+
+        if (single[i].lambdaN != 0.f) {
+            num_solved++;
+        }
+    }
+
+    // Both the active and inactive paths should have been exercised
+    EXPECT_GT(num_solved, 0);
+    EXPECT_LT(num_solved, num_records);
+}
+
+TEST(XPBDBatch, VelocityBatchMatchesSingle)
+{
+    std::mt19937 rng(17);
+
+    constexpr CountT num_records = 43;
+    constexpr float h = 1.f / 120.f;
+    constexpr float restitution_threshold = 2.f * 9.8f * h;
+
+    std::vector<batch::VelocityBatch<float>> batched;
+    for (CountT i = 0; i < num_records; i++) {
+        batched.push_back(randVelocityRecord(rng, i % 5));
+    }
+
+    std::vector<batch::VelocityBatch<float>> single = batched;
+
+    batch::solveVelocityRecords(batched.data(), num_records,
+                                h, restitution_threshold);
+
+    for (CountT i = 0; i < num_records; i++) {
+        batch::solveContactVelocities(single[i], h, restitution_threshold);
+
+        expectNear(batched[i].v1, single[i].v1, 1e-3f);
+        expectNear(batched[i].v2, single[i].v2, 1e-3f);
+        expectNear(batched[i].omega1, single[i].omega1, 1e-3f);
+        expectNear(batched[i].omega2, single[i].omega2, 1e-3f);
+    }
+}